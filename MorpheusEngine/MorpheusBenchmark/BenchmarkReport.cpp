@@ -0,0 +1,383 @@
+#include "BenchmarkReport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	bool SetError(std::string* error, const std::string& message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+
+		return false;
+	}
+
+	// Just enough JSON for reports: values the report does not use are parsed and skipped.
+	class FJsonReader
+	{
+	public:
+		explicit FJsonReader(const std::string& text)
+			: Text(text)
+			, Position(0)
+		{
+		}
+
+		bool ReadReport(FBenchmarkReport& report)
+		{
+			return ReadObject([&](const std::string& key)
+			{
+				double value = 0.0;
+				if (key == "seed" || key == "threads")
+				{
+					if (!ReadNumber(value))
+					{
+						return false;
+					}
+					(key == "seed" ? report.Seed : report.Threads) = static_cast<uint32_t>(value);
+					return true;
+				}
+				if (key == "results")
+				{
+					return ReadArray([&]()
+					{
+						FBenchmarkResult result;
+						if (!ReadResult(result))
+						{
+							return false;
+						}
+						report.Results.push_back(result);
+						return true;
+					});
+				}
+				return SkipValue();
+			}) && SkipWhitespace() == Text.size();
+		}
+
+		size_t GetPosition() const
+		{
+			return Position;
+		}
+
+	private:
+		bool ReadResult(FBenchmarkResult& result)
+		{
+			return ReadObject([&](const std::string& key)
+			{
+				if (key == "name")
+				{
+					return ReadString(result.Name);
+				}
+
+				double* field = key == "median_ms" ? &result.MedianMilliseconds :
+					key == "p99_ms" ? &result.P99Milliseconds :
+					key == "mean_ms" ? &result.MeanMilliseconds :
+					key == "min_ms" ? &result.MinMilliseconds :
+					key == "threshold_percent" ? &result.ThresholdPercent : nullptr;
+				if (field)
+				{
+					return ReadNumber(*field);
+				}
+
+				double value = 0.0;
+				if (key == "objects" || key == "samples")
+				{
+					if (!ReadNumber(value))
+					{
+						return false;
+					}
+					(key == "objects" ? result.Objects : result.Samples) = static_cast<uint32_t>(value);
+					return true;
+				}
+
+				return SkipValue();
+			});
+		}
+
+		size_t SkipWhitespace()
+		{
+			while (Position < Text.size() && std::strchr(" \t\r\n", Text[Position]) && Text[Position] != '\0')
+			{
+				++Position;
+			}
+			return Position;
+		}
+
+		bool Consume(char character)
+		{
+			SkipWhitespace();
+			if (Position < Text.size() && Text[Position] == character)
+			{
+				++Position;
+				return true;
+			}
+			return false;
+		}
+
+		template<typename MemberFunction>
+		bool ReadObject(const MemberFunction& member)
+		{
+			if (!Consume('{'))
+			{
+				return false;
+			}
+			if (Consume('}'))
+			{
+				return true;
+			}
+
+			do
+			{
+				std::string key;
+				if (!ReadString(key) || !Consume(':') || !member(key))
+				{
+					return false;
+				}
+			} while (Consume(','));
+
+			return Consume('}');
+		}
+
+		template<typename ElementFunction>
+		bool ReadArray(const ElementFunction& element)
+		{
+			if (!Consume('['))
+			{
+				return false;
+			}
+			if (Consume(']'))
+			{
+				return true;
+			}
+
+			do
+			{
+				if (!element())
+				{
+					return false;
+				}
+			} while (Consume(','));
+
+			return Consume(']');
+		}
+
+		bool ReadString(std::string& value)
+		{
+			if (!Consume('"'))
+			{
+				return false;
+			}
+
+			value.clear();
+			while (Position < Text.size() && Text[Position] != '"')
+			{
+				char character = Text[Position++];
+				if (character == '\\')
+				{
+					if (Position >= Text.size())
+					{
+						return false;
+					}
+
+					char escaped = Text[Position++];
+					switch (escaped)
+					{
+						case 'n': character = '\n'; break;
+						case 't': character = '\t'; break;
+						case 'r': character = '\r'; break;
+						case 'b': character = '\b'; break;
+						case 'f': character = '\f'; break;
+						case 'u':
+							// Report names are ASCII, anything else is kept as a placeholder.
+							if (Text.size() - Position < 4)
+							{
+								return false;
+							}
+							Position += 4;
+							character = '?';
+							break;
+						default: character = escaped; break;
+					}
+				}
+				value.push_back(character);
+			}
+
+			return Consume('"');
+		}
+
+		bool ReadNumber(double& value)
+		{
+			SkipWhitespace();
+
+			const char* begin = Text.c_str() + Position;
+			char* end = nullptr;
+			value = std::strtod(begin, &end);
+			if (end == begin || !std::isfinite(value))
+			{
+				return false;
+			}
+
+			Position += static_cast<size_t>(end - begin);
+			return true;
+		}
+
+		bool ReadLiteral(const char* literal)
+		{
+			size_t length = std::strlen(literal);
+			if (Text.compare(Position, length, literal) != 0)
+			{
+				return false;
+			}
+
+			Position += length;
+			return true;
+		}
+
+		bool SkipValue()
+		{
+			SkipWhitespace();
+			if (Position >= Text.size())
+			{
+				return false;
+			}
+
+			std::string text;
+			double number = 0.0;
+			switch (Text[Position])
+			{
+				case '{':
+					return ReadObject([&](const std::string&) { return SkipValue(); });
+				case '[':
+					return ReadArray([&]() { return SkipValue(); });
+				case '"':
+					return ReadString(text);
+				case 't':
+					return ReadLiteral("true");
+				case 'f':
+					return ReadLiteral("false");
+				case 'n':
+					return ReadLiteral("null");
+				default:
+					return ReadNumber(number);
+			}
+		}
+
+		const std::string& Text;
+		size_t Position;
+	};
+}
+
+double Median(std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		return 0.0;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	size_t middle = samples.size() / 2;
+
+	return (samples.size() % 2) ? samples[middle] : 0.5 * (samples[middle - 1] + samples[middle]);
+}
+
+FBenchmarkResult SummariseSamples(const std::string& name, uint32_t objects, std::vector<double> samples)
+{
+	FBenchmarkResult result;
+	result.Name = name;
+	result.Objects = objects;
+	result.Samples = static_cast<uint32_t>(samples.size());
+
+	if (samples.empty())
+	{
+		return result;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	result.MedianMilliseconds = Median(samples);
+
+	size_t rank = static_cast<size_t>(std::ceil(0.99 * static_cast<double>(samples.size())));
+	result.P99Milliseconds = samples[std::max<size_t>(rank, 1) - 1];
+
+	double sum = 0.0;
+	for (double sample : samples)
+	{
+		sum += sample;
+	}
+	result.MeanMilliseconds = sum / static_cast<double>(samples.size());
+	result.MinMilliseconds = samples.front();
+
+	return result;
+}
+
+bool WriteBenchmarkReport(const char* fileName, const FBenchmarkReport& report, std::string* error)
+{
+	FILE* file = std::fopen(fileName, "wb");
+	if (!file)
+	{
+		return SetError(error, std::string("Could not create ") + fileName);
+	}
+
+	std::fprintf(file, "{\n  \"seed\": %u,\n  \"threads\": %u,\n  \"results\": [", report.Seed, report.Threads);
+
+	for (size_t i = 0; i < report.Results.size(); ++i)
+	{
+		const FBenchmarkResult& result = report.Results[i];
+
+		// Names come from the suite and need no escaping.
+		std::fprintf(file, "%s\n    { \"name\": \"%s\", \"objects\": %u, \"samples\": %u, \"median_ms\": %.6f, \"p99_ms\": %.6f, \"mean_ms\": %.6f, \"min_ms\": %.6f",
+			i > 0 ? "," : "", result.Name.c_str(), result.Objects, result.Samples, result.MedianMilliseconds, result.P99Milliseconds,
+			result.MeanMilliseconds, result.MinMilliseconds);
+		if (result.ThresholdPercent > 0.0)
+		{
+			std::fprintf(file, ", \"threshold_percent\": %.3f", result.ThresholdPercent);
+		}
+		std::fprintf(file, " }");
+	}
+
+	std::fprintf(file, "\n  ]\n}\n");
+
+	bool written = !std::ferror(file);
+	written = std::fclose(file) == 0 && written;
+
+	return written ? true : SetError(error, std::string("Could not write ") + fileName);
+}
+
+bool ReadBenchmarkReport(const char* fileName, FBenchmarkReport& report, std::string* error)
+{
+	FILE* file = std::fopen(fileName, "rb");
+	if (!file)
+	{
+		return SetError(error, std::string("Could not open ") + fileName);
+	}
+
+	std::string text;
+	char buffer[4096];
+	size_t bytesRead;
+	while ((bytesRead = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		text.append(buffer, bytesRead);
+	}
+
+	bool failed = std::ferror(file) != 0;
+	std::fclose(file);
+	if (failed)
+	{
+		return SetError(error, std::string("Could not read ") + fileName);
+	}
+
+	report = FBenchmarkReport();
+
+	FJsonReader reader(text);
+	if (!reader.ReadReport(report))
+	{
+		return SetError(error, std::string(fileName) + " is not a benchmark report, error near byte " + std::to_string(reader.GetPosition()));
+	}
+
+	return true;
+}
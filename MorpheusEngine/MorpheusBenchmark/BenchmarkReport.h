@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Timing of one metric at one scene size, in milliseconds per iteration.
+struct FBenchmarkResult
+{
+	std::string Name;
+	uint32_t Objects = 0;
+	uint32_t Samples = 0;
+	double MedianMilliseconds = 0.0;
+	double P99Milliseconds = 0.0;
+	double MeanMilliseconds = 0.0;
+	double MinMilliseconds = 0.0;
+	// Regression the comparison allows for this metric, in percent. Zero defers to the command line.
+	double ThresholdPercent = 0.0;
+};
+
+struct FBenchmarkReport
+{
+	uint32_t Seed = 0;
+	uint32_t Threads = 0;
+	std::vector<FBenchmarkResult> Results;
+};
+
+// The mean of the middle two for an even count.
+double Median(std::vector<double> samples);
+
+// Median, nearest-rank 99th percentile, mean and minimum of the samples.
+FBenchmarkResult SummariseSamples(const std::string& name, uint32_t objects, std::vector<double> samples);
+
+// Median time of repeats calls of function(), after one untimed call that warms caches and grows buffers.
+template<typename FunctionType>
+double MeasureMilliseconds(uint32_t repeats, const FunctionType& function)
+{
+	function();
+
+	std::vector<double> samples;
+	for (uint32_t repeat = 0; repeat < repeats; ++repeat)
+	{
+		auto start = std::chrono::steady_clock::now();
+		function();
+		auto end = std::chrono::steady_clock::now();
+
+		samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return Median(samples);
+}
+
+// Median time of repeats calls of function() with no warm-up, each after an untimed call of prepare()
+// that restores whatever the previous call consumed or cached.
+template<typename PrepareType, typename FunctionType>
+double MeasureMilliseconds(uint32_t repeats, const PrepareType& prepare, const FunctionType& function)
+{
+	std::vector<double> samples;
+	for (uint32_t repeat = 0; repeat < repeats; ++repeat)
+	{
+		prepare();
+
+		auto start = std::chrono::steady_clock::now();
+		function();
+		auto end = std::chrono::steady_clock::now();
+
+		samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return Median(samples);
+}
+
+// JSON of the form
+//   { "seed": 1, "threads": 8, "results": [ { "name": "frame/100k", "objects": 100000, "samples": 31,
+//     "median_ms": 1.5, "p99_ms": 1.9, "mean_ms": 1.6, "min_ms": 1.4 }, ... ] }
+// with an optional "threshold_percent" per result. Unknown fields are ignored when reading.
+bool WriteBenchmarkReport(const char* fileName, const FBenchmarkReport& report, std::string* error = nullptr);
+bool ReadBenchmarkReport(const char* fileName, FBenchmarkReport& report, std::string* error = nullptr);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Every benchmark receives the arguments that follow its name on the command line and returns the
+// process exit code.
+typedef int(*FBenchmarkFunction)(int argumentCount, char** arguments);
+
+int RunBenchmarkComparison(int argumentCount, char** arguments);
+int RunBoundingVolumeHierarchyBenchmark(int argumentCount, char** arguments);
+int RunCommandListBenchmark(int argumentCount, char** arguments);
+int RunConstantBufferBenchmark(int argumentCount, char** arguments);
+int RunDrawSortBenchmark(int argumentCount, char** arguments);
+int RunEntityComponentSystemBenchmark(int argumentCount, char** arguments);
+int RunFrustumCullingBenchmark(int argumentCount, char** arguments);
+int RunInstancingBenchmark(int argumentCount, char** arguments);
+int RunJobSystemBenchmark(int argumentCount, char** arguments);
+int RunMemoryBenchmark(int argumentCount, char** arguments);
+int RunMeshLoadBenchmark(int argumentCount, char** arguments);
+int RunMeshOptimizerBenchmark(int argumentCount, char** arguments);
+int RunOcclusionCullingBenchmark(int argumentCount, char** arguments);
+int RunPipelineStateBenchmark(int argumentCount, char** arguments);
+int RunProfilerBenchmark(int argumentCount, char** arguments);
+int RunRasterizerBenchmark(int argumentCount, char** arguments);
+int RunRenderGraphBenchmark(int argumentCount, char** arguments);
+int RunResourcePoolBenchmark(int argumentCount, char** arguments);
+int RunSceneGraphBenchmark(int argumentCount, char** arguments);
+int RunShaderCacheBenchmark(int argumentCount, char** arguments);
+int RunStreamingBenchmark(int argumentCount, char** arguments);
+int RunSuiteBenchmark(int argumentCount, char** arguments);
+int RunTransformMathBenchmark(int argumentCount, char** arguments);
+int RunVertexFormatBenchmark(int argumentCount, char** arguments);
+
+// Parses "--name=value". Returns false when the argument is a different option.
+bool ParseOption(const char* argument, const char* name, uint32_t& value);
+bool ParseOption(const char* argument, const char* name, std::string& value);
@@ -0,0 +1,287 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// XMMatrixLookAtLH from the origin along +z times XMMatrixPerspectiveFovLH(60 degrees, 16:9, 0.1, 250).
+	FFloat4x4 CameraViewProjection()
+	{
+		const float nearPlane = 0.1f;
+		const float farPlane = 250.0f;
+		float yScale = 1.0f / std::tan(0.5f * 60.0f * 3.14159265f / 180.0f);
+		float range = farPlane / (farPlane - nearPlane);
+
+		FFloat4x4 viewProjection = {};
+		viewProjection.M[0][0] = yScale * 9.0f / 16.0f;
+		viewProjection.M[1][1] = yScale;
+		viewProjection.M[2][2] = range;
+		viewProjection.M[2][3] = 1.0f;
+		viewProjection.M[3][2] = -range * nearPlane;
+
+		return viewProjection;
+	}
+
+	bool RayEntersBox(const FBoundingBox& box, const FFloat3& origin, const FFloat3& inverseDirection, float maxDistance, float& entry)
+	{
+		float entryX = ((inverseDirection.X >= 0.0f ? box.Min.X : box.Max.X) - origin.X) * inverseDirection.X;
+		float exitX = ((inverseDirection.X >= 0.0f ? box.Max.X : box.Min.X) - origin.X) * inverseDirection.X;
+		float entryY = ((inverseDirection.Y >= 0.0f ? box.Min.Y : box.Max.Y) - origin.Y) * inverseDirection.Y;
+		float exitY = ((inverseDirection.Y >= 0.0f ? box.Max.Y : box.Min.Y) - origin.Y) * inverseDirection.Y;
+		float entryZ = ((inverseDirection.Z >= 0.0f ? box.Min.Z : box.Max.Z) - origin.Z) * inverseDirection.Z;
+		float exitZ = ((inverseDirection.Z >= 0.0f ? box.Max.Z : box.Min.Z) - origin.Z) * inverseDirection.Z;
+
+		entry = std::max(std::max(entryX, entryY), std::max(entryZ, 0.0f));
+
+		return entry <= std::min(std::min(exitX, exitY), std::min(exitZ, maxDistance));
+	}
+
+	bool BoxesOverlap(const FBoundingBox& a, const FBoundingBox& b)
+	{
+		return a.Min.X <= b.Max.X && a.Min.Y <= b.Max.Y && a.Min.Z <= b.Max.Z &&
+			b.Min.X <= a.Max.X && b.Min.Y <= a.Max.Y && b.Min.Z <= a.Max.Z;
+	}
+}
+
+int RunBoundingVolumeHierarchyBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t objectCount = 1000000;
+	uint32_t movingCount = 10000;
+	uint32_t queryCount = 10000;
+	uint32_t repeats = 11;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "objects", objectCount) &&
+			!ParseOption(arguments[i], "moving", movingCount) &&
+			!ParseOption(arguments[i], "queries", queryCount) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	objectCount = std::max(1u, objectCount);
+	movingCount = std::min(movingCount, objectCount);
+	queryCount = std::max(1u, queryCount);
+	repeats = std::max(1u, repeats);
+
+	// An open level with the same density at every size: the volume grows with the object count.
+	const float halfWidth = 1000.0f * std::sqrt(objectCount / 1000000.0f);
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> horizontal(-halfWidth, halfWidth);
+	std::uniform_real_distribution<float> vertical(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> extent(0.25f, 2.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	auto randomBox = [&](const FFloat3& centre)
+	{
+		FFloat3 extents = { extent(random), extent(random), extent(random) };
+
+		return FBoundingBox{ { centre.X - extents.X, centre.Y - extents.Y, centre.Z - extents.Z }, { centre.X + extents.X, centre.Y + extents.Y, centre.Z + extents.Z } };
+	};
+
+	std::vector<FBoundingBox> boxes(objectCount);
+	for (FBoundingBox& box : boxes)
+	{
+		box = randomBox({ horizontal(random), vertical(random), horizontal(random) });
+	}
+
+	// The last objects keep moving, the rest are static.
+	FBoundingVolumeHierarchy hierarchy;
+	std::vector<FBvhProxyHandle> proxies(objectCount);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		proxies[i] = hierarchy.CreateProxy(boxes[i], i, i >= objectCount - movingCount ? EBvhProxyType::Dynamic : EBvhProxyType::Static);
+	}
+
+	auto buildStart = std::chrono::steady_clock::now();
+	hierarchy.Update();
+	double buildMilliseconds = ElapsedMilliseconds(buildStart);
+
+	const FBvhStats& buildStats = hierarchy.GetLastUpdateStats();
+	printf("Bounding volume hierarchy of %u boxes, %u of them moving, median of %u runs\n\n", objectCount, movingCount, repeats);
+	printf("Static tree: %u proxies in %u nodes, built in %.1f ms. Dynamic tree: %u proxies in %u nodes.\n\n",
+		buildStats.StaticProxies, buildStats.StaticNodes, buildMilliseconds, buildStats.DynamicProxies, buildStats.DynamicNodes);
+
+	printf("%-36s %12s %12s %10s %10s\n", "query", "median ms", "us/query", "speedup", "results");
+
+	// Frustum culling against the flat SIMD culler over the same boxes.
+	FFrustum frustum = FrustumFromViewProjection(CameraViewProjection());
+
+	FBoundsSoA bounds;
+	bounds.Resize(objectCount);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		const FBoundingBox& box = boxes[i];
+		bounds.SetBox(i, { 0.5f * (box.Min.X + box.Max.X), 0.5f * (box.Min.Y + box.Max.Y), 0.5f * (box.Min.Z + box.Max.Z) },
+			{ 0.5f * (box.Max.X - box.Min.X), 0.5f * (box.Max.Y - box.Min.Y), 0.5f * (box.Max.Z - box.Min.Z) });
+	}
+
+	std::vector<uint32_t> visibleIndices(objectCount + CullOutputPadding);
+	uint32_t flatVisible = 0;
+	double flatMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		flatVisible = CullBounds(bounds, 0, objectCount, frustum, visibleIndices.data());
+	});
+
+	std::vector<uint32_t> results;
+	results.reserve(objectCount);
+	double treeMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		results.clear();
+		hierarchy.QueryFrustum(frustum, results);
+	});
+
+	printf("%-36s %12.3f %12.1f %9.2fx %10u\n", "frustum, flat SIMD culling", flatMilliseconds, flatMilliseconds * 1000.0, 1.0, flatVisible);
+	printf("%-36s %12.3f %12.1f %9.2fx %10u\n", "frustum, hierarchy", treeMilliseconds, treeMilliseconds * 1000.0, flatMilliseconds / treeMilliseconds,
+		static_cast<uint32_t>(results.size()));
+
+	// Picking rays from random points in random directions, and small proximity boxes. Brute force only
+	// runs a few queries, it scales with the object count.
+	const uint32_t bruteForceQueries = std::min(queryCount, 16u);
+
+	std::vector<FFloat3> rayOrigins(queryCount);
+	std::vector<FFloat3> rayDirections(queryCount);
+	std::vector<FBoundingBox> queryBoxes(queryCount);
+	for (uint32_t query = 0; query < queryCount; ++query)
+	{
+		rayOrigins[query] = { horizontal(random), vertical(random), horizontal(random) };
+
+		FFloat3 direction = { unit(random), 0.2f * unit(random), unit(random) };
+		float length = std::sqrt(direction.X * direction.X + direction.Y * direction.Y + direction.Z * direction.Z);
+		rayDirections[query] = { direction.X / length, direction.Y / length, direction.Z / length };
+
+		FBoundingBox box = randomBox(rayOrigins[query]);
+		queryBoxes[query] = { { box.Min.X - 5.0f, box.Min.Y - 5.0f, box.Min.Z - 5.0f }, { box.Max.X + 5.0f, box.Max.Y + 5.0f, box.Max.Z + 5.0f } };
+	}
+
+	const float maxRayDistance = 500.0f;
+	uint32_t bruteForceHits = 0;
+	double bruteForceRayMilliseconds = MeasureMilliseconds(1, [&]()
+	{
+		bruteForceHits = 0;
+		for (uint32_t query = 0; query < bruteForceQueries; ++query)
+		{
+			const FFloat3& direction = rayDirections[query];
+			FFloat3 inverseDirection = { 1.0f / direction.X, 1.0f / direction.Y, 1.0f / direction.Z };
+
+			float closest = maxRayDistance;
+			bool found = false;
+			for (const FBoundingBox& box : boxes)
+			{
+				float entry;
+				if (RayEntersBox(box, rayOrigins[query], inverseDirection, closest, entry))
+				{
+					closest = entry;
+					found = true;
+				}
+			}
+
+			bruteForceHits += found ? 1 : 0;
+		}
+	}) / bruteForceQueries;
+
+	uint32_t treeHits = 0;
+	uint32_t treeHitsOfBruteForceRays = 0;
+	double treeRayMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		treeHits = 0;
+		treeHitsOfBruteForceRays = 0;
+		for (uint32_t query = 0; query < queryCount; ++query)
+		{
+			FBvhRayHit hit;
+			bool found = hierarchy.RayCast(rayOrigins[query], rayDirections[query], maxRayDistance, hit);
+
+			treeHits += found ? 1 : 0;
+			treeHitsOfBruteForceRays += (found && query < bruteForceQueries) ? 1 : 0;
+		}
+	}) / queryCount;
+
+	printf("%-36s %12.3f %12.1f %9.2fx %10u\n", "ray, brute force", bruteForceRayMilliseconds, bruteForceRayMilliseconds * 1000.0, 1.0, bruteForceHits);
+	printf("%-36s %12.5f %12.2f %9.0fx %10u\n", "ray, hierarchy", treeRayMilliseconds, treeRayMilliseconds * 1000.0,
+		bruteForceRayMilliseconds / treeRayMilliseconds, treeHitsOfBruteForceRays);
+
+	uint32_t bruteForceOverlaps = 0;
+	double bruteForceBoxMilliseconds = MeasureMilliseconds(1, [&]()
+	{
+		bruteForceOverlaps = 0;
+		for (uint32_t query = 0; query < bruteForceQueries; ++query)
+		{
+			for (const FBoundingBox& box : boxes)
+			{
+				bruteForceOverlaps += BoxesOverlap(box, queryBoxes[query]) ? 1 : 0;
+			}
+		}
+	}) / bruteForceQueries;
+
+	uint32_t treeOverlaps = 0;
+	double treeBoxMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		treeOverlaps = 0;
+		for (uint32_t query = 0; query < queryCount; ++query)
+		{
+			results.clear();
+			hierarchy.QueryBox(queryBoxes[query], results);
+			treeOverlaps += query < bruteForceQueries ? static_cast<uint32_t>(results.size()) : 0;
+		}
+	}) / queryCount;
+
+	printf("%-36s %12.3f %12.1f %9.2fx %10u\n", "box overlap, brute force", bruteForceBoxMilliseconds, bruteForceBoxMilliseconds * 1000.0, 1.0, bruteForceOverlaps);
+	printf("%-36s %12.5f %12.2f %9.0fx %10u\n", "box overlap, hierarchy", treeBoxMilliseconds, treeBoxMilliseconds * 1000.0,
+		bruteForceBoxMilliseconds / treeBoxMilliseconds, treeOverlaps);
+
+	// A frame of movement: every dynamic object drifts, and one static object in a hundred is nudged
+	// and refitted.
+	std::vector<double> frameSamples;
+	FBvhStats moveStats;
+	for (uint32_t frame = 0; frame <= repeats; ++frame)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		for (uint32_t i = objectCount - movingCount; i < objectCount; ++i)
+		{
+			float step = 0.05f * unit(random);
+			boxes[i].Min.X += step;
+			boxes[i].Max.X += step;
+			hierarchy.SetBounds(proxies[i], boxes[i]);
+		}
+
+		for (uint32_t i = frame % 100; i < objectCount - movingCount; i += 100)
+		{
+			float step = 0.01f * unit(random);
+			boxes[i].Min.Z += step;
+			boxes[i].Max.Z += step;
+			hierarchy.SetBounds(proxies[i], boxes[i]);
+		}
+
+		hierarchy.Update();
+
+		if (frame > 0)
+		{
+			frameSamples.push_back(ElapsedMilliseconds(start));
+		}
+
+		moveStats = hierarchy.GetLastUpdateStats();
+	}
+
+	printf("\nMoving %u dynamic and %u static objects: %.3f ms per frame, %u reinserts, %u static nodes refitted\n",
+		movingCount, (objectCount - movingCount + 99) / 100, Median(frameSamples), moveStats.Reinserts, moveStats.NodesRefitted);
+	printf("Hierarchy results cover only the boxes, the flat culler also rejects by bounding sphere.\n");
+
+	return 0;
+}
@@ -0,0 +1,263 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "CommandBuffer.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Drops the lists instead of executing them, so only sorting and recording are timed.
+	class FRecordOnlyRenderDevice : public FNullRenderDevice
+	{
+	public:
+		FRecordOnlyRenderDevice()
+			: FNullRenderDevice(false)
+		{
+		}
+
+		void ExecuteCommandList(ICommandList*) override
+		{
+		}
+	};
+
+	bool SameCommands(const std::vector<FRecordedCommand>& a, const std::vector<FRecordedCommand>& b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			if (a[i].Type != b[i].Type || std::memcmp(a[i].Arguments, b[i].Arguments, sizeof(a[i].Arguments)) != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// The draws alone, which must not depend on how the list was split.
+	std::vector<FRecordedCommand> Draws(const std::vector<FRecordedCommand>& commands)
+	{
+		std::vector<FRecordedCommand> draws;
+		for (const FRecordedCommand& command : commands)
+		{
+			if (command.Type == ERecordedCommandType::DrawIndexed || command.Type == ERecordedCommandType::DrawIndexedInstanced)
+			{
+				draws.push_back(command);
+			}
+		}
+
+		return draws;
+	}
+}
+
+int RunCommandListBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t drawCount = 100000;
+	uint32_t pipelineCount = 8;
+	uint32_t meshCount = 64;
+	uint32_t repeats = 15;
+	uint32_t maxThreads = 0;
+	uint32_t listCount = 0;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "draws", drawCount) &&
+			!ParseOption(arguments[i], "pipelines", pipelineCount) &&
+			!ParseOption(arguments[i], "meshes", meshCount) &&
+			!ParseOption(arguments[i], "repeats", repeats) &&
+			!ParseOption(arguments[i], "threads", maxThreads) &&
+			!ParseOption(arguments[i], "lists", listCount))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	drawCount = std::max(1u, drawCount);
+	pipelineCount = std::max(1u, std::min(pipelineCount, 1u << DrawSortPipelineBits));
+	meshCount = std::max(1u, std::min(meshCount, 1u << DrawSortMaterialBits));
+	repeats = std::max(1u, repeats);
+	maxThreads = maxThreads > 0 ? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+	// The same split at every thread count, so every run has to produce the same command stream.
+	listCount = std::max(2u, listCount > 0 ? listCount : std::max(maxThreads, 8u));
+
+	FNullRenderDevice renderDevice(false);
+	FRecordOnlyRenderDevice recordOnlyDevice;
+
+	// Resources are created on both devices in the same order, so the handles agree.
+	FShaderBytecode bytecode;
+	FInputElementDesc element;
+	element.SemanticName = "POSITION";
+
+	std::vector<FDrawPipelineState> pipelines(pipelineCount);
+	std::vector<FBufferHandle> vertexBuffers(meshCount);
+	std::vector<FBufferHandle> indexBuffers(meshCount);
+	FBufferHandle constantBuffer;
+	for (IRenderDevice* device : { static_cast<IRenderDevice*>(&renderDevice), static_cast<IRenderDevice*>(&recordOnlyDevice) })
+	{
+		FRasterizerStateHandle rasterizerState = device->CreateRasterizerState(FRasterizerDesc());
+		FDepthStencilStateHandle depthStencilState = device->CreateDepthStencilState(FDepthStencilDesc());
+		for (FDrawPipelineState& pipeline : pipelines)
+		{
+			pipeline.VertexShader = device->CreateVertexShader(bytecode);
+			pipeline.PixelShader = device->CreatePixelShader(bytecode);
+			pipeline.InputLayout = device->CreateInputLayout(&element, 1, bytecode);
+			pipeline.RasterizerState = rasterizerState;
+			pipeline.DepthStencilState = depthStencilState;
+		}
+
+		FBufferDesc vertexDescription;
+		vertexDescription.ByteWidth = 24 * 8;
+		FBufferDesc indexDescription;
+		indexDescription.Binding = EBufferBinding::Index;
+		indexDescription.ByteWidth = 2 * 36;
+		for (uint32_t mesh = 0; mesh < meshCount; ++mesh)
+		{
+			vertexBuffers[mesh] = device->CreateBuffer(vertexDescription, nullptr);
+			indexBuffers[mesh] = device->CreateBuffer(indexDescription, nullptr);
+		}
+
+		FBufferDesc constantDescription;
+		constantDescription.Binding = EBufferBinding::Constant;
+		constantDescription.Usage = EResourceUsage::Dynamic;
+		constantDescription.ByteWidth = 256 * 1024;
+		constantBuffer = device->CreateBuffer(constantDescription, nullptr);
+	}
+
+	// Objects in random order with a constant buffer slice each, as the ring hands them out.
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> pickPipeline(0, pipelineCount - 1);
+	std::uniform_int_distribution<uint32_t> pickMesh(0, meshCount - 1);
+	std::uniform_real_distribution<float> pickDepth(1.0f, 100.0f);
+
+	FDrawList drawList;
+	for (uint32_t i = 0; i < drawCount; ++i)
+	{
+		uint32_t pipeline = pickPipeline(random);
+		uint32_t mesh = pickMesh(random);
+
+		FDrawItem item;
+		item.Pipeline = pipelines[pipeline];
+		item.VertexBuffers[0] = vertexBuffers[mesh];
+		item.VertexStrides[0] = 24;
+		item.IndexBuffer = indexBuffers[mesh];
+		item.ConstantBuffers[0].Buffer = constantBuffer;
+		item.ConstantBuffers[0].Offset = (i % 1024) * ConstantBufferRangeAlignment;
+		item.ConstantBuffers[0].Size = ConstantBufferRangeAlignment;
+		item.IndexCount = 36;
+
+		FDrawSortKeyFields fields;
+		fields.Pipeline = pipeline;
+		fields.Material = mesh;
+		fields.Depth = QuantizeDrawDepth(pickDepth(random), 0.1f, 100.0f);
+		drawList.Add(MakeDrawSortKey(fields), item);
+	}
+
+	std::vector<std::unique_ptr<ICommandList>> ownedLists;
+	std::vector<ICommandList*> commandLists;
+	std::vector<std::unique_ptr<ICommandList>> recordOnlyOwnedLists;
+	std::vector<ICommandList*> recordOnlyLists;
+	for (uint32_t i = 0; i < listCount; ++i)
+	{
+		ownedLists.push_back(renderDevice.CreateCommandList());
+		commandLists.push_back(ownedLists.back().get());
+		recordOnlyOwnedLists.push_back(recordOnlyDevice.CreateCommandList());
+		recordOnlyLists.push_back(recordOnlyOwnedLists.back().get());
+	}
+
+	// The reference is one thread straight into the device.
+	renderDevice.SetRecordingEnabled(true);
+	drawList.Submit(&renderDevice);
+	renderDevice.Present(false);
+	std::vector<FRecordedCommand> serialDraws = Draws(renderDevice.GetLastFrameCommands());
+	renderDevice.SetRecordingEnabled(false);
+
+	double serialMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		drawList.Submit(&renderDevice);
+		renderDevice.Present(false);
+	});
+	uint64_t directBinds = drawList.GetLastSubmitStats().Binds;
+
+	printf("Recording %u draws of %u pipelines and %u meshes into %u command lists, median of %u frames\n\n",
+		drawCount, pipelineCount, meshCount, listCount, repeats);
+	printf("%-8s %12s %12s %12s %14s %12s %10s\n", "threads", "record ms", "draws/ms", "speed-up", "record+run ms", "speed-up", "same");
+	printf("%-8s %12s %12s %12s %14.3f %12s %10s\n", "direct", "-", "-", "-", serialMilliseconds, "1.00x", "-");
+
+	std::vector<FRecordedCommand> firstStream;
+	double firstRecordMilliseconds = 0.0;
+	bool deterministic = true;
+
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	for (uint32_t threads : threadCounts)
+	{
+		FJobSystem jobSystem(threads);
+
+		double recordMilliseconds = MeasureMilliseconds(repeats, [&]()
+		{
+			drawList.SubmitParallel(&recordOnlyDevice, recordOnlyLists.data(), listCount, &jobSystem);
+		});
+
+		double submitMilliseconds = MeasureMilliseconds(repeats, [&]()
+		{
+			drawList.SubmitParallel(&renderDevice, commandLists.data(), listCount, &jobSystem);
+			renderDevice.Present(false);
+		});
+
+		// Every thread count has to hand the device the same commands, and the same draws as the direct path.
+		renderDevice.SetRecordingEnabled(true);
+		drawList.SubmitParallel(&renderDevice, commandLists.data(), listCount, &jobSystem);
+		renderDevice.Present(false);
+		renderDevice.SetRecordingEnabled(false);
+
+		if (firstStream.empty())
+		{
+			firstStream = renderDevice.GetLastFrameCommands();
+			firstRecordMilliseconds = recordMilliseconds;
+		}
+
+		bool same = SameCommands(firstStream, renderDevice.GetLastFrameCommands()) && SameCommands(serialDraws, Draws(renderDevice.GetLastFrameCommands()));
+		deterministic = deterministic && same;
+
+		printf("%-8u %12.3f %12.0f %11.2fx %14.3f %11.2fx %10s\n", jobSystem.GetConcurrency(), recordMilliseconds, drawCount / recordMilliseconds,
+			firstRecordMilliseconds / recordMilliseconds, submitMilliseconds, serialMilliseconds / submitMilliseconds, same ? "yes" : "NO");
+	}
+
+	uint64_t words = 0;
+	for (ICommandList* commandList : commandLists)
+	{
+		words += static_cast<FCommandBuffer*>(commandList)->GetWordCount();
+	}
+
+	const FDrawListStats& listStats = drawList.GetLastSubmitStats();
+	printf("\n%.1f bytes of packets per draw, %llu binds with %u lists against %llu direct\n", 4.0 * static_cast<double>(words) / drawCount,
+		static_cast<unsigned long long>(listStats.Binds), listCount, static_cast<unsigned long long>(directBinds));
+
+	if (!deterministic)
+	{
+		fprintf(stderr, "Command streams differ between thread counts\n");
+		return 1;
+	}
+
+	return 0;
+}
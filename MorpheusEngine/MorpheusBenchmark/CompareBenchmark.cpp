@@ -0,0 +1,126 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+int RunBenchmarkComparison(int argumentCount, char** arguments)
+{
+	const char* baselineFileName = nullptr;
+	const char* currentFileName = nullptr;
+	uint32_t thresholdPercent = 10;
+	std::string metric = "median";
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (strncmp(arguments[i], "--", 2) != 0)
+		{
+			if (!baselineFileName)
+			{
+				baselineFileName = arguments[i];
+				continue;
+			}
+			if (!currentFileName)
+			{
+				currentFileName = arguments[i];
+				continue;
+			}
+		}
+
+		if (!ParseOption(arguments[i], "threshold", thresholdPercent) &&
+			!ParseOption(arguments[i], "metric", metric))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	if (!baselineFileName || !currentFileName)
+	{
+		fprintf(stderr, "Usage: compare <baseline.json> <current.json> [--threshold=percent] [--metric=median|p99]\n");
+		return 1;
+	}
+
+	bool useP99 = metric == "p99";
+	if (!useP99 && metric != "median")
+	{
+		fprintf(stderr, "Unknown metric '%s'\n", metric.c_str());
+		return 1;
+	}
+
+	FBenchmarkReport baseline;
+	FBenchmarkReport current;
+	std::string error;
+	if (!ReadBenchmarkReport(baselineFileName, baseline, &error) || !ReadBenchmarkReport(currentFileName, current, &error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	if (baseline.Seed != current.Seed || baseline.Threads != current.Threads)
+	{
+		printf("Warning: the baseline ran with seed %u and %u threads, the current run with seed %u and %u threads\n\n",
+			baseline.Seed, baseline.Threads, current.Seed, current.Threads);
+	}
+
+	printf("%-20s %12s %12s %9s %10s\n", "metric", "baseline ms", "current ms", "change", "threshold");
+
+	// Every metric of the baseline is tracked. One that is missing from the current run fails, new ones
+	// are listed but cannot regress.
+	uint32_t regressions = 0;
+	uint32_t missing = 0;
+	for (const FBenchmarkResult& base : baseline.Results)
+	{
+		double threshold = base.ThresholdPercent > 0.0 ? base.ThresholdPercent : static_cast<double>(thresholdPercent);
+
+		const FBenchmarkResult* result = nullptr;
+		for (const FBenchmarkResult& candidate : current.Results)
+		{
+			if (candidate.Name == base.Name)
+			{
+				result = &candidate;
+				break;
+			}
+		}
+
+		if (!result)
+		{
+			printf("%-20s %12.3f %12s %9s %9.1f%%  MISSING\n", base.Name.c_str(), useP99 ? base.P99Milliseconds : base.MedianMilliseconds, "-", "-", threshold);
+			++missing;
+			continue;
+		}
+
+		double baseValue = useP99 ? base.P99Milliseconds : base.MedianMilliseconds;
+		double currentValue = useP99 ? result->P99Milliseconds : result->MedianMilliseconds;
+		double change = baseValue > 0.0 ? 100.0 * (currentValue - baseValue) / baseValue : 0.0;
+		bool regressed = change > threshold;
+		regressions += regressed ? 1 : 0;
+
+		printf("%-20s %12.3f %12.3f %+8.1f%% %9.1f%%%s\n", base.Name.c_str(), baseValue, currentValue, change, threshold, regressed ? "  REGRESSED" : "");
+	}
+
+	for (const FBenchmarkResult& result : current.Results)
+	{
+		bool tracked = false;
+		for (const FBenchmarkResult& base : baseline.Results)
+		{
+			tracked = tracked || base.Name == result.Name;
+		}
+
+		if (!tracked)
+		{
+			printf("%-20s %12s %12.3f %9s %10s  NEW\n", result.Name.c_str(), "-", useP99 ? result.P99Milliseconds : result.MedianMilliseconds, "-", "-");
+		}
+	}
+
+	if (regressions > 0 || missing > 0)
+	{
+		fprintf(stderr, "\n%u of %zu %s timings regressed, %u missing\n", regressions, baseline.Results.size(), metric.c_str(), missing);
+		return 1;
+	}
+
+	printf("\nNo regressions in %zu %s timings\n", baseline.Results.size(), metric.c_str());
+
+	return 0;
+}
@@ -0,0 +1,178 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "ConstantBufferRing.h"
+#include "NullRenderDevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	// Per-object constants of a typical draw, the world matrix and a few material parameters.
+	struct FObjectConstants
+	{
+		float World[16];
+		float Parameters[8];
+	};
+
+	void PrintRow(const char* name, double milliseconds, const FRenderDeviceStats& stats, uint64_t bytesUploaded)
+	{
+		printf("%-20s %12.3f %10llu %10llu %12llu\n", name, milliseconds,
+			static_cast<unsigned long long>(stats.BufferUpdates), static_cast<unsigned long long>(stats.BufferMaps),
+			static_cast<unsigned long long>(bytesUploaded));
+	}
+}
+
+int RunConstantBufferBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t objectCount = 10000;
+	uint32_t frames = 31;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "objects", objectCount) &&
+			!ParseOption(arguments[i], "frames", frames))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	objectCount = std::max(1u, objectCount);
+	frames = std::max(1u, frames);
+
+	std::vector<FObjectConstants> objects(objectCount);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		for (int element = 0; element < 16; ++element)
+		{
+			objects[i].World[element] = (element % 5 == 0) ? 1.0f : 0.0f;
+		}
+
+		objects[i].World[12] = static_cast<float>(i);
+	}
+
+	// The headless device only measures the engine side. Its updates are a memcpy into one hot buffer,
+	// a driver adds a copy and a rename per update, so compare the update and map counts.
+	FNullRenderDevice renderDevice(false);
+
+	FBufferDesc description;
+	description.Binding = EBufferBinding::Constant;
+	description.ByteWidth = sizeof(FObjectConstants);
+	FBufferHandle objectBuffer = renderDevice.CreateBuffer(description, nullptr);
+
+	FConstantBufferRing ring(&renderDevice);
+	std::vector<FConstantBufferAllocation> allocations(objectCount);
+
+	auto measure = [&](bool useRing, FRenderDeviceStats& frameStats)
+	{
+		std::vector<double> samples;
+
+		for (uint32_t frame = 0; frame <= frames; ++frame)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			if (useRing)
+			{
+				ring.BeginFrame();
+				for (uint32_t i = 0; i < objectCount; ++i)
+				{
+					allocations[i] = ring.Upload(&objects[i], sizeof(FObjectConstants));
+				}
+				ring.Commit();
+
+				for (uint32_t i = 0; i < objectCount; ++i)
+				{
+					renderDevice.SetConstantBufferRange(EShaderStage::Vertex, 2, allocations[i].Buffer, allocations[i].Offset, allocations[i].Size);
+					renderDevice.DrawIndexed(36, 0, 0);
+				}
+				ring.EndFrame();
+			}
+			else
+			{
+				for (uint32_t i = 0; i < objectCount; ++i)
+				{
+					renderDevice.UpdateBuffer(objectBuffer, &objects[i], sizeof(FObjectConstants));
+					renderDevice.SetConstantBuffer(EShaderStage::Vertex, 2, objectBuffer);
+					renderDevice.DrawIndexed(36, 0, 0);
+				}
+			}
+
+			auto end = std::chrono::steady_clock::now();
+			renderDevice.Present(false);
+
+			// The first frame creates the pages and is not measured.
+			if (frame > 0)
+			{
+				samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			}
+		}
+
+		frameStats = renderDevice.GetLastFrameStats();
+
+		return Median(samples);
+	};
+
+	printf("Constants of %u objects (%u bytes each), median of %u frames\n\n", objectCount, static_cast<uint32_t>(sizeof(FObjectConstants)), frames);
+	printf("%-20s %12s %10s %10s %12s\n", "path", "median ms", "updates", "maps", "bytes");
+
+	FRenderDeviceStats updateStats;
+	double updateMilliseconds = measure(false, updateStats);
+	PrintRow("update per object", updateMilliseconds, updateStats, updateStats.BytesUploaded);
+
+	FRenderDeviceStats ringStats;
+	double ringMilliseconds = measure(true, ringStats);
+	const FConstantBufferRingStats& stats = ring.GetLastFrameStats();
+	PrintRow("ring slices", ringMilliseconds, ringStats, stats.BytesUploaded);
+
+	printf("\nRing: %u KB pages, %u used per frame, %u allocated in total, %llu bytes of slices\n",
+		ring.GetPageSize() / 1024, stats.PagesUsed, ring.GetPageCount(), static_cast<unsigned long long>(stats.BytesAllocated));
+
+	// Every draw binds the slice it uploaded, aligned and covering the whole constants.
+	uint32_t failures = 0;
+	{
+		FNullRenderDevice recordingDevice(true);
+		FConstantBufferRing recordingRing(&recordingDevice);
+
+		const uint32_t checkedCount = std::min(objectCount, 64u);
+		recordingRing.BeginFrame();
+		for (uint32_t i = 0; i < checkedCount; ++i)
+		{
+			allocations[i] = recordingRing.Upload(&objects[i], sizeof(FObjectConstants));
+		}
+		recordingRing.Commit();
+
+		for (uint32_t i = 0; i < checkedCount; ++i)
+		{
+			recordingDevice.SetConstantBufferRange(EShaderStage::Vertex, 2, allocations[i].Buffer, allocations[i].Offset, allocations[i].Size);
+		}
+		recordingRing.EndFrame();
+
+		uint32_t bound = 0;
+		for (const FRecordedCommand& command : recordingDevice.GetRecordedCommands())
+		{
+			if (command.Type != ERecordedCommandType::SetConstantBufferRange)
+			{
+				continue;
+			}
+
+			const FConstantBufferAllocation& allocation = allocations[bound++];
+			if (command.Arguments[2] != allocation.Buffer.Value || command.Arguments[3] != allocation.Offset || command.Arguments[4] != allocation.Size ||
+				command.Arguments[3] % ConstantBufferRangeAlignment != 0 || command.Arguments[4] < sizeof(FObjectConstants))
+			{
+				++failures;
+			}
+		}
+
+		if (bound != checkedCount || failures > 0)
+		{
+			fprintf(stderr, "FAILED: %u of %u draws bound a slice other than the one uploaded\n", failures + (checkedCount - std::min(bound, checkedCount)), checkedCount);
+			failures = std::max(failures, 1u);
+		}
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,243 @@
+#include "CubeScene.h"
+
+#include "ConstantBufferRing.h"
+#include "Hash.h"
+#include "InstanceBuffer.h"
+#include "SoftwareRenderDevice.h"
+
+#include <cmath>
+
+namespace
+{
+	// The cube of the original demo, one colour per corner.
+	struct FCubeVertex
+	{
+		float Position[3];
+		float Colour[3];
+	};
+
+	const FCubeVertex CubeVertices[8] =
+	{
+		{ { -1.0f, -1.0f, -1.0f }, { 0.0f, 0.0f, 0.0f } },
+		{ { -1.0f,  1.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ {  1.0f,  1.0f, -1.0f }, { 1.0f, 1.0f, 0.0f } },
+		{ {  1.0f, -1.0f, -1.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { -1.0f, -1.0f,  1.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ { -1.0f,  1.0f,  1.0f }, { 0.0f, 1.0f, 1.0f } },
+		{ {  1.0f,  1.0f,  1.0f }, { 1.0f, 1.0f, 1.0f } },
+		{ {  1.0f, -1.0f,  1.0f }, { 1.0f, 0.0f, 1.0f } }
+	};
+
+	const uint16_t CubeIndices[36] =
+	{
+		0, 1, 2, 0, 2, 3,
+		4, 6, 5, 4, 7, 6,
+		4, 5, 1, 4, 1, 0,
+		3, 2, 6, 3, 6, 7,
+		1, 5, 6, 1, 6, 2,
+		4, 0, 3, 4, 3, 7
+	};
+
+	const uint32_t CubeIndexCount = 36;
+
+	const float NearPlane = 0.1f;
+	const float FarPlane = 100.0f;
+
+	// The PerObject constant buffer of SimpleVertexShader.hlsl. Float positions need no dequantisation.
+	struct FObjectConstants
+	{
+		FFloat4x4 WorldMatrix;
+		float PositionScale[4];
+		float PositionOffset[4];
+	};
+
+	void BeginCubeFrame(FSoftwareRenderDevice& device, const FCubeResources& resources)
+	{
+		const float clearColour[4] = { 100.0f / 255.0f, 149.0f / 255.0f, 237.0f / 255.0f, 1.0f };
+		device.Clear(clearColour, 1.0f, 0);
+
+		FViewport viewport;
+		viewport.Width = static_cast<float>(device.GetWidth());
+		viewport.Height = static_cast<float>(device.GetHeight());
+		device.SetViewport(viewport);
+
+		device.SetVertexBuffer(0, resources.VertexBuffer, sizeof(FCubeVertex), 0);
+		device.SetIndexBuffer(resources.IndexBuffer, EIndexFormat::UInt16, 0);
+		device.SetPixelShader(resources.PixelShader);
+		device.SetRasterizerState(resources.RasterizerState);
+		device.SetDepthStencilState(resources.DepthStencilState);
+		device.SetConstantBuffer(EShaderStage::Vertex, 0, resources.ProjectionBuffer);
+		device.SetConstantBuffer(EShaderStage::Vertex, 1, resources.ViewBuffer);
+	}
+
+	FConstantBufferAllocation UploadObjectConstants(FConstantBufferRing& ring, const FFloat4x4& worldMatrix)
+	{
+		FObjectConstants constants = { worldMatrix, { 1.0f, 1.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 0.0f } };
+
+		return ring.Upload(&constants, sizeof(constants));
+	}
+}
+
+void BuildCubeScene(FCubeScene& scene, uint32_t width, uint32_t height, uint32_t gridSide)
+{
+	// 45 degrees vertically, cot(22.5) is 1 + sqrt(2).
+	const float yScale = 1.0f + std::sqrt(2.0f);
+	const float xScale = yScale * static_cast<float>(height) / static_cast<float>(width);
+	const float zRange = FarPlane / (FarPlane - NearPlane);
+
+	scene.Projection = FFloat4x4();
+	scene.Projection.M[0][0] = xScale;
+	scene.Projection.M[1][1] = yScale;
+	scene.Projection.M[2][2] = zRange;
+	scene.Projection.M[2][3] = 1.0f;
+	scene.Projection.M[3][2] = -NearPlane * zRange;
+
+	// Looking from (0, 0, -10) at the origin.
+	scene.View = MatrixIdentity();
+	scene.View.M[3][2] = 10.0f;
+
+	scene.WorldMatrices.clear();
+
+	// 60 degrees about (0, 1, 1).
+	const float halfAngleSine = 0.5f / std::sqrt(2.0f);
+	scene.WorldMatrices.push_back(MatrixTransform({ 0.0f, 0.0f, 0.0f }, { 0.0f, halfAngleSine, halfAngleSine, 0.5f * std::sqrt(3.0f) }, { 1.0f, 1.0f, 1.0f }));
+
+	// 30 degrees about z, sin and cos of 15 degrees.
+	const float sine15 = 0.25f * (std::sqrt(6.0f) - std::sqrt(2.0f));
+	const float cosine15 = 0.25f * (std::sqrt(6.0f) + std::sqrt(2.0f));
+	FFloat4x4 grid = MatrixTransform({ 0.0f, 0.0f, 20.0f }, { 0.0f, 0.0f, sine15, cosine15 }, { 1.0f, 1.0f, 1.0f });
+
+	const float spacing = 0.75f;
+	const float extent = 0.5f * spacing * (gridSide - 1);
+	for (uint32_t i = 0; i < gridSide * gridSide; ++i)
+	{
+		FFloat3 position = { spacing * (i % gridSide) - extent, spacing * (i / gridSide) - extent, 0.0f };
+		FFloat4x4 local = MatrixTransform(position, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.25f, 0.25f, 0.25f });
+		scene.WorldMatrices.push_back(MatrixMultiply(local, grid));
+	}
+}
+
+bool CreateCubeResources(IRenderDevice& device, const FCubeScene& scene, FCubeResources& resources)
+{
+	FBufferDesc vertexDescription;
+	vertexDescription.Binding = EBufferBinding::Vertex;
+	vertexDescription.Usage = EResourceUsage::Immutable;
+	vertexDescription.ByteWidth = sizeof(CubeVertices);
+	resources.VertexBuffer = device.CreateBuffer(vertexDescription, CubeVertices);
+
+	FBufferDesc indexDescription;
+	indexDescription.Binding = EBufferBinding::Index;
+	indexDescription.Usage = EResourceUsage::Immutable;
+	indexDescription.ByteWidth = sizeof(CubeIndices);
+	resources.IndexBuffer = device.CreateBuffer(indexDescription, CubeIndices);
+
+	FBufferDesc constantDescription;
+	constantDescription.Binding = EBufferBinding::Constant;
+	constantDescription.ByteWidth = sizeof(FFloat4x4);
+	resources.ProjectionBuffer = device.CreateBuffer(constantDescription, &scene.Projection);
+	resources.ViewBuffer = device.CreateBuffer(constantDescription, &scene.View);
+
+	// The software device runs the program the file names, the bytecode is never read.
+	const uint8_t bytecodeData[4] = {};
+	FShaderBytecode vertexBytecode = { bytecodeData, sizeof(bytecodeData), "SimpleVertexShader.hlsl" };
+	FShaderBytecode instancedVertexBytecode = { bytecodeData, sizeof(bytecodeData), "InstancedVertexShader.hlsl" };
+	FShaderBytecode pixelBytecode = { bytecodeData, sizeof(bytecodeData), "SimplePixelShader.hlsl" };
+	resources.VertexShader = device.CreateVertexShader(vertexBytecode);
+	resources.InstancedVertexShader = device.CreateVertexShader(instancedVertexBytecode);
+	resources.PixelShader = device.CreatePixelShader(pixelBytecode);
+
+	FInputElementDesc elements[2 + FInstanceBuffer::InputElementCount];
+	elements[0].SemanticName = "POSITION";
+	elements[0].Format = EVertexFormat::Float3;
+	elements[1].SemanticName = "COLOR";
+	elements[1].Format = EVertexFormat::Float3;
+	elements[1].AlignedByteOffset = sizeof(float) * 3;
+	FInstanceBuffer::GetInputElements(1, &elements[2]);
+	resources.InputLayout = device.CreateInputLayout(elements, 2, vertexBytecode);
+	resources.InstancedInputLayout = device.CreateInputLayout(elements, 2 + FInstanceBuffer::InputElementCount, instancedVertexBytecode);
+
+	// The states InitialiseDirectX() sets up: back faces culled, clockwise in front, depth less.
+	resources.RasterizerState = device.CreateRasterizerState(FRasterizerDesc());
+	resources.DepthStencilState = device.CreateDepthStencilState(FDepthStencilDesc());
+
+	return resources.VertexBuffer.IsValid() && resources.IndexBuffer.IsValid() && resources.ProjectionBuffer.IsValid() && resources.ViewBuffer.IsValid() &&
+		resources.VertexShader.IsValid() && resources.InstancedVertexShader.IsValid() && resources.PixelShader.IsValid() && resources.InputLayout.IsValid() &&
+		resources.InstancedInputLayout.IsValid();
+}
+
+void DestroyCubeResources(IRenderDevice& device, const FCubeResources& resources)
+{
+	device.DestroyBuffer(resources.VertexBuffer);
+	device.DestroyBuffer(resources.IndexBuffer);
+	device.DestroyBuffer(resources.ProjectionBuffer);
+	device.DestroyBuffer(resources.ViewBuffer);
+	device.DestroyVertexShader(resources.VertexShader);
+	device.DestroyVertexShader(resources.InstancedVertexShader);
+	device.DestroyPixelShader(resources.PixelShader);
+	device.DestroyInputLayout(resources.InputLayout);
+	device.DestroyInputLayout(resources.InstancedInputLayout);
+	device.DestroyRasterizerState(resources.RasterizerState);
+	device.DestroyDepthStencilState(resources.DepthStencilState);
+}
+
+void RenderCubeScene(FSoftwareRenderDevice& device, FConstantBufferRing& ring, const FCubeResources& resources, const FCubeScene& scene)
+{
+	BeginCubeFrame(device, resources);
+	device.SetInputLayout(resources.InputLayout);
+	device.SetVertexShader(resources.VertexShader);
+
+	ring.BeginFrame();
+
+	std::vector<FConstantBufferAllocation> objectConstants(scene.WorldMatrices.size());
+	for (size_t i = 0; i < scene.WorldMatrices.size(); ++i)
+	{
+		objectConstants[i] = UploadObjectConstants(ring, scene.WorldMatrices[i]);
+	}
+	ring.Commit();
+
+	for (const FConstantBufferAllocation& allocation : objectConstants)
+	{
+		device.SetConstantBufferRange(EShaderStage::Vertex, 2, allocation.Buffer, allocation.Offset, allocation.Size);
+		device.DrawIndexed(CubeIndexCount, 0, 0);
+	}
+
+	device.Present(false);
+	ring.EndFrame();
+}
+
+void RenderCubeSceneInstanced(FSoftwareRenderDevice& device, FConstantBufferRing& ring, FInstanceBuffer& instanceBuffer, const FCubeResources& resources,
+	const FCubeScene& scene)
+{
+	BeginCubeFrame(device, resources);
+
+	ring.BeginFrame();
+	FConstantBufferAllocation cubeConstants = UploadObjectConstants(ring, scene.WorldMatrices[0]);
+	ring.Commit();
+
+	instanceBuffer.Upload(scene.WorldMatrices.data() + 1, static_cast<uint32_t>(scene.WorldMatrices.size() - 1));
+
+	device.SetInputLayout(resources.InputLayout);
+	device.SetVertexShader(resources.VertexShader);
+	device.SetConstantBufferRange(EShaderStage::Vertex, 2, cubeConstants.Buffer, cubeConstants.Offset, cubeConstants.Size);
+	device.DrawIndexed(CubeIndexCount, 0, 0);
+
+	// Keeps the object constants of the cube for the dequantisation, as the demo does.
+	device.SetInputLayout(resources.InstancedInputLayout);
+	device.SetVertexShader(resources.InstancedVertexShader);
+	instanceBuffer.Bind(1);
+	instanceBuffer.Draw(CubeIndexCount, 0, 0, 0, instanceBuffer.GetInstanceCount());
+
+	device.Present(false);
+	ring.EndFrame();
+}
+
+uint64_t HashColourBuffer(const FSoftwareRenderDevice& device)
+{
+	FHasher hasher;
+	for (uint32_t y = 0; y < device.GetHeight(); ++y)
+	{
+		hasher.Add(device.GetColourBuffer() + static_cast<size_t>(y) * device.GetPitch(), sizeof(uint32_t) * device.GetWidth());
+	}
+
+	return hasher.Get();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "TransformMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class FConstantBufferRing;
+class FInstanceBuffer;
+class FSoftwareRenderDevice;
+
+// The demo frame frozen at one moment, for the benchmarks that render on the software device: the
+// turned cube in front of a wall of small cubes, seen from where the demo camera stands.
+struct FCubeScene
+{
+	FFloat4x4 Projection;
+	FFloat4x4 View;
+	// The main cube first, then the wall row by row.
+	std::vector<FFloat4x4> WorldMatrices;
+};
+
+// The rotations are built from square roots alone so that every platform computes the same matrices.
+void BuildCubeScene(FCubeScene& scene, uint32_t width, uint32_t height, uint32_t gridSide);
+
+// Everything the engine creates for the simple and the instanced cube pipelines.
+struct FCubeResources
+{
+	FBufferHandle VertexBuffer;
+	FBufferHandle IndexBuffer;
+	FBufferHandle ProjectionBuffer;
+	FBufferHandle ViewBuffer;
+	FVertexShaderHandle VertexShader;
+	FVertexShaderHandle InstancedVertexShader;
+	FPixelShaderHandle PixelShader;
+	FInputLayoutHandle InputLayout;
+	// Cube vertices in slot 0, instance transforms in slot 1.
+	FInputLayoutHandle InstancedInputLayout;
+	FRasterizerStateHandle RasterizerState;
+	FDepthStencilStateHandle DepthStencilState;
+};
+
+bool CreateCubeResources(IRenderDevice& device, const FCubeScene& scene, FCubeResources& resources);
+void DestroyCubeResources(IRenderDevice& device, const FCubeResources& resources);
+
+// One frame the way the engine draws it without instancing: a constant buffer slice and a draw per cube.
+void RenderCubeScene(FSoftwareRenderDevice& device, FConstantBufferRing& ring, const FCubeResources& resources, const FCubeScene& scene);
+// The same frame with the main cube drawn alone and the wall as one instanced draw, as the demo does.
+// The instance buffer needs room for the whole wall.
+void RenderCubeSceneInstanced(FSoftwareRenderDevice& device, FConstantBufferRing& ring, FInstanceBuffer& instanceBuffer, const FCubeResources& resources,
+	const FCubeScene& scene);
+
+// Hash of the visible part of the colour buffer.
+uint64_t HashColourBuffer(const FSoftwareRenderDevice& device);
@@ -0,0 +1,224 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "ConstantBufferRing.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	void PrintRow(const char* name, double milliseconds, const FRenderDeviceStats& stats)
+	{
+		printf("%-26s %12.3f %10llu %14llu %12llu\n", name, milliseconds, static_cast<unsigned long long>(stats.DrawCalls),
+			static_cast<unsigned long long>(stats.StateChanges), static_cast<unsigned long long>(stats.RedundantStateChanges));
+	}
+}
+
+int RunDrawSortBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t drawCount = 100000;
+	uint32_t pipelineCount = 8;
+	uint32_t meshCount = 64;
+	uint32_t repeats = 15;
+	uint32_t threads = 0;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "draws", drawCount) &&
+			!ParseOption(arguments[i], "pipelines", pipelineCount) &&
+			!ParseOption(arguments[i], "meshes", meshCount) &&
+			!ParseOption(arguments[i], "repeats", repeats) &&
+			!ParseOption(arguments[i], "threads", threads))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	drawCount = std::max(1u, drawCount);
+	pipelineCount = std::max(1u, std::min(pipelineCount, 1u << DrawSortPipelineBits));
+	meshCount = std::max(1u, std::min(meshCount, 1u << DrawSortMaterialBits));
+	repeats = std::max(1u, repeats);
+
+	FNullRenderDevice renderDevice(false);
+	FJobSystem jobSystem(threads);
+
+	// Every pipeline has its own shaders and shares the fixed function state with the others.
+	FShaderBytecode bytecode;
+	FInputElementDesc element;
+	element.SemanticName = "POSITION";
+
+	FRasterizerStateHandle rasterizerState = renderDevice.CreateRasterizerState(FRasterizerDesc());
+	FDepthStencilStateHandle depthStencilState = renderDevice.CreateDepthStencilState(FDepthStencilDesc());
+
+	std::vector<FDrawPipelineState> pipelines(pipelineCount);
+	for (FDrawPipelineState& pipeline : pipelines)
+	{
+		pipeline.VertexShader = renderDevice.CreateVertexShader(bytecode);
+		pipeline.PixelShader = renderDevice.CreatePixelShader(bytecode);
+		pipeline.InputLayout = renderDevice.CreateInputLayout(&element, 1, bytecode);
+		pipeline.RasterizerState = rasterizerState;
+		pipeline.DepthStencilState = depthStencilState;
+	}
+
+	FBufferDesc vertexDescription;
+	vertexDescription.ByteWidth = 24 * 8;
+	FBufferDesc indexDescription;
+	indexDescription.Binding = EBufferBinding::Index;
+	indexDescription.ByteWidth = 2 * 36;
+
+	std::vector<FBufferHandle> vertexBuffers(meshCount);
+	std::vector<FBufferHandle> indexBuffers(meshCount);
+	for (uint32_t mesh = 0; mesh < meshCount; ++mesh)
+	{
+		vertexBuffers[mesh] = renderDevice.CreateBuffer(vertexDescription, nullptr);
+		indexBuffers[mesh] = renderDevice.CreateBuffer(indexDescription, nullptr);
+	}
+
+	FBufferDesc constantDescription;
+	constantDescription.Binding = EBufferBinding::Constant;
+	constantDescription.ByteWidth = 64;
+	FBufferHandle applicationConstants = renderDevice.CreateBuffer(constantDescription, nullptr);
+	FBufferHandle frameConstants = renderDevice.CreateBuffer(constantDescription, nullptr);
+
+	// Objects in random order, the way a scene traversal or culling produces them. A tenth of them is
+	// translucent.
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> pickPipeline(0, pipelineCount - 1);
+	std::uniform_int_distribution<uint32_t> pickMesh(0, meshCount - 1);
+	std::uniform_real_distribution<float> pickDepth(1.0f, 100.0f);
+	std::uniform_int_distribution<uint32_t> pickTranslucent(0, 9);
+
+	std::vector<FDrawItem> items(drawCount);
+	std::vector<uint64_t> keys(drawCount);
+	for (uint32_t i = 0; i < drawCount; ++i)
+	{
+		uint32_t pipeline = pickPipeline(random);
+		uint32_t mesh = pickMesh(random);
+
+		FDrawItem& item = items[i];
+		item.Pipeline = pipelines[pipeline];
+		item.VertexBuffers[0] = vertexBuffers[mesh];
+		item.VertexStrides[0] = 24;
+		item.IndexBuffer = indexBuffers[mesh];
+		item.ConstantBuffers[0].Buffer = applicationConstants;
+		item.ConstantBuffers[1].Buffer = frameConstants;
+		item.IndexCount = 36;
+
+		FDrawSortKeyFields fields;
+		fields.Translucent = pickTranslucent(random) == 0;
+		fields.Pipeline = pipeline;
+		fields.Material = mesh;
+		fields.Depth = QuantizeDrawDepth(pickDepth(random), 0.1f, 100.0f);
+		keys[i] = MakeDrawSortKey(fields);
+	}
+
+	FDrawList drawList;
+	for (uint32_t i = 0; i < drawCount; ++i)
+	{
+		drawList.Add(keys[i], items[i]);
+	}
+
+	// A bind on the headless device is a few stores, a driver validates and records every one of them,
+	// so the state change counts are what carries over to a GPU rather than the times.
+	printf("Submitting %u draws of %u pipelines and %u meshes, median of %u frames, %u job threads\n\n",
+		drawCount, pipelineCount, meshCount, repeats, jobSystem.GetConcurrency());
+	printf("%-26s %12s %10s %14s %12s\n", "path", "median ms", "draws", "state changes", "redundant");
+
+	// Binds everything every draw, as the engine did before the draw list.
+	double milliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		for (const FDrawItem& item : items)
+		{
+			renderDevice.SetVertexShader(item.Pipeline.VertexShader);
+			renderDevice.SetPixelShader(item.Pipeline.PixelShader);
+			renderDevice.SetInputLayout(item.Pipeline.InputLayout);
+			renderDevice.SetRasterizerState(item.Pipeline.RasterizerState);
+			renderDevice.SetDepthStencilState(item.Pipeline.DepthStencilState);
+			renderDevice.SetVertexBuffer(0, item.VertexBuffers[0], item.VertexStrides[0], 0);
+			renderDevice.SetIndexBuffer(item.IndexBuffer, item.IndexFormat, 0);
+			renderDevice.SetConstantBuffer(EShaderStage::Vertex, 0, item.ConstantBuffers[0].Buffer);
+			renderDevice.SetConstantBuffer(EShaderStage::Vertex, 1, item.ConstantBuffers[1].Buffer);
+			renderDevice.DrawIndexed(item.IndexCount, item.StartIndex, item.BaseVertex);
+		}
+
+		renderDevice.Present(false);
+	});
+
+	FRenderDeviceStats naiveStats = renderDevice.GetLastFrameStats();
+	PrintRow("unsorted, bind everything", milliseconds, naiveStats);
+
+	milliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		drawList.Submit(&renderDevice);
+		renderDevice.Present(false);
+	});
+	PrintRow("sorted, filtered", milliseconds, renderDevice.GetLastFrameStats());
+
+	milliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		drawList.Submit(&renderDevice, &jobSystem);
+		renderDevice.Present(false);
+	});
+
+	FRenderDeviceStats sortedStats = renderDevice.GetLastFrameStats();
+	PrintRow("sorted, filtered, parallel", milliseconds, sortedStats);
+
+	const FDrawListStats& listStats = drawList.GetLastSubmitStats();
+	printf("\nState changes avoided per frame: %llu (%llu binds skipped by the draw list, %u radix passes)\n",
+		static_cast<unsigned long long>(naiveStats.StateChanges - sortedStats.StateChanges),
+		static_cast<unsigned long long>(listStats.RedundantBindsSkipped), listStats.SortPasses);
+
+	// The sort on its own, against the standard library.
+	FRadixSorter sorter;
+	std::vector<uint64_t> sortKeys(drawCount);
+	std::vector<uint32_t> sortValues(drawCount);
+	std::vector<std::pair<uint64_t, uint32_t>> pairs(drawCount);
+
+	auto resetKeys = [&]()
+	{
+		for (uint32_t i = 0; i < drawCount; ++i)
+		{
+			sortKeys[i] = keys[i];
+			sortValues[i] = i;
+		}
+	};
+
+	printf("\n%-26s %12s\n", "sort", "median ms");
+
+	milliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		for (uint32_t i = 0; i < drawCount; ++i)
+		{
+			pairs[i] = std::make_pair(keys[i], i);
+		}
+
+		std::sort(pairs.begin(), pairs.end());
+	});
+	printf("%-26s %12.3f\n", "std::sort", milliseconds);
+
+	milliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		resetKeys();
+		sorter.Sort(sortKeys.data(), sortValues.data(), drawCount);
+	});
+	printf("%-26s %12.3f\n", "radix, 1 thread", milliseconds);
+
+	milliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		resetKeys();
+		sorter.Sort(sortKeys.data(), sortValues.data(), drawCount, &jobSystem);
+	});
+
+	char name[64];
+	snprintf(name, sizeof(name), "radix, %u threads", jobSystem.GetConcurrency());
+	printf("%-26s %12.3f\n", name, milliseconds);
+
+	return 0;
+}
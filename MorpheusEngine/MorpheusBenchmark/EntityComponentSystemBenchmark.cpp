@@ -0,0 +1,380 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "BoundingVolumeHierarchy.h"
+#include "EntityComponentSystem.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct FPosition
+	{
+		FFloat3 Value;
+	};
+
+	struct FVelocity
+	{
+		FFloat3 Value;
+	};
+
+	struct FLifetime
+	{
+		float Seconds;
+	};
+
+	struct FWorldBounds
+	{
+		FBoundingBox Box;
+	};
+
+	// Tag of entities the movement query skips.
+	struct FFrozen
+	{
+	};
+
+	const float TimeStep = 1.0f / 60.0f;
+	const float Gravity = -9.81f;
+	const float Radius = 0.5f;
+
+	// One step of the particle system both paths run, so they end up with the same numbers.
+	inline void Integrate(FPosition& position, FVelocity& velocity, FLifetime& lifetime, FWorldBounds& bounds)
+	{
+		velocity.Value.Y += Gravity * TimeStep;
+		position.Value.X += velocity.Value.X * TimeStep;
+		position.Value.Y += velocity.Value.Y * TimeStep;
+		position.Value.Z += velocity.Value.Z * TimeStep;
+		lifetime.Seconds -= TimeStep;
+
+		bounds.Box.Min = { position.Value.X - Radius, position.Value.Y - Radius, position.Value.Z - Radius };
+		bounds.Box.Max = { position.Value.X + Radius, position.Value.Y + Radius, position.Value.Z + Radius };
+	}
+
+	// The per-object layout the component system replaces: every object its own heap allocation behind
+	// a virtual update, with the state nothing in the loop reads in between.
+	class FGameObject
+	{
+	public:
+		virtual ~FGameObject()
+		{
+		}
+
+		virtual void Update()
+		{
+			Integrate(Position, Velocity, Lifetime, Bounds);
+		}
+
+		std::string Name;
+		FFloat4x4 WorldMatrix;
+		FPosition Position;
+		FVelocity Velocity;
+		FLifetime Lifetime;
+		FWorldBounds Bounds;
+		void* Mesh = nullptr;
+		void* Material = nullptr;
+	};
+
+	bool IsClose(const FFloat3& a, const FFloat3& b)
+	{
+		auto close = [](float x, float y)
+		{
+			return std::fabs(x - y) <= 1e-4f * std::max(1.0f, std::fabs(x));
+		};
+
+		return close(a.X, b.X) && close(a.Y, b.Y) && close(a.Z, b.Z);
+	}
+}
+
+int RunEntityComponentSystemBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t entityCount = 1000000;
+	uint32_t spawnCount = 100000;
+	uint32_t repeats = 11;
+	uint32_t threads = 0;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "entities", entityCount) &&
+			!ParseOption(arguments[i], "spawn", spawnCount) &&
+			!ParseOption(arguments[i], "repeats", repeats) &&
+			!ParseOption(arguments[i], "threads", threads))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	entityCount = std::max(1u, entityCount);
+	spawnCount = std::max(1u, spawnCount);
+	repeats = std::max(1u, repeats);
+
+	uint32_t failures = 0;
+	auto fail = [&failures](const char* message)
+	{
+		fprintf(stderr, "FAILED: %s\n", message);
+		++failures;
+	};
+
+	FJobSystem jobSystem(threads);
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> speed(-5.0f, 5.0f);
+
+	// Both paths start from the same state. Objects are updated in a shuffled order, as they would be
+	// once a level has been streamed in and out a few times.
+	FEntityWorld world;
+	std::vector<FEntity> entities(entityCount);
+	std::vector<std::unique_ptr<FGameObject>> objects(entityCount);
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		FPosition position = { { coordinate(random), coordinate(random), coordinate(random) } };
+		FVelocity velocity = { { speed(random), speed(random), speed(random) } };
+		FLifetime lifetime = { 1000.0f };
+		FWorldBounds bounds = {};
+
+		entities[i] = world.CreateEntity(position, velocity, lifetime, bounds);
+
+		objects[i] = std::make_unique<FGameObject>();
+		objects[i]->Position = position;
+		objects[i]->Velocity = velocity;
+		objects[i]->Lifetime = lifetime;
+		objects[i]->Bounds = bounds;
+	}
+
+	std::vector<FGameObject*> updateOrder(entityCount);
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		updateOrder[i] = objects[i].get();
+	}
+	std::shuffle(updateOrder.begin(), updateOrder.end(), random);
+
+	const FComponentMask movingMask = GetComponentMask<FPosition, FVelocity, FLifetime, FWorldBounds>();
+	FEntityQuery& moving = world.GetQuery(movingMask, GetComponentMask<FFrozen>());
+
+	auto updateEntities = [&](FJobSystem* jobs)
+	{
+		world.ForEach<FPosition, FVelocity, FLifetime, FWorldBounds>(moving, [](FEntity, FPosition& position, FVelocity& velocity, FLifetime& lifetime, FWorldBounds& bounds)
+		{
+			Integrate(position, velocity, lifetime, bounds);
+		}, jobs);
+	};
+
+	uint32_t objectSteps = 0;
+	uint32_t entitySteps = 0;
+
+	const uint32_t capacity = world.GetChunkCapacity(movingMask);
+	printf("%u entities of 4 components, %u per %u byte chunk, %u chunks, median of %u runs\n\n", entityCount, capacity, FEntityWorld::ChunkSize,
+		world.GetStats().Chunks, repeats);
+	printf("%-28s %12s %16s %10s\n", "path", "median ms", "entities per us", "speedup");
+
+	double objectMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		for (FGameObject* object : updateOrder)
+		{
+			object->Update();
+		}
+		++objectSteps;
+	});
+	printf("%-28s %12.3f %16.1f %9.2fx\n", "heap objects", objectMilliseconds, entityCount / (objectMilliseconds * 1000.0), 1.0);
+
+	double serialMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		updateEntities(nullptr);
+		++entitySteps;
+	});
+	printf("%-28s %12.3f %16.1f %9.2fx\n", "chunk query", serialMilliseconds, entityCount / (serialMilliseconds * 1000.0), objectMilliseconds / serialMilliseconds);
+
+	if (jobSystem.GetConcurrency() > 1)
+	{
+		double parallelMilliseconds = MeasureMilliseconds(repeats, [&]()
+		{
+			updateEntities(&jobSystem);
+			++entitySteps;
+		});
+
+		char name[64];
+		snprintf(name, sizeof(name), "chunk query, %u threads", jobSystem.GetConcurrency());
+		printf("%-28s %12.3f %16.1f %9.2fx\n", name, parallelMilliseconds, entityCount / (parallelMilliseconds * 1000.0), objectMilliseconds / parallelMilliseconds);
+	}
+
+	// Catch the objects up, then every entity must match its object.
+	while (objectSteps < entitySteps)
+	{
+		for (FGameObject* object : updateOrder)
+		{
+			object->Update();
+		}
+		++objectSteps;
+	}
+
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		const FPosition* position = world.GetComponent<FPosition>(entities[i]);
+		const FWorldBounds* bounds = world.GetComponent<FWorldBounds>(entities[i]);
+		if (!position || !bounds || !IsClose(position->Value, objects[i]->Position.Value) || !IsClose(bounds->Box.Max, objects[i]->Bounds.Box.Max))
+		{
+			++mismatches;
+		}
+	}
+
+	if (mismatches > 0)
+	{
+		fail("the entities do not match the objects they were copied from");
+	}
+
+	if (capacity * (sizeof(FEntity) + sizeof(FPosition) + sizeof(FVelocity) + sizeof(FLifetime) + sizeof(FWorldBounds)) > FEntityWorld::ChunkSize)
+	{
+		fail("a chunk holds more than fits");
+	}
+
+	// Particles that expire are destroyed and respawned through one command buffer per thread, which is
+	// played back once the query is done.
+	{
+		FEntityWorld particles;
+		std::uniform_real_distribution<float> lifetime(0.0f, 2.0f);
+
+		for (uint32_t i = 0; i < spawnCount; ++i)
+		{
+			particles.CreateEntity(FPosition{ { coordinate(random), coordinate(random), coordinate(random) } }, FVelocity{ { speed(random), speed(random), speed(random) } },
+				FLifetime{ lifetime(random) }, FWorldBounds{});
+		}
+
+		std::vector<FEntityCommandBuffer> commandBuffers(jobSystem.GetConcurrency());
+		FEntityQuery& alive = particles.GetQuery(movingMask);
+
+		uint32_t frame = 0;
+		uint32_t expired = 0;
+		uint32_t expiredAlive = 0;
+		std::vector<double> samples;
+
+		auto step = [&]()
+		{
+			particles.ForEach<FPosition, FVelocity, FLifetime, FWorldBounds>(alive, [&](FEntity entity, FPosition& position, FVelocity& velocity, FLifetime& life, FWorldBounds& bounds)
+			{
+				Integrate(position, velocity, life, bounds);
+
+				if (life.Seconds <= 0.0f)
+				{
+					// Respawned from the handle rather than a shared generator, which the jobs would race on.
+					uint32_t seed = entity.Index * 2654435761u + frame;
+					FEntityCommandBuffer& commands = commandBuffers[jobSystem.GetCurrentWorkerIndex()];
+					commands.DestroyEntity(entity);
+					commands.CreateEntity(FPosition{ { 0.0f, 0.0f, 0.0f } }, FVelocity{ { static_cast<float>(seed % 11) - 5.0f, 10.0f, static_cast<float>(seed % 7) - 3.0f } },
+						FLifetime{ 0.5f + static_cast<float>(seed % 64) / 32.0f }, FWorldBounds{});
+				}
+			}, &jobSystem);
+
+			for (FEntityCommandBuffer& commands : commandBuffers)
+			{
+				expired += commands.GetCommandCount() / 2;
+				commands.Playback(particles);
+			}
+
+			++frame;
+		};
+
+		for (uint32_t i = 0; i < 120; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			step();
+			auto end = std::chrono::steady_clock::now();
+
+			samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		particles.ForEach<FLifetime>(alive, [&expiredAlive](FEntity, FLifetime& life)
+		{
+			expiredAlive += life.Seconds <= 0.0f ? 1 : 0;
+		});
+
+		printf("\n%u particles, %u expired and respawned over %u frames, median frame %.3f ms, %llu entities moved between archetypes\n",
+			particles.GetStats().Entities, expired, frame, Median(samples), static_cast<unsigned long long>(particles.GetStats().EntitiesMoved));
+
+		if (particles.GetStats().Entities != spawnCount)
+		{
+			fail("respawning changed the number of particles");
+		}
+
+		if (expired == 0 || expiredAlive > 0)
+		{
+			fail("expired particles were not destroyed");
+		}
+	}
+
+	// Handles, queries that pick up new archetypes and deferred component changes.
+	{
+		FEntityWorld small;
+		std::vector<FEntity> smallEntities;
+		for (uint32_t i = 0; i < 1000; ++i)
+		{
+			smallEntities.push_back(small.CreateEntity(FPosition{ { static_cast<float>(i), 0.0f, 0.0f } }, FVelocity{ { 1.0f, 0.0f, 0.0f } }));
+		}
+
+		FEntityQuery& movable = small.GetQuery(GetComponentMask<FPosition, FVelocity>(), GetComponentMask<FFrozen>());
+		if (&movable != &small.GetQuery(GetComponentMask<FPosition, FVelocity>(), GetComponentMask<FFrozen>()))
+		{
+			fail("the same masks gave a second query");
+		}
+
+		auto countMatches = [&small](FEntityQuery& query)
+		{
+			uint32_t count = 0;
+			small.ForEachChunk(query, [&count](const FEntityChunk& chunk)
+			{
+				count += chunk.GetCount();
+			});
+			return count;
+		};
+
+		uint32_t before = countMatches(movable);
+
+		FEntityCommandBuffer commands;
+		for (uint32_t i = 0; i < 1000; i += 10)
+		{
+			commands.AddComponent(smallEntities[i], FFrozen());
+			commands.AddComponent(smallEntities[i + 1], FLifetime{ 5.0f });
+		}
+		commands.DestroyEntity(smallEntities[2]);
+		commands.Playback(small);
+
+		uint32_t after = countMatches(movable);
+		uint32_t frozen = countMatches(small.GetQuery(GetComponentMask<FFrozen>()));
+
+		FEntity reused = small.CreateEntity(FPosition{ { -1.0f, 0.0f, 0.0f } });
+		const FPosition* kept = small.GetComponent<FPosition>(smallEntities[11]);
+
+		printf("\nQuery matches %u entities, %u once 100 are frozen and one destroyed, %u archetypes\n", before, after, small.GetStats().Archetypes);
+
+		if (before != 1000 || after != 899 || frozen != 100)
+		{
+			fail("a query did not follow the archetypes entities moved to");
+		}
+
+		if (small.IsAlive(smallEntities[2]) || reused.Index != smallEntities[2].Index || reused == smallEntities[2])
+		{
+			fail("a destroyed handle was not told apart from the entity reusing its slot");
+		}
+
+		if (!kept || kept->Value.X != 11.0f || !small.HasComponent<FLifetime>(smallEntities[11]) || small.HasComponent<FFrozen>(smallEntities[11]))
+		{
+			fail("moving an entity to another archetype lost its components");
+		}
+	}
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "%u checks failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
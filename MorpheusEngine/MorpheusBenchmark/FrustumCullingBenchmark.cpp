@@ -0,0 +1,154 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// The per-object layout the SoA streams replace.
+	struct FObjectBounds
+	{
+		FFloat3 Centre;
+		FFloat3 Extents;
+		float Radius;
+	};
+
+	FFloat4x4 PerspectiveLookAt(float aspectRatio)
+	{
+		// XMMatrixLookAtLH from (0, 0, -10) towards the origin, times XMMatrixPerspectiveFovLH(45 degrees, 0.1, 100).
+		const float nearPlane = 0.1f;
+		const float farPlane = 100.0f;
+		float yScale = 1.0f / std::tan(0.5f * 45.0f * 3.14159265f / 180.0f);
+		float range = farPlane / (farPlane - nearPlane);
+
+		FFloat4x4 viewProjection = {};
+		viewProjection.M[0][0] = yScale / aspectRatio;
+		viewProjection.M[1][1] = yScale;
+		viewProjection.M[2][2] = range;
+		viewProjection.M[2][3] = 1.0f;
+		viewProjection.M[3][2] = 10.0f * range - range * nearPlane;
+		viewProjection.M[3][3] = 10.0f;
+
+		return viewProjection;
+	}
+}
+
+int RunFrustumCullingBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t objectCount = 1000000;
+	uint32_t repeats = 21;
+	uint32_t threads = 0;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "objects", objectCount) &&
+			!ParseOption(arguments[i], "repeats", repeats) &&
+			!ParseOption(arguments[i], "threads", threads))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	objectCount = std::max(1u, objectCount);
+	repeats = std::max(1u, repeats);
+
+	// Objects spread around the camera so that a few percent are in view, like an open level.
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 3.0f);
+
+	std::vector<FObjectBounds> objects(objectCount);
+	FBoundsSoA bounds;
+	bounds.Resize(objectCount);
+
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		FFloat3 centre = { position(random), 0.3f * position(random), position(random) };
+		FFloat3 extents = { extent(random), extent(random), extent(random) };
+
+		bounds.SetBox(i, centre, extents);
+		objects[i] = { centre, extents, bounds.Radius[i] };
+	}
+
+	FFrustum frustum = FrustumFromViewProjection(PerspectiveLookAt(16.0f / 9.0f));
+	std::vector<uint32_t> visibleIndices(objectCount + CullOutputPadding);
+	uint32_t visibleCount = 0;
+
+	printf("Frustum culling of %u boxes with bounding spheres, median of %u runs\n\n", objectCount, repeats);
+	printf("%-28s %12s %12s %10s %10s\n", "path", "median ms", "ns/object", "speedup", "visible");
+
+	double referenceMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		visibleCount = 0;
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			const FObjectBounds& object = objects[i];
+
+			bool outside = false;
+			for (const FPlane& plane : frustum.Planes)
+			{
+				float distance = plane.X * object.Centre.X + plane.Y * object.Centre.Y + plane.Z * object.Centre.Z + plane.W;
+				float boxRadius = std::fabs(plane.X) * object.Extents.X + std::fabs(plane.Y) * object.Extents.Y + std::fabs(plane.Z) * object.Extents.Z;
+				if (distance < -std::min(object.Radius, boxRadius))
+				{
+					outside = true;
+					break;
+				}
+			}
+
+			if (!outside)
+			{
+				visibleIndices[visibleCount++] = i;
+			}
+		}
+	});
+
+	printf("%-28s %12.3f %12.2f %9.2fx %10u\n", "per-object early out", referenceMilliseconds, referenceMilliseconds * 1e6 / objectCount, 1.0, visibleCount);
+
+	const EMathBackend previousBackend = GetMathBackend();
+	const EMathBackend backends[] = { EMathBackend::Scalar, EMathBackend::SSE, EMathBackend::AVX2, EMathBackend::NEON };
+
+	for (EMathBackend backend : backends)
+	{
+		if (!IsMathBackendSupported(backend))
+		{
+			continue;
+		}
+
+		SetMathBackend(backend);
+
+		double milliseconds = MeasureMilliseconds(repeats, [&]()
+		{
+			visibleCount = CullBounds(bounds, 0, objectCount, frustum, visibleIndices.data());
+		});
+
+		char name[64];
+		snprintf(name, sizeof(name), "SoA %s", GetMathBackendName(backend));
+		printf("%-28s %12.3f %12.2f %9.2fx %10u\n", name, milliseconds, milliseconds * 1e6 / objectCount, referenceMilliseconds / milliseconds, visibleCount);
+	}
+
+	SetMathBackend(previousBackend);
+
+	FJobSystem jobSystem(threads);
+	FFrustumCuller culler;
+	std::vector<uint32_t> parallelIndices;
+
+	double milliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		visibleCount = culler.Cull(bounds, frustum, parallelIndices, &jobSystem);
+	});
+
+	char name[64];
+	snprintf(name, sizeof(name), "SoA %s, %u threads", GetMathBackendName(GetMathBackend()), jobSystem.GetConcurrency());
+	printf("%-28s %12.3f %12.2f %9.2fx %10u\n", name, milliseconds, milliseconds * 1e6 / objectCount, referenceMilliseconds / milliseconds, visibleCount);
+
+	return 0;
+}
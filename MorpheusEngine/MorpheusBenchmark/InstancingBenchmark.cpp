@@ -0,0 +1,193 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+#include "CubeScene.h"
+
+#include "ConstantBufferRing.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "SoftwareRenderDevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	// The demo frame both ways on the software device, at a size that keeps the check quick.
+	const uint32_t ImageWidth = 640;
+	const uint32_t ImageHeight = 360;
+	const uint32_t ImageGridSide = 32;
+
+	void PrintRow(const char* name, double milliseconds, const FRenderDeviceStats& stats)
+	{
+		printf("%-24s %12.3f %10llu %10llu %12llu %10llu\n", name, milliseconds,
+			static_cast<unsigned long long>(stats.DrawCalls), static_cast<unsigned long long>(stats.StateChanges),
+			static_cast<unsigned long long>(stats.InstancesSubmitted), static_cast<unsigned long long>(stats.BufferMaps));
+	}
+}
+
+int RunInstancingBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t objectCount = 100000;
+	uint32_t frames = 31;
+	uint32_t threads = 0;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "objects", objectCount) &&
+			!ParseOption(arguments[i], "frames", frames) &&
+			!ParseOption(arguments[i], "threads", threads))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	objectCount = std::max(1u, objectCount);
+	frames = std::max(1u, frames);
+
+	std::vector<FFloat4x4> worldMatrices(objectCount);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		FFloat4x4& world = worldMatrices[i];
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				world.M[row][column] = (row == column) ? 1.0f : 0.0f;
+			}
+		}
+
+		world.M[3][0] = static_cast<float>(i % 256);
+		world.M[3][1] = static_cast<float>(i / 256);
+	}
+
+	// Only the engine side is measured. The per-object path also costs a driver call per bind and
+	// draw, which is what the draw and state change counts stand for.
+	FNullRenderDevice renderDevice(false);
+	FJobSystem jobSystem(threads);
+
+	FConstantBufferRing ring(&renderDevice);
+	FInstanceBuffer instanceBuffer(&renderDevice, objectCount);
+	if (!instanceBuffer.IsValid())
+	{
+		fprintf(stderr, "Failed to create the instance buffer\n");
+		return 1;
+	}
+
+	const uint32_t indexCount = 36;
+
+	auto measure = [&](int path, FRenderDeviceStats& frameStats)
+	{
+		std::vector<double> samples;
+
+		for (uint32_t frame = 0; frame <= frames; ++frame)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			if (path == 0)
+			{
+				// One constant buffer slice, bind and draw per object.
+				ring.BeginFrame();
+				for (uint32_t i = 0; i < objectCount; ++i)
+				{
+					FConstantBufferAllocation allocation = ring.Upload(&worldMatrices[i], sizeof(FFloat4x4));
+					renderDevice.SetConstantBufferRange(EShaderStage::Vertex, 2, allocation.Buffer, allocation.Offset, allocation.Size);
+					renderDevice.DrawIndexed(indexCount, 0, 0);
+				}
+				ring.EndFrame();
+			}
+			else
+			{
+				instanceBuffer.Upload(worldMatrices.data(), objectCount, path == 2 ? &jobSystem : nullptr);
+				instanceBuffer.Bind(1);
+				instanceBuffer.Draw(indexCount, 0, 0, 0, instanceBuffer.GetInstanceCount());
+			}
+
+			auto end = std::chrono::steady_clock::now();
+			renderDevice.Present(false);
+
+			// The first frame creates the ring pages and is not measured.
+			if (frame > 0)
+			{
+				samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			}
+		}
+
+		frameStats = renderDevice.GetLastFrameStats();
+
+		return Median(samples);
+	};
+
+	printf("Drawing %u cubes, median of %u frames, %u job threads\n\n", objectCount, frames, jobSystem.GetConcurrency());
+	printf("%-24s %12s %10s %10s %12s %10s\n", "path", "median ms", "draws", "binds", "instances", "maps");
+
+	FRenderDeviceStats stats;
+	double milliseconds = measure(0, stats);
+	PrintRow("draw per object", milliseconds, stats);
+
+	milliseconds = measure(1, stats);
+	PrintRow("instanced", milliseconds, stats);
+
+	milliseconds = measure(2, stats);
+	PrintRow("instanced, parallel pack", milliseconds, stats);
+
+	printf("\nInstance stream: %u bytes per instance, %llu bytes per frame\n", static_cast<uint32_t>(sizeof(FInstanceTransform)),
+		static_cast<unsigned long long>(sizeof(FInstanceTransform)) * instanceBuffer.GetInstanceCount());
+
+	uint32_t failures = 0;
+
+	// Drawing the wall with one instanced draw must give the image of one draw per cube.
+	{
+		FSoftwareRenderDevice softwareDevice(ImageWidth, ImageHeight, &jobSystem);
+		FConstantBufferRing softwareRing(&softwareDevice);
+
+		FCubeScene scene;
+		BuildCubeScene(scene, ImageWidth, ImageHeight, ImageGridSide);
+
+		FInstanceBuffer sceneInstances(&softwareDevice, static_cast<uint32_t>(scene.WorldMatrices.size() - 1));
+		FCubeResources resources;
+		if (!sceneInstances.IsValid() || !CreateCubeResources(softwareDevice, scene, resources))
+		{
+			fprintf(stderr, "Failed to create the software device resources\n");
+			return 1;
+		}
+
+		RenderCubeScene(softwareDevice, softwareRing, resources, scene);
+		std::vector<uint32_t> perObjectImage(softwareDevice.GetColourBuffer(), softwareDevice.GetColourBuffer() + softwareDevice.GetPitch() * ImageHeight);
+		FSoftwareRasterizerStats perObjectStats = softwareDevice.GetLastFrameRasterizerStats();
+
+		RenderCubeSceneInstanced(softwareDevice, softwareRing, sceneInstances, resources, scene);
+		const FSoftwareRasterizerStats& instancedStats = softwareDevice.GetLastFrameRasterizerStats();
+
+		uint32_t differentPixels = 0;
+		for (uint32_t y = 0; y < ImageHeight; ++y)
+		{
+			for (uint32_t x = 0; x < ImageWidth; ++x)
+			{
+				size_t texel = static_cast<size_t>(y) * softwareDevice.GetPitch() + x;
+				differentPixels += perObjectImage[texel] != softwareDevice.GetColourBuffer()[texel] ? 1 : 0;
+			}
+		}
+
+		printf("\nSoftware device at %ux%u: %llu pixels per object, %llu instanced, %u differ\n", ImageWidth, ImageHeight,
+			static_cast<unsigned long long>(perObjectStats.PixelsWritten), static_cast<unsigned long long>(instancedStats.PixelsWritten), differentPixels);
+
+		if (perObjectStats.SkippedDraws > 0 || instancedStats.SkippedDraws > 0 || perObjectStats.PixelsWritten == 0)
+		{
+			fprintf(stderr, "FAILED: the software device skipped draws\n");
+			++failures;
+		}
+		if (differentPixels > 0)
+		{
+			fprintf(stderr, "FAILED: the instanced image differs from the per-object image\n");
+			++failures;
+		}
+
+		DestroyCubeResources(softwareDevice, resources);
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct FTransform
+	{
+		float Position[3];
+		float Rotation[4];
+		float Scale[3];
+	};
+
+	struct FWorkload
+	{
+		const FTransform* Transforms;
+		const float* ParentMatrix;
+		float* WorldMatrices;
+	};
+
+	// Builds the local matrix of a scale, rotation and translation and concatenates it with the parent,
+	// the same per-object work an update pass does.
+	void ComputeWorldMatrices(const FWorkload& workload, uint32_t begin, uint32_t end)
+	{
+		const float* parent = workload.ParentMatrix;
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const FTransform& transform = workload.Transforms[i];
+			float x = transform.Rotation[0], y = transform.Rotation[1], z = transform.Rotation[2], w = transform.Rotation[3];
+
+			float local[16] =
+			{
+				(1.0f - 2.0f * (y * y + z * z)) * transform.Scale[0], 2.0f * (x * y + z * w) * transform.Scale[0], 2.0f * (x * z - y * w) * transform.Scale[0], 0.0f,
+				2.0f * (x * y - z * w) * transform.Scale[1], (1.0f - 2.0f * (x * x + z * z)) * transform.Scale[1], 2.0f * (y * z + x * w) * transform.Scale[1], 0.0f,
+				2.0f * (x * z + y * w) * transform.Scale[2], 2.0f * (y * z - x * w) * transform.Scale[2], (1.0f - 2.0f * (x * x + y * y)) * transform.Scale[2], 0.0f,
+				transform.Position[0], transform.Position[1], transform.Position[2], 1.0f
+			};
+
+			float* world = workload.WorldMatrices + i * 16;
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int column = 0; column < 4; ++column)
+				{
+					world[row * 4 + column] =
+						local[row * 4 + 0] * parent[0 * 4 + column] +
+						local[row * 4 + 1] * parent[1 * 4 + column] +
+						local[row * 4 + 2] * parent[2 * 4 + column] +
+						local[row * 4 + 3] * parent[3 * 4 + column];
+				}
+			}
+		}
+	}
+
+}
+
+int RunJobSystemBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t transformCount = 1000000;
+	uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t repeats = 11;
+	uint32_t batchSize = 0;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "transforms", transformCount) &&
+			!ParseOption(arguments[i], "threads", maxThreads) &&
+			!ParseOption(arguments[i], "repeats", repeats) &&
+			!ParseOption(arguments[i], "batch", batchSize))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	transformCount = std::max(1u, transformCount);
+	maxThreads = std::max(1u, maxThreads);
+	repeats = std::max(1u, repeats);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	std::vector<FTransform> transforms(transformCount);
+	for (FTransform& transform : transforms)
+	{
+		float rotation[4] = { component(random), component(random), component(random), component(random) };
+		float length = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+		length = std::max(length, 1e-3f);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			transform.Position[i] = position(random);
+			transform.Scale[i] = scale(random);
+		}
+
+		for (int i = 0; i < 4; ++i)
+		{
+			transform.Rotation[i] = rotation[i] / length;
+		}
+	}
+
+	const float parentMatrix[16] =
+	{
+		0.0f, 0.0f, -1.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		1.0f, 0.0f, 0.0f, 0.0f,
+		10.0f, 0.0f, -5.0f, 1.0f
+	};
+
+	std::vector<float> worldMatrices(static_cast<size_t>(transformCount) * 16);
+	FWorkload workload = { transforms.data(), parentMatrix, worldMatrices.data() };
+
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	printf("Job system scaling: %u transforms, median of %u runs\n\n", transformCount, repeats);
+	printf("%8s %12s %10s %11s %12s %12s\n", "threads", "median ms", "speedup", "efficiency", "jobs", "steals");
+
+	double singleThreadMilliseconds = 0.0;
+
+	for (uint32_t threads : threadCounts)
+	{
+		FJobSystem jobSystem(threads);
+
+		auto runOnce = [&]()
+		{
+			jobSystem.ParallelFor(transformCount, batchSize, [&workload](uint32_t begin, uint32_t end)
+			{
+				ComputeWorldMatrices(workload, begin, end);
+			});
+		};
+
+		// Warm up caches and let the workers spin up before measuring.
+		runOnce();
+		jobSystem.ResetStats();
+
+		std::vector<double> samples;
+		for (uint32_t repeat = 0; repeat < repeats; ++repeat)
+		{
+			auto start = std::chrono::steady_clock::now();
+			runOnce();
+			auto end = std::chrono::steady_clock::now();
+
+			samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		double milliseconds = Median(samples);
+		if (threads == 1)
+		{
+			singleThreadMilliseconds = milliseconds;
+		}
+
+		double speedup = singleThreadMilliseconds / milliseconds;
+		FJobSystemStats stats = jobSystem.GetStats();
+
+		printf("%8u %12.3f %9.2fx %10.1f%% %12llu %12llu\n", threads, milliseconds, speedup, 100.0 * speedup / threads,
+			static_cast<unsigned long long>(stats.JobsExecuted / repeats), static_cast<unsigned long long>(stats.JobsStolen / repeats));
+	}
+
+	// Keeps the compiler from discarding the work.
+	float checksum = 0.0f;
+	for (size_t i = 0; i < worldMatrices.size(); i += 16)
+	{
+		checksum += worldMatrices[i + 12];
+	}
+
+	printf("\nChecksum %f\n", checksum);
+
+	return 0;
+}
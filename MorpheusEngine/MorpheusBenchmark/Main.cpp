@@ -0,0 +1,109 @@
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct FBenchmark
+{
+	const char* Name;
+	FBenchmarkFunction Function;
+	const char* Description;
+};
+
+static const FBenchmark benchmarks[] =
+{
+	{ "bvh", RunBoundingVolumeHierarchyBenchmark, "Frustum, ray and box queries of the bounding volume hierarchy against flat culling and brute force. --objects= --moving= --queries= --repeats=" },
+	{ "commandlists", RunCommandListBenchmark, "Draw list recording split across per-thread command buffers and merged in order, from 1 to N threads, with a check that every thread count produces the same commands. --draws= --pipelines= --meshes= --lists= --threads= --repeats=" },
+	{ "compare", RunBenchmarkComparison, "Compares two suite reports and fails when a timing regressed past its threshold. <baseline.json> <current.json> --threshold= --metric=median|p99" },
+	{ "constants", RunConstantBufferBenchmark, "Constant buffer ring against one buffer update per object. --objects= --frames=" },
+	{ "culling", RunFrustumCullingBenchmark, "SIMD frustum culling of SoA bounds against a per-object test. --objects= --repeats= --threads=" },
+	{ "drawsort", RunDrawSortBenchmark, "Sorted draw list with redundant bind filtering against binding everything per draw. --draws= --pipelines= --meshes= --repeats= --threads=" },
+	{ "ecs", RunEntityComponentSystemBenchmark, "Archetype chunk queries over 4 components against per-object updates, serial and split across jobs, with particles respawned through command buffers. --entities= --spawn= --repeats= --threads=" },
+	{ "instancing", RunInstancingBenchmark, "Instanced draws from one per-instance stream against one draw per object, with a check that both render the same image on the software device. --objects= --frames= --threads=" },
+	{ "jobs", RunJobSystemBenchmark, "Job system scaling from 1 to N threads. --transforms= --threads= --repeats= --batch=" },
+	{ "memory", RunMemoryBenchmark, "Frame arenas, scratch arenas and pools against the heap, then headless frames that must not allocate once warm. --cubes= --frames= --warmup= --threads= --repeats=" },
+	{ "meshload", RunMeshLoadBenchmark, "Loading a memory-mapped mesh pack against reading it into memory and importing OBJ text. --megabytes= --repeats=" },
+	{ "meshopt", RunMeshOptimizerBenchmark, "Vertex cache, overdraw and vertex fetch reordering and meshlets of a shuffled sphere, with ACMR, ATVR and overfetch. --side= --repeats=" },
+	{ "occlusion", RunOcclusionCullingBenchmark, "Conservative occluder rasterization and hierarchical depth tests of frustum-culled boxes, per backend and thread count, checked against ray casts and a full resolution test. --objects= --occluders= --width= --height= --repeats= --threads=" },
+	{ "pipelinestates", RunPipelineStateBenchmark, "Hash-consed pipeline state cache against creating states per material, cold, warm and pre-warmed from a manifest. --materials= --shaders= --repeats=" },
+	{ "profiler", RunProfilerBenchmark, "Cost of a profile scope compiled in, disabled and recording, and of exporting a multi-threaded capture. --scopes= --threads= --repeats=" },
+	{ "rasterizer", RunRasterizerBenchmark, "The demo cube scene on the tiled software rasterizer, one draw per cube, with pixel throughput and a golden image hash. --width= --height= --grid= --frames= --threads= --output=" },
+	{ "rendergraph", RunRenderGraphBenchmark, "Builds, culls and aliases a deferred frame graph, checks the lifetimes and that resizes leave no textures behind. --width= --height= --frames=" },
+	{ "resources", RunResourcePoolBenchmark, "Generation-checked pool handle lookups against a shared_ptr copy per bind, with checks of stale handles, a full pool, fenced release and the leak report. --resources= --binds= --repeats=" },
+	{ "scenegraph", RunSceneGraphBenchmark, "Dirty-subtree scene graph update against recomputing every node. --nodes= --moving= --frames= --threads=" },
+	{ "shadercache", RunShaderCacheBenchmark, "Cold serial, cold parallel and warm compiles through the content-addressed shader cache, with a stub compiler. --shaders= --compile-us= --threads= --repeats=" },
+	{ "streaming", RunStreamingBenchmark, "A camera walking a row of pack meshes, loaded synchronously in the frame against streamed by priority with cancellation and an LRU memory budget, with time to first frame and worst frame. --meshes= --side= --budget-mb= --frames= --threads= --io-threads=" },
+	{ "suite", RunSuiteBenchmark, "Transforms, culling, draw sorting, constant uploads and whole frames of seeded synthetic scenes of 1k, 100k and 1M objects, as JSON. --objects= --seed= --samples= --threads= --output=" },
+	{ "transforms", RunTransformMathBenchmark, "Batched SoA transform kernels against the per-object path. --objects= --repeats=" },
+	{ "vertexformat", RunVertexFormatBenchmark, "Scalar and SSE encoding of quantised positions, octahedral normals and packed colours, with round trip errors. --vertices= --repeats=" },
+};
+
+static const char* FindOptionValue(const char* argument, const char* name)
+{
+	size_t nameLength = strlen(name);
+	if (strncmp(argument, "--", 2) != 0 || strncmp(argument + 2, name, nameLength) != 0 || argument[2 + nameLength] != '=')
+	{
+		return nullptr;
+	}
+
+	return argument + 3 + nameLength;
+}
+
+bool ParseOption(const char* argument, const char* name, uint32_t& value)
+{
+	const char* text = FindOptionValue(argument, name);
+	if (!text)
+	{
+		return false;
+	}
+
+	value = static_cast<uint32_t>(strtoul(text, nullptr, 10));
+
+	return true;
+}
+
+bool ParseOption(const char* argument, const char* name, std::string& value)
+{
+	const char* text = FindOptionValue(argument, name);
+	if (!text)
+	{
+		return false;
+	}
+
+	value = text;
+
+	return true;
+}
+
+static void PrintUsage()
+{
+	printf("Usage: MorpheusBenchmark <benchmark> [options]\n\n");
+
+	for (const FBenchmark& benchmark : benchmarks)
+	{
+		printf("  %-12s %s\n", benchmark.Name, benchmark.Description);
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if (argumentCount < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	for (const FBenchmark& benchmark : benchmarks)
+	{
+		if (strcmp(arguments[1], benchmark.Name) == 0)
+		{
+			return benchmark.Function(argumentCount - 2, arguments + 2);
+		}
+	}
+
+	fprintf(stderr, "Unknown benchmark '%s'\n\n", arguments[1]);
+	PrintUsage();
+
+	return 1;
+}
@@ -0,0 +1,369 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "BoundingVolumeHierarchy.h"
+#include "ConstantBufferRing.h"
+#include "DrawList.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+#include "MemoryArena.h"
+#include "NullRenderDevice.h"
+#include "PoolAllocator.h"
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Every plain and nothrow new and delete of the process goes through these, so the steady state frames
+// below can prove they leave the general heap alone. The nothrow forms matter: std::stable_sort takes
+// its buffer through them and frees it with the plain delete. The aligned forms are left to the library.
+namespace
+{
+	std::atomic<uint64_t> heapAllocationCount(0);
+}
+
+void* operator new(size_t size)
+{
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory = std::malloc(size > 0 ? size : 1);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	// XMMatrixPerspectiveFovLH(60 degrees, 16:9) looking along +z from the origin.
+	FFloat4x4 CameraViewProjection(float farPlane)
+	{
+		const float nearPlane = 0.1f;
+		float yScale = 1.0f / std::tan(0.5f * 60.0f * 3.14159265f / 180.0f);
+		float range = farPlane / (farPlane - nearPlane);
+
+		FFloat4x4 viewProjection = {};
+		viewProjection.M[0][0] = yScale * 9.0f / 16.0f;
+		viewProjection.M[1][1] = yScale;
+		viewProjection.M[2][2] = range;
+		viewProjection.M[2][3] = 1.0f;
+		viewProjection.M[3][2] = -range * nearPlane;
+
+		return viewProjection;
+	}
+
+	// Small engine object of the kind that is created and destroyed many times a frame.
+	struct FTransientEvent
+	{
+		uint32_t Type;
+		uint32_t Target;
+		float Values[6];
+	};
+
+	void PrintStats(const char* name, const FAllocatorStats& stats)
+	{
+		printf("%-24s %12llu %14llu %10llu %12llu %12llu\n", name, static_cast<unsigned long long>(stats.Allocations),
+			static_cast<unsigned long long>(stats.BytesAllocated), static_cast<unsigned long long>(stats.HeapAllocations),
+			static_cast<unsigned long long>(stats.HeapBytes), static_cast<unsigned long long>(stats.PeakBytes));
+	}
+}
+
+int RunMemoryBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t cubeCount = 16384;
+	uint32_t frames = 240;
+	uint32_t warmupFrames = 8;
+	uint32_t threads = 0;
+	uint32_t repeats = 15;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "cubes", cubeCount) &&
+			!ParseOption(arguments[i], "frames", frames) &&
+			!ParseOption(arguments[i], "warmup", warmupFrames) &&
+			!ParseOption(arguments[i], "threads", threads) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	cubeCount = std::max(1u, cubeCount);
+	frames = std::max(1u, frames);
+	warmupFrames = std::max(1u, warmupFrames);
+
+	// Allocator throughput against the general heap.
+	const uint32_t allocationCount = 100000;
+	std::vector<void*> pointers(allocationCount);
+
+	printf("Allocating %u small blocks, median of %u repeats\n\n", allocationCount, repeats);
+	printf("%-24s %12s %12s\n", "allocator", "median ms", "ns per block");
+
+	auto printRow = [&](const char* name, double milliseconds)
+	{
+		printf("%-24s %12.3f %12.2f\n", name, milliseconds, milliseconds * 1e6 / allocationCount);
+	};
+
+	printRow("heap new and delete", MeasureMilliseconds(repeats, [&]()
+	{
+		for (uint32_t i = 0; i < allocationCount; ++i)
+		{
+			pointers[i] = new FTransientEvent();
+		}
+		for (uint32_t i = 0; i < allocationCount; ++i)
+		{
+			delete static_cast<FTransientEvent*>(pointers[i]);
+		}
+	}));
+
+	TObjectPool<FTransientEvent> eventPool;
+	eventPool.GetPool().Reserve(allocationCount);
+	printRow("object pool", MeasureMilliseconds(repeats, [&]()
+	{
+		for (uint32_t i = 0; i < allocationCount; ++i)
+		{
+			pointers[i] = eventPool.New();
+		}
+		for (uint32_t i = 0; i < allocationCount; ++i)
+		{
+			eventPool.Delete(static_cast<FTransientEvent*>(pointers[i]));
+		}
+	}));
+
+	FLinearArena arena;
+	printRow("linear arena", MeasureMilliseconds(repeats, [&]()
+	{
+		arena.Reset();
+		for (uint32_t i = 0; i < allocationCount; ++i)
+		{
+			pointers[i] = arena.New<FTransientEvent>();
+		}
+	}));
+
+	// Headless frames shaped like the ones of the engine: transform update, culling, instance packing,
+	// constants and a sorted draw list. After the warm-up every frame is checked for heap allocations.
+	FJobSystem jobSystem(threads);
+	FNullRenderDevice renderDevice(false);
+	FConstantBufferRing constantBufferRing(&renderDevice);
+	FInstanceBuffer instanceBuffer(&renderDevice, cubeCount);
+	if (!instanceBuffer.IsValid())
+	{
+		fprintf(stderr, "Failed to create the instance buffer\n");
+		return 1;
+	}
+
+	FBufferDesc vertexBufferDescription;
+	vertexBufferDescription.Binding = EBufferBinding::Vertex;
+	vertexBufferDescription.ByteWidth = 24 * 16;
+	FBufferHandle vertexBuffer = renderDevice.CreateBuffer(vertexBufferDescription, nullptr);
+
+	// The grid turns about the view axis and stays entirely in view, so every frame is the same size.
+	uint32_t cubesPerSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(cubeCount))));
+	float gridDistance = 1.5f * static_cast<float>(cubesPerSide) + 5.0f;
+	FFrustum frustum = FrustumFromViewProjection(CameraViewProjection(2.0f * gridDistance + 10.0f));
+
+	FSceneGraph sceneGraph;
+	FSceneNodeHandle gridNode = sceneGraph.CreateNode();
+	sceneGraph.SetLocalPosition(gridNode, { 0.0f, 0.0f, gridDistance });
+
+	FBoundingBox cubeBounds = { { -0.4f, -0.4f, -0.4f }, { 0.4f, 0.4f, 0.4f } };
+	FBoundingVolumeHierarchy bounds;
+	std::vector<FSceneNodeHandle> cubeNodes(cubeCount);
+	std::vector<FBvhProxyHandle> cubeProxies(cubeCount);
+	for (uint32_t i = 0; i < cubeCount; ++i)
+	{
+		float x = static_cast<float>(i % cubesPerSide) - 0.5f * static_cast<float>(cubesPerSide - 1);
+		float y = static_cast<float>(i / cubesPerSide) - 0.5f * static_cast<float>(cubesPerSide - 1);
+		cubeNodes[i] = sceneGraph.CreateNode(gridNode);
+		sceneGraph.SetLocalPosition(cubeNodes[i], { x, y, 0.0f });
+		cubeProxies[i] = bounds.CreateProxy(cubeBounds, i, EBvhProxyType::Static);
+	}
+
+	FFrameArenas frameArenas(2);
+	FDrawList drawList;
+	std::vector<uint32_t> visibleCubes;
+	const uint32_t eventsPerFrame = 1024;
+	const uint32_t batchSize = 1024;
+
+	uint64_t warmupAllocations = 0;
+	uint64_t steadyAllocations = 0;
+	uint32_t framesWithAllocations = 0;
+	uint32_t visibleCount = 0;
+	std::vector<double> samples;
+	samples.reserve(frames);
+
+	for (uint32_t frame = 0; frame < warmupFrames + frames; ++frame)
+	{
+		uint64_t allocationsBefore = heapAllocationCount.load(std::memory_order_relaxed);
+		auto start = std::chrono::steady_clock::now();
+
+		FLinearArena& frameArena = frameArenas.BeginFrame();
+
+		sceneGraph.SetLocalRotation(gridNode, QuaternionRotationAxis({ 0.0f, 0.0f, 1.0f }, 0.01f * static_cast<float>(frame)));
+		sceneGraph.Update(&jobSystem);
+
+		for (uint32_t i = 0; i < cubeCount; ++i)
+		{
+			bounds.SetBounds(cubeProxies[i], TransformBoundingBox(cubeBounds, sceneGraph.GetWorldMatrix(cubeNodes[i])));
+		}
+		bounds.Update();
+
+		visibleCubes.clear();
+		bounds.QueryFrustum(frustum, visibleCubes);
+		visibleCount = static_cast<uint32_t>(visibleCubes.size());
+
+		FFloat4x4* instanceMatrices = frameArena.AllocateArray<FFloat4x4>(visibleCount);
+		for (uint32_t i = 0; i < visibleCount; ++i)
+		{
+			instanceMatrices[i] = sceneGraph.GetWorldMatrix(cubeNodes[visibleCubes[i]]);
+		}
+
+		// Each batch of instances sorts its view depths in scratch memory and keeps the nearest. One job per
+		// batch, since ParallelFor does not split on multiples of batchSize.
+		uint32_t batchCount = (visibleCount + batchSize - 1) / batchSize;
+		float* nearestDepths = frameArena.AllocateArray<float>(batchCount);
+		jobSystem.ParallelFor(batchCount, 1, [&](uint32_t batch, uint32_t)
+		{
+			uint32_t begin = batch * batchSize;
+			uint32_t end = std::min(visibleCount, begin + batchSize);
+
+			FScratchScope scratch;
+			float* depths = scratch.GetArena().AllocateArray<float>(end - begin);
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				depths[i - begin] = instanceMatrices[i].M[3][2];
+			}
+			std::sort(depths, depths + (end - begin));
+			nearestDepths[batch] = depths[0];
+		});
+
+		// Gameplay events live for part of the frame.
+		FTransientEvent* events[eventsPerFrame];
+		for (uint32_t i = 0; i < eventsPerFrame; ++i)
+		{
+			events[i] = eventPool.New();
+			events[i]->Target = i;
+		}
+		for (uint32_t i = 0; i < eventsPerFrame; ++i)
+		{
+			eventPool.Delete(events[i]);
+		}
+
+		constantBufferRing.BeginFrame();
+		FConstantBufferAllocation frameConstants = constantBufferRing.Upload(&frustum, sizeof(frustum));
+		constantBufferRing.Commit();
+
+		instanceBuffer.Upload(instanceMatrices, visibleCount, &jobSystem);
+
+		drawList.Reset();
+		for (uint32_t batch = 0; batch < batchCount; ++batch)
+		{
+			FDrawItem item;
+			item.VertexBuffers[0] = vertexBuffer;
+			item.VertexStrides[0] = 16;
+			item.VertexBuffers[1] = instanceBuffer.GetBuffer();
+			item.VertexStrides[1] = sizeof(FInstanceTransform);
+			item.ConstantBuffers[0].Buffer = frameConstants.Buffer;
+			item.ConstantBuffers[0].Offset = frameConstants.Offset;
+			item.ConstantBuffers[0].Size = frameConstants.Size;
+			item.IndexCount = 36;
+			item.StartInstance = batch * batchSize;
+			item.InstanceCount = std::min(batchSize, visibleCount - batch * batchSize);
+
+			FDrawSortKeyFields key;
+			key.Depth = QuantizeDrawDepth(nearestDepths[batch], 0.1f, 2.0f * gridDistance + 10.0f);
+			drawList.Add(MakeDrawSortKey(key), item);
+		}
+		drawList.Submit(&renderDevice, &jobSystem);
+
+		constantBufferRing.EndFrame();
+		renderDevice.Present(false);
+
+		auto end = std::chrono::steady_clock::now();
+		uint64_t allocations = heapAllocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+		if (frame < warmupFrames)
+		{
+			warmupAllocations += allocations;
+		}
+		else
+		{
+			steadyAllocations += allocations;
+			framesWithAllocations += allocations > 0 ? 1 : 0;
+			samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+	}
+
+	printf("\n%u cubes, %u visible, %u warm-up and %u measured frames, %u job threads, median %.3f ms\n\n", cubeCount, visibleCount,
+		warmupFrames, frames, jobSystem.GetConcurrency(), Median(samples));
+	printf("%-24s %12s %14s %10s %12s %12s\n", "allocator", "allocations", "bytes", "heap", "heap bytes", "peak bytes");
+	PrintStats("frame arenas", frameArenas.GetStats());
+	PrintStats("scratch, this thread", GetScratchArena().GetStats());
+	PrintStats("event pool", eventPool.GetPool().GetStats());
+
+	printf("\nGeneral heap allocations: %llu during warm-up, %llu in %u steady state frames (%u frames allocated)\n",
+		static_cast<unsigned long long>(warmupAllocations), static_cast<unsigned long long>(steadyAllocations), frames, framesWithAllocations);
+
+	if (steadyAllocations > 0)
+	{
+		fprintf(stderr, "Steady state frames allocated from the general heap\n");
+		return 1;
+	}
+
+	return 0;
+}
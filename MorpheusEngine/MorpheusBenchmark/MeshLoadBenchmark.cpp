@@ -0,0 +1,288 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "MeshFile.h"
+#include "NullRenderDevice.h"
+#include "ObjImporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char* packFileName = "MeshLoadBenchmark.pack";
+	// Vertices per side of every mesh, 64K vertices keep the indices 16 bit.
+	const uint32_t gridSide = 256;
+	const uint32_t pageSize = 4096;
+
+	// Runs prepare before every sample without measuring it.
+	// Drops the file from the OS file cache, so the next read comes from the disk. Only where the OS
+	// lets a normal user do that.
+	bool EvictFromFileCache(const char* path)
+	{
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+		int descriptor = open(path, O_RDONLY);
+		if (descriptor < 0)
+		{
+			return false;
+		}
+
+		bool evicted = fdatasync(descriptor) == 0 && posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		close(descriptor);
+
+		return evicted;
+#else
+		(void)path;
+		return false;
+#endif
+	}
+
+	// A displaced grid with positions, normals and texture coordinates, like a terrain tile.
+	FMeshData MakeGridMesh(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+
+		FMeshData mesh;
+		mesh.VertexCount = gridSide * gridSide;
+		mesh.Streams.resize(1);
+
+		FMeshStreamData& stream = mesh.Streams[0];
+		stream.Stride = 32;
+		stream.Elements.push_back({ EMeshSemantic::Position, 0, EVertexFormat::Float3, 0 });
+		stream.Elements.push_back({ EMeshSemantic::Normal, 0, EVertexFormat::Float3, 12 });
+		stream.Elements.push_back({ EMeshSemantic::TexCoord, 0, EVertexFormat::Float2, 24 });
+		stream.Data.resize(size_t(stream.Stride) * mesh.VertexCount);
+
+		float* vertex = reinterpret_cast<float*>(stream.Data.data());
+		for (uint32_t y = 0; y < gridSide; ++y)
+		{
+			for (uint32_t x = 0; x < gridSide; ++x, vertex += 8)
+			{
+				vertex[0] = static_cast<float>(x);
+				vertex[1] = height(random);
+				vertex[2] = static_cast<float>(y);
+				vertex[3] = 0.0f;
+				vertex[4] = 1.0f;
+				vertex[5] = 0.0f;
+				vertex[6] = x / float(gridSide - 1);
+				vertex[7] = y / float(gridSide - 1);
+			}
+		}
+
+		for (uint32_t y = 0; y + 1 < gridSide; ++y)
+		{
+			for (uint32_t x = 0; x + 1 < gridSide; ++x)
+			{
+				uint32_t corner = y * gridSide + x;
+				mesh.Indices.insert(mesh.Indices.end(), { corner, corner + gridSide, corner + 1, corner + 1, corner + gridSide, corner + gridSide + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	// The same mesh as OBJ text, to compare against parsing.
+	std::string MakeObjText(const FMeshData& mesh)
+	{
+		std::string text;
+		char line[128];
+
+		const float* vertex = reinterpret_cast<const float*>(mesh.Streams[0].Data.data());
+		for (uint32_t i = 0; i < mesh.VertexCount; ++i, vertex += 8)
+		{
+			snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\nvt %.6f %.6f\n", vertex[0], vertex[1], -vertex[2], vertex[3], vertex[4], -vertex[5], vertex[6], 1.0f - vertex[7]);
+			text += line;
+		}
+
+		for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+		{
+			uint32_t a = mesh.Indices[i] + 1;
+			uint32_t b = mesh.Indices[i + 1] + 1;
+			uint32_t c = mesh.Indices[i + 2] + 1;
+			snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+			text += line;
+		}
+
+		return text;
+	}
+
+	void PrintRow(const char* name, double milliseconds, uint64_t bytes)
+	{
+		printf("%-28s %12.2f %10.2f\n", name, milliseconds, bytes / (milliseconds * 1.0e-3) / (1024.0 * 1024.0 * 1024.0));
+	}
+}
+
+int RunMeshLoadBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t megabytes = 256;
+	uint32_t repeats = 5;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "megabytes", megabytes) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	megabytes = std::max(1u, megabytes);
+	repeats = std::max(1u, repeats);
+
+	std::mt19937 random(12);
+	FMeshData meshData = MakeGridMesh(random);
+
+	std::vector<uint8_t> meshBytes;
+	std::string error;
+	if (!SerializeMeshFile(meshData, meshBytes, &error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	// The pack repeats one mesh under different names, the loader does not care.
+	uint32_t meshCount = static_cast<uint32_t>(std::max<uint64_t>(1, (uint64_t(megabytes) << 20) / meshBytes.size()));
+	std::vector<FMeshPackSource> sources(meshCount);
+	for (uint32_t i = 0; i < meshCount; ++i)
+	{
+		sources[i].Name = "Tile" + std::to_string(i);
+		sources[i].Data = meshBytes.data();
+		sources[i].Size = meshBytes.size();
+	}
+
+	if (!WriteMeshPack(packFileName, sources, &error))
+	{
+		fprintf(stderr, "%s: %s\n", packFileName, error.c_str());
+		return 1;
+	}
+
+	FMeshPack probe;
+	if (!probe.Open(packFileName))
+	{
+		fprintf(stderr, "%s: %s\n", packFileName, probe.GetError());
+		return 1;
+	}
+
+	uint64_t packSize = probe.GetFile().GetSize();
+	probe.Close();
+
+	volatile uint32_t sink = 0;
+
+	auto readIntoMemory = [&]()
+	{
+		FILE* file = std::fopen(packFileName, "rb");
+		std::vector<uint8_t> bytes(static_cast<size_t>(packSize));
+		size_t read = file ? std::fread(bytes.data(), 1, bytes.size(), file) : 0;
+		if (file)
+		{
+			std::fclose(file);
+		}
+
+		sink = sink + static_cast<uint32_t>(read) + bytes[bytes.size() / 2];
+	};
+
+	// The pack is opened fresh for every sample, so every sample maps and validates it again.
+	auto openPack = [&](bool touchPages, IRenderDevice* renderDevice)
+	{
+		FMeshPack pack;
+		if (!pack.Open(packFileName))
+		{
+			return;
+		}
+
+		FMeshFile mesh;
+		for (uint32_t i = 0; i < pack.GetMeshCount(); ++i)
+		{
+			if (!pack.OpenMesh(i, mesh))
+			{
+				return;
+			}
+
+			if (touchPages)
+			{
+				uint32_t sum = 0;
+				for (uint64_t offset = 0; offset < mesh.GetSize(); offset += pageSize)
+				{
+					sum += mesh.GetData()[offset];
+				}
+				sink = sink + sum;
+			}
+
+			if (renderDevice)
+			{
+				FMeshBuffers buffers;
+				sink = sink + CreateMeshBuffers(renderDevice, mesh, buffers);
+			}
+		}
+	};
+
+	auto nothing = []()
+	{
+	};
+
+	printf("Mesh pack of %u meshes, %u vertices and %u indices each, %.1f MB, median of %u loads\n\n", meshCount, meshData.VertexCount,
+		static_cast<uint32_t>(meshData.Indices.size()), packSize / (1024.0 * 1024.0), repeats);
+	printf("%-28s %12s %10s\n", "path", "median ms", "GB/s");
+
+	// Warm file cache, the pack was just written.
+	readIntoMemory();
+	PrintRow("read into memory", MeasureMilliseconds(repeats, nothing, readIntoMemory), packSize);
+	PrintRow("map and validate", MeasureMilliseconds(repeats, nothing, [&]() { openPack(false, nullptr); }), packSize);
+	PrintRow("map and touch every page", MeasureMilliseconds(repeats, nothing, [&]() { openPack(true, nullptr); }), packSize);
+
+	// The headless device copies into system memory like a driver does for an upload, and keeps every
+	// buffer, so it is recreated for every sample.
+	FNullRenderDevice* renderDevice = nullptr;
+	auto newDevice = [&]()
+	{
+		delete renderDevice;
+		renderDevice = new FNullRenderDevice(false);
+	};
+	PrintRow("map and create buffers", MeasureMilliseconds(repeats, newDevice, [&]() { openPack(false, renderDevice); }), packSize);
+	delete renderDevice;
+	renderDevice = nullptr;
+
+	// Cold file cache, bounded by the disk.
+	auto evict = [&]()
+	{
+		EvictFromFileCache(packFileName);
+	};
+
+	if (EvictFromFileCache(packFileName))
+	{
+		PrintRow("cold read into memory", MeasureMilliseconds(repeats, evict, readIntoMemory), packSize);
+		PrintRow("cold map and touch", MeasureMilliseconds(repeats, evict, [&]() { openPack(true, nullptr); }), packSize);
+	}
+	else
+	{
+		printf("%-28s %12s\n", "cold rows", "not supported on this platform");
+	}
+
+	// Parse the same mesh from OBJ text and scale to the whole pack.
+	std::string objText = MakeObjText(meshData);
+	FObjImportOptions options;
+	FMeshData imported;
+	double objMilliseconds = MeasureMilliseconds(std::min(repeats, 3u), nothing, [&]()
+	{
+		ImportObj(objText.data(), objText.size(), options, imported, nullptr);
+		SerializeMeshFile(imported, meshBytes, nullptr);
+	});
+
+	printf("\nOBJ import of one mesh: %.1f MB of text in %.2f ms, %.0f MB/s\n", objText.size() / (1024.0 * 1024.0), objMilliseconds,
+		objText.size() / (objMilliseconds * 1.0e-3) / (1024.0 * 1024.0));
+	PrintRow("OBJ import, whole pack", objMilliseconds * meshCount, packSize);
+
+	std::remove(packFileName);
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Runs prepare before every sample without measuring it.
+	// A UV sphere with positions, normals and texture coordinates in one stream, triangles in scanline
+	// order like a simple exporter writes them.
+	FMeshData MakeSphereMesh(uint32_t side)
+	{
+		const float pi = 3.14159265f;
+
+		FMeshData mesh;
+		mesh.VertexCount = side * side;
+		mesh.Streams.resize(1);
+
+		FMeshStreamData& stream = mesh.Streams[0];
+		stream.Stride = 32;
+		stream.Elements.push_back({ EMeshSemantic::Position, 0, EVertexFormat::Float3, 0 });
+		stream.Elements.push_back({ EMeshSemantic::Normal, 0, EVertexFormat::Float3, 12 });
+		stream.Elements.push_back({ EMeshSemantic::TexCoord, 0, EVertexFormat::Float2, 24 });
+		stream.Data.resize(size_t(stream.Stride) * mesh.VertexCount);
+
+		float* vertex = reinterpret_cast<float*>(stream.Data.data());
+		for (uint32_t y = 0; y < side; ++y)
+		{
+			for (uint32_t x = 0; x < side; ++x, vertex += 8)
+			{
+				float theta = pi * y / float(side - 1);
+				float phi = 2.0f * pi * x / float(side - 1);
+
+				vertex[0] = std::sin(theta) * std::cos(phi);
+				vertex[1] = std::cos(theta);
+				vertex[2] = std::sin(theta) * std::sin(phi);
+				vertex[3] = vertex[0];
+				vertex[4] = vertex[1];
+				vertex[5] = vertex[2];
+				vertex[6] = x / float(side - 1);
+				vertex[7] = y / float(side - 1);
+			}
+		}
+
+		// Clockwise seen from outside.
+		for (uint32_t y = 0; y + 1 < side; ++y)
+		{
+			for (uint32_t x = 0; x + 1 < side; ++x)
+			{
+				uint32_t corner = y * side + x;
+				mesh.Indices.insert(mesh.Indices.end(), { corner, corner + 1, corner + side, corner + 1, corner + side + 1, corner + side });
+			}
+		}
+
+		return mesh;
+	}
+
+	// Triangles and vertices in random order, the worst case an unoptimised asset can be.
+	void ShuffleMesh(FMeshData& mesh, std::mt19937& random)
+	{
+		std::vector<std::array<uint32_t, 3>> triangles(mesh.Indices.size() / 3);
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			triangles[i] = { { mesh.Indices[i * 3], mesh.Indices[i * 3 + 1], mesh.Indices[i * 3 + 2] } };
+		}
+		std::shuffle(triangles.begin(), triangles.end(), random);
+
+		std::vector<uint32_t> order(mesh.VertexCount);
+		for (uint32_t i = 0; i < mesh.VertexCount; ++i)
+		{
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), random);
+
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				mesh.Indices[i * 3 + corner] = order[triangles[i][corner]];
+			}
+		}
+
+		FMeshStreamData& stream = mesh.Streams[0];
+		std::vector<uint8_t> data(stream.Data.size());
+		for (uint32_t vertex = 0; vertex < mesh.VertexCount; ++vertex)
+		{
+			std::copy_n(&stream.Data[size_t(vertex) * stream.Stride], stream.Stride, &data[size_t(order[vertex]) * stream.Stride]);
+		}
+		stream.Data.swap(data);
+	}
+
+	void PrintRow(const char* name, const FMeshData& mesh, double milliseconds)
+	{
+		uint32_t indexCount = static_cast<uint32_t>(mesh.Indices.size());
+		FVertexCacheStats cache = AnalyzeVertexCache(mesh.Indices.data(), indexCount, mesh.VertexCount);
+		FVertexCacheStats smallCache = AnalyzeVertexCache(mesh.Indices.data(), indexCount, mesh.VertexCount, 8);
+		FVertexFetchStats fetch = AnalyzeVertexFetch(mesh.Indices.data(), indexCount, mesh.VertexCount, mesh.Streams[0].Stride);
+
+		printf("%-30s %8.3f %8.3f %10.3f %10.2f", name, cache.Acmr, cache.Atvr, smallCache.Acmr, fetch.Overfetch);
+		if (milliseconds >= 0.0)
+		{
+			printf(" %10.2f", milliseconds);
+		}
+		printf("\n");
+	}
+
+	// Meshlets whose cone culls them for a camera outside the mesh, averaged over cameras around it.
+	double ConeCulledFraction(const FMeshData& mesh, std::mt19937& random)
+	{
+		std::normal_distribution<float> direction(0.0f, 1.0f);
+
+		const uint32_t cameraCount = 64;
+		uint64_t culled = 0;
+		for (uint32_t camera = 0; camera < cameraCount; ++camera)
+		{
+			FFloat3 position = { direction(random), direction(random), direction(random) };
+			float scale = 3.0f / std::sqrt(position.X * position.X + position.Y * position.Y + position.Z * position.Z);
+			position = { position.X * scale, position.Y * scale, position.Z * scale };
+
+			for (const FMeshFileMeshlet& meshlet : mesh.Meshlets)
+			{
+				FFloat3 view = { meshlet.ConeApex.X - position.X, meshlet.ConeApex.Y - position.Y, meshlet.ConeApex.Z - position.Z };
+				float length = std::sqrt(view.X * view.X + view.Y * view.Y + view.Z * view.Z);
+				float cosine = (view.X * meshlet.ConeAxis.X + view.Y * meshlet.ConeAxis.Y + view.Z * meshlet.ConeAxis.Z) / length;
+
+				culled += cosine > meshlet.ConeCutoff;
+			}
+		}
+
+		return mesh.Meshlets.empty() ? 0.0 : double(culled) / (double(cameraCount) * mesh.Meshlets.size());
+	}
+}
+
+int RunMeshOptimizerBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t side = 512;
+	uint32_t repeats = 3;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "side", side) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	side = std::max(4u, side);
+	repeats = std::max(1u, repeats);
+
+	std::mt19937 random(13);
+	FMeshData scanline = MakeSphereMesh(side);
+	FMeshData shuffled = scanline;
+	ShuffleMesh(shuffled, random);
+
+	uint32_t indexCount = static_cast<uint32_t>(shuffled.Indices.size());
+	printf("Sphere of %u vertices and %u triangles, %s indices, median of %u runs\n", shuffled.VertexCount, indexCount / 3,
+		shuffled.VertexCount > UINT16_MAX + 1u ? "32 bit" : "16 bit", repeats);
+	printf("ACMR and ATVR of a 16 entry FIFO cache, ACMR of an 8 entry one, overfetch of a 16 KB cache of 64 byte lines\n\n");
+	printf("%-30s %8s %8s %10s %10s %10s\n", "order", "ACMR", "ATVR", "ACMR 8", "overfetch", "median ms");
+
+	PrintRow("scanline", scanline, -1.0);
+	PrintRow("shuffled", shuffled, -1.0);
+
+	// Every stage runs on a fresh copy of the shuffled mesh.
+	FMeshData mesh;
+	auto reset = [&]()
+	{
+		mesh = shuffled;
+	};
+
+	FMeshOptimizeOptions options;
+	options.OptimizeOverdraw = false;
+	options.OptimizeVertexFetch = false;
+	double milliseconds = MeasureMilliseconds(repeats, reset, [&]() { OptimizeMesh(mesh, options); });
+	PrintRow("vertex cache", mesh, milliseconds);
+
+	options.OptimizeOverdraw = true;
+	milliseconds = MeasureMilliseconds(repeats, reset, [&]() { OptimizeMesh(mesh, options); });
+	PrintRow("vertex cache, overdraw", mesh, milliseconds);
+
+	options.OptimizeVertexFetch = true;
+	milliseconds = MeasureMilliseconds(repeats, reset, [&]() { OptimizeMesh(mesh, options); });
+	PrintRow("vertex cache, overdraw, fetch", mesh, milliseconds);
+
+	options.BuildMeshlets = true;
+	milliseconds = MeasureMilliseconds(repeats, reset, [&]() { OptimizeMesh(mesh, options); });
+	PrintRow("all, with meshlets", mesh, milliseconds);
+
+	uint64_t meshletVertices = 0;
+	uint64_t meshletTriangles = 0;
+	for (const FMeshFileMeshlet& meshlet : mesh.Meshlets)
+	{
+		meshletVertices += meshlet.VertexCount;
+		meshletTriangles += meshlet.TriangleCount;
+	}
+
+	size_t meshletCount = std::max<size_t>(1, mesh.Meshlets.size());
+	printf("\n%u meshlets of %.1f vertices and %.1f triangles on average, %.1f%% cone culled from outside\n",
+		static_cast<uint32_t>(mesh.Meshlets.size()), double(meshletVertices) / meshletCount, double(meshletTriangles) / meshletCount,
+		100.0 * ConeCulledFraction(mesh, random));
+
+	return 0;
+}
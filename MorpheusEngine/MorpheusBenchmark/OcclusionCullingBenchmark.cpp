@@ -0,0 +1,393 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// The camera of the culling benchmark: XMMatrixLookAtLH from (0, 0, -10) towards the origin, times
+	// XMMatrixPerspectiveFovLH(45 degrees, 16:9, 0.1, 100). View depth is world z + 10.
+	const float EyeZ = -10.0f;
+	const float NearPlane = 0.1f;
+	const float FarPlane = 100.0f;
+	const float AspectRatio = 16.0f / 9.0f;
+
+	FFloat4x4 PerspectiveLookAt()
+	{
+		float yScale = 1.0f / std::tan(0.5f * 45.0f * 3.14159265f / 180.0f);
+		float range = FarPlane / (FarPlane - NearPlane);
+
+		FFloat4x4 viewProjection = {};
+		viewProjection.M[0][0] = yScale / AspectRatio;
+		viewProjection.M[1][1] = yScale;
+		viewProjection.M[2][2] = range;
+		viewProjection.M[2][3] = 1.0f;
+		viewProjection.M[3][2] = -EyeZ * range - range * NearPlane;
+		viewProjection.M[3][3] = -EyeZ;
+
+		return viewProjection;
+	}
+
+	// Depth of the nearest occluder a ray through a point of the buffer hits, or 2 when it hits none.
+	// In doubles, as the reference for the rasterizer.
+	double TraceDepth(const std::vector<FBoundingBox>& occluders, const FFloat4x4& viewProjection, double x, double y, uint32_t width, uint32_t height)
+	{
+		double directionX = (x / width * 2.0 - 1.0) / viewProjection.M[0][0];
+		double directionY = (1.0 - y / height * 2.0) / viewProjection.M[1][1];
+
+		double nearest = 1e30;
+		for (const FBoundingBox& box : occluders)
+		{
+			// Slabs along the ray from the eye, whose parameter is the view depth as the direction has z = 1.
+			double enter = NearPlane;
+			double leave = 1e30;
+			const double origin[3] = { 0.0, 0.0, EyeZ };
+			const double direction[3] = { directionX, directionY, 1.0 };
+			const float minimum[3] = { box.Min.X, box.Min.Y, box.Min.Z };
+			const float maximum[3] = { box.Max.X, box.Max.Y, box.Max.Z };
+
+			for (int axis = 0; axis < 3 && enter <= leave; ++axis)
+			{
+				if (direction[axis] == 0.0)
+				{
+					leave = (origin[axis] < minimum[axis] || origin[axis] > maximum[axis]) ? -1.0 : leave;
+					continue;
+				}
+
+				double t0 = (minimum[axis] - origin[axis]) / direction[axis];
+				double t1 = (maximum[axis] - origin[axis]) / direction[axis];
+				enter = std::max(enter, std::min(t0, t1));
+				leave = std::min(leave, std::max(t0, t1));
+			}
+
+			if (enter <= leave)
+			{
+				nearest = std::min(nearest, enter);
+			}
+		}
+
+		double range = FarPlane / (FarPlane - NearPlane);
+
+		return nearest < 1e30 ? range * (1.0 - NearPlane / nearest) : 2.0;
+	}
+
+	// Whether an object is hidden by every pixel of the depth buffer it touches, without the hierarchy.
+	bool IsHiddenAtFullResolution(const FOcclusionCuller& culler, const FFloat4x4& viewProjection, const FBoundingBox& box)
+	{
+		const float(&m)[4][4] = viewProjection.M;
+		const float width = static_cast<float>(culler.GetWidth());
+		const float height = static_cast<float>(culler.GetHeight());
+
+		float minX = width;
+		float minY = height;
+		float maxX = 0.0f;
+		float maxY = 0.0f;
+		float nearestDepth = 1.0f;
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			float px = (corner & 1) ? box.Max.X : box.Min.X;
+			float py = (corner & 2) ? box.Max.Y : box.Min.Y;
+			float pz = (corner & 4) ? box.Max.Z : box.Min.Z;
+			float clipW = px * m[0][3] + py * m[1][3] + pz * m[2][3] + m[3][3];
+			float clipZ = px * m[0][2] + py * m[1][2] + pz * m[2][2] + m[3][2];
+			if (clipZ < 0.0f)
+			{
+				return false;
+			}
+
+			minX = std::min(minX, ((px * m[0][0] + py * m[1][0] + pz * m[2][0] + m[3][0]) / clipW * 0.5f + 0.5f) * width);
+			maxX = std::max(maxX, ((px * m[0][0] + py * m[1][0] + pz * m[2][0] + m[3][0]) / clipW * 0.5f + 0.5f) * width);
+			minY = std::min(minY, (0.5f - (px * m[0][1] + py * m[1][1] + pz * m[2][1] + m[3][1]) / clipW * 0.5f) * height);
+			maxY = std::max(maxY, (0.5f - (px * m[0][1] + py * m[1][1] + pz * m[2][1] + m[3][1]) / clipW * 0.5f) * height);
+			nearestDepth = std::min(nearestDepth, clipZ / clipW);
+		}
+
+		int32_t firstX = std::max(0, static_cast<int32_t>(std::floor(minX)));
+		int32_t firstY = std::max(0, static_cast<int32_t>(std::floor(minY)));
+		int32_t lastX = std::min(static_cast<int32_t>(culler.GetWidth()), static_cast<int32_t>(std::ceil(maxX)));
+		int32_t lastY = std::min(static_cast<int32_t>(culler.GetHeight()), static_cast<int32_t>(std::ceil(maxY)));
+
+		const float* depths = culler.GetFarthestDepths(0);
+		for (int32_t y = firstY; y < lastY; ++y)
+		{
+			for (int32_t x = firstX; x < lastX; ++x)
+			{
+				if (nearestDepth <= depths[static_cast<size_t>(y) * culler.GetLevelPitch(0) + x])
+				{
+					return false;
+				}
+			}
+		}
+
+		return firstX < lastX && firstY < lastY;
+	}
+
+	bool SameDepths(const FOcclusionCuller& a, const FOcclusionCuller& b)
+	{
+		for (uint32_t level = 0; level < a.GetLevelCount(); ++level)
+		{
+			size_t size = sizeof(float) * a.GetLevelPitch(level) * a.GetLevelHeight(level);
+			if (std::memcmp(a.GetNearestDepths(level), b.GetNearestDepths(level), size) != 0 ||
+				std::memcmp(a.GetFarthestDepths(level), b.GetFarthestDepths(level), size) != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+int RunOcclusionCullingBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t objectCount = 100000;
+	uint32_t occluderCount = 48;
+	uint32_t width = FOcclusionCuller::DefaultWidth;
+	uint32_t height = FOcclusionCuller::DefaultHeight;
+	uint32_t repeats = 21;
+	uint32_t threads = 0;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "objects", objectCount) &&
+			!ParseOption(arguments[i], "occluders", occluderCount) &&
+			!ParseOption(arguments[i], "width", width) &&
+			!ParseOption(arguments[i], "height", height) &&
+			!ParseOption(arguments[i], "repeats", repeats) &&
+			!ParseOption(arguments[i], "threads", threads))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	objectCount = std::max(1u, objectCount);
+	width = std::max(1u, width);
+	height = std::max(1u, height);
+	repeats = std::max(1u, repeats);
+
+	uint32_t failures = 0;
+	auto fail = [&failures](const char* message)
+	{
+		fprintf(stderr, "FAILED: %s\n", message);
+		++failures;
+	};
+
+	const FFloat4x4 viewProjection = PerspectiveLookAt();
+	const FFloat4x4 identity = MatrixIdentity();
+
+	// A town seen from the street: a wall across the middle distance, buildings in front of it and
+	// small props everywhere behind and between them.
+	std::mt19937 random(1234);
+	std::vector<FBoundingBox> occluders;
+	occluders.push_back({ { -12.0f, -5.0f, 40.0f }, { 12.0f, 4.0f, 41.0f } });
+
+	std::uniform_real_distribution<float> buildingX(-40.0f, 40.0f);
+	std::uniform_real_distribution<float> buildingZ(8.0f, 35.0f);
+	std::uniform_real_distribution<float> buildingSize(1.0f, 5.0f);
+	std::uniform_real_distribution<float> buildingHeight(1.0f, 12.0f);
+	for (uint32_t i = 1; i < occluderCount; ++i)
+	{
+		float x = buildingX(random);
+		float z = buildingZ(random);
+		float size = buildingSize(random);
+		occluders.push_back({ { x, -5.0f, z }, { x + size, -5.0f + buildingHeight(random), z + size } });
+	}
+
+	std::uniform_real_distribution<float> objectX(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> objectY(-5.0f, 3.0f);
+	std::uniform_real_distribution<float> objectZ(10.0f, 85.0f);
+	std::uniform_real_distribution<float> objectSize(0.1f, 1.0f);
+
+	std::vector<FBoundingBox> boxes(objectCount);
+	FBoundsSoA bounds;
+	bounds.Resize(objectCount);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		FFloat3 centre = { objectX(random), objectY(random), objectZ(random) };
+		float size = objectSize(random);
+		boxes[i] = { { centre.X - size, centre.Y - size, centre.Z - size }, { centre.X + size, centre.Y + size, centre.Z + size } };
+		bounds.SetBox(i, centre, { size, size, size });
+	}
+
+	FJobSystem jobSystem(threads);
+	FFrustumCuller frustumCuller;
+	std::vector<uint32_t> candidates;
+	frustumCuller.Cull(bounds, FrustumFromViewProjection(viewProjection), candidates, &jobSystem);
+
+	auto addOccluders = [&](FOcclusionCuller& culler)
+	{
+		culler.BeginFrame(viewProjection);
+		for (const FBoundingBox& occluder : occluders)
+		{
+			culler.AddOccluderBox(occluder, identity);
+		}
+	};
+
+	FOcclusionCuller culler(width, height);
+	addOccluders(culler);
+	culler.Rasterize(&jobSystem);
+
+	std::vector<uint32_t> visible = candidates;
+	culler.Cull(boxes.data(), visible, &jobSystem);
+	const FOcclusionCullingStats stats = culler.GetStats();
+
+	printf("Occlusion culling of %u boxes behind %u box occluders at %ux%u, %u levels, median of %u runs\n\n", objectCount, occluderCount, width, height,
+		culler.GetLevelCount(), repeats);
+	printf("%u in the frustum, %u hidden by occluders (%.1f%%), %u of %u occluder triangles rasterized\n\n", stats.TestedObjects, stats.CulledObjects,
+		stats.TestedObjects > 0 ? 100.0 * stats.CulledObjects / stats.TestedObjects : 0.0, stats.RasterizedTriangles, stats.OccluderTriangles);
+
+	// Every backend has to rasterize the same buffer, and every thread count.
+	const EMathBackend previousBackend = GetMathBackend();
+	const EMathBackend backends[] = { EMathBackend::Scalar, EMathBackend::SSE, EMathBackend::AVX2, EMathBackend::NEON };
+
+	printf("%-28s %12s %12s\n", "pass", "median ms", "speedup");
+
+	double serialMilliseconds = 0.0;
+	for (EMathBackend backend : backends)
+	{
+		if (!IsMathBackendSupported(backend))
+		{
+			continue;
+		}
+
+		SetMathBackend(backend);
+
+		FOcclusionCuller backendCuller(width, height);
+		double milliseconds = MeasureMilliseconds(repeats, [&]()
+		{
+			addOccluders(backendCuller);
+			backendCuller.Rasterize();
+		});
+		serialMilliseconds = serialMilliseconds > 0.0 ? serialMilliseconds : milliseconds;
+
+		char name[64];
+		snprintf(name, sizeof(name), "rasterize %s", GetMathBackendName(backend));
+		printf("%-28s %12.3f %11.2fx\n", name, milliseconds, serialMilliseconds / milliseconds);
+
+		if (!SameDepths(culler, backendCuller))
+		{
+			fail("a backend rasterized a different depth buffer");
+		}
+	}
+
+	SetMathBackend(previousBackend);
+
+	double parallelMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		addOccluders(culler);
+		culler.Rasterize(&jobSystem);
+	});
+
+	char name[64];
+	snprintf(name, sizeof(name), "rasterize %s, %u threads", GetMathBackendName(GetMathBackend()), jobSystem.GetConcurrency());
+	printf("%-28s %12.3f %11.2fx\n", name, parallelMilliseconds, serialMilliseconds / parallelMilliseconds);
+
+	std::vector<uint32_t> testIndices;
+	double testMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		testIndices = candidates;
+		culler.Cull(boxes.data(), testIndices);
+	});
+	printf("%-28s %12.3f %11.2fx\n", "test, 1 thread", testMilliseconds, 1.0);
+
+	double parallelTestMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		testIndices = candidates;
+		culler.Cull(boxes.data(), testIndices, &jobSystem);
+	});
+	snprintf(name, sizeof(name), "test, %u threads", jobSystem.GetConcurrency());
+	printf("%-28s %12.3f %11.2fx\n", name, parallelTestMilliseconds, testMilliseconds / parallelTestMilliseconds);
+
+	if (testIndices != visible)
+	{
+		fail("the parallel test hid different objects");
+	}
+
+	// The buffer must never be in front of the occluders: every corner of a written pixel sees an
+	// occluder at least as near as the pixel.
+	uint32_t writtenPixels = 0;
+	uint32_t wrongPixels = 0;
+	const float* depths = culler.GetNearestDepths(0);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			float depth = depths[static_cast<size_t>(y) * culler.GetLevelPitch(0) + x];
+			if (depth >= 1.0f)
+			{
+				continue;
+			}
+
+			++writtenPixels;
+			for (uint32_t corner = 0; corner < 4; ++corner)
+			{
+				if (TraceDepth(occluders, viewProjection, x + (corner & 1), y + (corner >> 1), width, height) > depth + 1e-6)
+				{
+					++wrongPixels;
+					break;
+				}
+			}
+		}
+	}
+
+	uint32_t hiddenAtFullResolution = 0;
+	uint32_t wrongObjects = 0;
+	for (uint32_t index : candidates)
+	{
+		bool hidden = IsHiddenAtFullResolution(culler, viewProjection, boxes[index]);
+		bool culled = !std::binary_search(visible.begin(), visible.end(), index);
+		hiddenAtFullResolution += hidden ? 1 : 0;
+		wrongObjects += (culled && !hidden) ? 1 : 0;
+	}
+
+	printf("\n%u pixels covered by occluders (%.1f%%), %u in front of them\n", writtenPixels, 100.0 * writtenPixels / (width * height), wrongPixels);
+	printf("The hierarchy hid %u of the %u objects a full resolution test hides (%.1f%%), %u that it does not\n", stats.CulledObjects, hiddenAtFullResolution,
+		hiddenAtFullResolution > 0 ? 100.0 * stats.CulledObjects / hiddenAtFullResolution : 100.0, wrongObjects);
+
+	if (wrongPixels > 0)
+	{
+		fail("the depth buffer is in front of the occluders");
+	}
+	if (wrongObjects > 0)
+	{
+		fail("an object with a visible pixel was hidden");
+	}
+	if (stats.CulledObjects == 0)
+	{
+		fail("nothing was hidden behind the wall");
+	}
+
+	// Seen head on, only the front face of a box faces the camera.
+	{
+		FOcclusionCuller boxCuller(width, height);
+		boxCuller.BeginFrame(viewProjection);
+		boxCuller.AddOccluderBox({ { -1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 2.0f } }, identity);
+		boxCuller.Rasterize();
+
+		const FOcclusionCullingStats& boxStats = boxCuller.GetStats();
+		float centreDepth = boxCuller.GetNearestDepths(0)[static_cast<size_t>(height / 2) * boxCuller.GetLevelPitch(0) + width / 2];
+		double frontDepth = TraceDepth({ { { -1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 2.0f } } }, viewProjection, 0.5 * width, 0.5 * height, width, height);
+		if (boxStats.RasterizedTriangles != 2 || std::fabs(centreDepth - frontDepth) > 1e-6)
+		{
+			fail("a box was not rasterized with its front face");
+		}
+	}
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "%u checks failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
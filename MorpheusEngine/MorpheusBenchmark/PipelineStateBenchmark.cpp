@@ -0,0 +1,151 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "NullRenderDevice.h"
+#include "PipelineStateCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const char* manifestFileName = "PipelineStateBenchmark.manifest";
+
+	// Materials pick from a few cull modes, depth modes and blend modes, so many of them share states.
+	std::vector<FPipelineStateDesc> MakeMaterials(uint32_t materialCount, uint32_t shaderCount, std::mt19937& random)
+	{
+		std::uniform_int_distribution<uint32_t> shader(1, shaderCount);
+		std::uniform_int_distribution<uint32_t> mode(0, 2);
+
+		std::vector<FPipelineStateDesc> materials(materialCount);
+		for (FPipelineStateDesc& material : materials)
+		{
+			material.VertexShader.Value = shader(random);
+			material.PixelShader.Value = shader(random);
+			material.InputLayout.Value = 1;
+			material.Rasterizer.CullMode = static_cast<ECullMode>(mode(random));
+
+			uint32_t depthMode = mode(random);
+			material.DepthStencil.DepthWriteEnable = depthMode == 0;
+			material.DepthStencil.DepthFunc = depthMode == 2 ? EComparisonFunc::Equal : EComparisonFunc::LessEqual;
+
+			uint32_t blendMode = mode(random);
+			material.Blend.BlendEnable = blendMode != 0;
+			material.Blend.SourceBlend = blendMode == 1 ? EBlendFactor::SourceAlpha : EBlendFactor::One;
+			material.Blend.DestinationBlend = blendMode == 1 ? EBlendFactor::InverseSourceAlpha : EBlendFactor::One;
+		}
+
+		return materials;
+	}
+
+	uint32_t CountCreated(const FStateCacheCounters& counters)
+	{
+		return counters.Misses + counters.Prewarmed;
+	}
+}
+
+int RunPipelineStateBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t materialCount = 10000;
+	uint32_t shaderCount = 16;
+	uint32_t repeats = 15;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "materials", materialCount) &&
+			!ParseOption(arguments[i], "shaders", shaderCount) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	materialCount = std::max(1u, materialCount);
+	shaderCount = std::max(1u, shaderCount);
+	repeats = std::max(1u, repeats);
+
+	std::mt19937 random(16);
+	std::vector<FPipelineStateDesc> materials = MakeMaterials(materialCount, shaderCount, random);
+
+	printf("Resolving the states of %u materials over %u shaders, median of %u runs\n\n", materialCount, shaderCount, repeats);
+	printf("%-24s %12s %14s %16s\n", "path", "median ms", "ns/material", "device objects");
+
+	// Every material creating its own state objects, as InitialiseDirectX() did for its one pipeline. The
+	// null device creates them for free, a driver takes microseconds for each and may compile shaders.
+	uint64_t adHocObjects = 0;
+	double adHocMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		FNullRenderDevice device(false);
+		for (const FPipelineStateDesc& material : materials)
+		{
+			device.CreateRasterizerState(material.Rasterizer);
+			device.CreateDepthStencilState(material.DepthStencil);
+			device.CreateBlendState(material.Blend);
+		}
+
+		adHocObjects = device.GetFrameStats().ResourcesCreated;
+	});
+	printf("%-24s %12.3f %14.1f %16llu\n", "ad hoc", adHocMilliseconds, adHocMilliseconds * 1e6 / materialCount, static_cast<unsigned long long>(adHocObjects));
+
+	// A cold cache, timed once with nothing run before it, then one already holding every state, which is
+	// what each later frame sees.
+	FNullRenderDevice device(false);
+	FPipelineStateCache cache(&device);
+	FPipelineStateCacheStats coldStats;
+	double coldMilliseconds = MeasureMilliseconds(1, []() {}, [&]()
+	{
+		for (const FPipelineStateDesc& material : materials)
+		{
+			cache.GetPipeline(material);
+		}
+	});
+	coldStats = cache.GetStats();
+	printf("%-24s %12.3f %14.1f %16llu\n", "cache, cold", coldMilliseconds, coldMilliseconds * 1e6 / materialCount,
+		static_cast<unsigned long long>(device.GetFrameStats().ResourcesCreated));
+
+	cache.ResetStats();
+	double warmMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		for (const FPipelineStateDesc& material : materials)
+		{
+			cache.GetPipeline(material);
+		}
+	});
+	printf("%-24s %12.3f %14.1f %16u\n", "cache, warm", warmMilliseconds, warmMilliseconds * 1e6 / materialCount, 0u);
+
+	const FPipelineStateCacheStats& warmStats = cache.GetStats();
+	printf("\n%u pipelines from %u rasterizer, %u depth stencil and %u blend states; warm runs had %u hits and %u misses\n", cache.GetPipelineCount(),
+		coldStats.RasterizerStates.Misses, coldStats.DepthStencilStates.Misses, coldStats.BlendStates.Misses, warmStats.Pipelines.Hits, warmStats.Pipelines.Misses);
+	printf("Cold state creation took %.3f ms, the slowest single creation %.3f us\n",
+		(coldStats.RasterizerStates.CreationNanoseconds + coldStats.DepthStencilStates.CreationNanoseconds + coldStats.BlendStates.CreationNanoseconds) * 1e-6,
+		std::max({ coldStats.RasterizerStates.MaxCreationNanoseconds, coldStats.DepthStencilStates.MaxCreationNanoseconds, coldStats.BlendStates.MaxCreationNanoseconds }) * 1e-3);
+
+	// The next run starts from the manifest and creates nothing while resolving materials.
+	std::string error;
+	if (!cache.SaveManifest(manifestFileName, &error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	FNullRenderDevice nextDevice(false);
+	FPipelineStateCache nextCache(&nextDevice);
+	double prewarmMilliseconds = MeasureMilliseconds(1, []() {}, [&]() { nextCache.PrewarmFromManifest(manifestFileName, nullptr, 0, &error); });
+
+	for (const FPipelineStateDesc& material : materials)
+	{
+		nextCache.GetPipeline(material);
+	}
+
+	const FPipelineStateCacheStats& nextStats = nextCache.GetStats();
+	printf("Pre-warming from the manifest: %.3f ms for %u states, then %u states created while resolving\n", prewarmMilliseconds,
+		CountCreated(nextStats.RasterizerStates) + CountCreated(nextStats.DepthStencilStates) + CountCreated(nextStats.BlendStates),
+		nextStats.RasterizerStates.Misses + nextStats.DepthStencilStates.Misses + nextStats.BlendStates.Misses);
+
+	std::remove(manifestFileName);
+
+	return 0;
+}
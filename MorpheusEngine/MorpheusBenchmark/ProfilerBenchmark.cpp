@@ -0,0 +1,147 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Stands in for the work inside a scope, small enough for the scope to dominate.
+	uint32_t Work(uint32_t value)
+	{
+		return value * 2654435761u + (value >> 7);
+	}
+}
+
+int RunProfilerBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t scopeCount = 1000000;
+	uint32_t threads = 0;
+	uint32_t repeats = 15;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "scopes", scopeCount) &&
+			!ParseOption(arguments[i], "threads", threads) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	scopeCount = std::max(1u, scopeCount);
+
+	// Every thread keeps a whole run, so nothing is overwritten while measuring.
+	uint32_t capacity = 1;
+	while (capacity < scopeCount && capacity < (1u << 24))
+	{
+		capacity <<= 1;
+	}
+	SetProfilerBufferCapacity(capacity);
+
+	// Keeps the work alive. The job threads write it too, so it is atomic rather than volatile.
+	std::atomic<uint32_t> sink(0);
+
+	auto runScopes = [&]()
+	{
+		uint32_t value = sink.load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < scopeCount; ++i)
+		{
+			MORPHEUS_PROFILE_SCOPE("Scope");
+			value = Work(value);
+		}
+		sink.store(value, std::memory_order_relaxed);
+	};
+
+	auto runBare = [&]()
+	{
+		uint32_t value = sink.load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < scopeCount; ++i)
+		{
+			value = Work(value);
+		}
+		sink.store(value, std::memory_order_relaxed);
+	};
+
+	printf("Timing %u scopes on one thread, median of %u repeats\n\n", scopeCount, repeats);
+	printf("%-24s %12s %12s\n", "profiler", "median ms", "ns per scope");
+
+	auto printRow = [&](const char* name, double milliseconds, double baseline)
+	{
+		printf("%-24s %12.3f %12.2f\n", name, milliseconds, (milliseconds - baseline) * 1e6 / scopeCount);
+	};
+
+	double bare = MeasureMilliseconds(repeats, runBare);
+	printRow("no scopes", bare, bare);
+
+	SetProfilerEnabled(false);
+	printRow("disabled", MeasureMilliseconds(repeats, runScopes), bare);
+
+	SetProfilerEnabled(true);
+	printRow("recording", MeasureMilliseconds(repeats, runScopes), bare);
+	SetProfilerEnabled(false);
+
+	// Nested scopes from every job thread, exported as a trace like a capture of the engine would be.
+	FJobSystem jobSystem(threads);
+	const uint32_t batchSize = 256;
+	const uint32_t frames = 16;
+
+	BeginProfilerCapture();
+	auto exportStart = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		MORPHEUS_PROFILE_FRAME();
+		MORPHEUS_PROFILE_SCOPE("Frame");
+
+		jobSystem.ParallelFor(scopeCount / frames, batchSize, [&](uint32_t begin, uint32_t end)
+		{
+			MORPHEUS_PROFILE_SCOPE("Batch");
+			uint32_t value = begin;
+			for (uint32_t i = begin; i < end; i += 16)
+			{
+				MORPHEUS_PROFILE_SCOPE("Item");
+				value = Work(value);
+			}
+			sink.store(value, std::memory_order_relaxed);
+		});
+
+		MORPHEUS_PROFILE_COUNTER("Frame number", frame);
+	}
+	double recordMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - exportStart).count();
+
+	const char* traceFileName = "ProfilerBenchmark.json";
+	std::string error;
+	exportStart = std::chrono::steady_clock::now();
+	if (!EndProfilerCapture(traceFileName, &error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	double exportMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - exportStart).count();
+
+	FILE* file = std::fopen(traceFileName, "rb");
+	long traceBytes = 0;
+	if (file)
+	{
+		std::fseek(file, 0, SEEK_END);
+		traceBytes = std::ftell(file);
+		std::fclose(file);
+	}
+	std::remove(traceFileName);
+
+	FProfilerStats stats = GetProfilerStats();
+	printf("\n%u frames on %u job threads recorded in %.3f ms, trace of %ld bytes written in %.3f ms\n", frames, jobSystem.GetConcurrency(),
+		recordMilliseconds, traceBytes, exportMilliseconds);
+	printf("%u threads, %llu events recorded, %llu overwritten\n", stats.Threads, static_cast<unsigned long long>(stats.EventsRecorded),
+		static_cast<unsigned long long>(stats.EventsOverwritten));
+
+	return 0;
+}
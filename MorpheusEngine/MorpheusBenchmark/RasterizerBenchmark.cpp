@@ -0,0 +1,120 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+#include "CubeScene.h"
+
+#include "ConstantBufferRing.h"
+#include "JobSystem.h"
+#include "SoftwareRenderDevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Hash of the colour buffer of the default scene at the default size. Only compared when both are
+	// unchanged; rerun with --output= and look at the image before updating it.
+	const uint32_t GoldenWidth = 1280;
+	const uint32_t GoldenHeight = 720;
+	const uint32_t GoldenGridSide = 32;
+	const uint64_t GoldenImageHash = 0x303921adcfc727a4ull;
+
+}
+
+int RunRasterizerBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t width = GoldenWidth;
+	uint32_t height = GoldenHeight;
+	uint32_t gridSide = GoldenGridSide;
+	uint32_t frames = 31;
+	uint32_t threads = 0;
+	std::string output;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "width", width) &&
+			!ParseOption(arguments[i], "height", height) &&
+			!ParseOption(arguments[i], "grid", gridSide) &&
+			!ParseOption(arguments[i], "frames", frames) &&
+			!ParseOption(arguments[i], "threads", threads) &&
+			!ParseOption(arguments[i], "output", output))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	width = std::max(1u, width);
+	height = std::max(1u, height);
+	frames = std::max(1u, frames);
+
+	FJobSystem jobSystem(threads);
+	FSoftwareRenderDevice device(width, height, &jobSystem);
+	FConstantBufferRing ring(&device);
+
+	FCubeScene scene;
+	BuildCubeScene(scene, width, height, gridSide);
+
+	FCubeResources resources;
+	if (!CreateCubeResources(device, scene, resources))
+	{
+		fprintf(stderr, "Failed to create the cube resources\n");
+		return 1;
+	}
+
+	// The first frame creates the ring pages and is not measured.
+	std::vector<double> samples;
+	for (uint32_t frame = 0; frame <= frames; ++frame)
+	{
+		auto start = std::chrono::steady_clock::now();
+		RenderCubeScene(device, ring, resources, scene);
+		auto end = std::chrono::steady_clock::now();
+
+		if (frame > 0)
+		{
+			samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+	}
+
+	const FSoftwareRasterizerStats& stats = device.GetLastFrameRasterizerStats();
+	double milliseconds = Median(samples);
+	uint64_t imageHash = HashColourBuffer(device);
+
+	printf("Cube scene of %zu cubes at %ux%u, median of %u frames, %u job threads\n\n", scene.WorldMatrices.size(), width, height, frames, jobSystem.GetConcurrency());
+	printf("%-24s %12s %12s %12s %14s\n", "path", "median ms", "triangles", "pixels", "Mpixels/s");
+	printf("%-24s %12.3f %12llu %12llu %14.1f\n", "draw per object", milliseconds, static_cast<unsigned long long>(stats.TrianglesRasterized),
+		static_cast<unsigned long long>(stats.PixelsWritten), milliseconds > 0.0 ? stats.PixelsWritten / (milliseconds * 1e3) : 0.0);
+	printf("\nTriangles: %llu submitted, %llu culled, %llu clipped, %llu draws skipped\n", static_cast<unsigned long long>(stats.TrianglesSubmitted),
+		static_cast<unsigned long long>(stats.TrianglesCulled), static_cast<unsigned long long>(stats.TrianglesClipped), static_cast<unsigned long long>(stats.SkippedDraws));
+	printf("Image hash: 0x%016llx\n", static_cast<unsigned long long>(imageHash));
+
+	if (!output.empty() && !device.WriteColourBuffer(output.c_str()))
+	{
+		fprintf(stderr, "Could not write '%s'\n", output.c_str());
+	}
+
+	uint32_t failures = 0;
+
+	auto fail = [&failures](const char* message)
+	{
+		fprintf(stderr, "FAILED: %s\n", message);
+		++failures;
+	};
+
+	if (stats.SkippedDraws > 0 || stats.PixelsWritten == 0)
+	{
+		fail("the software device skipped draws of the cube pipeline");
+	}
+
+	if (width == GoldenWidth && height == GoldenHeight && gridSide == GoldenGridSide && imageHash != GoldenImageHash)
+	{
+		fprintf(stderr, "Expected image hash 0x%016llx\n", static_cast<unsigned long long>(GoldenImageHash));
+		fail("the cube scene does not match the golden image");
+	}
+
+	DestroyCubeResources(device, resources);
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,330 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "NullRenderDevice.h"
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+	double Megabytes(uint64_t bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+
+	FTextureDesc MakeTarget(uint32_t width, uint32_t height, ETextureFormat format)
+	{
+		FTextureDesc description;
+		description.Width = std::max(1u, width);
+		description.Height = std::max(1u, height);
+		description.Format = format;
+		description.Bindings = format == ETextureFormat::D24S8 ? TextureBinding_DepthStencil | TextureBinding_ShaderResource : TextureBinding_RenderTarget | TextureBinding_ShaderResource;
+
+		return description;
+	}
+
+	struct FFrameGraph
+	{
+		std::vector<FRenderGraphTexture> Textures;
+		std::vector<const char*> TextureNames;
+		// Passes that must be culled and passes that must be kept.
+		uint32_t DebugPass = 0;
+		uint32_t ReadbackPass = 0;
+		// Set by a pass that found one of its textures without a device texture behind it.
+		bool MissingTexture = false;
+	};
+
+	// A deferred frame: shadows, depth prepass, G-buffer, ambient occlusion, lighting, a bloom chain,
+	// tone mapping into the back buffer, a debug view nobody reads and a luminance readback.
+	void BuildFrame(FRenderGraph& graph, IRenderDevice& renderDevice, uint32_t width, uint32_t height, FFrameGraph& frame)
+	{
+		graph.Reset();
+		frame.Textures.clear();
+		frame.TextureNames.clear();
+
+		auto addTexture = [&](const char* name, uint32_t textureWidth, uint32_t textureHeight, ETextureFormat format)
+		{
+			frame.Textures.push_back(graph.CreateTexture(name, MakeTarget(textureWidth, textureHeight, format)));
+			frame.TextureNames.push_back(name);
+			return frame.Textures.back();
+		};
+
+		// Binds what the pass writes, as a real pass would, and checks everything it touches is there.
+		auto addPass = [&](const char* name, std::initializer_list<FRenderGraphTexture> reads, std::initializer_list<FRenderGraphTexture> writes)
+		{
+			std::vector<FRenderGraphTexture> used(reads);
+			used.insert(used.end(), writes.begin(), writes.end());
+			FRenderGraphTexture target = *writes.begin();
+
+			FFrameGraph* frameGraph = &frame;
+			uint32_t index = graph.AddPass(name, [used, target, frameGraph](IRenderDevice& device, const FRenderGraph& passGraph)
+			{
+				for (FRenderGraphTexture texture : used)
+				{
+					frameGraph->MissingTexture = frameGraph->MissingTexture || !passGraph.GetTexture(texture).IsValid();
+				}
+
+				FTextureHandle texture = passGraph.GetTexture(target);
+				bool depth = device.GetTextureDesc(texture).Format == ETextureFormat::D24S8;
+				device.SetRenderTargets(depth ? FTextureHandle() : texture, depth ? texture : FTextureHandle());
+				device.DrawIndexed(3, 0, 0);
+			});
+
+			for (FRenderGraphTexture read : reads)
+			{
+				graph.Read(index, read);
+			}
+			for (FRenderGraphTexture write : writes)
+			{
+				graph.Write(index, write);
+			}
+
+			return index;
+		};
+
+		FRenderGraphTexture backBuffer = graph.ImportTexture("Back buffer", renderDevice.GetBackBuffer(), renderDevice.GetTextureDesc(renderDevice.GetBackBuffer()));
+
+		FRenderGraphTexture shadowMap = addTexture("Shadow map", 2048, 2048, ETextureFormat::D24S8);
+		FRenderGraphTexture depth = addTexture("Depth", width, height, ETextureFormat::D24S8);
+		FRenderGraphTexture albedo = addTexture("Albedo", width, height, ETextureFormat::RGBA8);
+		FRenderGraphTexture normals = addTexture("Normals", width, height, ETextureFormat::RGBA16Float);
+		FRenderGraphTexture material = addTexture("Material", width, height, ETextureFormat::RGBA8);
+		FRenderGraphTexture occlusion = addTexture("Occlusion", width / 2, height / 2, ETextureFormat::R32Float);
+		FRenderGraphTexture blurredOcclusion = addTexture("Blurred occlusion", width / 2, height / 2, ETextureFormat::R32Float);
+		FRenderGraphTexture lighting = addTexture("Lighting", width, height, ETextureFormat::RGBA16Float);
+		FRenderGraphTexture bloomHalf = addTexture("Bloom 1/2", width / 2, height / 2, ETextureFormat::RGBA16Float);
+		FRenderGraphTexture bloomQuarter = addTexture("Bloom 1/4", width / 4, height / 4, ETextureFormat::RGBA16Float);
+		FRenderGraphTexture bloomEighth = addTexture("Bloom 1/8", width / 8, height / 8, ETextureFormat::RGBA16Float);
+		FRenderGraphTexture bloomUpQuarter = addTexture("Bloom up 1/4", width / 4, height / 4, ETextureFormat::RGBA16Float);
+		FRenderGraphTexture bloomUpHalf = addTexture("Bloom up 1/2", width / 2, height / 2, ETextureFormat::RGBA16Float);
+		FRenderGraphTexture toneMapped = addTexture("Tone mapped", width, height, ETextureFormat::RGBA8);
+		FRenderGraphTexture debugView = addTexture("Debug view", width, height, ETextureFormat::RGBA8);
+		FRenderGraphTexture luminance = addTexture("Luminance", 1, 1, ETextureFormat::R32Float);
+
+		addPass("Shadows", {}, { shadowMap });
+		addPass("Depth prepass", {}, { depth });
+		addPass("G-buffer", { depth }, { albedo, normals, material, depth });
+		addPass("Occlusion", { depth, normals }, { occlusion });
+		addPass("Occlusion blur", { occlusion, depth }, { blurredOcclusion });
+		addPass("Lighting", { albedo, normals, material, blurredOcclusion, depth, shadowMap }, { lighting });
+		addPass("Bloom down 1/2", { lighting }, { bloomHalf });
+		addPass("Bloom down 1/4", { bloomHalf }, { bloomQuarter });
+		addPass("Bloom down 1/8", { bloomQuarter }, { bloomEighth });
+		addPass("Bloom up 1/4", { bloomEighth, bloomQuarter }, { bloomUpQuarter });
+		addPass("Bloom up 1/2", { bloomUpQuarter, bloomHalf }, { bloomUpHalf });
+		addPass("Tone mapping", { lighting, bloomUpHalf }, { toneMapped });
+		addPass("Anti-aliasing", { toneMapped }, { backBuffer });
+		frame.DebugPass = addPass("Debug view", { normals, blurredOcclusion }, { debugView });
+		frame.ReadbackPass = addPass("Luminance readback", { lighting }, { luminance });
+		graph.SetSideEffects(frame.ReadbackPass);
+	}
+
+	// Two transients that share an allocation must have the same description and must not be in use
+	// during the same pass.
+	bool CheckAliasing(const FRenderGraph& graph, const std::vector<FRenderGraphTexture>& textures, IRenderDevice& renderDevice)
+	{
+		for (size_t a = 0; a < textures.size(); ++a)
+		{
+			for (size_t b = a + 1; b < textures.size(); ++b)
+			{
+				uint32_t allocation = graph.GetAllocation(textures[a]);
+				if (allocation == FRenderGraph::InvalidIndex || allocation != graph.GetAllocation(textures[b]))
+				{
+					continue;
+				}
+
+				bool overlap = graph.GetFirstUse(textures[a]) <= graph.GetLastUse(textures[b]) && graph.GetFirstUse(textures[b]) <= graph.GetLastUse(textures[a]);
+				bool sameDescription = renderDevice.GetTextureDesc(graph.GetTexture(textures[a])) == renderDevice.GetTextureDesc(graph.GetTexture(textures[b]));
+				if (overlap || !sameDescription)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+}
+
+int RunRenderGraphBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t frames = 1000;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "width", width) &&
+			!ParseOption(arguments[i], "height", height) &&
+			!ParseOption(arguments[i], "frames", frames))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	width = std::max(8u, width);
+	height = std::max(8u, height);
+	frames = std::max(1u, frames);
+
+	FNullRenderDevice renderDevice(false);
+	renderDevice.ResizeBackBuffer(width, height);
+
+	FRenderGraph graph;
+	FRenderGraphTexturePool pool(&renderDevice);
+	FFrameGraph frame;
+	uint32_t failures = 0;
+
+	auto fail = [&failures](const char* message)
+	{
+		fprintf(stderr, "FAILED: %s\n", message);
+		++failures;
+	};
+
+	auto runFrame = [&]()
+	{
+		std::string error;
+		if (!graph.Compile(&error))
+		{
+			fail(error.c_str());
+			return;
+		}
+
+		graph.Execute(renderDevice, pool);
+		renderDevice.Present(false);
+		pool.EndFrame();
+	};
+
+	BuildFrame(graph, renderDevice, width, height, frame);
+	runFrame();
+
+	printf("Frame graph at %ux%u\n\n", width, height);
+	printf("%-5s %-20s\n", "pass", "name");
+	for (uint32_t pass = 0; pass < graph.GetPassCount(); ++pass)
+	{
+		printf("%-5u %-20s %s\n", pass, graph.GetPassName(pass), graph.IsPassCulled(pass) ? "culled" : "");
+	}
+
+	printf("\n%-20s %12s %8s %8s %11s\n", "texture", "size", "first", "last", "allocation");
+	for (size_t i = 0; i < frame.Textures.size(); ++i)
+	{
+		FRenderGraphTexture texture = frame.Textures[i];
+		uint32_t allocation = graph.GetAllocation(texture);
+		if (allocation == FRenderGraph::InvalidIndex)
+		{
+			continue;
+		}
+
+		const FTextureDesc& description = renderDevice.GetTextureDesc(graph.GetTexture(texture));
+		char size[32];
+		snprintf(size, sizeof(size), "%ux%u", description.Width, description.Height);
+		printf("%-20s %12s %8u %8u %11u\n", frame.TextureNames[i], size, graph.GetFirstUse(texture), graph.GetLastUse(texture), allocation);
+	}
+
+	const FRenderGraphStats& stats = graph.GetStats();
+	printf("\n%u of %u passes culled, %u transient textures in %u allocations\n", stats.CulledPasses, stats.Passes, stats.TransientTextures, stats.Allocations);
+	printf("Transient memory: %.1f MB without aliasing, %.1f MB aliased (%.0f%% saved), %.1f MB live at peak\n", Megabytes(stats.UnaliasedBytes),
+		Megabytes(stats.AliasedBytes), stats.UnaliasedBytes > 0 ? 100.0 * (1.0 - static_cast<double>(stats.AliasedBytes) / stats.UnaliasedBytes) : 0.0,
+		Megabytes(stats.PeakLiveBytes));
+
+	if (!graph.IsPassCulled(frame.DebugPass))
+	{
+		fail("the debug view nobody reads was kept");
+	}
+	if (graph.IsPassCulled(frame.ReadbackPass) || stats.CulledPasses != 1)
+	{
+		fail("a pass with results was culled");
+	}
+	if (frame.MissingTexture)
+	{
+		fail("a pass ran without one of its textures");
+	}
+	if (!CheckAliasing(graph, frame.Textures, renderDevice))
+	{
+		fail("two textures in use at the same time share an allocation");
+	}
+
+	// Reading a transient nobody has written must not compile.
+	{
+		FRenderGraph broken;
+		FRenderGraphTexture texture = broken.CreateTexture("Unwritten", MakeTarget(width, height, ETextureFormat::RGBA8));
+		broken.Read(broken.AddPass("Reader", [](IRenderDevice&, const FRenderGraph&) {}), texture);
+
+		std::string error;
+		if (broken.Compile(&error))
+		{
+			fail("a read of an unwritten transient compiled");
+		}
+	}
+
+	// Steady frames take everything from the pool.
+	uint64_t createdBefore = pool.GetTexturesCreated();
+	std::vector<double> samples;
+	for (uint32_t i = 0; i < frames; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		BuildFrame(graph, renderDevice, width, height, frame);
+		std::string error;
+		graph.Compile(&error);
+		auto end = std::chrono::steady_clock::now();
+		samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+
+		graph.Execute(renderDevice, pool);
+		renderDevice.Present(false);
+		pool.EndFrame();
+	}
+
+	printf("Build and compile: %.1f us median over %u frames, %llu textures created after the first frame\n", Median(samples), frames,
+		static_cast<unsigned long long>(pool.GetTexturesCreated() - createdBefore));
+
+	if (pool.GetTexturesCreated() != createdBefore)
+	{
+		fail("steady frames created textures");
+	}
+
+	// A resize empties the pool, a size that stops being asked for ages out of it. Either way the
+	// device ends up holding the back buffer and one frame's allocations and nothing else.
+	const uint32_t sizes[][2] = { { width / 2, height / 2 }, { width, height } };
+	for (const uint32_t* size : sizes)
+	{
+		renderDevice.ResizeBackBuffer(size[0], size[1]);
+		pool.Reset();
+
+		BuildFrame(graph, renderDevice, size[0], size[1], frame);
+		runFrame();
+
+		if (renderDevice.GetLiveTextureCount() != 1 + graph.GetStats().Allocations)
+		{
+			fail("textures of the old size outlived a resize");
+		}
+	}
+
+	uint32_t resizedWidth = width - width / 4;
+	uint32_t resizedHeight = height - height / 4;
+	for (uint32_t i = 0; i <= FRenderGraphTexturePool::DefaultMaxIdleFrames; ++i)
+	{
+		BuildFrame(graph, renderDevice, resizedWidth, resizedHeight, frame);
+		runFrame();
+	}
+
+	printf("After resizing: %u textures alive on the device, %u in the pool holding %.1f MB\n", renderDevice.GetLiveTextureCount(), pool.GetTextureCount(),
+		Megabytes(pool.GetTextureBytes()));
+
+	if (renderDevice.GetLiveTextureCount() != 1 + graph.GetStats().Allocations)
+	{
+		fail("idle textures were not destroyed");
+	}
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "%u checks failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
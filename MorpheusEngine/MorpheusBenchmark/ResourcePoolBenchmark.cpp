@@ -0,0 +1,308 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "NullRenderDevice.h"
+#include "ResourcePool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Stands in for the device object behind a handle, a bit of state next to the API pointer.
+	struct FFakeResource
+	{
+		uint64_t Data[4];
+	};
+
+	uint32_t CountLines(const std::string& text, const char* prefix)
+	{
+		uint32_t count = 0;
+		size_t length = strlen(prefix);
+		for (size_t start = 0; start < text.size();)
+		{
+			size_t end = text.find('\n', start);
+			if (end == std::string::npos)
+			{
+				end = text.size();
+			}
+
+			if (text.compare(start, length, prefix) == 0 && start + length < end && text[start + length] == ' ')
+			{
+				++count;
+			}
+
+			start = end + 1;
+		}
+
+		return count;
+	}
+}
+
+int RunResourcePoolBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t resourceCount = 4096;
+	uint32_t bindCount = 1000000;
+	uint32_t repeats = 9;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "resources", resourceCount) &&
+			!ParseOption(arguments[i], "binds", bindCount) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	resourceCount = std::max(1u, std::min(resourceCount, ResourceHandleIndexMask + 1));
+	bindCount = std::max(1u, bindCount);
+	repeats = std::max(1u, repeats);
+
+	uint32_t failures = 0;
+
+	auto fail = [&failures](const char* message)
+	{
+		fprintf(stderr, "FAILED: %s\n", message);
+		++failures;
+	};
+
+	std::mt19937 random(1234);
+
+	// The same resources twice: by value in a pool, and each in its own allocation behind a shared
+	// pointer, allocated in shuffled order like a long running heap would hand them out.
+	TResourcePool<FBufferHandle, FFakeResource> pool;
+	std::vector<FBufferHandle> handles;
+	for (uint32_t i = 0; i < resourceCount; ++i)
+	{
+		handles.push_back(pool.Add({ { i, i, i, i } }));
+	}
+
+	std::vector<uint32_t> allocationOrder(resourceCount);
+	for (uint32_t i = 0; i < resourceCount; ++i)
+	{
+		allocationOrder[i] = i;
+	}
+	std::shuffle(allocationOrder.begin(), allocationOrder.end(), random);
+
+	std::vector<std::shared_ptr<FFakeResource>> sharedResources(resourceCount);
+	for (uint32_t i : allocationOrder)
+	{
+		sharedResources[i] = std::make_shared<FFakeResource>(FFakeResource{ { i, i, i, i } });
+	}
+
+	// Resources bound by the draws of a frame, in draw order.
+	std::vector<uint32_t> binds(bindCount);
+	std::uniform_int_distribution<uint32_t> resource(0, resourceCount - 1);
+	for (uint32_t& bind : binds)
+	{
+		bind = resource(random);
+	}
+
+	std::vector<FBufferHandle> bindHandles(bindCount);
+	for (uint32_t i = 0; i < bindCount; ++i)
+	{
+		bindHandles[i] = handles[binds[i]];
+	}
+
+	volatile uint64_t sink = 0;
+	uint64_t poolSum = 0;
+	uint64_t sharedSum = 0;
+
+	double poolMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		uint64_t sum = 0;
+		for (FBufferHandle handle : bindHandles)
+		{
+			const FFakeResource* bound = pool.Get(handle);
+			sum += bound ? bound->Data[0] : 0;
+		}
+		poolSum = sum;
+		sink = sink + sum;
+	});
+
+	// What a context binding shared pointers does: the bound slot holds a reference, so every bind
+	// is an increment of the new object's count and a decrement of the old one's.
+	double sharedMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		uint64_t sum = 0;
+		std::shared_ptr<FFakeResource> bound;
+		for (uint32_t bind : binds)
+		{
+			bound = sharedResources[bind];
+			sum += bound->Data[0];
+		}
+		sharedSum = sum;
+		sink = sink + sum;
+	});
+
+	printf("%u binds over %u resources, median of %u runs\n\n", bindCount, resourceCount, repeats);
+	printf("%-24s %12s %10s\n", "path", "median ms", "ns/bind");
+	printf("%-24s %12.3f %10.2f\n", "shared_ptr per bind", sharedMilliseconds, sharedMilliseconds * 1e6 / bindCount);
+	printf("%-24s %12.3f %10.2f\n", "pool handle lookup", poolMilliseconds, poolMilliseconds * 1e6 / bindCount);
+	printf("\nHandle lookups are %.2fx faster\n", poolMilliseconds > 0.0 ? sharedMilliseconds / poolMilliseconds : 0.0);
+
+	if (poolSum != sharedSum)
+	{
+		fail("the two paths bound different resources");
+	}
+
+	// A removed resource's handle stays dead after its slot is reused.
+	{
+		TResourcePool<FBufferHandle, FFakeResource> slots;
+		FBufferHandle first = slots.Add({ { 1, 0, 0, 0 } });
+		slots.Remove(first);
+
+		if (slots.Get(first) || slots.IsValid(first))
+		{
+			fail("a removed handle still finds its resource");
+		}
+
+		FBufferHandle second = slots.Add({ { 2, 0, 0, 0 } });
+		if ((second.Value & ResourceHandleIndexMask) != (first.Value & ResourceHandleIndexMask))
+		{
+			fail("the free slot was not reused");
+		}
+		if (second == first || slots.Get(first) || !slots.Get(second) || slots.Get(second)->Data[0] != 2)
+		{
+			fail("a stale handle finds the resource that reused its slot");
+		}
+
+		// Every generation of the slot hands out a new handle, then the slot is retired rather than
+		// wrapping back to handles that were given out before.
+		std::vector<uint32_t> values;
+		values.push_back(first.Value);
+		FBufferHandle current = second;
+		while (slots.GetSlotCount() == 1)
+		{
+			values.push_back(current.Value);
+			slots.Remove(current);
+			current = slots.Add({ { 3, 0, 0, 0 } });
+		}
+
+		std::sort(values.begin(), values.end());
+		if (values.size() != ResourceHandleMaxGeneration || std::adjacent_find(values.begin(), values.end()) != values.end())
+		{
+			fail("a slot handed out the same handle twice or was retired early");
+		}
+		if (slots.GetLiveCount() != 1 || !slots.Get(current))
+		{
+			fail("the slot after a retired one is not live");
+		}
+	}
+
+	// Once every index is in use, adding fails instead of running into the generation bits.
+	{
+		TResourcePool<FBufferHandle, FFakeResource> slots;
+		FBufferHandle last;
+		while (slots.CanAdd())
+		{
+			last = slots.Add({ { 4, 0, 0, 0 } });
+		}
+
+		FBufferHandle overflow = slots.Add({ { 5, 0, 0, 0 } });
+		if (slots.GetSlotCount() != ResourceHandleIndexMask + 1 || (last.Value & ResourceHandleIndexMask) != ResourceHandleIndexMask)
+		{
+			fail("the pool stopped before using every slot index");
+		}
+		if (overflow.IsValid() || slots.IsValid(overflow) || slots.GetLiveCount() != ResourceHandleIndexMask + 1 || slots.Get(last)->Data[0] != 4)
+		{
+			fail("a full pool handed out a handle");
+		}
+
+		slots.Remove(last);
+		if (!slots.CanAdd() || !slots.Add({ { 6, 0, 0, 0 } }).IsValid())
+		{
+			fail("a full pool did not reuse a freed slot");
+		}
+	}
+
+	// Objects come back in order, each only once its fence has completed.
+	{
+		TDeferredReleaseQueue<uint32_t> queue;
+		queue.Enqueue(1, 1);
+		queue.Enqueue(2, 1);
+		queue.Enqueue(3, 2);
+		queue.Enqueue(4, 4);
+
+		std::vector<uint32_t> released;
+		auto release = [&released](uint32_t object) { released.push_back(object); };
+
+		bool early = queue.Release(0, release) != 0;
+		bool first = queue.Release(1, release) == 2;
+		bool second = queue.Release(3, release) == 1;
+		bool pending = queue.GetPendingCount() == 1 && queue.GetLastFence() == 4;
+		bool last = queue.ReleaseAll(release) == 1 && queue.IsEmpty();
+
+		if (early || !first || !second || !pending || !last || released != std::vector<uint32_t>({ 1, 2, 3, 4 }))
+		{
+			fail("the release queue freed an object before its fence or out of order");
+		}
+	}
+
+	// The device reports exactly what was created and not destroyed.
+	{
+		FNullRenderDevice device(false);
+
+		FBufferDesc bufferDescription;
+		bufferDescription.Binding = EBufferBinding::Vertex;
+		bufferDescription.ByteWidth = 256;
+
+		FTextureDesc textureDescription;
+		textureDescription.Width = 64;
+		textureDescription.Height = 64;
+		textureDescription.Format = ETextureFormat::RGBA8;
+		textureDescription.Bindings = TextureBinding_RenderTarget;
+
+		uint8_t bytecodeData[4] = {};
+		FShaderBytecode bytecode = { bytecodeData, sizeof(bytecodeData) };
+
+		FBufferHandle keptBuffer = device.CreateBuffer(bufferDescription, nullptr);
+		FBufferHandle destroyedBuffer = device.CreateBuffer(bufferDescription, nullptr);
+		FVertexShaderHandle shader = device.CreateVertexShader(bytecode);
+		FTextureHandle texture = device.CreateTexture(textureDescription);
+		FRasterizerStateHandle state = device.CreateRasterizerState(FRasterizerDesc());
+
+		device.DestroyBuffer(destroyedBuffer);
+		device.DestroyTexture(texture);
+
+		std::string report;
+		uint32_t leaks = device.ReportLiveResources(report);
+		printf("\nLeak report with a buffer, a shader and a state left:\n%s", report.c_str());
+
+		if (leaks != 3 || CountLines(report, "Buffer") != 1 || CountLines(report, "VertexShader") != 1 || CountLines(report, "RasterizerState") != 1 ||
+			CountLines(report, "Texture") != 0)
+		{
+			fail("the leak report does not list exactly the resources left");
+		}
+		if (device.GetFrameStats().ResourcesDestroyed != 2 || device.GetLiveTextureCount() != 1)
+		{
+			fail("destroyed resources are still counted as live");
+		}
+
+		FBufferHandle reused = device.CreateBuffer(bufferDescription, nullptr);
+		if (reused == destroyedBuffer)
+		{
+			fail("a buffer reusing a slot got the destroyed buffer's handle");
+		}
+
+		device.DestroyBuffer(reused);
+		device.DestroyBuffer(keptBuffer);
+		device.DestroyVertexShader(shader);
+		device.DestroyRasterizerState(state);
+
+		report.clear();
+		if (device.ReportLiveResources(report) != 0 || !report.empty())
+		{
+			fail("resources are reported after everything was destroyed");
+		}
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "JobSystem.h"
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const char* sourceDirectory = "ShaderCacheBenchmark";
+	const char* cacheDirectory = "ShaderCacheBenchmark/Cache";
+
+	bool WriteTextFile(const std::string& path, const std::string& text)
+	{
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			return false;
+		}
+
+		bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+
+		return std::fclose(file) == 0 && written;
+	}
+
+	// Shaders that each include a shared header and one of a few material headers, the way real shaders
+	// share their lighting code.
+	bool WriteShaders(uint32_t shaderCount, std::vector<FShaderCompileRequest>& requests)
+	{
+		std::filesystem::create_directories(sourceDirectory);
+
+		std::string directory = std::string(sourceDirectory) + "/";
+		bool written = WriteTextFile(directory + "Common.hlsli", "cbuffer PerFrame : register(b1)\n{\n\tmatrix viewMatrix;\n}\n");
+
+		const uint32_t materialCount = 4;
+		for (uint32_t i = 0; i < materialCount; ++i)
+		{
+			written = written && WriteTextFile(directory + "Material" + std::to_string(i) + ".hlsli",
+				"#include \"Common.hlsli\"\nfloat4 Shade" + std::to_string(i) + "(float4 colour) { return colour * " + std::to_string(i + 1) + "; }\n");
+		}
+
+		for (uint32_t i = 0; i < shaderCount && written; ++i)
+		{
+			std::string fileName = directory + "Shader" + std::to_string(i) + ".hlsl";
+			std::string material = std::to_string(i % materialCount);
+
+			written = WriteTextFile(fileName, "#include \"Material" + material + ".hlsli\"\n#include <VertexInput.hlsli>\n"
+				"float4 main(float4 colour : COLOR) : SV_TARGET\n{\n\treturn Shade" + material + "(colour) + " + std::to_string(i) + ";\n}\n");
+
+			FShaderCompileRequest request;
+			request.FileName = fileName;
+			request.EntryPoint = "main";
+			request.Profile = "ps_5_0";
+			request.VirtualFiles.push_back({ "VertexInput.hlsli", "struct VertexInput { float3 position : POSITION; };\n" });
+			requests.push_back(request);
+		}
+
+		return written;
+	}
+}
+
+int RunShaderCacheBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t shaderCount = 64;
+	uint32_t compileMicroseconds = 5000;
+	uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t repeats = 5;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "shaders", shaderCount) &&
+			!ParseOption(arguments[i], "compile-us", compileMicroseconds) &&
+			!ParseOption(arguments[i], "threads", threadCount) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	shaderCount = std::max(1u, shaderCount);
+	threadCount = std::max(1u, threadCount);
+	repeats = std::max(1u, repeats);
+
+	std::vector<FShaderCompileRequest> requests;
+	if (!WriteShaders(shaderCount, requests))
+	{
+		fprintf(stderr, "Could not write the shaders to %s\n", sourceDirectory);
+		return 1;
+	}
+
+	// The stub compiler spins for the given time per shader, a stand-in for the HLSL compiler.
+	FStubShaderCompiler compiler(compileMicroseconds);
+	FShaderCache shaderCache(cacheDirectory, &compiler);
+	FJobSystem jobSystem(threadCount);
+	std::vector<FShaderCacheResult> results(shaderCount);
+
+	printf("Compiling %u shaders of %u us each through the cache, %u threads, median of %u runs\n\n", shaderCount, compileMicroseconds,
+		threadCount, repeats);
+	printf("%-16s %12s %10s %8s %8s\n", "pass", "median ms", "speedup", "hits", "misses");
+
+	struct FPass
+	{
+		const char* Name;
+		bool Cold;
+		FJobSystem* Jobs;
+	};
+
+	const FPass passes[] =
+	{
+		{ "cold serial", true, nullptr },
+		{ "cold parallel", true, &jobSystem },
+		{ "warm", false, &jobSystem },
+	};
+
+	double serialMilliseconds = 0.0;
+	bool succeeded = true;
+	for (const FPass& pass : passes)
+	{
+		shaderCache.ResetStats();
+		// Clears the cache before every run when cold, so each run compiles everything.
+		auto prepare = [&]()
+		{
+			if (pass.Cold)
+			{
+				std::error_code errorCode;
+				std::filesystem::remove_all(cacheDirectory, errorCode);
+			}
+		};
+		double milliseconds = MeasureMilliseconds(repeats, prepare, [&]()
+		{
+			shaderCache.Compile(requests.data(), shaderCount, results.data(), pass.Jobs);
+		});
+		serialMilliseconds = pass.Jobs ? serialMilliseconds : milliseconds;
+
+		for (const FShaderCacheResult& result : results)
+		{
+			succeeded = succeeded && result.Succeeded;
+		}
+
+		FShaderCacheStats stats = shaderCache.GetStats();
+		printf("%-16s %12.3f %9.2fx %8u %8u\n", pass.Name, milliseconds, serialMilliseconds / milliseconds, stats.Hits / repeats, stats.Misses / repeats);
+	}
+
+	printf("\n%u compiles in total for %u cold runs of %u shaders\n", compiler.GetCompileCount(), 2 * repeats, shaderCount);
+
+	std::error_code errorCode;
+	std::filesystem::remove_all(sourceDirectory, errorCode);
+
+	if (!succeeded)
+	{
+		fprintf(stderr, "Some shaders failed to compile\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,547 @@
+#include "Benchmarks.h"
+
+#include "JobSystem.h"
+#include "MeshFile.h"
+#include "MeshStreamer.h"
+#include "NullRenderDevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char* packFileName = "StreamingBenchmark.pack";
+	// Meshes on either side of the camera that a frame draws.
+	const int32_t viewRadius = 8;
+	// How far the camera moves along the row of meshes every frame.
+	const float cameraSpeed = 0.25f;
+
+	typedef std::chrono::steady_clock FClock;
+
+	double Milliseconds(FClock::time_point start, FClock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	double Percentile(std::vector<double> samples, double fraction)
+	{
+		std::sort(samples.begin(), samples.end());
+
+		return samples[std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))];
+	}
+
+	bool EvictFromFileCache(const char* path)
+	{
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+		int descriptor = open(path, O_RDONLY);
+		if (descriptor < 0)
+		{
+			return false;
+		}
+
+		bool evicted = fdatasync(descriptor) == 0 && posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		close(descriptor);
+
+		return evicted;
+#else
+		(void)path;
+		return false;
+#endif
+	}
+
+	// A displaced grid of positions and normals, a different one for every mesh of the pack.
+	FMeshData MakeGridMesh(uint32_t side, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+
+		FMeshData mesh;
+		mesh.VertexCount = side * side;
+		mesh.Streams.resize(1);
+
+		FMeshStreamData& stream = mesh.Streams[0];
+		stream.Stride = 24;
+		stream.Elements.push_back({ EMeshSemantic::Position, 0, EVertexFormat::Float3, 0 });
+		stream.Elements.push_back({ EMeshSemantic::Normal, 0, EVertexFormat::Float3, 12 });
+		stream.Data.resize(size_t(stream.Stride) * mesh.VertexCount);
+
+		float* vertex = reinterpret_cast<float*>(stream.Data.data());
+		for (uint32_t y = 0; y < side; ++y)
+		{
+			for (uint32_t x = 0; x < side; ++x, vertex += 6)
+			{
+				vertex[0] = static_cast<float>(x);
+				vertex[1] = height(random);
+				vertex[2] = static_cast<float>(y);
+				vertex[3] = 0.0f;
+				vertex[4] = 1.0f;
+				vertex[5] = 0.0f;
+			}
+		}
+
+		for (uint32_t y = 0; y + 1 < side; ++y)
+		{
+			for (uint32_t x = 0; x + 1 < side; ++x)
+			{
+				uint32_t corner = y * side + x;
+				mesh.Indices.insert(mesh.Indices.end(), { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	// Where the camera is in frame, in meshes along the row. Halfway through it jumps to the far end,
+	// the worst case for a frame: a whole view that is not loaded.
+	float CameraPosition(uint32_t frame, uint32_t frames, uint32_t meshCount)
+	{
+		float position = frame * cameraSpeed;
+		if (frame >= frames / 2)
+		{
+			position = (meshCount - 1) - (frame - frames / 2) * cameraSpeed;
+		}
+
+		return std::max(0.0f, std::min(position, static_cast<float>(meshCount - 1)));
+	}
+
+	void GetView(float camera, uint32_t meshCount, int32_t& first, int32_t& last)
+	{
+		int32_t centre = static_cast<int32_t>(std::lround(camera));
+		first = std::max(0, centre - viewRadius);
+		last = std::min(static_cast<int32_t>(meshCount) - 1, centre + viewRadius);
+	}
+
+	struct FWalkResult
+	{
+		double FirstFrameMilliseconds = 0.0;
+		// Until every mesh of the first view could be drawn.
+		double FullViewMilliseconds = 0.0;
+		double WorstFrameMilliseconds = 0.0;
+		double P99FrameMilliseconds = 0.0;
+		// Draws skipped because the mesh was not resident yet.
+		uint64_t MissingDraws = 0;
+	};
+
+	void PrintWalk(const char* name, const FWalkResult& result)
+	{
+		printf("%-26s %11.2f %11.2f %11.3f %11.3f %9llu\n", name, result.FirstFrameMilliseconds, result.FullViewMilliseconds, result.WorstFrameMilliseconds,
+			result.P99FrameMilliseconds, static_cast<unsigned long long>(result.MissingDraws));
+	}
+
+	// Every mesh the view needs is loaded inside the frame that first needs it.
+	FWalkResult WalkSynchronous(const FMeshPack& pack, uint32_t frames)
+	{
+		FNullRenderDevice device(false);
+		std::vector<FMeshBuffers> meshes(pack.GetMeshCount());
+		std::vector<double> frameMilliseconds;
+		FWalkResult result;
+
+		auto start = FClock::now();
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			auto frameStart = FClock::now();
+
+			int32_t first;
+			int32_t last;
+			GetView(CameraPosition(frame, frames, pack.GetMeshCount()), pack.GetMeshCount(), first, last);
+
+			for (uint32_t mesh = 0; mesh < meshes.size(); ++mesh)
+			{
+				bool visible = static_cast<int32_t>(mesh) >= first && static_cast<int32_t>(mesh) <= last;
+				if (!visible && meshes[mesh].IndexBuffer.IsValid())
+				{
+					DestroyMeshBuffers(&device, meshes[mesh]);
+				}
+				else if (visible && !meshes[mesh].IndexBuffer.IsValid())
+				{
+					FMeshFile file;
+					if (pack.OpenMesh(mesh, file))
+					{
+						CreateMeshBuffers(&device, file, meshes[mesh]);
+					}
+				}
+			}
+			device.Present(false);
+
+			auto frameEnd = FClock::now();
+			frameMilliseconds.push_back(Milliseconds(frameStart, frameEnd));
+
+			if (frame == 0)
+			{
+				result.FirstFrameMilliseconds = Milliseconds(start, frameEnd);
+				result.FullViewMilliseconds = result.FirstFrameMilliseconds;
+			}
+		}
+
+		for (FMeshBuffers& mesh : meshes)
+		{
+			DestroyMeshBuffers(&device, mesh);
+		}
+
+		result.WorstFrameMilliseconds = *std::max_element(frameMilliseconds.begin(), frameMilliseconds.end());
+		result.P99FrameMilliseconds = Percentile(frameMilliseconds, 0.99);
+
+		return result;
+	}
+
+	// The view is requested by distance to the camera and drawn as far as it is resident. Meshes that
+	// leave the view before they arrive are cancelled.
+	FWalkResult WalkStreaming(const FMeshPack& pack, uint32_t frames, uint64_t budget, FJobSystem* jobSystem, uint32_t ioThreads, FMeshStreamerStats& stats)
+	{
+		FNullRenderDevice device(false);
+		std::vector<double> frameMilliseconds;
+		FWalkResult result;
+
+		auto start = FClock::now();
+		FMeshStreamer streamer(pack, &device, budget, jobSystem, ioThreads);
+		std::vector<bool> wanted(pack.GetMeshCount(), false);
+		bool firstViewComplete = false;
+
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			auto frameStart = FClock::now();
+
+			float camera = CameraPosition(frame, frames, pack.GetMeshCount());
+			int32_t first;
+			int32_t last;
+			GetView(camera, pack.GetMeshCount(), first, last);
+
+			for (uint32_t mesh = 0; mesh < wanted.size(); ++mesh)
+			{
+				bool visible = static_cast<int32_t>(mesh) >= first && static_cast<int32_t>(mesh) <= last;
+				if (visible)
+				{
+					streamer.Request(mesh, std::fabs(mesh - camera));
+				}
+				else if (wanted[mesh])
+				{
+					streamer.Cancel(mesh);
+				}
+				wanted[mesh] = visible;
+			}
+
+			streamer.Update();
+
+			uint32_t missing = 0;
+			for (int32_t mesh = first; mesh <= last; ++mesh)
+			{
+				missing += streamer.GetMesh(mesh) ? 0 : 1;
+			}
+			result.MissingDraws += missing;
+			device.Present(false);
+
+			auto frameEnd = FClock::now();
+			frameMilliseconds.push_back(Milliseconds(frameStart, frameEnd));
+
+			if (frame == 0)
+			{
+				result.FirstFrameMilliseconds = Milliseconds(start, frameEnd);
+			}
+			if (!firstViewComplete && missing == 0)
+			{
+				result.FullViewMilliseconds = Milliseconds(start, frameEnd);
+				firstViewComplete = true;
+			}
+
+			// Frames come at a steady rate, not as fast as the loop can go.
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		result.WorstFrameMilliseconds = *std::max_element(frameMilliseconds.begin(), frameMilliseconds.end());
+		result.P99FrameMilliseconds = Percentile(frameMilliseconds, 0.99);
+		stats = streamer.GetStats();
+
+		return result;
+	}
+
+	// Updates until nothing is pending, or gives up after ten seconds.
+	bool Drain(FMeshStreamer& streamer, FNullRenderDevice& device)
+	{
+		auto start = FClock::now();
+		while (streamer.GetPendingCount() > 0)
+		{
+			if (Milliseconds(start, FClock::now()) > 10000.0)
+			{
+				return false;
+			}
+
+			streamer.Update();
+			device.Present(false);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		return true;
+	}
+
+	// Waits until the meshes are checked and wait for Update().
+	bool WaitUntilReady(FMeshStreamer& streamer, uint32_t firstMesh, uint32_t meshCount)
+	{
+		auto start = FClock::now();
+		for (uint32_t mesh = firstMesh; mesh < firstMesh + meshCount; ++mesh)
+		{
+			while (streamer.GetState(mesh) != EStreamingState::Ready)
+			{
+				if (Milliseconds(start, FClock::now()) > 10000.0)
+				{
+					return false;
+				}
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		return true;
+	}
+}
+
+int RunStreamingBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t meshCount = 512;
+	uint32_t side = 64;
+	uint32_t budgetMegabytes = 8;
+	uint32_t frames = 600;
+	uint32_t threads = 0;
+	uint32_t ioThreads = FMeshStreamer::DefaultIoThreadCount;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "meshes", meshCount) &&
+			!ParseOption(arguments[i], "side", side) &&
+			!ParseOption(arguments[i], "budget-mb", budgetMegabytes) &&
+			!ParseOption(arguments[i], "frames", frames) &&
+			!ParseOption(arguments[i], "threads", threads) &&
+			!ParseOption(arguments[i], "io-threads", ioThreads))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	meshCount = std::max(2u * viewRadius + 2, meshCount);
+	// 16 bit indices.
+	side = std::max(2u, std::min(side, 256u));
+	frames = std::max(2u, frames);
+	ioThreads = std::max(1u, ioThreads);
+
+	std::mt19937 random(25);
+	std::vector<std::vector<uint8_t>> meshBytes(meshCount);
+	std::vector<FMeshPackSource> sources(meshCount);
+	std::string error;
+	for (uint32_t i = 0; i < meshCount; ++i)
+	{
+		if (!SerializeMeshFile(MakeGridMesh(side, random), meshBytes[i], &error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+
+		sources[i].Name = "Tile" + std::to_string(i);
+		sources[i].Data = meshBytes[i].data();
+		sources[i].Size = meshBytes[i].size();
+	}
+
+	if (!WriteMeshPack(packFileName, sources, &error))
+	{
+		fprintf(stderr, "%s: %s\n", packFileName, error.c_str());
+		return 1;
+	}
+	meshBytes.clear();
+
+	FMeshPack pack;
+	if (!pack.Open(packFileName))
+	{
+		fprintf(stderr, "%s: %s\n", packFileName, pack.GetError());
+		return 1;
+	}
+
+	FMeshFile probe;
+	pack.OpenMesh(0, probe);
+	uint64_t bytesPerMesh = FMeshStreamer::GetMeshBytes(probe);
+	uint64_t budget = uint64_t(budgetMegabytes) << 20;
+
+	// The budget has to hold at least the view, or streaming can never finish it.
+	uint64_t viewBytes = (2 * viewRadius + 1) * bytesPerMesh;
+	if (budget < viewBytes)
+	{
+		budget = viewBytes;
+		printf("Budget raised to the %.1f MB of one view\n", viewBytes / (1024.0 * 1024.0));
+	}
+
+	FJobSystem jobSystem(threads);
+	uint32_t failures = 0;
+
+	auto fail = [&failures](const char* message)
+	{
+		fprintf(stderr, "FAILED: %s\n", message);
+		++failures;
+	};
+
+	bool cold = EvictFromFileCache(packFileName);
+	printf("Walking a row of %u meshes of %.0f KB, %u frames with a jump to the far end halfway, %.1f MB budget, %u I/O threads, %u job threads\n",
+		meshCount, bytesPerMesh / 1024.0, frames, budget / (1024.0 * 1024.0), ioThreads, jobSystem.GetConcurrency());
+	printf("File cache %s before each walk\n\n", cold ? "dropped" : "warm, dropping it is not supported on this platform,");
+	printf("%-26s %11s %11s %11s %11s %9s\n", "path", "first ms", "view ms", "worst ms", "p99 ms", "missing");
+
+	FWalkResult synchronous = WalkSynchronous(pack, frames);
+	PrintWalk("synchronous loads", synchronous);
+
+	EvictFromFileCache(packFileName);
+	FMeshStreamerStats stats;
+	FWalkResult streaming = WalkStreaming(pack, frames, budget, &jobSystem, ioThreads, stats);
+	PrintWalk("streaming", streaming);
+
+	printf("\nStreaming: %llu requests, %llu cancelled, %llu loaded, %llu evicted, %.1f MB read, %.1f MB peak resident, %.3f ms longest update, %llu budget stalls\n",
+		static_cast<unsigned long long>(stats.Requests), static_cast<unsigned long long>(stats.Cancelled), static_cast<unsigned long long>(stats.Loaded),
+		static_cast<unsigned long long>(stats.Evicted), stats.BytesRead / (1024.0 * 1024.0), stats.PeakResidentBytes / (1024.0 * 1024.0),
+		stats.MaxUpdateNanoseconds * 1e-6, static_cast<unsigned long long>(stats.BudgetStalls));
+
+	if (stats.PeakResidentBytes > budget)
+	{
+		fail("streaming went over the memory budget");
+	}
+	if (stats.Failed > 0)
+	{
+		fail("a valid mesh failed to stream");
+	}
+	if (streaming.FullViewMilliseconds == 0.0)
+	{
+		fail("the first view never became resident");
+	}
+
+	// Cancelled meshes never become resident, the others all do.
+	{
+		FNullRenderDevice device(false);
+		FMeshStreamer streamer(pack, &device, ~0ull, &jobSystem, ioThreads);
+
+		uint32_t count = std::min(meshCount, 64u);
+		for (uint32_t mesh = 0; mesh < count; ++mesh)
+		{
+			streamer.Request(mesh, static_cast<float>(mesh));
+		}
+		for (uint32_t mesh = 1; mesh < count; mesh += 2)
+		{
+			streamer.Cancel(mesh);
+		}
+
+		if (!Drain(streamer, device))
+		{
+			fail("requests were still pending after ten seconds");
+		}
+
+		bool wrong = false;
+		for (uint32_t mesh = 0; mesh < count; ++mesh)
+		{
+			EStreamingState expected = (mesh % 2) ? EStreamingState::Unloaded : EStreamingState::Resident;
+			wrong = wrong || streamer.GetState(mesh) != expected || (streamer.GetMesh(mesh) != nullptr) != (expected == EStreamingState::Resident);
+		}
+
+		if (wrong || streamer.GetStats().Cancelled != count / 2)
+		{
+			fail("a cancelled mesh became resident or a requested one did not");
+		}
+	}
+
+	// With room for one upload a frame, checked meshes become resident strictly by priority.
+	{
+		FNullRenderDevice device(false);
+		FMeshStreamer streamer(pack, &device, ~0ull, &jobSystem, ioThreads, 1);
+
+		const uint32_t count = 16;
+		for (uint32_t mesh = 0; mesh < count; ++mesh)
+		{
+			streamer.Request(mesh, static_cast<float>(count - mesh));
+		}
+
+		if (!WaitUntilReady(streamer, 0, count))
+		{
+			fail("requests were not checked after ten seconds");
+		}
+
+		bool ordered = true;
+		for (uint32_t frame = 0; frame < count; ++frame)
+		{
+			streamer.Update();
+
+			uint32_t expected = count - 1 - frame;
+			ordered = ordered && streamer.GetState(expected) == EStreamingState::Resident && (expected == 0 || streamer.GetState(expected - 1) == EStreamingState::Ready);
+		}
+
+		if (!ordered)
+		{
+			fail("meshes were uploaded out of priority order");
+		}
+	}
+
+	// A full budget makes room by evicting the least recently used mesh, never one drawn last frame.
+	{
+		FNullRenderDevice device(false);
+		FMeshStreamer streamer(pack, &device, 4 * bytesPerMesh, &jobSystem, ioThreads);
+
+		for (uint32_t mesh = 0; mesh < 4; ++mesh)
+		{
+			streamer.Request(mesh, 0.0f);
+		}
+		if (!Drain(streamer, device))
+		{
+			fail("the first four meshes did not load");
+		}
+
+		// Mesh 2 was drawn longest ago, mesh 1 last.
+		streamer.GetMesh(2);
+		streamer.Update();
+		streamer.GetMesh(0);
+		streamer.GetMesh(3);
+		streamer.Update();
+		streamer.GetMesh(1);
+		streamer.Update();
+
+		streamer.Request(4, 0.0f);
+		if (!Drain(streamer, device))
+		{
+			fail("the fifth mesh did not load");
+		}
+
+		bool evictedLeastRecent = streamer.GetState(2) == EStreamingState::Unloaded && streamer.GetState(4) == EStreamingState::Resident;
+		for (uint32_t mesh : { 0u, 1u, 3u })
+		{
+			evictedLeastRecent = evictedLeastRecent && streamer.GetState(mesh) == EStreamingState::Resident;
+		}
+
+		if (!evictedLeastRecent || streamer.GetStats().Evicted != 1 || streamer.GetStats().ResidentBytes > 4 * bytesPerMesh)
+		{
+			fail("eviction did not pick the least recently used mesh");
+		}
+
+		// Everything in use: the new mesh waits rather than going over the budget.
+		for (uint32_t mesh : { 0u, 1u, 3u, 4u })
+		{
+			streamer.GetMesh(mesh);
+		}
+		streamer.Request(5, 0.0f);
+		if (!WaitUntilReady(streamer, 5, 1))
+		{
+			fail("the sixth mesh was not checked after ten seconds");
+		}
+
+		streamer.Update();
+		if (streamer.GetState(5) != EStreamingState::Ready || streamer.GetStats().Evicted != 1 || streamer.GetStats().BudgetStalls == 0)
+		{
+			fail("a mesh in use was evicted");
+		}
+	}
+
+	pack.Close();
+	std::remove(packFileName);
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,422 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "BoundingVolumeHierarchy.h"
+#include "ConstantBufferRing.h"
+#include "DrawList.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+#include "MemoryArena.h"
+#include "NullRenderDevice.h"
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const uint32_t ChildrenPerGroup = 16;
+	const uint32_t PipelineCount = 8;
+	const uint32_t MaterialCount = 64;
+	const uint32_t MeshCount = 32;
+	const float NearPlane = 0.1f;
+
+	// XMMatrixPerspectiveFovLH(60 degrees, 16:9) looking along +z from the origin.
+	FFloat4x4 CameraViewProjection(float farPlane)
+	{
+		float yScale = 1.0f / std::tan(0.5f * 60.0f * 3.14159265f / 180.0f);
+		float range = farPlane / (farPlane - NearPlane);
+
+		FFloat4x4 viewProjection = {};
+		viewProjection.M[0][0] = yScale * 9.0f / 16.0f;
+		viewProjection.M[1][1] = yScale;
+		viewProjection.M[2][2] = range;
+		viewProjection.M[2][3] = 1.0f;
+		viewProjection.M[3][2] = -range * NearPlane;
+
+		return viewProjection;
+	}
+
+	// "1k", "100k", "1M" for round sizes, the plain count otherwise.
+	std::string FormatObjectCount(uint32_t objects)
+	{
+		if (objects >= 1000000 && objects % 1000000 == 0)
+		{
+			return std::to_string(objects / 1000000) + "M";
+		}
+		if (objects >= 1000 && objects % 1000 == 0)
+		{
+			return std::to_string(objects / 1000) + "k";
+		}
+		return std::to_string(objects);
+	}
+
+	// Objects hang off group nodes in groups of ChildrenPerGroup and are spread through a cube around
+	// the camera at a fixed density, so the visible share is the same at every size. A tenth of the
+	// groups turn every frame. Everything follows from the seed.
+	struct FSyntheticScene
+	{
+		FSceneGraph SceneGraph;
+		FBoundingVolumeHierarchy Bounds;
+		std::vector<FSceneNodeHandle> GroupNodes;
+		std::vector<FSceneNodeHandle> ObjectNodes;
+		std::vector<FBvhProxyHandle> ObjectProxies;
+		std::vector<FBoundingBox> LocalBounds;
+		std::vector<uint16_t> Pipelines;
+		std::vector<uint16_t> Materials;
+		std::vector<uint16_t> Meshes;
+		std::vector<uint32_t> MovingGroups;
+		std::vector<float> GroupSpins;
+		FFrustum Frustum;
+		float FarPlane = 0.0f;
+	};
+
+	void BuildSyntheticScene(FSyntheticScene& scene, uint32_t objectCount, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		float extent = 2.0f * std::cbrt(static_cast<float>(objectCount));
+		scene.FarPlane = 2.0f * extent;
+		scene.Frustum = FrustumFromViewProjection(CameraViewProjection(scene.FarPlane));
+
+		uint32_t groupCount = (objectCount + ChildrenPerGroup - 1) / ChildrenPerGroup;
+		scene.GroupNodes.resize(groupCount);
+		scene.GroupSpins.resize(groupCount);
+		std::vector<uint8_t> moving(groupCount);
+		for (uint32_t group = 0; group < groupCount; ++group)
+		{
+			scene.GroupNodes[group] = scene.SceneGraph.CreateNode();
+			scene.SceneGraph.SetLocalPosition(scene.GroupNodes[group], { (2.0f * unit(random) - 1.0f) * extent,
+				(2.0f * unit(random) - 1.0f) * extent, (2.0f * unit(random) - 1.0f) * extent });
+			scene.GroupSpins[group] = 0.01f + 0.04f * unit(random);
+
+			moving[group] = unit(random) < 0.1f ? 1 : 0;
+			if (moving[group])
+			{
+				scene.MovingGroups.push_back(group);
+			}
+		}
+
+		scene.ObjectNodes.resize(objectCount);
+		scene.LocalBounds.resize(objectCount);
+		scene.Pipelines.resize(objectCount);
+		scene.Materials.resize(objectCount);
+		scene.Meshes.resize(objectCount);
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			FSceneNodeHandle node = scene.SceneGraph.CreateNode(scene.GroupNodes[i / ChildrenPerGroup]);
+			FFloat3 axis = { unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f };
+			float length = std::sqrt(axis.X * axis.X + axis.Y * axis.Y + axis.Z * axis.Z);
+			axis = length > 1e-4f ? FFloat3{ axis.X / length, axis.Y / length, axis.Z / length } : FFloat3{ 0.0f, 1.0f, 0.0f };
+
+			scene.SceneGraph.SetLocalTransform(node, { 4.0f * unit(random) - 2.0f, 4.0f * unit(random) - 2.0f, 4.0f * unit(random) - 2.0f },
+				QuaternionRotationAxis(axis, 6.2831853f * unit(random)), { 1.0f, 1.0f, 1.0f });
+			scene.ObjectNodes[i] = node;
+
+			float halfSize = 0.1f + 0.4f * unit(random);
+			scene.LocalBounds[i] = { { -halfSize, -halfSize, -halfSize }, { halfSize, halfSize, halfSize } };
+			scene.Pipelines[i] = static_cast<uint16_t>(random() % PipelineCount);
+			scene.Materials[i] = static_cast<uint16_t>(random() % MaterialCount);
+			scene.Meshes[i] = static_cast<uint16_t>(random() % MeshCount);
+		}
+
+		scene.SceneGraph.Update();
+
+		scene.ObjectProxies.resize(objectCount);
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			FBoundingBox worldBounds = TransformBoundingBox(scene.LocalBounds[i], scene.SceneGraph.GetWorldMatrix(scene.ObjectNodes[i]));
+			scene.ObjectProxies[i] = scene.Bounds.CreateProxy(worldBounds, i, moving[i / ChildrenPerGroup] ? EBvhProxyType::Dynamic : EBvhProxyType::Static);
+		}
+		scene.Bounds.Update();
+	}
+
+	// The per-frame animation of Update(): turns the moving groups and recomputes the world matrices.
+	void AnimateScene(FSyntheticScene& scene, uint32_t frame, FJobSystem* jobSystem)
+	{
+		for (uint32_t group : scene.MovingGroups)
+		{
+			scene.SceneGraph.SetLocalRotation(scene.GroupNodes[group], QuaternionRotationAxis({ 0.0f, 1.0f, 0.0f }, scene.GroupSpins[group] * static_cast<float>(frame)));
+		}
+		scene.SceneGraph.Update(jobSystem);
+	}
+
+	void UpdateMovingBounds(FSyntheticScene& scene)
+	{
+		uint32_t objectCount = static_cast<uint32_t>(scene.ObjectNodes.size());
+		for (uint32_t group : scene.MovingGroups)
+		{
+			uint32_t end = std::min(objectCount, (group + 1) * ChildrenPerGroup);
+			for (uint32_t i = group * ChildrenPerGroup; i < end; ++i)
+			{
+				scene.Bounds.SetBounds(scene.ObjectProxies[i], TransformBoundingBox(scene.LocalBounds[i], scene.SceneGraph.GetWorldMatrix(scene.ObjectNodes[i])));
+			}
+		}
+		scene.Bounds.Update();
+	}
+
+	uint64_t MakeObjectSortKey(const FSyntheticScene& scene, uint32_t object)
+	{
+		FDrawSortKeyFields key;
+		key.Pipeline = scene.Pipelines[object];
+		key.Material = scene.Materials[object];
+		key.Depth = QuantizeDrawDepth(scene.SceneGraph.GetWorldMatrix(scene.ObjectNodes[object]).M[3][2], NearPlane, scene.FarPlane);
+		return MakeDrawSortKey(key);
+	}
+
+	// Two untimed iterations, then one sample per iteration.
+	template<typename FunctionType>
+	std::vector<double> MeasureSamples(uint32_t sampleCount, const FunctionType& function)
+	{
+		uint32_t iteration = 0;
+		for (; iteration < 2; ++iteration)
+		{
+			function(iteration);
+		}
+
+		std::vector<double> samples;
+		samples.reserve(sampleCount);
+		for (uint32_t sample = 0; sample < sampleCount; ++sample, ++iteration)
+		{
+			auto start = std::chrono::steady_clock::now();
+			function(iteration);
+			auto end = std::chrono::steady_clock::now();
+
+			samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		return samples;
+	}
+
+	void RunSuite(uint32_t objectCount, uint32_t seed, uint32_t sampleCount, FJobSystem& jobSystem, FBenchmarkReport& report)
+	{
+		FSyntheticScene scene;
+		BuildSyntheticScene(scene, objectCount, seed);
+
+		FNullRenderDevice renderDevice(false);
+		FConstantBufferRing constantBufferRing(&renderDevice);
+		FInstanceBuffer instanceBuffer(&renderDevice, objectCount);
+		FFrameArenas frameArenas(2);
+		FDrawList drawList;
+
+		std::vector<FBufferHandle> meshVertexBuffers(MeshCount);
+		std::vector<FBufferHandle> meshIndexBuffers(MeshCount);
+		for (uint32_t mesh = 0; mesh < MeshCount; ++mesh)
+		{
+			FBufferDesc vertexBufferDescription;
+			vertexBufferDescription.Binding = EBufferBinding::Vertex;
+			vertexBufferDescription.Usage = EResourceUsage::Immutable;
+			vertexBufferDescription.ByteWidth = 24 * 16;
+			meshVertexBuffers[mesh] = renderDevice.CreateBuffer(vertexBufferDescription, nullptr);
+
+			FBufferDesc indexBufferDescription;
+			indexBufferDescription.Binding = EBufferBinding::Index;
+			indexBufferDescription.Usage = EResourceUsage::Immutable;
+			indexBufferDescription.ByteWidth = 36 * 2;
+			meshIndexBuffers[mesh] = renderDevice.CreateBuffer(indexBufferDescription, nullptr);
+		}
+
+		std::vector<uint32_t> visible;
+		visible.reserve(objectCount);
+		scene.Bounds.QueryFrustum(scene.Frustum, visible);
+		uint32_t visibleCount = static_cast<uint32_t>(visible.size());
+
+		std::string suffix = "/" + FormatObjectCount(objectCount);
+		auto addResult = [&](const char* metric, const std::vector<double>& samples)
+		{
+			FBenchmarkResult result = SummariseSamples(metric + suffix, objectCount, samples);
+			printf("%-20s %10u %12.3f %12.3f %12.3f\n", result.Name.c_str(), visibleCount, result.MedianMilliseconds, result.P99Milliseconds, result.MinMilliseconds);
+			report.Results.push_back(result);
+		};
+
+		addResult("transforms", MeasureSamples(sampleCount, [&](uint32_t iteration)
+		{
+			AnimateScene(scene, iteration, &jobSystem);
+		}));
+
+		addResult("culling", MeasureSamples(sampleCount, [&](uint32_t)
+		{
+			visible.clear();
+			scene.Bounds.QueryFrustum(scene.Frustum, visible);
+		}));
+
+		// One draw per visible object, the same frame after frame.
+		addResult("drawsort", MeasureSamples(sampleCount, [&](uint32_t)
+		{
+			drawList.Reset();
+			for (uint32_t object : visible)
+			{
+				uint16_t mesh = scene.Meshes[object];
+
+				FDrawItem item;
+				item.VertexBuffers[0] = meshVertexBuffers[mesh];
+				item.VertexStrides[0] = 24;
+				item.IndexBuffer = meshIndexBuffers[mesh];
+				item.IndexCount = 36;
+				item.InstanceCount = 1;
+				drawList.Add(MakeObjectSortKey(scene, object), item);
+			}
+			drawList.Submit(&renderDevice, &jobSystem);
+			renderDevice.Present(false);
+		}));
+
+		// A world matrix per visible object through the ring.
+		addResult("constants", MeasureSamples(sampleCount, [&](uint32_t)
+		{
+			constantBufferRing.BeginFrame();
+			for (uint32_t object : visible)
+			{
+				constantBufferRing.Upload(&scene.SceneGraph.GetWorldMatrix(scene.ObjectNodes[object]), sizeof(FFloat4x4));
+			}
+			constantBufferRing.EndFrame();
+			renderDevice.Present(false);
+		}));
+
+		// Everything a frame of the engine does on the CPU: animation, bounds, culling, instances grouped
+		// by mesh in the frame arena, per-draw constants and a sorted submit.
+		std::vector<uint32_t> meshCounts(MeshCount);
+		addResult("frame", MeasureSamples(sampleCount, [&](uint32_t iteration)
+		{
+			FLinearArena& frameArena = frameArenas.BeginFrame();
+
+			AnimateScene(scene, iteration, &jobSystem);
+			UpdateMovingBounds(scene);
+
+			visible.clear();
+			scene.Bounds.QueryFrustum(scene.Frustum, visible);
+			uint32_t frameVisibleCount = static_cast<uint32_t>(visible.size());
+
+			std::fill(meshCounts.begin(), meshCounts.end(), 0u);
+			for (uint32_t object : visible)
+			{
+				++meshCounts[scene.Meshes[object]];
+			}
+
+			uint32_t* meshStarts = frameArena.AllocateArray<uint32_t>(MeshCount + 1);
+			meshStarts[0] = 0;
+			for (uint32_t mesh = 0; mesh < MeshCount; ++mesh)
+			{
+				meshStarts[mesh + 1] = meshStarts[mesh] + meshCounts[mesh];
+			}
+
+			FFloat4x4* instanceMatrices = frameArena.AllocateArray<FFloat4x4>(frameVisibleCount);
+			uint32_t* writePositions = frameArena.AllocateArray<uint32_t>(MeshCount);
+			std::copy(meshStarts, meshStarts + MeshCount, writePositions);
+			for (uint32_t object : visible)
+			{
+				instanceMatrices[writePositions[scene.Meshes[object]]++] = scene.SceneGraph.GetWorldMatrix(scene.ObjectNodes[object]);
+			}
+
+			instanceBuffer.Upload(instanceMatrices, frameVisibleCount, &jobSystem);
+
+			constantBufferRing.BeginFrame();
+			FConstantBufferAllocation frameConstants = constantBufferRing.Upload(&scene.Frustum, sizeof(scene.Frustum));
+
+			drawList.Reset();
+			for (uint32_t mesh = 0; mesh < MeshCount; ++mesh)
+			{
+				if (meshCounts[mesh] == 0)
+				{
+					continue;
+				}
+
+				uint32_t tint[4] = { mesh, meshCounts[mesh], 0, 0 };
+				FConstantBufferAllocation drawConstants = constantBufferRing.Upload(tint, sizeof(tint));
+
+				FDrawItem item;
+				item.VertexBuffers[0] = meshVertexBuffers[mesh];
+				item.VertexStrides[0] = 24;
+				item.VertexBuffers[1] = instanceBuffer.GetBuffer();
+				item.VertexStrides[1] = sizeof(FInstanceTransform);
+				item.IndexBuffer = meshIndexBuffers[mesh];
+				item.ConstantBuffers[0].Buffer = frameConstants.Buffer;
+				item.ConstantBuffers[0].Offset = frameConstants.Offset;
+				item.ConstantBuffers[0].Size = frameConstants.Size;
+				item.ConstantBuffers[1].Buffer = drawConstants.Buffer;
+				item.ConstantBuffers[1].Offset = drawConstants.Offset;
+				item.ConstantBuffers[1].Size = drawConstants.Size;
+				item.IndexCount = 36;
+				item.StartInstance = meshStarts[mesh];
+				item.InstanceCount = meshCounts[mesh];
+
+				FDrawSortKeyFields key;
+				key.Pipeline = mesh % PipelineCount;
+				key.Material = mesh;
+				drawList.Add(MakeDrawSortKey(key), item);
+			}
+			constantBufferRing.Commit();
+			drawList.Submit(&renderDevice, &jobSystem);
+
+			constantBufferRing.EndFrame();
+			renderDevice.Present(false);
+		}));
+	}
+}
+
+int RunSuiteBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t objectCount = 0;
+	uint32_t seed = 1;
+	uint32_t sampleCount = 51;
+	uint32_t threads = 0;
+	std::string outputFileName;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "objects", objectCount) &&
+			!ParseOption(arguments[i], "seed", seed) &&
+			!ParseOption(arguments[i], "samples", sampleCount) &&
+			!ParseOption(arguments[i], "threads", threads) &&
+			!ParseOption(arguments[i], "output", outputFileName))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	sampleCount = std::max(sampleCount, 1u);
+
+	std::vector<uint32_t> objectCounts;
+	if (objectCount > 0)
+	{
+		objectCounts.push_back(objectCount);
+	}
+	else
+	{
+		objectCounts = { 1000, 100000, 1000000 };
+	}
+
+	FJobSystem jobSystem(threads);
+
+	FBenchmarkReport report;
+	report.Seed = seed;
+	report.Threads = jobSystem.GetConcurrency();
+
+	printf("Synthetic scenes with seed %u, %u samples per metric, %u job threads\n\n", seed, sampleCount, report.Threads);
+	printf("%-20s %10s %12s %12s %12s\n", "metric", "visible", "median ms", "p99 ms", "min ms");
+
+	for (uint32_t count : objectCounts)
+	{
+		RunSuite(count, seed, sampleCount, jobSystem, report);
+	}
+
+	if (!outputFileName.empty())
+	{
+		std::string error;
+		if (!WriteBenchmarkReport(outputFileName.c_str(), report, &error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+
+		printf("\nWrote %s\n", outputFileName.c_str());
+	}
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "TransformMath.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct FTransform
+	{
+		FFloat3 Position;
+		FQuaternion Rotation;
+		FFloat3 Scale;
+	};
+
+	float Checksum(const std::vector<FFloat4x4>& matrices)
+	{
+		float checksum = 0.0f;
+		for (const FFloat4x4& matrix : matrices)
+		{
+			checksum += matrix.M[3][0] + matrix.M[0][0];
+		}
+
+		return checksum;
+	}
+}
+
+int RunTransformMathBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t objectCount = 100000;
+	uint32_t repeats = 21;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "objects", objectCount) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	objectCount = std::max(1u, objectCount);
+	repeats = std::max(1u, repeats);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	std::vector<FTransform> objects(objectCount);
+	FTransformSoA transforms;
+	transforms.Resize(objectCount);
+
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		FTransform& object = objects[i];
+		object.Position = { position(random), position(random), position(random) };
+		object.Rotation = QuaternionRotationAxis({ component(random), component(random), 1.0f }, component(random) * 3.14159265f);
+		object.Scale = { scale(random), scale(random), scale(random) };
+
+		transforms.Set(i, object.Position, object.Rotation, object.Scale);
+	}
+
+	FFloat4x4 viewProjection = MatrixIdentity();
+	for (int i = 0; i < 16; ++i)
+	{
+		viewProjection.M[i / 4][i % 4] = component(random);
+	}
+
+	std::vector<FFloat4x4> worldMatrices(objectCount);
+	std::vector<FFloat4x4> modelViewProjections(objectCount);
+
+	printf("World and model-view-projection matrices for %u objects, median of %u runs\n\n", objectCount, repeats);
+	printf("%-28s %12s %12s %10s\n", "path", "median ms", "ns/object", "speedup");
+
+	// The per-object path Update() used: one matrix chain per object, stored to memory afterwards.
+#if MORPHEUS_HAS_DIRECTXMATH
+	const char* referenceName = "per-object DirectXMath";
+	DirectX::XMMATRIX viewProjectionMatrix = LoadMatrix(viewProjection);
+
+	double referenceMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		using namespace DirectX;
+
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			const FTransform& object = objects[i];
+			XMMATRIX world = XMMatrixScaling(object.Scale.X, object.Scale.Y, object.Scale.Z) *
+				XMMatrixRotationQuaternion(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&object.Rotation))) *
+				XMMatrixTranslation(object.Position.X, object.Position.Y, object.Position.Z);
+
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(&worldMatrices[i]), world);
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(&modelViewProjections[i]), world * viewProjectionMatrix);
+		}
+	});
+#else
+	const char* referenceName = "per-object scalar";
+
+	double referenceMilliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			const FTransform& object = objects[i];
+			worldMatrices[i] = MatrixTransform(object.Position, object.Rotation, object.Scale);
+			modelViewProjections[i] = MatrixMultiply(worldMatrices[i], viewProjection);
+		}
+	});
+#endif
+
+	printf("%-28s %12.3f %12.2f %9.2fx\n", referenceName, referenceMilliseconds, referenceMilliseconds * 1e6 / objectCount, 1.0);
+	float referenceChecksum = Checksum(modelViewProjections);
+
+	const EMathBackend previousBackend = GetMathBackend();
+	const EMathBackend backends[] = { EMathBackend::Scalar, EMathBackend::SSE, EMathBackend::AVX2, EMathBackend::NEON };
+
+	for (EMathBackend backend : backends)
+	{
+		if (!IsMathBackendSupported(backend))
+		{
+			continue;
+		}
+
+		SetMathBackend(backend);
+
+		double milliseconds = MeasureMilliseconds(repeats, [&]()
+		{
+			ComposeModelViewProjections(transforms, 0, objectCount, viewProjection, worldMatrices.data(), modelViewProjections.data());
+		});
+
+		char name[64];
+		snprintf(name, sizeof(name), "batched SoA %s", GetMathBackendName(backend));
+		printf("%-28s %12.3f %12.2f %9.2fx\n", name, milliseconds, milliseconds * 1e6 / objectCount, referenceMilliseconds / milliseconds);
+	}
+
+	SetMathBackend(previousBackend);
+
+	printf("\nChecksum %f (reference %f)\n", Checksum(modelViewProjections), referenceChecksum);
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+
+#include "MeshFile.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Position, normal and colour in one stream, like the OBJ importer writes them with vertex colours.
+	FMeshData MakeMesh(uint32_t vertexCount, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> coordinate(-25.0f, 25.0f);
+		std::uniform_real_distribution<float> channel(0.0f, 1.0f);
+		std::normal_distribution<float> direction(0.0f, 1.0f);
+
+		FMeshData mesh;
+		mesh.VertexCount = vertexCount;
+		mesh.Streams.resize(1);
+
+		FMeshStreamData& stream = mesh.Streams[0];
+		stream.Stride = 36;
+		stream.Elements.push_back({ EMeshSemantic::Position, 0, EVertexFormat::Float3, 0 });
+		stream.Elements.push_back({ EMeshSemantic::Normal, 0, EVertexFormat::Float3, 12 });
+		stream.Elements.push_back({ EMeshSemantic::Colour, 0, EVertexFormat::Float3, 24 });
+		stream.Data.resize(size_t(stream.Stride) * vertexCount);
+
+		float* vertex = reinterpret_cast<float*>(stream.Data.data());
+		for (uint32_t i = 0; i < vertexCount; ++i, vertex += 9)
+		{
+			FFloat3 normal = { direction(random), direction(random), direction(random) };
+			float length = std::sqrt(normal.X * normal.X + normal.Y * normal.Y + normal.Z * normal.Z);
+
+			vertex[0] = coordinate(random);
+			vertex[1] = coordinate(random);
+			vertex[2] = coordinate(random);
+			vertex[3] = normal.X / length;
+			vertex[4] = normal.Y / length;
+			vertex[5] = normal.Z / length;
+			vertex[6] = channel(random);
+			vertex[7] = channel(random);
+			vertex[8] = channel(random);
+		}
+
+		return mesh;
+	}
+}
+
+int RunVertexFormatBenchmark(int argumentCount, char** arguments)
+{
+	uint32_t vertexCount = 1000000;
+	uint32_t repeats = 5;
+
+	for (int i = 0; i < argumentCount; ++i)
+	{
+		if (!ParseOption(arguments[i], "vertices", vertexCount) &&
+			!ParseOption(arguments[i], "repeats", repeats))
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+			return 1;
+		}
+	}
+
+	vertexCount = std::max(1u, vertexCount);
+	repeats = std::max(1u, repeats);
+
+	std::mt19937 random(14);
+	FMeshData source = MakeMesh(vertexCount, random);
+	const FMeshStreamData& stream = source.Streams[0];
+	const uint8_t* vertices = stream.Data.data();
+
+	FPositionQuantization quantization = ComputePositionQuantization(vertices, stream.Stride, vertexCount);
+	std::vector<uint8_t> packed(size_t(vertexCount) * 16);
+
+	printf("Encoding %u vertices of float position, normal and colour, median of %u runs\n\n", vertexCount, repeats);
+	printf("%-22s %-8s %12s %14s %10s\n", "attribute", "backend", "median ms", "Mvertices/s", "speedup");
+
+	const EMathBackend previousBackend = GetMathBackend();
+
+	struct FEncoder
+	{
+		const char* Name;
+		void (*Encode)(const uint8_t* vertices, uint32_t stride, uint32_t count, const FPositionQuantization& quantization, uint8_t* output);
+	};
+
+	const FEncoder encoders[] =
+	{
+		{ "position Short4Norm", [](const uint8_t* vertices, uint32_t stride, uint32_t count, const FPositionQuantization& quantization, uint8_t* output)
+			{ EncodePositions(vertices, stride, count, quantization, output, 16); } },
+		{ "normal octahedral", [](const uint8_t* vertices, uint32_t stride, uint32_t count, const FPositionQuantization&, uint8_t* output)
+			{ EncodeOctahedralNormals(vertices + 12, stride, count, output + 8, 16); } },
+		{ "colour UByte4Norm", [](const uint8_t* vertices, uint32_t stride, uint32_t count, const FPositionQuantization&, uint8_t* output)
+			{ EncodeColours(vertices + 24, stride, false, count, output + 12, 16); } },
+	};
+
+	for (const FEncoder& encoder : encoders)
+	{
+		double scalarMilliseconds = 0.0;
+		for (EMathBackend backend : { EMathBackend::Scalar, EMathBackend::SSE })
+		{
+			if (!IsMathBackendSupported(backend))
+			{
+				continue;
+			}
+
+			SetMathBackend(backend);
+			double milliseconds = MeasureMilliseconds(repeats, [&]() { encoder.Encode(vertices, stream.Stride, vertexCount, quantization, packed.data()); });
+			scalarMilliseconds = backend == EMathBackend::Scalar ? milliseconds : scalarMilliseconds;
+
+			printf("%-22s %-8s %12.3f %14.1f %9.2fx\n", encoder.Name, GetMathBackendName(backend), milliseconds, vertexCount / (milliseconds * 1e3),
+				scalarMilliseconds / milliseconds);
+		}
+	}
+
+	SetMathBackend(previousBackend);
+
+	// The whole repack as the converter runs it, with the round trip errors.
+	FMeshData mesh;
+	FVertexQuantizationStats stats;
+	double milliseconds = MeasureMilliseconds(repeats, [&]()
+	{
+		mesh = source;
+		QuantizeMeshVertices(mesh, FVertexFormatOptions(), &stats);
+	});
+
+	printf("\nQuantizeMeshVertices with %s: %.3f ms, %u -> %u bytes per vertex\n", GetMathBackendName(GetMathBackend()), milliseconds,
+		stats.VertexSizeBefore, stats.VertexSizeAfter);
+	printf("Largest round trip error: position %g in a box of 50 units, normal %.4f degrees, colour %.4f\n", stats.MaxPositionError,
+		stats.MaxNormalErrorDegrees, stats.MaxColourError);
+
+	return 0;
+}
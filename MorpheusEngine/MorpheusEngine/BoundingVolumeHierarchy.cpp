@@ -0,0 +1,1368 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MORPHEUS_BVH_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64) || defined(_M_ARM)
+#define MORPHEUS_BVH_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	// The four lanes of a static node.
+#if MORPHEUS_BVH_SSE
+	struct FNodeVector
+	{
+		typedef __m128 FRegister;
+
+		static FRegister Load(const float* source) { return _mm_load_ps(source); }
+		static FRegister Set(float value) { return _mm_set1_ps(value); }
+		static FRegister Subtract(FRegister a, FRegister b) { return _mm_sub_ps(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return _mm_mul_ps(a, b); }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static FRegister Min(FRegister a, FRegister b) { return _mm_min_ps(a, b); }
+		static FRegister Max(FRegister a, FRegister b) { return _mm_max_ps(a, b); }
+		static uint32_t LessBits(FRegister a, FRegister b) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(a, b))); }
+		static void Store(float* destination, FRegister a) { _mm_storeu_ps(destination, a); }
+	};
+#elif MORPHEUS_BVH_NEON
+	struct FNodeVector
+	{
+		typedef float32x4_t FRegister;
+
+		static FRegister Load(const float* source) { return vld1q_f32(source); }
+		static FRegister Set(float value) { return vdupq_n_f32(value); }
+		static FRegister Subtract(FRegister a, FRegister b) { return vsubq_f32(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return vmulq_f32(a, b); }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return vmlaq_f32(c, a, b); }
+		static FRegister Min(FRegister a, FRegister b) { return vminq_f32(a, b); }
+		static FRegister Max(FRegister a, FRegister b) { return vmaxq_f32(a, b); }
+		static void Store(float* destination, FRegister a) { vst1q_f32(destination, a); }
+
+		static uint32_t LessBits(FRegister a, FRegister b)
+		{
+			uint32x4_t mask = vcltq_f32(a, b);
+
+			return (vgetq_lane_u32(mask, 0) & 1) | (vgetq_lane_u32(mask, 1) & 2) | (vgetq_lane_u32(mask, 2) & 4) | (vgetq_lane_u32(mask, 3) & 8);
+		}
+	};
+#else
+	struct FNodeVector
+	{
+		struct FRegister
+		{
+			float V[4];
+		};
+
+		static FRegister Load(const float* source) { return { { source[0], source[1], source[2], source[3] } }; }
+		static FRegister Set(float value) { return { { value, value, value, value } }; }
+		static FRegister Subtract(FRegister a, FRegister b) { return { { a.V[0] - b.V[0], a.V[1] - b.V[1], a.V[2] - b.V[2], a.V[3] - b.V[3] } }; }
+		static FRegister Multiply(FRegister a, FRegister b) { return { { a.V[0] * b.V[0], a.V[1] * b.V[1], a.V[2] * b.V[2], a.V[3] * b.V[3] } }; }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return { { a.V[0] * b.V[0] + c.V[0], a.V[1] * b.V[1] + c.V[1], a.V[2] * b.V[2] + c.V[2], a.V[3] * b.V[3] + c.V[3] } }; }
+		static FRegister Min(FRegister a, FRegister b) { return { { std::min(a.V[0], b.V[0]), std::min(a.V[1], b.V[1]), std::min(a.V[2], b.V[2]), std::min(a.V[3], b.V[3]) } }; }
+		static FRegister Max(FRegister a, FRegister b) { return { { std::max(a.V[0], b.V[0]), std::max(a.V[1], b.V[1]), std::max(a.V[2], b.V[2]), std::max(a.V[3], b.V[3]) } }; }
+		static void Store(float* destination, FRegister a) { std::copy(a.V, a.V + 4, destination); }
+
+		static uint32_t LessBits(FRegister a, FRegister b)
+		{
+			return (a.V[0] < b.V[0] ? 1u : 0u) | (a.V[1] < b.V[1] ? 2u : 0u) | (a.V[2] < b.V[2] ? 4u : 0u) | (a.V[3] < b.V[3] ? 8u : 0u);
+		}
+	};
+#endif
+
+	typedef FNodeVector::FRegister FRegister;
+
+	// Marks an entry of the frustum traversal whose node is entirely inside.
+	const uint32_t InsideBit = 0x80000000u;
+	const uint32_t MaxSplitBins = 16;
+
+	const FBoundingBox EmptyBox = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+
+	FBoundingBox Union(const FBoundingBox& a, const FBoundingBox& b)
+	{
+		return { { std::min(a.Min.X, b.Min.X), std::min(a.Min.Y, b.Min.Y), std::min(a.Min.Z, b.Min.Z) },
+			{ std::max(a.Max.X, b.Max.X), std::max(a.Max.Y, b.Max.Y), std::max(a.Max.Z, b.Max.Z) } };
+	}
+
+	bool Contains(const FBoundingBox& outer, const FBoundingBox& inner)
+	{
+		return outer.Min.X <= inner.Min.X && outer.Min.Y <= inner.Min.Y && outer.Min.Z <= inner.Min.Z &&
+			outer.Max.X >= inner.Max.X && outer.Max.Y >= inner.Max.Y && outer.Max.Z >= inner.Max.Z;
+	}
+
+	bool Overlaps(const FBoundingBox& a, const FBoundingBox& b)
+	{
+		return a.Min.X <= b.Max.X && a.Min.Y <= b.Max.Y && a.Min.Z <= b.Max.Z &&
+			b.Min.X <= a.Max.X && b.Min.Y <= a.Max.Y && b.Min.Z <= a.Max.Z;
+	}
+
+	// Half the surface area, which is all the heuristic needs.
+	float HalfArea(const FBoundingBox& box)
+	{
+		float x = box.Max.X - box.Min.X;
+		float y = box.Max.Y - box.Min.Y;
+		float z = box.Max.Z - box.Min.Z;
+
+		return (x < 0.0f) ? 0.0f : x * y + y * z + z * x;
+	}
+
+	FBoundingBox GetLane(const float(&bounds)[6][4], uint32_t lane)
+	{
+		return { { bounds[0][lane], bounds[1][lane], bounds[2][lane] }, { bounds[3][lane], bounds[4][lane], bounds[5][lane] } };
+	}
+
+	void SetLane(float(&bounds)[6][4], uint32_t lane, const FBoundingBox& box)
+	{
+		bounds[0][lane] = box.Min.X;
+		bounds[1][lane] = box.Min.Y;
+		bounds[2][lane] = box.Min.Z;
+		bounds[3][lane] = box.Max.X;
+		bounds[4][lane] = box.Max.Y;
+		bounds[5][lane] = box.Max.Z;
+	}
+
+	FBoundingBox UnionOfLanes(const float(&bounds)[6][4])
+	{
+		FBoundingBox box = GetLane(bounds, 0);
+		for (uint32_t lane = 1; lane < 4; ++lane)
+		{
+			box = Union(box, GetLane(bounds, lane));
+		}
+
+		return box;
+	}
+
+	// Planes as registers, with the rows of the node bounds holding the box corner furthest along each
+	// normal and the one furthest against it.
+	struct FFrustumTest
+	{
+		FRegister NormalX[6];
+		FRegister NormalY[6];
+		FRegister NormalZ[6];
+		FRegister W[6];
+		uint8_t FarRows[6][3];
+		uint8_t NearRows[6][3];
+	};
+
+	FFrustumTest MakeFrustumTest(const FFrustum& frustum)
+	{
+		FFrustumTest test;
+		for (uint32_t plane = 0; plane < 6; ++plane)
+		{
+			const FPlane& p = frustum.Planes[plane];
+			test.NormalX[plane] = FNodeVector::Set(p.X);
+			test.NormalY[plane] = FNodeVector::Set(p.Y);
+			test.NormalZ[plane] = FNodeVector::Set(p.Z);
+			test.W[plane] = FNodeVector::Set(p.W);
+
+			const float normal[3] = { p.X, p.Y, p.Z };
+			for (uint8_t axis = 0; axis < 3; ++axis)
+			{
+				test.FarRows[plane][axis] = normal[axis] >= 0.0f ? axis + 3 : axis;
+				test.NearRows[plane][axis] = normal[axis] >= 0.0f ? axis : axis + 3;
+			}
+		}
+
+		return test;
+	}
+
+	// Returns the lanes that are at least partly inside, and in insideBits those entirely inside.
+	uint32_t TestFrustumLanes(const float(&bounds)[6][4], const FFrustumTest& test, uint32_t& insideBits)
+	{
+		const FRegister zero = FNodeVector::Set(0.0f);
+
+		uint32_t outsideBits = 0;
+		uint32_t crossingBits = 0;
+		for (uint32_t plane = 0; plane < 6; ++plane)
+		{
+			const uint8_t(&farRows)[3] = test.FarRows[plane];
+			const uint8_t(&nearRows)[3] = test.NearRows[plane];
+
+			FRegister farDistance = FNodeVector::MultiplyAdd(test.NormalX[plane], FNodeVector::Load(bounds[farRows[0]]),
+				FNodeVector::MultiplyAdd(test.NormalY[plane], FNodeVector::Load(bounds[farRows[1]]),
+				FNodeVector::MultiplyAdd(test.NormalZ[plane], FNodeVector::Load(bounds[farRows[2]]), test.W[plane])));
+			FRegister nearDistance = FNodeVector::MultiplyAdd(test.NormalX[plane], FNodeVector::Load(bounds[nearRows[0]]),
+				FNodeVector::MultiplyAdd(test.NormalY[plane], FNodeVector::Load(bounds[nearRows[1]]),
+				FNodeVector::MultiplyAdd(test.NormalZ[plane], FNodeVector::Load(bounds[nearRows[2]]), test.W[plane])));
+
+			outsideBits |= FNodeVector::LessBits(farDistance, zero);
+			crossingBits |= FNodeVector::LessBits(nearDistance, zero);
+		}
+
+		uint32_t visibleBits = ~outsideBits & 0xf;
+		insideBits = visibleBits & ~crossingBits;
+
+		return visibleBits;
+	}
+
+	enum class EBoxClass
+	{
+		Outside,
+		Crossing,
+		Inside
+	};
+
+	EBoxClass ClassifyBox(const FBoundingBox& box, const FFrustum& frustum)
+	{
+		EBoxClass result = EBoxClass::Inside;
+		for (const FPlane& plane : frustum.Planes)
+		{
+			float farDistance = plane.X * (plane.X >= 0.0f ? box.Max.X : box.Min.X) + plane.Y * (plane.Y >= 0.0f ? box.Max.Y : box.Min.Y) +
+				plane.Z * (plane.Z >= 0.0f ? box.Max.Z : box.Min.Z) + plane.W;
+			if (farDistance < 0.0f)
+			{
+				return EBoxClass::Outside;
+			}
+
+			float nearDistance = plane.X * (plane.X >= 0.0f ? box.Min.X : box.Max.X) + plane.Y * (plane.Y >= 0.0f ? box.Min.Y : box.Max.Y) +
+				plane.Z * (plane.Z >= 0.0f ? box.Min.Z : box.Max.Z) + plane.W;
+			if (nearDistance < 0.0f)
+			{
+				result = EBoxClass::Crossing;
+			}
+		}
+
+		return result;
+	}
+
+	// Ray with its reciprocal direction. Zero components get a huge finite reciprocal, so the slabs never
+	// multiply zero by infinity.
+	struct FRayTest
+	{
+		FFloat3 Origin;
+		FFloat3 InverseDirection;
+		FRegister OriginLanes[3];
+		FRegister InverseLanes[3];
+		// Rows of the node bounds the ray enters and leaves each slab through.
+		uint8_t EntryRows[3];
+		uint8_t ExitRows[3];
+	};
+
+	FRayTest MakeRayTest(const FFloat3& origin, const FFloat3& direction)
+	{
+		FRayTest test;
+		test.Origin = origin;
+
+		const float components[3] = { direction.X, direction.Y, direction.Z };
+		float inverse[3];
+		for (uint8_t axis = 0; axis < 3; ++axis)
+		{
+			float component = components[axis];
+			inverse[axis] = std::fabs(component) > 1e-20f ? 1.0f / component : std::copysign(1e30f, component);
+
+			test.EntryRows[axis] = inverse[axis] >= 0.0f ? axis : axis + 3;
+			test.ExitRows[axis] = inverse[axis] >= 0.0f ? axis + 3 : axis;
+		}
+
+		test.InverseDirection = { inverse[0], inverse[1], inverse[2] };
+		test.OriginLanes[0] = FNodeVector::Set(origin.X);
+		test.OriginLanes[1] = FNodeVector::Set(origin.Y);
+		test.OriginLanes[2] = FNodeVector::Set(origin.Z);
+		test.InverseLanes[0] = FNodeVector::Set(inverse[0]);
+		test.InverseLanes[1] = FNodeVector::Set(inverse[1]);
+		test.InverseLanes[2] = FNodeVector::Set(inverse[2]);
+
+		return test;
+	}
+
+	// Returns the lanes the ray enters before maxDistance, with the entry distances.
+	uint32_t TestRayLanes(const float(&bounds)[6][4], const FRayTest& test, float maxDistance, float(&entries)[4])
+	{
+		FRegister entry = FNodeVector::Set(0.0f);
+		FRegister exit = FNodeVector::Set(maxDistance);
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			FRegister slabEntry = FNodeVector::Multiply(FNodeVector::Subtract(FNodeVector::Load(bounds[test.EntryRows[axis]]), test.OriginLanes[axis]), test.InverseLanes[axis]);
+			FRegister slabExit = FNodeVector::Multiply(FNodeVector::Subtract(FNodeVector::Load(bounds[test.ExitRows[axis]]), test.OriginLanes[axis]), test.InverseLanes[axis]);
+			entry = FNodeVector::Max(entry, slabEntry);
+			exit = FNodeVector::Min(exit, slabExit);
+		}
+
+		FNodeVector::Store(entries, entry);
+
+		return ~FNodeVector::LessBits(exit, entry) & 0xf;
+	}
+
+	bool RayEntersBox(const FBoundingBox& box, const FRayTest& test, float maxDistance, float& entry)
+	{
+		const float minimum[3] = { box.Min.X, box.Min.Y, box.Min.Z };
+		const float maximum[3] = { box.Max.X, box.Max.Y, box.Max.Z };
+		const float origin[3] = { test.Origin.X, test.Origin.Y, test.Origin.Z };
+		const float inverse[3] = { test.InverseDirection.X, test.InverseDirection.Y, test.InverseDirection.Z };
+
+		float entryDistance = 0.0f;
+		float exitDistance = maxDistance;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float slabEntry = ((inverse[axis] >= 0.0f ? minimum[axis] : maximum[axis]) - origin[axis]) * inverse[axis];
+			float slabExit = ((inverse[axis] >= 0.0f ? maximum[axis] : minimum[axis]) - origin[axis]) * inverse[axis];
+			entryDistance = std::max(entryDistance, slabEntry);
+			exitDistance = std::min(exitDistance, slabExit);
+		}
+
+		entry = entryDistance;
+
+		return entryDistance <= exitDistance;
+	}
+
+	uint32_t TestBoxLanes(const float(&bounds)[6][4], const FRegister(&queryMin)[3], const FRegister(&queryMax)[3])
+	{
+		uint32_t separatedBits = 0;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			separatedBits |= FNodeVector::LessBits(queryMax[axis], FNodeVector::Load(bounds[axis]));
+			separatedBits |= FNodeVector::LessBits(FNodeVector::Load(bounds[axis + 3]), queryMin[axis]);
+		}
+
+		return ~separatedBits & 0xf;
+	}
+}
+
+FBoundingBox TransformBoundingBox(const FBoundingBox& box, const FFloat4x4& world)
+{
+	const float(&m)[4][4] = world.M;
+
+	FFloat3 centre = { 0.5f * (box.Min.X + box.Max.X), 0.5f * (box.Min.Y + box.Max.Y), 0.5f * (box.Min.Z + box.Max.Z) };
+	FFloat3 extents = { 0.5f * (box.Max.X - box.Min.X), 0.5f * (box.Max.Y - box.Min.Y), 0.5f * (box.Max.Z - box.Min.Z) };
+
+	FFloat3 worldCentre;
+	worldCentre.X = centre.X * m[0][0] + centre.Y * m[1][0] + centre.Z * m[2][0] + m[3][0];
+	worldCentre.Y = centre.X * m[0][1] + centre.Y * m[1][1] + centre.Z * m[2][1] + m[3][1];
+	worldCentre.Z = centre.X * m[0][2] + centre.Y * m[1][2] + centre.Z * m[2][2] + m[3][2];
+
+	// Every world axis of the box is the sum of the absolute projections of the local axes.
+	FFloat3 worldExtents;
+	worldExtents.X = extents.X * std::fabs(m[0][0]) + extents.Y * std::fabs(m[1][0]) + extents.Z * std::fabs(m[2][0]);
+	worldExtents.Y = extents.X * std::fabs(m[0][1]) + extents.Y * std::fabs(m[1][1]) + extents.Z * std::fabs(m[2][1]);
+	worldExtents.Z = extents.X * std::fabs(m[0][2]) + extents.Y * std::fabs(m[1][2]) + extents.Z * std::fabs(m[2][2]);
+
+	return { { worldCentre.X - worldExtents.X, worldCentre.Y - worldExtents.Y, worldCentre.Z - worldExtents.Z },
+		{ worldCentre.X + worldExtents.X, worldCentre.Y + worldExtents.Y, worldCentre.Z + worldExtents.Z } };
+}
+
+FBoundingVolumeHierarchy::FBoundingVolumeHierarchy(float dynamicMargin)
+	: DynamicMargin(dynamicMargin)
+	, LiveProxyCount(0)
+	, StaticProxyCount(0)
+	, StaticLiveCount(0)
+	, StaticRemovedCount(0)
+	, HasDirtyStaticNodes(false)
+	, DynamicRoot(InvalidIndex)
+	, DynamicFreeList(InvalidIndex)
+	, DynamicNodeCount(0)
+	, DynamicLeafCount(0)
+{
+}
+
+FBvhProxyHandle FBoundingVolumeHierarchy::CreateProxy(const FBoundingBox& box, uint32_t userData, EBvhProxyType type)
+{
+	uint32_t slot;
+	if (!FreeSlots.empty())
+	{
+		slot = FreeSlots.back();
+		FreeSlots.pop_back();
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(SlotBoxes.size());
+		SlotBoxes.emplace_back();
+		SlotUserData.push_back(0);
+		SlotTypes.push_back(type);
+		SlotPlacements.push_back(EPlacement::Free);
+		SlotLocations.push_back(InvalidIndex);
+	}
+
+	SlotBoxes[slot] = box;
+	SlotUserData[slot] = userData;
+	SlotTypes[slot] = type;
+	++LiveProxyCount;
+
+	if (type == EBvhProxyType::Static)
+	{
+		SlotPlacements[slot] = EPlacement::Pending;
+		SlotLocations[slot] = static_cast<uint32_t>(PendingSlots.size());
+		PendingSlots.push_back(slot);
+		++StaticProxyCount;
+	}
+	else
+	{
+		AddDynamicProxy(slot);
+	}
+
+	FBvhProxyHandle proxy;
+	proxy.Value = slot + 1;
+
+	return proxy;
+}
+
+void FBoundingVolumeHierarchy::DestroyProxy(FBvhProxyHandle proxy)
+{
+	uint32_t slot = GetSlot(proxy);
+	uint32_t location = SlotLocations[slot];
+
+	switch (SlotPlacements[slot])
+	{
+	case EPlacement::Pending:
+	{
+		uint32_t last = PendingSlots.back();
+		PendingSlots[location] = last;
+		SlotLocations[last] = location;
+		PendingSlots.pop_back();
+		break;
+	}
+	case EPlacement::StaticTree:
+		// The primitive stays in its leaf until the next build, with a box that matches nothing.
+		StaticBoxes[location] = EmptyBox;
+		StaticSlots[location] = InvalidIndex;
+		MarkStaticLeafDirty(location);
+		--StaticLiveCount;
+		++StaticRemovedCount;
+		break;
+	case EPlacement::DynamicTree:
+		RemoveDynamicProxy(slot);
+		break;
+	default:
+		assert(false);
+		break;
+	}
+
+	if (SlotTypes[slot] == EBvhProxyType::Static)
+	{
+		--StaticProxyCount;
+	}
+
+	SlotPlacements[slot] = EPlacement::Free;
+	SlotLocations[slot] = InvalidIndex;
+	FreeSlots.push_back(slot);
+	--LiveProxyCount;
+}
+
+bool FBoundingVolumeHierarchy::IsAlive(FBvhProxyHandle proxy) const
+{
+	return proxy.IsValid() && proxy.Value <= SlotPlacements.size() && SlotPlacements[proxy.Value - 1] != EPlacement::Free;
+}
+
+void FBoundingVolumeHierarchy::SetBounds(FBvhProxyHandle proxy, const FBoundingBox& box)
+{
+	uint32_t slot = GetSlot(proxy);
+	uint32_t location = SlotLocations[slot];
+
+	if (SlotPlacements[slot] == EPlacement::StaticTree)
+	{
+		StaticBoxes[location] = box;
+		MarkStaticLeafDirty(location);
+	}
+	else if (SlotPlacements[slot] == EPlacement::DynamicTree && !Contains(DynamicNodes[location].Box, box))
+	{
+		const FBoundingBox& previous = SlotBoxes[slot];
+
+		// Stretch the new box in the direction of travel, so an object that keeps moving the same way
+		// is reinserted less often.
+		FBoundingBox fat = box;
+		float displacement[3] =
+		{
+			(box.Min.X + box.Max.X) - (previous.Min.X + previous.Max.X),
+			(box.Min.Y + box.Max.Y) - (previous.Min.Y + previous.Max.Y),
+			(box.Min.Z + box.Max.Z) - (previous.Min.Z + previous.Max.Z)
+		};
+		float* minimum[3] = { &fat.Min.X, &fat.Min.Y, &fat.Min.Z };
+		float* maximum[3] = { &fat.Max.X, &fat.Max.Y, &fat.Max.Z };
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			*minimum[axis] -= DynamicMargin - std::min(displacement[axis], 0.0f);
+			*maximum[axis] += DynamicMargin + std::max(displacement[axis], 0.0f);
+		}
+
+		RemoveDynamicLeaf(location);
+		DynamicNodes[location].Box = fat;
+		InsertDynamicLeaf(location);
+
+		++Stats.Reinserts;
+	}
+
+	SlotBoxes[slot] = box;
+}
+
+const FBoundingBox& FBoundingVolumeHierarchy::GetBounds(FBvhProxyHandle proxy) const
+{
+	return SlotBoxes[GetSlot(proxy)];
+}
+
+uint32_t FBoundingVolumeHierarchy::GetUserData(FBvhProxyHandle proxy) const
+{
+	return SlotUserData[GetSlot(proxy)];
+}
+
+void FBoundingVolumeHierarchy::Update()
+{
+	// Static proxies outside the tree cost a dynamic insert each, destroyed ones a wasted test.
+	uint32_t staleCount = (StaticProxyCount - StaticLiveCount) + StaticRemovedCount;
+	if (staleCount > 0 && staleCount * 4 > StaticLiveCount)
+	{
+		RebuildStaticTree();
+	}
+	else
+	{
+		for (uint32_t slot : PendingSlots)
+		{
+			AddDynamicProxy(slot);
+		}
+
+		PendingSlots.clear();
+		RefitStaticTree();
+	}
+
+	Stats.StaticProxies = StaticLiveCount;
+	Stats.DynamicProxies = DynamicLeafCount;
+	Stats.StaticNodes = static_cast<uint32_t>(StaticNodes.size());
+	Stats.DynamicNodes = DynamicNodeCount;
+
+	LastUpdateStats = Stats;
+	Stats = FBvhStats();
+}
+
+void FBoundingVolumeHierarchy::RebuildStaticTree()
+{
+	BuildItems.clear();
+	BuildItems.reserve(StaticProxyCount);
+
+	for (uint32_t slot = 0; slot < static_cast<uint32_t>(SlotPlacements.size()); ++slot)
+	{
+		if (SlotPlacements[slot] == EPlacement::Free || SlotTypes[slot] != EBvhProxyType::Static)
+		{
+			continue;
+		}
+
+		if (SlotPlacements[slot] == EPlacement::DynamicTree)
+		{
+			RemoveDynamicProxy(slot);
+		}
+
+		const FBoundingBox& box = SlotBoxes[slot];
+		BuildItems.push_back({ box, { box.Min.X + box.Max.X, box.Min.Y + box.Max.Y, box.Min.Z + box.Max.Z }, slot });
+	}
+
+	PendingSlots.clear();
+
+	const uint32_t count = static_cast<uint32_t>(BuildItems.size());
+	StaticNodes.clear();
+	StaticNodeParents.clear();
+	StaticLeafNodes.resize(count);
+
+	if (count > 0)
+	{
+		BuildStaticNode(0, count, 0);
+	}
+
+	StaticNodeDirty.assign(StaticNodes.size(), 0);
+	StaticBoxes.resize(count);
+	StaticSlots.resize(count);
+	StaticUserData.resize(count);
+
+	for (uint32_t primitive = 0; primitive < count; ++primitive)
+	{
+		uint32_t slot = BuildItems[primitive].Slot;
+
+		StaticBoxes[primitive] = BuildItems[primitive].Box;
+		StaticSlots[primitive] = slot;
+		StaticUserData[primitive] = SlotUserData[slot];
+		SlotPlacements[slot] = EPlacement::StaticTree;
+		SlotLocations[slot] = primitive;
+	}
+
+	StaticLiveCount = count;
+	StaticRemovedCount = 0;
+	HasDirtyStaticNodes = false;
+	Stats.StaticTreeRebuilt = true;
+}
+
+void FBoundingVolumeHierarchy::QueryFrustum(const FFrustum& frustum, std::vector<uint32_t>& userData) const
+{
+	if (!StaticNodes.empty())
+	{
+		const FFrustumTest test = MakeFrustumTest(frustum);
+
+		uint32_t stack[MaxStaticDepth * 3 + 1];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			uint32_t entry = stack[--stackSize];
+			const FStaticNode& node = StaticNodes[entry & ~InsideBit];
+
+			// Nothing below a node that is entirely inside needs testing.
+			uint32_t insideBits = 0xf;
+			uint32_t visibleBits = (entry & InsideBit) ? 0xf : TestFrustumLanes(node.Bounds, test, insideBits);
+
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if (!((visibleBits >> lane) & 1) || node.Children[lane] == InvalidIndex)
+				{
+					continue;
+				}
+
+				bool inside = (insideBits >> lane) & 1;
+				if (node.Counts[lane] == 0)
+				{
+					stack[stackSize++] = node.Children[lane] | (inside ? InsideBit : 0);
+					continue;
+				}
+
+				uint32_t end = node.Children[lane] + node.Counts[lane];
+				for (uint32_t primitive = node.Children[lane]; primitive < end; ++primitive)
+				{
+					if (StaticSlots[primitive] != InvalidIndex && (inside || ClassifyBox(StaticBoxes[primitive], frustum) != EBoxClass::Outside))
+					{
+						userData.push_back(StaticUserData[primitive]);
+					}
+				}
+			}
+		}
+	}
+
+	if (DynamicRoot != InvalidIndex)
+	{
+		uint32_t stack[MaxDynamicHeight + 1];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = DynamicRoot;
+
+		while (stackSize > 0)
+		{
+			uint32_t entry = stack[--stackSize];
+			const FDynamicNode& node = DynamicNodes[entry & ~InsideBit];
+
+			bool inside = (entry & InsideBit) != 0;
+			if (!inside)
+			{
+				EBoxClass boxClass = ClassifyBox(node.Box, frustum);
+				if (boxClass == EBoxClass::Outside)
+				{
+					continue;
+				}
+
+				inside = boxClass == EBoxClass::Inside;
+			}
+
+			if (node.Height == 0)
+			{
+				// The enlarged box only decides the descent, the leaf is the proxy's own box.
+				if (inside || ClassifyBox(SlotBoxes[node.Slot], frustum) != EBoxClass::Outside)
+				{
+					userData.push_back(SlotUserData[node.Slot]);
+				}
+				continue;
+			}
+
+			assert(stackSize + 2 <= MaxDynamicHeight + 1);
+			stack[stackSize++] = node.Child1 | (inside ? InsideBit : 0);
+			stack[stackSize++] = node.Child2 | (inside ? InsideBit : 0);
+		}
+	}
+}
+
+void FBoundingVolumeHierarchy::QueryBox(const FBoundingBox& box, std::vector<uint32_t>& userData) const
+{
+	if (!StaticNodes.empty())
+	{
+		const FRegister queryMin[3] = { FNodeVector::Set(box.Min.X), FNodeVector::Set(box.Min.Y), FNodeVector::Set(box.Min.Z) };
+		const FRegister queryMax[3] = { FNodeVector::Set(box.Max.X), FNodeVector::Set(box.Max.Y), FNodeVector::Set(box.Max.Z) };
+
+		uint32_t stack[MaxStaticDepth * 3 + 1];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const FStaticNode& node = StaticNodes[stack[--stackSize]];
+			uint32_t overlapBits = TestBoxLanes(node.Bounds, queryMin, queryMax);
+
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if (!((overlapBits >> lane) & 1))
+				{
+					continue;
+				}
+
+				if (node.Counts[lane] == 0)
+				{
+					stack[stackSize++] = node.Children[lane];
+					continue;
+				}
+
+				uint32_t end = node.Children[lane] + node.Counts[lane];
+				for (uint32_t primitive = node.Children[lane]; primitive < end; ++primitive)
+				{
+					if (Overlaps(StaticBoxes[primitive], box))
+					{
+						userData.push_back(StaticUserData[primitive]);
+					}
+				}
+			}
+		}
+	}
+
+	if (DynamicRoot != InvalidIndex)
+	{
+		uint32_t stack[MaxDynamicHeight + 1];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = DynamicRoot;
+
+		while (stackSize > 0)
+		{
+			const FDynamicNode& node = DynamicNodes[stack[--stackSize]];
+			if (!Overlaps(node.Box, box))
+			{
+				continue;
+			}
+
+			if (node.Height == 0)
+			{
+				if (Overlaps(SlotBoxes[node.Slot], box))
+				{
+					userData.push_back(SlotUserData[node.Slot]);
+				}
+				continue;
+			}
+
+			assert(stackSize + 2 <= MaxDynamicHeight + 1);
+			stack[stackSize++] = node.Child1;
+			stack[stackSize++] = node.Child2;
+		}
+	}
+}
+
+bool FBoundingVolumeHierarchy::RayCast(const FFloat3& origin, const FFloat3& direction, float maxDistance, FBvhRayHit& hit) const
+{
+	const FRayTest test = MakeRayTest(origin, direction);
+
+	float closest = maxDistance;
+	bool found = false;
+
+	if (!StaticNodes.empty())
+	{
+		uint32_t stack[MaxStaticDepth * 3 + 1];
+		float stackEntries[MaxStaticDepth * 3 + 1];
+		uint32_t stackSize = 0;
+		stack[stackSize] = 0;
+		stackEntries[stackSize++] = 0.0f;
+
+		while (stackSize > 0)
+		{
+			--stackSize;
+			if (stackEntries[stackSize] > closest)
+			{
+				continue;
+			}
+
+			const FStaticNode& node = StaticNodes[stack[stackSize]];
+
+			float entries[4];
+			uint32_t hitBits = TestRayLanes(node.Bounds, test, closest, entries);
+
+			// Children are pushed far to near, so the nearest is searched first and shortens the ray for
+			// the others.
+			uint32_t lanes[4];
+			uint32_t laneCount = 0;
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if (!((hitBits >> lane) & 1))
+				{
+					continue;
+				}
+
+				if (node.Counts[lane] == 0)
+				{
+					uint32_t position = laneCount++;
+					while (position > 0 && entries[lanes[position - 1]] < entries[lane])
+					{
+						lanes[position] = lanes[position - 1];
+						--position;
+					}
+					lanes[position] = lane;
+					continue;
+				}
+
+				uint32_t end = node.Children[lane] + node.Counts[lane];
+				for (uint32_t primitive = node.Children[lane]; primitive < end; ++primitive)
+				{
+					float entry;
+					if (RayEntersBox(StaticBoxes[primitive], test, closest, entry))
+					{
+						closest = entry;
+						hit.UserData = StaticUserData[primitive];
+						hit.Distance = entry;
+						found = true;
+					}
+				}
+			}
+
+			for (uint32_t i = 0; i < laneCount; ++i)
+			{
+				stack[stackSize] = node.Children[lanes[i]];
+				stackEntries[stackSize++] = entries[lanes[i]];
+			}
+		}
+	}
+
+	if (DynamicRoot != InvalidIndex)
+	{
+		uint32_t stack[MaxDynamicHeight + 1];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = DynamicRoot;
+
+		while (stackSize > 0)
+		{
+			const FDynamicNode& node = DynamicNodes[stack[--stackSize]];
+
+			float entry;
+			if (!RayEntersBox(node.Box, test, closest, entry))
+			{
+				continue;
+			}
+
+			if (node.Height == 0)
+			{
+				if (RayEntersBox(SlotBoxes[node.Slot], test, closest, entry))
+				{
+					closest = entry;
+					hit.UserData = SlotUserData[node.Slot];
+					hit.Distance = entry;
+					found = true;
+				}
+				continue;
+			}
+
+			assert(stackSize + 2 <= MaxDynamicHeight + 1);
+			stack[stackSize++] = node.Child1;
+			stack[stackSize++] = node.Child2;
+		}
+	}
+
+	return found;
+}
+
+uint32_t FBoundingVolumeHierarchy::GetProxyCount() const
+{
+	return LiveProxyCount;
+}
+
+const FBvhStats& FBoundingVolumeHierarchy::GetLastUpdateStats() const
+{
+	return LastUpdateStats;
+}
+
+uint32_t FBoundingVolumeHierarchy::GetSlot(FBvhProxyHandle proxy) const
+{
+	assert(IsAlive(proxy));
+
+	return proxy.Value - 1;
+}
+
+uint32_t FBoundingVolumeHierarchy::BuildStaticNode(uint32_t begin, uint32_t end, uint32_t depth)
+{
+	assert(depth < MaxStaticDepth);
+
+	uint32_t nodeIndex = static_cast<uint32_t>(StaticNodes.size());
+	StaticNodes.emplace_back();
+	StaticNodeParents.push_back(InvalidIndex);
+
+	// Two levels of binary splits make the four children, always splitting the largest range.
+	uint32_t rangeBegins[4] = { begin };
+	uint32_t rangeEnds[4] = { end };
+	uint32_t rangeCount = 1;
+	while (rangeCount < 4)
+	{
+		uint32_t largest = InvalidIndex;
+		for (uint32_t range = 0; range < rangeCount; ++range)
+		{
+			uint32_t size = rangeEnds[range] - rangeBegins[range];
+			if (size > MaxLeafSize && (largest == InvalidIndex || size > rangeEnds[largest] - rangeBegins[largest]))
+			{
+				largest = range;
+			}
+		}
+
+		if (largest == InvalidIndex)
+		{
+			break;
+		}
+
+		uint32_t middle = SplitBuildRange(rangeBegins[largest], rangeEnds[largest], depth);
+		rangeBegins[rangeCount] = middle;
+		rangeEnds[rangeCount] = rangeEnds[largest];
+		rangeEnds[largest] = middle;
+		++rangeCount;
+	}
+
+	FStaticNode node;
+	for (uint32_t lane = 0; lane < 4; ++lane)
+	{
+		SetLane(node.Bounds, lane, EmptyBox);
+		node.Children[lane] = InvalidIndex;
+		node.Counts[lane] = 0;
+		node.Padding[lane % 3] = 0;
+	}
+
+	for (uint32_t lane = 0; lane < rangeCount; ++lane)
+	{
+		uint32_t rangeBegin = rangeBegins[lane];
+		uint32_t rangeEnd = rangeEnds[lane];
+
+		FBoundingBox box = EmptyBox;
+		if (rangeEnd - rangeBegin <= MaxLeafSize)
+		{
+			for (uint32_t item = rangeBegin; item < rangeEnd; ++item)
+			{
+				box = Union(box, BuildItems[item].Box);
+				StaticLeafNodes[item] = nodeIndex;
+			}
+
+			node.Children[lane] = rangeBegin;
+			node.Counts[lane] = static_cast<uint8_t>(rangeEnd - rangeBegin);
+		}
+		else
+		{
+			uint32_t child = BuildStaticNode(rangeBegin, rangeEnd, depth + 1);
+			StaticNodeParents[child] = nodeIndex;
+			box = UnionOfLanes(StaticNodes[child].Bounds);
+
+			node.Children[lane] = child;
+		}
+
+		SetLane(node.Bounds, lane, box);
+	}
+
+	StaticNodes[nodeIndex] = node;
+
+	return nodeIndex;
+}
+
+uint32_t FBoundingVolumeHierarchy::SplitBuildRange(uint32_t begin, uint32_t end, uint32_t depth)
+{
+	float centreMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float centreMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t item = begin; item < end; ++item)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float value = BuildItems[item].Centre[axis];
+			centreMin[axis] = std::min(centreMin[axis], value);
+			centreMax[axis] = std::max(centreMax[axis], value);
+		}
+	}
+
+	uint32_t widestAxis = 0;
+	for (uint32_t axis = 1; axis < 3; ++axis)
+	{
+		if (centreMax[axis] - centreMin[axis] > centreMax[widestAxis] - centreMin[widestAxis])
+		{
+			widestAxis = axis;
+		}
+	}
+
+	uint32_t middle = begin + (end - begin) / 2;
+
+	// Coincident centres cannot be told apart, any half will do.
+	if (centreMax[widestAxis] <= centreMin[widestAxis])
+	{
+		return middle;
+	}
+
+	if (depth >= MedianSplitDepth)
+	{
+		std::nth_element(BuildItems.begin() + begin, BuildItems.begin() + middle, BuildItems.begin() + end,
+			[&](const FBuildItem& a, const FBuildItem& b) { return a.Centre[widestAxis] < b.Centre[widestAxis]; });
+
+		return middle;
+	}
+
+	struct FBin
+	{
+		FBoundingBox Box = EmptyBox;
+		uint32_t Count = 0;
+	};
+
+	// Small ranges get a bin per item at most, the sweep would cost more than the items.
+	const uint32_t binCount = std::min(MaxSplitBins, end - begin);
+
+	FBin bins[3][MaxSplitBins];
+	float binScales[3];
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		float extent = centreMax[axis] - centreMin[axis];
+		binScales[axis] = extent > 0.0f ? binCount * 0.9999f / extent : 0.0f;
+	}
+
+	auto getBin = [&](const FBuildItem& item, uint32_t axis)
+	{
+		return std::min(static_cast<uint32_t>((item.Centre[axis] - centreMin[axis]) * binScales[axis]), binCount - 1);
+	};
+
+	for (uint32_t item = begin; item < end; ++item)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			FBin& bin = bins[axis][getBin(BuildItems[item], axis)];
+			bin.Box = Union(bin.Box, BuildItems[item].Box);
+			++bin.Count;
+		}
+	}
+
+	// Cost of splitting after bin i is area(left) * count(left) + area(right) * count(right).
+	float bestCost = FLT_MAX;
+	uint32_t bestAxis = widestAxis;
+	uint32_t bestBin = InvalidIndex;
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		if (binScales[axis] == 0.0f)
+		{
+			continue;
+		}
+
+		float rightCosts[MaxSplitBins];
+		FBoundingBox rightBox = EmptyBox;
+		uint32_t rightCount = 0;
+		for (uint32_t bin = binCount - 1; bin > 0; --bin)
+		{
+			rightBox = Union(rightBox, bins[axis][bin].Box);
+			rightCount += bins[axis][bin].Count;
+			rightCosts[bin - 1] = rightCount > 0 ? HalfArea(rightBox) * rightCount : -1.0f;
+		}
+
+		FBoundingBox leftBox = EmptyBox;
+		uint32_t leftCount = 0;
+		for (uint32_t bin = 0; bin + 1 < binCount; ++bin)
+		{
+			leftBox = Union(leftBox, bins[axis][bin].Box);
+			leftCount += bins[axis][bin].Count;
+
+			if (leftCount == 0 || rightCosts[bin] < 0.0f)
+			{
+				continue;
+			}
+
+			float cost = HalfArea(leftBox) * leftCount + rightCosts[bin];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin;
+			}
+		}
+	}
+
+	if (bestBin == InvalidIndex)
+	{
+		return middle;
+	}
+
+	auto split = std::partition(BuildItems.begin() + begin, BuildItems.begin() + end,
+		[&](const FBuildItem& item) { return getBin(item, bestAxis) <= bestBin; });
+
+	return static_cast<uint32_t>(split - BuildItems.begin());
+}
+
+void FBoundingVolumeHierarchy::MarkStaticLeafDirty(uint32_t primitive)
+{
+	// Flagged nodes always have flagged ancestors, so the walk stops at the first one.
+	uint32_t node = StaticLeafNodes[primitive];
+	while (node != InvalidIndex && !StaticNodeDirty[node])
+	{
+		StaticNodeDirty[node] = 1;
+		node = StaticNodeParents[node];
+	}
+
+	HasDirtyStaticNodes = true;
+}
+
+void FBoundingVolumeHierarchy::RefitStaticTree()
+{
+	if (!HasDirtyStaticNodes)
+	{
+		return;
+	}
+
+	// Children come after their parents, so a backwards pass sees every child before its parent.
+	for (uint32_t index = static_cast<uint32_t>(StaticNodes.size()); index > 0; --index)
+	{
+		uint32_t nodeIndex = index - 1;
+		if (!StaticNodeDirty[nodeIndex])
+		{
+			continue;
+		}
+
+		FStaticNode& node = StaticNodes[nodeIndex];
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			if (node.Children[lane] == InvalidIndex)
+			{
+				continue;
+			}
+
+			FBoundingBox box = EmptyBox;
+			if (node.Counts[lane] > 0)
+			{
+				uint32_t end = node.Children[lane] + node.Counts[lane];
+				for (uint32_t primitive = node.Children[lane]; primitive < end; ++primitive)
+				{
+					box = Union(box, StaticBoxes[primitive]);
+				}
+			}
+			else
+			{
+				box = UnionOfLanes(StaticNodes[node.Children[lane]].Bounds);
+			}
+
+			SetLane(node.Bounds, lane, box);
+		}
+
+		StaticNodeDirty[nodeIndex] = 0;
+		++Stats.NodesRefitted;
+	}
+
+	HasDirtyStaticNodes = false;
+}
+
+uint32_t FBoundingVolumeHierarchy::AllocateDynamicNode()
+{
+	uint32_t node;
+	if (DynamicFreeList != InvalidIndex)
+	{
+		// Free nodes are linked through their parent.
+		node = DynamicFreeList;
+		DynamicFreeList = DynamicNodes[node].Parent;
+	}
+	else
+	{
+		node = static_cast<uint32_t>(DynamicNodes.size());
+		DynamicNodes.emplace_back();
+	}
+
+	DynamicNodes[node] = FDynamicNode();
+	DynamicNodes[node].Height = 0;
+	++DynamicNodeCount;
+
+	return node;
+}
+
+void FBoundingVolumeHierarchy::FreeDynamicNode(uint32_t node)
+{
+	DynamicNodes[node].Parent = DynamicFreeList;
+	DynamicNodes[node].Height = -1;
+	DynamicFreeList = node;
+	--DynamicNodeCount;
+}
+
+void FBoundingVolumeHierarchy::InsertDynamicLeaf(uint32_t leaf)
+{
+	if (DynamicRoot == InvalidIndex)
+	{
+		DynamicRoot = leaf;
+		DynamicNodes[leaf].Parent = InvalidIndex;
+		return;
+	}
+
+	// Descend towards the sibling that grows the total area least, stopping where pairing with the
+	// current node is cheaper than going deeper.
+	const FBoundingBox leafBox = DynamicNodes[leaf].Box;
+	uint32_t index = DynamicRoot;
+	while (DynamicNodes[index].Height > 0)
+	{
+		const FDynamicNode& node = DynamicNodes[index];
+
+		float area = HalfArea(node.Box);
+		float combinedArea = HalfArea(Union(node.Box, leafBox));
+
+		// A new parent here costs its own area, and every ancestor grows by the leaf.
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		const uint32_t children[2] = { node.Child1, node.Child2 };
+		for (uint32_t child = 0; child < 2; ++child)
+		{
+			const FDynamicNode& childNode = DynamicNodes[children[child]];
+			float grownArea = HalfArea(Union(childNode.Box, leafBox));
+			childCosts[child] = (childNode.Height == 0 ? grownArea : grownArea - HalfArea(childNode.Box)) + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+		{
+			break;
+		}
+
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	uint32_t sibling = index;
+	uint32_t oldParent = DynamicNodes[sibling].Parent;
+	uint32_t newParent = AllocateDynamicNode();
+
+	FDynamicNode& parentNode = DynamicNodes[newParent];
+	parentNode.Parent = oldParent;
+	parentNode.Box = Union(leafBox, DynamicNodes[sibling].Box);
+	parentNode.Height = DynamicNodes[sibling].Height + 1;
+	parentNode.Child1 = sibling;
+	parentNode.Child2 = leaf;
+
+	if (oldParent != InvalidIndex)
+	{
+		FDynamicNode& oldParentNode = DynamicNodes[oldParent];
+		(oldParentNode.Child1 == sibling ? oldParentNode.Child1 : oldParentNode.Child2) = newParent;
+	}
+	else
+	{
+		DynamicRoot = newParent;
+	}
+
+	DynamicNodes[sibling].Parent = newParent;
+	DynamicNodes[leaf].Parent = newParent;
+
+	// Walk back up, refitting and rebalancing the ancestors.
+	index = DynamicNodes[leaf].Parent;
+	while (index != InvalidIndex)
+	{
+		index = BalanceDynamicNode(index);
+
+		FDynamicNode& node = DynamicNodes[index];
+		node.Height = 1 + std::max(DynamicNodes[node.Child1].Height, DynamicNodes[node.Child2].Height);
+		node.Box = Union(DynamicNodes[node.Child1].Box, DynamicNodes[node.Child2].Box);
+
+		index = node.Parent;
+	}
+}
+
+void FBoundingVolumeHierarchy::RemoveDynamicLeaf(uint32_t leaf)
+{
+	if (leaf == DynamicRoot)
+	{
+		DynamicRoot = InvalidIndex;
+		return;
+	}
+
+	uint32_t parent = DynamicNodes[leaf].Parent;
+	uint32_t grandParent = DynamicNodes[parent].Parent;
+	uint32_t sibling = DynamicNodes[parent].Child1 == leaf ? DynamicNodes[parent].Child2 : DynamicNodes[parent].Child1;
+
+	// The sibling takes the place of the parent.
+	FreeDynamicNode(parent);
+	DynamicNodes[sibling].Parent = grandParent;
+
+	if (grandParent == InvalidIndex)
+	{
+		DynamicRoot = sibling;
+		return;
+	}
+
+	FDynamicNode& grandParentNode = DynamicNodes[grandParent];
+	(grandParentNode.Child1 == parent ? grandParentNode.Child1 : grandParentNode.Child2) = sibling;
+
+	uint32_t index = grandParent;
+	while (index != InvalidIndex)
+	{
+		index = BalanceDynamicNode(index);
+
+		FDynamicNode& node = DynamicNodes[index];
+		node.Height = 1 + std::max(DynamicNodes[node.Child1].Height, DynamicNodes[node.Child2].Height);
+		node.Box = Union(DynamicNodes[node.Child1].Box, DynamicNodes[node.Child2].Box);
+
+		index = node.Parent;
+	}
+}
+
+uint32_t FBoundingVolumeHierarchy::BalanceDynamicNode(uint32_t a)
+{
+	// Rotates the higher child of a up when the heights of its children differ by more than one, and
+	// returns the node that now stands where a was.
+	if (DynamicNodes[a].Height < 2)
+	{
+		return a;
+	}
+
+	uint32_t b = DynamicNodes[a].Child1;
+	uint32_t c = DynamicNodes[a].Child2;
+	int32_t balance = DynamicNodes[c].Height - DynamicNodes[b].Height;
+	if (balance >= -1 && balance <= 1)
+	{
+		return a;
+	}
+
+	// The higher child rises, the lower stays with a, and the higher child's lower child moves to a.
+	uint32_t up = balance > 1 ? c : b;
+	uint32_t stay = balance > 1 ? b : c;
+	uint32_t upChild1 = DynamicNodes[up].Child1;
+	uint32_t upChild2 = DynamicNodes[up].Child2;
+	bool firstIsHigher = DynamicNodes[upChild1].Height > DynamicNodes[upChild2].Height;
+	uint32_t keep = firstIsHigher ? upChild1 : upChild2;
+	uint32_t move = firstIsHigher ? upChild2 : upChild1;
+
+	FDynamicNode& nodeA = DynamicNodes[a];
+	FDynamicNode& nodeUp = DynamicNodes[up];
+
+	nodeUp.Parent = nodeA.Parent;
+	nodeA.Parent = up;
+	if (nodeUp.Parent != InvalidIndex)
+	{
+		FDynamicNode& parent = DynamicNodes[nodeUp.Parent];
+		(parent.Child1 == a ? parent.Child1 : parent.Child2) = up;
+	}
+	else
+	{
+		DynamicRoot = up;
+	}
+
+	nodeUp.Child1 = a;
+	nodeUp.Child2 = keep;
+	if (balance > 1)
+	{
+		nodeA.Child2 = move;
+	}
+	else
+	{
+		nodeA.Child1 = move;
+	}
+	DynamicNodes[move].Parent = a;
+
+	nodeA.Box = Union(DynamicNodes[stay].Box, DynamicNodes[move].Box);
+	nodeA.Height = 1 + std::max(DynamicNodes[stay].Height, DynamicNodes[move].Height);
+	nodeUp.Box = Union(nodeA.Box, DynamicNodes[keep].Box);
+	nodeUp.Height = 1 + std::max(nodeA.Height, DynamicNodes[keep].Height);
+
+	return up;
+}
+
+void FBoundingVolumeHierarchy::AddDynamicProxy(uint32_t slot)
+{
+	uint32_t leaf = AllocateDynamicNode();
+
+	const FBoundingBox& box = SlotBoxes[slot];
+	FDynamicNode& node = DynamicNodes[leaf];
+	node.Box = { { box.Min.X - DynamicMargin, box.Min.Y - DynamicMargin, box.Min.Z - DynamicMargin },
+		{ box.Max.X + DynamicMargin, box.Max.Y + DynamicMargin, box.Max.Z + DynamicMargin } };
+	node.Slot = slot;
+
+	InsertDynamicLeaf(leaf);
+
+	SlotPlacements[slot] = EPlacement::DynamicTree;
+	SlotLocations[slot] = leaf;
+	++DynamicLeafCount;
+}
+
+void FBoundingVolumeHierarchy::RemoveDynamicProxy(uint32_t slot)
+{
+	uint32_t leaf = SlotLocations[slot];
+
+	RemoveDynamicLeaf(leaf);
+	FreeDynamicNode(leaf);
+
+	SlotPlacements[slot] = EPlacement::Pending;
+	SlotLocations[slot] = InvalidIndex;
+	--DynamicLeafCount;
+}
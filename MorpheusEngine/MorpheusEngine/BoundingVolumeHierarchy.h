@@ -0,0 +1,213 @@
+#pragma once
+
+#include "FrustumCulling.h"
+#include "TransformMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Axis aligned box. An empty box has Min above Max and overlaps nothing.
+struct FBoundingBox
+{
+	FFloat3 Min;
+	FFloat3 Max;
+};
+
+// World box of a local box moved by a row vector world matrix.
+FBoundingBox TransformBoundingBox(const FBoundingBox& box, const FFloat4x4& world);
+
+// One-based, zero is the invalid proxy.
+struct FBvhProxyHandle
+{
+	uint32_t Value = 0;
+
+	bool IsValid() const
+	{
+		return Value != 0;
+	}
+
+	bool operator==(const FBvhProxyHandle& other) const
+	{
+		return Value == other.Value;
+	}
+
+	bool operator!=(const FBvhProxyHandle& other) const
+	{
+		return Value != other.Value;
+	}
+};
+
+enum class EBvhProxyType : uint8_t
+{
+	// Built into the SAH tree. Moves refit the tree in Update(), which stays tight as long as objects
+	// only move a little or together.
+	Static,
+	// Kept in the incremental tree with enlarged bounds, and reinserted when they leave them.
+	Dynamic
+};
+
+struct FBvhRayHit
+{
+	uint32_t UserData = 0;
+	// Where the ray enters the box, in lengths of the ray direction. Zero when it starts inside.
+	float Distance = 0.0f;
+};
+
+// Counters of the last call to Update() and the changes since the one before.
+struct FBvhStats
+{
+	uint32_t StaticProxies = 0;
+	uint32_t DynamicProxies = 0;
+	uint32_t StaticNodes = 0;
+	uint32_t DynamicNodes = 0;
+	uint32_t NodesRefitted = 0;
+	uint32_t Reinserts = 0;
+	bool StaticTreeRebuilt = false;
+};
+
+// Spatial index over the bounds of scene objects, for culling, picking and proximity queries.
+//
+// Static proxies live in a tree of 4-wide nodes built top down with the binned surface area
+// heuristic. Every node keeps the boxes of its four children as structure of arrays, so one node is
+// tested with a single SIMD instruction per plane or slab, and the nodes are stored depth first in one
+// array. Dynamic proxies live in a binary tree that is updated incrementally, balanced by rotations,
+// with boxes enlarged so small moves do not touch the tree.
+//
+// New static proxies wait for the next Update(), which either rebuilds the static tree, once the
+// proxies outside it and the destroyed ones in it add up to a quarter of it, or moves them into the
+// dynamic tree. Moves of static proxies also show in queries after Update(), everything else right
+// away. Not thread safe, but the const queries may run concurrently with each other.
+class FBoundingVolumeHierarchy
+{
+public:
+	static const uint32_t MaxLeafSize = 4;
+
+	// Margin added on every side of dynamic boxes.
+	explicit FBoundingVolumeHierarchy(float dynamicMargin = 0.1f);
+
+	FBvhProxyHandle CreateProxy(const FBoundingBox& box, uint32_t userData, EBvhProxyType type);
+	void DestroyProxy(FBvhProxyHandle proxy);
+	bool IsAlive(FBvhProxyHandle proxy) const;
+
+	void SetBounds(FBvhProxyHandle proxy, const FBoundingBox& box);
+	const FBoundingBox& GetBounds(FBvhProxyHandle proxy) const;
+	uint32_t GetUserData(FBvhProxyHandle proxy) const;
+
+	// Refits the static tree after moves, or rebuilds it when it has gone stale.
+	void Update();
+	// Builds the static tree over every static proxy.
+	void RebuildStaticTree();
+
+	// The queries append the user data of every matching proxy, in no particular order.
+	void QueryFrustum(const FFrustum& frustum, std::vector<uint32_t>& userData) const;
+	void QueryBox(const FBoundingBox& box, std::vector<uint32_t>& userData) const;
+	// Finds the box the ray enters first within maxDistance.
+	bool RayCast(const FFloat3& origin, const FFloat3& direction, float maxDistance, FBvhRayHit& hit) const;
+
+	uint32_t GetProxyCount() const;
+	const FBvhStats& GetLastUpdateStats() const;
+
+private:
+	static constexpr uint32_t InvalidIndex = ~0u;
+	// Builds split at the median below this depth, which quarters the ranges on every level, so the
+	// static tree stays under MaxStaticDepth and the traversal stacks can be fixed arrays.
+	static const uint32_t MedianSplitDepth = 40;
+	static const uint32_t MaxStaticDepth = 64;
+	// AVL balancing keeps the dynamic tree below 1.44 log2 of its leaf count.
+	static const uint32_t MaxDynamicHeight = 64;
+
+	enum class EPlacement : uint8_t
+	{
+		Free,
+		// A static proxy waiting for Update().
+		Pending,
+		StaticTree,
+		DynamicTree
+	};
+
+	// Four children as structure of arrays. A lane with a count is a leaf of that many primitives from
+	// Children, a lane without one an inner node, and an unused lane has an empty box.
+	struct alignas(16) FStaticNode
+	{
+		// MinX, MinY, MinZ, MaxX, MaxY, MaxZ.
+		float Bounds[6][4];
+		uint32_t Children[4];
+		uint8_t Counts[4];
+		uint32_t Padding[3];
+	};
+
+	struct FDynamicNode
+	{
+		FBoundingBox Box;
+		uint32_t Parent = InvalidIndex;
+		uint32_t Child1 = InvalidIndex;
+		uint32_t Child2 = InvalidIndex;
+		// Zero for leaves, minus one for free nodes.
+		int32_t Height = -1;
+		uint32_t Slot = InvalidIndex;
+	};
+
+	struct FBuildItem
+	{
+		FBoundingBox Box;
+		// Min + Max, twice the centre.
+		float Centre[3];
+		uint32_t Slot;
+	};
+
+	uint32_t GetSlot(FBvhProxyHandle proxy) const;
+
+	uint32_t BuildStaticNode(uint32_t begin, uint32_t end, uint32_t depth);
+	uint32_t SplitBuildRange(uint32_t begin, uint32_t end, uint32_t depth);
+	void MarkStaticLeafDirty(uint32_t primitive);
+	void RefitStaticTree();
+
+	uint32_t AllocateDynamicNode();
+	void FreeDynamicNode(uint32_t node);
+	void InsertDynamicLeaf(uint32_t leaf);
+	void RemoveDynamicLeaf(uint32_t leaf);
+	uint32_t BalanceDynamicNode(uint32_t node);
+	void AddDynamicProxy(uint32_t slot);
+	void RemoveDynamicProxy(uint32_t slot);
+
+	float DynamicMargin;
+
+	// Per handle slot, indexed by handle value - 1.
+	std::vector<FBoundingBox> SlotBoxes;
+	std::vector<uint32_t> SlotUserData;
+	std::vector<EBvhProxyType> SlotTypes;
+	std::vector<EPlacement> SlotPlacements;
+	// Index into PendingSlots, primitive of the static tree or leaf of the dynamic tree.
+	std::vector<uint32_t> SlotLocations;
+	std::vector<uint32_t> FreeSlots;
+	std::vector<uint32_t> PendingSlots;
+	uint32_t LiveProxyCount;
+	uint32_t StaticProxyCount;
+
+	// Static tree, parents before their children. Primitives are in leaf order; destroyed ones keep an
+	// empty box and an invalid slot until the next build.
+	std::vector<FStaticNode> StaticNodes;
+	std::vector<uint32_t> StaticNodeParents;
+	std::vector<uint8_t> StaticNodeDirty;
+	std::vector<FBoundingBox> StaticBoxes;
+	std::vector<uint32_t> StaticSlots;
+	std::vector<uint32_t> StaticUserData;
+	std::vector<uint32_t> StaticLeafNodes;
+	// Live and destroyed primitives of the static tree.
+	uint32_t StaticLiveCount;
+	uint32_t StaticRemovedCount;
+	bool HasDirtyStaticNodes;
+
+	// Dynamic tree.
+	std::vector<FDynamicNode> DynamicNodes;
+	uint32_t DynamicRoot;
+	uint32_t DynamicFreeList;
+	uint32_t DynamicNodeCount;
+	uint32_t DynamicLeafCount;
+
+	// Scratch space of the build, kept between calls.
+	std::vector<FBuildItem> BuildItems;
+
+	FBvhStats Stats;
+	FBvhStats LastUpdateStats;
+};
@@ -0,0 +1,278 @@
+#include "CommandBuffer.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	enum class ECommandPacketType : uint8_t
+	{
+		SetVertexBuffer,
+		SetIndexBuffer,
+		SetInputLayout,
+		SetVertexShader,
+		SetPixelShader,
+		SetConstantBuffer,
+		SetConstantBufferRange,
+		SetRasterizerState,
+		SetDepthStencilState,
+		SetBlendState,
+		SetViewport,
+		SetRenderTargets,
+		DrawIndexed,
+		DrawIndexedInstanced
+	};
+
+	// The low byte is the command, the next one a slot and the one above that a shader stage or index format.
+	uint32_t MakeHeader(ECommandPacketType type, uint32_t slot = 0, uint32_t mode = 0)
+	{
+		assert(slot < 256 && mode < 256);
+		return static_cast<uint32_t>(type) | (slot << 8) | (mode << 16);
+	}
+
+	template<typename HandleType>
+	HandleType ToHandle(uint32_t value)
+	{
+		HandleType handle;
+		handle.Value = value;
+		return handle;
+	}
+
+	uint32_t FloatBits(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	float BitsFloat(uint32_t bits)
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+}
+
+FCommandBuffer::FCommandBuffer()
+	: DrawCount(0)
+	, Recording(false)
+{
+}
+
+void FCommandBuffer::Begin()
+{
+	Words.clear();
+	DrawCount = 0;
+	Recording = true;
+}
+
+void FCommandBuffer::End()
+{
+	assert(Recording);
+	Recording = false;
+}
+
+uint32_t FCommandBuffer::GetDrawCount() const
+{
+	return DrawCount;
+}
+
+void FCommandBuffer::SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset)
+{
+	Write(MakeHeader(ECommandPacketType::SetVertexBuffer, slot), buffer.Value, stride, offset);
+}
+
+void FCommandBuffer::SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset)
+{
+	Write(MakeHeader(ECommandPacketType::SetIndexBuffer, 0, static_cast<uint32_t>(format)), buffer.Value, offset);
+}
+
+void FCommandBuffer::SetInputLayout(FInputLayoutHandle inputLayout)
+{
+	Write(MakeHeader(ECommandPacketType::SetInputLayout), inputLayout.Value);
+}
+
+void FCommandBuffer::SetVertexShader(FVertexShaderHandle shader)
+{
+	Write(MakeHeader(ECommandPacketType::SetVertexShader), shader.Value);
+}
+
+void FCommandBuffer::SetPixelShader(FPixelShaderHandle shader)
+{
+	Write(MakeHeader(ECommandPacketType::SetPixelShader), shader.Value);
+}
+
+void FCommandBuffer::SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer)
+{
+	Write(MakeHeader(ECommandPacketType::SetConstantBuffer, slot, static_cast<uint32_t>(stage)), buffer.Value);
+}
+
+void FCommandBuffer::SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size)
+{
+	Write(MakeHeader(ECommandPacketType::SetConstantBufferRange, slot, static_cast<uint32_t>(stage)), buffer.Value, offset, size);
+}
+
+void FCommandBuffer::SetRasterizerState(FRasterizerStateHandle state)
+{
+	Write(MakeHeader(ECommandPacketType::SetRasterizerState), state.Value);
+}
+
+void FCommandBuffer::SetDepthStencilState(FDepthStencilStateHandle state)
+{
+	Write(MakeHeader(ECommandPacketType::SetDepthStencilState), state.Value);
+}
+
+void FCommandBuffer::SetBlendState(FBlendStateHandle state)
+{
+	Write(MakeHeader(ECommandPacketType::SetBlendState), state.Value);
+}
+
+void FCommandBuffer::SetViewport(const FViewport& viewport)
+{
+	Write(MakeHeader(ECommandPacketType::SetViewport), FloatBits(viewport.TopLeftX), FloatBits(viewport.TopLeftY), FloatBits(viewport.Width));
+	Words.push_back(FloatBits(viewport.Height));
+	Words.push_back(FloatBits(viewport.MinDepth));
+	Words.push_back(FloatBits(viewport.MaxDepth));
+}
+
+void FCommandBuffer::SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil)
+{
+	Write(MakeHeader(ECommandPacketType::SetRenderTargets), renderTarget.Value, depthStencil.Value);
+}
+
+void FCommandBuffer::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	Write(MakeHeader(ECommandPacketType::DrawIndexed), indexCount, startIndex, static_cast<uint32_t>(baseVertex));
+	++DrawCount;
+}
+
+void FCommandBuffer::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	Write(MakeHeader(ECommandPacketType::DrawIndexedInstanced), indexCount, instanceCount, startIndex);
+	Words.push_back(static_cast<uint32_t>(baseVertex));
+	Words.push_back(startInstance);
+	++DrawCount;
+}
+
+void FCommandBuffer::Execute(ICommandContext& context) const
+{
+	assert(!Recording);
+
+	const uint32_t* word = Words.data();
+	const uint32_t* end = word + Words.size();
+
+	while (word < end)
+	{
+		uint32_t header = *word++;
+		uint32_t slot = (header >> 8) & 0xFF;
+		uint32_t mode = (header >> 16) & 0xFF;
+
+		switch (static_cast<ECommandPacketType>(header & 0xFF))
+		{
+			case ECommandPacketType::SetVertexBuffer:
+				context.SetVertexBuffer(slot, ToHandle<FBufferHandle>(word[0]), word[1], word[2]);
+				word += 3;
+				break;
+
+			case ECommandPacketType::SetIndexBuffer:
+				context.SetIndexBuffer(ToHandle<FBufferHandle>(word[0]), static_cast<EIndexFormat>(mode), word[1]);
+				word += 2;
+				break;
+
+			case ECommandPacketType::SetInputLayout:
+				context.SetInputLayout(ToHandle<FInputLayoutHandle>(*word++));
+				break;
+
+			case ECommandPacketType::SetVertexShader:
+				context.SetVertexShader(ToHandle<FVertexShaderHandle>(*word++));
+				break;
+
+			case ECommandPacketType::SetPixelShader:
+				context.SetPixelShader(ToHandle<FPixelShaderHandle>(*word++));
+				break;
+
+			case ECommandPacketType::SetConstantBuffer:
+				context.SetConstantBuffer(static_cast<EShaderStage>(mode), slot, ToHandle<FBufferHandle>(*word++));
+				break;
+
+			case ECommandPacketType::SetConstantBufferRange:
+				context.SetConstantBufferRange(static_cast<EShaderStage>(mode), slot, ToHandle<FBufferHandle>(word[0]), word[1], word[2]);
+				word += 3;
+				break;
+
+			case ECommandPacketType::SetRasterizerState:
+				context.SetRasterizerState(ToHandle<FRasterizerStateHandle>(*word++));
+				break;
+
+			case ECommandPacketType::SetDepthStencilState:
+				context.SetDepthStencilState(ToHandle<FDepthStencilStateHandle>(*word++));
+				break;
+
+			case ECommandPacketType::SetBlendState:
+				context.SetBlendState(ToHandle<FBlendStateHandle>(*word++));
+				break;
+
+			case ECommandPacketType::SetViewport:
+			{
+				FViewport viewport;
+				viewport.TopLeftX = BitsFloat(word[0]);
+				viewport.TopLeftY = BitsFloat(word[1]);
+				viewport.Width = BitsFloat(word[2]);
+				viewport.Height = BitsFloat(word[3]);
+				viewport.MinDepth = BitsFloat(word[4]);
+				viewport.MaxDepth = BitsFloat(word[5]);
+				context.SetViewport(viewport);
+				word += 6;
+				break;
+			}
+
+			case ECommandPacketType::SetRenderTargets:
+				context.SetRenderTargets(ToHandle<FTextureHandle>(word[0]), ToHandle<FTextureHandle>(word[1]));
+				word += 2;
+				break;
+
+			case ECommandPacketType::DrawIndexed:
+				context.DrawIndexed(word[0], word[1], static_cast<int32_t>(word[2]));
+				word += 3;
+				break;
+
+			case ECommandPacketType::DrawIndexedInstanced:
+				context.DrawIndexedInstanced(word[0], word[1], word[2], static_cast<int32_t>(word[3]), word[4]);
+				word += 5;
+				break;
+
+			default:
+				assert(false && "Corrupt command buffer");
+				return;
+		}
+	}
+}
+
+uint32_t FCommandBuffer::GetWordCount() const
+{
+	return static_cast<uint32_t>(Words.size());
+}
+
+void FCommandBuffer::Write(uint32_t header, uint32_t argument0)
+{
+	assert(Recording);
+	Words.push_back(header);
+	Words.push_back(argument0);
+}
+
+void FCommandBuffer::Write(uint32_t header, uint32_t argument0, uint32_t argument1)
+{
+	assert(Recording);
+	Words.push_back(header);
+	Words.push_back(argument0);
+	Words.push_back(argument1);
+}
+
+void FCommandBuffer::Write(uint32_t header, uint32_t argument0, uint32_t argument1, uint32_t argument2)
+{
+	assert(Recording);
+	Words.push_back(header);
+	Words.push_back(argument0);
+	Words.push_back(argument1);
+	Words.push_back(argument2);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <vector>
+
+// Command list in the engine's own format, for devices without native ones. Every call is stored as
+// a packet of 32-bit words: a header with the command in the low byte and a slot or stage above it,
+// followed by the arguments. Execute() decodes the packets in order and makes the same calls on the
+// context it is given, so executing a buffer is indistinguishable from having made the calls there.
+//
+// The words are kept between recordings, so a buffer that is reused every frame stops allocating
+// once it has seen its largest frame.
+class FCommandBuffer : public ICommandList
+{
+public:
+	FCommandBuffer();
+
+	void Begin() override;
+	void End() override;
+	uint32_t GetDrawCount() const override;
+
+	void SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset) override;
+	void SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset) override;
+	void SetInputLayout(FInputLayoutHandle inputLayout) override;
+	void SetVertexShader(FVertexShaderHandle shader) override;
+	void SetPixelShader(FPixelShaderHandle shader) override;
+	void SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer) override;
+	void SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size) override;
+	void SetRasterizerState(FRasterizerStateHandle state) override;
+	void SetDepthStencilState(FDepthStencilStateHandle state) override;
+	void SetBlendState(FBlendStateHandle state) override;
+	void SetViewport(const FViewport& viewport) override;
+	void SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil) override;
+
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+
+	// Plays the packets back in the order they were recorded.
+	void Execute(ICommandContext& context) const;
+
+	// Size of the recording, for measuring how compact it is.
+	uint32_t GetWordCount() const;
+
+private:
+	void Write(uint32_t header, uint32_t argument0);
+	void Write(uint32_t header, uint32_t argument0, uint32_t argument1);
+	void Write(uint32_t header, uint32_t argument0, uint32_t argument1, uint32_t argument2);
+
+	std::vector<uint32_t> Words;
+	uint32_t DrawCount;
+	bool Recording;
+};
@@ -0,0 +1,202 @@
+#include "ConstantBufferRing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	uint32_t AlignSize(uint32_t size)
+	{
+		return (size + ConstantBufferRangeAlignment - 1) & ~(ConstantBufferRangeAlignment - 1);
+	}
+}
+
+FConstantBufferRing::FConstantBufferRing(IRenderDevice* renderDevice, uint32_t pageSize)
+	: RenderDevice(renderDevice)
+	, PageSize(AlignSize(std::max(pageSize, MaxConstantBufferRangeSize)))
+	, RangesSupported(renderDevice->SupportsConstantBufferRanges())
+	, CurrentPage(InvalidPage)
+	, CurrentOffset(0)
+	, CurrentData(nullptr)
+{
+	assert(RenderDevice);
+}
+
+FConstantBufferRing::~FConstantBufferRing()
+{
+	Commit();
+
+	for (FPage& page : Pages)
+	{
+		if (page.Buffer.IsValid())
+		{
+			RenderDevice->DestroyBuffer(page.Buffer);
+		}
+	}
+}
+
+void FConstantBufferRing::BeginFrame()
+{
+	// Fences complete in order, so the retired pages do too.
+	size_t reclaimed = 0;
+	while (reclaimed < RetiredPages.size() && RenderDevice->IsFenceComplete(Pages[RetiredPages[reclaimed]].Fence))
+	{
+		FreePages.push_back(RetiredPages[reclaimed]);
+		++reclaimed;
+	}
+
+	RetiredPages.erase(RetiredPages.begin(), RetiredPages.begin() + reclaimed);
+}
+
+FConstantBufferAllocation FConstantBufferRing::Allocate(uint32_t size)
+{
+	assert(size > 0 && size <= MaxConstantBufferRangeSize);
+
+	FConstantBufferAllocation allocation;
+	uint32_t alignedSize = AlignSize(size);
+
+	// Without ranges every allocation is bound as a whole buffer of its own.
+	bool pageFull = CurrentPage == InvalidPage || CurrentOffset + alignedSize > Pages[CurrentPage].Size;
+	if ((pageFull || (!RangesSupported && CurrentOffset != 0)) && !OpenPage(alignedSize))
+	{
+		return allocation;
+	}
+
+	FPage& page = Pages[CurrentPage];
+	if (!CurrentData)
+	{
+		EMapMode mode = (RangesSupported && page.EverMapped) ? EMapMode::WriteNoOverwrite : EMapMode::WriteDiscard;
+
+		CurrentData = static_cast<uint8_t*>(RenderDevice->MapBuffer(page.Buffer, mode));
+		if (!CurrentData)
+		{
+			return allocation;
+		}
+
+		page.EverMapped = true;
+		++FrameStats.Maps;
+	}
+
+	allocation.Buffer = page.Buffer;
+	allocation.Offset = CurrentOffset;
+	allocation.Size = alignedSize;
+	allocation.Data = CurrentData + CurrentOffset;
+
+	CurrentOffset += alignedSize;
+
+	++FrameStats.Allocations;
+	FrameStats.BytesUploaded += size;
+	FrameStats.BytesAllocated += alignedSize;
+
+	return allocation;
+}
+
+FConstantBufferAllocation FConstantBufferRing::Upload(const void* data, uint32_t size)
+{
+	FConstantBufferAllocation allocation = Allocate(size);
+	if (allocation.IsValid())
+	{
+		std::memcpy(allocation.Data, data, size);
+	}
+
+	return allocation;
+}
+
+void FConstantBufferRing::Commit()
+{
+	if (CurrentData)
+	{
+		RenderDevice->UnmapBuffer(Pages[CurrentPage].Buffer);
+		CurrentData = nullptr;
+	}
+}
+
+void FConstantBufferRing::EndFrame()
+{
+	Commit();
+
+	if (!FramePages.empty())
+	{
+		uint64_t fence = RenderDevice->InsertFence();
+		for (uint32_t page : FramePages)
+		{
+			Pages[page].Fence = fence;
+			RetiredPages.push_back(page);
+		}
+
+		FramePages.clear();
+	}
+
+	CurrentPage = InvalidPage;
+	CurrentOffset = 0;
+
+	LastFrameStats = FrameStats;
+	FrameStats = FConstantBufferRingStats();
+}
+
+uint32_t FConstantBufferRing::GetPageSize() const
+{
+	return PageSize;
+}
+
+uint32_t FConstantBufferRing::GetPageCount() const
+{
+	return static_cast<uint32_t>(Pages.size());
+}
+
+const FConstantBufferRingStats& FConstantBufferRing::GetFrameStats() const
+{
+	return FrameStats;
+}
+
+const FConstantBufferRingStats& FConstantBufferRing::GetLastFrameStats() const
+{
+	return LastFrameStats;
+}
+
+bool FConstantBufferRing::OpenPage(uint32_t minimumSize)
+{
+	Commit();
+
+	CurrentPage = InvalidPage;
+	CurrentOffset = 0;
+
+	// Full sized pages always fit, the per-allocation pages of the fallback may not.
+	for (size_t i = FreePages.size(); i > 0; --i)
+	{
+		uint32_t page = FreePages[i - 1];
+		if (Pages[page].Size >= minimumSize)
+		{
+			FreePages.erase(FreePages.begin() + (i - 1));
+			CurrentPage = page;
+			break;
+		}
+	}
+
+	if (CurrentPage == InvalidPage)
+	{
+		FBufferDesc description;
+		description.Binding = EBufferBinding::Constant;
+		description.Usage = EResourceUsage::Dynamic;
+		description.ByteWidth = RangesSupported ? PageSize : minimumSize;
+
+		FPage page;
+		page.Buffer = RenderDevice->CreateBuffer(description, nullptr);
+		if (!page.Buffer.IsValid())
+		{
+			return false;
+		}
+
+		page.Size = description.ByteWidth;
+
+		CurrentPage = static_cast<uint32_t>(Pages.size());
+		Pages.push_back(page);
+		++FrameStats.PagesCreated;
+	}
+
+	FramePages.push_back(CurrentPage);
+	++FrameStats.PagesUsed;
+
+	return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <cstdint>
+#include <vector>
+
+// A slice of a constant buffer page, valid until the end of the frame it was allocated in. Data
+// points at mapped memory and may only be written before the next Commit().
+struct FConstantBufferAllocation
+{
+	FBufferHandle Buffer;
+	uint32_t Offset = 0;
+	uint32_t Size = 0;
+	void* Data = nullptr;
+
+	bool IsValid() const
+	{
+		return Data != nullptr;
+	}
+};
+
+// Counters gathered between two calls to EndFrame().
+struct FConstantBufferRingStats
+{
+	uint64_t Allocations = 0;
+	// Bytes the callers asked for, and the same rounded up to whole slices.
+	uint64_t BytesUploaded = 0;
+	uint64_t BytesAllocated = 0;
+	uint32_t PagesUsed = 0;
+	uint32_t PagesCreated = 0;
+	uint32_t Maps = 0;
+};
+
+// Suballocates per-draw constants from large dynamic pages instead of updating one buffer per object.
+// A page is mapped once with no-overwrite, filled with many 256 byte aligned slices and bound by
+// offset. Pages retire with a fence at the end of the frame and are reused once the GPU passed it.
+//
+// Typical frame: BeginFrame(), Allocate() and fill the constants of every draw, Commit(), record the
+// draws binding each slice with SetConstantBufferRange(), EndFrame(). Not thread safe.
+//
+// Devices without constant buffer ranges get one small page per allocation, mapped with discard, so
+// the same code runs everywhere.
+class FConstantBufferRing
+{
+public:
+	static const uint32_t DefaultPageSize = 256 * 1024;
+
+	explicit FConstantBufferRing(IRenderDevice* renderDevice, uint32_t pageSize = DefaultPageSize);
+	// Destroys the pages, which the device keeps until the frames using them retire.
+	~FConstantBufferRing();
+
+	FConstantBufferRing(const FConstantBufferRing&) = delete;
+	FConstantBufferRing& operator=(const FConstantBufferRing&) = delete;
+
+	// Reclaims the pages of frames the GPU has finished.
+	void BeginFrame();
+	// Returns an invalid allocation if the page cannot be created or mapped.
+	FConstantBufferAllocation Allocate(uint32_t size);
+	// Allocates and copies size bytes.
+	FConstantBufferAllocation Upload(const void* data, uint32_t size);
+	// Unmaps the page that is being filled. Must be called before a draw reads any slice; allocating
+	// again afterwards maps the same page without overwrite.
+	void Commit();
+	// Commits and fences the pages used this frame.
+	void EndFrame();
+
+	uint32_t GetPageSize() const;
+	uint32_t GetPageCount() const;
+
+	const FConstantBufferRingStats& GetFrameStats() const;
+	const FConstantBufferRingStats& GetLastFrameStats() const;
+
+private:
+	static constexpr uint32_t InvalidPage = ~0u;
+
+	struct FPage
+	{
+		FBufferHandle Buffer;
+		uint32_t Size = 0;
+		uint64_t Fence = 0;
+		// The first map of a buffer has to discard.
+		bool EverMapped = false;
+	};
+
+	bool OpenPage(uint32_t minimumSize);
+
+	IRenderDevice* RenderDevice;
+	uint32_t PageSize;
+	bool RangesSupported;
+
+	std::vector<FPage> Pages;
+	std::vector<uint32_t> FreePages;
+	// Pages of earlier frames in fence order, and pages used this frame.
+	std::vector<uint32_t> RetiredPages;
+	std::vector<uint32_t> FramePages;
+
+	uint32_t CurrentPage;
+	uint32_t CurrentOffset;
+	uint8_t* CurrentData;
+
+	FConstantBufferRingStats FrameStats;
+	FConstantBufferRingStats LastFrameStats;
+};
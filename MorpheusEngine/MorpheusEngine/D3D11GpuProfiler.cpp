@@ -0,0 +1,144 @@
+#include "DirectXTemplate.h"
+#include "D3D11GpuProfiler.h"
+
+FD3D11GpuProfiler::FD3D11GpuProfiler(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+	: DeviceContext(deviceContext)
+	, CurrentFrame(0)
+	, Recording(false)
+	, Valid(true)
+	, DroppedFrames(0)
+{
+	D3D11_QUERY_DESC disjointDescription = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+	D3D11_QUERY_DESC timestampDescription = { D3D11_QUERY_TIMESTAMP, 0 };
+
+	for (FFrame& frame : Frames)
+	{
+		Valid = Valid && SUCCEEDED(device->CreateQuery(&disjointDescription, &frame.Disjoint));
+		Valid = Valid && SUCCEEDED(device->CreateQuery(&timestampDescription, &frame.FrameBegin));
+
+		for (FRange& range : frame.Ranges)
+		{
+			Valid = Valid && SUCCEEDED(device->CreateQuery(&timestampDescription, &range.Begin));
+			Valid = Valid && SUCCEEDED(device->CreateQuery(&timestampDescription, &range.End));
+		}
+	}
+}
+
+FD3D11GpuProfiler::~FD3D11GpuProfiler()
+{
+	for (FFrame& frame : Frames)
+	{
+		SafeRelease(frame.Disjoint);
+		SafeRelease(frame.FrameBegin);
+
+		for (FRange& range : frame.Ranges)
+		{
+			SafeRelease(range.Begin);
+			SafeRelease(range.End);
+		}
+	}
+}
+
+void FD3D11GpuProfiler::BeginFrame()
+{
+	CurrentFrame = (CurrentFrame + 1) % FrameLatency;
+	FFrame& frame = Frames[CurrentFrame];
+
+	// The oldest frame is read back before its queries are reused.
+	if (frame.Pending)
+	{
+		Resolve(frame);
+	}
+
+	Recording = Valid && IsProfilerEnabled();
+	if (!Recording)
+	{
+		return;
+	}
+
+	frame.RangeCount = 0;
+	frame.CpuBeginTicks = GetProfilerTimestamp();
+	DeviceContext->Begin(frame.Disjoint);
+	DeviceContext->End(frame.FrameBegin);
+}
+
+uint32_t FD3D11GpuProfiler::BeginRange(const char* name)
+{
+	FFrame& frame = Frames[CurrentFrame];
+	if (!Recording || frame.RangeCount == MaxRangesPerFrame)
+	{
+		return InvalidRange;
+	}
+
+	FRange& range = frame.Ranges[frame.RangeCount];
+	range.Name = name;
+	range.Ended = false;
+	DeviceContext->End(range.Begin);
+
+	return frame.RangeCount++;
+}
+
+void FD3D11GpuProfiler::EndRange(uint32_t range)
+{
+	FFrame& frame = Frames[CurrentFrame];
+	if (!Recording || range >= frame.RangeCount)
+	{
+		return;
+	}
+
+	DeviceContext->End(frame.Ranges[range].End);
+	frame.Ranges[range].Ended = true;
+}
+
+void FD3D11GpuProfiler::EndFrame()
+{
+	if (!Recording)
+	{
+		return;
+	}
+
+	FFrame& frame = Frames[CurrentFrame];
+	DeviceContext->End(frame.Disjoint);
+	frame.Pending = true;
+	Recording = false;
+}
+
+uint64_t FD3D11GpuProfiler::GetDroppedFrameCount() const
+{
+	return DroppedFrames;
+}
+
+void FD3D11GpuProfiler::Resolve(FFrame& frame)
+{
+	frame.Pending = false;
+
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	UINT64 frameBegin = 0;
+	if (DeviceContext->GetData(frame.Disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK || disjoint.Disjoint ||
+		DeviceContext->GetData(frame.FrameBegin, &frameBegin, sizeof(frameBegin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+	{
+		++DroppedFrames;
+		return;
+	}
+
+	// GPU ticks to profiler ticks.
+	double tickScale = 1e9 / static_cast<double>(disjoint.Frequency) * GetProfilerTicksPerNanosecond();
+
+	for (uint32_t i = 0; i < frame.RangeCount; ++i)
+	{
+		const FRange& range = frame.Ranges[i];
+		UINT64 begin = 0;
+		UINT64 end = 0;
+		if (!range.Ended ||
+			DeviceContext->GetData(range.Begin, &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			DeviceContext->GetData(range.End, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			begin < frameBegin || end < begin)
+		{
+			continue;
+		}
+
+		uint64_t start = frame.CpuBeginTicks + static_cast<uint64_t>((begin - frameBegin) * tickScale);
+		uint64_t finish = frame.CpuBeginTicks + static_cast<uint64_t>((end - frameBegin) * tickScale);
+		RecordProfileGpuScope(range.Name, start, finish);
+	}
+}
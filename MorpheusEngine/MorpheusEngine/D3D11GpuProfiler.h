@@ -0,0 +1,61 @@
+#pragma once
+
+#include "DirectXTemplate.h"
+#include "Profiler.h"
+
+#include <cstdint>
+
+// Timestamp queries on the Direct3D 11 immediate context. Each frame in flight owns a disjoint query
+// and a fixed set of timestamps; the results of a frame are read back FrameLatency frames later,
+// without stalling, and frames the GPU has not finished by then or that were disjoint are dropped.
+//
+// GPU times are placed on the CPU clock relative to the BeginFrame() of their frame, which makes the
+// GPU track line up with the submission only roughly. Called from the render thread only.
+class FD3D11GpuProfiler : public IGpuProfiler
+{
+public:
+	static const uint32_t FrameLatency = 4;
+	static const uint32_t MaxRangesPerFrame = 32;
+
+	FD3D11GpuProfiler(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	~FD3D11GpuProfiler() override;
+
+	FD3D11GpuProfiler(const FD3D11GpuProfiler&) = delete;
+	FD3D11GpuProfiler& operator=(const FD3D11GpuProfiler&) = delete;
+
+	void BeginFrame() override;
+	uint32_t BeginRange(const char* name) override;
+	void EndRange(uint32_t range) override;
+	void EndFrame() override;
+
+	uint64_t GetDroppedFrameCount() const;
+
+private:
+	struct FRange
+	{
+		const char* Name = nullptr;
+		ID3D11Query* Begin = nullptr;
+		ID3D11Query* End = nullptr;
+		bool Ended = false;
+	};
+
+	struct FFrame
+	{
+		ID3D11Query* Disjoint = nullptr;
+		ID3D11Query* FrameBegin = nullptr;
+		FRange Ranges[MaxRangesPerFrame];
+		uint32_t RangeCount = 0;
+		uint64_t CpuBeginTicks = 0;
+		bool Pending = false;
+	};
+
+	// Hands the ranges of a finished frame to the profiler.
+	void Resolve(FFrame& frame);
+
+	ID3D11DeviceContext* DeviceContext;
+	FFrame Frames[FrameLatency];
+	uint32_t CurrentFrame;
+	bool Recording;
+	bool Valid;
+	uint64_t DroppedFrames;
+};
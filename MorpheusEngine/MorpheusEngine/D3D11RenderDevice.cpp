@@ -0,0 +1,1330 @@
+#include "DirectXTemplate.h"
+#include "D3D11RenderDevice.h"
+
+namespace
+{
+	D3D11_USAGE ToD3D11Usage(EResourceUsage usage)
+	{
+		switch (usage)
+		{
+			case EResourceUsage::Immutable:
+				return D3D11_USAGE_IMMUTABLE;
+
+			case EResourceUsage::Dynamic:
+				return D3D11_USAGE_DYNAMIC;
+
+			default:
+				return D3D11_USAGE_DEFAULT;
+		}
+	}
+
+	UINT ToD3D11BindFlags(EBufferBinding binding)
+	{
+		switch (binding)
+		{
+			case EBufferBinding::Index:
+				return D3D11_BIND_INDEX_BUFFER;
+
+			case EBufferBinding::Constant:
+				return D3D11_BIND_CONSTANT_BUFFER;
+
+			default:
+				return D3D11_BIND_VERTEX_BUFFER;
+		}
+	}
+
+	DXGI_FORMAT ToDXGIFormat(EVertexFormat format)
+	{
+		switch (format)
+		{
+			case EVertexFormat::Float2:
+				return DXGI_FORMAT_R32G32_FLOAT;
+
+			case EVertexFormat::Float3:
+				return DXGI_FORMAT_R32G32B32_FLOAT;
+
+			case EVertexFormat::Float4:
+				return DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+			case EVertexFormat::Short4Norm:
+				return DXGI_FORMAT_R16G16B16A16_SNORM;
+
+			case EVertexFormat::Short2Norm:
+				return DXGI_FORMAT_R16G16_SNORM;
+
+			case EVertexFormat::UByte4Norm:
+				return DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	DXGI_FORMAT ToDXGIFormat(ETextureFormat format)
+	{
+		switch (format)
+		{
+			case ETextureFormat::RGBA8:
+				return DXGI_FORMAT_R8G8B8A8_UNORM;
+
+			case ETextureFormat::RGBA16Float:
+				return DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+			case ETextureFormat::R32Float:
+				return DXGI_FORMAT_R32_FLOAT;
+
+			case ETextureFormat::D24S8:
+				return DXGI_FORMAT_D24_UNORM_S8_UINT;
+		}
+
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	UINT ToD3D11BindFlags(uint8_t bindings)
+	{
+		UINT bindFlags = 0;
+		bindFlags |= (bindings & TextureBinding_RenderTarget) ? D3D11_BIND_RENDER_TARGET : 0;
+		bindFlags |= (bindings & TextureBinding_DepthStencil) ? D3D11_BIND_DEPTH_STENCIL : 0;
+		bindFlags |= (bindings & TextureBinding_ShaderResource) ? D3D11_BIND_SHADER_RESOURCE : 0;
+
+		return bindFlags;
+	}
+
+	D3D11_FILL_MODE ToD3D11FillMode(EFillMode fillMode)
+	{
+		return fillMode == EFillMode::Wireframe ? D3D11_FILL_WIREFRAME : D3D11_FILL_SOLID;
+	}
+
+	D3D11_CULL_MODE ToD3D11CullMode(ECullMode cullMode)
+	{
+		switch (cullMode)
+		{
+			case ECullMode::None:
+				return D3D11_CULL_NONE;
+
+			case ECullMode::Front:
+				return D3D11_CULL_FRONT;
+
+			default:
+				return D3D11_CULL_BACK;
+		}
+	}
+
+	D3D11_COMPARISON_FUNC ToD3D11ComparisonFunc(EComparisonFunc comparisonFunc)
+	{
+		switch (comparisonFunc)
+		{
+			case EComparisonFunc::Never:
+				return D3D11_COMPARISON_NEVER;
+
+			case EComparisonFunc::Less:
+				return D3D11_COMPARISON_LESS;
+
+			case EComparisonFunc::Equal:
+				return D3D11_COMPARISON_EQUAL;
+
+			case EComparisonFunc::LessEqual:
+				return D3D11_COMPARISON_LESS_EQUAL;
+
+			case EComparisonFunc::Greater:
+				return D3D11_COMPARISON_GREATER;
+
+			case EComparisonFunc::NotEqual:
+				return D3D11_COMPARISON_NOT_EQUAL;
+
+			case EComparisonFunc::GreaterEqual:
+				return D3D11_COMPARISON_GREATER_EQUAL;
+
+			default:
+				return D3D11_COMPARISON_ALWAYS;
+		}
+	}
+
+	D3D11_BLEND ToD3D11Blend(EBlendFactor factor)
+	{
+		switch (factor)
+		{
+			case EBlendFactor::Zero:
+				return D3D11_BLEND_ZERO;
+
+			case EBlendFactor::SourceColour:
+				return D3D11_BLEND_SRC_COLOR;
+
+			case EBlendFactor::InverseSourceColour:
+				return D3D11_BLEND_INV_SRC_COLOR;
+
+			case EBlendFactor::SourceAlpha:
+				return D3D11_BLEND_SRC_ALPHA;
+
+			case EBlendFactor::InverseSourceAlpha:
+				return D3D11_BLEND_INV_SRC_ALPHA;
+
+			case EBlendFactor::DestinationColour:
+				return D3D11_BLEND_DEST_COLOR;
+
+			case EBlendFactor::InverseDestinationColour:
+				return D3D11_BLEND_INV_DEST_COLOR;
+
+			case EBlendFactor::DestinationAlpha:
+				return D3D11_BLEND_DEST_ALPHA;
+
+			case EBlendFactor::InverseDestinationAlpha:
+				return D3D11_BLEND_INV_DEST_ALPHA;
+
+			default:
+				return D3D11_BLEND_ONE;
+		}
+	}
+
+	D3D11_BLEND_OP ToD3D11BlendOperation(EBlendOperation operation)
+	{
+		switch (operation)
+		{
+			case EBlendOperation::Subtract:
+				return D3D11_BLEND_OP_SUBTRACT;
+
+			case EBlendOperation::ReverseSubtract:
+				return D3D11_BLEND_OP_REV_SUBTRACT;
+
+			case EBlendOperation::Min:
+				return D3D11_BLEND_OP_MIN;
+
+			case EBlendOperation::Max:
+				return D3D11_BLEND_OP_MAX;
+
+			default:
+				return D3D11_BLEND_OP_ADD;
+		}
+	}
+}
+
+FD3D11ContextBinder::FD3D11ContextBinder(const FD3D11RenderDevice* renderDevice, ID3D11DeviceContext* context, FRenderDeviceStats* stats)
+	: RenderDevice(renderDevice)
+	, Context(context)
+	, Context1(nullptr)
+	, Stats(stats)
+{
+	assert(Context);
+
+	Context->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&Context1));
+
+	ResetBindings();
+}
+
+FD3D11ContextBinder::~FD3D11ContextBinder()
+{
+	SafeRelease(Context1);
+}
+
+ID3D11DeviceContext* FD3D11ContextBinder::GetContext() const
+{
+	return Context;
+}
+
+void FD3D11ContextBinder::ResetBindings()
+{
+	ZeroMemory(BoundVertexBuffers, sizeof(BoundVertexBuffers));
+	BoundIndexBuffer = 0;
+	BoundInputLayout = 0;
+	BoundVertexShader = 0;
+	BoundPixelShader = 0;
+	ZeroMemory(BoundConstantBuffers, sizeof(BoundConstantBuffers));
+	ZeroMemory(BoundConstantBufferOffsets, sizeof(BoundConstantBufferOffsets));
+	BoundRasterizerState = 0;
+	BoundDepthStencilState = 0;
+	BoundBlendState = 0;
+
+	BindRenderTargets(RenderDevice->BoundRenderTarget, RenderDevice->BoundDepthStencil);
+	BoundRenderTarget = RenderDevice->BoundRenderTarget.Value;
+	BoundDepthStencil = RenderDevice->BoundDepthStencil.Value;
+
+	const FViewport& viewport = RenderDevice->Viewport;
+	if (viewport.Width > 0.0f && viewport.Height > 0.0f)
+	{
+		D3D11_VIEWPORT d3dViewport;
+		d3dViewport.TopLeftX = viewport.TopLeftX;
+		d3dViewport.TopLeftY = viewport.TopLeftY;
+		d3dViewport.Width = viewport.Width;
+		d3dViewport.Height = viewport.Height;
+		d3dViewport.MinDepth = viewport.MinDepth;
+		d3dViewport.MaxDepth = viewport.MaxDepth;
+
+		Context->RSSetViewports(1, &d3dViewport);
+	}
+}
+
+void FD3D11ContextBinder::SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset)
+{
+	assert(slot < MaxVertexBufferSlots);
+
+	ID3D11Buffer* d3dBuffer = FD3D11RenderDevice::GetResource(RenderDevice->Buffers, buffer);
+	Context->IASetVertexBuffers(slot, 1, &d3dBuffer, &stride, &offset);
+
+	RecordStateChange(*Stats, BoundVertexBuffers[slot], buffer.Value);
+}
+
+void FD3D11ContextBinder::SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset)
+{
+	DXGI_FORMAT indexFormat = format == EIndexFormat::UInt32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+	Context->IASetIndexBuffer(FD3D11RenderDevice::GetResource(RenderDevice->Buffers, buffer), indexFormat, offset);
+	Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	RecordStateChange(*Stats, BoundIndexBuffer, buffer.Value);
+}
+
+void FD3D11ContextBinder::SetInputLayout(FInputLayoutHandle inputLayout)
+{
+	Context->IASetInputLayout(FD3D11RenderDevice::GetResource(RenderDevice->InputLayouts, inputLayout));
+
+	RecordStateChange(*Stats, BoundInputLayout, inputLayout.Value);
+}
+
+void FD3D11ContextBinder::SetVertexShader(FVertexShaderHandle shader)
+{
+	Context->VSSetShader(FD3D11RenderDevice::GetResource(RenderDevice->VertexShaders, shader), nullptr, 0);
+
+	RecordStateChange(*Stats, BoundVertexShader, shader.Value);
+}
+
+void FD3D11ContextBinder::SetPixelShader(FPixelShaderHandle shader)
+{
+	Context->PSSetShader(FD3D11RenderDevice::GetResource(RenderDevice->PixelShaders, shader), nullptr, 0);
+
+	RecordStateChange(*Stats, BoundPixelShader, shader.Value);
+}
+
+void FD3D11ContextBinder::SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer)
+{
+	assert(slot < MaxConstantBufferSlots);
+
+	ID3D11Buffer* d3dBuffer = FD3D11RenderDevice::GetResource(RenderDevice->Buffers, buffer);
+
+	if (stage == EShaderStage::Vertex)
+	{
+		Context->VSSetConstantBuffers(slot, 1, &d3dBuffer);
+	}
+	else
+	{
+		Context->PSSetConstantBuffers(slot, 1, &d3dBuffer);
+	}
+
+	uint32_t& boundOffset = BoundConstantBufferOffsets[static_cast<int>(stage)][slot];
+	if (boundOffset != 0)
+	{
+		BoundConstantBuffers[static_cast<int>(stage)][slot] = 0;
+	}
+
+	RecordStateChange(*Stats, BoundConstantBuffers[static_cast<int>(stage)][slot], buffer.Value);
+	boundOffset = 0;
+}
+
+void FD3D11ContextBinder::SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size)
+{
+	assert(slot < MaxConstantBufferSlots);
+	assert(offset % ConstantBufferRangeAlignment == 0 && size % ConstantBufferRangeAlignment == 0);
+	assert(size <= MaxConstantBufferRangeSize);
+
+	if (!RenderDevice->ConstantBufferRangesSupported || !Context1)
+	{
+		// Without 11.1 only whole buffers can be bound, callers fall back to one buffer per range.
+		assert(offset == 0);
+
+		SetConstantBuffer(stage, slot, buffer);
+		return;
+	}
+
+	ID3D11Buffer* d3dBuffer = FD3D11RenderDevice::GetResource(RenderDevice->Buffers, buffer);
+
+	// Offsets and sizes are counted in 16 byte constants.
+	UINT firstConstant = offset / 16;
+	UINT constantCount = size / 16;
+
+	if (stage == EShaderStage::Vertex)
+	{
+		Context1->VSSetConstantBuffers1(slot, 1, &d3dBuffer, &firstConstant, &constantCount);
+	}
+	else
+	{
+		Context1->PSSetConstantBuffers1(slot, 1, &d3dBuffer, &firstConstant, &constantCount);
+	}
+
+	// Another slice of the same buffer is a real change.
+	uint32_t& boundOffset = BoundConstantBufferOffsets[static_cast<int>(stage)][slot];
+	if (boundOffset != offset)
+	{
+		BoundConstantBuffers[static_cast<int>(stage)][slot] = 0;
+	}
+
+	RecordStateChange(*Stats, BoundConstantBuffers[static_cast<int>(stage)][slot], buffer.Value);
+	boundOffset = offset;
+}
+
+void FD3D11ContextBinder::SetRasterizerState(FRasterizerStateHandle state)
+{
+	Context->RSSetState(FD3D11RenderDevice::GetResource(RenderDevice->RasterizerStates, state));
+
+	RecordStateChange(*Stats, BoundRasterizerState, state.Value);
+}
+
+void FD3D11ContextBinder::SetDepthStencilState(FDepthStencilStateHandle state)
+{
+	Context->OMSetDepthStencilState(FD3D11RenderDevice::GetResource(RenderDevice->DepthStencilStates, state), 1);
+
+	RecordStateChange(*Stats, BoundDepthStencilState, state.Value);
+}
+
+void FD3D11ContextBinder::SetBlendState(FBlendStateHandle state)
+{
+	Context->OMSetBlendState(FD3D11RenderDevice::GetResource(RenderDevice->BlendStates, state), nullptr, 0xFFFFFFFF);
+
+	RecordStateChange(*Stats, BoundBlendState, state.Value);
+}
+
+void FD3D11ContextBinder::SetViewport(const FViewport& viewport)
+{
+	D3D11_VIEWPORT d3dViewport;
+	d3dViewport.TopLeftX = viewport.TopLeftX;
+	d3dViewport.TopLeftY = viewport.TopLeftY;
+	d3dViewport.Width = viewport.Width;
+	d3dViewport.Height = viewport.Height;
+	d3dViewport.MinDepth = viewport.MinDepth;
+	d3dViewport.MaxDepth = viewport.MaxDepth;
+
+	Context->RSSetViewports(1, &d3dViewport);
+
+	++Stats->StateChanges;
+}
+
+void FD3D11ContextBinder::SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil)
+{
+	BindRenderTargets(renderTarget, depthStencil);
+
+	// Both targets are bound by one call, so they count as one change.
+	++Stats->StateChanges;
+
+	if (BoundRenderTarget == renderTarget.Value && BoundDepthStencil == depthStencil.Value)
+	{
+		++Stats->RedundantStateChanges;
+	}
+
+	BoundRenderTarget = renderTarget.Value;
+	BoundDepthStencil = depthStencil.Value;
+}
+
+void FD3D11ContextBinder::BindRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil)
+{
+	const FD3D11RenderDevice::FD3D11Texture* colour = RenderDevice->Textures.Get(renderTarget);
+	const FD3D11RenderDevice::FD3D11Texture* depth = RenderDevice->Textures.Get(depthStencil);
+
+	ID3D11RenderTargetView* renderTargetView = colour ? colour->RenderTargetView : nullptr;
+	ID3D11DepthStencilView* depthStencilView = depth ? depth->DepthStencilView : nullptr;
+	Context->OMSetRenderTargets(renderTargetView ? 1 : 0, renderTargetView ? &renderTargetView : nullptr, depthStencilView);
+}
+
+void FD3D11ContextBinder::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	Context->DrawIndexed(indexCount, startIndex, baseVertex);
+
+	++Stats->DrawCalls;
+	Stats->IndicesSubmitted += indexCount;
+	++Stats->InstancesSubmitted;
+}
+
+void FD3D11ContextBinder::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	Context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+
+	++Stats->DrawCalls;
+	Stats->IndicesSubmitted += static_cast<uint64_t>(indexCount) * instanceCount;
+	Stats->InstancesSubmitted += instanceCount;
+}
+
+// Records on a deferred context of its own and counts into its own stats, which the device adds to
+// the frame when it executes the list.
+class FD3D11CommandList : public ICommandList
+{
+public:
+	FD3D11CommandList(const FD3D11RenderDevice* renderDevice, ID3D11DeviceContext* deferredContext)
+		: Binder(renderDevice, deferredContext, &Stats)
+		, CommandList(nullptr)
+		, DrawCount(0)
+	{
+	}
+
+	~FD3D11CommandList() override
+	{
+		SafeRelease(CommandList);
+
+		ID3D11DeviceContext* deferredContext = Binder.GetContext();
+		SafeRelease(deferredContext);
+	}
+
+	void Begin() override
+	{
+		SafeRelease(CommandList);
+		Stats = FRenderDeviceStats();
+		DrawCount = 0;
+
+		Binder.ResetBindings();
+	}
+
+	void End() override
+	{
+		// Not restoring the deferred state afterwards leaves it cleared for the next Begin().
+		HRESULT result = Binder.GetContext()->FinishCommandList(FALSE, &CommandList);
+		if (FAILED(result))
+		{
+			CommandList = nullptr;
+		}
+	}
+
+	uint32_t GetDrawCount() const override
+	{
+		return DrawCount;
+	}
+
+	void SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset) override
+	{
+		Binder.SetVertexBuffer(slot, buffer, stride, offset);
+	}
+
+	void SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset) override
+	{
+		Binder.SetIndexBuffer(buffer, format, offset);
+	}
+
+	void SetInputLayout(FInputLayoutHandle inputLayout) override
+	{
+		Binder.SetInputLayout(inputLayout);
+	}
+
+	void SetVertexShader(FVertexShaderHandle shader) override
+	{
+		Binder.SetVertexShader(shader);
+	}
+
+	void SetPixelShader(FPixelShaderHandle shader) override
+	{
+		Binder.SetPixelShader(shader);
+	}
+
+	void SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer) override
+	{
+		Binder.SetConstantBuffer(stage, slot, buffer);
+	}
+
+	void SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size) override
+	{
+		Binder.SetConstantBufferRange(stage, slot, buffer, offset, size);
+	}
+
+	void SetRasterizerState(FRasterizerStateHandle state) override
+	{
+		Binder.SetRasterizerState(state);
+	}
+
+	void SetDepthStencilState(FDepthStencilStateHandle state) override
+	{
+		Binder.SetDepthStencilState(state);
+	}
+
+	void SetBlendState(FBlendStateHandle state) override
+	{
+		Binder.SetBlendState(state);
+	}
+
+	void SetViewport(const FViewport& viewport) override
+	{
+		Binder.SetViewport(viewport);
+	}
+
+	void SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil) override
+	{
+		Binder.SetRenderTargets(renderTarget, depthStencil);
+	}
+
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override
+	{
+		Binder.DrawIndexed(indexCount, startIndex, baseVertex);
+		++DrawCount;
+	}
+
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override
+	{
+		Binder.DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+		++DrawCount;
+	}
+
+	// Hands the finished list over and forgets it, a list is executed once.
+	ID3D11CommandList* TakeCommandList()
+	{
+		ID3D11CommandList* commandList = CommandList;
+		CommandList = nullptr;
+		return commandList;
+	}
+
+	const FRenderDeviceStats& GetStats() const
+	{
+		return Stats;
+	}
+
+private:
+	// Declared before the binder, which counts into it.
+	FRenderDeviceStats Stats;
+	FD3D11ContextBinder Binder;
+	ID3D11CommandList* CommandList;
+	uint32_t DrawCount;
+};
+
+FD3D11RenderDevice::FD3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* deviceContext, IDXGISwapChain* swapChain)
+	: Device(device)
+	, DeviceContext(deviceContext)
+	, SwapChain(swapChain)
+	, ConstantBufferRangesSupported(false)
+	, LastFence(0)
+	, CompletedFence(0)
+	, Immediate(this, deviceContext, &FrameStats)
+{
+	assert(Device);
+	assert(DeviceContext);
+
+	// Binding by offset needs the 11.1 context, mapping a constant buffer without overwrite needs the
+	// driver to opt in as well.
+	ID3D11DeviceContext1* deviceContext1 = nullptr;
+	if (SUCCEEDED(DeviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&deviceContext1))))
+	{
+		D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+		ZeroMemory(&options, sizeof(D3D11_FEATURE_DATA_D3D11_OPTIONS));
+
+		HRESULT result = Device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(D3D11_FEATURE_DATA_D3D11_OPTIONS));
+		ConstantBufferRangesSupported = SUCCEEDED(result) && options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+	}
+	SafeRelease(deviceContext1);
+
+	// The back buffer keeps its slot, and its handle, across resizes.
+	BackBuffer = Textures.Add(FD3D11Texture());
+
+	if (CreateBackBufferView())
+	{
+		BoundRenderTarget = BackBuffer;
+		Immediate.ResetBindings();
+	}
+	else
+	{
+		Textures.Remove(BackBuffer);
+		BackBuffer = FTextureHandle();
+	}
+}
+
+FD3D11RenderDevice::~FD3D11RenderDevice()
+{
+	// The device is going away with the GPU done, so nothing needs to wait for a fence.
+	Buffers.ForEach([](FBufferHandle, ID3D11Buffer*& buffer) { SafeRelease(buffer); });
+	VertexShaders.ForEach([](FVertexShaderHandle, ID3D11VertexShader*& shader) { SafeRelease(shader); });
+	PixelShaders.ForEach([](FPixelShaderHandle, ID3D11PixelShader*& shader) { SafeRelease(shader); });
+	InputLayouts.ForEach([](FInputLayoutHandle, ID3D11InputLayout*& inputLayout) { SafeRelease(inputLayout); });
+	RasterizerStates.ForEach([](FRasterizerStateHandle, ID3D11RasterizerState*& state) { SafeRelease(state); });
+	DepthStencilStates.ForEach([](FDepthStencilStateHandle, ID3D11DepthStencilState*& state) { SafeRelease(state); });
+	BlendStates.ForEach([](FBlendStateHandle, ID3D11BlendState*& state) { SafeRelease(state); });
+	Textures.ForEach([](FTextureHandle, FD3D11Texture& texture) { ReleaseTexture(texture); });
+
+	PendingReleases.ReleaseAll([](IUnknown* object) { object->Release(); });
+
+	for (FPendingFence& fence : PendingFences)
+	{
+		SafeRelease(fence.Query);
+	}
+
+	for (ID3D11Query*& query : FreeFenceQueries)
+	{
+		SafeRelease(query);
+	}
+
+}
+
+template<typename HandleType, typename ResourceType>
+ResourceType* FD3D11RenderDevice::GetResource(const TResourcePool<HandleType, ResourceType*>& resources, HandleType handle)
+{
+	ResourceType* const* resource = resources.Get(handle);
+	assert(!handle.IsValid() || resource);
+
+	return resource ? *resource : nullptr;
+}
+
+FBufferHandle FD3D11RenderDevice::CreateBuffer(const FBufferDesc& description, const void* initialData)
+{
+	if (!Buffers.CanAdd())
+	{
+		return FBufferHandle();
+	}
+
+	D3D11_BUFFER_DESC bufferDescription;
+	ZeroMemory(&bufferDescription, sizeof(D3D11_BUFFER_DESC));
+
+	bufferDescription.BindFlags = ToD3D11BindFlags(description.Binding);
+	bufferDescription.ByteWidth = description.ByteWidth;
+	bufferDescription.CPUAccessFlags = description.Usage == EResourceUsage::Dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	bufferDescription.Usage = ToD3D11Usage(description.Usage);
+
+	D3D11_SUBRESOURCE_DATA resourceData;
+	ZeroMemory(&resourceData, sizeof(D3D11_SUBRESOURCE_DATA));
+
+	resourceData.pSysMem = initialData;
+
+	ID3D11Buffer* buffer = nullptr;
+	HRESULT result = Device->CreateBuffer(&bufferDescription, initialData ? &resourceData : nullptr, &buffer);
+	if (FAILED(result))
+	{
+		return FBufferHandle();
+	}
+
+	++FrameStats.ResourcesCreated;
+	if (initialData)
+	{
+		FrameStats.BytesUploaded += description.ByteWidth;
+	}
+
+	return Buffers.Add(buffer);
+}
+
+FVertexShaderHandle FD3D11RenderDevice::CreateVertexShader(const FShaderBytecode& bytecode)
+{
+	if (!VertexShaders.CanAdd())
+	{
+		return FVertexShaderHandle();
+	}
+
+	assert(bytecode.Data);
+
+	ID3D11VertexShader* vertexShader = nullptr;
+	HRESULT result = Device->CreateVertexShader(bytecode.Data, bytecode.Size, nullptr, &vertexShader);
+	if (FAILED(result))
+	{
+		return FVertexShaderHandle();
+	}
+
+	++FrameStats.ResourcesCreated;
+
+	return VertexShaders.Add(vertexShader);
+}
+
+FPixelShaderHandle FD3D11RenderDevice::CreatePixelShader(const FShaderBytecode& bytecode)
+{
+	if (!PixelShaders.CanAdd())
+	{
+		return FPixelShaderHandle();
+	}
+
+	assert(bytecode.Data);
+
+	ID3D11PixelShader* pixelShader = nullptr;
+	HRESULT result = Device->CreatePixelShader(bytecode.Data, bytecode.Size, nullptr, &pixelShader);
+	if (FAILED(result))
+	{
+		return FPixelShaderHandle();
+	}
+
+	++FrameStats.ResourcesCreated;
+
+	return PixelShaders.Add(pixelShader);
+}
+
+FInputLayoutHandle FD3D11RenderDevice::CreateInputLayout(const FInputElementDesc* elements, uint32_t elementCount, const FShaderBytecode& vertexShaderBytecode)
+{
+	if (!InputLayouts.CanAdd())
+	{
+		return FInputLayoutHandle();
+	}
+
+	assert(vertexShaderBytecode.Data);
+
+	std::vector<D3D11_INPUT_ELEMENT_DESC> inputElements(elementCount);
+
+	for (uint32_t i = 0; i < elementCount; ++i)
+	{
+		const FInputElementDesc& element = elements[i];
+		bool perInstance = element.Classification == EInputClassification::PerInstance;
+
+		inputElements[i].SemanticName = element.SemanticName;
+		inputElements[i].SemanticIndex = element.SemanticIndex;
+		inputElements[i].Format = ToDXGIFormat(element.Format);
+		inputElements[i].InputSlot = element.InputSlot;
+		inputElements[i].AlignedByteOffset = element.AlignedByteOffset;
+		inputElements[i].InputSlotClass = perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		inputElements[i].InstanceDataStepRate = perInstance ? element.InstanceDataStepRate : 0;
+	}
+
+	ID3D11InputLayout* inputLayout = nullptr;
+	HRESULT result = Device->CreateInputLayout(inputElements.data(), elementCount, vertexShaderBytecode.Data, vertexShaderBytecode.Size, &inputLayout);
+	if (FAILED(result))
+	{
+		return FInputLayoutHandle();
+	}
+
+	++FrameStats.ResourcesCreated;
+
+	return InputLayouts.Add(inputLayout);
+}
+
+FRasterizerStateHandle FD3D11RenderDevice::CreateRasterizerState(const FRasterizerDesc& description)
+{
+	if (!RasterizerStates.CanAdd())
+	{
+		return FRasterizerStateHandle();
+	}
+
+	D3D11_RASTERIZER_DESC rasterizerDescription;
+	ZeroMemory(&rasterizerDescription, sizeof(D3D11_RASTERIZER_DESC));
+
+	rasterizerDescription.AntialiasedLineEnable = description.AntialiasedLineEnable;
+	rasterizerDescription.CullMode = ToD3D11CullMode(description.CullMode);
+	rasterizerDescription.DepthBias = description.DepthBias;
+	rasterizerDescription.DepthBiasClamp = description.DepthBiasClamp;
+	rasterizerDescription.DepthClipEnable = description.DepthClipEnable;
+	rasterizerDescription.FillMode = ToD3D11FillMode(description.FillMode);
+	rasterizerDescription.FrontCounterClockwise = description.FrontCounterClockwise;
+	rasterizerDescription.MultisampleEnable = description.MultisampleEnable;
+	rasterizerDescription.ScissorEnable = description.ScissorEnable;
+	rasterizerDescription.SlopeScaledDepthBias = description.SlopeScaledDepthBias;
+
+	ID3D11RasterizerState* rasterizerState = nullptr;
+	HRESULT result = Device->CreateRasterizerState(&rasterizerDescription, &rasterizerState);
+	if (FAILED(result))
+	{
+		return FRasterizerStateHandle();
+	}
+
+	++FrameStats.ResourcesCreated;
+
+	return RasterizerStates.Add(rasterizerState);
+}
+
+FDepthStencilStateHandle FD3D11RenderDevice::CreateDepthStencilState(const FDepthStencilDesc& description)
+{
+	if (!DepthStencilStates.CanAdd())
+	{
+		return FDepthStencilStateHandle();
+	}
+
+	D3D11_DEPTH_STENCIL_DESC depthStencilStateDescription;
+	ZeroMemory(&depthStencilStateDescription, sizeof(D3D11_DEPTH_STENCIL_DESC));
+
+	depthStencilStateDescription.DepthEnable = description.DepthEnable;
+	depthStencilStateDescription.DepthWriteMask = description.DepthWriteEnable ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthStencilStateDescription.DepthFunc = ToD3D11ComparisonFunc(description.DepthFunc);
+	depthStencilStateDescription.StencilEnable = description.StencilEnable;
+
+	ID3D11DepthStencilState* depthStencilState = nullptr;
+	HRESULT result = Device->CreateDepthStencilState(&depthStencilStateDescription, &depthStencilState);
+	if (FAILED(result))
+	{
+		return FDepthStencilStateHandle();
+	}
+
+	++FrameStats.ResourcesCreated;
+
+	return DepthStencilStates.Add(depthStencilState);
+}
+
+FBlendStateHandle FD3D11RenderDevice::CreateBlendState(const FBlendDesc& description)
+{
+	if (!BlendStates.CanAdd())
+	{
+		return FBlendStateHandle();
+	}
+
+	D3D11_BLEND_DESC blendStateDescription;
+	ZeroMemory(&blendStateDescription, sizeof(D3D11_BLEND_DESC));
+
+	blendStateDescription.AlphaToCoverageEnable = description.AlphaToCoverageEnable;
+	blendStateDescription.IndependentBlendEnable = FALSE;
+
+	D3D11_RENDER_TARGET_BLEND_DESC& renderTarget = blendStateDescription.RenderTarget[0];
+	renderTarget.BlendEnable = description.BlendEnable;
+	renderTarget.SrcBlend = ToD3D11Blend(description.SourceBlend);
+	renderTarget.DestBlend = ToD3D11Blend(description.DestinationBlend);
+	renderTarget.BlendOp = ToD3D11BlendOperation(description.BlendOperation);
+	renderTarget.SrcBlendAlpha = ToD3D11Blend(description.SourceBlendAlpha);
+	renderTarget.DestBlendAlpha = ToD3D11Blend(description.DestinationBlendAlpha);
+	renderTarget.BlendOpAlpha = ToD3D11BlendOperation(description.BlendOperationAlpha);
+	renderTarget.RenderTargetWriteMask = description.WriteMask & ColourWrite_All;
+
+	ID3D11BlendState* blendState = nullptr;
+	HRESULT result = Device->CreateBlendState(&blendStateDescription, &blendState);
+	if (FAILED(result))
+	{
+		return FBlendStateHandle();
+	}
+
+	++FrameStats.ResourcesCreated;
+
+	return BlendStates.Add(blendState);
+}
+
+FTextureHandle FD3D11RenderDevice::CreateTexture(const FTextureDesc& description)
+{
+	if (!Textures.CanAdd())
+	{
+		return FTextureHandle();
+	}
+
+	// A depth buffer read by shaders needs a format both views can be made of.
+	bool readDepth = description.Format == ETextureFormat::D24S8 && (description.Bindings & TextureBinding_ShaderResource);
+
+	D3D11_TEXTURE2D_DESC textureDescription;
+	ZeroMemory(&textureDescription, sizeof(D3D11_TEXTURE2D_DESC));
+
+	textureDescription.Width = description.Width;
+	textureDescription.Height = description.Height;
+	textureDescription.MipLevels = 1;
+	textureDescription.ArraySize = 1;
+	textureDescription.Format = readDepth ? DXGI_FORMAT_R24G8_TYPELESS : ToDXGIFormat(description.Format);
+	textureDescription.SampleDesc.Count = 1;
+	textureDescription.SampleDesc.Quality = 0;
+	textureDescription.Usage = D3D11_USAGE_DEFAULT;
+	textureDescription.BindFlags = ToD3D11BindFlags(description.Bindings);
+
+	FD3D11Texture texture;
+	texture.Description = description;
+
+	HRESULT result = Device->CreateTexture2D(&textureDescription, nullptr, &texture.Texture);
+
+	if (SUCCEEDED(result) && (description.Bindings & TextureBinding_RenderTarget))
+	{
+		result = Device->CreateRenderTargetView(texture.Texture, nullptr, &texture.RenderTargetView);
+	}
+
+	if (SUCCEEDED(result) && (description.Bindings & TextureBinding_DepthStencil))
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC viewDescription;
+		ZeroMemory(&viewDescription, sizeof(D3D11_DEPTH_STENCIL_VIEW_DESC));
+		viewDescription.Format = ToDXGIFormat(description.Format);
+		viewDescription.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+
+		result = Device->CreateDepthStencilView(texture.Texture, &viewDescription, &texture.DepthStencilView);
+	}
+
+	if (SUCCEEDED(result) && (description.Bindings & TextureBinding_ShaderResource))
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDescription;
+		ZeroMemory(&viewDescription, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+		viewDescription.Format = readDepth ? DXGI_FORMAT_R24_UNORM_X8_TYPELESS : ToDXGIFormat(description.Format);
+		viewDescription.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		viewDescription.Texture2D.MipLevels = 1;
+
+		result = Device->CreateShaderResourceView(texture.Texture, &viewDescription, &texture.ShaderResourceView);
+	}
+
+	if (FAILED(result))
+	{
+		ReleaseTexture(texture);
+		return FTextureHandle();
+	}
+
+	++FrameStats.ResourcesCreated;
+
+	return Textures.Add(texture);
+}
+
+void FD3D11RenderDevice::DestroyBuffer(FBufferHandle buffer)
+{
+	ReleaseDeferred(Buffers.Remove(buffer));
+	++FrameStats.ResourcesDestroyed;
+}
+
+void FD3D11RenderDevice::DestroyVertexShader(FVertexShaderHandle shader)
+{
+	ReleaseDeferred(VertexShaders.Remove(shader));
+	++FrameStats.ResourcesDestroyed;
+}
+
+void FD3D11RenderDevice::DestroyPixelShader(FPixelShaderHandle shader)
+{
+	ReleaseDeferred(PixelShaders.Remove(shader));
+	++FrameStats.ResourcesDestroyed;
+}
+
+void FD3D11RenderDevice::DestroyInputLayout(FInputLayoutHandle inputLayout)
+{
+	ReleaseDeferred(InputLayouts.Remove(inputLayout));
+	++FrameStats.ResourcesDestroyed;
+}
+
+void FD3D11RenderDevice::DestroyRasterizerState(FRasterizerStateHandle state)
+{
+	ReleaseDeferred(RasterizerStates.Remove(state));
+	++FrameStats.ResourcesDestroyed;
+}
+
+void FD3D11RenderDevice::DestroyDepthStencilState(FDepthStencilStateHandle state)
+{
+	ReleaseDeferred(DepthStencilStates.Remove(state));
+	++FrameStats.ResourcesDestroyed;
+}
+
+void FD3D11RenderDevice::DestroyBlendState(FBlendStateHandle state)
+{
+	ReleaseDeferred(BlendStates.Remove(state));
+	++FrameStats.ResourcesDestroyed;
+}
+
+void FD3D11RenderDevice::DestroyTexture(FTextureHandle texture)
+{
+	assert(texture != BackBuffer);
+	assert(texture != BoundRenderTarget && texture != BoundDepthStencil);
+
+	FD3D11Texture d3dTexture = Textures.Remove(texture);
+	ReleaseDeferred(d3dTexture.ShaderResourceView);
+	ReleaseDeferred(d3dTexture.DepthStencilView);
+	ReleaseDeferred(d3dTexture.RenderTargetView);
+	ReleaseDeferred(d3dTexture.Texture);
+	++FrameStats.ResourcesDestroyed;
+}
+
+void FD3D11RenderDevice::ReleaseDeferred(IUnknown* object)
+{
+	// Anything issued so far may use the object, and the next fence covers all of it.
+	if (object)
+	{
+		PendingReleases.Enqueue(object, LastFence + 1);
+	}
+}
+
+uint32_t FD3D11RenderDevice::ReportLiveResources(std::string& report) const
+{
+	uint32_t count = 0;
+	count += AppendLiveResources(report, "Buffer", Buffers);
+	count += AppendLiveResources(report, "VertexShader", VertexShaders);
+	count += AppendLiveResources(report, "PixelShader", PixelShaders);
+	count += AppendLiveResources(report, "InputLayout", InputLayouts);
+	count += AppendLiveResources(report, "RasterizerState", RasterizerStates);
+	count += AppendLiveResources(report, "DepthStencilState", DepthStencilStates);
+	count += AppendLiveResources(report, "BlendState", BlendStates);
+	count += AppendLiveResources(report, "Texture", Textures, BackBuffer);
+
+	return count;
+}
+
+FTextureHandle FD3D11RenderDevice::GetBackBuffer() const
+{
+	return BackBuffer;
+}
+
+const FTextureDesc& FD3D11RenderDevice::GetTextureDesc(FTextureHandle texture) const
+{
+	const FD3D11Texture* d3dTexture = Textures.Get(texture);
+	assert(d3dTexture);
+
+	return d3dTexture->Description;
+}
+
+bool FD3D11RenderDevice::ResizeBackBuffer(uint32_t width, uint32_t height)
+{
+	FD3D11Texture* backBuffer = Textures.Get(BackBuffer);
+	if (!backBuffer)
+	{
+		return false;
+	}
+
+	// The swap chain cannot resize while anything still references its buffer.
+	DeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+	BoundRenderTarget = FTextureHandle();
+	BoundDepthStencil = FTextureHandle();
+	Immediate.ResetBindings();
+
+	ReleaseTexture(*backBuffer);
+
+	HRESULT result = SwapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	return CreateBackBufferView();
+}
+
+void FD3D11RenderDevice::ReleaseTexture(FD3D11Texture& texture)
+{
+	SafeRelease(texture.ShaderResourceView);
+	SafeRelease(texture.DepthStencilView);
+	SafeRelease(texture.RenderTargetView);
+	SafeRelease(texture.Texture);
+}
+
+bool FD3D11RenderDevice::CreateBackBufferView()
+{
+	FD3D11Texture& backBuffer = *Textures.Get(BackBuffer);
+
+	HRESULT result = SwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&backBuffer.Texture));
+	if (SUCCEEDED(result))
+	{
+		result = Device->CreateRenderTargetView(backBuffer.Texture, nullptr, &backBuffer.RenderTargetView);
+	}
+
+	if (FAILED(result))
+	{
+		ReleaseTexture(backBuffer);
+		return false;
+	}
+
+	D3D11_TEXTURE2D_DESC textureDescription;
+	backBuffer.Texture->GetDesc(&textureDescription);
+
+	backBuffer.Description.Width = textureDescription.Width;
+	backBuffer.Description.Height = textureDescription.Height;
+	backBuffer.Description.Format = ETextureFormat::RGBA8;
+	backBuffer.Description.Bindings = TextureBinding_RenderTarget;
+
+	return true;
+}
+
+void FD3D11RenderDevice::UpdateBuffer(FBufferHandle buffer, const void* data, uint32_t size)
+{
+	ID3D11Buffer* d3dBuffer = GetResource(Buffers, buffer);
+	assert(d3dBuffer);
+
+	DeviceContext->UpdateSubresource(d3dBuffer, 0, nullptr, data, 0, 0);
+
+	++FrameStats.BufferUpdates;
+	FrameStats.BytesUploaded += size;
+}
+
+void* FD3D11RenderDevice::MapBuffer(FBufferHandle buffer, EMapMode mode)
+{
+	ID3D11Buffer* d3dBuffer = GetResource(Buffers, buffer);
+	assert(d3dBuffer);
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	D3D11_MAP mapType = mode == EMapMode::WriteNoOverwrite ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD;
+
+	HRESULT result = DeviceContext->Map(d3dBuffer, 0, mapType, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		return nullptr;
+	}
+
+	++FrameStats.BufferMaps;
+
+	return mappedResource.pData;
+}
+
+void FD3D11RenderDevice::UnmapBuffer(FBufferHandle buffer)
+{
+	ID3D11Buffer* d3dBuffer = GetResource(Buffers, buffer);
+	assert(d3dBuffer);
+
+	DeviceContext->Unmap(d3dBuffer, 0);
+}
+
+void FD3D11RenderDevice::SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset)
+{
+	Immediate.SetVertexBuffer(slot, buffer, stride, offset);
+}
+
+void FD3D11RenderDevice::SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset)
+{
+	Immediate.SetIndexBuffer(buffer, format, offset);
+}
+
+void FD3D11RenderDevice::SetInputLayout(FInputLayoutHandle inputLayout)
+{
+	Immediate.SetInputLayout(inputLayout);
+}
+
+void FD3D11RenderDevice::SetVertexShader(FVertexShaderHandle shader)
+{
+	Immediate.SetVertexShader(shader);
+}
+
+void FD3D11RenderDevice::SetPixelShader(FPixelShaderHandle shader)
+{
+	Immediate.SetPixelShader(shader);
+}
+
+void FD3D11RenderDevice::SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer)
+{
+	Immediate.SetConstantBuffer(stage, slot, buffer);
+}
+
+void FD3D11RenderDevice::SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size)
+{
+	Immediate.SetConstantBufferRange(stage, slot, buffer, offset, size);
+}
+
+void FD3D11RenderDevice::SetRasterizerState(FRasterizerStateHandle state)
+{
+	Immediate.SetRasterizerState(state);
+}
+
+void FD3D11RenderDevice::SetDepthStencilState(FDepthStencilStateHandle state)
+{
+	Immediate.SetDepthStencilState(state);
+}
+
+void FD3D11RenderDevice::SetBlendState(FBlendStateHandle state)
+{
+	Immediate.SetBlendState(state);
+}
+
+void FD3D11RenderDevice::SetViewport(const FViewport& viewport)
+{
+	Immediate.SetViewport(viewport);
+	Viewport = viewport;
+}
+
+void FD3D11RenderDevice::SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil)
+{
+	Immediate.SetRenderTargets(renderTarget, depthStencil);
+	BoundRenderTarget = renderTarget;
+	BoundDepthStencil = depthStencil;
+}
+
+uint64_t FD3D11RenderDevice::InsertFence()
+{
+	ID3D11Query* query = nullptr;
+	if (!FreeFenceQueries.empty())
+	{
+		query = FreeFenceQueries.back();
+		FreeFenceQueries.pop_back();
+	}
+	else
+	{
+		D3D11_QUERY_DESC queryDescription;
+		queryDescription.Query = D3D11_QUERY_EVENT;
+		queryDescription.MiscFlags = 0;
+
+		Device->CreateQuery(&queryDescription, &query);
+	}
+
+	++LastFence;
+
+	// Without a query the fence cannot be polled. Fences complete in order, so it stays pending until
+	// a later fence with a query completes, which is late but never early.
+	if (query)
+	{
+		DeviceContext->End(query);
+
+		FPendingFence fence = { LastFence, query };
+		PendingFences.push_back(fence);
+	}
+
+	return LastFence;
+}
+
+bool FD3D11RenderDevice::IsFenceComplete(uint64_t fence)
+{
+	while (!PendingFences.empty())
+	{
+		FPendingFence& pending = PendingFences.front();
+
+		BOOL done = FALSE;
+		HRESULT result = DeviceContext->GetData(pending.Query, &done, sizeof(done), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		if (result != S_OK || !done)
+		{
+			break;
+		}
+
+		CompletedFence = pending.Value;
+		FreeFenceQueries.push_back(pending.Query);
+		PendingFences.pop_front();
+	}
+
+	return fence <= CompletedFence;
+}
+
+bool FD3D11RenderDevice::SupportsConstantBufferRanges() const
+{
+	return ConstantBufferRangesSupported;
+}
+
+std::unique_ptr<ICommandList> FD3D11RenderDevice::CreateCommandList()
+{
+	ID3D11DeviceContext* deferredContext = nullptr;
+	HRESULT result = Device->CreateDeferredContext(0, &deferredContext);
+	if (FAILED(result))
+	{
+		return nullptr;
+	}
+
+	return std::unique_ptr<ICommandList>(new FD3D11CommandList(this, deferredContext));
+}
+
+void FD3D11RenderDevice::ExecuteCommandList(ICommandList* commandList)
+{
+	// Only lists this device created come back here.
+	FD3D11CommandList* d3dCommandList = static_cast<FD3D11CommandList*>(commandList);
+
+	ID3D11CommandList* recorded = d3dCommandList->TakeCommandList();
+	if (!recorded)
+	{
+		return;
+	}
+
+	DeviceContext->ExecuteCommandList(recorded, FALSE);
+	SafeRelease(recorded);
+
+	const FRenderDeviceStats& stats = d3dCommandList->GetStats();
+	FrameStats.DrawCalls += stats.DrawCalls;
+	FrameStats.IndicesSubmitted += stats.IndicesSubmitted;
+	FrameStats.InstancesSubmitted += stats.InstancesSubmitted;
+	FrameStats.StateChanges += stats.StateChanges;
+	FrameStats.RedundantStateChanges += stats.RedundantStateChanges;
+
+	// Executing without restoring clears the immediate context.
+	Immediate.ResetBindings();
+}
+
+void FD3D11RenderDevice::Clear(const float clearColour[4], float clearDepth, uint8_t clearStencil)
+{
+	FD3D11Texture* renderTarget = Textures.Get(BoundRenderTarget);
+	if (renderTarget && renderTarget->RenderTargetView)
+	{
+		DeviceContext->ClearRenderTargetView(renderTarget->RenderTargetView, clearColour);
+	}
+
+	FD3D11Texture* depthStencil = Textures.Get(BoundDepthStencil);
+	if (depthStencil && depthStencil->DepthStencilView)
+	{
+		DeviceContext->ClearDepthStencilView(depthStencil->DepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, clearDepth, clearStencil);
+	}
+}
+
+void FD3D11RenderDevice::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	Immediate.DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void FD3D11RenderDevice::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	Immediate.DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void FD3D11RenderDevice::Present(bool vSync)
+{
+	SwapChain->Present(vSync ? 1 : 0, 0);
+
+	// Releases behind a fence that got no query wait for a later fence, so one is inserted while no
+	// query is left to complete.
+	if (PendingReleases.GetLastFence() > LastFence || (PendingReleases.GetLastFence() > CompletedFence && PendingFences.empty()))
+	{
+		InsertFence();
+	}
+
+	if (!PendingReleases.IsEmpty())
+	{
+		IsFenceComplete(PendingReleases.GetLastFence());
+		PendingReleases.Release(CompletedFence, [](IUnknown* object) { object->Release(); });
+	}
+
+	LastFrameStats = FrameStats;
+	FrameStats = FRenderDeviceStats();
+}
+
+const FRenderDeviceStats& FD3D11RenderDevice::GetFrameStats() const
+{
+	return FrameStats;
+}
+
+const FRenderDeviceStats& FD3D11RenderDevice::GetLastFrameStats() const
+{
+	return LastFrameStats;
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "DirectXTemplate.h"
+#include "RenderDevice.h"
+#include "ResourcePool.h"
+
+#include <deque>
+#include <vector>
+
+class FD3D11RenderDevice;
+
+// Issues binds and draws on one Direct3D context and counts them. The device has one for the
+// immediate context and every command list one for its deferred context.
+class FD3D11ContextBinder
+{
+public:
+	static const uint32_t MaxVertexBufferSlots = 4;
+	static const uint32_t MaxConstantBufferSlots = 8;
+
+	FD3D11ContextBinder(const FD3D11RenderDevice* renderDevice, ID3D11DeviceContext* context, FRenderDeviceStats* stats);
+	~FD3D11ContextBinder();
+
+	FD3D11ContextBinder(const FD3D11ContextBinder&) = delete;
+	FD3D11ContextBinder& operator=(const FD3D11ContextBinder&) = delete;
+
+	ID3D11DeviceContext* GetContext() const;
+
+	// Binds the render targets and viewport last set on the device, and forgets every other binding.
+	void ResetBindings();
+
+	void SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset);
+	void SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset);
+	void SetInputLayout(FInputLayoutHandle inputLayout);
+	void SetVertexShader(FVertexShaderHandle shader);
+	void SetPixelShader(FPixelShaderHandle shader);
+	void SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer);
+	void SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size);
+	void SetRasterizerState(FRasterizerStateHandle state);
+	void SetDepthStencilState(FDepthStencilStateHandle state);
+	void SetBlendState(FBlendStateHandle state);
+	void SetViewport(const FViewport& viewport);
+	void SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil);
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+
+private:
+	void BindRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil);
+
+	const FD3D11RenderDevice* RenderDevice;
+	ID3D11DeviceContext* Context;
+	// Null on runtimes older than Direct3D 11.1.
+	ID3D11DeviceContext1* Context1;
+	FRenderDeviceStats* Stats;
+
+	// Handle values of the currently bound objects, only used for the counters.
+	uint32_t BoundVertexBuffers[MaxVertexBufferSlots];
+	uint32_t BoundIndexBuffer;
+	uint32_t BoundInputLayout;
+	uint32_t BoundVertexShader;
+	uint32_t BoundPixelShader;
+	uint32_t BoundConstantBuffers[static_cast<int>(EShaderStage::NumberOfStages)][MaxConstantBufferSlots];
+	uint32_t BoundConstantBufferOffsets[static_cast<int>(EShaderStage::NumberOfStages)][MaxConstantBufferSlots];
+	uint32_t BoundRasterizerState;
+	uint32_t BoundDepthStencilState;
+	uint32_t BoundBlendState;
+	uint32_t BoundRenderTarget;
+	uint32_t BoundDepthStencil;
+};
+
+// Render device that forwards to Direct3D 11. The device, context and swap chain are created by
+// InitialiseDirectX() and borrowed here; the back buffer view and resources created through the
+// interface are owned. Resources live in pools that hold the interface pointers by value, so binding
+// a handle never touches a reference count. Destroyed objects are released once the frame fence after
+// their last use has completed.
+// Constant buffer ranges use the Direct3D 11.1 context when the runtime and driver offer it.
+class FD3D11RenderDevice : public IRenderDevice
+{
+public:
+	FD3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* deviceContext, IDXGISwapChain* swapChain);
+	~FD3D11RenderDevice() override;
+
+	FBufferHandle CreateBuffer(const FBufferDesc& description, const void* initialData) override;
+	FVertexShaderHandle CreateVertexShader(const FShaderBytecode& bytecode) override;
+	FPixelShaderHandle CreatePixelShader(const FShaderBytecode& bytecode) override;
+	FInputLayoutHandle CreateInputLayout(const FInputElementDesc* elements, uint32_t elementCount, const FShaderBytecode& vertexShaderBytecode) override;
+	FRasterizerStateHandle CreateRasterizerState(const FRasterizerDesc& description) override;
+	FDepthStencilStateHandle CreateDepthStencilState(const FDepthStencilDesc& description) override;
+	FBlendStateHandle CreateBlendState(const FBlendDesc& description) override;
+	// Depth textures that are also read by shaders are created typeless, with a depth view and a
+	// shader resource view of their own formats.
+	FTextureHandle CreateTexture(const FTextureDesc& description) override;
+
+	void DestroyBuffer(FBufferHandle buffer) override;
+	void DestroyVertexShader(FVertexShaderHandle shader) override;
+	void DestroyPixelShader(FPixelShaderHandle shader) override;
+	void DestroyInputLayout(FInputLayoutHandle inputLayout) override;
+	void DestroyRasterizerState(FRasterizerStateHandle state) override;
+	void DestroyDepthStencilState(FDepthStencilStateHandle state) override;
+	void DestroyBlendState(FBlendStateHandle state) override;
+	void DestroyTexture(FTextureHandle texture) override;
+
+	uint32_t ReportLiveResources(std::string& report) const override;
+
+	// Invalid when the view of the swap chain buffer could not be created.
+	FTextureHandle GetBackBuffer() const override;
+	const FTextureDesc& GetTextureDesc(FTextureHandle texture) const override;
+	bool ResizeBackBuffer(uint32_t width, uint32_t height) override;
+
+	void UpdateBuffer(FBufferHandle buffer, const void* data, uint32_t size) override;
+	void* MapBuffer(FBufferHandle buffer, EMapMode mode) override;
+	void UnmapBuffer(FBufferHandle buffer) override;
+
+	void SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset) override;
+	void SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset) override;
+	void SetInputLayout(FInputLayoutHandle inputLayout) override;
+	void SetVertexShader(FVertexShaderHandle shader) override;
+	void SetPixelShader(FPixelShaderHandle shader) override;
+	void SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer) override;
+	void SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size) override;
+	void SetRasterizerState(FRasterizerStateHandle state) override;
+	void SetDepthStencilState(FDepthStencilStateHandle state) override;
+	void SetBlendState(FBlendStateHandle state) override;
+	void SetViewport(const FViewport& viewport) override;
+	void SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil) override;
+
+	// Fences are event queries, polled without flushing.
+	// A fence whose query could not be created completes with the next fence that has one.
+	uint64_t InsertFence() override;
+	bool IsFenceComplete(uint64_t fence) override;
+
+	bool SupportsConstantBufferRanges() const override;
+
+	// Deferred contexts, replayed on the immediate context without restoring its state. Null when the
+	// deferred context cannot be created.
+	std::unique_ptr<ICommandList> CreateCommandList() override;
+	void ExecuteCommandList(ICommandList* commandList) override;
+
+	void Clear(const float clearColour[4], float clearDepth, uint8_t clearStencil) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+	// Inserts a fence when objects destroyed this frame wait for one, and releases the objects whose
+	// fence has completed.
+	void Present(bool vSync) override;
+
+	const FRenderDeviceStats& GetFrameStats() const override;
+	const FRenderDeviceStats& GetLastFrameStats() const override;
+
+private:
+	friend class FD3D11ContextBinder;
+
+	// Null for invalid handles. A stale handle is a use after destroy, which asserts.
+	template<typename HandleType, typename ResourceType>
+	static ResourceType* GetResource(const TResourcePool<HandleType, ResourceType*>& resources, HandleType handle);
+
+	struct FD3D11Texture
+	{
+		ID3D11Texture2D* Texture = nullptr;
+		ID3D11RenderTargetView* RenderTargetView = nullptr;
+		ID3D11DepthStencilView* DepthStencilView = nullptr;
+		ID3D11ShaderResourceView* ShaderResourceView = nullptr;
+		FTextureDesc Description;
+	};
+
+	static void ReleaseTexture(FD3D11Texture& texture);
+	// Releases the object once the GPU has finished everything issued so far.
+	void ReleaseDeferred(IUnknown* object);
+	// Creates the view of the first swap chain buffer in the back buffer slot.
+	bool CreateBackBufferView();
+
+	struct FPendingFence
+	{
+		uint64_t Value;
+		ID3D11Query* Query;
+	};
+
+	ID3D11Device* Device;
+	ID3D11DeviceContext* DeviceContext;
+	IDXGISwapChain* SwapChain;
+	bool ConstantBufferRangesSupported;
+	// Given to command lists as they begin.
+	FViewport Viewport;
+	FTextureHandle BoundRenderTarget;
+	FTextureHandle BoundDepthStencil;
+
+	TResourcePool<FBufferHandle, ID3D11Buffer*> Buffers;
+	TResourcePool<FVertexShaderHandle, ID3D11VertexShader*> VertexShaders;
+	TResourcePool<FPixelShaderHandle, ID3D11PixelShader*> PixelShaders;
+	TResourcePool<FInputLayoutHandle, ID3D11InputLayout*> InputLayouts;
+	TResourcePool<FRasterizerStateHandle, ID3D11RasterizerState*> RasterizerStates;
+	TResourcePool<FDepthStencilStateHandle, ID3D11DepthStencilState*> DepthStencilStates;
+	TResourcePool<FBlendStateHandle, ID3D11BlendState*> BlendStates;
+	TResourcePool<FTextureHandle, FD3D11Texture> Textures;
+	FTextureHandle BackBuffer;
+
+	// Destroyed objects and the fence that retires the last frame that may have used them.
+	TDeferredReleaseQueue<IUnknown*> PendingReleases;
+
+	// Fences in insertion order, and event queries ready for reuse.
+	std::deque<FPendingFence> PendingFences;
+	std::vector<ID3D11Query*> FreeFenceQueries;
+	uint64_t LastFence;
+	uint64_t CompletedFence;
+
+	FRenderDeviceStats FrameStats;
+	FRenderDeviceStats LastFrameStats;
+
+	// Declared after FrameStats, which it counts into.
+	FD3D11ContextBinder Immediate;
+};
@@ -0,0 +1,73 @@
+#include "DirectXTemplate.h"
+#include "D3DShaderCompiler.h"
+
+namespace
+{
+	class FSourcesInclude : public ID3DInclude
+	{
+	public:
+		explicit FSourcesInclude(const FShaderSources& sources)
+			: Sources(sources)
+		{
+		}
+
+		HRESULT __stdcall Open(D3D_INCLUDE_TYPE includeType, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* bytes) override
+		{
+			const FShaderSourceFile* file = Sources.FindInclude(fileName);
+			if (!file)
+			{
+				return E_FAIL;
+			}
+
+			*data = file->Text.data();
+			*bytes = static_cast<UINT>(file->Text.size());
+
+			return S_OK;
+		}
+
+		HRESULT __stdcall Close(LPCVOID data) override
+		{
+			return S_OK;
+		}
+
+	private:
+		const FShaderSources& Sources;
+	};
+}
+
+FD3DShaderCompiler::FD3DShaderCompiler()
+	: Identity("D3DCompiler " + std::to_string(D3D_COMPILER_VERSION))
+{
+}
+
+const char* FD3DShaderCompiler::GetIdentity() const
+{
+	return Identity.c_str();
+}
+
+bool FD3DShaderCompiler::Compile(const FShaderCompileRequest& request, const FShaderSources& sources, std::vector<uint8_t>& bytecode, std::string& messages)
+{
+	FSourcesInclude include(sources);
+	const std::string& text = sources.Files[0].Text;
+
+	ID3DBlob* shaderBlob = nullptr;
+	ID3DBlob* errorBlob = nullptr;
+
+	HRESULT result = D3DCompile(text.data(), text.size(), request.FileName.c_str(), nullptr, &include, request.EntryPoint.c_str(), request.Profile.c_str(),
+		request.Flags, 0, &shaderBlob, &errorBlob);
+
+	messages = errorBlob ? std::string(static_cast<const char*>(errorBlob->GetBufferPointer()), errorBlob->GetBufferSize()) : std::string();
+	SafeRelease(errorBlob);
+
+	if (FAILED(result) || !shaderBlob)
+	{
+		SafeRelease(shaderBlob);
+		return false;
+	}
+
+	const uint8_t* code = static_cast<const uint8_t*>(shaderBlob->GetBufferPointer());
+	bytecode.assign(code, code + shaderBlob->GetBufferSize());
+	SafeRelease(shaderBlob);
+
+	return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "DirectXTemplate.h"
+#include "ShaderCache.h"
+
+// IShaderCompiler over D3DCompile. Includes are served from the resolved sources rather than the
+// disk, so the compiler sees exactly the text the cache key was computed from.
+class FD3DShaderCompiler : public IShaderCompiler
+{
+public:
+	FD3DShaderCompiler();
+
+	const char* GetIdentity() const override;
+	bool Compile(const FShaderCompileRequest& request, const FShaderSources& sources, std::vector<uint8_t>& bytecode, std::string& messages) override;
+
+private:
+	std::string Identity;
+};
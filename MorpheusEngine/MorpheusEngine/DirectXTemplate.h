@@ -2,13 +2,14 @@
 
 #include <windows.h>
 
-#include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <DirectXColors.h>
 
 #include <iostream>
 #include <algorithm>
+#include <cassert>
 #include <string>
 
 #pragma comment(lib, "d3d11.lib")
@@ -0,0 +1,241 @@
+#include "DrawList.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Never a valid handle, so the first draw after Submit() starts binds everything.
+	const uint32_t UnknownBinding = ~0u;
+
+	struct FTrackedState
+	{
+		uint32_t VertexShader = UnknownBinding;
+		uint32_t PixelShader = UnknownBinding;
+		uint32_t InputLayout = UnknownBinding;
+		uint32_t RasterizerState = UnknownBinding;
+		uint32_t DepthStencilState = UnknownBinding;
+		uint32_t BlendState = UnknownBinding;
+		uint32_t VertexBuffers[FDrawItem::MaxVertexStreams] = { UnknownBinding, UnknownBinding };
+		uint32_t VertexStrides[FDrawItem::MaxVertexStreams] = {};
+		uint32_t IndexBuffer = UnknownBinding;
+		EIndexFormat IndexFormat = EIndexFormat::UInt16;
+		uint32_t ConstantBuffers[FDrawItem::MaxConstantBuffers] = { UnknownBinding, UnknownBinding, UnknownBinding };
+		uint32_t ConstantBufferOffsets[FDrawItem::MaxConstantBuffers] = {};
+		uint32_t ConstantBufferSizes[FDrawItem::MaxConstantBuffers] = {};
+	};
+
+	// Returns whether the bind has to be issued, and counts it either way.
+	bool Changes(FDrawListStats& stats, uint32_t& bound, uint32_t value)
+	{
+		if (bound == value)
+		{
+			++stats.RedundantBindsSkipped;
+			return false;
+		}
+
+		bound = value;
+		++stats.Binds;
+
+		return true;
+	}
+}
+
+void FDrawList::Reset()
+{
+	Items.clear();
+	Keys.clear();
+}
+
+void FDrawList::Add(uint64_t sortKey, const FDrawItem& item)
+{
+	Items.push_back(item);
+	Keys.push_back(sortKey);
+}
+
+uint32_t FDrawList::GetCount() const
+{
+	return static_cast<uint32_t>(Items.size());
+}
+
+void FDrawList::Submit(IRenderDevice* renderDevice, FJobSystem* jobSystem)
+{
+	LastSubmitStats = FDrawListStats();
+
+	Sort(jobSystem);
+	Record(*renderDevice, 0, GetCount(), LastSubmitStats);
+}
+
+void FDrawList::SubmitParallel(IRenderDevice* renderDevice, ICommandList* const* commandLists, uint32_t commandListCount, FJobSystem* jobSystem)
+{
+	const uint32_t count = GetCount();
+
+	uint32_t sliceCount = std::min(commandListCount, count / MinDrawsPerCommandList);
+	if (sliceCount < 2 || !jobSystem)
+	{
+		Submit(renderDevice, jobSystem);
+		return;
+	}
+
+	LastSubmitStats = FDrawListStats();
+
+	Sort(jobSystem);
+
+	SliceStats.assign(sliceCount, FDrawListStats());
+
+	// The slices depend on the draw and list counts only, never on which worker records which.
+	jobSystem->ParallelFor(sliceCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t slice = begin; slice < end; ++slice)
+		{
+			uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(count) * slice / sliceCount);
+			uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(count) * (slice + 1) / sliceCount);
+
+			ICommandList* commandList = commandLists[slice];
+			commandList->Begin();
+			Record(*commandList, first, last, SliceStats[slice]);
+			commandList->End();
+		}
+	});
+
+	for (uint32_t slice = 0; slice < sliceCount; ++slice)
+	{
+		renderDevice->ExecuteCommandList(commandLists[slice]);
+
+		LastSubmitStats.Draws += SliceStats[slice].Draws;
+		LastSubmitStats.Binds += SliceStats[slice].Binds;
+		LastSubmitStats.RedundantBindsSkipped += SliceStats[slice].RedundantBindsSkipped;
+	}
+}
+
+void FDrawList::Sort(FJobSystem* jobSystem)
+{
+	const uint32_t count = GetCount();
+
+	SortedKeys.assign(Keys.begin(), Keys.end());
+	Order.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Order[i] = i;
+	}
+
+	Sorter.Sort(SortedKeys.data(), Order.data(), count, jobSystem);
+	LastSubmitStats.SortPasses = Sorter.GetLastPassCount();
+}
+
+void FDrawList::Record(ICommandContext& context, uint32_t first, uint32_t last, FDrawListStats& stats) const
+{
+	FTrackedState bound;
+
+	for (uint32_t position = first; position < last; ++position)
+	{
+		const FDrawItem& item = Items[Order[position]];
+		const FDrawPipelineState& pipeline = item.Pipeline;
+
+		if (Changes(stats, bound.VertexShader, pipeline.VertexShader.Value))
+		{
+			context.SetVertexShader(pipeline.VertexShader);
+		}
+
+		if (Changes(stats, bound.PixelShader, pipeline.PixelShader.Value))
+		{
+			context.SetPixelShader(pipeline.PixelShader);
+		}
+
+		if (Changes(stats, bound.InputLayout, pipeline.InputLayout.Value))
+		{
+			context.SetInputLayout(pipeline.InputLayout);
+		}
+
+		if (Changes(stats, bound.RasterizerState, pipeline.RasterizerState.Value))
+		{
+			context.SetRasterizerState(pipeline.RasterizerState);
+		}
+
+		if (Changes(stats, bound.DepthStencilState, pipeline.DepthStencilState.Value))
+		{
+			context.SetDepthStencilState(pipeline.DepthStencilState);
+		}
+
+		if (Changes(stats, bound.BlendState, pipeline.BlendState.Value))
+		{
+			context.SetBlendState(pipeline.BlendState);
+		}
+
+		for (uint32_t slot = 0; slot < FDrawItem::MaxVertexStreams; ++slot)
+		{
+			if (!item.VertexBuffers[slot].IsValid())
+			{
+				continue;
+			}
+
+			// A different stride alone still needs the buffer bound again.
+			if (bound.VertexStrides[slot] != item.VertexStrides[slot])
+			{
+				bound.VertexBuffers[slot] = UnknownBinding;
+				bound.VertexStrides[slot] = item.VertexStrides[slot];
+			}
+
+			if (Changes(stats, bound.VertexBuffers[slot], item.VertexBuffers[slot].Value))
+			{
+				context.SetVertexBuffer(slot, item.VertexBuffers[slot], item.VertexStrides[slot], 0);
+			}
+		}
+
+		if (bound.IndexFormat != item.IndexFormat)
+		{
+			bound.IndexBuffer = UnknownBinding;
+			bound.IndexFormat = item.IndexFormat;
+		}
+
+		if (Changes(stats, bound.IndexBuffer, item.IndexBuffer.Value))
+		{
+			context.SetIndexBuffer(item.IndexBuffer, item.IndexFormat, 0);
+		}
+
+		for (uint32_t slot = 0; slot < FDrawItem::MaxConstantBuffers; ++slot)
+		{
+			const FDrawConstantBuffer& constantBuffer = item.ConstantBuffers[slot];
+			if (!constantBuffer.Buffer.IsValid())
+			{
+				continue;
+			}
+
+			// Ring slices share a buffer, so the range is part of what is bound.
+			if (bound.ConstantBufferOffsets[slot] != constantBuffer.Offset || bound.ConstantBufferSizes[slot] != constantBuffer.Size)
+			{
+				bound.ConstantBuffers[slot] = UnknownBinding;
+				bound.ConstantBufferOffsets[slot] = constantBuffer.Offset;
+				bound.ConstantBufferSizes[slot] = constantBuffer.Size;
+			}
+
+			if (Changes(stats, bound.ConstantBuffers[slot], constantBuffer.Buffer.Value))
+			{
+				if (constantBuffer.Size == 0)
+				{
+					context.SetConstantBuffer(EShaderStage::Vertex, slot, constantBuffer.Buffer);
+				}
+				else
+				{
+					context.SetConstantBufferRange(EShaderStage::Vertex, slot, constantBuffer.Buffer, constantBuffer.Offset, constantBuffer.Size);
+				}
+			}
+		}
+
+		if (item.InstanceCount == 1 && item.StartInstance == 0)
+		{
+			context.DrawIndexed(item.IndexCount, item.StartIndex, item.BaseVertex);
+		}
+		else
+		{
+			context.DrawIndexedInstanced(item.IndexCount, item.InstanceCount, item.StartIndex, item.BaseVertex, item.StartInstance);
+		}
+
+		++stats.Draws;
+	}
+}
+
+const FDrawListStats& FDrawList::GetLastSubmitStats() const
+{
+	return LastSubmitStats;
+}
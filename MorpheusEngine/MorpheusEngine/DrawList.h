@@ -0,0 +1,153 @@
+#pragma once
+
+#include "RadixSort.h"
+#include "RenderDevice.h"
+
+#include <cstdint>
+#include <vector>
+
+class FJobSystem;
+
+// Fields of a draw sort key, most significant first. Opaque draws group by pipeline state and
+// material and go front to back inside each group; translucent draws go back to front across all
+// of them and sort after every opaque draw of their layer.
+struct FDrawSortKeyFields
+{
+	uint32_t Layer = 0;
+	bool Translucent = false;
+	// Identifies the shaders and fixed function state, usually an index into a table of pipelines.
+	uint32_t Pipeline = 0;
+	// Identifies the resources bound with the pipeline, a material or a mesh.
+	uint32_t Material = 0;
+	// From QuantizeDrawDepth(), zero is nearest.
+	uint32_t Depth = 0;
+};
+
+const uint32_t DrawSortLayerBits = 4;
+const uint32_t DrawSortPipelineBits = 16;
+const uint32_t DrawSortMaterialBits = 16;
+const uint32_t DrawSortDepthBits = 27;
+
+// Opaque:      layer:4 | 0 | pipeline:16 | material:16 | depth:27
+// Translucent: layer:4 | 1 | ~depth:27 | pipeline:16 | material:16
+// Fields are masked to their width.
+inline uint64_t MakeDrawSortKey(const FDrawSortKeyFields& fields)
+{
+	const uint64_t depthMask = (1ull << DrawSortDepthBits) - 1;
+
+	uint64_t layer = static_cast<uint64_t>(fields.Layer & ((1u << DrawSortLayerBits) - 1)) << 60;
+	uint64_t pipeline = fields.Pipeline & ((1u << DrawSortPipelineBits) - 1);
+	uint64_t material = fields.Material & ((1u << DrawSortMaterialBits) - 1);
+	uint64_t depth = fields.Depth & depthMask;
+
+	if (fields.Translucent)
+	{
+		return layer | (1ull << 59) | ((depthMask - depth) << 32) | (pipeline << 16) | material;
+	}
+
+	return layer | (pipeline << 43) | (material << 27) | depth;
+}
+
+// Maps a view space depth linearly between the clip planes onto the depth field of a sort key.
+inline uint32_t QuantizeDrawDepth(float viewDepth, float nearPlane, float farPlane)
+{
+	const float maxDepth = static_cast<float>((1u << DrawSortDepthBits) - 1);
+
+	float normalised = (viewDepth - nearPlane) / (farPlane - nearPlane);
+	normalised = normalised < 0.0f ? 0.0f : (normalised > 1.0f ? 1.0f : normalised);
+
+	return static_cast<uint32_t>(normalised * maxDepth);
+}
+
+struct FDrawPipelineState
+{
+	FVertexShaderHandle VertexShader;
+	FPixelShaderHandle PixelShader;
+	FInputLayoutHandle InputLayout;
+	FRasterizerStateHandle RasterizerState;
+	FDepthStencilStateHandle DepthStencilState;
+	FBlendStateHandle BlendState;
+};
+
+// A vertex shader constant buffer. A size of zero binds the whole buffer, an invalid buffer leaves the
+// slot as it is.
+struct FDrawConstantBuffer
+{
+	FBufferHandle Buffer;
+	uint32_t Offset = 0;
+	uint32_t Size = 0;
+};
+
+// Everything one draw binds. Slot 1 of the vertex streams is usually the instance stream.
+struct FDrawItem
+{
+	static const uint32_t MaxVertexStreams = 2;
+	static const uint32_t MaxConstantBuffers = 3;
+
+	FDrawPipelineState Pipeline;
+	FBufferHandle VertexBuffers[MaxVertexStreams];
+	uint32_t VertexStrides[MaxVertexStreams] = {};
+	FBufferHandle IndexBuffer;
+	EIndexFormat IndexFormat = EIndexFormat::UInt16;
+	FDrawConstantBuffer ConstantBuffers[MaxConstantBuffers];
+
+	uint32_t IndexCount = 0;
+	uint32_t StartIndex = 0;
+	int32_t BaseVertex = 0;
+	// One draws without instancing.
+	uint32_t InstanceCount = 1;
+	uint32_t StartInstance = 0;
+};
+
+// Counters of the last Submit(). Binds are the calls made, redundant binds the ones skipped because
+// the previous draw had bound the same thing.
+struct FDrawListStats
+{
+	uint32_t Draws = 0;
+	uint64_t Binds = 0;
+	uint64_t RedundantBindsSkipped = 0;
+	uint32_t SortPasses = 0;
+};
+
+// Collects the draws of a frame with a sort key each. Submit() orders them with a parallel radix sort
+// and walks the sorted list, binding only the state that differs from the previous draw.
+//
+// The device state is unknown when Submit() starts, so its first draw binds everything. Not thread safe.
+class FDrawList
+{
+public:
+	// Below this many draws a command list costs more to record and execute than it saves.
+	static const uint32_t MinDrawsPerCommandList = 256;
+
+	// Forgets the draws and keeps the memory.
+	void Reset();
+	void Add(uint64_t sortKey, const FDrawItem& item);
+	uint32_t GetCount() const;
+
+	// Sorts and submits every draw added since Reset(). The list stays intact.
+	void Submit(IRenderDevice* renderDevice, FJobSystem* jobSystem = nullptr);
+
+	// Sorts like Submit(), then cuts the sorted draws into one contiguous slice per command list and
+	// records the slices on the job system. The lists are executed in slice order on the calling
+	// thread, so the device receives the draws in sorted order whatever the thread count. Every slice
+	// binds everything for its first draw. Falls back to Submit() when there are too few draws to split.
+	void SubmitParallel(IRenderDevice* renderDevice, ICommandList* const* commandLists, uint32_t commandListCount, FJobSystem* jobSystem);
+
+	const FDrawListStats& GetLastSubmitStats() const;
+
+private:
+	void Sort(FJobSystem* jobSystem);
+	// Binds and draws the sorted draws [first, last), starting from unknown state.
+	void Record(ICommandContext& context, uint32_t first, uint32_t last, FDrawListStats& stats) const;
+
+	std::vector<FDrawItem> Items;
+	std::vector<uint64_t> Keys;
+	// Sorted copies of the keys and the item each one belongs to.
+	std::vector<uint64_t> SortedKeys;
+	std::vector<uint32_t> Order;
+	// Counters of every slice of the last SubmitParallel().
+	std::vector<FDrawListStats> SliceStats;
+
+	FRadixSorter Sorter;
+	FDrawListStats LastSubmitStats;
+};
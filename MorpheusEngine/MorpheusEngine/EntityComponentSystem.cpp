@@ -0,0 +1,479 @@
+#include "EntityComponentSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace
+{
+	// Chunks are allocated a page of this many at a time.
+	const uint32_t ChunksPerPage = 16;
+
+	FComponentTypeInfo ComponentTypes[MaxComponentTypes];
+	std::atomic<uint32_t> ComponentTypeCount(0);
+	std::mutex ComponentTypeMutex;
+
+	uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+uint32_t RegisterComponentType(uint32_t size, uint32_t alignment)
+{
+	std::lock_guard<std::mutex> lock(ComponentTypeMutex);
+
+	uint32_t type = ComponentTypeCount.load(std::memory_order_relaxed);
+	assert(type < MaxComponentTypes);
+	assert(alignment <= FEntityWorld::ColumnAlignment);
+
+	ComponentTypes[type].Size = size;
+	ComponentTypes[type].Alignment = alignment;
+	ComponentTypeCount.store(type + 1, std::memory_order_release);
+
+	return type;
+}
+
+const FComponentTypeInfo& GetComponentTypeInfo(uint32_t type)
+{
+	assert(type < ComponentTypeCount.load(std::memory_order_acquire));
+	return ComponentTypes[type];
+}
+
+FEntityWorld::FEntityWorld()
+	: ChunkPool(ChunkSize, ColumnAlignment, ChunksPerPage)
+	, IterationDepth(0)
+{
+}
+
+FEntityWorld::~FEntityWorld()
+{
+	for (FArchetype& archetype : Archetypes)
+	{
+		for (FArchetypeChunk& chunk : archetype.Chunks)
+		{
+			ChunkPool.Free(chunk.Data);
+		}
+	}
+}
+
+FEntity FEntityWorld::CreateEntity(FComponentMask mask)
+{
+	assert(IterationDepth == 0);
+
+	uint32_t index;
+	if (!FreeRecords.empty())
+	{
+		index = FreeRecords.back();
+		FreeRecords.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(Records.size());
+		Records.push_back({ InvalidIndex, 0, 0, 1 });
+	}
+
+	uint32_t archetype = GetArchetype(mask);
+	AllocateRow(archetype, index);
+
+	const FEntityRecord& record = Records[index];
+	FArchetypeChunk& chunk = Archetypes[archetype].Chunks[record.Chunk];
+	for (uint32_t type : Archetypes[archetype].Types)
+	{
+		uint32_t size = ComponentTypes[type].Size;
+		memset(chunk.Data + Archetypes[archetype].ColumnOffsets[type] + record.Row * size, 0, size);
+	}
+
+	++Stats.Entities;
+
+	FEntity entity;
+	entity.Index = index;
+	entity.Generation = record.Generation;
+
+	return entity;
+}
+
+void FEntityWorld::DestroyEntity(FEntity entity)
+{
+	assert(IterationDepth == 0);
+	assert(IsAlive(entity));
+
+	FEntityRecord& record = Records[entity.Index];
+	FreeRow(record.Archetype, record.Chunk, record.Row);
+
+	record.Archetype = InvalidIndex;
+	// Zero is the invalid generation.
+	record.Generation = record.Generation + 1 != 0 ? record.Generation + 1 : 1;
+	FreeRecords.push_back(entity.Index);
+
+	--Stats.Entities;
+}
+
+bool FEntityWorld::IsAlive(FEntity entity) const
+{
+	return FindRecord(entity) != nullptr;
+}
+
+FComponentMask FEntityWorld::GetComponentMask(FEntity entity) const
+{
+	const FEntityRecord* record = FindRecord(entity);
+	return record ? Archetypes[record->Archetype].Mask : 0;
+}
+
+void FEntityWorld::AddComponent(FEntity entity, uint32_t type, const void* value)
+{
+	assert(IsAlive(entity));
+
+	FEntityRecord& record = Records[entity.Index];
+	if ((Archetypes[record.Archetype].Mask & (FComponentMask(1) << type)) == 0)
+	{
+		assert(IterationDepth == 0);
+		MoveEntity(entity.Index, GetNeighbour(record.Archetype, type, true));
+	}
+
+	memcpy(GetComponent(entity, type), value, ComponentTypes[type].Size);
+}
+
+void FEntityWorld::RemoveComponent(FEntity entity, uint32_t type)
+{
+	assert(IsAlive(entity));
+
+	FEntityRecord& record = Records[entity.Index];
+	if ((Archetypes[record.Archetype].Mask & (FComponentMask(1) << type)) != 0)
+	{
+		assert(IterationDepth == 0);
+		MoveEntity(entity.Index, GetNeighbour(record.Archetype, type, false));
+	}
+}
+
+void* FEntityWorld::GetComponent(FEntity entity, uint32_t type)
+{
+	const FEntityRecord* record = FindRecord(entity);
+	if (!record)
+	{
+		return nullptr;
+	}
+
+	const FArchetype& archetype = Archetypes[record->Archetype];
+	uint32_t offset = archetype.ColumnOffsets[type];
+	if (offset == 0)
+	{
+		return nullptr;
+	}
+
+	return archetype.Chunks[record->Chunk].Data + offset + record->Row * ComponentTypes[type].Size;
+}
+
+FEntityQuery& FEntityWorld::GetQuery(FComponentMask all, FComponentMask none)
+{
+	assert((all & none) == 0);
+
+	for (const std::unique_ptr<FEntityQuery>& query : Queries)
+	{
+		if (query->All == all && query->None == none)
+		{
+			return *query;
+		}
+	}
+
+	Queries.push_back(std::make_unique<FEntityQuery>());
+	Queries.back()->All = all;
+	Queries.back()->None = none;
+
+	return *Queries.back();
+}
+
+uint32_t FEntityWorld::GetChunkCapacity(FComponentMask mask)
+{
+	return Archetypes[GetArchetype(mask)].Capacity;
+}
+
+const FEntityWorldStats& FEntityWorld::GetStats() const
+{
+	return Stats;
+}
+
+uint32_t FEntityWorld::GetArchetype(FComponentMask mask)
+{
+	auto found = ArchetypeIndices.find(mask);
+	if (found != ArchetypeIndices.end())
+	{
+		return found->second;
+	}
+
+	FArchetype archetype;
+	archetype.Mask = mask;
+	std::fill(std::begin(archetype.ColumnOffsets), std::end(archetype.ColumnOffsets), 0u);
+
+	uint32_t rowSize = sizeof(FEntity);
+	for (uint32_t type = 0; type < MaxComponentTypes; ++type)
+	{
+		if (mask & (FComponentMask(1) << type))
+		{
+			archetype.Types.push_back(type);
+			rowSize += GetComponentTypeInfo(type).Size;
+		}
+	}
+
+	// Aligning each column wastes less than ColumnAlignment bytes, which is set aside up front.
+	const uint32_t columnCount = static_cast<uint32_t>(archetype.Types.size()) + 1;
+	archetype.Capacity = (ChunkSize - ColumnAlignment * columnCount) / rowSize;
+	assert(archetype.Capacity > 0);
+
+	uint32_t offset = AlignUp(sizeof(FEntity) * archetype.Capacity, ColumnAlignment);
+	for (uint32_t type : archetype.Types)
+	{
+		archetype.ColumnOffsets[type] = offset;
+		offset = AlignUp(offset + ComponentTypes[type].Size * archetype.Capacity, ColumnAlignment);
+	}
+	assert(offset <= ChunkSize);
+
+	uint32_t index = static_cast<uint32_t>(Archetypes.size());
+	Archetypes.push_back(std::move(archetype));
+	ArchetypeIndices.emplace(mask, index);
+	++Stats.Archetypes;
+
+	return index;
+}
+
+uint32_t FEntityWorld::GetNeighbour(uint32_t archetype, uint32_t type, bool add)
+{
+	std::vector<FArchetypeEdge>& edges = add ? Archetypes[archetype].AddEdges : Archetypes[archetype].RemoveEdges;
+	for (const FArchetypeEdge& edge : edges)
+	{
+		if (edge.Type == type)
+		{
+			return edge.Archetype;
+		}
+	}
+
+	FComponentMask bit = FComponentMask(1) << type;
+	FComponentMask mask = add ? Archetypes[archetype].Mask | bit : Archetypes[archetype].Mask & ~bit;
+	uint32_t neighbour = GetArchetype(mask);
+
+	// Creating the archetype may have moved the array.
+	FArchetypeEdge edge = { type, neighbour };
+	(add ? Archetypes[archetype].AddEdges : Archetypes[archetype].RemoveEdges).push_back(edge);
+
+	return neighbour;
+}
+
+const FEntityWorld::FEntityRecord* FEntityWorld::FindRecord(FEntity entity) const
+{
+	if (entity.Index >= Records.size())
+	{
+		return nullptr;
+	}
+
+	const FEntityRecord& record = Records[entity.Index];
+	return record.Generation == entity.Generation && record.Archetype != InvalidIndex ? &record : nullptr;
+}
+
+void FEntityWorld::AllocateRow(uint32_t archetype, uint32_t entityIndex)
+{
+	FArchetype& target = Archetypes[archetype];
+	if (target.Chunks.empty() || target.Chunks.back().Count == target.Capacity)
+	{
+		FArchetypeChunk chunk = { static_cast<uint8_t*>(ChunkPool.Allocate()), 0 };
+		target.Chunks.push_back(chunk);
+		++Stats.Chunks;
+	}
+
+	FArchetypeChunk& chunk = target.Chunks.back();
+	FEntityRecord& record = Records[entityIndex];
+	record.Archetype = archetype;
+	record.Chunk = static_cast<uint32_t>(target.Chunks.size() - 1);
+	record.Row = chunk.Count++;
+
+	FEntity entity;
+	entity.Index = entityIndex;
+	entity.Generation = record.Generation;
+	reinterpret_cast<FEntity*>(chunk.Data)[record.Row] = entity;
+}
+
+void FEntityWorld::FreeRow(uint32_t archetype, uint32_t chunk, uint32_t row)
+{
+	FArchetype& source = Archetypes[archetype];
+	FArchetypeChunk& last = source.Chunks.back();
+	const uint32_t lastRow = last.Count - 1;
+
+	FArchetypeChunk& hole = source.Chunks[chunk];
+	if (&hole != &last || row != lastRow)
+	{
+		FEntity moved = reinterpret_cast<FEntity*>(last.Data)[lastRow];
+		reinterpret_cast<FEntity*>(hole.Data)[row] = moved;
+
+		for (uint32_t type : source.Types)
+		{
+			uint32_t size = ComponentTypes[type].Size;
+			uint32_t offset = source.ColumnOffsets[type];
+			memcpy(hole.Data + offset + row * size, last.Data + offset + lastRow * size, size);
+		}
+
+		Records[moved.Index].Chunk = chunk;
+		Records[moved.Index].Row = row;
+	}
+
+	if (--last.Count == 0)
+	{
+		ChunkPool.Free(last.Data);
+		source.Chunks.pop_back();
+		--Stats.Chunks;
+	}
+}
+
+void FEntityWorld::MoveEntity(uint32_t entityIndex, uint32_t archetype)
+{
+	const FEntityRecord previous = Records[entityIndex];
+	AllocateRow(archetype, entityIndex);
+
+	const FEntityRecord& record = Records[entityIndex];
+	const FArchetype& source = Archetypes[previous.Archetype];
+	const FArchetype& target = Archetypes[archetype];
+	const uint8_t* sourceData = source.Chunks[previous.Chunk].Data;
+	uint8_t* targetData = target.Chunks[record.Chunk].Data;
+
+	// Components the entity keeps are copied, the one it gains is zeroed.
+	for (uint32_t type : target.Types)
+	{
+		uint32_t size = ComponentTypes[type].Size;
+		uint8_t* destination = targetData + target.ColumnOffsets[type] + record.Row * size;
+		if (source.ColumnOffsets[type] != 0)
+		{
+			memcpy(destination, sourceData + source.ColumnOffsets[type] + previous.Row * size, size);
+		}
+		else
+		{
+			memset(destination, 0, size);
+		}
+	}
+
+	FreeRow(previous.Archetype, previous.Chunk, previous.Row);
+	++Stats.EntitiesMoved;
+}
+
+void FEntityWorld::CollectChunks(FEntityQuery& query)
+{
+	const uint32_t archetypeCount = static_cast<uint32_t>(Archetypes.size());
+	for (; query.CheckedArchetypes < archetypeCount; ++query.CheckedArchetypes)
+	{
+		FComponentMask mask = Archetypes[query.CheckedArchetypes].Mask;
+		if ((mask & query.All) == query.All && (mask & query.None) == 0)
+		{
+			query.Archetypes.push_back(query.CheckedArchetypes);
+		}
+	}
+
+	query.Chunks.clear();
+	for (uint32_t index : query.Archetypes)
+	{
+		const FArchetype& archetype = Archetypes[index];
+		for (const FArchetypeChunk& source : archetype.Chunks)
+		{
+			FEntityChunk chunk;
+			chunk.Data = source.Data;
+			chunk.Count = source.Count;
+			chunk.ColumnOffsets = archetype.ColumnOffsets;
+			query.Chunks.push_back(chunk);
+		}
+	}
+}
+
+void FEntityCommandBuffer::DestroyEntity(FEntity entity)
+{
+	FCommandHeader header = { ECommand::Destroy, 0, entity };
+	Write(&header, sizeof(header));
+	++CommandCount;
+}
+
+void FEntityCommandBuffer::Playback(FEntityWorld& world)
+{
+	size_t position = 0;
+
+	// Headers and components are packed without padding, so they are copied out rather than cast.
+	auto read = [&](void* destination, size_t size)
+	{
+		memcpy(destination, Data.data() + position, size);
+		position += size;
+	};
+
+	while (position < Data.size())
+	{
+		FCommandHeader header;
+		read(&header, sizeof(header));
+
+		switch (header.Command)
+		{
+		case ECommand::Create:
+		{
+			// The mask comes first, so every component is written in place.
+			FComponentMask mask = 0;
+			size_t start = position;
+			for (uint32_t i = 0; i < header.Count; ++i)
+			{
+				uint32_t type;
+				read(&type, sizeof(type));
+				mask |= FComponentMask(1) << type;
+				position += GetComponentTypeInfo(type).Size;
+			}
+
+			FEntity entity = world.CreateEntity(mask);
+
+			position = start;
+			for (uint32_t i = 0; i < header.Count; ++i)
+			{
+				uint32_t type;
+				read(&type, sizeof(type));
+				read(world.GetComponent(entity, type), GetComponentTypeInfo(type).Size);
+			}
+			break;
+		}
+
+		case ECommand::Destroy:
+			if (world.IsAlive(header.Entity))
+			{
+				world.DestroyEntity(header.Entity);
+			}
+			break;
+
+		case ECommand::AddComponent:
+		{
+			uint32_t type;
+			read(&type, sizeof(type));
+			if (world.IsAlive(header.Entity))
+			{
+				world.AddComponent(header.Entity, type, Data.data() + position);
+			}
+			position += GetComponentTypeInfo(type).Size;
+			break;
+		}
+
+		case ECommand::RemoveComponent:
+			if (world.IsAlive(header.Entity))
+			{
+				world.RemoveComponent(header.Entity, header.Count);
+			}
+			break;
+		}
+	}
+
+	Clear();
+}
+
+void FEntityCommandBuffer::Clear()
+{
+	Data.clear();
+	CommandCount = 0;
+}
+
+uint32_t FEntityCommandBuffer::GetCommandCount() const
+{
+	return CommandCount;
+}
+
+void FEntityCommandBuffer::Write(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	Data.insert(Data.end(), bytes, bytes + size);
+}
@@ -0,0 +1,417 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "PoolAllocator.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+class FEntityWorld;
+
+// Slot in the entity table and the generation of the slot when the entity was created, so the handle
+// of a destroyed entity is never mistaken for a later one in the same slot. Generation zero is invalid.
+struct FEntity
+{
+	uint32_t Index = 0;
+	uint32_t Generation = 0;
+
+	bool IsValid() const
+	{
+		return Generation != 0;
+	}
+
+	bool operator==(const FEntity& other) const
+	{
+		return Index == other.Index && Generation == other.Generation;
+	}
+
+	bool operator!=(const FEntity& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// One bit per component type.
+typedef uint64_t FComponentMask;
+
+static const uint32_t MaxComponentTypes = 64;
+
+struct FComponentTypeInfo
+{
+	uint32_t Size = 0;
+	uint32_t Alignment = 0;
+};
+
+// Gives the type the next free id. Use GetComponentType<T>(), which registers every type once.
+uint32_t RegisterComponentType(uint32_t size, uint32_t alignment);
+const FComponentTypeInfo& GetComponentTypeInfo(uint32_t type);
+
+// Components are plain data: they are moved between chunks with memcpy and never destroyed.
+template<typename T>
+uint32_t GetComponentType()
+{
+	static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value, "Components must be plain data");
+
+	static const uint32_t type = RegisterComponentType(sizeof(T), alignof(T));
+	return type;
+}
+
+template<typename... T>
+FComponentMask GetComponentMask()
+{
+	return (FComponentMask(0) | ... | (FComponentMask(1) << GetComponentType<T>()));
+}
+
+// The entities of one chunk and their component columns, as handed to query callbacks.
+class FEntityChunk
+{
+public:
+	uint32_t GetCount() const
+	{
+		return Count;
+	}
+
+	const FEntity* GetEntities() const
+	{
+		return reinterpret_cast<const FEntity*>(Data);
+	}
+
+	// Null when the archetype of the chunk has no such component.
+	template<typename T>
+	T* GetComponents() const
+	{
+		uint32_t offset = ColumnOffsets[GetComponentType<T>()];
+		return offset != 0 ? reinterpret_cast<T*>(Data + offset) : nullptr;
+	}
+
+private:
+	friend class FEntityWorld;
+
+	uint8_t* Data = nullptr;
+	uint32_t Count = 0;
+	const uint32_t* ColumnOffsets = nullptr;
+};
+
+// Entities that have every component of All and none of None. The archetypes that match are cached
+// and only archetypes created since the last use are checked again.
+class FEntityQuery
+{
+public:
+	FComponentMask GetAll() const
+	{
+		return All;
+	}
+
+	FComponentMask GetNone() const
+	{
+		return None;
+	}
+
+private:
+	friend class FEntityWorld;
+
+	FComponentMask All = 0;
+	FComponentMask None = 0;
+	std::vector<uint32_t> Archetypes;
+	uint32_t CheckedArchetypes = 0;
+	// Chunks of the last iteration, kept to avoid allocating every time.
+	std::vector<FEntityChunk> Chunks;
+};
+
+struct FEntityWorldStats
+{
+	uint32_t Entities = 0;
+	uint32_t Archetypes = 0;
+	uint32_t Chunks = 0;
+	// Entities copied to another archetype by adding or removing a component.
+	uint64_t EntitiesMoved = 0;
+};
+
+// Entity component system with archetype storage. All entities with the same set of components share
+// an archetype, which keeps them in fixed ChunkSize blocks: an entity column and one column per
+// component, each a contiguous array, so a query walks plain arrays chunk by chunk. Removing an entity
+// moves the last entity of its archetype into the hole, which keeps every chunk but the last full.
+//
+// Adding or removing components moves the entity to another archetype. These structural changes must
+// not happen while a query runs; jobs record them into an FEntityCommandBuffer instead, which is played
+// back afterwards. Not thread safe, apart from queries writing the components of their own chunks.
+class FEntityWorld
+{
+public:
+	static const uint32_t ChunkSize = 16 * 1024;
+	// Every column starts on a cache line.
+	static const uint32_t ColumnAlignment = 64;
+
+	FEntityWorld();
+	~FEntityWorld();
+
+	FEntityWorld(const FEntityWorld&) = delete;
+	FEntityWorld& operator=(const FEntityWorld&) = delete;
+
+	template<typename... T>
+	FEntity CreateEntity(const T&... components);
+	// Components are zeroed.
+	FEntity CreateEntity(FComponentMask mask);
+	void DestroyEntity(FEntity entity);
+	bool IsAlive(FEntity entity) const;
+
+	// Overwrites the component when the entity has it already.
+	template<typename T>
+	void AddComponent(FEntity entity, const T& value = T());
+	template<typename T>
+	void RemoveComponent(FEntity entity);
+	template<typename T>
+	bool HasComponent(FEntity entity) const;
+	// Null when the entity has no such component. Valid until the next structural change.
+	template<typename T>
+	T* GetComponent(FEntity entity);
+
+	FComponentMask GetComponentMask(FEntity entity) const;
+
+	// Type-erased forms of the templates, for command buffer playback.
+	void AddComponent(FEntity entity, uint32_t type, const void* value);
+	void RemoveComponent(FEntity entity, uint32_t type);
+	void* GetComponent(FEntity entity, uint32_t type);
+
+	// The same query object for the same masks, so its archetype list is only built once.
+	FEntityQuery& GetQuery(FComponentMask all, FComponentMask none = 0);
+
+	// Calls function(const FEntityChunk&) for every non-empty chunk that matches. Chunks are split across
+	// the job system when one is given, so the function may run on several threads at once.
+	template<typename FunctionType>
+	void ForEachChunk(FEntityQuery& query, const FunctionType& function, FJobSystem* jobSystem = nullptr);
+	// Calls function(FEntity, T&...) for every entity that matches. The query must require every T.
+	template<typename... T, typename FunctionType>
+	void ForEach(FEntityQuery& query, const FunctionType& function, FJobSystem* jobSystem = nullptr);
+
+	// Number of entities a chunk of the given set of components holds.
+	uint32_t GetChunkCapacity(FComponentMask mask);
+
+	const FEntityWorldStats& GetStats() const;
+
+private:
+	static const uint32_t InvalidIndex = ~0u;
+	// Chunks handed to one job.
+	static const uint32_t ChunksPerJob = 4;
+
+	struct FArchetypeChunk
+	{
+		uint8_t* Data;
+		uint32_t Count;
+	};
+
+	struct FArchetypeEdge
+	{
+		uint32_t Type;
+		uint32_t Archetype;
+	};
+
+	struct FArchetype
+	{
+		FComponentMask Mask;
+		std::vector<uint32_t> Types;
+		uint32_t Capacity;
+		// Byte offset of the column of every component type in a chunk, zero for the types the
+		// archetype does not have. The entity column is at zero.
+		uint32_t ColumnOffsets[MaxComponentTypes];
+		std::vector<FArchetypeChunk> Chunks;
+		// Archetypes one component away, found on first use.
+		std::vector<FArchetypeEdge> AddEdges;
+		std::vector<FArchetypeEdge> RemoveEdges;
+	};
+
+	struct FEntityRecord
+	{
+		uint32_t Archetype;
+		uint32_t Chunk;
+		uint32_t Row;
+		uint32_t Generation;
+	};
+
+	uint32_t GetArchetype(FComponentMask mask);
+	uint32_t GetNeighbour(uint32_t archetype, uint32_t type, bool add);
+	const FEntityRecord* FindRecord(FEntity entity) const;
+	// Appends a row for the entity and points its record at it. The components are not initialised.
+	void AllocateRow(uint32_t archetype, uint32_t entityIndex);
+	// Moves the last row of the archetype into the row and releases the last one.
+	void FreeRow(uint32_t archetype, uint32_t chunk, uint32_t row);
+	void MoveEntity(uint32_t entityIndex, uint32_t archetype);
+	void CollectChunks(FEntityQuery& query);
+
+	template<typename FunctionType, typename... T>
+	static void ForEachRow(const FunctionType& function, const FEntity* entities, uint32_t count, T*... columns)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			function(entities[i], columns[i]...);
+		}
+	}
+
+	FPoolAllocator ChunkPool;
+	std::vector<FArchetype> Archetypes;
+	std::unordered_map<FComponentMask, uint32_t> ArchetypeIndices;
+	std::vector<FEntityRecord> Records;
+	std::vector<uint32_t> FreeRecords;
+	std::vector<std::unique_ptr<FEntityQuery>> Queries;
+	FEntityWorldStats Stats;
+	// Queries running on this world, which must not see structural changes.
+	uint32_t IterationDepth;
+};
+
+// Structural changes recorded for later, by jobs that iterate a query. Commands are applied in the
+// order they were recorded; those on entities that are dead by then are skipped. Entities created
+// through a buffer have no handle until playback, so later commands cannot refer to them. Use one
+// buffer per thread.
+class FEntityCommandBuffer
+{
+public:
+	template<typename... T>
+	void CreateEntity(const T&... components);
+	void DestroyEntity(FEntity entity);
+	template<typename T>
+	void AddComponent(FEntity entity, const T& value = T());
+	template<typename T>
+	void RemoveComponent(FEntity entity);
+
+	// Applies and clears the commands.
+	void Playback(FEntityWorld& world);
+	void Clear();
+
+	uint32_t GetCommandCount() const;
+
+private:
+	enum class ECommand : uint32_t
+	{
+		Create,
+		Destroy,
+		AddComponent,
+		RemoveComponent,
+	};
+
+	// Followed by Count components for Create and one for AddComponent, each a type and its bytes.
+	// RemoveComponent keeps the type in Count.
+	struct FCommandHeader
+	{
+		ECommand Command;
+		uint32_t Count;
+		FEntity Entity;
+	};
+
+	void Write(const void* data, size_t size);
+	template<typename T>
+	void WriteComponent(const T& component);
+
+	std::vector<uint8_t> Data;
+	uint32_t CommandCount = 0;
+};
+
+template<typename... T>
+FEntity FEntityWorld::CreateEntity(const T&... components)
+{
+	FEntity entity = CreateEntity(::GetComponentMask<T...>());
+	((*GetComponent<T>(entity) = components), ...);
+
+	return entity;
+}
+
+template<typename T>
+void FEntityWorld::AddComponent(FEntity entity, const T& value)
+{
+	AddComponent(entity, GetComponentType<T>(), &value);
+}
+
+template<typename T>
+void FEntityWorld::RemoveComponent(FEntity entity)
+{
+	RemoveComponent(entity, GetComponentType<T>());
+}
+
+template<typename T>
+bool FEntityWorld::HasComponent(FEntity entity) const
+{
+	return (GetComponentMask(entity) & ::GetComponentMask<T>()) != 0;
+}
+
+template<typename T>
+T* FEntityWorld::GetComponent(FEntity entity)
+{
+	return static_cast<T*>(GetComponent(entity, GetComponentType<T>()));
+}
+
+template<typename FunctionType>
+void FEntityWorld::ForEachChunk(FEntityQuery& query, const FunctionType& function, FJobSystem* jobSystem)
+{
+	CollectChunks(query);
+
+	const std::vector<FEntityChunk>& chunks = query.Chunks;
+	const uint32_t chunkCount = static_cast<uint32_t>(chunks.size());
+
+	++IterationDepth;
+	if (jobSystem && chunkCount > ChunksPerJob)
+	{
+		jobSystem->ParallelFor(chunkCount, ChunksPerJob, [&](uint32_t first, uint32_t last)
+		{
+			for (uint32_t i = first; i < last; ++i)
+			{
+				function(chunks[i]);
+			}
+		});
+	}
+	else
+	{
+		for (const FEntityChunk& chunk : chunks)
+		{
+			function(chunk);
+		}
+	}
+	--IterationDepth;
+}
+
+template<typename... T, typename FunctionType>
+void FEntityWorld::ForEach(FEntityQuery& query, const FunctionType& function, FJobSystem* jobSystem)
+{
+	assert((query.GetAll() & ::GetComponentMask<T...>()) == ::GetComponentMask<T...>());
+
+	ForEachChunk(query, [&function](const FEntityChunk& chunk)
+	{
+		ForEachRow(function, chunk.GetEntities(), chunk.GetCount(), chunk.GetComponents<T>()...);
+	}, jobSystem);
+}
+
+template<typename... T>
+void FEntityCommandBuffer::CreateEntity(const T&... components)
+{
+	FCommandHeader header = { ECommand::Create, static_cast<uint32_t>(sizeof...(T)), FEntity() };
+	Write(&header, sizeof(header));
+	(WriteComponent(components), ...);
+	++CommandCount;
+}
+
+template<typename T>
+void FEntityCommandBuffer::AddComponent(FEntity entity, const T& value)
+{
+	FCommandHeader header = { ECommand::AddComponent, 1, entity };
+	Write(&header, sizeof(header));
+	WriteComponent(value);
+	++CommandCount;
+}
+
+template<typename T>
+void FEntityCommandBuffer::RemoveComponent(FEntity entity)
+{
+	FCommandHeader header = { ECommand::RemoveComponent, GetComponentType<T>(), entity };
+	Write(&header, sizeof(header));
+	++CommandCount;
+}
+
+template<typename T>
+void FEntityCommandBuffer::WriteComponent(const T& component)
+{
+	uint32_t type = GetComponentType<T>();
+	Write(&type, sizeof(type));
+	Write(&component, sizeof(T));
+}
@@ -0,0 +1,59 @@
+#include "FrameScheduler.h"
+
+#include <cassert>
+#include <chrono>
+
+uint64_t FHighResolutionClock::NowNanoseconds()
+{
+	// steady_clock is backed by QueryPerformanceCounter on Windows and CLOCK_MONOTONIC elsewhere.
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+FFixedTimestep::FFixedTimestep(uint64_t stepNanoseconds, uint32_t maxStepsPerFrame)
+	: StepNanoseconds(stepNanoseconds)
+	, MaxStepsPerFrame(maxStepsPerFrame)
+	, Accumulator(0)
+	, DroppedNanoseconds(0)
+{
+	assert(StepNanoseconds > 0);
+	assert(MaxStepsPerFrame > 0);
+}
+
+uint32_t FFixedTimestep::Advance(uint64_t elapsedNanoseconds)
+{
+	Accumulator += elapsedNanoseconds;
+
+	uint64_t steps = Accumulator / StepNanoseconds;
+	if (steps > MaxStepsPerFrame)
+	{
+		// Keep the fractional part so the interpolation stays continuous after a hitch.
+		uint64_t excess = (steps - MaxStepsPerFrame) * StepNanoseconds;
+		DroppedNanoseconds += excess;
+		Accumulator -= excess;
+		steps = MaxStepsPerFrame;
+	}
+
+	Accumulator -= steps * StepNanoseconds;
+
+	return static_cast<uint32_t>(steps);
+}
+
+float FFixedTimestep::GetStepSeconds() const
+{
+	return static_cast<float>(static_cast<double>(StepNanoseconds) * 1e-9);
+}
+
+uint64_t FFixedTimestep::GetStepNanoseconds() const
+{
+	return StepNanoseconds;
+}
+
+float FFixedTimestep::GetInterpolationAlpha() const
+{
+	return static_cast<float>(static_cast<double>(Accumulator) / static_cast<double>(StepNanoseconds));
+}
+
+uint64_t FFixedTimestep::GetDroppedNanoseconds() const
+{
+	return DroppedNanoseconds;
+}
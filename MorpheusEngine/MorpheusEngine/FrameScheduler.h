@@ -0,0 +1,169 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Monotonic clock with nanosecond resolution.
+class FHighResolutionClock
+{
+public:
+	static uint64_t NowNanoseconds();
+};
+
+// Accumulates real time and hands it out in fixed simulation steps. The remainder is exposed as an
+// interpolation factor between the last two simulated states.
+class FFixedTimestep
+{
+public:
+	// Frames that would need more than maxStepsPerFrame steps drop the excess time instead of
+	// falling further and further behind.
+	FFixedTimestep(uint64_t stepNanoseconds, uint32_t maxStepsPerFrame);
+
+	// Adds elapsed time and returns the number of steps to simulate.
+	uint32_t Advance(uint64_t elapsedNanoseconds);
+
+	float GetStepSeconds() const;
+	uint64_t GetStepNanoseconds() const;
+
+	// Position in [0, 1) of the current time between the previous and the latest step.
+	float GetInterpolationAlpha() const;
+
+	uint64_t GetDroppedNanoseconds() const;
+
+private:
+	uint64_t StepNanoseconds;
+	uint32_t MaxStepsPerFrame;
+	uint64_t Accumulator;
+	uint64_t DroppedNanoseconds;
+};
+
+// Runs the render submission of frame N on its own thread while the calling thread simulates
+// frame N + 1. Each frame in flight owns one FrameDataType, so the simulation can run at most
+// framesInFlight - 1 frames ahead of the renderer; a limit of one serialises the two.
+template<typename FrameDataType>
+class TFramePipeline
+{
+public:
+	TFramePipeline(uint32_t framesInFlight, std::function<void(const FrameDataType&)> renderFunction)
+		: Frames(framesInFlight > 0 ? framesInFlight : 1)
+		, RenderFunction(std::move(renderFunction))
+		, NextWriteFrame(0)
+		, NextReadFrame(0)
+		, FramesQueued(0)
+		, FramesInFlight(0)
+		, Stopping(false)
+	{
+		RenderThread = std::thread(&TFramePipeline::RenderThreadMain, this);
+	}
+
+	~TFramePipeline()
+	{
+		Stop();
+	}
+
+	// Waits until a frame slot is free and returns it for the simulation to fill.
+	FrameDataType& BeginFrame()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		FrameRetired.wait(lock, [this]() { return FramesInFlight < Frames.size(); });
+
+		++FramesInFlight;
+
+		return Frames[NextWriteFrame];
+	}
+
+	// Hands the frame returned by BeginFrame() over to the render thread.
+	void EndFrame()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			NextWriteFrame = (NextWriteFrame + 1) % Frames.size();
+			++FramesQueued;
+		}
+
+		FrameQueued.notify_one();
+	}
+
+	// Blocks until every queued frame has been rendered.
+	void WaitForIdle()
+	{
+		std::unique_lock<std::mutex> lock(Mutex);
+		FrameRetired.wait(lock, [this]() { return FramesInFlight == 0; });
+	}
+
+	// Renders what is queued and joins the render thread.
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (!RenderThread.joinable())
+			{
+				return;
+			}
+
+			Stopping = true;
+		}
+
+		FrameQueued.notify_one();
+		RenderThread.join();
+	}
+
+	uint32_t GetFramesInFlightLimit() const
+	{
+		return static_cast<uint32_t>(Frames.size());
+	}
+
+private:
+	void RenderThreadMain()
+	{
+		SetProfilerThreadName("Render");
+
+		for (;;)
+		{
+			size_t frameIndex;
+
+			{
+				std::unique_lock<std::mutex> lock(Mutex);
+				FrameQueued.wait(lock, [this]() { return Stopping || FramesQueued > 0; });
+
+				if (FramesQueued == 0)
+				{
+					return;
+				}
+
+				frameIndex = NextReadFrame;
+			}
+
+			RenderFunction(Frames[frameIndex]);
+
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				NextReadFrame = (NextReadFrame + 1) % Frames.size();
+				--FramesQueued;
+				--FramesInFlight;
+			}
+
+			FrameRetired.notify_all();
+		}
+	}
+
+	std::vector<FrameDataType> Frames;
+	std::function<void(const FrameDataType&)> RenderFunction;
+
+	std::mutex Mutex;
+	std::condition_variable FrameQueued;
+	std::condition_variable FrameRetired;
+	size_t NextWriteFrame;
+	size_t NextReadFrame;
+	size_t FramesQueued;
+	size_t FramesInFlight;
+	bool Stopping;
+
+	std::thread RenderThread;
+};
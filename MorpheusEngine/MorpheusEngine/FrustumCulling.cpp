@@ -0,0 +1,279 @@
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "FrustumCullingKernels.h"
+
+#if MORPHEUS_CULLING_SSE
+#include <emmintrin.h>
+
+// Defined in FrustumCullingAVX2.cpp, which is compiled for AVX2 and FMA.
+uint32_t CullBoundsAVX2(const FBoundsStreams& bounds, uint32_t begin, uint32_t end, const FFrustum& frustum,
+	uint32_t* visibleIndices, uint32_t& visibleCount);
+#elif MORPHEUS_CULLING_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+#if MORPHEUS_CULLING_SSE
+	struct FCullVectorSSE
+	{
+		typedef __m128 FRegister;
+		typedef __m128 FMask;
+		static const uint32_t Width = 4;
+
+		static FRegister Load(const float* source) { return _mm_loadu_ps(source); }
+		static FRegister Set(float value) { return _mm_set1_ps(value); }
+		static FRegister Add(FRegister a, FRegister b) { return _mm_add_ps(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return _mm_mul_ps(a, b); }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static FRegister Min(FRegister a, FRegister b) { return _mm_min_ps(a, b); }
+		static FMask NoLanes() { return _mm_setzero_ps(); }
+		static FMask LessThanZero(FRegister a) { return _mm_cmplt_ps(a, _mm_setzero_ps()); }
+		static FMask Or(FMask a, FMask b) { return _mm_or_ps(a, b); }
+		static uint32_t InvertedBits(FMask mask) { return ~static_cast<uint32_t>(_mm_movemask_ps(mask)) & 0xf; }
+
+		static uint32_t AppendVisible(uint32_t visibleMask, uint32_t index, uint32_t* output)
+		{
+			return AppendVisibleLanes<Width>(visibleMask, index, output);
+		}
+	};
+#elif MORPHEUS_CULLING_NEON
+	struct FCullVectorNEON
+	{
+		typedef float32x4_t FRegister;
+		typedef uint32x4_t FMask;
+		static const uint32_t Width = 4;
+
+		static FRegister Load(const float* source) { return vld1q_f32(source); }
+		static FRegister Set(float value) { return vdupq_n_f32(value); }
+		static FRegister Add(FRegister a, FRegister b) { return vaddq_f32(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return vmulq_f32(a, b); }
+#if defined(__aarch64__) || defined(_M_ARM64)
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return vfmaq_f32(c, a, b); }
+#else
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return vmlaq_f32(c, a, b); }
+#endif
+		static FRegister Min(FRegister a, FRegister b) { return vminq_f32(a, b); }
+		static FMask NoLanes() { return vdupq_n_u32(0); }
+		static FMask LessThanZero(FRegister a) { return vcltq_f32(a, vdupq_n_f32(0.0f)); }
+		static FMask Or(FMask a, FMask b) { return vorrq_u32(a, b); }
+
+		static uint32_t InvertedBits(FMask mask)
+		{
+			uint32x4_t inside = vmvnq_u32(mask);
+
+			return (vgetq_lane_u32(inside, 0) & 1) | (vgetq_lane_u32(inside, 1) & 2) | (vgetq_lane_u32(inside, 2) & 4) | (vgetq_lane_u32(inside, 3) & 8);
+		}
+
+		static uint32_t AppendVisible(uint32_t visibleMask, uint32_t index, uint32_t* output)
+		{
+			return AppendVisibleLanes<Width>(visibleMask, index, output);
+		}
+	};
+#endif
+
+	FBoundsStreams GetStreams(const FBoundsSoA& bounds)
+	{
+		FBoundsStreams streams;
+		streams.CentreX = bounds.CentreX.data();
+		streams.CentreY = bounds.CentreY.data();
+		streams.CentreZ = bounds.CentreZ.data();
+		streams.ExtentX = bounds.ExtentX.data();
+		streams.ExtentY = bounds.ExtentY.data();
+		streams.ExtentZ = bounds.ExtentZ.data();
+		streams.Radius = bounds.Radius.data();
+
+		return streams;
+	}
+
+	FPlane NormalisePlane(float x, float y, float z, float w)
+	{
+		float length = std::sqrt(x * x + y * y + z * z);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+		return { x * scale, y * scale, z * scale, w * scale };
+	}
+}
+
+FFrustum FrustumFromViewProjection(const FFloat4x4& viewProjection)
+{
+	// With row vectors clip = p * M, so every clip coordinate is p dotted with a column of M.
+	const float(&m)[4][4] = viewProjection.M;
+
+	FFrustum frustum;
+	for (int plane = 0; plane < 6; ++plane)
+	{
+		// -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+		int axis = plane / 2;
+		float sign = (plane % 2 == 0) ? 1.0f : -1.0f;
+
+		float coefficients[4];
+		for (int row = 0; row < 4; ++row)
+		{
+			coefficients[row] = (plane == 4) ? m[row][2] : m[row][3] + sign * m[row][axis];
+		}
+
+		frustum.Planes[plane] = NormalisePlane(coefficients[0], coefficients[1], coefficients[2], coefficients[3]);
+	}
+
+	return frustum;
+}
+
+void FBoundsSoA::Resize(uint32_t count)
+{
+	CentreX.resize(count, 0.0f);
+	CentreY.resize(count, 0.0f);
+	CentreZ.resize(count, 0.0f);
+	ExtentX.resize(count, 0.0f);
+	ExtentY.resize(count, 0.0f);
+	ExtentZ.resize(count, 0.0f);
+	Radius.resize(count, 0.0f);
+}
+
+uint32_t FBoundsSoA::GetCount() const
+{
+	return static_cast<uint32_t>(CentreX.size());
+}
+
+void FBoundsSoA::SetBox(uint32_t index, const FFloat3& centre, const FFloat3& extents)
+{
+	assert(index < GetCount());
+
+	CentreX[index] = centre.X;
+	CentreY[index] = centre.Y;
+	CentreZ[index] = centre.Z;
+	ExtentX[index] = extents.X;
+	ExtentY[index] = extents.Y;
+	ExtentZ[index] = extents.Z;
+	Radius[index] = std::sqrt(extents.X * extents.X + extents.Y * extents.Y + extents.Z * extents.Z);
+}
+
+void FBoundsSoA::SetSphere(uint32_t index, const FFloat3& centre, float radius)
+{
+	assert(index < GetCount());
+
+	CentreX[index] = centre.X;
+	CentreY[index] = centre.Y;
+	CentreZ[index] = centre.Z;
+	ExtentX[index] = radius;
+	ExtentY[index] = radius;
+	ExtentZ[index] = radius;
+	Radius[index] = radius;
+}
+
+void FBoundsSoA::SetTransformedBox(uint32_t index, const FFloat4x4& world, const FFloat3& localCentre, const FFloat3& localExtents)
+{
+	const float(&m)[4][4] = world.M;
+
+	FFloat3 centre;
+	centre.X = localCentre.X * m[0][0] + localCentre.Y * m[1][0] + localCentre.Z * m[2][0] + m[3][0];
+	centre.Y = localCentre.X * m[0][1] + localCentre.Y * m[1][1] + localCentre.Z * m[2][1] + m[3][1];
+	centre.Z = localCentre.X * m[0][2] + localCentre.Y * m[1][2] + localCentre.Z * m[2][2] + m[3][2];
+
+	// Every world axis of the box is the sum of the absolute projections of the local axes.
+	FFloat3 extents;
+	extents.X = localExtents.X * std::fabs(m[0][0]) + localExtents.Y * std::fabs(m[1][0]) + localExtents.Z * std::fabs(m[2][0]);
+	extents.Y = localExtents.X * std::fabs(m[0][1]) + localExtents.Y * std::fabs(m[1][1]) + localExtents.Z * std::fabs(m[2][1]);
+	extents.Z = localExtents.X * std::fabs(m[0][2]) + localExtents.Y * std::fabs(m[1][2]) + localExtents.Z * std::fabs(m[2][2]);
+
+	SetBox(index, centre, extents);
+
+	// The sphere around the rotated local box is tighter than the one around the world box.
+	float scaleX = std::sqrt(m[0][0] * m[0][0] + m[0][1] * m[0][1] + m[0][2] * m[0][2]) * localExtents.X;
+	float scaleY = std::sqrt(m[1][0] * m[1][0] + m[1][1] * m[1][1] + m[1][2] * m[1][2]) * localExtents.Y;
+	float scaleZ = std::sqrt(m[2][0] * m[2][0] + m[2][1] * m[2][1] + m[2][2] * m[2][2]) * localExtents.Z;
+	Radius[index] = std::min(Radius[index], std::sqrt(scaleX * scaleX + scaleY * scaleY + scaleZ * scaleZ));
+}
+
+uint32_t CullBounds(const FBoundsSoA& bounds, uint32_t begin, uint32_t end, const FFrustum& frustum, uint32_t* visibleIndices)
+{
+	assert(begin <= end && end <= bounds.GetCount());
+
+	FBoundsStreams streams = GetStreams(bounds);
+	uint32_t visibleCount = 0;
+	uint32_t index = begin;
+
+	switch (GetMathBackend())
+	{
+#if MORPHEUS_CULLING_SSE
+	case EMathBackend::AVX2:
+		index = CullBoundsAVX2(streams, index, end, frustum, visibleIndices, visibleCount);
+		break;
+	case EMathBackend::SSE:
+		index = CullBoundsKernel<FCullVectorSSE>(streams, index, end, frustum, visibleIndices, visibleCount);
+		break;
+#elif MORPHEUS_CULLING_NEON
+	case EMathBackend::NEON:
+		index = CullBoundsKernel<FCullVectorNEON>(streams, index, end, frustum, visibleIndices, visibleCount);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	CullBoundsKernel<FCullVectorScalar>(streams, index, end, frustum, visibleIndices, visibleCount);
+
+	return visibleCount;
+}
+
+uint32_t FFrustumCuller::Cull(const FBoundsSoA& bounds, const FFrustum& frustum, std::vector<uint32_t>& visibleIndices, FJobSystem* jobSystem)
+{
+	const uint32_t count = bounds.GetCount();
+	const uint32_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+
+	// A single chunk goes straight into the output.
+	if (!jobSystem || chunkCount <= 1)
+	{
+		visibleIndices.resize(count + CullOutputPadding);
+		visibleIndices.resize(CullBounds(bounds, 0, count, frustum, visibleIndices.data()));
+
+		return static_cast<uint32_t>(visibleIndices.size());
+	}
+
+	// Every chunk fills its own slice of the scratch list, padded for the SIMD stores.
+	const uint32_t chunkStride = ChunkSize + CullOutputPadding;
+	ChunkIndices.resize(static_cast<size_t>(chunkCount) * chunkStride);
+	ChunkCounts.resize(chunkCount);
+	ChunkOffsets.resize(chunkCount);
+
+	jobSystem->ParallelFor(chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk)
+	{
+		for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+		{
+			uint32_t begin = chunk * ChunkSize;
+			uint32_t end = std::min(begin + ChunkSize, count);
+			ChunkCounts[chunk] = CullBounds(bounds, begin, end, frustum, &ChunkIndices[static_cast<size_t>(chunk) * chunkStride]);
+		}
+	});
+
+	uint32_t visibleCount = 0;
+	for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		ChunkOffsets[chunk] = visibleCount;
+		visibleCount += ChunkCounts[chunk];
+	}
+
+	visibleIndices.resize(visibleCount);
+	if (visibleCount == 0)
+	{
+		return 0;
+	}
+
+	// The compaction is a copy per chunk, also in parallel.
+	uint32_t* output = visibleIndices.data();
+	jobSystem->ParallelFor(chunkCount, 4, [&](uint32_t firstChunk, uint32_t lastChunk)
+	{
+		for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+		{
+			std::memcpy(output + ChunkOffsets[chunk], &ChunkIndices[static_cast<size_t>(chunk) * chunkStride], sizeof(uint32_t) * ChunkCounts[chunk]);
+		}
+	});
+
+	return visibleCount;
+}
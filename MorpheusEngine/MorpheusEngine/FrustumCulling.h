@@ -0,0 +1,80 @@
+#pragma once
+
+#include "TransformMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class FJobSystem;
+
+// Plane with a unit normal, a point p is on the inner side when dot(normal, p) + W >= 0.
+struct FPlane
+{
+	float X;
+	float Y;
+	float Z;
+	float W;
+};
+
+// The six planes of a view frustum, normals pointing inwards: left, right, bottom, top, near, far.
+struct FFrustum
+{
+	FPlane Planes[6];
+};
+
+// Extracts the planes of a row vector view * projection matrix with a [0, 1] depth range, as built by
+// XMMatrixPerspectiveFovLH. Planes of a projection alone are in view space, of view * projection in
+// world space.
+FFrustum FrustumFromViewProjection(const FFloat4x4& viewProjection);
+
+// World space bounding volumes as structure of arrays. Every object has an axis aligned box and a
+// sphere around the same centre; an object is culled when either of them is outside a plane, so
+// the culling is as tight as the better fitting of the two.
+struct FBoundsSoA
+{
+	std::vector<float> CentreX;
+	std::vector<float> CentreY;
+	std::vector<float> CentreZ;
+	// Half sizes of the box.
+	std::vector<float> ExtentX;
+	std::vector<float> ExtentY;
+	std::vector<float> ExtentZ;
+	std::vector<float> Radius;
+
+	// New entries are points at the origin.
+	void Resize(uint32_t count);
+	uint32_t GetCount() const;
+
+	// The sphere is the one around the box.
+	void SetBox(uint32_t index, const FFloat3& centre, const FFloat3& extents);
+	// The box is the one around the sphere.
+	void SetSphere(uint32_t index, const FFloat3& centre, float radius);
+	// Bounds of a local box moved by a row vector world matrix.
+	void SetTransformedBox(uint32_t index, const FFloat4x4& world, const FFloat3& localCentre, const FFloat3& localExtents);
+};
+
+// Slots the kernels may write past the last visible index, one SIMD register of indices.
+const uint32_t CullOutputPadding = 8;
+
+// Writes the index of every object in [begin, end) that is at least partly inside the frustum to
+// visibleIndices, in increasing order, and returns how many there are. visibleIndices needs room for
+// end - begin + CullOutputPadding indices. Uses the backend of GetMathBackend(), 8 objects per
+// iteration with AVX2.
+uint32_t CullBounds(const FBoundsSoA& bounds, uint32_t begin, uint32_t end, const FFrustum& frustum, uint32_t* visibleIndices);
+
+// Culls large bound arrays in parallel chunks and compacts the chunk results into one ordered list.
+// Scratch memory is kept between calls. Not thread safe.
+class FFrustumCuller
+{
+public:
+	// Replaces visibleIndices with the sorted indices of the visible objects and returns their count.
+	uint32_t Cull(const FBoundsSoA& bounds, const FFrustum& frustum, std::vector<uint32_t>& visibleIndices, FJobSystem* jobSystem = nullptr);
+
+private:
+	// Objects per job, a multiple of every SIMD width.
+	static const uint32_t ChunkSize = 16384;
+
+	std::vector<uint32_t> ChunkIndices;
+	std::vector<uint32_t> ChunkCounts;
+	std::vector<uint32_t> ChunkOffsets;
+};
@@ -0,0 +1,95 @@
+#include "FrustumCulling.h"
+
+#include <immintrin.h>
+
+// Everything defined below is compiled for AVX2 and FMA. Only FrustumCulling.cpp calls into this unit,
+// and only after checking that the CPU supports both.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "FrustumCullingKernels.h"
+
+#if MORPHEUS_CULLING_SSE
+
+namespace
+{
+	// For every 8 bit mask, the indices of its set bits followed by zeros, and how many there are.
+	struct FCompactTable
+	{
+		uint8_t Lanes[256][8];
+		uint8_t Counts[256];
+	};
+
+	constexpr FCompactTable MakeCompactTable()
+	{
+		FCompactTable table = {};
+
+		for (uint32_t mask = 0; mask < 256; ++mask)
+		{
+			uint8_t count = 0;
+			for (uint8_t lane = 0; lane < 8; ++lane)
+			{
+				if (mask & (1u << lane))
+				{
+					table.Lanes[mask][count++] = lane;
+				}
+			}
+
+			table.Counts[mask] = count;
+		}
+
+		return table;
+	}
+
+	constexpr FCompactTable CompactTable = MakeCompactTable();
+
+	struct FCullVectorAVX2
+	{
+		typedef __m256 FRegister;
+		typedef __m256 FMask;
+		static const uint32_t Width = 8;
+
+		static FRegister Load(const float* source) { return _mm256_loadu_ps(source); }
+		static FRegister Set(float value) { return _mm256_set1_ps(value); }
+		static FRegister Add(FRegister a, FRegister b) { return _mm256_add_ps(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return _mm256_mul_ps(a, b); }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return _mm256_fmadd_ps(a, b, c); }
+		static FRegister Min(FRegister a, FRegister b) { return _mm256_min_ps(a, b); }
+		static FMask NoLanes() { return _mm256_setzero_ps(); }
+		static FMask LessThanZero(FRegister a) { return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ); }
+		static FMask Or(FMask a, FMask b) { return _mm256_or_ps(a, b); }
+		static uint32_t InvertedBits(FMask mask) { return ~static_cast<uint32_t>(_mm256_movemask_ps(mask)) & 0xff; }
+
+		// Packs the visible lanes to the front with one permutation and stores all eight.
+		static uint32_t AppendVisible(uint32_t visibleMask, uint32_t index, uint32_t* output)
+		{
+			__m256i lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(CompactTable.Lanes[visibleMask])));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(output), _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(index))));
+
+			return CompactTable.Counts[visibleMask];
+		}
+	};
+}
+
+uint32_t CullBoundsAVX2(const FBoundsStreams& bounds, uint32_t begin, uint32_t end, const FFrustum& frustum,
+	uint32_t* visibleIndices, uint32_t& visibleCount)
+{
+	uint32_t index = CullBoundsKernel<FCullVectorAVX2>(bounds, begin, end, frustum, visibleIndices, visibleCount);
+
+	// The callers continue with SSE or scalar code.
+	_mm256_zeroupper();
+
+	return index;
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,128 @@
+#pragma once
+
+// Private to the FrustumCulling translation units, with the same rules as TransformMathKernels.h:
+// included after the target pragmas of the unit, pulling in no other header. FrustumCulling.h has to
+// be included first.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MORPHEUS_CULLING_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64) || defined(_M_ARM)
+#define MORPHEUS_CULLING_NEON 1
+#endif
+
+// Raw streams of an FBoundsSoA.
+struct FBoundsStreams
+{
+	const float* CentreX;
+	const float* CentreY;
+	const float* CentreZ;
+	const float* ExtentX;
+	const float* ExtentY;
+	const float* ExtentZ;
+	const float* Radius;
+};
+
+namespace
+{
+	// One object per register, used for the tails and as the reference result.
+	struct FCullVectorScalar
+	{
+		typedef float FRegister;
+		typedef bool FMask;
+		static const uint32_t Width = 1;
+
+		static FRegister Load(const float* source) { return *source; }
+		static FRegister Set(float value) { return value; }
+		static FRegister Add(FRegister a, FRegister b) { return a + b; }
+		static FRegister Multiply(FRegister a, FRegister b) { return a * b; }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return a * b + c; }
+		static FRegister Min(FRegister a, FRegister b) { return a < b ? a : b; }
+		static FMask NoLanes() { return false; }
+		static FMask LessThanZero(FRegister a) { return a < 0.0f; }
+		static FMask Or(FMask a, FMask b) { return a || b; }
+		static uint32_t InvertedBits(FMask mask) { return mask ? 0u : 1u; }
+
+		static uint32_t AppendVisible(uint32_t visibleMask, uint32_t index, uint32_t* output)
+		{
+			*output = index;
+
+			return visibleMask;
+		}
+	};
+
+	// Writes the lanes set in visibleMask without branches. Every lane is stored, so up to Width slots
+	// past the returned count are overwritten.
+	template<uint32_t Width>
+	uint32_t AppendVisibleLanes(uint32_t visibleMask, uint32_t index, uint32_t* output)
+	{
+		uint32_t count = 0;
+		for (uint32_t lane = 0; lane < Width; ++lane)
+		{
+			output[count] = index + lane;
+			count += (visibleMask >> lane) & 1;
+		}
+
+		return count;
+	}
+
+	// Tests Width objects per iteration, starting at begin, and returns the first index it did not test.
+	// An object is outside when its box or its sphere is fully behind one plane:
+	// dot(normal, centre) + w < -min(radius, dot(|normal|, extents)).
+	template<typename TVector>
+	uint32_t CullBoundsKernel(const FBoundsStreams& bounds, uint32_t begin, uint32_t end, const FFrustum& frustum,
+		uint32_t* visibleIndices, uint32_t& visibleCount)
+	{
+		typedef typename TVector::FRegister FRegister;
+		typedef typename TVector::FMask FMask;
+
+		FRegister normalX[6];
+		FRegister normalY[6];
+		FRegister normalZ[6];
+		FRegister distance[6];
+		FRegister absoluteX[6];
+		FRegister absoluteY[6];
+		FRegister absoluteZ[6];
+
+		for (int plane = 0; plane < 6; ++plane)
+		{
+			const FPlane& source = frustum.Planes[plane];
+			normalX[plane] = TVector::Set(source.X);
+			normalY[plane] = TVector::Set(source.Y);
+			normalZ[plane] = TVector::Set(source.Z);
+			distance[plane] = TVector::Set(source.W);
+			absoluteX[plane] = TVector::Set(source.X < 0.0f ? -source.X : source.X);
+			absoluteY[plane] = TVector::Set(source.Y < 0.0f ? -source.Y : source.Y);
+			absoluteZ[plane] = TVector::Set(source.Z < 0.0f ? -source.Z : source.Z);
+		}
+
+		uint32_t count = visibleCount;
+		uint32_t index = begin;
+		for (; index + TVector::Width <= end; index += TVector::Width)
+		{
+			FRegister centreX = TVector::Load(bounds.CentreX + index);
+			FRegister centreY = TVector::Load(bounds.CentreY + index);
+			FRegister centreZ = TVector::Load(bounds.CentreZ + index);
+			FRegister extentX = TVector::Load(bounds.ExtentX + index);
+			FRegister extentY = TVector::Load(bounds.ExtentY + index);
+			FRegister extentZ = TVector::Load(bounds.ExtentZ + index);
+			FRegister radius = TVector::Load(bounds.Radius + index);
+
+			FMask outside = TVector::NoLanes();
+			for (int plane = 0; plane < 6; ++plane)
+			{
+				FRegister centreDistance = TVector::MultiplyAdd(normalZ[plane], centreZ,
+					TVector::MultiplyAdd(normalY[plane], centreY, TVector::MultiplyAdd(normalX[plane], centreX, distance[plane])));
+				FRegister boxRadius = TVector::MultiplyAdd(absoluteZ[plane], extentZ,
+					TVector::MultiplyAdd(absoluteY[plane], extentY, TVector::Multiply(absoluteX[plane], extentX)));
+
+				outside = TVector::Or(outside, TVector::LessThanZero(TVector::Add(centreDistance, TVector::Min(radius, boxRadius))));
+			}
+
+			count += TVector::AppendVisible(TVector::InvertedBits(outside), index, visibleIndices + count);
+		}
+
+		visibleCount = count;
+
+		return index;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 bit FNV-1a. Strings are written with their length, so no two sequences of fields hash the same
+// bytes. Floats go in through Add(data, size), by their bits.
+class FHasher
+{
+public:
+	void Add(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			Hash = (Hash ^ bytes[i]) * 1099511628211ull;
+		}
+	}
+
+	void Add(uint64_t value)
+	{
+		Add(&value, sizeof(value));
+	}
+
+	void Add(const std::string& text)
+	{
+		Add(uint64_t(text.size()));
+		Add(text.data(), text.size());
+	}
+
+	uint64_t Get() const
+	{
+		return Hash;
+	}
+
+private:
+	uint64_t Hash = 14695981039346656037ull;
+};
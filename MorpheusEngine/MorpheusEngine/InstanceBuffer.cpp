@@ -0,0 +1,153 @@
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MORPHEUS_INSTANCE_BUFFER_SSE 1
+#include <xmmintrin.h>
+#else
+#define MORPHEUS_INSTANCE_BUFFER_SSE 0
+#endif
+
+void PackInstanceTransforms(const FFloat4x4* worldMatrices, uint32_t count, FInstanceTransform* instances)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const FFloat4x4& world = worldMatrices[i];
+		FInstanceTransform& instance = instances[i];
+
+#if MORPHEUS_INSTANCE_BUFFER_SSE
+		__m128 row0 = _mm_loadu_ps(world.M[0]);
+		__m128 row1 = _mm_loadu_ps(world.M[1]);
+		__m128 row2 = _mm_loadu_ps(world.M[2]);
+		__m128 row3 = _mm_loadu_ps(world.M[3]);
+		_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+		// The destination is usually write-combined memory, so every byte is written once and in order.
+		_mm_storeu_ps(instance.Columns[0], row0);
+		_mm_storeu_ps(instance.Columns[1], row1);
+		_mm_storeu_ps(instance.Columns[2], row2);
+#else
+		for (int column = 0; column < 3; ++column)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				instance.Columns[column][row] = world.M[row][column];
+			}
+		}
+#endif
+	}
+}
+
+void FInstanceBuffer::GetInputElements(uint32_t inputSlot, FInputElementDesc elements[InputElementCount])
+{
+	for (uint32_t column = 0; column < InputElementCount; ++column)
+	{
+		elements[column].SemanticName = "WORLD";
+		elements[column].SemanticIndex = column;
+		elements[column].Format = EVertexFormat::Float4;
+		elements[column].InputSlot = inputSlot;
+		elements[column].AlignedByteOffset = column * sizeof(float) * 4;
+		elements[column].Classification = EInputClassification::PerInstance;
+		elements[column].InstanceDataStepRate = 1;
+	}
+}
+
+FInstanceBuffer::FInstanceBuffer(IRenderDevice* renderDevice, uint32_t capacity)
+	: RenderDevice(renderDevice)
+	, Capacity(capacity)
+	, InstanceCount(0)
+{
+	assert(RenderDevice && capacity > 0);
+
+	FBufferDesc description;
+	description.Binding = EBufferBinding::Vertex;
+	description.Usage = EResourceUsage::Dynamic;
+	description.ByteWidth = capacity * sizeof(FInstanceTransform);
+
+	Buffer = RenderDevice->CreateBuffer(description, nullptr);
+}
+
+FInstanceBuffer::~FInstanceBuffer()
+{
+	if (Buffer.IsValid())
+	{
+		RenderDevice->DestroyBuffer(Buffer);
+	}
+}
+
+bool FInstanceBuffer::IsValid() const
+{
+	return Buffer.IsValid();
+}
+
+FBufferHandle FInstanceBuffer::GetBuffer() const
+{
+	return Buffer;
+}
+
+uint32_t FInstanceBuffer::GetCapacity() const
+{
+	return Capacity;
+}
+
+uint32_t FInstanceBuffer::GetInstanceCount() const
+{
+	return InstanceCount;
+}
+
+uint32_t FInstanceBuffer::Upload(const FFloat4x4* worldMatrices, uint32_t count, FJobSystem* jobSystem)
+{
+	InstanceCount = 0;
+
+	count = std::min(count, Capacity);
+	if (count == 0 || !Buffer.IsValid())
+	{
+		return 0;
+	}
+
+	FInstanceTransform* instances = static_cast<FInstanceTransform*>(RenderDevice->MapBuffer(Buffer, EMapMode::WriteDiscard));
+	if (!instances)
+	{
+		return 0;
+	}
+
+	if (jobSystem && count >= 2 * UploadBatchSize)
+	{
+		jobSystem->ParallelFor(count, UploadBatchSize, [worldMatrices, instances](uint32_t begin, uint32_t end)
+		{
+			PackInstanceTransforms(worldMatrices + begin, end - begin, instances + begin);
+		});
+	}
+	else
+	{
+		PackInstanceTransforms(worldMatrices, count, instances);
+	}
+
+	RenderDevice->UnmapBuffer(Buffer);
+
+	InstanceCount = count;
+
+	return count;
+}
+
+void FInstanceBuffer::Bind(uint32_t inputSlot)
+{
+	RenderDevice->SetVertexBuffer(inputSlot, Buffer, sizeof(FInstanceTransform), 0);
+}
+
+void FInstanceBuffer::Draw(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex, uint32_t firstInstance, uint32_t instanceCount)
+{
+	if (firstInstance >= InstanceCount)
+	{
+		return;
+	}
+
+	instanceCount = std::min(instanceCount, InstanceCount - firstInstance);
+	if (instanceCount > 0)
+	{
+		RenderDevice->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, firstInstance);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "TransformMath.h"
+
+#include <cstdint>
+
+class FJobSystem;
+
+// Per-instance transform as InstancedVertexShader.hlsl reads it: the first three columns of a row
+// vector world matrix. The last column of an affine transform is always (0, 0, 0, 1), so an instance
+// takes 48 bytes instead of 64.
+struct FInstanceTransform
+{
+	float Columns[3][4];
+};
+
+static_assert(sizeof(FInstanceTransform) == 48, "The instance stream stride is fixed by the input layout.");
+
+// Writes count world matrices as instance transforms.
+void PackInstanceTransforms(const FFloat4x4* worldMatrices, uint32_t count, FInstanceTransform* instances);
+
+// Dynamic vertex buffer holding one FInstanceTransform per instance, so that many copies of a mesh
+// are drawn with one DrawIndexedInstanced() instead of one constant buffer update and draw each.
+//
+// Typical frame: Upload() the world matrices of every instance, Bind() the stream next to the mesh
+// vertices and Draw() the mesh once per group of instances. Not thread safe.
+class FInstanceBuffer
+{
+public:
+	static const uint32_t InputElementCount = 3;
+
+	// Describes the stream as WORLD0 to WORLD2 in the given slot, stepping once per instance.
+	static void GetInputElements(uint32_t inputSlot, FInputElementDesc elements[InputElementCount]);
+
+	FInstanceBuffer(IRenderDevice* renderDevice, uint32_t capacity);
+	~FInstanceBuffer();
+
+	FInstanceBuffer(const FInstanceBuffer&) = delete;
+	FInstanceBuffer& operator=(const FInstanceBuffer&) = delete;
+
+	bool IsValid() const;
+	FBufferHandle GetBuffer() const;
+	uint32_t GetCapacity() const;
+	// Instances written by the last Upload().
+	uint32_t GetInstanceCount() const;
+
+	// Maps the buffer once with discard and packs the world matrices straight into it, split across the
+	// job system when one is given. Matrices beyond the capacity are dropped. Returns the number of
+	// instances written.
+	uint32_t Upload(const FFloat4x4* worldMatrices, uint32_t count, FJobSystem* jobSystem = nullptr);
+
+	void Bind(uint32_t inputSlot);
+	// Draws instanceCount of the uploaded instances, starting at firstInstance, with the bound mesh.
+	void Draw(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex, uint32_t firstInstance, uint32_t instanceCount);
+
+private:
+	// Instances packed by one job, 48 KB of output.
+	static const uint32_t UploadBatchSize = 1024;
+
+	IRenderDevice* RenderDevice;
+	FBufferHandle Buffer;
+	uint32_t Capacity;
+	uint32_t InstanceCount;
+};
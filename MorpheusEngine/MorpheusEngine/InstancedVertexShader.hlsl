@@ -0,0 +1,47 @@
+cbuffer PerApplication : register(b0)
+{
+	matrix projectionMatrix;
+}
+
+cbuffer PerFrame : register(b1)
+{
+	matrix viewMatrix;
+}
+
+// Same layout as in SimpleVertexShader.hlsl. The world matrix comes with every instance instead.
+cbuffer PerObject : register(b2)
+{
+	matrix worldMatrix;
+	float4 positionScale;
+	float4 positionOffset;
+}
+
+#include "VertexInput.hlsli"
+
+struct InstanceData
+{
+	// The first three columns of the world matrix, one per instance. The last column is always (0, 0, 0, 1).
+	float4 world0 : WORLD0;
+	float4 world1 : WORLD1;
+	float4 world2 : WORLD2;
+};
+
+struct VertexShaderOutput
+{
+	float4 color : COLOR;
+	float4 position : SV_POSITION;
+};
+
+VertexShaderOutput main(VertexInput InData, InstanceData InInstance)
+{
+	VertexShaderOutput outData;
+	DecodedVertex vertex = DecodeVertex(InData);
+
+	float4 position = float4(vertex.position, 1.0f);
+	float4 worldPosition = float4(dot(InInstance.world0, position), dot(InInstance.world1, position), dot(InInstance.world2, position), 1.0f);
+
+	outData.position = mul(projectionMatrix, mul(viewMatrix, worldPosition));
+	outData.color = vertex.color;
+
+	return outData;
+}
@@ -0,0 +1,622 @@
+#include "JobSystem.h"
+
+#include "MemoryArena.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+namespace
+{
+	// Chase-Lev deque with a fixed capacity. Only the owning worker pushes and pops at the bottom,
+	// any thread may steal from the top. Slots are atomics so a thief that loses the race for the
+	// top reads a stale job instead of a torn one.
+	class FJobQueue
+	{
+	public:
+		static const int64_t Capacity = 4096;
+
+		struct FSlot
+		{
+			std::atomic<FJobFunction> Function;
+			std::atomic<void*> UserData;
+			std::atomic<uint32_t> Begin;
+			std::atomic<uint32_t> End;
+			std::atomic<void*> Counter;
+		};
+
+		FJobQueue()
+			: Top(0)
+			, Bottom(0)
+			, Slots(new FSlot[Capacity])
+		{
+		}
+
+		// Returns false when the deque is full.
+		bool Push(const FJobDeclaration& declaration, void* counter)
+		{
+			int64_t bottom = Bottom.load(std::memory_order_relaxed);
+			int64_t top = Top.load(std::memory_order_acquire);
+			if (bottom - top >= Capacity)
+			{
+				return false;
+			}
+
+			FSlot& slot = Slots[bottom & (Capacity - 1)];
+			slot.Function.store(declaration.Function, std::memory_order_relaxed);
+			slot.UserData.store(declaration.UserData, std::memory_order_relaxed);
+			slot.Begin.store(declaration.Begin, std::memory_order_relaxed);
+			slot.End.store(declaration.End, std::memory_order_relaxed);
+			slot.Counter.store(counter, std::memory_order_relaxed);
+
+			Bottom.store(bottom + 1, std::memory_order_seq_cst);
+
+			return true;
+		}
+
+		bool Pop(FJobDeclaration& declaration, void*& counter)
+		{
+			int64_t bottom = Bottom.load(std::memory_order_relaxed) - 1;
+			Bottom.store(bottom, std::memory_order_seq_cst);
+			int64_t top = Top.load(std::memory_order_seq_cst);
+
+			if (top > bottom)
+			{
+				Bottom.store(bottom + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			Load(bottom, declaration, counter);
+
+			if (top == bottom)
+			{
+				// Last job, race the thieves for it.
+				bool won = Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				Bottom.store(bottom + 1, std::memory_order_relaxed);
+
+				return won;
+			}
+
+			return true;
+		}
+
+		bool Steal(FJobDeclaration& declaration, void*& counter)
+		{
+			int64_t top = Top.load(std::memory_order_seq_cst);
+			int64_t bottom = Bottom.load(std::memory_order_seq_cst);
+
+			if (top >= bottom)
+			{
+				return false;
+			}
+
+			Load(top, declaration, counter);
+
+			return Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+		bool IsEmpty() const
+		{
+			return Bottom.load(std::memory_order_seq_cst) <= Top.load(std::memory_order_seq_cst);
+		}
+
+	private:
+		void Load(int64_t index, FJobDeclaration& declaration, void*& counter) const
+		{
+			const FSlot& slot = Slots[index & (Capacity - 1)];
+			declaration.Function = slot.Function.load(std::memory_order_relaxed);
+			declaration.UserData = slot.UserData.load(std::memory_order_relaxed);
+			declaration.Begin = slot.Begin.load(std::memory_order_relaxed);
+			declaration.End = slot.End.load(std::memory_order_relaxed);
+			counter = slot.Counter.load(std::memory_order_relaxed);
+		}
+
+		alignas(64) std::atomic<int64_t> Top;
+		alignas(64) std::atomic<int64_t> Bottom;
+		alignas(64) std::unique_ptr<FSlot[]> Slots;
+	};
+
+	// Iterations an idle worker keeps looking for work before it goes to sleep.
+	const uint32_t IdleSpinCount = 64;
+
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		return state;
+	}
+}
+
+struct alignas(64) FJobSystem::FWorker
+{
+	FJobQueue Queue;
+	FJobSystem* System = nullptr;
+	uint32_t Index = 0;
+	uint32_t RandomState = 0;
+	std::atomic<uint64_t> JobsExecuted{ 0 };
+	std::atomic<uint64_t> JobsStolen{ 0 };
+	std::thread Thread;
+};
+
+struct FJobSystem::FParallelForContext
+{
+	FJobSystem* System;
+	FJobFunction Function;
+	void* UserData;
+	uint32_t BatchSize;
+	FJobCounter* Counter;
+};
+
+thread_local FJobSystem::FWorker* FJobSystem::CurrentWorker = nullptr;
+
+namespace
+{
+	thread_local uint32_t externalRandomState = 0x9E3779B9u;
+}
+
+FJobCounter::FJobCounter()
+	: Value(0)
+{
+}
+
+FJobCounter::~FJobCounter()
+{
+	// The job that released the counter may still hold the lock.
+	std::lock_guard<std::mutex> lock(ContinuationMutex);
+	assert(Value.load() == 0 && "Job counter destroyed while jobs are still running");
+}
+
+bool FJobCounter::IsDone() const
+{
+	return Value.load(std::memory_order_acquire) == 0;
+}
+
+uint32_t FJobCounter::GetValue() const
+{
+	return Value.load(std::memory_order_acquire);
+}
+
+FJobSystem::FJobSystem(uint32_t concurrency)
+	: InjectionHead(0)
+	, InjectedJobs(0)
+	, SleepingWorkers(0)
+	, ShuttingDown(false)
+	, ExternalJobsExecuted(0)
+	, ExternalJobsStolen(0)
+{
+	if (concurrency == 0)
+	{
+		concurrency = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (uint32_t i = 1; i < concurrency; ++i)
+	{
+		std::unique_ptr<FWorker> worker(new FWorker());
+		worker->System = this;
+		worker->Index = i;
+		worker->RandomState = 0x9E3779B9u * i;
+		Workers.push_back(std::move(worker));
+	}
+
+	// Start the threads once every deque exists, they steal from each other straight away.
+	for (std::unique_ptr<FWorker>& worker : Workers)
+	{
+		worker->Thread = std::thread(&FJobSystem::WorkerMain, this, worker.get());
+	}
+}
+
+FJobSystem::~FJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(SleepMutex);
+		ShuttingDown = true;
+	}
+
+	WorkAvailable.notify_all();
+
+	for (std::unique_ptr<FWorker>& worker : Workers)
+	{
+		worker->Thread.join();
+	}
+
+	assert(!HasQueuedJobs() && "Job system destroyed with queued jobs");
+}
+
+void FJobSystem::Run(const FJobDeclaration* jobs, uint32_t jobCount, FJobCounter* counter)
+{
+	if (jobCount == 0)
+	{
+		return;
+	}
+
+	if (counter)
+	{
+		counter->Value.fetch_add(jobCount, std::memory_order_relaxed);
+	}
+
+	for (uint32_t i = 0; i < jobCount; ++i)
+	{
+		Push({ jobs[i], counter });
+	}
+
+	WakeWorkers(jobCount);
+}
+
+void FJobSystem::Run(const FJobDeclaration& job, FJobCounter* counter)
+{
+	Run(&job, 1, counter);
+}
+
+void FJobSystem::RunAfter(FJobCounter& dependency, const FJobDeclaration* jobs, uint32_t jobCount, FJobCounter* counter)
+{
+	if (jobCount == 0)
+	{
+		return;
+	}
+
+	if (counter)
+	{
+		counter->Value.fetch_add(jobCount, std::memory_order_relaxed);
+	}
+
+	{
+		// The last job of the dependency drains the continuations under this lock, so either it
+		// sees the new entries or they are pushed here.
+		std::lock_guard<std::mutex> lock(dependency.ContinuationMutex);
+		if (dependency.Value.load(std::memory_order_acquire) != 0)
+		{
+			for (uint32_t i = 0; i < jobCount; ++i)
+			{
+				dependency.Continuations.push_back({ jobs[i], counter });
+			}
+
+			return;
+		}
+	}
+
+	for (uint32_t i = 0; i < jobCount; ++i)
+	{
+		Push({ jobs[i], counter });
+	}
+
+	WakeWorkers(jobCount);
+}
+
+void FJobSystem::Wait(FJobCounter& counter)
+{
+	FWorker* localWorker = GetLocalWorker();
+
+	while (!counter.IsDone())
+	{
+		FJob job;
+		if (FindJob(localWorker, job))
+		{
+			Execute(localWorker, job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void FJobSystem::ParallelFor(uint32_t count, uint32_t batchSize, FJobFunction function, void* userData)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (batchSize == 0)
+	{
+		// Aim for several batches per thread so stealing can even out uneven items.
+		batchSize = std::max(1u, count / (GetConcurrency() * 8));
+	}
+
+	if (Workers.empty() || count <= batchSize)
+	{
+		function(userData, 0, count);
+		return;
+	}
+
+	FJobCounter counter;
+	FParallelForContext context = { this, function, userData, batchSize, &counter };
+
+	FJobDeclaration job;
+	job.Function = &FJobSystem::ParallelForJob;
+	job.UserData = &context;
+	job.Begin = 0;
+	job.End = count;
+
+	// Execute the root range here and leave the halves it splits off to the workers.
+	counter.Value.fetch_add(1, std::memory_order_relaxed);
+	Execute(GetLocalWorker(), { job, &counter });
+
+	Wait(counter);
+}
+
+void FJobSystem::ParallelForJob(void* userData, uint32_t begin, uint32_t end)
+{
+	const FParallelForContext& context = *static_cast<const FParallelForContext*>(userData);
+
+	while (end - begin > context.BatchSize)
+	{
+		uint32_t middle = begin + (end - begin) / 2;
+
+		FJobDeclaration upperHalf;
+		upperHalf.Function = &FJobSystem::ParallelForJob;
+		upperHalf.UserData = userData;
+		upperHalf.Begin = middle;
+		upperHalf.End = end;
+		context.System->Run(upperHalf, context.Counter);
+
+		end = middle;
+	}
+
+	context.Function(context.UserData, begin, end);
+}
+
+uint32_t FJobSystem::GetWorkerThreadCount() const
+{
+	return static_cast<uint32_t>(Workers.size());
+}
+
+uint32_t FJobSystem::GetConcurrency() const
+{
+	return static_cast<uint32_t>(Workers.size()) + 1;
+}
+
+uint32_t FJobSystem::GetCurrentWorkerIndex() const
+{
+	FWorker* worker = GetLocalWorker();
+
+	return worker ? worker->Index : 0;
+}
+
+FJobSystemStats FJobSystem::GetStats() const
+{
+	FJobSystemStats stats;
+	stats.JobsExecuted = ExternalJobsExecuted.load(std::memory_order_relaxed);
+	stats.JobsStolen = ExternalJobsStolen.load(std::memory_order_relaxed);
+
+	for (const std::unique_ptr<FWorker>& worker : Workers)
+	{
+		stats.JobsExecuted += worker->JobsExecuted.load(std::memory_order_relaxed);
+		stats.JobsStolen += worker->JobsStolen.load(std::memory_order_relaxed);
+	}
+
+	return stats;
+}
+
+void FJobSystem::ResetStats()
+{
+	ExternalJobsExecuted.store(0, std::memory_order_relaxed);
+	ExternalJobsStolen.store(0, std::memory_order_relaxed);
+
+	for (std::unique_ptr<FWorker>& worker : Workers)
+	{
+		worker->JobsExecuted.store(0, std::memory_order_relaxed);
+		worker->JobsStolen.store(0, std::memory_order_relaxed);
+	}
+}
+
+void FJobSystem::WorkerMain(FWorker* worker)
+{
+	CurrentWorker = worker;
+	// Takes the first block of the scratch arena now rather than in the first job that needs it.
+	GetScratchArena();
+	SetProfilerThreadName(("Worker " + std::to_string(worker->Index)).c_str());
+
+	uint32_t idleIterations = 0;
+
+	for (;;)
+	{
+		FJob job;
+		if (FindJob(worker, job))
+		{
+			Execute(worker, job);
+			idleIterations = 0;
+			continue;
+		}
+
+		if (++idleIterations < IdleSpinCount)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(SleepMutex);
+		if (ShuttingDown)
+		{
+			break;
+		}
+
+		// Announce the sleep before looking at the queues one last time. Push() publishes a job
+		// before it checks for sleepers, so one of the two always sees the other.
+		SleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+		if (!HasQueuedJobs())
+		{
+			WorkAvailable.wait(lock);
+		}
+		SleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+
+		idleIterations = 0;
+	}
+
+	CurrentWorker = nullptr;
+}
+
+FJobSystem::FWorker* FJobSystem::GetLocalWorker() const
+{
+	return (CurrentWorker && CurrentWorker->System == this) ? CurrentWorker : nullptr;
+}
+
+void FJobSystem::Push(const FJob& job)
+{
+	FWorker* localWorker = GetLocalWorker();
+
+	if (localWorker)
+	{
+		if (!localWorker->Queue.Push(job.Declaration, job.Counter))
+		{
+			// The deque is full, run the job right away rather than growing it.
+			Execute(localWorker, job);
+		}
+
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(InjectionMutex);
+
+	if (InjectionHead > 0 && InjectionHead * 2 >= InjectionQueue.size())
+	{
+		InjectionQueue.erase(InjectionQueue.begin(), InjectionQueue.begin() + InjectionHead);
+		InjectionHead = 0;
+	}
+
+	InjectionQueue.push_back(job);
+	InjectedJobs.fetch_add(1, std::memory_order_seq_cst);
+}
+
+bool FJobSystem::FindJob(FWorker* localWorker, FJob& job)
+{
+	void* counter;
+
+	if (localWorker && localWorker->Queue.Pop(job.Declaration, counter))
+	{
+		job.Counter = static_cast<FJobCounter*>(counter);
+		return true;
+	}
+
+	if (InjectedJobs.load(std::memory_order_seq_cst) > 0)
+	{
+		std::lock_guard<std::mutex> lock(InjectionMutex);
+		if (InjectionHead < InjectionQueue.size())
+		{
+			job = InjectionQueue[InjectionHead++];
+			InjectedJobs.fetch_sub(1, std::memory_order_seq_cst);
+
+			if (InjectionHead == InjectionQueue.size())
+			{
+				InjectionQueue.clear();
+				InjectionHead = 0;
+			}
+
+			return true;
+		}
+	}
+
+	const uint32_t workerCount = static_cast<uint32_t>(Workers.size());
+	if (workerCount == 0)
+	{
+		return false;
+	}
+
+	uint32_t& randomState = localWorker ? localWorker->RandomState : externalRandomState;
+	uint32_t firstVictim = NextRandom(randomState) % workerCount;
+
+	for (uint32_t i = 0; i < workerCount; ++i)
+	{
+		FWorker* victim = Workers[(firstVictim + i) % workerCount].get();
+		if (victim == localWorker)
+		{
+			continue;
+		}
+
+		if (victim->Queue.Steal(job.Declaration, counter))
+		{
+			job.Counter = static_cast<FJobCounter*>(counter);
+
+			std::atomic<uint64_t>& jobsStolen = localWorker ? localWorker->JobsStolen : ExternalJobsStolen;
+			jobsStolen.fetch_add(1, std::memory_order_relaxed);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FJobSystem::Execute(FWorker* localWorker, const FJob& job)
+{
+	job.Declaration.Function(job.Declaration.UserData, job.Declaration.Begin, job.Declaration.End);
+
+	std::atomic<uint64_t>& jobsExecuted = localWorker ? localWorker->JobsExecuted : ExternalJobsExecuted;
+	jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+
+	FJobCounter* counter = job.Counter;
+	if (!counter)
+	{
+		return;
+	}
+
+	uint32_t value = counter->Value.load(std::memory_order_relaxed);
+	while (value > 1)
+	{
+		if (counter->Value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			return;
+		}
+	}
+
+	// Last job of the counter. The continuations are started and the counter released under the
+	// lock, so RunAfter() either queued them before or sees zero and starts its jobs itself.
+	uint32_t continuationCount = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(counter->ContinuationMutex);
+		if (counter->Value.load(std::memory_order_acquire) == 1)
+		{
+			continuationCount = static_cast<uint32_t>(counter->Continuations.size());
+			for (const FJobCounter::FContinuation& continuation : counter->Continuations)
+			{
+				Push({ continuation.Job, continuation.Counter });
+			}
+
+			counter->Continuations.clear();
+		}
+
+		counter->Value.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	WakeWorkers(continuationCount);
+}
+
+bool FJobSystem::HasQueuedJobs() const
+{
+	if (InjectedJobs.load(std::memory_order_seq_cst) > 0)
+	{
+		return true;
+	}
+
+	for (const std::unique_ptr<FWorker>& worker : Workers)
+	{
+		if (!worker->Queue.IsEmpty())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FJobSystem::WakeWorkers(uint32_t jobCount)
+{
+	if (jobCount == 0 || SleepingWorkers.load(std::memory_order_seq_cst) == 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(SleepMutex);
+	if (jobCount > 1)
+	{
+		WorkAvailable.notify_all();
+	}
+	else
+	{
+		WorkAvailable.notify_one();
+	}
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Job entry point. The range lets one job cover a batch of items.
+typedef void(*FJobFunction)(void* userData, uint32_t begin, uint32_t end);
+
+struct FJobDeclaration
+{
+	FJobFunction Function = nullptr;
+	void* UserData = nullptr;
+	uint32_t Begin = 0;
+	uint32_t End = 0;
+};
+
+struct FJobSystemStats
+{
+	uint64_t JobsExecuted = 0;
+	uint64_t JobsStolen = 0;
+};
+
+// Number of unfinished jobs that were started with this counter. Jobs can be waited on through it
+// or scheduled to start once it drops to zero. A counter must outlive the jobs that reference it.
+class FJobCounter
+{
+public:
+	FJobCounter();
+	~FJobCounter();
+
+	FJobCounter(const FJobCounter&) = delete;
+	FJobCounter& operator=(const FJobCounter&) = delete;
+
+	bool IsDone() const;
+	uint32_t GetValue() const;
+
+private:
+	friend class FJobSystem;
+
+	struct FContinuation
+	{
+		FJobDeclaration Job;
+		FJobCounter* Counter;
+	};
+
+	std::atomic<uint32_t> Value;
+	std::mutex ContinuationMutex;
+	std::vector<FContinuation> Continuations;
+};
+
+// Task scheduler with one lock-free work-stealing deque per worker thread. Jobs started from a worker
+// go to the bottom of its own deque, idle workers steal from the top of the others. Jobs started from
+// any other thread go through a shared injection queue. Threads that wait on a counter execute jobs
+// in the meantime, so waiting inside a job does not block a worker.
+class FJobSystem
+{
+public:
+	// Concurrency counts the thread that waits, so a concurrency of one starts no worker threads.
+	// Zero matches the number of hardware threads.
+	explicit FJobSystem(uint32_t concurrency = 0);
+	~FJobSystem();
+
+	FJobSystem(const FJobSystem&) = delete;
+	FJobSystem& operator=(const FJobSystem&) = delete;
+
+	// Every job increments counter when it is started and decrements it when it finishes.
+	void Run(const FJobDeclaration* jobs, uint32_t jobCount, FJobCounter* counter = nullptr);
+	void Run(const FJobDeclaration& job, FJobCounter* counter = nullptr);
+
+	// Starts the jobs once dependency drops to zero. Counter is incremented right away.
+	void RunAfter(FJobCounter& dependency, const FJobDeclaration* jobs, uint32_t jobCount, FJobCounter* counter = nullptr);
+
+	// Executes queued jobs until counter drops to zero.
+	void Wait(FJobCounter& counter);
+
+	// Calls function(begin, end) over [0, count) and returns when all of it is done. The range is split in
+	// halves on demand, so idle workers steal large pieces first. Each call gets at most batchSize items,
+	// more than half of that once the range was split, and begin is not a multiple of batchSize in general.
+	// A batch size of zero picks one from the item and thread count.
+	template<typename FunctionType>
+	void ParallelFor(uint32_t count, uint32_t batchSize, const FunctionType& function);
+	void ParallelFor(uint32_t count, uint32_t batchSize, FJobFunction function, void* userData);
+
+	uint32_t GetWorkerThreadCount() const;
+	// Threads that can execute jobs at the same time: the workers and one waiting thread.
+	uint32_t GetConcurrency() const;
+	// One-based index of the calling worker thread, or zero for any thread that is not a worker.
+	uint32_t GetCurrentWorkerIndex() const;
+
+	FJobSystemStats GetStats() const;
+	void ResetStats();
+
+private:
+	struct FJob
+	{
+		FJobDeclaration Declaration;
+		FJobCounter* Counter;
+	};
+
+	struct FWorker;
+	struct FParallelForContext;
+
+	static void ParallelForJob(void* userData, uint32_t begin, uint32_t end);
+
+	void WorkerMain(FWorker* worker);
+	FWorker* GetLocalWorker() const;
+
+	void Push(const FJob& job);
+	bool FindJob(FWorker* localWorker, FJob& job);
+	void Execute(FWorker* localWorker, const FJob& job);
+	bool HasQueuedJobs() const;
+	void WakeWorkers(uint32_t jobCount);
+
+	static thread_local FWorker* CurrentWorker;
+
+	std::vector<std::unique_ptr<FWorker>> Workers;
+
+	std::mutex InjectionMutex;
+	std::vector<FJob> InjectionQueue;
+	size_t InjectionHead;
+	std::atomic<uint32_t> InjectedJobs;
+
+	std::mutex SleepMutex;
+	std::condition_variable WorkAvailable;
+	std::atomic<uint32_t> SleepingWorkers;
+	bool ShuttingDown;
+
+	std::atomic<uint64_t> ExternalJobsExecuted;
+	std::atomic<uint64_t> ExternalJobsStolen;
+};
+
+template<typename FunctionType>
+void FJobSystem::ParallelFor(uint32_t count, uint32_t batchSize, const FunctionType& function)
+{
+	FJobFunction trampoline = [](void* userData, uint32_t begin, uint32_t end)
+	{
+		(*static_cast<const FunctionType*>(userData))(begin, end);
+	};
+
+	ParallelFor(count, batchSize, trampoline, const_cast<FunctionType*>(&function));
+}
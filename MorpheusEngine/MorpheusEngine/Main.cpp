@@ -1,4 +1,24 @@
 #include "DirectXTemplate.h"
+#include "BoundingVolumeHierarchy.h"
+#include "ConstantBufferRing.h"
+#include "D3D11GpuProfiler.h"
+#include "D3D11RenderDevice.h"
+#include "D3DShaderCompiler.h"
+#include "DrawList.h"
+#include "EntityComponentSystem.h"
+#include "FrameScheduler.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+#include "MemoryArena.h"
+#include "MeshFile.h"
+#include "MeshStreamer.h"
+#include "OcclusionCulling.h"
+#include "PipelineStateCache.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "SceneGraph.h"
+#include "ShaderCache.h"
+#include "VertexFormat.h"
 
 using namespace DirectX;
 
@@ -8,35 +28,106 @@ const LONG windowHeight = 720;
 LPCSTR windowClassName = "DirectXWindowClass";
 LPCSTR windowName = "Morpheus Engine";
 HWND windowHandle = 0;
+// Client area as of the last WM_SIZE, zero while the window is minimised.
+uint32_t windowClientWidth = 0;
+uint32_t windowClientHeight = 0;
 
 const BOOL enableVSync = TRUE;
 
+// The simulation runs at a fixed rate and rendering interpolates between the last two steps.
+const uint64_t simulationStepNanoseconds = 1000000000ull / 60;
+const uint32_t maxSimulationStepsPerFrame = 8;
+// Number of frames the simulation may run ahead of render submission, plus the one being rendered.
+const uint32_t framesInFlight = 2;
+// Clip planes of the projection, also the depth range of the draw sort keys.
+const float nearPlane = 0.1f;
+const float farPlane = 100.0f;
+// The background grid of cubes is drawn with one instanced draw, zero disables it.
+const uint32_t instancedCubesPerSide = 32;
+
 // Direct3D device and swap chain.
 ID3D11Device* d3dDevice = nullptr;
 ID3D11DeviceContext* d3dDeviceContext = nullptr;
 IDXGISwapChain* d3dSwapChain = nullptr;
 
-// Render target view for the back buffer of the swap chain.
-ID3D11RenderTargetView* d3dRenderTargetView = nullptr;
-// Depth/stencil view for use as a depth buffer.
-ID3D11DepthStencilView* d3dDepthStencilView = nullptr;
-// A texture to associate to the depth stencil view.
-ID3D11Texture2D* d3dDepthStencilBuffer = nullptr;
+// All frame code goes through the render device rather than the device context.
+IRenderDevice* renderDevice = nullptr;
+
+// Passes of a frame and the render targets they need, rebuilt every frame. Only the back buffer lives
+// outside the graph, the depth buffer and any other target comes from the pool.
+FRenderGraph renderGraph;
+FRenderGraphTexturePool* renderTargetPool = nullptr;
+// The frame with the most transient memory, reported on exit.
+FRenderGraphStats largestRenderGraph;
+
+// F11 starts a profiler capture and stops it again, writing the trace to the working directory.
+FD3D11GpuProfiler* gpuProfiler = nullptr;
+const UINT profilerCaptureKey = VK_F11;
+const char* profilerCaptureFileName = "MorpheusProfile.json";
+
+// Every state object comes from the cache, which is pre-warmed with the states of the last run.
+FPipelineStateCache* pipelineStateCache = nullptr;
+const char* pipelineManifestFileName = "PipelineStates.manifest";
 
 // Define the functionality of the depth/stencil stages.
-ID3D11DepthStencilState* d3dDepthStencilState = nullptr;
+FDepthStencilDesc depthStencilDescription;
 // Define the functionality of the rasterizer stage.
-ID3D11RasterizerState* d3dRasterizerState = nullptr;
-D3D11_VIEWPORT Viewport = { 0 };
+FRasterizerDesc rasterizerDescription;
+FViewport Viewport;
+
+// Mesh data, converted offline from Cube.obj.
+const char* cubeMeshFileName = "Cube.mesh";
+FMeshBuffers cubeMesh;
+
+// Optional level meshes, converted like Cube.mesh and packed with --pack. They stand in a row going
+// away from the camera and stream in nearest first while the first frames are already drawn.
+const char* levelPackFileName = "Level.pack";
+const uint64_t levelMemoryBudget = 64 * 1024 * 1024;
+const float levelMeshSpacing = 4.0f;
+const float levelViewDistance = farPlane;
+FMeshPack levelPack;
+FMeshStreamer* meshStreamer = nullptr;
+
+struct FLevelDraw
+{
+	const FMeshBuffers* Mesh;
+	FConstantBufferAllocation Constants;
+	float ViewDepth;
+};
+
+std::vector<FLevelDraw> levelDraws;
+
+XMVECTOR GetLevelMeshPosition(uint32_t mesh)
+{
+	return XMVectorSet(-4.0f, -2.0f, levelMeshSpacing * mesh, 1.0f);
+}
 
-// Vertex buffer data
-ID3D11InputLayout* d3dInputLayout = nullptr;
-ID3D11Buffer* d3dVertexBuffer = nullptr;
-ID3D11Buffer* d3dIndexBuffer = nullptr;
+// Startup and hitch metrics, written by the render thread and reported on exit.
+uint64_t startTime = 0;
+uint64_t firstFrameNanoseconds = 0;
+uint64_t previousPresentTime = 0;
+uint64_t worstFrameNanoseconds = 0;
 
 // Shader data
-ID3D11VertexShader* d3dVertexShader = nullptr;
-ID3D11PixelShader* d3dPixelShader = nullptr;
+FVertexShaderHandle vertexShader;
+FPixelShaderHandle pixelShader;
+
+// Instanced variant of the vertex shader, reading the world matrix from a second vertex stream.
+FVertexShaderHandle instancedVertexShader;
+FInstanceBuffer* instanceBuffer = nullptr;
+
+// Packs instance data on the render thread and updates the scene graph.
+FJobSystem* jobSystem = nullptr;
+
+// Pipeline ids from the state cache, also the pipeline field of the draw sort keys.
+uint32_t simplePipeline = FPipelineStateCache::InvalidPipeline;
+uint32_t instancedPipeline = FPipelineStateCache::InvalidPipeline;
+
+// Draws of a frame, sorted and filtered for redundant binds before they reach the device.
+FDrawList drawList;
+// One per job thread. Frames with enough draws are recorded into them in parallel.
+std::vector<std::unique_ptr<ICommandList>> commandLists;
+std::vector<ICommandList*> commandListPointers;
 
 // Shader resources.
 enum EConstantBuffer
@@ -47,61 +138,115 @@ enum EConstantBuffer
 	NumberOfConstantBuffers
 };
 
-ID3D11Buffer* d3DConstantBuffers[NumberOfConstantBuffers];
+// The projection only changes with the window, per-frame and per-object constants come from the ring.
+FBufferHandle applicationConstantBuffer;
+FConstantBufferRing* constantBufferRing = nullptr;
+
+// Transform hierarchy of the scene objects, only moved nodes are recomputed every frame.
+FSceneGraph sceneGraph;
+FSceneNodeHandle cubeNode;
+FSceneNodeHandle gridNode;
+// Bounds of the grid cubes, queried with the view frustum every frame before packing instances. The
+// grid turns as a whole, so refitting keeps the tree tight and the cubes are static proxies.
+FBoundingVolumeHierarchy sceneBounds;
+// Every grid cube is an entity with its scene node and its proxy, in the order of gridCubeBounds.
+struct FSceneNodeComponent
+{
+	FSceneNodeHandle Node;
+};
+
+struct FCullProxyComponent
+{
+	FBvhProxyHandle Proxy;
+	uint32_t Index;
+};
 
-XMMATRIX worldMatrix;
+FEntityWorld entityWorld;
+FEntityQuery* gridCubeQuery = nullptr;
+std::vector<FEntity> gridCubeEntities;
+std::vector<uint32_t> visibleGridCubes;
+std::vector<FBoundingBox> gridCubeBounds;
+FBoundingBox cubeLocalBounds;
+// Grid cubes behind the main cube are dropped after frustum culling. The cube fills its bounds, so its
+// box is an exact occluder.
+FOcclusionCuller occlusionCuller;
+// Totals of every frame, reported on exit.
+uint64_t occlusionTestedInstances = 0;
+uint64_t occlusionCulledInstances = 0;
+uint64_t occlusionNanoseconds = 0;
+uint64_t occlusionFrames = 0;
 XMMATRIX viewMatrix;
 XMMATRIX projectionMatrix;
+// Size of the view the projection was made for.
+uint32_t viewWidth = 0;
+uint32_t viewHeight = 0;
+
+// Simulation state of the last two fixed steps.
+float previousAngle = 0.0f;
+float currentAngle = 0.0f;
 
-struct FVertexColour
+// Everything the render thread needs from the simulation to draw one frame.
+struct FFrameData
 {
-	XMFLOAT3 Position;
-	XMFLOAT3 Colour;
+	XMMATRIX WorldMatrix;
+	XMMATRIX ViewMatrix;
+	XMMATRIX ProjectionMatrix;
+	// Size the back buffer should have for this frame.
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	XMVECTOR GridPosition;
+	// Allocated from the frame arena of this frame.
+	const FFloat4x4* InstanceWorldMatrices = nullptr;
+	uint32_t InstanceCount = 0;
 };
 
-FVertexColour vertices[8] =
+// The PerObject constant buffer of the vertex shaders.
+struct FObjectConstants
 {
-	{ XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) }, // 0
-	{ XMFLOAT3(-1.0f,  1.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) }, // 1
-	{ XMFLOAT3(1.0f,  1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f) }, // 2
-	{ XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) }, // 3
-	{ XMFLOAT3(-1.0f, -1.0f,  1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) }, // 4
-	{ XMFLOAT3(-1.0f,  1.0f,  1.0f), XMFLOAT3(0.0f, 1.0f, 1.0f) }, // 5
-	{ XMFLOAT3(1.0f,  1.0f,  1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f) }, // 6
-	{ XMFLOAT3(1.0f, -1.0f,  1.0f), XMFLOAT3(1.0f, 0.0f, 1.0f) }  // 7
+	XMMATRIX WorldMatrix;
+	// Dequantisation of the mesh positions, w unused.
+	XMFLOAT4 PositionScale;
+	XMFLOAT4 PositionOffset;
 };
 
-WORD indicies[36] =
+// Shaders of the application, compiled through the cache in one batch.
+enum EShader
 {
-	0, 1, 2, 0, 2, 3,
-	4, 6, 5, 4, 7, 6,
-	4, 5, 1, 4, 1, 0,
-	3, 2, 6, 3, 6, 7,
-	1, 5, 6, 1, 6, 2,
-	4, 0, 3, 4, 3, 7
+	Shader_SimpleVertex,
+	Shader_InstancedVertex,
+	Shader_SimplePixel,
+	NumberOfShaders
 };
 
+const char* shaderFileNames[NumberOfShaders] =
+{
+	"SimpleVertexShader.hlsl",
+	"InstancedVertexShader.hlsl",
+	"SimplePixelShader.hlsl"
+};
+
+// Compiled bytecode, keyed by the sources, profile and flags. Filled offline by --compile-shaders.
+const char* shaderCacheDirectory = "ShaderCache";
+
 #pragma region Function declarations
 // Forward declarations.
 LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
 
-template< class ShaderClass >
-ShaderClass* LoadShader(const std::wstring& fileName, const std::string& entryPoint, const std::string& profile);
-
 template<class ShaderClass>
-std::string GetLatestProfile();
+std::string GetLatestProfile(D3D_FEATURE_LEVEL featureLevel);
 
-template<class ShaderClass>
-ShaderClass* CreateShader(ID3DBlob* shaderBlob, ID3D11ClassLinkage* classLinkage);
+void GetShaderRequests(const FInputElementDesc* meshElements, uint32_t meshElementCount, D3D_FEATURE_LEVEL featureLevel, FShaderCompileRequest* requests);
+int CompileShadersOffline();
 
 bool LoadContent();
 void UnloadContent();
 
 void Update(float deltaTime);
+void BuildFrameData(FFrameData& frame, FLinearArena& frameArena, float interpolationAlpha);
 void Clear(const FLOAT clearColour[4], FLOAT clearDepth, UINT8 clearStencil);
 
 void Present(BOOL vSync);
-void Render();
+void Render(const FFrameData& frame);
 void Cleanup();
 DXGI_RATIONAL QueryRefreshRate(UINT screenWidth, UINT screenHeight, BOOL vsync);
 int InitialiseDirectX(HINSTANCE hInstance, BOOL vSync);
@@ -154,6 +299,36 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 		}
 		break;
 	
+		case WM_KEYDOWN:
+		{
+			// Ignores the repeats of a held key.
+			if (wParam == profilerCaptureKey && (lParam & (1 << 30)) == 0)
+			{
+				if (!IsProfilerEnabled())
+				{
+					BeginProfilerCapture();
+				}
+				else
+				{
+					std::string captureError;
+					if (!EndProfilerCapture(profilerCaptureFileName, &captureError))
+					{
+						OutputDebugStringA((captureError + "\n").c_str());
+					}
+				}
+			}
+		}
+		break;
+
+		case WM_SIZE:
+		{
+			// The swap chain belongs to the render thread, which resizes it when a frame with the new
+			// size reaches it.
+			windowClientWidth = LOWORD(lParam);
+			windowClientHeight = HIWORD(lParam);
+		}
+		break;
+
 		case WM_DESTROY:
 		{
 			PostQuitMessage(0);
@@ -171,35 +346,76 @@ int Run()
 {
 	MSG message = { 0 };
 
-	static DWORD previousTime = timeGetTime();
-	static const float targetFrameRate = 30.0f;
-	static const float maxTimeStep = 1.0f / targetFrameRate;
+	FFixedTimestep timestep(simulationStepNanoseconds, maxSimulationStepsPerFrame);
+
+	// Transient memory of each frame, recycled in step with the frame data of the pipeline. Declared
+	// first so it outlives the render thread.
+	FFrameArenas frameArenas(framesInFlight);
+	// Render submission of frame N runs on its own thread while this thread simulates frame N + 1.
+	TFramePipeline<FFrameData> framePipeline(framesInFlight, [](const FFrameData& frame) { Render(frame); });
+
+	uint64_t previousTime = FHighResolutionClock::NowNanoseconds();
+
+	SetProfilerThreadName("Simulation");
 
 	while (message.message != WM_QUIT)
 	{
-		if (PeekMessage(&message, 0, 0, 0, PM_REMOVE))
+		MORPHEUS_PROFILE_FRAME();
+
+		// Drain the whole queue so input is never more than one frame old.
+		while (PeekMessage(&message, 0, 0, 0, PM_REMOVE))
 		{
+			if (message.message == WM_QUIT)
+			{
+				break;
+			}
+
 			TranslateMessage(&message);
 			DispatchMessage(&message);
 		}
-		else
+
+		if (message.message == WM_QUIT)
+		{
+			break;
+		}
+
+		uint64_t currentTime = FHighResolutionClock::NowNanoseconds();
+		uint32_t steps = timestep.Advance(currentTime - previousTime);
+		previousTime = currentTime;
+
+		for (uint32_t step = 0; step < steps; ++step)
 		{
-			DWORD currentTime = timeGetTime();
-			float deltaTime = (currentTime - previousTime) / 1000.0f;
-			previousTime = currentTime;
+			Update(timestep.GetStepSeconds());
+		}
 
-			//
-			deltaTime = std::min<float>(deltaTime, maxTimeStep);
+		// Blocks while the renderer is a full pipeline behind.
+		FFrameData* frame;
+		{
+			MORPHEUS_PROFILE_SCOPE("Wait for frame slot");
+			frame = &framePipeline.BeginFrame();
 		}
+
+		FLinearArena& frameArena = frameArenas.BeginFrame();
+		BuildFrameData(*frame, frameArena, timestep.GetInterpolationAlpha());
+		MORPHEUS_PROFILE_COUNTER("Frame arena bytes", frameArena.GetUsedBytes());
+		framePipeline.EndFrame();
 	}
 
+	framePipeline.Stop();
+
 	return static_cast<int>(message.wParam);
 }
 
 int WINAPI wWinMain(HINSTANCE currentInstance, HINSTANCE previousInstance, LPWSTR commandLine, int commandShow)
 {
 	UNREFERENCED_PARAMETER(previousInstance);
-	UNREFERENCED_PARAMETER(commandLine);
+
+	startTime = FHighResolutionClock::NowNanoseconds();
+
+	if (commandLine && wcscmp(commandLine, L"--compile-shaders") == 0)
+	{
+		return CompileShadersOffline();
+	}
 
 	if (!XMVerifyCPUSupport())
 	{
@@ -218,10 +434,62 @@ int WINAPI wWinMain(HINSTANCE currentInstance, HINSTANCE previousInstance, LPWST
 	if (InitialiseDirectX(currentInstance, enableVSync) != 0)
 	{
 		MessageBox(nullptr, TEXT("Failed to create DirectX device and swap chain!"), TEXT("Error"), MB_OK);
+
+		return -1;
+	}
+
+	if (!LoadContent())
+	{
+		MessageBox(nullptr, TEXT("Failed to load content!"), TEXT("Error"), MB_OK);
+
+		return -1;
 	}
 
 	int returnCode = Run();
 
+	// Whatever this run created is created up front by the next one.
+	std::string manifestError;
+	if (!pipelineStateCache->SaveManifest(pipelineManifestFileName, &manifestError))
+	{
+		OutputDebugStringA((manifestError + "\n").c_str());
+	}
+
+	const FPipelineStateCacheStats& stateStats = pipelineStateCache->GetStats();
+	char statsText[256];
+	snprintf(statsText, sizeof(statsText), "Pipeline states: %u pipelines, %u created while running, %u pre-warmed, %.3f ms creating\n", pipelineStateCache->GetPipelineCount(),
+		stateStats.RasterizerStates.Misses + stateStats.DepthStencilStates.Misses + stateStats.BlendStates.Misses + stateStats.InputLayouts.Misses,
+		stateStats.RasterizerStates.Prewarmed + stateStats.DepthStencilStates.Prewarmed + stateStats.BlendStates.Prewarmed + stateStats.InputLayouts.Prewarmed,
+		(stateStats.RasterizerStates.CreationNanoseconds + stateStats.DepthStencilStates.CreationNanoseconds + stateStats.BlendStates.CreationNanoseconds +
+			stateStats.InputLayouts.CreationNanoseconds) * 1e-6);
+	OutputDebugStringA(statsText);
+
+	snprintf(statsText, sizeof(statsText), "Render graph: %u of %u passes culled, %u transient targets in %u allocations, %.1f MB without aliasing, %.1f MB aliased, %.1f MB at peak\n",
+		largestRenderGraph.CulledPasses, largestRenderGraph.Passes, largestRenderGraph.TransientTextures, largestRenderGraph.Allocations,
+		largestRenderGraph.UnaliasedBytes / (1024.0 * 1024.0), largestRenderGraph.AliasedBytes / (1024.0 * 1024.0), largestRenderGraph.PeakLiveBytes / (1024.0 * 1024.0));
+	OutputDebugStringA(statsText);
+
+	snprintf(statsText, sizeof(statsText), "Occlusion culling: %llu of %llu instances in the frustum hidden (%.1f%%), %.1f us per frame\n",
+		static_cast<unsigned long long>(occlusionCulledInstances), static_cast<unsigned long long>(occlusionTestedInstances),
+		occlusionTestedInstances > 0 ? 100.0 * occlusionCulledInstances / occlusionTestedInstances : 0.0,
+		occlusionFrames > 0 ? occlusionNanoseconds * 1e-3 / occlusionFrames : 0.0);
+	OutputDebugStringA(statsText);
+
+	snprintf(statsText, sizeof(statsText), "Frames: %.1f ms to the first frame, %.1f ms worst frame\n", firstFrameNanoseconds * 1e-6, worstFrameNanoseconds * 1e-6);
+	OutputDebugStringA(statsText);
+
+	if (meshStreamer)
+	{
+		const FMeshStreamerStats& streamingStats = meshStreamer->GetStats();
+		snprintf(statsText, sizeof(statsText), "Streaming: %llu meshes loaded, %llu evicted, %llu failed, %.1f MB peak resident of %.1f MB, %.3f ms longest update\n",
+			static_cast<unsigned long long>(streamingStats.Loaded), static_cast<unsigned long long>(streamingStats.Evicted),
+			static_cast<unsigned long long>(streamingStats.Failed), streamingStats.PeakResidentBytes / (1024.0 * 1024.0),
+			meshStreamer->GetMemoryBudget() / (1024.0 * 1024.0), streamingStats.MaxUpdateNanoseconds * 1e-6);
+		OutputDebugStringA(statsText);
+	}
+
+	UnloadContent();
+	Cleanup();
+
 	return returnCode;
 }
 DXGI_RATIONAL QueryRefreshRate(UINT screenWidth, UINT screenHeight, BOOL vsync)
@@ -233,7 +501,6 @@ DXGI_RATIONAL QueryRefreshRate(UINT screenWidth, UINT screenHeight, BOOL vsync)
 		IDXGIFactory* factory;
 		IDXGIAdapter* adapter;
 		IDXGIOutput* adapterOutput;
-		DXGI_MODE_DESC* displayModeList;
 
 		// Create a DirectX graphics interface factory.
 		HRESULT hr = CreateDXGIFactory(__uuidof(IDXGIFactory), (void**)&factory);
@@ -269,10 +536,9 @@ DXGI_RATIONAL QueryRefreshRate(UINT screenWidth, UINT screenHeight, BOOL vsync)
 			throw new std::exception("Failed to query display mode list.");
 		}
 
-		displayModeList = new DXGI_MODE_DESC[numDisplayModes];
-		assert(displayModeList);
+		std::vector<DXGI_MODE_DESC> displayModeList(numDisplayModes);
 
-		hr = adapterOutput->GetDisplayModeList(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_ENUM_MODES_INTERLACED, &numDisplayModes, displayModeList);
+		hr = adapterOutput->GetDisplayModeList(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_ENUM_MODES_INTERLACED, &numDisplayModes, displayModeList.data());
 		if (FAILED(hr))
 		{
 			MessageBox(0, TEXT("Failed to query display mode list."), TEXT("Query Refresh Rate"), MB_OK);
@@ -289,7 +555,6 @@ DXGI_RATIONAL QueryRefreshRate(UINT screenWidth, UINT screenHeight, BOOL vsync)
 			}
 		}
 
-		delete[] displayModeList;
 		SafeRelease(adapterOutput);
 		SafeRelease(adapter);
 		SafeRelease(factory);
@@ -357,88 +622,35 @@ int InitialiseDirectX(HINSTANCE hInstance, BOOL vSync)
 		return -1;
 	}
 
-	ID3D11Texture2D* backBuffer;
-
-	hr = d3dSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&backBuffer);
-
-	if (FAILED(hr))
-	{
-		return -1;
-	}
-
-	hr = d3dDevice->CreateRenderTargetView(backBuffer, nullptr, &d3dRenderTargetView);
-
-	if (FAILED(hr))
-	{
-		return -1;
-	}
-
-	SafeRelease(backBuffer);
-
-	D3D11_TEXTURE2D_DESC depthStencilBufferDescription;
-	ZeroMemory(&depthStencilBufferDescription, sizeof(D3D11_TEXTURE2D_DESC));
-
-	depthStencilBufferDescription.ArraySize = 1;
-	depthStencilBufferDescription.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-	depthStencilBufferDescription.CPUAccessFlags = 0;
-	depthStencilBufferDescription.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-	depthStencilBufferDescription.Width = clientWidth;
-	depthStencilBufferDescription.Height = clientHeight;
-	depthStencilBufferDescription.MipLevels = 1;
-	depthStencilBufferDescription.SampleDesc.Count = 1;
-	depthStencilBufferDescription.SampleDesc.Quality = 0;
-	depthStencilBufferDescription.Usage = D3D11_USAGE_DEFAULT;
-
-	hr = d3dDevice->CreateTexture2D(&depthStencilBufferDescription, nullptr, &d3dDepthStencilBuffer);
-
-	if (FAILED(hr))
-	{
-		return -1;
-	}
-
-	hr = d3dDevice->CreateDepthStencilView(d3dDepthStencilBuffer, nullptr, &d3dDepthStencilView);
+	// The device makes the view of the back buffer, the depth buffer is a render graph target.
+	renderDevice = new FD3D11RenderDevice(d3dDevice, d3dDeviceContext, d3dSwapChain);
 
-	if (FAILED(hr))
+	if (!renderDevice->GetBackBuffer().IsValid())
 	{
 		return -1;
 	}
 
-	D3D11_DEPTH_STENCIL_DESC depthStencilStateDescription;
-	ZeroMemory(&depthStencilStateDescription, sizeof(D3D11_DEPTH_STENCIL_DESC));
-
-	depthStencilStateDescription.DepthEnable = TRUE;
-	depthStencilStateDescription.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-	depthStencilStateDescription.DepthFunc = D3D11_COMPARISON_LESS;
-	depthStencilStateDescription.StencilEnable = FALSE;
+	renderTargetPool = new FRenderGraphTexturePool(renderDevice);
+	gpuProfiler = new FD3D11GpuProfiler(d3dDevice, d3dDeviceContext);
 
-	hr = d3dDevice->CreateDepthStencilState(&depthStencilStateDescription, &d3dDepthStencilState);
+	pipelineStateCache = new FPipelineStateCache(renderDevice);
 
-	//if (FAILED(hr))
-	//{
-	//	return -1;
-	//}
+	depthStencilDescription.DepthEnable = true;
+	depthStencilDescription.DepthWriteEnable = true;
+	depthStencilDescription.DepthFunc = EComparisonFunc::Less;
+	depthStencilDescription.StencilEnable = false;
 
-	D3D11_RASTERIZER_DESC rasterizerDescription;
-	ZeroMemory(&rasterizerDescription, sizeof(D3D11_RASTERIZER_DESC));
-
-	rasterizerDescription.AntialiasedLineEnable = FALSE;
-	rasterizerDescription.CullMode = D3D11_CULL_BACK;
+	rasterizerDescription.AntialiasedLineEnable = false;
+	rasterizerDescription.CullMode = ECullMode::Back;
 	rasterizerDescription.DepthBias = 0;
 	rasterizerDescription.DepthBiasClamp = 0.0f;
-	rasterizerDescription.DepthClipEnable = TRUE;
-	rasterizerDescription.FillMode = D3D11_FILL_SOLID;
-	rasterizerDescription.FrontCounterClockwise = FALSE;
-	rasterizerDescription.MultisampleEnable = FALSE;
-	rasterizerDescription.ScissorEnable = FALSE;
+	rasterizerDescription.DepthClipEnable = true;
+	rasterizerDescription.FillMode = EFillMode::Solid;
+	rasterizerDescription.FrontCounterClockwise = false;
+	rasterizerDescription.MultisampleEnable = false;
+	rasterizerDescription.ScissorEnable = false;
 	rasterizerDescription.SlopeScaledDepthBias = 0.0f;
 
-	hr = d3dDevice->CreateRasterizerState(&rasterizerDescription, &d3dRasterizerState);
-
-	if (FAILED(hr))
-	{
-		return -1;
-	}
-
 	Viewport.Width = static_cast<float>(clientWidth);
 	Viewport.Height = static_cast<float>(clientHeight);
 	Viewport.TopLeftX = 0.0f;
@@ -450,12 +662,8 @@ int InitialiseDirectX(HINSTANCE hInstance, BOOL vSync)
 }
 
 template<>
-std::string GetLatestProfile<ID3D11VertexShader>()
+std::string GetLatestProfile<ID3D11VertexShader>(D3D_FEATURE_LEVEL featureLevel)
 {
-	assert(d3dDevice);
-
-	D3D_FEATURE_LEVEL featureLevel = d3dDevice->GetFeatureLevel();
-
 	switch (featureLevel)
 	{
 		case D3D_FEATURE_LEVEL_11_1:
@@ -485,12 +693,8 @@ std::string GetLatestProfile<ID3D11VertexShader>()
 }
 
 template<>
-std::string GetLatestProfile<ID3D11PixelShader>()
+std::string GetLatestProfile<ID3D11PixelShader>(D3D_FEATURE_LEVEL featureLevel)
 {
-	assert(d3dDevice);
-
-	D3D_FEATURE_LEVEL featureLevel = d3dDevice->GetFeatureLevel();
-
 	switch (featureLevel)
 	{
 		case D3D_FEATURE_LEVEL_11_1:
@@ -519,141 +723,204 @@ std::string GetLatestProfile<ID3D11PixelShader>()
 	return "";
 }
 
-template<>
-ID3D11VertexShader* CreateShader<ID3D11VertexShader>(ID3DBlob* shaderBlob, ID3D11ClassLinkage* classLinkage)
+// The requests of all shaders for one feature level. The vertex shaders include the input struct
+// generated from the mesh layout, so they are keyed by it too.
+void GetShaderRequests(const FInputElementDesc* meshElements, uint32_t meshElementCount, D3D_FEATURE_LEVEL featureLevel, FShaderCompileRequest* requests)
 {
-	assert(d3dDevice);
-	assert(shaderBlob);
+	UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
 
-	ID3D11VertexShader* vertexShader = nullptr;
-	d3dDevice->CreateVertexShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), classLinkage, &vertexShader);
+#if _DEBUG
+	flags |= D3DCOMPILE_DEBUG;
+#endif
 
-	return vertexShader;
-}
+	FShaderVirtualFile vertexInput = { "VertexInput.hlsli", GenerateVertexShaderInput(meshElements, meshElementCount) };
 
-template<>
-ID3D11PixelShader* CreateShader<ID3D11PixelShader>(ID3DBlob* shaderBlob, ID3D11ClassLinkage* classLinkage)
-{
-	assert(d3dDevice);
-	assert(shaderBlob);
+	for (uint32_t i = 0; i < NumberOfShaders; ++i)
+	{
+		const bool isPixelShader = i == Shader_SimplePixel;
 
-	ID3D11PixelShader* pixelShader = nullptr;
-	d3dDevice->CreatePixelShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), classLinkage, &pixelShader);
+		requests[i].FileName = shaderFileNames[i];
+		requests[i].EntryPoint = "main";
+		requests[i].Profile = isPixelShader ? GetLatestProfile<ID3D11PixelShader>(featureLevel) : GetLatestProfile<ID3D11VertexShader>(featureLevel);
+		requests[i].Flags = flags;
+		requests[i].VirtualFiles.clear();
 
-	return pixelShader;
+		if (!isPixelShader)
+		{
+			requests[i].VirtualFiles.push_back(vertexInput);
+		}
+	}
 }
 
-template<class ShaderClass>
-ShaderClass* LoadShader(const std::wstring& fileName, const std::string& entryPoint, const std::string& profile)
+// Fills the shader cache for every feature level the device may be created with, so the first launch
+// loads bytecode instead of waiting on the compiler. Runs without a window, as a post-build step.
+int CompileShadersOffline()
 {
-	ID3DBlob* shaderBlob = nullptr;
-	ID3DBlob* errorBlob = nullptr;
+	const D3D_FEATURE_LEVEL featureLevels[] =
+	{
+		D3D_FEATURE_LEVEL_11_1,
+		D3D_FEATURE_LEVEL_11_0,
+		D3D_FEATURE_LEVEL_10_1,
+		D3D_FEATURE_LEVEL_10_0,
+		D3D_FEATURE_LEVEL_9_3,
+		D3D_FEATURE_LEVEL_9_2,
+		D3D_FEATURE_LEVEL_9_1
+	};
 
-	ShaderClass* shader = nullptr;
+	FMeshFile cubeMeshFile;
+	if (!cubeMeshFile.Open(cubeMeshFileName))
+	{
+		OutputDebugStringA((std::string(cubeMeshFileName) + ": " + cubeMeshFile.GetError() + "\n").c_str());
+		return 1;
+	}
 
-	std::string prof = profile;
+	FInputElementDesc meshElements[MaxMeshStreams * MaxMeshStreamElements];
+	uint32_t meshElementCount = cubeMeshFile.GetInputElements(meshElements, _countof(meshElements));
 
-	if (prof == "latest")
+	// Levels with the same profiles make the same keys, the cache compiles those once.
+	std::vector<FShaderCompileRequest> requests(_countof(featureLevels) * NumberOfShaders);
+	for (uint32_t i = 0; i < _countof(featureLevels); ++i)
 	{
-		prof = GetLatestProfile<ShaderClass>();
+		GetShaderRequests(meshElements, meshElementCount, featureLevels[i], &requests[i * NumberOfShaders]);
 	}
 
-	UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
-
-#if _DEBUG
-	flags |= D3DCOMPILE_DEBUG;
-#endif
+	FD3DShaderCompiler compiler;
+	FShaderCache shaderCache(shaderCacheDirectory, &compiler);
+	FJobSystem compileJobs(0);
 
-	HRESULT result = D3DCompileFromFile(fileName.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint.c_str(), prof.c_str(), flags, 0, &shaderBlob, &errorBlob);
+	std::vector<FShaderCacheResult> results(requests.size());
+	shaderCache.Compile(requests.data(), static_cast<uint32_t>(requests.size()), results.data(), &compileJobs);
 
-	if (FAILED(result))
+	int returnCode = 0;
+	for (size_t i = 0; i < results.size(); ++i)
 	{
-		if (errorBlob)
+		if (!results[i].Messages.empty())
 		{
-			std::string errorMessage = (char*)errorBlob->GetBufferPointer();
-			OutputDebugStringA(errorMessage.c_str());
-
-			SafeRelease(shaderBlob);
-			SafeRelease(errorBlob);
+			OutputDebugStringA((requests[i].FileName + " (" + requests[i].Profile + "): " + results[i].Messages + "\n").c_str());
 		}
 
-		return false;
+		returnCode = results[i].Succeeded ? returnCode : 1;
 	}
 
-	shader = CreateShader<ShaderClass>(shaderBlob, nullptr);
-
-	SafeRelease(shaderBlob);
-	SafeRelease(errorBlob);
-
-	return shader;
+	return returnCode;
 }
 
+
 bool LoadContent()
 {
-	assert(d3dDevice);
+	assert(renderDevice);
+
+	// The buffers are created straight from the mapped file, which is closed again when the function
+	// returns. The instanced draw needs one vertex stream left for the instance transforms.
+	FMeshFile cubeMeshFile;
+	if (!cubeMeshFile.Open(cubeMeshFileName))
+	{
+		OutputDebugStringA((std::string(cubeMeshFileName) + ": " + cubeMeshFile.GetError() + "\n").c_str());
+		return false;
+	}
 
-	D3D11_BUFFER_DESC vertexBufferDescription;
-	ZeroMemory(&vertexBufferDescription, sizeof(D3D11_BUFFER_DESC));
+	if (cubeMeshFile.GetStreamCount() >= FDrawItem::MaxVertexStreams || !CreateMeshBuffers(renderDevice, cubeMeshFile, cubeMesh))
+	{
+		return false;
+	}
 
-	vertexBufferDescription.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDescription.ByteWidth = sizeof(FVertexColour) * _countof(vertices);
-	vertexBufferDescription.CPUAccessFlags = 0;
-	vertexBufferDescription.Usage = D3D11_USAGE_DEFAULT;
+	cubeLocalBounds = cubeMeshFile.GetBounds();
 
-	D3D11_SUBRESOURCE_DATA resourceData;
-	ZeroMemory(&resourceData, sizeof(D3D11_SUBRESOURCE_DATA));
+	FInputElementDesc meshElements[MaxMeshStreams * MaxMeshStreamElements];
+	uint32_t meshElementCount = cubeMeshFile.GetInputElements(meshElements, _countof(meshElements));
 
-	resourceData.pSysMem = vertices;
+	FBufferDesc constantBufferDescription;
+	constantBufferDescription.Binding = EBufferBinding::Constant;
+	constantBufferDescription.ByteWidth = sizeof(XMMATRIX);
+	constantBufferDescription.Usage = EResourceUsage::Default;
 
-	HRESULT result = d3dDevice->CreateBuffer(&vertexBufferDescription, &resourceData, &d3dVertexBuffer);
-	if (FAILED(result))
+	applicationConstantBuffer = renderDevice->CreateBuffer(constantBufferDescription, nullptr);
+	if (!applicationConstantBuffer.IsValid())
 	{
 		return false;
 	}
 
-	// Create and initialize the index buffer.
-	D3D11_BUFFER_DESC indexBufferDescription;
-	ZeroMemory(&indexBufferDescription, sizeof(D3D11_BUFFER_DESC));
+	constantBufferRing = new FConstantBufferRing(renderDevice);
 
-	indexBufferDescription.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDescription.ByteWidth = sizeof(WORD) * _countof(indicies);
-	indexBufferDescription.CPUAccessFlags = 0;
-	indexBufferDescription.Usage = D3D11_USAGE_DEFAULT;
-	resourceData.pSysMem = indicies;
+	jobSystem = new FJobSystem(0);
 
-	result = d3dDevice->CreateBuffer(&indexBufferDescription, &resourceData, &d3dIndexBuffer);
-	if (FAILED(result))
+	for (uint32_t i = 0; i < jobSystem->GetConcurrency(); ++i)
 	{
-		return false;
+		std::unique_ptr<ICommandList> commandList = renderDevice->CreateCommandList();
+		if (commandList)
+		{
+			commandListPointers.push_back(commandList.get());
+			commandLists.push_back(std::move(commandList));
+		}
 	}
 
-	D3D11_BUFFER_DESC constantBufferDescription;
-	ZeroMemory(&constantBufferDescription, sizeof(D3D11_BUFFER_DESC));
+	// The vertex shaders read the mesh in whatever packing the converter chose. Anything not in the
+	// cache yet is compiled in parallel on the job system.
+	FShaderCompileRequest shaderRequests[NumberOfShaders];
+	GetShaderRequests(meshElements, meshElementCount, d3dDevice->GetFeatureLevel(), shaderRequests);
 
-	constantBufferDescription.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	constantBufferDescription.ByteWidth = sizeof(XMMATRIX);
-	constantBufferDescription.CPUAccessFlags = 0;
-	constantBufferDescription.Usage = D3D11_USAGE_DEFAULT;
+	FD3DShaderCompiler shaderCompiler;
+	FShaderCache shaderCache(shaderCacheDirectory, &shaderCompiler);
 
-	result = d3dDevice->CreateBuffer(&constantBufferDescription, nullptr, &d3DConstantBuffers[CB_Application]);
-	if (FAILED(result))
+	FShaderCacheResult shaderResults[NumberOfShaders];
+	shaderCache.Compile(shaderRequests, NumberOfShaders, shaderResults, jobSystem);
+
+	FShaderBytecode shaderBytecode[NumberOfShaders];
+	for (uint32_t i = 0; i < NumberOfShaders; ++i)
 	{
-		return false;
+		if (!shaderResults[i].Messages.empty())
+		{
+			OutputDebugStringA((shaderRequests[i].FileName + ": " + shaderResults[i].Messages + "\n").c_str());
+		}
+
+		if (!shaderResults[i].Succeeded)
+		{
+			return false;
+		}
+
+		shaderBytecode[i].Data = shaderResults[i].Bytecode.data();
+		shaderBytecode[i].Size = shaderResults[i].Bytecode.size();
+		shaderBytecode[i].DebugName = shaderFileNames[i];
 	}
-	result = d3dDevice->CreateBuffer(&constantBufferDescription, nullptr, &d3DConstantBuffers[CB_Frame]);
-	if (FAILED(result))
+
+	vertexShader = renderDevice->CreateVertexShader(shaderBytecode[Shader_SimpleVertex]);
+	instancedVertexShader = renderDevice->CreateVertexShader(shaderBytecode[Shader_InstancedVertex]);
+	pixelShader = renderDevice->CreatePixelShader(shaderBytecode[Shader_SimplePixel]);
+
+	// The first run has no manifest, and a changed shader skips the input layouts of the old one. The
+	// vertex shaders come first in the shader table.
+	std::string manifestError;
+	if (!pipelineStateCache->PrewarmFromManifest(pipelineManifestFileName, shaderBytecode, Shader_InstancedVertex + 1, &manifestError))
 	{
-		return false;
+		OutputDebugStringA((manifestError + "\n").c_str());
 	}
-	result = d3dDevice->CreateBuffer(&constantBufferDescription, nullptr, &d3DConstantBuffers[CB_Object]);
-	if (FAILED(result))
+
+	// The input layout is validated against the vertex shader signature.
+	FPipelineStateDesc pipelineDescription;
+	pipelineDescription.VertexShader = vertexShader;
+	pipelineDescription.PixelShader = pixelShader;
+	pipelineDescription.InputLayout = pipelineStateCache->GetInputLayout(meshElements, meshElementCount, shaderBytecode[Shader_SimpleVertex]);
+	pipelineDescription.Rasterizer = rasterizerDescription;
+	pipelineDescription.DepthStencil = depthStencilDescription;
+
+	simplePipeline = pipelineStateCache->GetPipeline(pipelineDescription);
+
+	// Mesh vertices in the first slots, one instance transform per cube in the slot after them.
+	FInputElementDesc vertexLayoutDescription[_countof(meshElements) + FInstanceBuffer::InputElementCount];
+	std::copy(meshElements, meshElements + meshElementCount, vertexLayoutDescription);
+	FInstanceBuffer::GetInputElements(cubeMesh.StreamCount, &vertexLayoutDescription[meshElementCount]);
+
+	pipelineDescription.VertexShader = instancedVertexShader;
+	pipelineDescription.InputLayout = pipelineStateCache->GetInputLayout(vertexLayoutDescription, meshElementCount + FInstanceBuffer::InputElementCount,
+		shaderBytecode[Shader_InstancedVertex]);
+
+	instancedPipeline = pipelineStateCache->GetPipeline(pipelineDescription);
+
+	if (simplePipeline == FPipelineStateCache::InvalidPipeline || instancedPipeline == FPipelineStateCache::InvalidPipeline)
 	{
 		return false;
 	}
 
-	d3dVertexShader = LoadShader<ID3D11VertexShader>(L"", "main", "latest");
-	d3dPixelShader = LoadShader<ID3D11PixelShader>(L"", "main", "latest");
-
 	// Setup the projection matrix.
 	RECT clientRectangle;
 	GetClientRect(windowHandle, &clientRectangle);
@@ -663,44 +930,461 @@ bool LoadContent()
 	float clientWidth = static_cast<float>(clientRectangle.right - clientRectangle.left);
 	float clientHeight = static_cast<float>(clientRectangle.bottom - clientRectangle.top);
 
-	projectionMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), clientWidth / clientHeight, 0.1f, 100.0f);
+	projectionMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), clientWidth / clientHeight, nearPlane, farPlane);
+	viewWidth = static_cast<uint32_t>(clientWidth);
+	viewHeight = static_cast<uint32_t>(clientHeight);
+
+	renderDevice->UpdateBuffer(applicationConstantBuffer, &projectionMatrix, sizeof(XMMATRIX));
+
+	cubeNode = sceneGraph.CreateNode();
+
+	// A slowly turning wall of small cubes behind the main one, all children of one node.
+	if (instancedCubesPerSide > 0)
+	{
+		const uint32_t cubeCount = instancedCubesPerSide * instancedCubesPerSide;
+		const float spacing = 0.75f;
+		const float extent = 0.5f * spacing * (instancedCubesPerSide - 1);
+
+		gridNode = sceneGraph.CreateNode();
+		sceneGraph.SetLocalPosition(gridNode, { 0.0f, 0.0f, 20.0f });
+
+		gridCubeEntities.reserve(cubeCount);
+		gridCubeBounds.resize(cubeCount);
+		for (uint32_t i = 0; i < cubeCount; ++i)
+		{
+			FFloat3 position = { spacing * (i % instancedCubesPerSide) - extent, spacing * (i / instancedCubesPerSide) - extent, 0.0f };
+
+			FSceneNodeHandle node = sceneGraph.CreateNode(gridNode);
+			sceneGraph.SetLocalTransform(node, position, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.25f, 0.25f, 0.25f });
+			FBvhProxyHandle proxy = sceneBounds.CreateProxy(cubeLocalBounds, i, EBvhProxyType::Static);
+			gridCubeEntities.push_back(entityWorld.CreateEntity(FSceneNodeComponent{ node }, FCullProxyComponent{ proxy, i }));
+		}
+
+		gridCubeQuery = &entityWorld.GetQuery(GetComponentMask<FSceneNodeComponent, FCullProxyComponent>());
+
+		instanceBuffer = new FInstanceBuffer(renderDevice, cubeCount);
+	}
 
-	d3dDeviceContext->UpdateSubresource(d3DConstantBuffers[CB_Application], 0, nullptr, &projectionMatrix, 0, 0);
+	// Nothing of the level is loaded here, the render thread requests the meshes once it runs.
+	if (levelPack.Open(levelPackFileName))
+	{
+		meshStreamer = new FMeshStreamer(levelPack, renderDevice, levelMemoryBudget, jobSystem);
+	}
 
 	return true;
 }
 
+// Destroys what LoadContent() created, once the render thread has stopped.
+void UnloadContent()
+{
+	delete meshStreamer;
+	meshStreamer = nullptr;
+	levelPack.Close();
+	levelDraws.clear();
+
+	delete instanceBuffer;
+	instanceBuffer = nullptr;
+	gridCubeQuery = nullptr;
+
+	if (vertexShader.IsValid())
+	{
+		renderDevice->DestroyVertexShader(vertexShader);
+		vertexShader = FVertexShaderHandle();
+	}
+
+	if (instancedVertexShader.IsValid())
+	{
+		renderDevice->DestroyVertexShader(instancedVertexShader);
+		instancedVertexShader = FVertexShaderHandle();
+	}
+
+	if (pixelShader.IsValid())
+	{
+		renderDevice->DestroyPixelShader(pixelShader);
+		pixelShader = FPixelShaderHandle();
+	}
+
+	DestroyMeshBuffers(renderDevice, cubeMesh);
+
+	if (applicationConstantBuffer.IsValid())
+	{
+		renderDevice->DestroyBuffer(applicationConstantBuffer);
+		applicationConstantBuffer = FBufferHandle();
+	}
+
+	delete constantBufferRing;
+	constantBufferRing = nullptr;
+
+	commandListPointers.clear();
+	commandLists.clear();
+
+	delete jobSystem;
+	jobSystem = nullptr;
+}
+
+// Advances the simulation by one fixed step. Runs on the main thread and must not touch the device.
 void Update(float deltaTime)
 {
+	MORPHEUS_PROFILE_FUNCTION();
+
 	XMVECTOR eyePosition = XMVectorSet(0, 0, -10, 1);
 	XMVECTOR focusPoint = XMVectorSet(0, 0, 0, 1);
 	XMVECTOR upDirection = XMVectorSet(0, 1, 0, 0);
 	viewMatrix = XMMatrixLookAtLH(eyePosition, focusPoint, upDirection);
-	d3dDeviceContext->UpdateSubresource(d3DConstantBuffers[CB_Frame], 0, nullptr, &viewMatrix, 0, 0);
 
+	previousAngle = currentAngle;
+	currentAngle += 90.0f * deltaTime;
+}
+
+// Captures the simulation state for the render thread, interpolated between the last two steps.
+void BuildFrameData(FFrameData& frame, FLinearArena& frameArena, float interpolationAlpha)
+{
+	MORPHEUS_PROFILE_FUNCTION();
+
+	float angle = previousAngle + (currentAngle - previousAngle) * interpolationAlpha;
+	FQuaternion rotation = QuaternionRotationAxis({ 0.0f, 1.0f, 1.0f }, XMConvertToRadians(angle));
+
+	sceneGraph.SetLocalRotation(cubeNode, rotation);
+	if (gridNode.IsValid())
+	{
+		sceneGraph.SetLocalRotation(gridNode, QuaternionRotationAxis({ 0.0f, 0.0f, 1.0f }, XMConvertToRadians(0.1f * angle)));
+	}
+
+	{
+		MORPHEUS_PROFILE_SCOPE("Scene graph");
+		sceneGraph.Update(jobSystem);
+	}
+
+	// A minimised window keeps the last size, there is nothing to resize to.
+	if (windowClientWidth > 0 && windowClientHeight > 0 && (windowClientWidth != viewWidth || windowClientHeight != viewHeight))
+	{
+		viewWidth = windowClientWidth;
+		viewHeight = windowClientHeight;
+		projectionMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), static_cast<float>(viewWidth) / viewHeight, nearPlane, farPlane);
+	}
+
+	frame.WorldMatrix = LoadMatrix(sceneGraph.GetWorldMatrix(cubeNode));
+	frame.ViewMatrix = viewMatrix;
+	frame.ProjectionMatrix = projectionMatrix;
+	frame.Width = viewWidth;
+	frame.Height = viewHeight;
+	frame.GridPosition = gridNode.IsValid() ? LoadMatrix(sceneGraph.GetWorldMatrix(gridNode)).r[3] : XMVectorZero();
 
-	static float angle = 0.0f;
-	angle += 90.0f * deltaTime;
-	XMVECTOR rotationAxis = XMVectorSet(0, 1, 1, 0);
+	// Only the cubes in view reach the instance buffer, the render thread packs them as they are.
+	{
+		MORPHEUS_PROFILE_SCOPE("Bounds");
+		if (gridCubeQuery)
+		{
+			// Serial, the tree is not thread safe.
+			entityWorld.ForEach<FSceneNodeComponent, FCullProxyComponent>(*gridCubeQuery, [](FEntity, FSceneNodeComponent& node, FCullProxyComponent& proxy)
+			{
+				gridCubeBounds[proxy.Index] = TransformBoundingBox(cubeLocalBounds, sceneGraph.GetWorldMatrix(node.Node));
+				sceneBounds.SetBounds(proxy.Proxy, gridCubeBounds[proxy.Index]);
+			});
+		}
+		sceneBounds.Update();
+	}
+
+	const FFloat4x4 viewProjection = StoreMatrix(XMMatrixMultiply(viewMatrix, projectionMatrix));
+	{
+		MORPHEUS_PROFILE_SCOPE("Culling");
+		visibleGridCubes.clear();
+		sceneBounds.QueryFrustum(FrustumFromViewProjection(viewProjection), visibleGridCubes);
+	}
+
+	{
+		MORPHEUS_PROFILE_SCOPE("Occlusion");
+		occlusionCuller.BeginFrame(viewProjection);
+		occlusionCuller.AddOccluderBox(cubeLocalBounds, sceneGraph.GetWorldMatrix(cubeNode));
+		occlusionCuller.Rasterize(jobSystem);
+		occlusionCuller.Cull(gridCubeBounds.data(), visibleGridCubes, jobSystem);
+	}
+
+	const FOcclusionCullingStats& occlusionStats = occlusionCuller.GetStats();
+	occlusionTestedInstances += occlusionStats.TestedObjects;
+	occlusionCulledInstances += occlusionStats.CulledObjects;
+	occlusionNanoseconds += occlusionStats.RasterNanoseconds + occlusionStats.TestNanoseconds;
+	++occlusionFrames;
+	MORPHEUS_PROFILE_COUNTER("Occluded instances", occlusionStats.CulledObjects);
+	MORPHEUS_PROFILE_COUNTER("Visible instances", visibleGridCubes.size());
 
-	worldMatrix = XMMatrixRotationAxis(rotationAxis, XMConvertToRadians(angle));
-	d3dDeviceContext->UpdateSubresource(d3DConstantBuffers[CB_Object], 0, nullptr, &worldMatrix, 0, 0);
+	FFloat4x4* instanceWorldMatrices = frameArena.AllocateArray<FFloat4x4>(visibleGridCubes.size());
+	for (size_t i = 0; i < visibleGridCubes.size(); ++i)
+	{
+		instanceWorldMatrices[i] = sceneGraph.GetWorldMatrix(entityWorld.GetComponent<FSceneNodeComponent>(gridCubeEntities[visibleGridCubes[i]])->Node);
+	}
+	frame.InstanceWorldMatrices = instanceWorldMatrices;
+	frame.InstanceCount = static_cast<uint32_t>(visibleGridCubes.size());
 }
 
 void Clear(const FLOAT clearColour[4], FLOAT clearDepth, UINT8 clearStencil)
 {
-	d3dDeviceContext->ClearRenderTargetView(d3dRenderTargetView, clearColour);
-	d3dDeviceContext->ClearDepthStencilView(d3dDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, clearDepth, clearStencil);
+	renderDevice->Clear(clearColour, clearDepth, clearStencil);
 }
 
 void Present(BOOL vSync)
 {
-	if (vSync)
+	MORPHEUS_PROFILE_FUNCTION();
+
+	renderDevice->Present(vSync != FALSE);
+}
+
+void Render(const FFrameData& frame)
+{
+	MORPHEUS_PROFILE_FUNCTION();
+
+	assert(renderDevice);
+
+	// Everything sized after the old back buffer goes with it.
+	FTextureDesc backBufferDescription = renderDevice->GetTextureDesc(renderDevice->GetBackBuffer());
+	if (frame.Width != backBufferDescription.Width || frame.Height != backBufferDescription.Height)
 	{
-		d3dSwapChain->Present(1, 0);
+		MORPHEUS_PROFILE_SCOPE("Resize");
+
+		if (!renderDevice->ResizeBackBuffer(frame.Width, frame.Height))
+		{
+			OutputDebugStringA("Could not resize the back buffer\n");
+		}
+		renderTargetPool->Reset();
+
+		backBufferDescription = renderDevice->GetTextureDesc(renderDevice->GetBackBuffer());
+		Viewport.Width = static_cast<float>(backBufferDescription.Width);
+		Viewport.Height = static_cast<float>(backBufferDescription.Height);
+		renderDevice->UpdateBuffer(applicationConstantBuffer, &frame.ProjectionMatrix, sizeof(XMMATRIX));
+	}
+
+	gpuProfiler->BeginFrame();
+
+	// Every constant of the frame is written before the first draw, so the ring maps each page once.
+	constantBufferRing->BeginFrame();
+	FConstantBufferAllocation frameConstants = constantBufferRing->Upload(&frame.ViewMatrix, sizeof(XMMATRIX));
+	FObjectConstants cubeConstants;
+	cubeConstants.WorldMatrix = frame.WorldMatrix;
+	cubeConstants.PositionScale = XMFLOAT4(cubeMesh.PositionQuantization.Scale.X, cubeMesh.PositionQuantization.Scale.Y, cubeMesh.PositionQuantization.Scale.Z, 0.0f);
+	cubeConstants.PositionOffset = XMFLOAT4(cubeMesh.PositionQuantization.Offset.X, cubeMesh.PositionQuantization.Offset.Y, cubeMesh.PositionQuantization.Offset.Z, 0.0f);
+	FConstantBufferAllocation objectConstants = constantBufferRing->Upload(&cubeConstants, sizeof(cubeConstants));
+
+	// Level meshes in range are requested by distance every frame and those out of range dropped if
+	// they are still on their way. Only meshes that share the layout of the cube can be drawn.
+	levelDraws.clear();
+	if (meshStreamer)
+	{
+		MORPHEUS_PROFILE_SCOPE("Streaming");
+
+		XMVECTOR eyePosition = XMMatrixInverse(nullptr, frame.ViewMatrix).r[3];
+		auto inRange = [eyePosition](uint32_t mesh, float& distance)
+		{
+			distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(GetLevelMeshPosition(mesh), eyePosition)));
+			return distance < levelViewDistance;
+		};
+
+		for (uint32_t mesh = 0; mesh < levelPack.GetMeshCount(); ++mesh)
+		{
+			float distance;
+			if (inRange(mesh, distance))
+			{
+				meshStreamer->Request(mesh, distance);
+			}
+			else
+			{
+				meshStreamer->Cancel(mesh);
+			}
+		}
+
+		meshStreamer->Update();
+
+		for (uint32_t mesh = 0; mesh < levelPack.GetMeshCount(); ++mesh)
+		{
+			float distance;
+			if (!inRange(mesh, distance) || meshStreamer->GetState(mesh) != EStreamingState::Resident)
+			{
+				continue;
+			}
+
+			const FMeshBuffers* levelMesh = meshStreamer->GetMesh(mesh);
+			if (levelMesh->StreamCount != cubeMesh.StreamCount ||
+				!std::equal(levelMesh->VertexStrides, levelMesh->VertexStrides + levelMesh->StreamCount, cubeMesh.VertexStrides))
+			{
+				continue;
+			}
+
+			FObjectConstants levelConstants;
+			levelConstants.WorldMatrix = XMMatrixTranslationFromVector(GetLevelMeshPosition(mesh));
+			levelConstants.PositionScale = XMFLOAT4(levelMesh->PositionQuantization.Scale.X, levelMesh->PositionQuantization.Scale.Y, levelMesh->PositionQuantization.Scale.Z, 0.0f);
+			levelConstants.PositionOffset = XMFLOAT4(levelMesh->PositionQuantization.Offset.X, levelMesh->PositionQuantization.Offset.Y, levelMesh->PositionQuantization.Offset.Z, 0.0f);
+
+			FLevelDraw draw = { levelMesh, constantBufferRing->Upload(&levelConstants, sizeof(levelConstants)),
+				XMVectorGetZ(XMVector3Transform(GetLevelMeshPosition(mesh), frame.ViewMatrix)) };
+			levelDraws.push_back(draw);
+		}
+	}
+
+	constantBufferRing->Commit();
+
+	if (instanceBuffer)
+	{
+		MORPHEUS_PROFILE_SCOPE("Instances");
+		instanceBuffer->Upload(frame.InstanceWorldMatrices, frame.InstanceCount, jobSystem);
+	}
+
+	drawList.Reset();
+
+	FDrawItem cube;
+	cube.Pipeline = pipelineStateCache->GetPipelineState(simplePipeline);
+	for (uint32_t stream = 0; stream < cubeMesh.StreamCount; ++stream)
+	{
+		cube.VertexBuffers[stream] = cubeMesh.VertexBuffers[stream];
+		cube.VertexStrides[stream] = cubeMesh.VertexStrides[stream];
+	}
+	cube.IndexBuffer = cubeMesh.IndexBuffer;
+	cube.IndexFormat = cubeMesh.IndexFormat;
+	cube.ConstantBuffers[CB_Application].Buffer = applicationConstantBuffer;
+	cube.ConstantBuffers[CB_Frame].Buffer = frameConstants.Buffer;
+	cube.ConstantBuffers[CB_Frame].Offset = frameConstants.Offset;
+	cube.ConstantBuffers[CB_Frame].Size = frameConstants.Size;
+	cube.ConstantBuffers[CB_Object].Buffer = objectConstants.Buffer;
+	cube.ConstantBuffers[CB_Object].Offset = objectConstants.Offset;
+	cube.ConstantBuffers[CB_Object].Size = objectConstants.Size;
+	cube.IndexCount = cubeMesh.IndexCount;
+
+	FDrawSortKeyFields cubeKey;
+	cubeKey.Pipeline = simplePipeline;
+	cubeKey.Depth = QuantizeDrawDepth(XMVectorGetZ(XMVector3Transform(frame.WorldMatrix.r[3], frame.ViewMatrix)), nearPlane, farPlane);
+	drawList.Add(MakeDrawSortKey(cubeKey), cube);
+
+	// The whole grid is one instanced draw of the same mesh.
+	if (instanceBuffer && instanceBuffer->GetInstanceCount() > 0)
+	{
+		FDrawItem grid = cube;
+		grid.Pipeline = pipelineStateCache->GetPipelineState(instancedPipeline);
+		grid.VertexBuffers[cubeMesh.StreamCount] = instanceBuffer->GetBuffer();
+		grid.VertexStrides[cubeMesh.StreamCount] = sizeof(FInstanceTransform);
+		// Keeps the object constants of the cube for the dequantisation, the world matrices come per instance.
+		grid.InstanceCount = instanceBuffer->GetInstanceCount();
+
+		FDrawSortKeyFields gridKey;
+		gridKey.Pipeline = instancedPipeline;
+		gridKey.Depth = QuantizeDrawDepth(XMVectorGetZ(XMVector3Transform(frame.GridPosition, frame.ViewMatrix)), nearPlane, farPlane);
+		drawList.Add(MakeDrawSortKey(gridKey), grid);
+	}
+
+	for (const FLevelDraw& levelDraw : levelDraws)
+	{
+		FDrawItem level = cube;
+		for (uint32_t stream = 0; stream < levelDraw.Mesh->StreamCount; ++stream)
+		{
+			level.VertexBuffers[stream] = levelDraw.Mesh->VertexBuffers[stream];
+		}
+		level.IndexBuffer = levelDraw.Mesh->IndexBuffer;
+		level.IndexFormat = levelDraw.Mesh->IndexFormat;
+		level.ConstantBuffers[CB_Object].Buffer = levelDraw.Constants.Buffer;
+		level.ConstantBuffers[CB_Object].Offset = levelDraw.Constants.Offset;
+		level.ConstantBuffers[CB_Object].Size = levelDraw.Constants.Size;
+		level.IndexCount = levelDraw.Mesh->IndexCount;
+
+		FDrawSortKeyFields levelKey;
+		levelKey.Pipeline = simplePipeline;
+		levelKey.Depth = QuantizeDrawDepth(levelDraw.ViewDepth, nearPlane, farPlane);
+		drawList.Add(MakeDrawSortKey(levelKey), level);
+	}
+
+	renderGraph.Reset();
+
+	FTextureDesc depthDescription;
+	depthDescription.Width = backBufferDescription.Width;
+	depthDescription.Height = backBufferDescription.Height;
+	depthDescription.Format = ETextureFormat::D24S8;
+	depthDescription.Bindings = TextureBinding_DepthStencil;
+
+	FRenderGraphTexture backBuffer = renderGraph.ImportTexture("Back buffer", renderDevice->GetBackBuffer(), backBufferDescription);
+	FRenderGraphTexture depthBuffer = renderGraph.CreateTexture("Depth buffer", depthDescription);
+
+	uint32_t scenePass = renderGraph.AddPass("Scene", [backBuffer, depthBuffer](IRenderDevice& device, const FRenderGraph& graph)
+	{
+		device.SetRenderTargets(graph.GetTexture(backBuffer), graph.GetTexture(depthBuffer));
+
+		{
+			MORPHEUS_PROFILE_GPU_SCOPE(gpuProfiler, "Clear");
+			Clear(Colors::CornflowerBlue, 1.0f, 0);
+		}
+
+		device.SetViewport(Viewport);
+
+		{
+			MORPHEUS_PROFILE_SCOPE("Submit");
+			MORPHEUS_PROFILE_GPU_SCOPE(gpuProfiler, "Draws");
+			drawList.SubmitParallel(&device, commandListPointers.data(), static_cast<uint32_t>(commandListPointers.size()), jobSystem);
+		}
+	});
+	renderGraph.Write(scenePass, backBuffer);
+	renderGraph.Write(scenePass, depthBuffer);
+
+	std::string graphError;
+	if (renderGraph.Compile(&graphError))
+	{
+		renderGraph.Execute(*renderDevice, *renderTargetPool);
+
+		if (renderGraph.GetStats().UnaliasedBytes > largestRenderGraph.UnaliasedBytes)
+		{
+			largestRenderGraph = renderGraph.GetStats();
+		}
 	}
 	else
 	{
-		d3dSwapChain->Present(0, 0);
+		OutputDebugStringA((graphError + "\n").c_str());
 	}
+
+	constantBufferRing->EndFrame();
+
+	const FRenderDeviceStats& deviceStats = renderDevice->GetFrameStats();
+	MORPHEUS_PROFILE_COUNTER("Draws", deviceStats.DrawCalls);
+	MORPHEUS_PROFILE_COUNTER("State changes", deviceStats.StateChanges);
+	MORPHEUS_PROFILE_COUNTER("Bytes uploaded", deviceStats.BytesUploaded);
+
+	gpuProfiler->EndFrame();
+
+	Present(enableVSync);
+
+	// Time to the first frame includes loading the content, later frames are measured present to present.
+	uint64_t presentTime = FHighResolutionClock::NowNanoseconds();
+	if (previousPresentTime == 0)
+	{
+		firstFrameNanoseconds = presentTime - startTime;
+	}
+	else
+	{
+		worstFrameNanoseconds = std::max(worstFrameNanoseconds, presentTime - previousPresentTime);
+	}
+	previousPresentTime = presentTime;
+
+	renderTargetPool->EndFrame();
+}
+
+// Releases what InitialiseDirectX() created. Anything the device still holds at this point was never
+// destroyed and is reported as a leak.
+void Cleanup()
+{
+	delete pipelineStateCache;
+	pipelineStateCache = nullptr;
+	delete renderTargetPool;
+	renderTargetPool = nullptr;
+	delete gpuProfiler;
+	gpuProfiler = nullptr;
+
+	if (renderDevice)
+	{
+		std::string leaks;
+		uint32_t leakCount = renderDevice->ReportLiveResources(leaks);
+		if (leakCount > 0)
+		{
+			OutputDebugStringA(("Leaked render resources: " + std::to_string(leakCount) + "\n" + leaks).c_str());
+		}
+
+		delete renderDevice;
+		renderDevice = nullptr;
+	}
+
+	SafeRelease(d3dSwapChain);
+	SafeRelease(d3dDeviceContext);
+	SafeRelease(d3dDevice);
 }
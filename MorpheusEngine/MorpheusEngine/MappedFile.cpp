@@ -0,0 +1,181 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FMappedFile::FMappedFile()
+	: Data(nullptr)
+	, Size(0)
+#if defined(_WIN32)
+	, FileHandle(nullptr)
+	, MappingHandle(nullptr)
+#endif
+{
+}
+
+FMappedFile::~FMappedFile()
+{
+	Close();
+}
+
+FMappedFile::FMappedFile(FMappedFile&& other)
+	: FMappedFile()
+{
+	*this = std::move(other);
+}
+
+FMappedFile& FMappedFile::operator=(FMappedFile&& other)
+{
+	if (this != &other)
+	{
+		Close();
+
+		std::swap(Data, other.Data);
+		std::swap(Size, other.Size);
+#if defined(_WIN32)
+		std::swap(FileHandle, other.FileHandle);
+		std::swap(MappingHandle, other.MappingHandle);
+#endif
+	}
+
+	return *this;
+}
+
+bool FMappedFile::Open(const char* path)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0 || static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	FileHandle = file;
+	MappingHandle = mapping;
+	Data = static_cast<const uint8_t*>(view);
+	Size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+	int descriptor = open(path, O_RDONLY);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size <= 0 || static_cast<uint64_t>(status.st_size) > SIZE_MAX)
+	{
+		close(descriptor);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// The mapping keeps its own reference to the file.
+	close(descriptor);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	Data = static_cast<const uint8_t*>(view);
+	Size = static_cast<uint64_t>(status.st_size);
+#endif
+
+	return true;
+}
+
+void FMappedFile::Close()
+{
+	if (!Data)
+	{
+		return;
+	}
+
+#if defined(_WIN32)
+	UnmapViewOfFile(Data);
+	CloseHandle(MappingHandle);
+	CloseHandle(FileHandle);
+	MappingHandle = nullptr;
+	FileHandle = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(Data), static_cast<size_t>(Size));
+#endif
+
+	Data = nullptr;
+	Size = 0;
+}
+
+bool FMappedFile::IsOpen() const
+{
+	return Data != nullptr;
+}
+
+const uint8_t* FMappedFile::GetData() const
+{
+	return Data;
+}
+
+uint64_t FMappedFile::GetSize() const
+{
+	return Size;
+}
+
+void FMappedFile::Prefetch(uint64_t offset, uint64_t size) const
+{
+	if (!Data || offset >= Size)
+	{
+		return;
+	}
+
+	size = std::min(size, Size - offset);
+
+#if defined(_WIN32)
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<uint8_t*>(Data + offset);
+	range.NumberOfBytes = static_cast<SIZE_T>(size);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	// madvise wants a page aligned start.
+	uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	uint64_t alignedOffset = offset - offset % pageSize;
+	madvise(const_cast<uint8_t*>(Data + alignedOffset), static_cast<size_t>(size + offset - alignedOffset), MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of a whole file in the address space. Nothing is read when the file is opened; pages
+// come in from the file cache the first time they are touched, and the OS may drop them again under
+// memory pressure because the file backs them.
+class FMappedFile
+{
+public:
+	FMappedFile();
+	~FMappedFile();
+
+	FMappedFile(FMappedFile&& other);
+	FMappedFile& operator=(FMappedFile&& other);
+
+	FMappedFile(const FMappedFile&) = delete;
+	FMappedFile& operator=(const FMappedFile&) = delete;
+
+	// Closes the current file first. Empty files fail, there is nothing to map.
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const;
+	const uint8_t* GetData() const;
+	uint64_t GetSize() const;
+
+	// Asks the OS to start reading the range in the background, so the first touch does not wait on
+	// the disk. Only a hint, the range is clamped to the file.
+	void Prefetch(uint64_t offset, uint64_t size) const;
+
+private:
+	const uint8_t* Data;
+	uint64_t Size;
+#if defined(_WIN32)
+	void* FileHandle;
+	void* MappingHandle;
+#endif
+};
@@ -0,0 +1,220 @@
+#include "MemoryArena.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	// Room in the block list before it has to grow; an arena that needs more than this many blocks in
+	// one cycle is merged on the next reset anyway.
+	const size_t ReservedBlockCount = 16;
+
+	size_t AlignOffset(uintptr_t address, size_t alignment)
+	{
+		return static_cast<size_t>((alignment - (address & (alignment - 1))) & (alignment - 1));
+	}
+}
+
+FLinearArena::FLinearArena(size_t blockSize)
+	: BlockSize(blockSize > 0 ? blockSize : DefaultBlockSize)
+	, CurrentBlock(0)
+	, CurrentOffset(0)
+	, BytesBeforeCurrentBlock(0)
+{
+	Blocks.reserve(ReservedBlockCount);
+	if (blockSize > 0)
+	{
+		AddBlock(blockSize);
+	}
+}
+
+FLinearArena::~FLinearArena()
+{
+	FreeBlocks();
+}
+
+void* FLinearArena::Allocate(size_t size, size_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	for (;;)
+	{
+		if (CurrentBlock < Blocks.size())
+		{
+			FBlock& block = Blocks[CurrentBlock];
+			size_t padding = AlignOffset(reinterpret_cast<uintptr_t>(block.Data + CurrentOffset), alignment);
+			if (padding <= block.Size - CurrentOffset && size <= block.Size - CurrentOffset - padding)
+			{
+				void* result = block.Data + CurrentOffset + padding;
+				CurrentOffset += padding + size;
+
+				++Stats.Allocations;
+				Stats.BytesAllocated += size;
+				Stats.PeakBytes = std::max<uint64_t>(Stats.PeakBytes, GetUsedBytes());
+				return result;
+			}
+
+			// Blocks kept after a rewind are tried in order before a new one is taken.
+			if (CurrentBlock + 1 < Blocks.size())
+			{
+				BytesBeforeCurrentBlock += block.Size;
+				++CurrentBlock;
+				CurrentOffset = 0;
+				continue;
+			}
+		}
+
+		if (size > SIZE_MAX - alignment)
+		{
+			throw std::bad_alloc();
+		}
+		AddBlock(size + alignment);
+		if (Blocks.size() > 1)
+		{
+			BytesBeforeCurrentBlock += Blocks[CurrentBlock].Size;
+			++CurrentBlock;
+		}
+		CurrentOffset = 0;
+	}
+}
+
+void FLinearArena::Reset()
+{
+	if (Blocks.size() > 1)
+	{
+		size_t totalSize = 0;
+		for (const FBlock& block : Blocks)
+		{
+			totalSize += block.Size;
+		}
+
+		FreeBlocks();
+		AddBlock(totalSize);
+	}
+
+	CurrentBlock = 0;
+	CurrentOffset = 0;
+	BytesBeforeCurrentBlock = 0;
+}
+
+FLinearArena::FMarker FLinearArena::GetMarker() const
+{
+	FMarker marker;
+	marker.Block = CurrentBlock;
+	marker.Offset = CurrentOffset;
+	return marker;
+}
+
+void FLinearArena::RewindTo(const FMarker& marker)
+{
+	assert(marker.Block < CurrentBlock || (marker.Block == CurrentBlock && marker.Offset <= CurrentOffset));
+
+	for (size_t block = marker.Block; block < CurrentBlock; ++block)
+	{
+		BytesBeforeCurrentBlock -= Blocks[block].Size;
+	}
+	CurrentBlock = marker.Block;
+	CurrentOffset = marker.Offset;
+}
+
+size_t FLinearArena::GetUsedBytes() const
+{
+	return BytesBeforeCurrentBlock + CurrentOffset;
+}
+
+size_t FLinearArena::GetCapacity() const
+{
+	return static_cast<size_t>(Stats.HeapBytes);
+}
+
+const FAllocatorStats& FLinearArena::GetStats() const
+{
+	return Stats;
+}
+
+void FLinearArena::ResetStats()
+{
+	uint64_t heapBytes = Stats.HeapBytes;
+	Stats = FAllocatorStats();
+	Stats.HeapBytes = heapBytes;
+}
+
+void FLinearArena::AddBlock(size_t minimumSize)
+{
+	// Grows geometrically, so a frame that keeps getting bigger needs few blocks.
+	size_t size = std::max(minimumSize, Blocks.empty() ? BlockSize : Blocks.back().Size * 2);
+
+	FBlock block;
+	block.Data = static_cast<uint8_t*>(::operator new(size));
+	block.Size = size;
+	Blocks.push_back(block);
+
+	++Stats.HeapAllocations;
+	Stats.HeapBytes += size;
+}
+
+void FLinearArena::FreeBlocks()
+{
+	for (const FBlock& block : Blocks)
+	{
+		::operator delete(block.Data);
+		Stats.HeapBytes -= block.Size;
+	}
+	Blocks.clear();
+}
+
+FFrameArenas::FFrameArenas(uint32_t frameCount, size_t blockSize)
+	: Current(0)
+{
+	Arenas.resize(frameCount > 0 ? frameCount : 1);
+	for (std::unique_ptr<FLinearArena>& arena : Arenas)
+	{
+		arena.reset(new FLinearArena(blockSize));
+	}
+}
+
+FLinearArena& FFrameArenas::BeginFrame()
+{
+	Current = (Current + 1) % static_cast<uint32_t>(Arenas.size());
+	Arenas[Current]->Reset();
+	return *Arenas[Current];
+}
+
+FLinearArena& FFrameArenas::GetCurrent()
+{
+	return *Arenas[Current];
+}
+
+uint32_t FFrameArenas::GetFrameCount() const
+{
+	return static_cast<uint32_t>(Arenas.size());
+}
+
+FAllocatorStats FFrameArenas::GetStats() const
+{
+	FAllocatorStats total;
+	for (const std::unique_ptr<FLinearArena>& arena : Arenas)
+	{
+		const FAllocatorStats& stats = arena->GetStats();
+		total.Allocations += stats.Allocations;
+		total.BytesAllocated += stats.BytesAllocated;
+		total.HeapAllocations += stats.HeapAllocations;
+		total.HeapBytes += stats.HeapBytes;
+		total.PeakBytes = std::max(total.PeakBytes, stats.PeakBytes);
+	}
+	return total;
+}
+
+void FFrameArenas::ResetStats()
+{
+	for (std::unique_ptr<FLinearArena>& arena : Arenas)
+	{
+		arena->ResetStats();
+	}
+}
+
+FLinearArena& GetScratchArena()
+{
+	thread_local FLinearArena scratchArena(FLinearArena::DefaultBlockSize);
+	return scratchArena;
+}
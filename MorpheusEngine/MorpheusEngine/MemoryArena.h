@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Counters of one allocator. Steady state is reached when HeapAllocations stops moving.
+struct FAllocatorStats
+{
+	// Requests served and the bytes they asked for.
+	uint64_t Allocations = 0;
+	uint64_t BytesAllocated = 0;
+	// Blocks taken from the general heap, and the bytes held from it right now.
+	uint64_t HeapAllocations = 0;
+	uint64_t HeapBytes = 0;
+	// Most bytes in use at once.
+	uint64_t PeakBytes = 0;
+};
+
+// Bump allocator for memory that is released all at once. Allocating advances an offset in the
+// current block; a block that is full is followed by a larger one from the heap, and Reset() merges
+// them into a single block of the combined size. An arena that has seen its largest frame therefore
+// never touches the heap again.
+//
+// Nothing allocated here is destroyed, so only trivially destructible types belong in it. Not thread
+// safe, every thread uses its own arena.
+class FLinearArena
+{
+public:
+	static const size_t DefaultBlockSize = 64 * 1024;
+
+	// A position to rewind to, which frees everything allocated after it.
+	struct FMarker
+	{
+		size_t Block = 0;
+		size_t Offset = 0;
+	};
+
+	// Allocates the first block lazily when blockSize is zero.
+	explicit FLinearArena(size_t blockSize = 0);
+	~FLinearArena();
+
+	FLinearArena(const FLinearArena&) = delete;
+	FLinearArena& operator=(const FLinearArena&) = delete;
+
+	// Never fails short of the heap itself; alignment must be a power of two.
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	// Uninitialised storage for count objects.
+	template<typename T>
+	T* AllocateArray(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "The arena never runs destructors.");
+		if (count > SIZE_MAX / sizeof(T))
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	template<typename T, typename... ArgumentTypes>
+	T* New(ArgumentTypes&&... arguments)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "The arena never runs destructors.");
+		return new (Allocate(sizeof(T), alignof(T))) T(std::forward<ArgumentTypes>(arguments)...);
+	}
+
+	// Frees everything and merges the blocks of the last cycle into one.
+	void Reset();
+
+	FMarker GetMarker() const;
+	// The blocks after the marker are kept and refilled before new ones are taken.
+	void RewindTo(const FMarker& marker);
+
+	size_t GetUsedBytes() const;
+	size_t GetCapacity() const;
+
+	const FAllocatorStats& GetStats() const;
+	// Clears the counters but keeps HeapBytes, which describes the memory still held.
+	void ResetStats();
+
+private:
+	struct FBlock
+	{
+		uint8_t* Data;
+		size_t Size;
+	};
+
+	void AddBlock(size_t minimumSize);
+	void FreeBlocks();
+
+	std::vector<FBlock> Blocks;
+	size_t BlockSize;
+	size_t CurrentBlock;
+	size_t CurrentOffset;
+	// Bytes of the blocks before the current one, counted as used whether they were filled or not.
+	size_t BytesBeforeCurrentBlock;
+	FAllocatorStats Stats;
+};
+
+// One arena for each frame in flight, used in the same round-robin order as the frame data of a
+// TFramePipeline. BeginFrame() resets the arena of the frame that left the pipeline longest ago, so
+// whatever a frame allocated stays valid until that frame has been rendered.
+class FFrameArenas
+{
+public:
+	FFrameArenas(uint32_t frameCount, size_t blockSize = FLinearArena::DefaultBlockSize);
+
+	FFrameArenas(const FFrameArenas&) = delete;
+	FFrameArenas& operator=(const FFrameArenas&) = delete;
+
+	// Moves on to the next arena and resets it.
+	FLinearArena& BeginFrame();
+	FLinearArena& GetCurrent();
+
+	uint32_t GetFrameCount() const;
+	// Summed over the frames, except PeakBytes which is the largest of one frame.
+	FAllocatorStats GetStats() const;
+	void ResetStats();
+
+private:
+	std::vector<std::unique_ptr<FLinearArena>> Arenas;
+	uint32_t Current;
+};
+
+// The scratch arena of the calling thread, for memory that does not outlive the function that took
+// it. Every thread gets its own the first time it asks, job workers when they start. Take an
+// FScratchScope before allocating, so the memory is returned when the scope ends.
+FLinearArena& GetScratchArena();
+
+class FScratchScope
+{
+public:
+	FScratchScope()
+		: Arena(GetScratchArena())
+		, Marker(Arena.GetMarker())
+	{
+	}
+
+	~FScratchScope()
+	{
+		Arena.RewindTo(Marker);
+	}
+
+	FScratchScope(const FScratchScope&) = delete;
+	FScratchScope& operator=(const FScratchScope&) = delete;
+
+	FLinearArena& GetArena()
+	{
+		return Arena;
+	}
+
+private:
+	FLinearArena& Arena;
+	FLinearArena::FMarker Marker;
+};
+
+// Lets standard containers allocate from an arena. Deallocation is a no-op, growth leaves the old
+// storage behind until the arena resets, so reserve up front where the size is known.
+template<typename T>
+class TArenaAllocator
+{
+public:
+	using value_type = T;
+
+	explicit TArenaAllocator(FLinearArena& arena)
+		: Arena(&arena)
+	{
+	}
+
+	template<typename U>
+	TArenaAllocator(const TArenaAllocator<U>& other)
+		: Arena(other.GetArena())
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		if (count > SIZE_MAX / sizeof(T))
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(Arena->Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T*, size_t)
+	{
+	}
+
+	FLinearArena* GetArena() const
+	{
+		return Arena;
+	}
+
+private:
+	FLinearArena* Arena;
+};
+
+template<typename T, typename U>
+bool operator==(const TArenaAllocator<T>& a, const TArenaAllocator<U>& b)
+{
+	return a.GetArena() == b.GetArena();
+}
+
+template<typename T, typename U>
+bool operator!=(const TArenaAllocator<T>& a, const TArenaAllocator<U>& b)
+{
+	return a.GetArena() != b.GetArena();
+}
+
+template<typename T>
+using TArenaVector = std::vector<T, TArenaAllocator<T>>;
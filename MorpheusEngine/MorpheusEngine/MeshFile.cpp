@@ -0,0 +1,923 @@
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// True when [offset, offset + size) lies inside the data and starts aligned.
+	bool IsValidRange(uint64_t offset, uint64_t size, uint64_t dataSize)
+	{
+		return offset % MeshFileAlignment == 0 && offset <= dataSize && size <= dataSize - offset;
+	}
+
+	uint32_t GetIndexSize(EIndexFormat format)
+	{
+		return format == EIndexFormat::UInt32 ? 4 : 2;
+	}
+
+	bool IsValidElement(const FMeshFileElement& element, uint32_t stride)
+	{
+		uint32_t size = GetVertexFormatSize(element.Format);
+
+		return element.Semantic < EMeshSemantic::NumberOfSemantics && size != 0 && element.Offset % 4 == 0 && element.Offset + size <= stride;
+	}
+
+	// The scale divides when encoding and shaders multiply by it, zero would flatten the mesh.
+	bool IsValidQuantization(const FPositionQuantization& quantization)
+	{
+		const float values[] = { quantization.Scale.X, quantization.Scale.Y, quantization.Scale.Z,
+			quantization.Offset.X, quantization.Offset.Y, quantization.Offset.Z };
+		for (float value : values)
+		{
+			if (!std::isfinite(value))
+			{
+				return false;
+			}
+		}
+
+		return quantization.Scale.X != 0.0f && quantization.Scale.Y != 0.0f && quantization.Scale.Z != 0.0f;
+	}
+
+	FBoundingBox MakeEmptyBox()
+	{
+		return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	}
+
+	void GrowBox(FBoundingBox& box, const FFloat3& point)
+	{
+		box.Min = { std::min(box.Min.X, point.X), std::min(box.Min.Y, point.Y), std::min(box.Min.Z, point.Z) };
+		box.Max = { std::max(box.Max.X, point.X), std::max(box.Max.Y, point.Y), std::max(box.Max.Z, point.Z) };
+	}
+
+	void GrowBox(FBoundingBox& box, const FBoundingBox& other)
+	{
+		if (other.Min.X <= other.Max.X)
+		{
+			GrowBox(box, other.Min);
+			GrowBox(box, other.Max);
+		}
+	}
+
+	bool SetError(std::string* error, const char* message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+
+		return false;
+	}
+
+	bool WritePadding(FILE* file, uint64_t size)
+	{
+		static const uint8_t zeros[MeshFileAlignment] = {};
+
+		return size == 0 || std::fwrite(zeros, 1, static_cast<size_t>(size), file) == size;
+	}
+}
+
+const char* GetMeshSemanticName(EMeshSemantic semantic)
+{
+	switch (semantic)
+	{
+		case EMeshSemantic::Position:
+			return "POSITION";
+
+		case EMeshSemantic::Normal:
+			return "NORMAL";
+
+		case EMeshSemantic::Colour:
+			return "COLOR";
+
+		case EMeshSemantic::TexCoord:
+			return "TEXCOORD";
+
+		case EMeshSemantic::Tangent:
+			return "TANGENT";
+
+		default:
+			return "";
+	}
+}
+
+FMeshFile::FMeshFile()
+	: Data(nullptr)
+	, Size(0)
+	, Header(nullptr)
+	, Streams(nullptr)
+	, Submeshes(nullptr)
+	, Meshlets(nullptr)
+	, Error(nullptr)
+{
+}
+
+bool FMeshFile::Open(const char* path)
+{
+	Close();
+
+	if (!File.Open(path))
+	{
+		return Fail("The mesh file could not be mapped");
+	}
+
+	return OpenMemory(File.GetData(), File.GetSize());
+}
+
+bool FMeshFile::OpenMemory(const void* data, uint64_t size)
+{
+	// Open() passes its own mapping.
+	if (data != File.GetData())
+	{
+		Close();
+	}
+
+	Data = static_cast<const uint8_t*>(data);
+	Size = size;
+
+	if (!Data || reinterpret_cast<uintptr_t>(Data) % MeshFileAlignment != 0)
+	{
+		return Fail("Mesh data is not aligned");
+	}
+
+	if (Size < sizeof(FMeshFileHeader))
+	{
+		return Fail("Mesh file is too small for its header");
+	}
+
+	Header = reinterpret_cast<const FMeshFileHeader*>(Data);
+	if (Header->Magic != MeshFileMagic)
+	{
+		return Fail("Not a mesh file");
+	}
+
+	if (Header->Version != MeshFileVersion || Header->HeaderSize != sizeof(FMeshFileHeader))
+	{
+		return Fail("Unsupported mesh file version, convert the source again");
+	}
+
+	if (Header->FileSize != Size)
+	{
+		return Fail("Mesh file is truncated");
+	}
+
+	if (Header->VertexCount == 0 || Header->StreamCount == 0 || Header->StreamCount > MaxMeshStreams ||
+		(Header->IndexFormat != EIndexFormat::UInt16 && Header->IndexFormat != EIndexFormat::UInt32) ||
+		!IsValidQuantization(Header->PositionQuantization))
+	{
+		return Fail("Mesh file header is corrupt");
+	}
+
+	if (!IsValidRange(Header->StreamTableOffset, uint64_t(Header->StreamCount) * sizeof(FMeshFileStream), Size) ||
+		!IsValidRange(Header->SubmeshTableOffset, uint64_t(Header->SubmeshCount) * sizeof(FMeshFileSubmesh), Size) ||
+		!IsValidRange(Header->IndexDataOffset, Header->IndexDataSize, Size) ||
+		Header->IndexDataSize != uint64_t(Header->IndexCount) * GetIndexSize(Header->IndexFormat) ||
+		!IsValidRange(Header->MeshletTableOffset, uint64_t(Header->MeshletCount) * sizeof(FMeshFileMeshlet), Size) ||
+		!IsValidRange(Header->MeshletVertexOffset, uint64_t(Header->MeshletVertexCount) * sizeof(uint32_t), Size) ||
+		!IsValidRange(Header->MeshletTriangleOffset, Header->MeshletTriangleSize, Size))
+	{
+		return Fail("Mesh file tables are out of range");
+	}
+
+	Streams = reinterpret_cast<const FMeshFileStream*>(Data + Header->StreamTableOffset);
+	for (uint32_t i = 0; i < Header->StreamCount; ++i)
+	{
+		const FMeshFileStream& stream = Streams[i];
+		if (stream.Stride == 0 || stream.Stride % 4 != 0 || stream.ElementCount == 0 || stream.ElementCount > MaxMeshStreamElements ||
+			stream.DataSize != uint64_t(Header->VertexCount) * stream.Stride || !IsValidRange(stream.DataOffset, stream.DataSize, Size))
+		{
+			return Fail("Mesh file vertex stream is corrupt");
+		}
+
+		for (uint32_t element = 0; element < stream.ElementCount; ++element)
+		{
+			if (!IsValidElement(stream.Elements[element], stream.Stride))
+			{
+				return Fail("Mesh file vertex element is corrupt");
+			}
+		}
+	}
+
+	// Index values are not scanned, that would touch every page. The converter checks them, and out of
+	// range vertex fetches read zero on the GPU.
+	Submeshes = reinterpret_cast<const FMeshFileSubmesh*>(Data + Header->SubmeshTableOffset);
+	for (uint32_t i = 0; i < Header->SubmeshCount; ++i)
+	{
+		if (uint64_t(Submeshes[i].FirstIndex) + Submeshes[i].IndexCount > Header->IndexCount)
+		{
+			return Fail("Mesh file submesh is out of range");
+		}
+	}
+
+	// Like the indices, the meshlet vertices and triangles are checked by the converter.
+	Meshlets = reinterpret_cast<const FMeshFileMeshlet*>(Data + Header->MeshletTableOffset);
+	for (uint32_t i = 0; i < Header->MeshletCount; ++i)
+	{
+		const FMeshFileMeshlet& meshlet = Meshlets[i];
+		if (meshlet.VertexCount > MaxMeshletVertices || uint64_t(meshlet.VertexOffset) + meshlet.VertexCount > Header->MeshletVertexCount ||
+			uint64_t(meshlet.TriangleOffset) + uint64_t(meshlet.TriangleCount) * 3 > Header->MeshletTriangleSize ||
+			meshlet.Submesh >= Header->SubmeshCount)
+		{
+			return Fail("Mesh file meshlet is out of range");
+		}
+	}
+
+	Error = nullptr;
+
+	return true;
+}
+
+void FMeshFile::Close()
+{
+	File.Close();
+	Data = nullptr;
+	Size = 0;
+	Header = nullptr;
+	Streams = nullptr;
+	Submeshes = nullptr;
+	Meshlets = nullptr;
+}
+
+bool FMeshFile::IsOpen() const
+{
+	return Header != nullptr;
+}
+
+const char* FMeshFile::GetError() const
+{
+	return Error ? Error : "";
+}
+
+const FMeshFileHeader& FMeshFile::GetHeader() const
+{
+	return *Header;
+}
+
+uint32_t FMeshFile::GetVertexCount() const
+{
+	return Header->VertexCount;
+}
+
+const FBoundingBox& FMeshFile::GetBounds() const
+{
+	return Header->Bounds;
+}
+
+const FPositionQuantization& FMeshFile::GetPositionQuantization() const
+{
+	return Header->PositionQuantization;
+}
+
+uint32_t FMeshFile::GetStreamCount() const
+{
+	return Header->StreamCount;
+}
+
+const FMeshFileStream& FMeshFile::GetStream(uint32_t stream) const
+{
+	return Streams[stream];
+}
+
+const uint8_t* FMeshFile::GetStreamData(uint32_t stream) const
+{
+	return Data + Streams[stream].DataOffset;
+}
+
+EIndexFormat FMeshFile::GetIndexFormat() const
+{
+	return Header->IndexFormat;
+}
+
+uint32_t FMeshFile::GetIndexCount() const
+{
+	return Header->IndexCount;
+}
+
+const void* FMeshFile::GetIndexData() const
+{
+	return Data + Header->IndexDataOffset;
+}
+
+uint32_t FMeshFile::GetSubmeshCount() const
+{
+	return Header->SubmeshCount;
+}
+
+const FMeshFileSubmesh& FMeshFile::GetSubmesh(uint32_t submesh) const
+{
+	return Submeshes[submesh];
+}
+
+uint32_t FMeshFile::GetMeshletCount() const
+{
+	return Header->MeshletCount;
+}
+
+const FMeshFileMeshlet& FMeshFile::GetMeshlet(uint32_t meshlet) const
+{
+	return Meshlets[meshlet];
+}
+
+const uint32_t* FMeshFile::GetMeshletVertices() const
+{
+	return reinterpret_cast<const uint32_t*>(Data + Header->MeshletVertexOffset);
+}
+
+const uint8_t* FMeshFile::GetMeshletTriangles() const
+{
+	return Data + Header->MeshletTriangleOffset;
+}
+
+uint32_t FMeshFile::GetInputElements(FInputElementDesc* elements, uint32_t capacity) const
+{
+	uint32_t count = 0;
+	for (uint32_t stream = 0; stream < Header->StreamCount; ++stream)
+	{
+		count += Streams[stream].ElementCount;
+	}
+
+	if (count > capacity)
+	{
+		return 0;
+	}
+
+	count = 0;
+	for (uint32_t stream = 0; stream < Header->StreamCount; ++stream)
+	{
+		for (uint32_t i = 0; i < Streams[stream].ElementCount; ++i)
+		{
+			const FMeshFileElement& element = Streams[stream].Elements[i];
+
+			FInputElementDesc& description = elements[count++];
+			description = FInputElementDesc();
+			description.SemanticName = GetMeshSemanticName(element.Semantic);
+			description.SemanticIndex = element.SemanticIndex;
+			description.Format = element.Format;
+			description.InputSlot = stream;
+			description.AlignedByteOffset = element.Offset;
+		}
+	}
+
+	return count;
+}
+
+const uint8_t* FMeshFile::GetData() const
+{
+	return Data;
+}
+
+uint64_t FMeshFile::GetSize() const
+{
+	return Size;
+}
+
+bool FMeshFile::Fail(const char* error)
+{
+	Close();
+	Error = error;
+
+	return false;
+}
+
+bool CreateMeshBuffers(IRenderDevice* renderDevice, const FMeshFile& mesh, FMeshBuffers& buffers)
+{
+	buffers = FMeshBuffers();
+
+	if (!mesh.IsOpen() || mesh.GetHeader().IndexDataSize > UINT32_MAX)
+	{
+		return false;
+	}
+
+	for (uint32_t stream = 0; stream < mesh.GetStreamCount(); ++stream)
+	{
+		const FMeshFileStream& streamHeader = mesh.GetStream(stream);
+		if (streamHeader.DataSize == 0 || streamHeader.DataSize > UINT32_MAX)
+		{
+			return false;
+		}
+
+		FBufferDesc description;
+		description.Binding = EBufferBinding::Vertex;
+		description.Usage = EResourceUsage::Immutable;
+		description.ByteWidth = static_cast<uint32_t>(streamHeader.DataSize);
+
+		buffers.VertexBuffers[stream] = renderDevice->CreateBuffer(description, mesh.GetStreamData(stream));
+		if (!buffers.VertexBuffers[stream].IsValid())
+		{
+			return false;
+		}
+
+		buffers.VertexStrides[stream] = streamHeader.Stride;
+	}
+
+	buffers.StreamCount = mesh.GetStreamCount();
+
+	if (mesh.GetIndexCount() > 0)
+	{
+		FBufferDesc description;
+		description.Binding = EBufferBinding::Index;
+		description.Usage = EResourceUsage::Immutable;
+		description.ByteWidth = static_cast<uint32_t>(mesh.GetHeader().IndexDataSize);
+
+		buffers.IndexBuffer = renderDevice->CreateBuffer(description, mesh.GetIndexData());
+		if (!buffers.IndexBuffer.IsValid())
+		{
+			return false;
+		}
+	}
+
+	buffers.IndexFormat = mesh.GetIndexFormat();
+	buffers.IndexCount = mesh.GetIndexCount();
+	buffers.PositionQuantization = mesh.GetPositionQuantization();
+
+	return true;
+}
+
+void DestroyMeshBuffers(IRenderDevice* renderDevice, FMeshBuffers& buffers)
+{
+	for (FBufferHandle& vertexBuffer : buffers.VertexBuffers)
+	{
+		if (vertexBuffer.IsValid())
+		{
+			renderDevice->DestroyBuffer(vertexBuffer);
+			vertexBuffer = FBufferHandle();
+		}
+	}
+
+	if (buffers.IndexBuffer.IsValid())
+	{
+		renderDevice->DestroyBuffer(buffers.IndexBuffer);
+		buffers.IndexBuffer = FBufferHandle();
+	}
+}
+
+FMeshPack::FMeshPack()
+	: Header(nullptr)
+	, Entries(nullptr)
+	, Error(nullptr)
+{
+}
+
+bool FMeshPack::Open(const char* path)
+{
+	Close();
+
+	if (!File.Open(path))
+	{
+		return Fail("The mesh pack could not be mapped");
+	}
+
+	const uint8_t* data = File.GetData();
+	uint64_t size = File.GetSize();
+	if (size < sizeof(FMeshPackHeader))
+	{
+		return Fail("Mesh pack is too small for its header");
+	}
+
+	Header = reinterpret_cast<const FMeshPackHeader*>(data);
+	if (Header->Magic != MeshPackMagic)
+	{
+		return Fail("Not a mesh pack");
+	}
+
+	if (Header->Version != MeshPackVersion || Header->HeaderSize != sizeof(FMeshPackHeader))
+	{
+		return Fail("Unsupported mesh pack version, build the pack again");
+	}
+
+	if (Header->FileSize != size)
+	{
+		return Fail("Mesh pack is truncated");
+	}
+
+	if (!IsValidRange(Header->EntryTableOffset, uint64_t(Header->EntryCount) * sizeof(FMeshPackEntry), size))
+	{
+		return Fail("Mesh pack entry table is out of range");
+	}
+
+	Entries = reinterpret_cast<const FMeshPackEntry*>(data + Header->EntryTableOffset);
+	for (uint32_t i = 0; i < Header->EntryCount; ++i)
+	{
+		if (!IsValidRange(Entries[i].Offset, Entries[i].Size, size) || Entries[i].Name[MaxMeshPackNameLength] != '\0')
+		{
+			return Fail("Mesh pack entry is corrupt");
+		}
+	}
+
+	Error = nullptr;
+
+	return true;
+}
+
+void FMeshPack::Close()
+{
+	File.Close();
+	Header = nullptr;
+	Entries = nullptr;
+}
+
+bool FMeshPack::IsOpen() const
+{
+	return Header != nullptr;
+}
+
+const char* FMeshPack::GetError() const
+{
+	return Error ? Error : "";
+}
+
+uint32_t FMeshPack::GetMeshCount() const
+{
+	return Header ? Header->EntryCount : 0;
+}
+
+const char* FMeshPack::GetMeshName(uint32_t mesh) const
+{
+	return Entries[mesh].Name;
+}
+
+uint32_t FMeshPack::FindMesh(const char* name) const
+{
+	for (uint32_t i = 0; i < GetMeshCount(); ++i)
+	{
+		if (std::strcmp(Entries[i].Name, name) == 0)
+		{
+			return i;
+		}
+	}
+
+	return ~0u;
+}
+
+bool FMeshPack::OpenMesh(uint32_t mesh, FMeshFile& meshFile) const
+{
+	return mesh < GetMeshCount() && meshFile.OpenMemory(File.GetData() + Entries[mesh].Offset, Entries[mesh].Size);
+}
+
+const uint8_t* FMeshPack::GetMeshData(uint32_t mesh) const
+{
+	assert(mesh < GetMeshCount());
+
+	return File.GetData() + Entries[mesh].Offset;
+}
+
+uint64_t FMeshPack::GetMeshSize(uint32_t mesh) const
+{
+	assert(mesh < GetMeshCount());
+
+	return Entries[mesh].Size;
+}
+
+void FMeshPack::Prefetch(uint32_t firstMesh, uint32_t meshCount) const
+{
+	uint32_t end = std::min(GetMeshCount(), firstMesh + meshCount);
+	if (firstMesh >= end)
+	{
+		return;
+	}
+
+	// Meshes are stored in entry order, so a run of entries is one range of the file.
+	uint64_t begin = Entries[firstMesh].Offset;
+	File.Prefetch(begin, Entries[end - 1].Offset + Entries[end - 1].Size - begin);
+}
+
+const FMappedFile& FMeshPack::GetFile() const
+{
+	return File;
+}
+
+bool FMeshPack::Fail(const char* error)
+{
+	Close();
+	Error = error;
+
+	return false;
+}
+
+const uint8_t* GetMeshDataPositions(const FMeshData& mesh, uint32_t& stride)
+{
+	for (const FMeshStreamData& stream : mesh.Streams)
+	{
+		for (const FMeshFileElement& element : stream.Elements)
+		{
+			if (element.Semantic == EMeshSemantic::Position && element.SemanticIndex == 0 && element.Format == EVertexFormat::Float3 &&
+				element.Offset + sizeof(FFloat3) <= stream.Stride && stream.Data.size() >= uint64_t(mesh.VertexCount) * stream.Stride)
+			{
+				stride = stream.Stride;
+				return stream.Data.data() + element.Offset;
+			}
+		}
+	}
+
+	stride = 0;
+	return nullptr;
+}
+
+bool SerializeMeshFile(const FMeshData& mesh, std::vector<uint8_t>& bytes, std::string* error)
+{
+	if (mesh.VertexCount == 0 || mesh.Streams.empty() || mesh.Streams.size() > MaxMeshStreams)
+	{
+		return SetError(error, "A mesh needs vertices in one to four streams");
+	}
+
+	for (const FMeshStreamData& stream : mesh.Streams)
+	{
+		if (stream.Stride == 0 || stream.Stride % 4 != 0 || stream.Elements.empty() || stream.Elements.size() > MaxMeshStreamElements)
+		{
+			return SetError(error, "Vertex streams need a stride that is a multiple of four and one to eight elements");
+		}
+
+		if (stream.Data.size() != uint64_t(mesh.VertexCount) * stream.Stride)
+		{
+			return SetError(error, "Vertex stream size does not match the vertex count");
+		}
+
+		for (const FMeshFileElement& element : stream.Elements)
+		{
+			if (!IsValidElement(element, stream.Stride))
+			{
+				return SetError(error, "Vertex element is outside its stream or misaligned");
+			}
+		}
+	}
+
+	if (!IsValidQuantization(mesh.PositionQuantization))
+	{
+		return SetError(error, "Position quantization needs a finite, nonzero scale");
+	}
+
+	// The positions for the bounds, in any format that holds three components.
+	const uint8_t* positions = nullptr;
+	uint32_t positionStride = 0;
+	EVertexFormat positionFormat = EVertexFormat::Float3;
+	for (const FMeshStreamData& stream : mesh.Streams)
+	{
+		for (const FMeshFileElement& element : stream.Elements)
+		{
+			if (!positions && element.Semantic == EMeshSemantic::Position && element.SemanticIndex == 0 && element.Format != EVertexFormat::Float2 &&
+				element.Format != EVertexFormat::Short2Norm)
+			{
+				positions = stream.Data.data() + element.Offset;
+				positionStride = stream.Stride;
+				positionFormat = element.Format;
+			}
+		}
+	}
+
+	const FPositionQuantization& quantization = mesh.PositionQuantization;
+
+	std::vector<FMeshFileSubmesh> submeshes = mesh.Submeshes;
+	if (submeshes.empty())
+	{
+		FMeshFileSubmesh submesh = {};
+		submesh.IndexCount = static_cast<uint32_t>(mesh.Indices.size());
+		submeshes.push_back(submesh);
+	}
+
+	// Check every index once here, so loading never has to, and pick the smallest index format.
+	uint32_t largestIndex = 0;
+	FBoundingBox bounds = MakeEmptyBox();
+
+	for (FMeshFileSubmesh& submesh : submeshes)
+	{
+		if (uint64_t(submesh.FirstIndex) + submesh.IndexCount > mesh.Indices.size())
+		{
+			return SetError(error, "Submesh index range is outside the index data");
+		}
+
+		submesh.Bounds = MakeEmptyBox();
+		submesh.Reserved[0] = 0;
+		submesh.Reserved[1] = 0;
+
+		for (uint32_t i = submesh.FirstIndex; i < submesh.FirstIndex + submesh.IndexCount; ++i)
+		{
+			int64_t vertex = int64_t(mesh.Indices[i]) + submesh.BaseVertex;
+			if (vertex < 0 || vertex >= mesh.VertexCount)
+			{
+				return SetError(error, "Index refers to a vertex that does not exist");
+			}
+
+			largestIndex = std::max(largestIndex, mesh.Indices[i]);
+
+			if (positions)
+			{
+				float value[4];
+				ReadVertexElement(positions + size_t(vertex) * positionStride, positionFormat, value);
+				FFloat3 position = { value[0] * quantization.Scale.X + quantization.Offset.X, value[1] * quantization.Scale.Y + quantization.Offset.Y,
+					value[2] * quantization.Scale.Z + quantization.Offset.Z };
+				GrowBox(submesh.Bounds, position);
+			}
+		}
+
+		GrowBox(bounds, submesh.Bounds);
+	}
+
+	for (const FMeshFileMeshlet& meshlet : mesh.Meshlets)
+	{
+		if (meshlet.VertexCount > MaxMeshletVertices || uint64_t(meshlet.VertexOffset) + meshlet.VertexCount > mesh.MeshletVertices.size() ||
+			uint64_t(meshlet.TriangleOffset) + uint64_t(meshlet.TriangleCount) * 3 > mesh.MeshletTriangles.size() ||
+			meshlet.Submesh >= submeshes.size())
+		{
+			return SetError(error, "Meshlet is outside the meshlet data");
+		}
+
+		for (uint32_t i = 0; i < meshlet.TriangleCount * 3; ++i)
+		{
+			if (mesh.MeshletTriangles[meshlet.TriangleOffset + i] >= meshlet.VertexCount)
+			{
+				return SetError(error, "Meshlet triangle refers to a vertex outside its meshlet");
+			}
+		}
+	}
+
+	for (uint32_t vertex : mesh.MeshletVertices)
+	{
+		if (vertex >= mesh.VertexCount)
+		{
+			return SetError(error, "Meshlet refers to a vertex that does not exist");
+		}
+	}
+
+	FMeshFileHeader header = {};
+	header.Magic = MeshFileMagic;
+	header.Version = MeshFileVersion;
+	header.HeaderSize = sizeof(FMeshFileHeader);
+	header.VertexCount = mesh.VertexCount;
+	header.IndexCount = static_cast<uint32_t>(mesh.Indices.size());
+	header.StreamCount = static_cast<uint32_t>(mesh.Streams.size());
+	header.SubmeshCount = static_cast<uint32_t>(submeshes.size());
+	header.MeshletCount = static_cast<uint32_t>(mesh.Meshlets.size());
+	header.MeshletVertexCount = static_cast<uint32_t>(mesh.MeshletVertices.size());
+	header.IndexFormat = largestIndex <= UINT16_MAX ? EIndexFormat::UInt16 : EIndexFormat::UInt32;
+	header.Bounds = bounds;
+	header.PositionQuantization = quantization;
+
+	uint64_t offset = AlignUp(sizeof(FMeshFileHeader), MeshFileAlignment);
+	header.StreamTableOffset = offset;
+	offset = AlignUp(offset + header.StreamCount * sizeof(FMeshFileStream), MeshFileAlignment);
+	header.SubmeshTableOffset = offset;
+	offset = AlignUp(offset + header.SubmeshCount * sizeof(FMeshFileSubmesh), MeshFileAlignment);
+	header.MeshletTableOffset = offset;
+	offset = AlignUp(offset + header.MeshletCount * sizeof(FMeshFileMeshlet), MeshFileAlignment);
+
+	std::vector<FMeshFileStream> streams(mesh.Streams.size());
+	for (size_t i = 0; i < mesh.Streams.size(); ++i)
+	{
+		FMeshFileStream& stream = streams[i];
+		stream = FMeshFileStream();
+		stream.DataOffset = offset;
+		stream.DataSize = mesh.Streams[i].Data.size();
+		stream.Stride = mesh.Streams[i].Stride;
+		stream.ElementCount = static_cast<uint32_t>(mesh.Streams[i].Elements.size());
+		std::copy(mesh.Streams[i].Elements.begin(), mesh.Streams[i].Elements.end(), stream.Elements);
+
+		offset = AlignUp(offset + stream.DataSize, MeshFileAlignment);
+	}
+
+	header.IndexDataOffset = offset;
+	header.IndexDataSize = uint64_t(header.IndexCount) * GetIndexSize(header.IndexFormat);
+	offset = AlignUp(offset + header.IndexDataSize, MeshFileAlignment);
+	header.MeshletVertexOffset = offset;
+	offset = AlignUp(offset + uint64_t(header.MeshletVertexCount) * sizeof(uint32_t), MeshFileAlignment);
+	header.MeshletTriangleOffset = offset;
+	header.MeshletTriangleSize = mesh.MeshletTriangles.size();
+	header.FileSize = AlignUp(offset + header.MeshletTriangleSize, MeshFileAlignment);
+
+	if (header.FileSize > SIZE_MAX)
+	{
+		return SetError(error, "Mesh is too large for this platform");
+	}
+
+	bytes.assign(static_cast<size_t>(header.FileSize), 0);
+	uint8_t* data = bytes.data();
+
+	std::memcpy(data, &header, sizeof(header));
+	std::memcpy(data + header.StreamTableOffset, streams.data(), streams.size() * sizeof(FMeshFileStream));
+	std::memcpy(data + header.SubmeshTableOffset, submeshes.data(), submeshes.size() * sizeof(FMeshFileSubmesh));
+	if (!mesh.Meshlets.empty())
+	{
+		std::memcpy(data + header.MeshletTableOffset, mesh.Meshlets.data(), mesh.Meshlets.size() * sizeof(FMeshFileMeshlet));
+	}
+
+	for (size_t i = 0; i < mesh.Streams.size(); ++i)
+	{
+		if (!mesh.Streams[i].Data.empty())
+		{
+			std::memcpy(data + streams[i].DataOffset, mesh.Streams[i].Data.data(), mesh.Streams[i].Data.size());
+		}
+	}
+
+	if (header.IndexFormat == EIndexFormat::UInt16)
+	{
+		uint16_t* indices = reinterpret_cast<uint16_t*>(data + header.IndexDataOffset);
+		for (size_t i = 0; i < mesh.Indices.size(); ++i)
+		{
+			indices[i] = static_cast<uint16_t>(mesh.Indices[i]);
+		}
+	}
+	else if (!mesh.Indices.empty())
+	{
+		std::memcpy(data + header.IndexDataOffset, mesh.Indices.data(), mesh.Indices.size() * sizeof(uint32_t));
+	}
+
+	if (!mesh.MeshletVertices.empty())
+	{
+		std::memcpy(data + header.MeshletVertexOffset, mesh.MeshletVertices.data(), mesh.MeshletVertices.size() * sizeof(uint32_t));
+	}
+
+	if (!mesh.MeshletTriangles.empty())
+	{
+		std::memcpy(data + header.MeshletTriangleOffset, mesh.MeshletTriangles.data(), mesh.MeshletTriangles.size());
+	}
+
+	return true;
+}
+
+bool WriteMeshFile(const char* path, const FMeshData& mesh, std::string* error)
+{
+	std::vector<uint8_t> bytes;
+	if (!SerializeMeshFile(mesh, bytes, error))
+	{
+		return false;
+	}
+
+	FILE* file = std::fopen(path, "wb");
+	if (!file)
+	{
+		return SetError(error, "Could not create the mesh file");
+	}
+
+	bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	written = std::fclose(file) == 0 && written;
+
+	return written || SetError(error, "Could not write the mesh file");
+}
+
+bool WriteMeshPack(const char* path, const std::vector<FMeshPackSource>& meshes, std::string* error)
+{
+	FMeshPackHeader header = {};
+	header.Magic = MeshPackMagic;
+	header.Version = MeshPackVersion;
+	header.HeaderSize = sizeof(FMeshPackHeader);
+	header.EntryCount = static_cast<uint32_t>(meshes.size());
+	header.EntryTableOffset = AlignUp(sizeof(FMeshPackHeader), MeshFileAlignment);
+
+	// Lay out the whole pack first, then write it front to back.
+	std::vector<FMeshPackEntry> entries(meshes.size());
+	uint64_t offset = AlignUp(header.EntryTableOffset + entries.size() * sizeof(FMeshPackEntry), MeshFileAlignment);
+
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		if (meshes[i].Name.empty() || meshes[i].Name.size() > MaxMeshPackNameLength)
+		{
+			return SetError(error, "Mesh names in a pack need one to 47 characters");
+		}
+
+		entries[i] = FMeshPackEntry();
+		std::memcpy(entries[i].Name, meshes[i].Name.c_str(), meshes[i].Name.size());
+		entries[i].Offset = offset;
+		entries[i].Size = meshes[i].Size;
+
+		offset = AlignUp(offset + meshes[i].Size, MeshFileAlignment);
+	}
+
+	header.FileSize = offset;
+
+	FILE* file = std::fopen(path, "wb");
+	if (!file)
+	{
+		return SetError(error, "Could not create the mesh pack");
+	}
+
+	uint64_t position = sizeof(header);
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+	written = written && WritePadding(file, header.EntryTableOffset - position);
+	position = header.EntryTableOffset;
+
+	if (!entries.empty())
+	{
+		written = written && std::fwrite(entries.data(), sizeof(FMeshPackEntry), entries.size(), file) == entries.size();
+		position += entries.size() * sizeof(FMeshPackEntry);
+	}
+
+	for (size_t i = 0; i < meshes.size() && written; ++i)
+	{
+		written = WritePadding(file, entries[i].Offset - position) &&
+			std::fwrite(meshes[i].Data, 1, static_cast<size_t>(meshes[i].Size), file) == meshes[i].Size;
+		position = entries[i].Offset + meshes[i].Size;
+	}
+
+	written = written && WritePadding(file, header.FileSize - position);
+	written = std::fclose(file) == 0 && written;
+
+	return written || SetError(error, "Could not write the mesh pack");
+}
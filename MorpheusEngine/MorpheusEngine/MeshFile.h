@@ -0,0 +1,324 @@
+#pragma once
+
+#include "BoundingVolumeHierarchy.h"
+#include "MappedFile.h"
+#include "RenderDevice.h"
+#include "VertexFormat.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary mesh container. The file holds the vertex and index data exactly as the buffers want them,
+// so loading is mapping the file, checking the tables and handing pointers into the mapping to
+// CreateBuffer. Nothing is parsed or copied on the CPU, and the load costs what the page-in costs.
+//
+// Layout, little endian, every section starting on a MeshFileAlignment boundary:
+//   FMeshFileHeader
+//   FMeshFileStream[StreamCount]
+//   FMeshFileSubmesh[SubmeshCount]
+//   FMeshFileMeshlet[MeshletCount]
+//   vertex data of every stream, VertexCount * Stride bytes each
+//   index data, IndexCount 16 or 32 bit indices
+//   meshlet vertices, MeshletVertexCount 32 bit vertex indices
+//   meshlet triangles, MeshletTriangleSize bytes of 8 bit indices into the meshlet vertices
+//
+// Readers accept exactly MeshFileVersion. Files are rebuilt by the converter rather than upgraded,
+// so bump the version with every layout change.
+const uint32_t MeshFileMagic = 0x48534d4d; // "MMSH"
+const uint16_t MeshFileVersion = 3;
+const uint32_t MeshFileAlignment = 16;
+const uint32_t MaxMeshStreams = 4;
+const uint32_t MaxMeshStreamElements = 8;
+const uint32_t MaxMeshletVertices = 256;
+
+// Stored in the files, only append.
+enum class EMeshSemantic : uint8_t
+{
+	Position,
+	Normal,
+	Colour,
+	TexCoord,
+	Tangent,
+	NumberOfSemantics
+};
+
+// HLSL semantic name of an input element.
+const char* GetMeshSemanticName(EMeshSemantic semantic);
+
+struct FMeshFileElement
+{
+	EMeshSemantic Semantic;
+	uint8_t SemanticIndex;
+	EVertexFormat Format;
+	// Byte offset in the vertex, below the stride.
+	uint8_t Offset;
+};
+
+struct FMeshFileStream
+{
+	uint64_t DataOffset;
+	uint64_t DataSize;
+	uint32_t Stride;
+	uint32_t ElementCount;
+	FMeshFileElement Elements[MaxMeshStreamElements];
+	uint64_t Reserved;
+};
+
+struct FMeshFileSubmesh
+{
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	int32_t BaseVertex;
+	uint32_t MaterialIndex;
+	FBoundingBox Bounds;
+	uint32_t Reserved[2];
+};
+
+// A small cluster of triangles of one submesh, for culling clusters instead of whole meshes. The
+// cluster faces away from a camera at c, and can be skipped, when
+// dot(normalize(ConeApex - c), ConeAxis) > ConeCutoff.
+struct FMeshFileMeshlet
+{
+	uint32_t VertexOffset;
+	// In bytes, three per triangle.
+	uint32_t TriangleOffset;
+	uint32_t VertexCount;
+	uint32_t TriangleCount;
+	FFloat3 Centre;
+	float Radius;
+	FFloat3 ConeApex;
+	float ConeCutoff;
+	FFloat3 ConeAxis;
+	uint32_t Submesh;
+};
+
+struct FMeshFileHeader
+{
+	uint32_t Magic;
+	uint16_t Version;
+	uint16_t HeaderSize;
+	uint64_t FileSize;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t StreamCount;
+	uint32_t SubmeshCount;
+	EIndexFormat IndexFormat;
+	uint8_t Reserved[7];
+	uint64_t StreamTableOffset;
+	uint64_t SubmeshTableOffset;
+	uint64_t IndexDataOffset;
+	uint64_t IndexDataSize;
+	// Of every vertex referenced by a submesh, in mesh space.
+	FBoundingBox Bounds;
+	uint32_t MeshletCount;
+	uint32_t MeshletVertexCount;
+	uint64_t MeshletTableOffset;
+	uint64_t MeshletVertexOffset;
+	uint64_t MeshletTriangleOffset;
+	uint64_t MeshletTriangleSize;
+	// Identity unless the positions are Short4Norm.
+	FPositionQuantization PositionQuantization;
+	uint64_t Reserved1;
+};
+
+static_assert(sizeof(FMeshFileElement) == 4, "Mesh file element layout changed");
+static_assert(sizeof(FMeshFileStream) == 64, "Mesh file stream layout changed");
+static_assert(sizeof(FMeshFileSubmesh) == 48, "Mesh file submesh layout changed");
+static_assert(sizeof(FMeshFileMeshlet) == 64, "Mesh file meshlet layout changed");
+static_assert(sizeof(FMeshFileHeader) == 168, "Mesh file header layout changed");
+
+// A validated mesh file, either mapped by Open() or viewed in memory that somebody else owns, like a
+// mesh inside a pack. Every accessor points into that memory.
+class FMeshFile
+{
+public:
+	FMeshFile();
+
+	FMeshFile(const FMeshFile&) = delete;
+	FMeshFile& operator=(const FMeshFile&) = delete;
+
+	bool Open(const char* path);
+	// The data must start on a MeshFileAlignment boundary and outlive the mesh.
+	bool OpenMemory(const void* data, uint64_t size);
+	void Close();
+
+	bool IsOpen() const;
+	// Why the last Open() or OpenMemory() failed.
+	const char* GetError() const;
+
+	const FMeshFileHeader& GetHeader() const;
+	uint32_t GetVertexCount() const;
+	const FBoundingBox& GetBounds() const;
+	const FPositionQuantization& GetPositionQuantization() const;
+
+	uint32_t GetStreamCount() const;
+	const FMeshFileStream& GetStream(uint32_t stream) const;
+	const uint8_t* GetStreamData(uint32_t stream) const;
+
+	EIndexFormat GetIndexFormat() const;
+	uint32_t GetIndexCount() const;
+	const void* GetIndexData() const;
+
+	uint32_t GetSubmeshCount() const;
+	const FMeshFileSubmesh& GetSubmesh(uint32_t submesh) const;
+
+	// Zero when the converter did not build meshlets.
+	uint32_t GetMeshletCount() const;
+	const FMeshFileMeshlet& GetMeshlet(uint32_t meshlet) const;
+	const uint32_t* GetMeshletVertices() const;
+	const uint8_t* GetMeshletTriangles() const;
+
+	// Input layout of the vertex streams, stream n in input slot n. Returns the element count, at most
+	// MaxMeshStreams * MaxMeshStreamElements, or zero when they do not fit in capacity.
+	uint32_t GetInputElements(FInputElementDesc* elements, uint32_t capacity) const;
+
+	// The file or memory the mesh was opened from.
+	const uint8_t* GetData() const;
+	uint64_t GetSize() const;
+
+private:
+	bool Fail(const char* error);
+
+	FMappedFile File;
+	const uint8_t* Data;
+	uint64_t Size;
+	const FMeshFileHeader* Header;
+	const FMeshFileStream* Streams;
+	const FMeshFileSubmesh* Submeshes;
+	const FMeshFileMeshlet* Meshlets;
+	const char* Error;
+};
+
+// Device buffers of one mesh.
+struct FMeshBuffers
+{
+	FBufferHandle VertexBuffers[MaxMeshStreams];
+	uint32_t VertexStrides[MaxMeshStreams] = {};
+	uint32_t StreamCount = 0;
+	FBufferHandle IndexBuffer;
+	EIndexFormat IndexFormat = EIndexFormat::UInt16;
+	uint32_t IndexCount = 0;
+	// For the object constants of the draws.
+	FPositionQuantization PositionQuantization = GetIdentityPositionQuantization();
+};
+
+// Creates immutable buffers straight from the mesh data. The device copies the data during the call,
+// the mesh file can be closed afterwards.
+bool CreateMeshBuffers(IRenderDevice* renderDevice, const FMeshFile& mesh, FMeshBuffers& buffers);
+// Destroys whatever buffers were created, also after CreateMeshBuffers() failed half way, and resets
+// the handles.
+void DestroyMeshBuffers(IRenderDevice* renderDevice, FMeshBuffers& buffers);
+
+// Mesh packs ("MPAK") hold many mesh files in one, so a level maps a single file. The entry table
+// follows the header and every mesh starts on a MeshFileAlignment boundary.
+const uint32_t MeshPackMagic = 0x4b41504d; // "MPAK"
+const uint16_t MeshPackVersion = 1;
+const uint32_t MaxMeshPackNameLength = 47;
+
+struct FMeshPackHeader
+{
+	uint32_t Magic;
+	uint16_t Version;
+	uint16_t HeaderSize;
+	uint32_t EntryCount;
+	uint32_t Reserved;
+	uint64_t FileSize;
+	uint64_t EntryTableOffset;
+};
+
+struct FMeshPackEntry
+{
+	// Zero terminated.
+	char Name[MaxMeshPackNameLength + 1];
+	uint64_t Offset;
+	uint64_t Size;
+};
+
+static_assert(sizeof(FMeshPackHeader) == 32, "Mesh pack header layout changed");
+static_assert(sizeof(FMeshPackEntry) == 64, "Mesh pack entry layout changed");
+
+// A mapped mesh pack. Opening checks the entry table only; every mesh is validated when it is opened.
+class FMeshPack
+{
+public:
+	FMeshPack();
+
+	FMeshPack(const FMeshPack&) = delete;
+	FMeshPack& operator=(const FMeshPack&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const;
+	const char* GetError() const;
+
+	uint32_t GetMeshCount() const;
+	const char* GetMeshName(uint32_t mesh) const;
+	// Returns ~0u when the pack has no mesh of that name.
+	uint32_t FindMesh(const char* name) const;
+	// The mesh views the pack, which must stay open while the mesh is used.
+	bool OpenMesh(uint32_t mesh, FMeshFile& meshFile) const;
+	// Where the mesh file lies in the mapping, for readers that page it in before opening it.
+	const uint8_t* GetMeshData(uint32_t mesh) const;
+	uint64_t GetMeshSize(uint32_t mesh) const;
+
+	// Starts reading the meshes in the background, see FMappedFile::Prefetch().
+	void Prefetch(uint32_t firstMesh, uint32_t meshCount) const;
+
+	const FMappedFile& GetFile() const;
+
+private:
+	bool Fail(const char* error);
+
+	FMappedFile File;
+	const FMeshPackHeader* Header;
+	const FMeshPackEntry* Entries;
+	const char* Error;
+};
+
+// Offline side, used by the converter and the benchmarks.
+
+struct FMeshStreamData
+{
+	uint32_t Stride = 0;
+	std::vector<FMeshFileElement> Elements;
+	// VertexCount * Stride bytes.
+	std::vector<uint8_t> Data;
+};
+
+// A mesh in memory before it is written. Submesh bounds are computed by the writer.
+struct FMeshData
+{
+	uint32_t VertexCount = 0;
+	std::vector<FMeshStreamData> Streams;
+	std::vector<uint32_t> Indices;
+	// Empty writes one submesh over every index.
+	std::vector<FMeshFileSubmesh> Submeshes;
+	// Optional, built by OptimizeMesh().
+	std::vector<FMeshFileMeshlet> Meshlets;
+	std::vector<uint32_t> MeshletVertices;
+	std::vector<uint8_t> MeshletTriangles;
+	// Set by QuantizeMeshVertices().
+	FPositionQuantization PositionQuantization = GetIdentityPositionQuantization();
+};
+
+// The Float3 Position element of the mesh, or null when it has none.
+const uint8_t* GetMeshDataPositions(const FMeshData& mesh, uint32_t& stride);
+
+// Builds the file image of a mesh. Indices are stored as 16 bit when every vertex can be addressed
+// with them, and the bounds come from the Position element, dequantised. Fails when the mesh does not
+// describe valid data.
+bool SerializeMeshFile(const FMeshData& mesh, std::vector<uint8_t>& bytes, std::string* error = nullptr);
+bool WriteMeshFile(const char* path, const FMeshData& mesh, std::string* error = nullptr);
+
+struct FMeshPackSource
+{
+	std::string Name;
+	// A complete mesh file image.
+	const uint8_t* Data = nullptr;
+	uint64_t Size = 0;
+};
+
+// Writes the meshes one after another, so the pack never has to fit in memory.
+bool WriteMeshPack(const char* path, const std::vector<FMeshPackSource>& meshes, std::string* error = nullptr);
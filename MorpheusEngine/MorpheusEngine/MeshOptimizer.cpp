@@ -0,0 +1,833 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+	// Forsyth's constants. The modelled cache is larger than the hardware one, which keeps the order
+	// good across cache sizes.
+	const uint32_t ForsythCacheSize = 32;
+	const float ForsythDecayPower = 1.5f;
+	const float ForsythLastTriangleScore = 0.75f;
+	const float ForsythValenceBoostScale = 2.0f;
+	const float ForsythValenceBoostPower = 0.5f;
+	const uint32_t ForsythValenceTableSize = 32;
+
+	// The cache the overdraw clusters are found with.
+	const uint32_t OverdrawCacheSize = 16;
+
+	const uint32_t FetchCacheLineSize = 64;
+	const uint32_t FetchCacheLineCount = 256;
+
+	struct FForsythTables
+	{
+		float CachePosition[ForsythCacheSize];
+		float Valence[ForsythValenceTableSize];
+
+		FForsythTables()
+		{
+			for (uint32_t i = 0; i < ForsythCacheSize; ++i)
+			{
+				// The three vertices of the last triangle score the same, they are in the cache whichever
+				// way it is ordered.
+				CachePosition[i] = i < 3 ? ForsythLastTriangleScore :
+					std::pow(1.0f - float(i - 3) / float(ForsythCacheSize - 3), ForsythDecayPower);
+			}
+
+			for (uint32_t i = 0; i < ForsythValenceTableSize; ++i)
+			{
+				Valence[i] = ValenceScore(i);
+			}
+		}
+
+		static float ValenceScore(uint32_t remainingTriangles)
+		{
+			return remainingTriangles == 0 ? 0.0f : ForsythValenceBoostScale * std::pow(float(remainingTriangles), -ForsythValenceBoostPower);
+		}
+
+		float Score(int32_t cachePosition, uint32_t remainingTriangles) const
+		{
+			if (remainingTriangles == 0)
+			{
+				return -1.0f;
+			}
+
+			float score = cachePosition >= 0 ? CachePosition[cachePosition] : 0.0f;
+
+			return score + (remainingTriangles < ForsythValenceTableSize ? Valence[remainingTriangles] : ValenceScore(remainingTriangles));
+		}
+	};
+
+	// Triangles of every vertex, compressed rows.
+	struct FVertexTriangles
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Counts;
+		std::vector<uint32_t> Triangles;
+
+		FVertexTriangles(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+			: Offsets(vertexCount + 1, 0)
+			, Counts(vertexCount, 0)
+			, Triangles(indexCount)
+		{
+			for (uint32_t i = 0; i < indexCount; ++i)
+			{
+				++Counts[indices[i]];
+			}
+
+			for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+			{
+				Offsets[vertex + 1] = Offsets[vertex] + Counts[vertex];
+				Counts[vertex] = 0;
+			}
+
+			for (uint32_t i = 0; i < indexCount; ++i)
+			{
+				uint32_t vertex = indices[i];
+				Triangles[Offsets[vertex] + Counts[vertex]++] = i / 3;
+			}
+		}
+	};
+
+	FFloat3 LoadPosition(const uint8_t* positions, uint32_t stride, uint32_t vertex)
+	{
+		FFloat3 position;
+		std::memcpy(&position, positions + size_t(vertex) * stride, sizeof(position));
+
+		return position;
+	}
+
+	FFloat3 Subtract(const FFloat3& a, const FFloat3& b)
+	{
+		return { a.X - b.X, a.Y - b.Y, a.Z - b.Z };
+	}
+
+	FFloat3 Cross(const FFloat3& a, const FFloat3& b)
+	{
+		return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X };
+	}
+
+	float Dot(const FFloat3& a, const FFloat3& b)
+	{
+		return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+	}
+
+	// Counts the vertices of a triangle that miss a FIFO cache. A vertex is cached while fewer than
+	// cacheSize misses happened since it was loaded.
+	uint32_t UpdateFifoCache(const uint32_t* triangle, std::vector<uint32_t>& loadTimes, uint32_t& time, uint32_t cacheSize)
+	{
+		uint32_t misses = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = triangle[corner];
+			if (time - loadTimes[vertex] > cacheSize)
+			{
+				loadTimes[vertex] = time++;
+				++misses;
+			}
+		}
+
+		return misses;
+	}
+
+	bool SetError(std::string* error, const char* message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+
+		return false;
+	}
+
+	FVertexFetchStats AnalyzeMeshFetch(const FMeshData& mesh)
+	{
+		FVertexFetchStats stats;
+		uint32_t vertexSize = 0;
+		for (const FMeshStreamData& stream : mesh.Streams)
+		{
+			stats.BytesFetched += AnalyzeVertexFetch(mesh.Indices.data(), static_cast<uint32_t>(mesh.Indices.size()), mesh.VertexCount, stream.Stride).BytesFetched;
+			vertexSize += stream.Stride;
+		}
+
+		std::vector<uint8_t> used(mesh.VertexCount, 0);
+		uint32_t usedCount = 0;
+		for (uint32_t index : mesh.Indices)
+		{
+			usedCount += used[index] == 0;
+			used[index] = 1;
+		}
+
+		stats.Overfetch = usedCount ? float(double(stats.BytesFetched) / (double(usedCount) * vertexSize)) : 0.0f;
+
+		return stats;
+	}
+
+	// Greedy meshlets over the triangles in draw order, which after the cache optimisation keeps every
+	// meshlet a compact patch.
+	void BuildSubmeshMeshlets(FMeshData& mesh, uint32_t submesh, uint32_t firstIndex, uint32_t indexCount, uint32_t maxVertices,
+		uint32_t maxTriangles, std::vector<uint32_t>& localIndices)
+	{
+		FMeshFileMeshlet meshlet = {};
+		meshlet.Submesh = submesh;
+
+		auto finish = [&]()
+		{
+			if (meshlet.TriangleCount == 0)
+			{
+				return;
+			}
+
+			for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+			{
+				localIndices[mesh.MeshletVertices[meshlet.VertexOffset + i]] = ~0u;
+			}
+
+			mesh.Meshlets.push_back(meshlet);
+
+			meshlet.VertexOffset = static_cast<uint32_t>(mesh.MeshletVertices.size());
+			meshlet.TriangleOffset = static_cast<uint32_t>(mesh.MeshletTriangles.size());
+			meshlet.VertexCount = 0;
+			meshlet.TriangleCount = 0;
+		};
+
+		meshlet.VertexOffset = static_cast<uint32_t>(mesh.MeshletVertices.size());
+		meshlet.TriangleOffset = static_cast<uint32_t>(mesh.MeshletTriangles.size());
+
+		for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3)
+		{
+			const uint32_t* triangle = &mesh.Indices[i];
+
+			// Degenerate triangles repeat vertices, which only count once.
+			uint32_t newVertices = (localIndices[triangle[0]] == ~0u) +
+				(localIndices[triangle[1]] == ~0u && triangle[1] != triangle[0]) +
+				(localIndices[triangle[2]] == ~0u && triangle[2] != triangle[0] && triangle[2] != triangle[1]);
+
+			if (meshlet.VertexCount + newVertices > maxVertices || meshlet.TriangleCount + 1 > maxTriangles)
+			{
+				finish();
+			}
+
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t vertex = triangle[corner];
+				if (localIndices[vertex] == ~0u)
+				{
+					localIndices[vertex] = meshlet.VertexCount++;
+					mesh.MeshletVertices.push_back(vertex);
+				}
+
+				mesh.MeshletTriangles.push_back(static_cast<uint8_t>(localIndices[vertex]));
+			}
+
+			++meshlet.TriangleCount;
+		}
+
+		finish();
+	}
+}
+
+FVertexCacheStats AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	FVertexCacheStats stats;
+
+	// Start every vertex far enough in the past to miss.
+	std::vector<uint32_t> loadTimes(vertexCount, 0);
+	std::vector<uint8_t> used(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	uint32_t usedCount = 0;
+
+	for (uint32_t i = 0; i + 3 <= indexCount; i += 3)
+	{
+		stats.VerticesTransformed += UpdateFifoCache(indices + i, loadTimes, time, cacheSize);
+		++stats.TrianglesProcessed;
+
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			usedCount += used[indices[i + corner]] == 0;
+			used[indices[i + corner]] = 1;
+		}
+	}
+
+	stats.Acmr = stats.TrianglesProcessed ? float(stats.VerticesTransformed) / float(stats.TrianglesProcessed) : 0.0f;
+	stats.Atvr = usedCount ? float(stats.VerticesTransformed) / float(usedCount) : 0.0f;
+
+	return stats;
+}
+
+FVertexFetchStats AnalyzeVertexFetch(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t vertexSize)
+{
+	FVertexFetchStats stats;
+	if (vertexSize == 0)
+	{
+		return stats;
+	}
+
+	uint64_t lineCount = (uint64_t(vertexCount) * vertexSize + FetchCacheLineSize - 1) / FetchCacheLineSize;
+	std::vector<uint32_t> loadTimes(static_cast<size_t>(lineCount), 0);
+	std::vector<uint8_t> used(vertexCount, 0);
+	uint32_t time = FetchCacheLineCount + 1;
+	uint32_t usedCount = 0;
+
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t vertex = indices[i];
+		usedCount += used[vertex] == 0;
+		used[vertex] = 1;
+
+		uint64_t begin = uint64_t(vertex) * vertexSize / FetchCacheLineSize;
+		uint64_t end = (uint64_t(vertex) * vertexSize + vertexSize - 1) / FetchCacheLineSize;
+		for (uint64_t line = begin; line <= end; ++line)
+		{
+			if (time - loadTimes[line] > FetchCacheLineCount)
+			{
+				loadTimes[line] = time++;
+				stats.BytesFetched += FetchCacheLineSize;
+			}
+		}
+	}
+
+	stats.Overfetch = usedCount ? float(double(stats.BytesFetched) / (double(usedCount) * vertexSize)) : 0.0f;
+
+	return stats;
+}
+
+void OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+	static const FForsythTables tables;
+
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Work on a copy, so destination may be the source.
+	std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+	FVertexTriangles adjacency(source.data(), triangleCount * 3, vertexCount);
+
+	// Counts double as the triangles each vertex has left.
+	std::vector<uint32_t>& remaining = adjacency.Counts;
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+	{
+		vertexScores[vertex] = tables.Score(-1, remaining[vertex]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		const uint32_t* corners = &source[triangle * 3];
+		triangleScores[triangle] = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+	}
+
+	// Three extra entries for the vertices pushed in before the oldest ones fall out.
+	uint32_t cache[ForsythCacheSize + 3];
+	uint32_t newCache[ForsythCacheSize + 3];
+	uint32_t cacheCount = 0;
+
+	uint32_t bestTriangle = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	uint32_t cursor = 0;
+
+	for (uint32_t output = 0; output < triangleCount; ++output)
+	{
+		if (bestTriangle == ~0u)
+		{
+			// Nothing in the cache has triangles left, continue with the next triangle in input order.
+			// Forsyth rescans every triangle here, which is quadratic on meshes of many small parts.
+			while (emitted[cursor])
+			{
+				++cursor;
+			}
+			bestTriangle = cursor;
+		}
+
+		const uint32_t* corners = &source[bestTriangle * 3];
+		destination[output * 3 + 0] = corners[0];
+		destination[output * 3 + 1] = corners[1];
+		destination[output * 3 + 2] = corners[2];
+		emitted[bestTriangle] = 1;
+
+		// Take the triangle out of the lists of its vertices.
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = corners[corner];
+			uint32_t* triangles = &adjacency.Triangles[adjacency.Offsets[vertex]];
+			uint32_t count = remaining[vertex];
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				if (triangles[i] == bestTriangle)
+				{
+					triangles[i] = triangles[count - 1];
+					--remaining[vertex];
+					break;
+				}
+			}
+		}
+
+		// The triangle moves to the front of the cache.
+		uint32_t newCount = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = corners[corner];
+			if (std::find(newCache, newCache + newCount, vertex) == newCache + newCount)
+			{
+				newCache[newCount++] = vertex;
+			}
+		}
+
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			uint32_t vertex = cache[i];
+			if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+			{
+				newCache[newCount++] = vertex;
+			}
+		}
+
+		// Rescore every vertex that was or is cached, and the triangles still using them.
+		for (uint32_t i = 0; i < newCount; ++i)
+		{
+			uint32_t vertex = newCache[i];
+			cachePositions[vertex] = i < ForsythCacheSize ? static_cast<int32_t>(i) : -1;
+			vertexScores[vertex] = tables.Score(cachePositions[vertex], remaining[vertex]);
+		}
+
+		bestTriangle = ~0u;
+		float bestScore = -1.0f;
+		for (uint32_t i = 0; i < newCount; ++i)
+		{
+			uint32_t vertex = newCache[i];
+			const uint32_t* triangles = &adjacency.Triangles[adjacency.Offsets[vertex]];
+			for (uint32_t j = 0; j < remaining[vertex]; ++j)
+			{
+				uint32_t triangle = triangles[j];
+				const uint32_t* triangleCorners = &source[triangle * 3];
+				float score = vertexScores[triangleCorners[0]] + vertexScores[triangleCorners[1]] + vertexScores[triangleCorners[2]];
+				triangleScores[triangle] = score;
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = triangle;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, ForsythCacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+}
+
+void OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, uint32_t indexCount, const uint8_t* positions, uint32_t positionStride,
+	uint32_t vertexCount, float threshold)
+{
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+
+	// Hard boundaries, where all three vertices of a triangle miss and the cache starts over anyway.
+	std::vector<uint32_t> loadTimes(vertexCount, 0);
+	uint32_t time = OverdrawCacheSize + 1;
+
+	std::vector<uint32_t> hardBoundaries;
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		if (UpdateFifoCache(&source[triangle * 3], loadTimes, time, OverdrawCacheSize) == 3 || triangle == 0)
+		{
+			hardBoundaries.push_back(triangle);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries split every hard cluster wherever its ACMR so far is already close to the ACMR of
+	// the whole cluster, so the split costs little.
+	std::vector<uint32_t> clusters;
+	for (size_t hard = 0; hard + 1 < hardBoundaries.size(); ++hard)
+	{
+		uint32_t begin = hardBoundaries[hard];
+		uint32_t end = hardBoundaries[hard + 1];
+
+		// Moving the clock past the cache size empties the cache.
+		time += OverdrawCacheSize + 1;
+		uint32_t clusterMisses = 0;
+		for (uint32_t triangle = begin; triangle < end; ++triangle)
+		{
+			clusterMisses += UpdateFifoCache(&source[triangle * 3], loadTimes, time, OverdrawCacheSize);
+		}
+
+		float clusterThreshold = threshold * float(clusterMisses) / float(end - begin);
+
+		time += OverdrawCacheSize + 1;
+		clusters.push_back(begin);
+		uint32_t runningMisses = 0;
+		uint32_t runningTriangles = 0;
+		for (uint32_t triangle = begin; triangle < end; ++triangle)
+		{
+			runningMisses += UpdateFifoCache(&source[triangle * 3], loadTimes, time, OverdrawCacheSize);
+			++runningTriangles;
+
+			if (float(runningMisses) / float(runningTriangles) <= clusterThreshold)
+			{
+				// Every cluster starts with a cold cache once they are sorted.
+				clusters.push_back(triangle + 1);
+				time += OverdrawCacheSize + 1;
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+
+		// The rest after the last split rarely reaches the threshold and would be a short cluster of
+		// poor ACMR, so it joins the one before. That also drops a split at the very end.
+		if (clusters.back() != begin)
+		{
+			clusters.pop_back();
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	uint32_t clusterCount = static_cast<uint32_t>(clusters.size() - 1);
+
+	FFloat3 meshCentre = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+	{
+		FFloat3 position = LoadPosition(positions, positionStride, source[i]);
+		meshCentre = { meshCentre.X + position.X, meshCentre.Y + position.Y, meshCentre.Z + position.Z };
+	}
+
+	float inverseCount = 1.0f / float(triangleCount * 3);
+	meshCentre = { meshCentre.X * inverseCount, meshCentre.Y * inverseCount, meshCentre.Z * inverseCount };
+
+	// Clusters facing outwards from the centre occlude the rest, so they sort first.
+	std::vector<float> sortKeys(clusterCount);
+	for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+	{
+		FFloat3 centroid = { 0.0f, 0.0f, 0.0f };
+		FFloat3 normal = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+
+		for (uint32_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; ++triangle)
+		{
+			FFloat3 p0 = LoadPosition(positions, positionStride, source[triangle * 3 + 0]);
+			FFloat3 p1 = LoadPosition(positions, positionStride, source[triangle * 3 + 1]);
+			FFloat3 p2 = LoadPosition(positions, positionStride, source[triangle * 3 + 2]);
+
+			// Twice the area, weighting both sums.
+			FFloat3 triangleNormal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+			float triangleArea = std::sqrt(Dot(triangleNormal, triangleNormal));
+
+			centroid.X += (p0.X + p1.X + p2.X) * triangleArea;
+			centroid.Y += (p0.Y + p1.Y + p2.Y) * triangleArea;
+			centroid.Z += (p0.Z + p1.Z + p2.Z) * triangleArea;
+			normal = { normal.X + triangleNormal.X, normal.Y + triangleNormal.Y, normal.Z + triangleNormal.Z };
+			area += triangleArea;
+		}
+
+		float inverseArea = area > 0.0f ? 1.0f / (3.0f * area) : 0.0f;
+		centroid = { centroid.X * inverseArea, centroid.Y * inverseArea, centroid.Z * inverseArea };
+
+		float normalLength = std::sqrt(Dot(normal, normal));
+		float inverseLength = normalLength > 0.0f ? 1.0f / normalLength : 0.0f;
+		normal = { normal.X * inverseLength, normal.Y * inverseLength, normal.Z * inverseLength };
+
+		sortKeys[cluster] = Dot(Subtract(centroid, meshCentre), normal);
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	uint32_t output = 0;
+	for (uint32_t cluster : order)
+	{
+		uint32_t begin = clusters[cluster] * 3;
+		uint32_t end = clusters[cluster + 1] * 3;
+		std::copy(source.begin() + begin, source.begin() + end, destination + output);
+		output += end - begin;
+	}
+}
+
+uint32_t OptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+	std::fill(remap, remap + vertexCount, ~0u);
+
+	uint32_t nextVertex = 0;
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		if (remap[indices[i]] == ~0u)
+		{
+			remap[indices[i]] = nextVertex++;
+		}
+	}
+
+	return nextVertex;
+}
+
+void ComputeMeshletBounds(FMeshFileMeshlet& meshlet, const uint32_t* meshletVertices, const uint8_t* meshletTriangles, const uint8_t* positions,
+	uint32_t positionStride)
+{
+	meshlet.Centre = { 0.0f, 0.0f, 0.0f };
+	meshlet.Radius = 0.0f;
+	meshlet.ConeApex = { 0.0f, 0.0f, 0.0f };
+	meshlet.ConeAxis = { 0.0f, 0.0f, 0.0f };
+	meshlet.ConeCutoff = 1.0f;
+
+	if (meshlet.VertexCount == 0 || !positions)
+	{
+		return;
+	}
+
+	// Sphere around the box, which is close enough for culling and simple.
+	FFloat3 minimum = LoadPosition(positions, positionStride, meshletVertices[meshlet.VertexOffset]);
+	FFloat3 maximum = minimum;
+	for (uint32_t i = 1; i < meshlet.VertexCount; ++i)
+	{
+		FFloat3 position = LoadPosition(positions, positionStride, meshletVertices[meshlet.VertexOffset + i]);
+		minimum = { std::min(minimum.X, position.X), std::min(minimum.Y, position.Y), std::min(minimum.Z, position.Z) };
+		maximum = { std::max(maximum.X, position.X), std::max(maximum.Y, position.Y), std::max(maximum.Z, position.Z) };
+	}
+
+	FFloat3 centre = { 0.5f * (minimum.X + maximum.X), 0.5f * (minimum.Y + maximum.Y), 0.5f * (minimum.Z + maximum.Z) };
+	float radiusSquared = 0.0f;
+	for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+	{
+		FFloat3 offset = Subtract(LoadPosition(positions, positionStride, meshletVertices[meshlet.VertexOffset + i]), centre);
+		radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+	}
+
+	meshlet.Centre = centre;
+	meshlet.Radius = std::sqrt(radiusSquared);
+
+	// Unit normals of the triangles; degenerate triangles face nowhere and are left out.
+	std::vector<FFloat3> normals;
+	std::vector<FFloat3> corners;
+	normals.reserve(meshlet.TriangleCount);
+	corners.reserve(meshlet.TriangleCount);
+
+	FFloat3 axis = { 0.0f, 0.0f, 0.0f };
+	const uint8_t* triangles = meshletTriangles + meshlet.TriangleOffset;
+	for (uint32_t triangle = 0; triangle < meshlet.TriangleCount; ++triangle)
+	{
+		FFloat3 p0 = LoadPosition(positions, positionStride, meshletVertices[meshlet.VertexOffset + triangles[triangle * 3 + 0]]);
+		FFloat3 p1 = LoadPosition(positions, positionStride, meshletVertices[meshlet.VertexOffset + triangles[triangle * 3 + 1]]);
+		FFloat3 p2 = LoadPosition(positions, positionStride, meshletVertices[meshlet.VertexOffset + triangles[triangle * 3 + 2]]);
+
+		FFloat3 normal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+		float length = std::sqrt(Dot(normal, normal));
+		if (length == 0.0f)
+		{
+			continue;
+		}
+
+		normal = { normal.X / length, normal.Y / length, normal.Z / length };
+		normals.push_back(normal);
+		corners.push_back(p0);
+		axis = { axis.X + normal.X, axis.Y + normal.Y, axis.Z + normal.Z };
+	}
+
+	float axisLength = std::sqrt(Dot(axis, axis));
+	if (normals.empty() || axisLength == 0.0f)
+	{
+		return;
+	}
+
+	axis = { axis.X / axisLength, axis.Y / axisLength, axis.Z / axisLength };
+
+	float minimumDot = 1.0f;
+	for (const FFloat3& normal : normals)
+	{
+		minimumDot = std::min(minimumDot, Dot(normal, axis));
+	}
+
+	// Past about 84 degrees between the axis and a normal the cone culls almost nothing.
+	if (minimumDot <= 0.1f)
+	{
+		return;
+	}
+
+	// Move the apex back along the axis until it is behind the plane of every triangle, then every
+	// direction inside the cone from the apex sees only back faces.
+	float maximumDistance = 0.0f;
+	for (size_t i = 0; i < normals.size(); ++i)
+	{
+		float distance = Dot(Subtract(centre, corners[i]), normals[i]) / Dot(axis, normals[i]);
+		maximumDistance = std::max(maximumDistance, distance);
+	}
+
+	meshlet.ConeApex = { centre.X - axis.X * maximumDistance, centre.Y - axis.Y * maximumDistance, centre.Z - axis.Z * maximumDistance };
+	meshlet.ConeAxis = axis;
+	meshlet.ConeCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+}
+
+bool OptimizeMesh(FMeshData& mesh, const FMeshOptimizeOptions& options, FMeshOptimizeStats* stats, std::string* error)
+{
+	uint32_t indexCount = static_cast<uint32_t>(mesh.Indices.size());
+	if (indexCount % 3 != 0)
+	{
+		return SetError(error, "Only triangle lists can be optimised");
+	}
+
+	if (options.MaxMeshletVertices < 3 || options.MaxMeshletVertices > MaxMeshletVertices || options.MaxMeshletTriangles == 0)
+	{
+		return SetError(error, "Meshlets need three to 256 vertices and at least one triangle");
+	}
+
+	// Work on absolute indices, sorted submeshes make overlaps easy to find.
+	std::vector<FMeshFileSubmesh> submeshes = mesh.Submeshes;
+	if (submeshes.empty())
+	{
+		FMeshFileSubmesh submesh = {};
+		submesh.IndexCount = indexCount;
+		submeshes.push_back(submesh);
+	}
+
+	std::vector<uint32_t> order(submeshes.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return submeshes[a].FirstIndex < submeshes[b].FirstIndex;
+	});
+
+	uint64_t previousEnd = 0;
+	for (uint32_t submesh : order)
+	{
+		const FMeshFileSubmesh& range = submeshes[submesh];
+		if (range.FirstIndex % 3 != 0 || range.IndexCount % 3 != 0 || uint64_t(range.FirstIndex) + range.IndexCount > indexCount)
+		{
+			return SetError(error, "Submeshes must be whole triangles inside the index data");
+		}
+
+		if (range.IndexCount > 0 && range.FirstIndex < previousEnd)
+		{
+			return SetError(error, "Submeshes must not share indices");
+		}
+
+		previousEnd = std::max<uint64_t>(previousEnd, uint64_t(range.FirstIndex) + range.IndexCount);
+	}
+
+	std::vector<uint32_t> indices = mesh.Indices;
+	for (FMeshFileSubmesh& submesh : submeshes)
+	{
+		for (uint32_t i = submesh.FirstIndex; i < submesh.FirstIndex + submesh.IndexCount; ++i)
+		{
+			int64_t vertex = int64_t(indices[i]) + submesh.BaseVertex;
+			if (vertex < 0 || vertex >= mesh.VertexCount)
+			{
+				return SetError(error, "Index refers to a vertex that does not exist");
+			}
+
+			indices[i] = static_cast<uint32_t>(vertex);
+		}
+
+		submesh.BaseVertex = 0;
+	}
+
+	for (uint32_t index : indices)
+	{
+		if (index >= mesh.VertexCount)
+		{
+			return SetError(error, "Index refers to a vertex that does not exist");
+		}
+	}
+
+	mesh.Indices.swap(indices);
+	if (!mesh.Submeshes.empty())
+	{
+		mesh.Submeshes = submeshes;
+	}
+
+	if (stats)
+	{
+		*stats = FMeshOptimizeStats();
+		stats->CacheBefore = AnalyzeVertexCache(mesh.Indices.data(), indexCount, mesh.VertexCount);
+		stats->FetchBefore = AnalyzeMeshFetch(mesh);
+	}
+
+	uint32_t positionStride = 0;
+	const uint8_t* positions = GetMeshDataPositions(mesh, positionStride);
+
+	for (const FMeshFileSubmesh& submesh : submeshes)
+	{
+		uint32_t* submeshIndices = mesh.Indices.data() + submesh.FirstIndex;
+
+		if (options.OptimizeVertexCache)
+		{
+			OptimizeVertexCache(submeshIndices, submeshIndices, submesh.IndexCount, mesh.VertexCount);
+		}
+
+		if (options.OptimizeOverdraw && positions)
+		{
+			OptimizeOverdraw(submeshIndices, submeshIndices, submesh.IndexCount, positions, positionStride, mesh.VertexCount, options.OverdrawThreshold);
+		}
+	}
+
+	// A mesh without indices would lose every vertex.
+	if (options.OptimizeVertexFetch && indexCount > 0)
+	{
+		std::vector<uint32_t> remap(mesh.VertexCount);
+		uint32_t usedCount = OptimizeVertexFetchRemap(remap.data(), mesh.Indices.data(), indexCount, mesh.VertexCount);
+
+		for (uint32_t& index : mesh.Indices)
+		{
+			index = remap[index];
+		}
+
+		for (FMeshStreamData& stream : mesh.Streams)
+		{
+			std::vector<uint8_t> data(size_t(usedCount) * stream.Stride);
+			for (uint32_t vertex = 0; vertex < mesh.VertexCount; ++vertex)
+			{
+				if (remap[vertex] != ~0u)
+				{
+					std::memcpy(&data[size_t(remap[vertex]) * stream.Stride], &stream.Data[size_t(vertex) * stream.Stride], stream.Stride);
+				}
+			}
+
+			stream.Data.swap(data);
+		}
+
+		mesh.VertexCount = usedCount;
+		positions = GetMeshDataPositions(mesh, positionStride);
+	}
+
+	mesh.Meshlets.clear();
+	mesh.MeshletVertices.clear();
+	mesh.MeshletTriangles.clear();
+
+	if (options.BuildMeshlets)
+	{
+		std::vector<uint32_t> localIndices(mesh.VertexCount, ~0u);
+		for (uint32_t submesh = 0; submesh < submeshes.size(); ++submesh)
+		{
+			BuildSubmeshMeshlets(mesh, submesh, submeshes[submesh].FirstIndex, submeshes[submesh].IndexCount, options.MaxMeshletVertices,
+				options.MaxMeshletTriangles, localIndices);
+		}
+
+		for (FMeshFileMeshlet& meshlet : mesh.Meshlets)
+		{
+			ComputeMeshletBounds(meshlet, mesh.MeshletVertices.data(), mesh.MeshletTriangles.data(), positions, positionStride);
+		}
+	}
+
+	if (stats)
+	{
+		stats->CacheAfter = AnalyzeVertexCache(mesh.Indices.data(), indexCount, mesh.VertexCount);
+		stats->FetchAfter = AnalyzeMeshFetch(mesh);
+		stats->MeshletCount = static_cast<uint32_t>(mesh.Meshlets.size());
+	}
+
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "MeshFile.h"
+
+#include <cstdint>
+#include <string>
+
+// Offline mesh optimisation for the converter. Every function works on 32 bit triangle lists; the
+// writer picks 16 bit indices afterwards when the vertex count allows it.
+
+// Result of running an index buffer through a FIFO post-transform cache model. ACMR is vertices
+// transformed per triangle, 0.5 at best for large regular meshes and 3 at worst. ATVR is vertices
+// transformed per vertex referenced, 1 at best.
+struct FVertexCacheStats
+{
+	uint32_t VerticesTransformed = 0;
+	uint32_t TrianglesProcessed = 0;
+	float Acmr = 0.0f;
+	float Atvr = 0.0f;
+};
+
+FVertexCacheStats AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize = 16);
+
+// Result of running the vertex fetches through a model of a small cache of 64 byte lines. Overfetch
+// is bytes read from memory per byte of vertex data referenced, 1 at best.
+struct FVertexFetchStats
+{
+	uint64_t BytesFetched = 0;
+	float Overfetch = 0.0f;
+};
+
+FVertexFetchStats AnalyzeVertexFetch(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t vertexSize);
+
+// Reorders the triangles for the post-transform cache with Tom Forsyth's linear speed algorithm: every
+// step emits the adjacent triangle whose vertices score best, where vertices score for being recently
+// used and for having few triangles left. destination may be indices.
+void OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+
+// Reorders cache optimised triangles to draw front most surfaces first, after Sander et al., "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw". The triangles are split into clusters
+// wherever the cache restarts, or where the ACMR so far is within threshold of the whole cluster, and
+// the clusters are sorted by how much they face away from the mesh centre. A threshold of 1.05 gives up
+// at most 5% of the cache efficiency. destination may be indices.
+void OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, uint32_t indexCount, const uint8_t* positions, uint32_t positionStride,
+	uint32_t vertexCount, float threshold = 1.05f);
+
+// Numbers the vertices in the order the indices first use them, so vertex fetches walk memory forwards.
+// remap needs vertexCount entries and gets ~0u for vertices no index uses. Returns the number of vertices
+// used.
+uint32_t OptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+
+// Bounding sphere and normal cone of a cluster of triangles, see FMeshFileMeshlet. A cone cutoff of 1
+// never culls, used when the triangles face too many ways.
+void ComputeMeshletBounds(FMeshFileMeshlet& meshlet, const uint32_t* meshletVertices, const uint8_t* meshletTriangles, const uint8_t* positions,
+	uint32_t positionStride);
+
+struct FMeshOptimizeOptions
+{
+	bool OptimizeVertexCache = true;
+	// Needs Float3 positions, skipped without them.
+	bool OptimizeOverdraw = true;
+	float OverdrawThreshold = 1.05f;
+	// Reorders and compacts the vertices of every stream.
+	bool OptimizeVertexFetch = true;
+	bool BuildMeshlets = false;
+	// At most MaxMeshletVertices.
+	uint32_t MaxMeshletVertices = 64;
+	uint32_t MaxMeshletTriangles = 124;
+};
+
+struct FMeshOptimizeStats
+{
+	FVertexCacheStats CacheBefore;
+	FVertexCacheStats CacheAfter;
+	// Over every stream.
+	FVertexFetchStats FetchBefore;
+	FVertexFetchStats FetchAfter;
+	uint32_t MeshletCount = 0;
+};
+
+// Runs the steps the options ask for, each submesh on its own: vertex cache, then overdraw, then vertex
+// fetch over the whole mesh, then meshlets from the final order. Submeshes come out with a BaseVertex
+// of zero. Fails when the indices do not form triangles of existing vertices, or submeshes share
+// indices.
+bool OptimizeMesh(FMeshData& mesh, const FMeshOptimizeOptions& options, FMeshOptimizeStats* stats = nullptr, std::string* error = nullptr);
@@ -0,0 +1,508 @@
+#include "MeshStreamer.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace
+{
+	// The I/O threads read one byte of every page to fault the mesh in from the file cache or disk.
+	const uint64_t StreamingPageSize = 4096;
+
+	// The most urgent load on top of the heap.
+	template<typename QueuedLoadType>
+	bool IsLessUrgent(const QueuedLoadType& a, const QueuedLoadType& b)
+	{
+		return a.Priority > b.Priority;
+	}
+
+	template<typename IndexType>
+	bool IndicesInRange(const IndexType* indices, uint32_t indexCount, uint32_t vertexCount)
+	{
+		IndexType largest = 0;
+		for (uint32_t i = 0; i < indexCount; ++i)
+		{
+			largest = std::max(largest, indices[i]);
+		}
+
+		return indexCount == 0 || largest < vertexCount;
+	}
+}
+
+FMeshStreamer::FMeshStreamer(const FMeshPack& pack, IRenderDevice* renderDevice, uint64_t memoryBudget, FJobSystem* jobSystem, uint32_t ioThreadCount,
+	uint64_t uploadBytesPerFrame)
+	: Pack(pack)
+	, RenderDevice(renderDevice)
+	, JobSystem(jobSystem && jobSystem->GetWorkerThreadCount() > 0 ? jobSystem : nullptr)
+	, MemoryBudget(memoryBudget)
+	, UploadBytesPerFrame(uploadBytesPerFrame)
+	, Meshes(pack.GetMeshCount())
+	, QueuedCount(0)
+	, PendingCount(0)
+	, Stopping(false)
+	, BytesRead(0)
+	, Newest(InvalidMesh)
+	, Oldest(InvalidMesh)
+	, Frame(0)
+{
+	assert(Pack.IsOpen());
+	assert(RenderDevice);
+
+	for (uint32_t i = 0; i < std::max(1u, ioThreadCount); ++i)
+	{
+		IoThreads.emplace_back(&FMeshStreamer::IoThreadMain, this);
+	}
+}
+
+FMeshStreamer::~FMeshStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+	}
+	LoadQueued.notify_all();
+
+	for (std::thread& thread : IoThreads)
+	{
+		thread.join();
+	}
+
+	// No thread starts a check any more.
+	if (JobSystem)
+	{
+		JobSystem->Wait(CheckJobs);
+	}
+
+	Ready.clear();
+	Uploads.clear();
+
+	for (uint32_t mesh = 0; mesh < Meshes.size(); ++mesh)
+	{
+		if (Meshes[mesh].Resident)
+		{
+			DestroyMeshBuffers(RenderDevice, Meshes[mesh].Buffers);
+		}
+	}
+}
+
+void FMeshStreamer::Request(uint32_t mesh, float priority)
+{
+	assert(mesh < Meshes.size());
+
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+
+		FMeshSlot& slot = Meshes[mesh];
+		switch (slot.State)
+		{
+		case EStreamingState::Unloaded:
+			++slot.Serial;
+			slot.State = EStreamingState::Queued;
+			slot.Priority = priority;
+			++QueuedCount;
+			++PendingCount;
+			++Stats.Requests;
+			PushQueuedLoad(slot, mesh);
+			queued = true;
+			break;
+
+		case EStreamingState::Queued:
+			if (slot.Priority != priority)
+			{
+				slot.Priority = priority;
+				PushQueuedLoad(slot, mesh);
+			}
+			break;
+
+		case EStreamingState::Loading:
+		case EStreamingState::Ready:
+			// Orders the uploads.
+			slot.Priority = priority;
+			break;
+
+		case EStreamingState::Resident:
+		case EStreamingState::Failed:
+			break;
+		}
+	}
+
+	if (queued)
+	{
+		LoadQueued.notify_one();
+	}
+}
+
+void FMeshStreamer::Cancel(uint32_t mesh)
+{
+	assert(mesh < Meshes.size());
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	FMeshSlot& slot = Meshes[mesh];
+	if (slot.State != EStreamingState::Queued && slot.State != EStreamingState::Loading && slot.State != EStreamingState::Ready)
+	{
+		return;
+	}
+
+	// The queue entry, the read or the upload of the old serial is dropped wherever it is.
+	QueuedCount -= slot.State == EStreamingState::Queued ? 1 : 0;
+	--PendingCount;
+	++slot.Serial;
+	slot.State = EStreamingState::Unloaded;
+	++Stats.Cancelled;
+}
+
+void FMeshStreamer::Evict(uint32_t mesh)
+{
+	assert(mesh < Meshes.size());
+
+	FMeshSlot& slot = Meshes[mesh];
+	if (!slot.Resident)
+	{
+		return;
+	}
+
+	// The device holds on to the buffers until the frames that drew them retire.
+	Unlink(mesh);
+	DestroyMeshBuffers(RenderDevice, slot.Buffers);
+	slot.Resident = false;
+	Stats.ResidentBytes -= slot.Bytes;
+	++Stats.Evicted;
+
+	SetState(mesh, EStreamingState::Unloaded);
+}
+
+void FMeshStreamer::Update()
+{
+	MORPHEUS_PROFILE_FUNCTION();
+
+	auto start = std::chrono::steady_clock::now();
+
+	++Frame;
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+
+		for (std::unique_ptr<FLoad>& load : Ready)
+		{
+			Uploads.push_back(std::move(load));
+		}
+		Ready.clear();
+	}
+
+	std::stable_sort(Uploads.begin(), Uploads.end(), [this](const std::unique_ptr<FLoad>& a, const std::unique_ptr<FLoad>& b)
+	{
+		return Meshes[a->Mesh].Priority < Meshes[b->Mesh].Priority;
+	});
+
+	uint64_t uploadedBytes = 0;
+	size_t next = 0;
+	for (; next < Uploads.size(); ++next)
+	{
+		FLoad& load = *Uploads[next];
+		FMeshSlot& slot = Meshes[load.Mesh];
+
+		// Cancelled after the check.
+		if (slot.Serial != load.Serial)
+		{
+			continue;
+		}
+
+		uint64_t bytes = load.Valid ? GetMeshBytes(load.File) : 0;
+		if (!load.Valid || bytes > MemoryBudget)
+		{
+			++Stats.Failed;
+			SetState(load.Mesh, EStreamingState::Failed);
+			continue;
+		}
+
+		// At least one mesh a frame, however large.
+		if (uploadedBytes > 0 && uploadedBytes + bytes > UploadBytesPerFrame)
+		{
+			break;
+		}
+
+		if (!MakeRoom(bytes))
+		{
+			++Stats.BudgetStalls;
+			break;
+		}
+
+		if (!CreateMeshBuffers(RenderDevice, load.File, slot.Buffers))
+		{
+			DestroyMeshBuffers(RenderDevice, slot.Buffers);
+			++Stats.Failed;
+			SetState(load.Mesh, EStreamingState::Failed);
+			continue;
+		}
+
+		slot.Resident = true;
+		slot.Bytes = bytes;
+		slot.LastUsedFrame = Frame;
+		LinkNewest(load.Mesh);
+
+		uploadedBytes += bytes;
+		Stats.ResidentBytes += bytes;
+		Stats.PeakResidentBytes = std::max(Stats.PeakResidentBytes, Stats.ResidentBytes);
+		Stats.BytesUploaded += bytes;
+		++Stats.Loaded;
+
+		SetState(load.Mesh, EStreamingState::Resident);
+	}
+
+	Uploads.erase(Uploads.begin(), Uploads.begin() + next);
+
+	Stats.BytesRead = BytesRead.load(std::memory_order_relaxed);
+
+	uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	Stats.MaxUpdateNanoseconds = std::max(Stats.MaxUpdateNanoseconds, nanoseconds);
+}
+
+const FMeshBuffers* FMeshStreamer::GetMesh(uint32_t mesh)
+{
+	assert(mesh < Meshes.size());
+
+	FMeshSlot& slot = Meshes[mesh];
+	if (!slot.Resident)
+	{
+		return nullptr;
+	}
+
+	slot.LastUsedFrame = Frame;
+	if (Newest != mesh)
+	{
+		Unlink(mesh);
+		LinkNewest(mesh);
+	}
+
+	return &slot.Buffers;
+}
+
+EStreamingState FMeshStreamer::GetState(uint32_t mesh) const
+{
+	assert(mesh < Meshes.size());
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	return Meshes[mesh].State;
+}
+
+uint32_t FMeshStreamer::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	return PendingCount;
+}
+
+uint64_t FMeshStreamer::GetMeshBytes(const FMeshFile& mesh)
+{
+	uint64_t bytes = mesh.GetHeader().IndexDataSize;
+	for (uint32_t stream = 0; stream < mesh.GetStreamCount(); ++stream)
+	{
+		bytes += mesh.GetStream(stream).DataSize;
+	}
+
+	return bytes;
+}
+
+uint64_t FMeshStreamer::GetMemoryBudget() const
+{
+	return MemoryBudget;
+}
+
+const FMeshStreamerStats& FMeshStreamer::GetStats() const
+{
+	return Stats;
+}
+
+void FMeshStreamer::IoThreadMain()
+{
+	SetProfilerThreadName("Streaming I/O");
+
+	for (;;)
+	{
+		FQueuedLoad queued;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			LoadQueued.wait(lock, [this]() { return Stopping || !Queue.empty(); });
+
+			if (Stopping)
+			{
+				return;
+			}
+
+			std::pop_heap(Queue.begin(), Queue.end(), IsLessUrgent<FQueuedLoad>);
+			queued = Queue.back();
+			Queue.pop_back();
+
+			FMeshSlot& slot = Meshes[queued.Mesh];
+			if (slot.State != EStreamingState::Queued || slot.Serial != queued.Serial || slot.Priority != queued.Priority)
+			{
+				continue;
+			}
+
+			slot.State = EStreamingState::Loading;
+			--QueuedCount;
+		}
+
+		{
+			MORPHEUS_PROFILE_SCOPE("Read mesh");
+
+			const volatile uint8_t* data = Pack.GetMeshData(queued.Mesh);
+			uint64_t size = Pack.GetMeshSize(queued.Mesh);
+
+			uint8_t touched = 0;
+			for (uint64_t offset = 0; offset < size; offset += StreamingPageSize)
+			{
+				touched = touched + data[offset];
+			}
+			(void)touched;
+
+			BytesRead.fetch_add(size, std::memory_order_relaxed);
+		}
+
+		FLoad* load = new FLoad();
+		load->Streamer = this;
+		load->Mesh = queued.Mesh;
+		load->Serial = queued.Serial;
+		load->Valid = false;
+
+		if (JobSystem)
+		{
+			FJobDeclaration job;
+			job.Function = &FMeshStreamer::CheckJob;
+			job.UserData = load;
+			job.Begin = 0;
+			job.End = 1;
+			JobSystem->Run(job, &CheckJobs);
+		}
+		else
+		{
+			Check(load);
+		}
+	}
+}
+
+void FMeshStreamer::CheckJob(void* userData, uint32_t, uint32_t)
+{
+	FLoad* load = static_cast<FLoad*>(userData);
+	load->Streamer->Check(load);
+}
+
+void FMeshStreamer::Check(FLoad* load)
+{
+	MORPHEUS_PROFILE_SCOPE("Check mesh");
+
+	std::unique_ptr<FLoad> owned(load);
+
+	// The tables are checked by opening the mesh, the indices here, so a corrupt pack cannot make the
+	// GPU read past a vertex buffer. The pages are in memory by now.
+	FMeshFile& file = load->File;
+	if (file.OpenMemory(Pack.GetMeshData(load->Mesh), Pack.GetMeshSize(load->Mesh)) && file.GetStreamCount() > 0)
+	{
+		load->Valid = file.GetIndexFormat() == EIndexFormat::UInt16 ?
+			IndicesInRange(static_cast<const uint16_t*>(file.GetIndexData()), file.GetIndexCount(), file.GetVertexCount()) :
+			IndicesInRange(static_cast<const uint32_t*>(file.GetIndexData()), file.GetIndexCount(), file.GetVertexCount());
+	}
+
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	FMeshSlot& slot = Meshes[load->Mesh];
+	if (slot.Serial == load->Serial)
+	{
+		slot.State = EStreamingState::Ready;
+		Ready.push_back(std::move(owned));
+	}
+}
+
+void FMeshStreamer::PushQueuedLoad(const FMeshSlot& slot, uint32_t mesh)
+{
+	FQueuedLoad queued = { slot.Priority, mesh, slot.Serial };
+	Queue.push_back(queued);
+	std::push_heap(Queue.begin(), Queue.end(), IsLessUrgent<FQueuedLoad>);
+
+	if (Queue.size() > 2 * static_cast<size_t>(QueuedCount) + 64)
+	{
+		Queue.erase(std::remove_if(Queue.begin(), Queue.end(), [this](const FQueuedLoad& entry)
+		{
+			const FMeshSlot& entrySlot = Meshes[entry.Mesh];
+			return entrySlot.State != EStreamingState::Queued || entrySlot.Serial != entry.Serial || entrySlot.Priority != entry.Priority;
+		}), Queue.end());
+		std::make_heap(Queue.begin(), Queue.end(), IsLessUrgent<FQueuedLoad>);
+	}
+}
+
+void FMeshStreamer::SetState(uint32_t mesh, EStreamingState state)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	FMeshSlot& slot = Meshes[mesh];
+	if (slot.State == EStreamingState::Ready)
+	{
+		--PendingCount;
+	}
+	slot.State = state;
+}
+
+bool FMeshStreamer::MakeRoom(uint64_t bytes)
+{
+	while (Stats.ResidentBytes + bytes > MemoryBudget)
+	{
+		// Meshes drawn in the last frame would only come straight back.
+		if (Oldest == InvalidMesh || Meshes[Oldest].LastUsedFrame + 1 >= Frame)
+		{
+			return false;
+		}
+
+		Evict(Oldest);
+	}
+
+	return true;
+}
+
+void FMeshStreamer::Unlink(uint32_t mesh)
+{
+	FMeshSlot& slot = Meshes[mesh];
+
+	if (slot.Newer != InvalidMesh)
+	{
+		Meshes[slot.Newer].Older = slot.Older;
+	}
+	else
+	{
+		Newest = slot.Older;
+	}
+
+	if (slot.Older != InvalidMesh)
+	{
+		Meshes[slot.Older].Newer = slot.Newer;
+	}
+	else
+	{
+		Oldest = slot.Newer;
+	}
+
+	slot.Newer = InvalidMesh;
+	slot.Older = InvalidMesh;
+}
+
+void FMeshStreamer::LinkNewest(uint32_t mesh)
+{
+	FMeshSlot& slot = Meshes[mesh];
+	slot.Newer = InvalidMesh;
+	slot.Older = Newest;
+
+	if (Newest != InvalidMesh)
+	{
+		Meshes[Newest].Newer = mesh;
+	}
+	else
+	{
+		Oldest = mesh;
+	}
+
+	Newest = mesh;
+}
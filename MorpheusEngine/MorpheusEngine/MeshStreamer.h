@@ -0,0 +1,167 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "MeshFile.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class EStreamingState : uint8_t
+{
+	// Never requested, cancelled or evicted.
+	Unloaded,
+	Queued,
+	// Being read by an I/O thread or checked by a job.
+	Loading,
+	// Checked and waiting for its buffers.
+	Ready,
+	Resident,
+	// Corrupt, larger than the whole budget or refused by the device. Requests are ignored.
+	Failed
+};
+
+struct FMeshStreamerStats
+{
+	uint64_t Requests = 0;
+	uint64_t Cancelled = 0;
+	uint64_t Loaded = 0;
+	uint64_t Failed = 0;
+	uint64_t Evicted = 0;
+	// Paged in by the I/O threads.
+	uint64_t BytesRead = 0;
+	uint64_t BytesUploaded = 0;
+	uint64_t ResidentBytes = 0;
+	uint64_t PeakResidentBytes = 0;
+	// Longest Update(), the hitch streaming adds to a frame.
+	uint64_t MaxUpdateNanoseconds = 0;
+	// Updates that left a ready mesh waiting because meshes in use filled the budget.
+	uint64_t BudgetStalls = 0;
+};
+
+// Loads the meshes of a pack in the background so that neither startup nor frames wait on the disk.
+// I/O threads page the most urgent request in, a job checks the tables and indices, and Update() on
+// the render thread creates the buffers, a few megabytes a frame at most. Residency is capped by a
+// memory budget: the least recently used meshes are evicted to make room, but never the ones drawn
+// in the last frame.
+//
+// Everything but the I/O threads and jobs runs on the thread that owns the device.
+class FMeshStreamer
+{
+public:
+	static const uint32_t DefaultIoThreadCount = 2;
+	static const uint64_t DefaultUploadBytesPerFrame = 4 * 1024 * 1024;
+
+	// The pack must stay open while the streamer exists. Without a job system, or one without worker
+	// threads that nobody would wait on, the I/O threads check the meshes themselves.
+	FMeshStreamer(const FMeshPack& pack, IRenderDevice* renderDevice, uint64_t memoryBudget, FJobSystem* jobSystem = nullptr,
+		uint32_t ioThreadCount = DefaultIoThreadCount, uint64_t uploadBytesPerFrame = DefaultUploadBytesPerFrame);
+	// Waits for the reads and jobs in flight and destroys every resident mesh.
+	~FMeshStreamer();
+
+	FMeshStreamer(const FMeshStreamer&) = delete;
+	FMeshStreamer& operator=(const FMeshStreamer&) = delete;
+
+	// Lower priorities load first, a distance to the camera for example. Requesting a mesh that is
+	// on its way again only changes its priority.
+	void Request(uint32_t mesh, float priority);
+	// Drops a load that has not become resident. A read in flight finishes and is thrown away.
+	void Cancel(uint32_t mesh);
+	// Destroys the buffers of a resident mesh.
+	void Evict(uint32_t mesh);
+
+	// Once per frame, before the draws: creates the buffers of checked meshes, most urgent first, up
+	// to the upload limit, evicting to stay in budget.
+	void Update();
+
+	// Buffers of a resident mesh, which counts as used this frame. Null while it is not resident.
+	const FMeshBuffers* GetMesh(uint32_t mesh);
+	EStreamingState GetState(uint32_t mesh) const;
+	// Meshes queued, loading or ready.
+	uint32_t GetPendingCount() const;
+	// Bytes of buffers a mesh needs, from its header.
+	static uint64_t GetMeshBytes(const FMeshFile& mesh);
+
+	uint64_t GetMemoryBudget() const;
+	const FMeshStreamerStats& GetStats() const;
+
+private:
+	static const uint32_t InvalidMesh = ~0u;
+
+	struct FMeshSlot
+	{
+		// Guarded by Mutex. Serial changes with every request and cancel, so the loads of an older
+		// request are recognised and dropped.
+		EStreamingState State = EStreamingState::Unloaded;
+		uint32_t Serial = 0;
+		float Priority = 0.0f;
+
+		// Render thread only. Newer and Older link the resident meshes from most to least recently used.
+		bool Resident = false;
+		FMeshBuffers Buffers;
+		uint64_t Bytes = 0;
+		uint64_t LastUsedFrame = 0;
+		uint32_t Newer = InvalidMesh;
+		uint32_t Older = InvalidMesh;
+	};
+
+	struct FQueuedLoad
+	{
+		float Priority;
+		uint32_t Mesh;
+		uint32_t Serial;
+	};
+
+	struct FLoad
+	{
+		FMeshStreamer* Streamer;
+		uint32_t Mesh;
+		uint32_t Serial;
+		FMeshFile File;
+		bool Valid;
+	};
+
+	void IoThreadMain();
+	static void CheckJob(void* userData, uint32_t begin, uint32_t end);
+	void Check(FLoad* load);
+
+	// Called with Mutex held. Rebuilds the queue once stale entries outnumber the live ones.
+	void PushQueuedLoad(const FMeshSlot& slot, uint32_t mesh);
+	void SetState(uint32_t mesh, EStreamingState state);
+
+	bool MakeRoom(uint64_t bytes);
+	void Unlink(uint32_t mesh);
+	void LinkNewest(uint32_t mesh);
+
+	const FMeshPack& Pack;
+	IRenderDevice* RenderDevice;
+	FJobSystem* JobSystem;
+	uint64_t MemoryBudget;
+	uint64_t UploadBytesPerFrame;
+
+	std::vector<FMeshSlot> Meshes;
+
+	mutable std::mutex Mutex;
+	std::condition_variable LoadQueued;
+	// Heap on priority. Reprioritised and cancelled requests leave stale entries behind.
+	std::vector<FQueuedLoad> Queue;
+	uint32_t QueuedCount;
+	uint32_t PendingCount;
+	std::vector<std::unique_ptr<FLoad>> Ready;
+	bool Stopping;
+
+	std::vector<std::thread> IoThreads;
+	FJobCounter CheckJobs;
+	std::atomic<uint64_t> BytesRead;
+
+	// Render thread only.
+	std::vector<std::unique_ptr<FLoad>> Uploads;
+	uint32_t Newest;
+	uint32_t Oldest;
+	uint64_t Frame;
+	FMeshStreamerStats Stats;
+};
@@ -0,0 +1,584 @@
+#include "NullRenderDevice.h"
+#include "CommandBuffer.h"
+
+#include <cassert>
+#include <cstring>
+
+FNullRenderDevice::FNullRenderDevice(bool recordCommands)
+	: RecordCommands(recordCommands)
+	, PresentedFrames(0)
+	, LastFence(0)
+{
+	BackBuffer = Textures.Add(FNullTexture());
+}
+
+FBufferHandle FNullRenderDevice::CreateBuffer(const FBufferDesc& description, const void* initialData)
+{
+	if (!Buffers.CanAdd())
+	{
+		return FBufferHandle();
+	}
+
+	FNullBuffer buffer;
+	buffer.Description = description;
+	buffer.Data.resize(description.ByteWidth);
+
+	if (initialData)
+	{
+		std::memcpy(buffer.Data.data(), initialData, description.ByteWidth);
+		FrameStats.BytesUploaded += description.ByteWidth;
+	}
+
+	FBufferHandle handle = Buffers.Add(std::move(buffer));
+	++FrameStats.ResourcesCreated;
+
+	Record(ERecordedCommandType::CreateBuffer, handle.Value, description.ByteWidth);
+
+	return handle;
+}
+
+FVertexShaderHandle FNullRenderDevice::CreateVertexShader(const FShaderBytecode& bytecode)
+{
+	if (!VertexShaders.CanAdd())
+	{
+		return FVertexShaderHandle();
+	}
+
+	FNullShader shader;
+	shader.DebugName = bytecode.DebugName ? bytecode.DebugName : "";
+
+	FVertexShaderHandle handle = VertexShaders.Add(std::move(shader));
+	++FrameStats.ResourcesCreated;
+
+	Record(ERecordedCommandType::CreateVertexShader, handle.Value, static_cast<uint32_t>(bytecode.Size));
+
+	return handle;
+}
+
+FPixelShaderHandle FNullRenderDevice::CreatePixelShader(const FShaderBytecode& bytecode)
+{
+	if (!PixelShaders.CanAdd())
+	{
+		return FPixelShaderHandle();
+	}
+
+	FNullShader shader;
+	shader.DebugName = bytecode.DebugName ? bytecode.DebugName : "";
+
+	FPixelShaderHandle handle = PixelShaders.Add(std::move(shader));
+	++FrameStats.ResourcesCreated;
+
+	Record(ERecordedCommandType::CreatePixelShader, handle.Value, static_cast<uint32_t>(bytecode.Size));
+
+	return handle;
+}
+
+FInputLayoutHandle FNullRenderDevice::CreateInputLayout(const FInputElementDesc* elements, uint32_t elementCount, const FShaderBytecode& vertexShaderBytecode)
+{
+	if (!InputLayouts.CanAdd())
+	{
+		return FInputLayoutHandle();
+	}
+
+	FNullInputLayout inputLayout;
+	inputLayout.Elements.assign(elements, elements + elementCount);
+	inputLayout.SemanticNames.reserve(elementCount);
+
+	// Keep our own copy of the semantic names, the caller's strings may not outlive the layout.
+	for (FInputElementDesc& element : inputLayout.Elements)
+	{
+		inputLayout.SemanticNames.push_back(element.SemanticName ? element.SemanticName : "");
+		element.SemanticName = nullptr;
+	}
+
+	FInputLayoutHandle handle = InputLayouts.Add(std::move(inputLayout));
+	++FrameStats.ResourcesCreated;
+
+	Record(ERecordedCommandType::CreateInputLayout, handle.Value, elementCount, static_cast<uint32_t>(vertexShaderBytecode.Size));
+
+	return handle;
+}
+
+FRasterizerStateHandle FNullRenderDevice::CreateRasterizerState(const FRasterizerDesc& description)
+{
+	if (!RasterizerStates.CanAdd())
+	{
+		return FRasterizerStateHandle();
+	}
+
+	FRasterizerStateHandle handle = RasterizerStates.Add(description);
+	++FrameStats.ResourcesCreated;
+
+	Record(ERecordedCommandType::CreateRasterizerState, handle.Value);
+
+	return handle;
+}
+
+FDepthStencilStateHandle FNullRenderDevice::CreateDepthStencilState(const FDepthStencilDesc& description)
+{
+	if (!DepthStencilStates.CanAdd())
+	{
+		return FDepthStencilStateHandle();
+	}
+
+	FDepthStencilStateHandle handle = DepthStencilStates.Add(description);
+	++FrameStats.ResourcesCreated;
+
+	Record(ERecordedCommandType::CreateDepthStencilState, handle.Value);
+
+	return handle;
+}
+
+FBlendStateHandle FNullRenderDevice::CreateBlendState(const FBlendDesc& description)
+{
+	if (!BlendStates.CanAdd())
+	{
+		return FBlendStateHandle();
+	}
+
+	FBlendStateHandle handle = BlendStates.Add(description);
+	++FrameStats.ResourcesCreated;
+
+	Record(ERecordedCommandType::CreateBlendState, handle.Value);
+
+	return handle;
+}
+
+FTextureHandle FNullRenderDevice::CreateTexture(const FTextureDesc& description)
+{
+	if (!Textures.CanAdd())
+	{
+		return FTextureHandle();
+	}
+
+	assert(description.Width > 0 && description.Height > 0);
+
+	FNullTexture texture;
+	texture.Description = description;
+
+	FTextureHandle handle = Textures.Add(texture);
+	++FrameStats.ResourcesCreated;
+
+	Record(ERecordedCommandType::CreateTexture, handle.Value, description.Width, description.Height, static_cast<uint32_t>(description.Format), description.Bindings);
+
+	return handle;
+}
+
+void FNullRenderDevice::DestroyBuffer(FBufferHandle buffer)
+{
+	FNullBuffer* target = FindBuffer(buffer);
+	assert(target && !target->Mapped);
+	(void)target;
+
+	Buffers.Remove(buffer);
+	++FrameStats.ResourcesDestroyed;
+
+	Record(ERecordedCommandType::DestroyBuffer, buffer.Value);
+}
+
+void FNullRenderDevice::DestroyVertexShader(FVertexShaderHandle shader)
+{
+	VertexShaders.Remove(shader);
+	++FrameStats.ResourcesDestroyed;
+
+	Record(ERecordedCommandType::DestroyVertexShader, shader.Value);
+}
+
+void FNullRenderDevice::DestroyPixelShader(FPixelShaderHandle shader)
+{
+	PixelShaders.Remove(shader);
+	++FrameStats.ResourcesDestroyed;
+
+	Record(ERecordedCommandType::DestroyPixelShader, shader.Value);
+}
+
+void FNullRenderDevice::DestroyInputLayout(FInputLayoutHandle inputLayout)
+{
+	InputLayouts.Remove(inputLayout);
+	++FrameStats.ResourcesDestroyed;
+
+	Record(ERecordedCommandType::DestroyInputLayout, inputLayout.Value);
+}
+
+void FNullRenderDevice::DestroyRasterizerState(FRasterizerStateHandle state)
+{
+	RasterizerStates.Remove(state);
+	++FrameStats.ResourcesDestroyed;
+
+	Record(ERecordedCommandType::DestroyRasterizerState, state.Value);
+}
+
+void FNullRenderDevice::DestroyDepthStencilState(FDepthStencilStateHandle state)
+{
+	DepthStencilStates.Remove(state);
+	++FrameStats.ResourcesDestroyed;
+
+	Record(ERecordedCommandType::DestroyDepthStencilState, state.Value);
+}
+
+void FNullRenderDevice::DestroyBlendState(FBlendStateHandle state)
+{
+	BlendStates.Remove(state);
+	++FrameStats.ResourcesDestroyed;
+
+	Record(ERecordedCommandType::DestroyBlendState, state.Value);
+}
+
+void FNullRenderDevice::DestroyTexture(FTextureHandle texture)
+{
+	assert(texture != BackBuffer);
+	assert(texture.Value != Bound.RenderTarget && texture.Value != Bound.DepthStencil);
+
+	Textures.Remove(texture);
+	++FrameStats.ResourcesDestroyed;
+
+	Record(ERecordedCommandType::DestroyTexture, texture.Value);
+}
+
+uint32_t FNullRenderDevice::ReportLiveResources(std::string& report) const
+{
+	uint32_t count = 0;
+	count += AppendLiveResources(report, "Buffer", Buffers);
+	count += AppendLiveResources(report, "VertexShader", VertexShaders);
+	count += AppendLiveResources(report, "PixelShader", PixelShaders);
+	count += AppendLiveResources(report, "InputLayout", InputLayouts);
+	count += AppendLiveResources(report, "RasterizerState", RasterizerStates);
+	count += AppendLiveResources(report, "DepthStencilState", DepthStencilStates);
+	count += AppendLiveResources(report, "BlendState", BlendStates);
+	// The back buffer belongs to the device.
+	count += AppendLiveResources(report, "Texture", Textures, BackBuffer);
+
+	return count;
+}
+
+FTextureHandle FNullRenderDevice::GetBackBuffer() const
+{
+	return BackBuffer;
+}
+
+const FTextureDesc& FNullRenderDevice::GetTextureDesc(FTextureHandle texture) const
+{
+	const FNullTexture* target = FindTexture(texture);
+	assert(target);
+
+	return target->Description;
+}
+
+bool FNullRenderDevice::ResizeBackBuffer(uint32_t width, uint32_t height)
+{
+	Bound.RenderTarget = 0;
+	Bound.DepthStencil = 0;
+
+	FNullTexture* backBuffer = Textures.Get(BackBuffer);
+	backBuffer->Description.Width = width;
+	backBuffer->Description.Height = height;
+
+	Record(ERecordedCommandType::ResizeBackBuffer, width, height);
+
+	return true;
+}
+
+void FNullRenderDevice::UpdateBuffer(FBufferHandle buffer, const void* data, uint32_t size)
+{
+	FNullBuffer* target = FindBuffer(buffer);
+	assert(target);
+	assert(size <= target->Data.size());
+
+	std::memcpy(target->Data.data(), data, size);
+
+	++FrameStats.BufferUpdates;
+	FrameStats.BytesUploaded += size;
+
+	Record(ERecordedCommandType::UpdateBuffer, buffer.Value, size);
+}
+
+void* FNullRenderDevice::MapBuffer(FBufferHandle buffer, EMapMode mode)
+{
+	FNullBuffer* target = FindBuffer(buffer);
+	assert(target);
+	assert(target->Description.Usage == EResourceUsage::Dynamic);
+	assert(!target->Mapped);
+
+	target->Mapped = true;
+	++FrameStats.BufferMaps;
+
+	Record(ERecordedCommandType::MapBuffer, buffer.Value, static_cast<uint32_t>(mode));
+
+	return target->Data.data();
+}
+
+void FNullRenderDevice::UnmapBuffer(FBufferHandle buffer)
+{
+	FNullBuffer* target = FindBuffer(buffer);
+	assert(target && target->Mapped);
+
+	target->Mapped = false;
+
+	Record(ERecordedCommandType::UnmapBuffer, buffer.Value);
+}
+
+void FNullRenderDevice::SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset)
+{
+	assert(slot < MaxVertexBufferSlots);
+
+	// A different stride or offset is a real change even when the buffer is the same.
+	if (Bound.VertexStrides[slot] != stride || Bound.VertexOffsets[slot] != offset)
+	{
+		Bound.VertexBuffers[slot] = 0;
+	}
+
+	RecordStateChange(FrameStats, Bound.VertexBuffers[slot], buffer.Value);
+	Bound.VertexStrides[slot] = stride;
+	Bound.VertexOffsets[slot] = offset;
+
+	Record(ERecordedCommandType::SetVertexBuffer, slot, buffer.Value, offset);
+}
+
+void FNullRenderDevice::SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset)
+{
+	if (Bound.IndexFormat != format || Bound.IndexOffset != offset)
+	{
+		Bound.IndexBuffer = 0;
+	}
+
+	RecordStateChange(FrameStats, Bound.IndexBuffer, buffer.Value);
+	Bound.IndexFormat = format;
+	Bound.IndexOffset = offset;
+
+	Record(ERecordedCommandType::SetIndexBuffer, buffer.Value, static_cast<uint32_t>(format), offset);
+}
+
+void FNullRenderDevice::SetInputLayout(FInputLayoutHandle inputLayout)
+{
+	RecordStateChange(FrameStats, Bound.InputLayout, inputLayout.Value);
+	Record(ERecordedCommandType::SetInputLayout, inputLayout.Value);
+}
+
+void FNullRenderDevice::SetVertexShader(FVertexShaderHandle shader)
+{
+	RecordStateChange(FrameStats, Bound.VertexShader, shader.Value);
+	Record(ERecordedCommandType::SetVertexShader, shader.Value);
+}
+
+void FNullRenderDevice::SetPixelShader(FPixelShaderHandle shader)
+{
+	RecordStateChange(FrameStats, Bound.PixelShader, shader.Value);
+	Record(ERecordedCommandType::SetPixelShader, shader.Value);
+}
+
+void FNullRenderDevice::SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer)
+{
+	assert(slot < MaxConstantBufferSlots);
+
+	uint32_t& boundOffset = Bound.ConstantBufferOffsets[static_cast<int>(stage)][slot];
+	if (boundOffset != 0)
+	{
+		Bound.ConstantBuffers[static_cast<int>(stage)][slot] = 0;
+	}
+
+	RecordStateChange(FrameStats, Bound.ConstantBuffers[static_cast<int>(stage)][slot], buffer.Value);
+	boundOffset = 0;
+
+	Record(ERecordedCommandType::SetConstantBuffer, static_cast<uint32_t>(stage), slot, buffer.Value);
+}
+
+void FNullRenderDevice::SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size)
+{
+	assert(slot < MaxConstantBufferSlots);
+	assert(offset % ConstantBufferRangeAlignment == 0 && size % ConstantBufferRangeAlignment == 0);
+	assert(size <= MaxConstantBufferRangeSize);
+
+	// Another slice of the same buffer is a real change.
+	uint32_t& boundOffset = Bound.ConstantBufferOffsets[static_cast<int>(stage)][slot];
+	if (boundOffset != offset)
+	{
+		Bound.ConstantBuffers[static_cast<int>(stage)][slot] = 0;
+	}
+
+	RecordStateChange(FrameStats, Bound.ConstantBuffers[static_cast<int>(stage)][slot], buffer.Value);
+	boundOffset = offset;
+
+	Record(ERecordedCommandType::SetConstantBufferRange, static_cast<uint32_t>(stage), slot, buffer.Value, offset, size);
+}
+
+void FNullRenderDevice::SetRasterizerState(FRasterizerStateHandle state)
+{
+	RecordStateChange(FrameStats, Bound.RasterizerState, state.Value);
+	Record(ERecordedCommandType::SetRasterizerState, state.Value);
+}
+
+void FNullRenderDevice::SetDepthStencilState(FDepthStencilStateHandle state)
+{
+	RecordStateChange(FrameStats, Bound.DepthStencilState, state.Value);
+	Record(ERecordedCommandType::SetDepthStencilState, state.Value);
+}
+
+void FNullRenderDevice::SetBlendState(FBlendStateHandle state)
+{
+	RecordStateChange(FrameStats, Bound.BlendState, state.Value);
+	Record(ERecordedCommandType::SetBlendState, state.Value);
+}
+
+void FNullRenderDevice::SetViewport(const FViewport& viewport)
+{
+	++FrameStats.StateChanges;
+
+	if (std::memcmp(&Bound.Viewport, &viewport, sizeof(FViewport)) == 0)
+	{
+		++FrameStats.RedundantStateChanges;
+	}
+
+	Bound.Viewport = viewport;
+
+	Record(ERecordedCommandType::SetViewport, static_cast<uint32_t>(viewport.Width), static_cast<uint32_t>(viewport.Height));
+}
+
+void FNullRenderDevice::SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil)
+{
+	assert(!renderTarget.IsValid() || FindTexture(renderTarget));
+	assert(!depthStencil.IsValid() || FindTexture(depthStencil));
+
+	// Both targets are bound by one call, so they count as one change.
+	++FrameStats.StateChanges;
+
+	if (Bound.RenderTarget == renderTarget.Value && Bound.DepthStencil == depthStencil.Value)
+	{
+		++FrameStats.RedundantStateChanges;
+	}
+
+	Bound.RenderTarget = renderTarget.Value;
+	Bound.DepthStencil = depthStencil.Value;
+
+	Record(ERecordedCommandType::SetRenderTargets, renderTarget.Value, depthStencil.Value);
+}
+
+uint64_t FNullRenderDevice::InsertFence()
+{
+	++LastFence;
+
+	Record(ERecordedCommandType::InsertFence, static_cast<uint32_t>(LastFence));
+
+	return LastFence;
+}
+
+bool FNullRenderDevice::IsFenceComplete(uint64_t fence)
+{
+	return fence <= LastFence;
+}
+
+bool FNullRenderDevice::SupportsConstantBufferRanges() const
+{
+	return true;
+}
+
+std::unique_ptr<ICommandList> FNullRenderDevice::CreateCommandList()
+{
+	return std::unique_ptr<ICommandList>(new FCommandBuffer());
+}
+
+void FNullRenderDevice::ExecuteCommandList(ICommandList* commandList)
+{
+	// Only lists this device created come back here.
+	static_cast<FCommandBuffer*>(commandList)->Execute(*this);
+}
+
+void FNullRenderDevice::Clear(const float clearColour[4], float clearDepth, uint8_t clearStencil)
+{
+	uint32_t depthBits;
+	std::memcpy(&depthBits, &clearDepth, sizeof(depthBits));
+
+	uint32_t packedColour = 0;
+	for (int channel = 0; channel < 4; ++channel)
+	{
+		float value = clearColour[channel] < 0.0f ? 0.0f : (clearColour[channel] > 1.0f ? 1.0f : clearColour[channel]);
+		packedColour |= static_cast<uint32_t>(value * 255.0f + 0.5f) << (channel * 8);
+	}
+
+	Record(ERecordedCommandType::Clear, packedColour, depthBits, clearStencil);
+}
+
+void FNullRenderDevice::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	++FrameStats.DrawCalls;
+	FrameStats.IndicesSubmitted += indexCount;
+	++FrameStats.InstancesSubmitted;
+
+	Record(ERecordedCommandType::DrawIndexed, indexCount, startIndex, static_cast<uint32_t>(baseVertex));
+}
+
+void FNullRenderDevice::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	++FrameStats.DrawCalls;
+	FrameStats.IndicesSubmitted += static_cast<uint64_t>(indexCount) * instanceCount;
+	FrameStats.InstancesSubmitted += instanceCount;
+
+	Record(ERecordedCommandType::DrawIndexedInstanced, indexCount, instanceCount, startIndex, static_cast<uint32_t>(baseVertex), startInstance);
+}
+
+void FNullRenderDevice::Present(bool vSync)
+{
+	Record(ERecordedCommandType::Present, vSync ? 1 : 0);
+
+	LastFrameStats = FrameStats;
+	FrameStats = FRenderDeviceStats();
+
+	// Swapping keeps the capacity of both lists so steady-state frames do not allocate.
+	LastFrameCommands.swap(RecordedCommands);
+	RecordedCommands.clear();
+
+	++PresentedFrames;
+}
+
+const FRenderDeviceStats& FNullRenderDevice::GetFrameStats() const
+{
+	return FrameStats;
+}
+
+const FRenderDeviceStats& FNullRenderDevice::GetLastFrameStats() const
+{
+	return LastFrameStats;
+}
+
+void FNullRenderDevice::SetRecordingEnabled(bool enabled)
+{
+	RecordCommands = enabled;
+}
+
+const std::vector<FRecordedCommand>& FNullRenderDevice::GetRecordedCommands() const
+{
+	return RecordedCommands;
+}
+
+const std::vector<FRecordedCommand>& FNullRenderDevice::GetLastFrameCommands() const
+{
+	return LastFrameCommands;
+}
+
+uint64_t FNullRenderDevice::GetPresentedFrameCount() const
+{
+	return PresentedFrames;
+}
+
+uint32_t FNullRenderDevice::GetLiveTextureCount() const
+{
+	return Textures.GetLiveCount();
+}
+
+void FNullRenderDevice::Record(ERecordedCommandType type, uint32_t argument0, uint32_t argument1, uint32_t argument2, uint32_t argument3, uint32_t argument4)
+{
+	if (RecordCommands)
+	{
+		FRecordedCommand command = { type, { argument0, argument1, argument2, argument3, argument4 } };
+		RecordedCommands.push_back(command);
+	}
+}
+
+FNullRenderDevice::FNullBuffer* FNullRenderDevice::FindBuffer(FBufferHandle buffer)
+{
+	return Buffers.Get(buffer);
+}
+
+const FNullRenderDevice::FNullTexture* FNullRenderDevice::FindTexture(FTextureHandle texture) const
+{
+	return Textures.Get(texture);
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "ResourcePool.h"
+
+#include <string>
+#include <vector>
+
+enum class ERecordedCommandType : uint8_t
+{
+	CreateBuffer,
+	CreateVertexShader,
+	CreatePixelShader,
+	CreateInputLayout,
+	CreateRasterizerState,
+	CreateDepthStencilState,
+	CreateBlendState,
+	UpdateBuffer,
+	MapBuffer,
+	UnmapBuffer,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	SetInputLayout,
+	SetVertexShader,
+	SetPixelShader,
+	SetConstantBuffer,
+	SetConstantBufferRange,
+	SetRasterizerState,
+	SetDepthStencilState,
+	SetBlendState,
+	SetViewport,
+	InsertFence,
+	Clear,
+	DrawIndexed,
+	DrawIndexedInstanced,
+	Present,
+	CreateTexture,
+	DestroyTexture,
+	ResizeBackBuffer,
+	SetRenderTargets,
+	DestroyBuffer,
+	DestroyVertexShader,
+	DestroyPixelShader,
+	DestroyInputLayout,
+	DestroyRasterizerState,
+	DestroyDepthStencilState,
+	DestroyBlendState
+};
+
+// One recorded device call. The meaning of the arguments depends on the command type.
+struct FRecordedCommand
+{
+	ERecordedCommandType Type;
+	uint32_t Arguments[5];
+};
+
+// Headless device that keeps resources in system memory, records every call and counts what a
+// real driver would have to do. Used to measure CPU frame cost without a GPU.
+class FNullRenderDevice : public IRenderDevice
+{
+public:
+	static const uint32_t MaxVertexBufferSlots = 4;
+	static const uint32_t MaxConstantBufferSlots = 8;
+
+	explicit FNullRenderDevice(bool recordCommands = true);
+
+	FBufferHandle CreateBuffer(const FBufferDesc& description, const void* initialData) override;
+	FVertexShaderHandle CreateVertexShader(const FShaderBytecode& bytecode) override;
+	FPixelShaderHandle CreatePixelShader(const FShaderBytecode& bytecode) override;
+	FInputLayoutHandle CreateInputLayout(const FInputElementDesc* elements, uint32_t elementCount, const FShaderBytecode& vertexShaderBytecode) override;
+	FRasterizerStateHandle CreateRasterizerState(const FRasterizerDesc& description) override;
+	FDepthStencilStateHandle CreateDepthStencilState(const FDepthStencilDesc& description) override;
+	FBlendStateHandle CreateBlendState(const FBlendDesc& description) override;
+	FTextureHandle CreateTexture(const FTextureDesc& description) override;
+
+	// Nothing runs behind the CPU, so resources are freed right away.
+	void DestroyBuffer(FBufferHandle buffer) override;
+	void DestroyVertexShader(FVertexShaderHandle shader) override;
+	void DestroyPixelShader(FPixelShaderHandle shader) override;
+	void DestroyInputLayout(FInputLayoutHandle inputLayout) override;
+	void DestroyRasterizerState(FRasterizerStateHandle state) override;
+	void DestroyDepthStencilState(FDepthStencilStateHandle state) override;
+	void DestroyBlendState(FBlendStateHandle state) override;
+	void DestroyTexture(FTextureHandle texture) override;
+
+	uint32_t ReportLiveResources(std::string& report) const override;
+
+	// The back buffer starts out empty, zero by zero texels.
+	FTextureHandle GetBackBuffer() const override;
+	const FTextureDesc& GetTextureDesc(FTextureHandle texture) const override;
+	bool ResizeBackBuffer(uint32_t width, uint32_t height) override;
+
+	void UpdateBuffer(FBufferHandle buffer, const void* data, uint32_t size) override;
+	void* MapBuffer(FBufferHandle buffer, EMapMode mode) override;
+	void UnmapBuffer(FBufferHandle buffer) override;
+
+	void SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset) override;
+	void SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset) override;
+	void SetInputLayout(FInputLayoutHandle inputLayout) override;
+	void SetVertexShader(FVertexShaderHandle shader) override;
+	void SetPixelShader(FPixelShaderHandle shader) override;
+	void SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer) override;
+	void SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size) override;
+	void SetRasterizerState(FRasterizerStateHandle state) override;
+	void SetDepthStencilState(FDepthStencilStateHandle state) override;
+	void SetBlendState(FBlendStateHandle state) override;
+	void SetViewport(const FViewport& viewport) override;
+	void SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil) override;
+
+	// Nothing runs behind the CPU, so every fence is complete as soon as it is inserted.
+	uint64_t InsertFence() override;
+	bool IsFenceComplete(uint64_t fence) override;
+
+	bool SupportsConstantBufferRanges() const override;
+
+	// FCommandBuffer packet streams, played back through this device as if the calls were made here.
+	std::unique_ptr<ICommandList> CreateCommandList() override;
+	void ExecuteCommandList(ICommandList* commandList) override;
+
+	void Clear(const float clearColour[4], float clearDepth, uint8_t clearStencil) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+	void Present(bool vSync) override;
+
+	const FRenderDeviceStats& GetFrameStats() const override;
+	const FRenderDeviceStats& GetLastFrameStats() const override;
+
+	void SetRecordingEnabled(bool enabled);
+
+	// Commands recorded since the last Present() and during the last presented frame.
+	const std::vector<FRecordedCommand>& GetRecordedCommands() const;
+	const std::vector<FRecordedCommand>& GetLastFrameCommands() const;
+
+	uint64_t GetPresentedFrameCount() const;
+	// Textures created and not destroyed yet, the back buffer included.
+	uint32_t GetLiveTextureCount() const;
+
+protected:
+	struct FNullBuffer
+	{
+		FBufferDesc Description;
+		std::vector<uint8_t> Data;
+		bool Mapped = false;
+	};
+
+	struct FNullTexture
+	{
+		FTextureDesc Description;
+	};
+
+	struct FNullShader
+	{
+		std::string DebugName;
+		// Left to derived devices, the software device keeps the built-in program it runs instead.
+		uint8_t Program = 0;
+	};
+
+	struct FNullInputLayout
+	{
+		std::vector<FInputElementDesc> Elements;
+		std::vector<std::string> SemanticNames;
+	};
+
+	struct FBoundState
+	{
+		uint32_t VertexBuffers[MaxVertexBufferSlots] = {};
+		uint32_t VertexStrides[MaxVertexBufferSlots] = {};
+		uint32_t VertexOffsets[MaxVertexBufferSlots] = {};
+		uint32_t IndexBuffer = 0;
+		EIndexFormat IndexFormat = EIndexFormat::UInt16;
+		uint32_t IndexOffset = 0;
+		uint32_t InputLayout = 0;
+		uint32_t VertexShader = 0;
+		uint32_t PixelShader = 0;
+		uint32_t ConstantBuffers[static_cast<int>(EShaderStage::NumberOfStages)][MaxConstantBufferSlots] = {};
+		uint32_t ConstantBufferOffsets[static_cast<int>(EShaderStage::NumberOfStages)][MaxConstantBufferSlots] = {};
+		uint32_t RasterizerState = 0;
+		uint32_t DepthStencilState = 0;
+		uint32_t BlendState = 0;
+		FViewport Viewport;
+		uint32_t RenderTarget = 0;
+		uint32_t DepthStencil = 0;
+	};
+
+	void Record(ERecordedCommandType type, uint32_t argument0 = 0, uint32_t argument1 = 0, uint32_t argument2 = 0, uint32_t argument3 = 0, uint32_t argument4 = 0);
+
+	// Null for invalid and stale handles.
+	FNullBuffer* FindBuffer(FBufferHandle buffer);
+	const FNullTexture* FindTexture(FTextureHandle texture) const;
+
+	TResourcePool<FBufferHandle, FNullBuffer> Buffers;
+	TResourcePool<FVertexShaderHandle, FNullShader> VertexShaders;
+	TResourcePool<FPixelShaderHandle, FNullShader> PixelShaders;
+	TResourcePool<FInputLayoutHandle, FNullInputLayout> InputLayouts;
+	TResourcePool<FRasterizerStateHandle, FRasterizerDesc> RasterizerStates;
+	TResourcePool<FDepthStencilStateHandle, FDepthStencilDesc> DepthStencilStates;
+	TResourcePool<FBlendStateHandle, FBlendDesc> BlendStates;
+	TResourcePool<FTextureHandle, FNullTexture> Textures;
+	FTextureHandle BackBuffer;
+
+	FBoundState Bound;
+
+	FRenderDeviceStats FrameStats;
+	FRenderDeviceStats LastFrameStats;
+
+private:
+	bool RecordCommands;
+	std::vector<FRecordedCommand> RecordedCommands;
+	std::vector<FRecordedCommand> LastFrameCommands;
+	uint64_t PresentedFrames;
+	uint64_t LastFence;
+};
@@ -0,0 +1,511 @@
+#include "ObjImporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// Indices of one face corner into the attribute lists, minus one when the corner has none.
+	struct FObjCorner
+	{
+		int32_t Position;
+		int32_t TexCoord;
+		int32_t Normal;
+
+		bool operator==(const FObjCorner& other) const
+		{
+			return Position == other.Position && TexCoord == other.TexCoord && Normal == other.Normal;
+		}
+	};
+
+	struct FObjCornerHash
+	{
+		size_t operator()(const FObjCorner& corner) const
+		{
+			uint64_t hash = uint64_t(uint32_t(corner.Position)) * 0x9e3779b97f4a7c15ull;
+			hash ^= uint64_t(uint32_t(corner.TexCoord)) * 0xc2b2ae3d27d4eb4full;
+			hash ^= uint64_t(uint32_t(corner.Normal)) * 0x165667b19e3779f9ull;
+
+			return static_cast<size_t>(hash ^ (hash >> 32));
+		}
+	};
+
+	struct FObjMaterial
+	{
+		std::string Name;
+		std::vector<uint32_t> Indices;
+	};
+
+	bool IsSpace(char character)
+	{
+		return character == ' ' || character == '\t' || character == '\r';
+	}
+
+	bool IsDigit(char character)
+	{
+		return character >= '0' && character <= '9';
+	}
+
+	void SkipSpaces(const char*& cursor, const char* end)
+	{
+		while (cursor < end && IsSpace(*cursor))
+		{
+			++cursor;
+		}
+	}
+
+	bool ParseInteger(const char*& cursor, const char* end, int32_t& value)
+	{
+		const char* start = cursor;
+		bool negative = cursor < end && *cursor == '-';
+		if (cursor < end && (*cursor == '-' || *cursor == '+'))
+		{
+			++cursor;
+		}
+
+		int64_t result = 0;
+		const char* digits = cursor;
+		while (cursor < end && IsDigit(*cursor) && result <= INT32_MAX)
+		{
+			result = result * 10 + (*cursor++ - '0');
+		}
+
+		if (cursor == digits || result > INT32_MAX)
+		{
+			cursor = start;
+			return false;
+		}
+
+		value = static_cast<int32_t>(negative ? -result : result);
+
+		return true;
+	}
+
+	// strtof is locale dependent and several times slower. Keeps 18 significant digits and divides by an
+	// exact power of ten, which is correctly rounded for anything an OBJ exporter writes.
+	bool ParseFloat(const char*& cursor, const char* end, float& value)
+	{
+		static const double powersOfTen[] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		SkipSpaces(cursor, end);
+
+		const char* start = cursor;
+		bool negative = cursor < end && *cursor == '-';
+		if (cursor < end && (*cursor == '-' || *cursor == '+'))
+		{
+			++cursor;
+		}
+
+		uint64_t mantissa = 0;
+		int32_t significantDigits = 0;
+		int32_t exponent = 0;
+		bool hasDigits = false;
+
+		for (; cursor < end && IsDigit(*cursor); ++cursor)
+		{
+			hasDigits = true;
+			if (significantDigits < 18)
+			{
+				mantissa = mantissa * 10 + (*cursor - '0');
+				significantDigits += mantissa != 0;
+			}
+			else
+			{
+				++exponent;
+			}
+		}
+
+		if (cursor < end && *cursor == '.')
+		{
+			for (++cursor; cursor < end && IsDigit(*cursor); ++cursor)
+			{
+				hasDigits = true;
+				if (significantDigits < 18)
+				{
+					mantissa = mantissa * 10 + (*cursor - '0');
+					significantDigits += mantissa != 0;
+					--exponent;
+				}
+			}
+		}
+
+		if (!hasDigits)
+		{
+			cursor = start;
+			return false;
+		}
+
+		if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+		{
+			const char* exponentStart = cursor++;
+			int32_t exponentValue;
+			if (ParseInteger(cursor, end, exponentValue))
+			{
+				exponent += std::max(-400, std::min(400, exponentValue));
+			}
+			else
+			{
+				cursor = exponentStart;
+			}
+		}
+
+		double result = static_cast<double>(mantissa);
+		if (exponent < 0)
+		{
+			result = -exponent <= 22 ? result / powersOfTen[-exponent] : result * std::pow(10.0, exponent);
+		}
+		else if (exponent > 0)
+		{
+			result = exponent <= 22 ? result * powersOfTen[exponent] : result * std::pow(10.0, exponent);
+		}
+
+		value = static_cast<float>(negative ? -result : result);
+
+		return true;
+	}
+
+	// Turns a one-based or negative relative OBJ index into a zero-based one.
+	bool ResolveIndex(int32_t index, size_t count, int32_t& resolved)
+	{
+		int64_t value = index < 0 ? int64_t(count) + index : int64_t(index) - 1;
+		if (value < 0 || value >= int64_t(count))
+		{
+			return false;
+		}
+
+		resolved = static_cast<int32_t>(value);
+
+		return true;
+	}
+
+	bool ParseCorner(const char*& cursor, const char* end, size_t positionCount, size_t texCoordCount, size_t normalCount, FObjCorner& corner)
+	{
+		int32_t index;
+		if (!ParseInteger(cursor, end, index) || !ResolveIndex(index, positionCount, corner.Position))
+		{
+			return false;
+		}
+
+		corner.TexCoord = -1;
+		corner.Normal = -1;
+
+		if (cursor < end && *cursor == '/')
+		{
+			++cursor;
+			if (cursor < end && *cursor != '/')
+			{
+				if (!ParseInteger(cursor, end, index) || !ResolveIndex(index, texCoordCount, corner.TexCoord))
+				{
+					return false;
+				}
+			}
+
+			if (cursor < end && *cursor == '/')
+			{
+				++cursor;
+				if (!ParseInteger(cursor, end, index) || !ResolveIndex(index, normalCount, corner.Normal))
+				{
+					return false;
+				}
+			}
+		}
+
+		return cursor == end || IsSpace(*cursor);
+	}
+
+	bool FailAtLine(std::string* error, uint32_t line, const char* message)
+	{
+		if (error)
+		{
+			*error = "Line " + std::to_string(line) + ": " + message;
+		}
+
+		return false;
+	}
+
+	void AddElement(FMeshStreamData& stream, EMeshSemantic semantic, EVertexFormat format)
+	{
+		FMeshFileElement element;
+		element.Semantic = semantic;
+		element.SemanticIndex = 0;
+		element.Format = format;
+		element.Offset = static_cast<uint8_t>(stream.Stride);
+
+		stream.Elements.push_back(element);
+		stream.Stride += GetVertexFormatSize(format);
+	}
+}
+
+bool ImportObj(const char* text, size_t length, const FObjImportOptions& options, FMeshData& mesh, std::string* error)
+{
+	std::vector<FFloat3> positions;
+	std::vector<FFloat3> colours;
+	std::vector<float> texCoords;
+	std::vector<FFloat3> normals;
+	bool hasColours = false;
+
+	std::vector<FObjCorner> vertices;
+	std::unordered_map<FObjCorner, uint32_t, FObjCornerHash> vertexLookup;
+	std::vector<FObjMaterial> materials;
+	std::string pendingMaterial;
+	int32_t currentMaterial = -1;
+	std::vector<uint32_t> polygon;
+
+	const char* end = text + length;
+	uint32_t line = 0;
+
+	for (const char* cursor = text; cursor < end; )
+	{
+		++line;
+
+		const char* lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+		lineEnd = lineEnd ? lineEnd : end;
+
+		const char* c = cursor;
+		cursor = lineEnd + 1;
+
+		SkipSpaces(c, lineEnd);
+		const char* keyword = c;
+		while (c < lineEnd && !IsSpace(*c))
+		{
+			++c;
+		}
+
+		size_t keywordLength = c - keyword;
+
+		if (keywordLength == 1 && keyword[0] == 'v')
+		{
+			FFloat3 position;
+			if (!ParseFloat(c, lineEnd, position.X) || !ParseFloat(c, lineEnd, position.Y) || !ParseFloat(c, lineEnd, position.Z))
+			{
+				return FailAtLine(error, line, "Vertex positions need three coordinates");
+			}
+
+			// Either a w coordinate, which is ignored, or a colour.
+			FFloat3 colour = { 1.0f, 1.0f, 1.0f };
+			if (ParseFloat(c, lineEnd, colour.X))
+			{
+				if (ParseFloat(c, lineEnd, colour.Y) && ParseFloat(c, lineEnd, colour.Z))
+				{
+					hasColours = true;
+				}
+				else
+				{
+					colour = { 1.0f, 1.0f, 1.0f };
+				}
+			}
+
+			if (options.ConvertToLeftHanded)
+			{
+				position.Z = -position.Z;
+			}
+
+			positions.push_back(position);
+			colours.push_back(colour);
+		}
+		else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 't')
+		{
+			float u;
+			float v = 0.0f;
+			if (!ParseFloat(c, lineEnd, u))
+			{
+				return FailAtLine(error, line, "Texture coordinates need at least one value");
+			}
+
+			ParseFloat(c, lineEnd, v);
+
+			texCoords.push_back(u);
+			texCoords.push_back(1.0f - v);
+		}
+		else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 'n')
+		{
+			FFloat3 normal;
+			if (!ParseFloat(c, lineEnd, normal.X) || !ParseFloat(c, lineEnd, normal.Y) || !ParseFloat(c, lineEnd, normal.Z))
+			{
+				return FailAtLine(error, line, "Normals need three coordinates");
+			}
+
+			if (options.ConvertToLeftHanded)
+			{
+				normal.Z = -normal.Z;
+			}
+
+			normals.push_back(normal);
+		}
+		else if (keywordLength == 1 && keyword[0] == 'f')
+		{
+			polygon.clear();
+
+			for (SkipSpaces(c, lineEnd); c < lineEnd; SkipSpaces(c, lineEnd))
+			{
+				FObjCorner corner;
+				if (!ParseCorner(c, lineEnd, positions.size(), texCoords.size() / 2, normals.size(), corner))
+				{
+					return FailAtLine(error, line, "Face corner is malformed or refers to a missing vertex");
+				}
+
+				auto inserted = vertexLookup.emplace(corner, static_cast<uint32_t>(vertices.size()));
+				if (inserted.second)
+				{
+					vertices.push_back(corner);
+				}
+
+				polygon.push_back(inserted.first->second);
+			}
+
+			if (polygon.size() < 3)
+			{
+				continue;
+			}
+
+			// Materials are only created once they have a face.
+			if (currentMaterial < 0)
+			{
+				for (size_t i = 0; i < materials.size() && currentMaterial < 0; ++i)
+				{
+					if (materials[i].Name == pendingMaterial)
+					{
+						currentMaterial = static_cast<int32_t>(i);
+					}
+				}
+
+				if (currentMaterial < 0)
+				{
+					currentMaterial = static_cast<int32_t>(materials.size());
+					materials.push_back({ pendingMaterial, {} });
+				}
+			}
+
+			std::vector<uint32_t>& indices = materials[currentMaterial].Indices;
+			for (size_t i = 2; i < polygon.size(); ++i)
+			{
+				indices.push_back(polygon[0]);
+				indices.push_back(polygon[i - 1]);
+				indices.push_back(polygon[i]);
+			}
+		}
+		else if (keywordLength == 6 && std::memcmp(keyword, "usemtl", 6) == 0)
+		{
+			SkipSpaces(c, lineEnd);
+			const char* nameEnd = lineEnd;
+			while (nameEnd > c && IsSpace(nameEnd[-1]))
+			{
+				--nameEnd;
+			}
+
+			std::string name(c, nameEnd);
+			if (currentMaterial < 0 || materials[currentMaterial].Name != name)
+			{
+				pendingMaterial = name;
+				currentMaterial = -1;
+			}
+		}
+	}
+
+	if (materials.empty())
+	{
+		return FailAtLine(error, line, "The file has no faces");
+	}
+
+	bool hasNormals = false;
+	bool hasTexCoords = false;
+	for (const FObjCorner& vertex : vertices)
+	{
+		hasNormals |= vertex.Normal >= 0;
+		hasTexCoords |= vertex.TexCoord >= 0;
+	}
+
+	mesh = FMeshData();
+	mesh.VertexCount = static_cast<uint32_t>(vertices.size());
+	mesh.Streams.resize(options.SeparatePositionStream && (hasNormals || hasTexCoords || hasColours) ? 2 : 1);
+
+	FMeshStreamData& positionStream = mesh.Streams[0];
+	FMeshStreamData& attributeStream = mesh.Streams.back();
+
+	AddElement(positionStream, EMeshSemantic::Position, EVertexFormat::Float3);
+	if (hasNormals)
+	{
+		AddElement(attributeStream, EMeshSemantic::Normal, EVertexFormat::Float3);
+	}
+
+	if (hasTexCoords)
+	{
+		AddElement(attributeStream, EMeshSemantic::TexCoord, EVertexFormat::Float2);
+	}
+
+	if (hasColours)
+	{
+		AddElement(attributeStream, EMeshSemantic::Colour, EVertexFormat::Float3);
+	}
+
+	for (FMeshStreamData& stream : mesh.Streams)
+	{
+		stream.Data.resize(size_t(stream.Stride) * mesh.VertexCount);
+	}
+
+	// Elements were added in a fixed order, so the offsets follow from which attributes exist.
+	const FFloat3 noNormal = { 0.0f, 0.0f, 0.0f };
+	const float noTexCoord[2] = { 0.0f, 0.0f };
+
+	for (uint32_t i = 0; i < mesh.VertexCount; ++i)
+	{
+		const FObjCorner& vertex = vertices[i];
+
+		uint8_t* position = positionStream.Data.data() + size_t(i) * positionStream.Stride;
+		std::memcpy(position, &positions[vertex.Position], sizeof(FFloat3));
+
+		uint8_t* attributes = attributeStream.Data.data() + size_t(i) * attributeStream.Stride + (mesh.Streams.size() == 1 ? sizeof(FFloat3) : 0);
+		if (hasNormals)
+		{
+			std::memcpy(attributes, vertex.Normal >= 0 ? &normals[vertex.Normal] : &noNormal, sizeof(FFloat3));
+			attributes += sizeof(FFloat3);
+		}
+
+		if (hasTexCoords)
+		{
+			std::memcpy(attributes, vertex.TexCoord >= 0 ? &texCoords[size_t(vertex.TexCoord) * 2] : noTexCoord, 2 * sizeof(float));
+			attributes += 2 * sizeof(float);
+		}
+
+		if (hasColours)
+		{
+			std::memcpy(attributes, &colours[vertex.Position], sizeof(FFloat3));
+		}
+	}
+
+	for (size_t i = 0; i < materials.size(); ++i)
+	{
+		FMeshFileSubmesh submesh = {};
+		submesh.FirstIndex = static_cast<uint32_t>(mesh.Indices.size());
+		submesh.IndexCount = static_cast<uint32_t>(materials[i].Indices.size());
+		submesh.MaterialIndex = static_cast<uint32_t>(i);
+
+		mesh.Indices.insert(mesh.Indices.end(), materials[i].Indices.begin(), materials[i].Indices.end());
+		mesh.Submeshes.push_back(submesh);
+	}
+
+	return true;
+}
+
+bool ImportObjFile(const char* path, const FObjImportOptions& options, FMeshData& mesh, std::string* error)
+{
+	FMappedFile file;
+	if (!file.Open(path))
+	{
+		if (error)
+		{
+			*error = std::string("Could not open ") + path;
+		}
+
+		return false;
+	}
+
+	return ImportObj(reinterpret_cast<const char*>(file.GetData()), static_cast<size_t>(file.GetSize()), options, mesh, error);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "MeshFile.h"
+
+#include <cstddef>
+#include <string>
+
+struct FObjImportOptions
+{
+	// OBJ files are right handed with counter-clockwise front faces. Negating Z turns them into the left
+	// handed space of the engine, and the mirror also turns the winding into the clockwise front faces
+	// of the default rasterizer state.
+	bool ConvertToLeftHanded = true;
+	// Positions in a stream of their own and the other attributes in a second one, so depth only passes
+	// fetch less.
+	bool SeparatePositionStream = false;
+};
+
+// Wavefront OBJ to mesh data, for the offline converter. Reads v (with the optional r g b extension),
+// vt, vn, f and usemtl; everything else is skipped. Polygons are split into fans, vertices with the same
+// position, texture coordinate and normal are merged, and the faces of every material become one
+// submesh, in the order the materials first appear.
+//
+// Every vertex has a Float3 position, then Float3 normals, Float2 texture coordinates and Float3
+// colours when any face or vertex in the file has them. Texture coordinates are flipped to a top left
+// origin.
+bool ImportObj(const char* text, size_t length, const FObjImportOptions& options, FMeshData& mesh, std::string* error = nullptr);
+bool ImportObjFile(const char* path, const FObjImportOptions& options, FMeshData& mesh, std::string* error = nullptr);
@@ -0,0 +1,660 @@
+#include "OcclusionCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MORPHEUS_OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Every row is rasterized in groups of this many pixels from a multiple of it, whatever the backend,
+	// so all backends write the same pixels with the same arithmetic.
+	const uint32_t ColumnAlignment = 4;
+
+	// One pixel per register, used when the math backend is scalar and as the reference result.
+	struct FDepthVectorScalar
+	{
+		typedef float FRegister;
+		typedef bool FMask;
+		static const uint32_t Width = 1;
+
+		static FRegister Load(const float* source) { return *source; }
+		static void Store(float* destination, FRegister value) { *destination = value; }
+		static FRegister Set(float value) { return value; }
+		static FRegister PixelCentres(float x) { return x + 0.5f; }
+		static FRegister Add(FRegister a, FRegister b) { return a + b; }
+		static FRegister Multiply(FRegister a, FRegister b) { return a * b; }
+		static FRegister Min(FRegister a, FRegister b) { return a < b ? a : b; }
+		static FRegister Max(FRegister a, FRegister b) { return a > b ? a : b; }
+		static FMask NotNegative(FRegister a) { return a >= 0.0f; }
+		static FMask And(FMask a, FMask b) { return a && b; }
+		static FRegister Select(FMask mask, FRegister a, FRegister b) { return mask ? a : b; }
+	};
+
+#if MORPHEUS_OCCLUSION_SSE
+	struct FDepthVectorSSE
+	{
+		typedef __m128 FRegister;
+		typedef __m128 FMask;
+		static const uint32_t Width = 4;
+
+		static FRegister Load(const float* source) { return _mm_loadu_ps(source); }
+		static void Store(float* destination, FRegister value) { _mm_storeu_ps(destination, value); }
+		static FRegister Set(float value) { return _mm_set1_ps(value); }
+		static FRegister PixelCentres(float x) { return _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f)); }
+		static FRegister Add(FRegister a, FRegister b) { return _mm_add_ps(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return _mm_mul_ps(a, b); }
+		static FRegister Min(FRegister a, FRegister b) { return _mm_min_ps(a, b); }
+		static FRegister Max(FRegister a, FRegister b) { return _mm_max_ps(a, b); }
+		static FMask NotNegative(FRegister a) { return _mm_cmpge_ps(a, _mm_setzero_ps()); }
+		static FMask And(FMask a, FMask b) { return _mm_and_ps(a, b); }
+		static FRegister Select(FMask mask, FRegister a, FRegister b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	};
+#endif
+
+	// Keeps the nearer of the stored depth and the polygon depth in every pixel of rows [rowBegin,
+	// rowEnd) the polygon covers completely.
+	template<typename TVector, typename TPolygon>
+	void RasterizePolygonRows(const TPolygon& polygon, int32_t rowBegin, int32_t rowEnd, float* depth, uint32_t pitch)
+	{
+		typedef typename TVector::FRegister FRegister;
+		typedef typename TVector::FMask FMask;
+
+		const int32_t alignment = static_cast<int32_t>(ColumnAlignment);
+		const int32_t firstColumn = polygon.MinX - polygon.MinX % alignment;
+		const int32_t endColumn = (polygon.MaxX + alignment) / alignment * alignment;
+
+		FRegister edgeA[4];
+		for (int edge = 0; edge < 4; ++edge)
+		{
+			edgeA[edge] = TVector::Set(polygon.EdgeA[edge]);
+		}
+		const FRegister depthX0 = TVector::Set(polygon.DepthX[0]);
+		const FRegister depthX1 = TVector::Set(polygon.DepthX[1]);
+		const FRegister maxDepth = TVector::Set(polygon.MaxDepth);
+
+		for (int32_t y = rowBegin; y < rowEnd; ++y)
+		{
+			float centreY = y + 0.5f;
+			FRegister rowEdge[4];
+			for (int edge = 0; edge < 4; ++edge)
+			{
+				rowEdge[edge] = TVector::Set(polygon.EdgeB[edge] * centreY + polygon.EdgeC[edge]);
+			}
+			FRegister rowDepth0 = TVector::Set(polygon.DepthY[0] * centreY + polygon.DepthC[0]);
+			FRegister rowDepth1 = TVector::Set(polygon.DepthY[1] * centreY + polygon.DepthC[1]);
+			float* row = depth + static_cast<size_t>(y) * pitch;
+
+			for (int32_t x = firstColumn; x < endColumn; x += TVector::Width)
+			{
+				FRegister centreX = TVector::PixelCentres(static_cast<float>(x));
+
+				FMask inside = TVector::And(
+					TVector::And(TVector::NotNegative(TVector::Add(TVector::Multiply(edgeA[0], centreX), rowEdge[0])),
+						TVector::NotNegative(TVector::Add(TVector::Multiply(edgeA[1], centreX), rowEdge[1]))),
+					TVector::And(TVector::NotNegative(TVector::Add(TVector::Multiply(edgeA[2], centreX), rowEdge[2])),
+						TVector::NotNegative(TVector::Add(TVector::Multiply(edgeA[3], centreX), rowEdge[3]))));
+
+				FRegister polygonDepth = TVector::Min(TVector::Max(TVector::Add(TVector::Multiply(depthX0, centreX), rowDepth0),
+					TVector::Add(TVector::Multiply(depthX1, centreX), rowDepth1)), maxDepth);
+				FRegister stored = TVector::Load(row + x);
+				TVector::Store(row + x, TVector::Select(inside, TVector::Min(stored, polygonDepth), stored));
+			}
+		}
+	}
+
+	// Twice the signed area of a triangle of screen positions, positive when it is clockwise with y down.
+	float TriangleArea(const float* screen, uint32_t a, uint32_t b, uint32_t c)
+	{
+		const float* p0 = &screen[static_cast<size_t>(a) * 3];
+		const float* p1 = &screen[static_cast<size_t>(b) * 3];
+		const float* p2 = &screen[static_cast<size_t>(c) * 3];
+
+		return (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1]);
+	}
+
+	bool IsFrontFacing(const float* screen, const uint32_t* triangle)
+	{
+		// Clipping would only add small pieces of occluder, triangles reaching past the near plane are dropped.
+		return screen[static_cast<size_t>(triangle[0]) * 3 + 2] >= 0.0f && screen[static_cast<size_t>(triangle[1]) * 3 + 2] >= 0.0f &&
+			screen[static_cast<size_t>(triangle[2]) * 3 + 2] >= 0.0f && TriangleArea(screen, triangle[0], triangle[1], triangle[2]) > 0.0f;
+	}
+
+	// Two triangles that share an edge, in opposite directions, and together have a convex outline
+	// make a quad, written clockwise.
+	bool MakeQuad(const float* screen, const uint32_t* first, const uint32_t* second, uint32_t* quad)
+	{
+		for (uint32_t edge = 0; edge < 3; ++edge)
+		{
+			uint32_t from = first[edge];
+			uint32_t to = first[(edge + 1) % 3];
+
+			for (uint32_t other = 0; other < 3; ++other)
+			{
+				if (second[other] != to || second[(other + 1) % 3] != from)
+				{
+					continue;
+				}
+
+				quad[0] = to;
+				quad[1] = first[(edge + 2) % 3];
+				quad[2] = from;
+				quad[3] = second[(other + 2) % 3];
+
+				for (uint32_t corner = 0; corner < 4; ++corner)
+				{
+					if (!(TriangleArea(screen, quad[corner], quad[(corner + 1) % 4], quad[(corner + 2) % 4]) > 0.0f))
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	int32_t ClampToPixels(float value, uint32_t size)
+	{
+		// Clamped as a float first, vertices close to the camera plane land far outside the int range.
+		return static_cast<int32_t>(std::max(0.0f, std::min(value, static_cast<float>(size))));
+	}
+
+	uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+}
+
+FOcclusionCuller::FOcclusionCuller(uint32_t width, uint32_t height)
+	: ViewProjection(MatrixIdentity())
+	, Rasterized(false)
+{
+	assert(width > 0 && height > 0);
+
+	for (;;)
+	{
+		FDepthLevel level;
+		level.Width = width;
+		level.Height = height;
+		level.Pitch = Levels.empty() ? (width + ColumnAlignment - 1) / ColumnAlignment * ColumnAlignment : width;
+		level.Nearest.assign(static_cast<size_t>(level.Pitch) * height, 1.0f);
+		if (!Levels.empty())
+		{
+			level.Farthest.assign(static_cast<size_t>(level.Pitch) * height, 1.0f);
+		}
+		Levels.push_back(std::move(level));
+
+		if (width == 1 && height == 1)
+		{
+			break;
+		}
+
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+}
+
+void FOcclusionCuller::BeginFrame(const FFloat4x4& viewProjection)
+{
+	ViewProjection = viewProjection;
+	Polygons.clear();
+	Stats = FOcclusionCullingStats();
+	Rasterized = false;
+}
+
+void FOcclusionCuller::AddOccluder(const FFloat3* positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const FFloat4x4& world)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	const FFloat4x4 worldViewProjection = MatrixMultiply(world, ViewProjection);
+	const float(&m)[4][4] = worldViewProjection.M;
+	const float width = static_cast<float>(Levels[0].Width);
+	const float height = static_cast<float>(Levels[0].Height);
+
+	ScreenPositions.resize(static_cast<size_t>(vertexCount) * 3);
+	for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+	{
+		const FFloat3& p = positions[vertex];
+		float clipX = p.X * m[0][0] + p.Y * m[1][0] + p.Z * m[2][0] + m[3][0];
+		float clipY = p.X * m[0][1] + p.Y * m[1][1] + p.Z * m[2][1] + m[3][1];
+		float clipZ = p.X * m[0][2] + p.Y * m[1][2] + p.Z * m[2][2] + m[3][2];
+		float clipW = p.X * m[0][3] + p.Y * m[1][3] + p.Z * m[2][3] + m[3][3];
+
+		float* screen = &ScreenPositions[static_cast<size_t>(vertex) * 3];
+		if (clipZ < 0.0f || clipW <= 0.0f)
+		{
+			screen[0] = 0.0f;
+			screen[1] = 0.0f;
+			screen[2] = -1.0f;
+			continue;
+		}
+
+		float inverseW = 1.0f / clipW;
+		screen[0] = (clipX * inverseW * 0.5f + 0.5f) * width;
+		screen[1] = (0.5f - clipY * inverseW * 0.5f) * height;
+		screen[2] = clipZ * inverseW;
+	}
+
+	const float* screen = ScreenPositions.data();
+	const uint32_t triangleCount = indexCount / 3;
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		const uint32_t* corners = &indices[triangle * 3];
+		assert(corners[0] < vertexCount && corners[1] < vertexCount && corners[2] < vertexCount);
+
+		// Back faces are hidden by the front ones.
+		if (!IsFrontFacing(screen, corners))
+		{
+			continue;
+		}
+
+		uint32_t quad[4];
+		if (triangle + 1 < triangleCount && IsFrontFacing(screen, corners + 3) && MakeQuad(screen, corners, corners + 3, quad))
+		{
+			AddPolygon(quad, 4);
+			++triangle;
+			continue;
+		}
+
+		AddPolygon(corners, 3);
+	}
+
+	++Stats.Occluders;
+	Stats.OccluderTriangles += triangleCount;
+	Stats.RasterNanoseconds += NanosecondsSince(start);
+}
+
+void FOcclusionCuller::AddOccluderBox(const FBoundingBox& box, const FFloat4x4& world)
+{
+	// Corner i has the maximum of x in bit 0, of y in bit 1 and of z in bit 2. Every face is listed
+	// clockwise as seen from outside, top left first.
+	static const uint32_t faces[6][4] =
+	{
+		{ 2, 3, 1, 0 },
+		{ 7, 6, 4, 5 },
+		{ 6, 2, 0, 4 },
+		{ 3, 7, 5, 1 },
+		{ 5, 4, 0, 1 },
+		{ 6, 7, 3, 2 }
+	};
+
+	FFloat3 corners[8];
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		corners[corner].X = (corner & 1) ? box.Max.X : box.Min.X;
+		corners[corner].Y = (corner & 2) ? box.Max.Y : box.Min.Y;
+		corners[corner].Z = (corner & 4) ? box.Max.Z : box.Min.Z;
+	}
+
+	uint32_t indices[36];
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		const uint32_t(&quad)[4] = faces[face];
+		uint32_t* triangles = &indices[face * 6];
+		triangles[0] = quad[0];
+		triangles[1] = quad[1];
+		triangles[2] = quad[2];
+		triangles[3] = quad[0];
+		triangles[4] = quad[2];
+		triangles[5] = quad[3];
+	}
+
+	AddOccluder(corners, 8, indices, 36, world);
+}
+
+void FOcclusionCuller::AddPolygon(const uint32_t* vertices, uint32_t vertexCount)
+{
+	assert(vertexCount == 3 || vertexCount == 4);
+
+	const FDepthLevel& level = Levels[0];
+	const float* screen = ScreenPositions.data();
+
+	float x[4];
+	float y[4];
+	float z[4];
+	for (uint32_t vertex = 0; vertex < 4; ++vertex)
+	{
+		const float* position = &screen[static_cast<size_t>(vertices[vertex % vertexCount]) * 3];
+		x[vertex] = position[0];
+		y[vertex] = position[1];
+		z[vertex] = position[2];
+	}
+
+	FOccluderPolygon polygon;
+	polygon.MinX = ClampToPixels(std::floor(*std::min_element(x, x + vertexCount)), level.Width);
+	polygon.MinY = ClampToPixels(std::floor(*std::min_element(y, y + vertexCount)), level.Height);
+	polygon.MaxX = ClampToPixels(std::ceil(*std::max_element(x, x + vertexCount)), level.Width) - 1;
+	polygon.MaxY = ClampToPixels(std::ceil(*std::max_element(y, y + vertexCount)), level.Height) - 1;
+	if (polygon.MinX > polygon.MaxX || polygon.MinY > polygon.MaxY)
+	{
+		return;
+	}
+
+	for (uint32_t edge = 0; edge < 4; ++edge)
+	{
+		uint32_t from = edge % vertexCount;
+		uint32_t to = (edge + 1) % vertexCount;
+		float edgeA = y[from] - y[to];
+		float edgeB = x[to] - x[from];
+
+		polygon.EdgeA[edge] = edgeA;
+		polygon.EdgeB[edge] = edgeB;
+		polygon.EdgeC[edge] = -(edgeA * x[from] + edgeB * y[from]) - 0.5f * (std::fabs(edgeA) + std::fabs(edgeB));
+	}
+
+	// The triangles 0, 1, 2 and 0, 2, 3 of a quad.
+	for (uint32_t plane = 0; plane < 2; ++plane)
+	{
+		uint32_t b = vertexCount == 4 ? plane + 1 : 1;
+		uint32_t c = b + 1;
+		float area = (x[b] - x[0]) * (y[c] - y[0]) - (x[c] - x[0]) * (y[b] - y[0]);
+		float depthX = ((z[b] - z[0]) * (y[c] - y[0]) - (z[c] - z[0]) * (y[b] - y[0])) / area;
+		float depthY = ((x[b] - x[0]) * (z[c] - z[0]) - (x[c] - x[0]) * (z[b] - z[0])) / area;
+
+		polygon.DepthX[plane] = depthX;
+		polygon.DepthY[plane] = depthY;
+		polygon.DepthC[plane] = z[0] - depthX * x[0] - depthY * y[0] + 0.5f * (std::fabs(depthX) + std::fabs(depthY));
+	}
+	polygon.MaxDepth = *std::max_element(z, z + vertexCount);
+
+	Polygons.push_back(polygon);
+	Stats.RasterizedTriangles += vertexCount - 2;
+}
+
+void FOcclusionCuller::Rasterize(FJobSystem* jobSystem)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	const uint32_t bandCount = (Levels[0].Height + BandHeight - 1) / BandHeight;
+	if (jobSystem && bandCount > 1)
+	{
+		jobSystem->ParallelFor(bandCount, 1, [this](uint32_t firstBand, uint32_t lastBand)
+		{
+			for (uint32_t band = firstBand; band < lastBand; ++band)
+			{
+				RasterizeBand(band);
+			}
+		});
+	}
+	else
+	{
+		for (uint32_t band = 0; band < bandCount; ++band)
+		{
+			RasterizeBand(band);
+		}
+	}
+
+	// The levels above the bands are a few hundred texels.
+	for (uint32_t level = BandLevels + 1; level < Levels.size(); ++level)
+	{
+		BuildLevelRows(level, 0, Levels[level].Height);
+	}
+
+	Rasterized = true;
+	Stats.RasterNanoseconds += NanosecondsSince(start);
+}
+
+void FOcclusionCuller::RasterizeBand(uint32_t band)
+{
+	FDepthLevel& level = Levels[0];
+	const int32_t rowBegin = static_cast<int32_t>(band * BandHeight);
+	const int32_t rowEnd = std::min(rowBegin + static_cast<int32_t>(BandHeight), static_cast<int32_t>(level.Height));
+
+	std::fill(level.Nearest.begin() + static_cast<size_t>(rowBegin) * level.Pitch, level.Nearest.begin() + static_cast<size_t>(rowEnd) * level.Pitch, 1.0f);
+
+#if MORPHEUS_OCCLUSION_SSE
+	const bool useSIMD = GetMathBackend() != EMathBackend::Scalar;
+#endif
+
+	for (const FOccluderPolygon& polygon : Polygons)
+	{
+		int32_t first = std::max(rowBegin, polygon.MinY);
+		int32_t last = std::min(rowEnd, polygon.MaxY + 1);
+		if (first >= last)
+		{
+			continue;
+		}
+
+#if MORPHEUS_OCCLUSION_SSE
+		if (useSIMD)
+		{
+			RasterizePolygonRows<FDepthVectorSSE>(polygon, first, last, level.Nearest.data(), level.Pitch);
+			continue;
+		}
+#endif
+
+		RasterizePolygonRows<FDepthVectorScalar>(polygon, first, last, level.Nearest.data(), level.Pitch);
+	}
+
+	// A band of BandHeight rows covers whole rows of the first BandLevels levels above it.
+	for (uint32_t levelIndex = 1; levelIndex <= BandLevels && levelIndex < Levels.size(); ++levelIndex)
+	{
+		uint32_t levelRowBegin = (band * BandHeight) >> levelIndex;
+		uint32_t levelRowEnd = std::min(((band + 1) * BandHeight) >> levelIndex, Levels[levelIndex].Height);
+		BuildLevelRows(levelIndex, levelRowBegin, levelRowEnd);
+	}
+}
+
+void FOcclusionCuller::BuildLevelRows(uint32_t levelIndex, uint32_t rowBegin, uint32_t rowEnd)
+{
+	assert(levelIndex > 0);
+
+	const FDepthLevel& below = Levels[levelIndex - 1];
+	const float* belowNearest = below.Nearest.data();
+	const float* belowFarthest = levelIndex == 1 ? below.Nearest.data() : below.Farthest.data();
+
+	FDepthLevel& level = Levels[levelIndex];
+
+	// An odd last row or column of the level below is paired with itself.
+	for (uint32_t y = rowBegin; y < rowEnd; ++y)
+	{
+		size_t row0 = static_cast<size_t>(2 * y) * below.Pitch;
+		size_t row1 = static_cast<size_t>(std::min(2 * y + 1, below.Height - 1)) * below.Pitch;
+		float* nearest = &level.Nearest[static_cast<size_t>(y) * level.Pitch];
+		float* farthest = &level.Farthest[static_cast<size_t>(y) * level.Pitch];
+
+		for (uint32_t x = 0; x < level.Width; ++x)
+		{
+			size_t x0 = 2 * x;
+			size_t x1 = std::min(2 * x + 1, below.Width - 1);
+
+			nearest[x] = std::min(std::min(belowNearest[row0 + x0], belowNearest[row0 + x1]), std::min(belowNearest[row1 + x0], belowNearest[row1 + x1]));
+			farthest[x] = std::max(std::max(belowFarthest[row0 + x0], belowFarthest[row0 + x1]), std::max(belowFarthest[row1 + x0], belowFarthest[row1 + x1]));
+		}
+	}
+}
+
+bool FOcclusionCuller::IsVisible(const FBoundingBox& box) const
+{
+	assert(Rasterized);
+
+	const float(&m)[4][4] = ViewProjection.M;
+	const FDepthLevel& level = Levels[0];
+
+	float minX = level.Width + 1.0f;
+	float minY = level.Height + 1.0f;
+	float maxX = -1.0f;
+	float maxY = -1.0f;
+	float nearestDepth = 1.0f;
+
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		float px = (corner & 1) ? box.Max.X : box.Min.X;
+		float py = (corner & 2) ? box.Max.Y : box.Min.Y;
+		float pz = (corner & 4) ? box.Max.Z : box.Min.Z;
+
+		float clipX = px * m[0][0] + py * m[1][0] + pz * m[2][0] + m[3][0];
+		float clipY = px * m[0][1] + py * m[1][1] + pz * m[2][1] + m[3][1];
+		float clipZ = px * m[0][2] + py * m[1][2] + pz * m[2][2] + m[3][2];
+		float clipW = px * m[0][3] + py * m[1][3] + pz * m[2][3] + m[3][3];
+		if (clipZ < 0.0f || clipW <= 0.0f)
+		{
+			return true;
+		}
+
+		float inverseW = 1.0f / clipW;
+		float x = (clipX * inverseW * 0.5f + 0.5f) * level.Width;
+		float y = (0.5f - clipY * inverseW * 0.5f) * level.Height;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearestDepth = std::min(nearestDepth, clipZ * inverseW);
+	}
+
+	if (maxX <= 0.0f || maxY <= 0.0f || minX >= level.Width || minY >= level.Height)
+	{
+		return true;
+	}
+
+	// Every pixel the box touches, even partly.
+	int32_t pixelMinX = ClampToPixels(std::floor(minX), level.Width - 1);
+	int32_t pixelMinY = ClampToPixels(std::floor(minY), level.Height - 1);
+	int32_t pixelMaxX = std::max(pixelMinX, ClampToPixels(std::ceil(maxX), level.Width) - 1);
+	int32_t pixelMaxY = std::max(pixelMinY, ClampToPixels(std::ceil(maxY), level.Height) - 1);
+
+	// The first level where the box spans at most 2x2 texels.
+	uint32_t levelIndex = 0;
+	while (levelIndex + 1 < Levels.size() && ((pixelMaxX >> levelIndex) - (pixelMinX >> levelIndex) > 1 || (pixelMaxY >> levelIndex) - (pixelMinY >> levelIndex) > 1))
+	{
+		++levelIndex;
+	}
+
+	float nearest;
+	float farthest;
+	GetDepthRange(levelIndex, pixelMinX, pixelMinY, pixelMaxX, pixelMaxY, nearest, farthest);
+	if (nearestDepth > farthest)
+	{
+		return false;
+	}
+
+	// In front of every occluder there, or already exact.
+	if (nearestDepth <= nearest || levelIndex == 0)
+	{
+		return true;
+	}
+
+	GetDepthRange(levelIndex > RefineLevels ? levelIndex - RefineLevels : 0, pixelMinX, pixelMinY, pixelMaxX, pixelMaxY, nearest, farthest);
+
+	return nearestDepth <= farthest;
+}
+
+uint32_t FOcclusionCuller::Cull(const FBoundingBox* boxes, std::vector<uint32_t>& indices, FJobSystem* jobSystem)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	const uint32_t count = static_cast<uint32_t>(indices.size());
+	Visible.resize(count);
+
+	auto test = [this, boxes, &indices](uint32_t first, uint32_t last)
+	{
+		for (uint32_t i = first; i < last; ++i)
+		{
+			Visible[i] = IsVisible(boxes[indices[i]]) ? 1 : 0;
+		}
+	};
+
+	// Boxes per job, a few microseconds of tests.
+	const uint32_t batchSize = 256;
+	if (jobSystem && count > batchSize)
+	{
+		jobSystem->ParallelFor(count, batchSize, test);
+	}
+	else
+	{
+		test(0, count);
+	}
+
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		indices[visibleCount] = indices[i];
+		visibleCount += Visible[i];
+	}
+	indices.resize(visibleCount);
+
+	Stats.TestedObjects += count;
+	Stats.CulledObjects += count - visibleCount;
+	Stats.TestNanoseconds += NanosecondsSince(start);
+
+	return visibleCount;
+}
+
+uint32_t FOcclusionCuller::GetWidth() const
+{
+	return Levels[0].Width;
+}
+
+uint32_t FOcclusionCuller::GetHeight() const
+{
+	return Levels[0].Height;
+}
+
+uint32_t FOcclusionCuller::GetLevelCount() const
+{
+	return static_cast<uint32_t>(Levels.size());
+}
+
+uint32_t FOcclusionCuller::GetLevelWidth(uint32_t level) const
+{
+	assert(level < Levels.size());
+	return Levels[level].Width;
+}
+
+uint32_t FOcclusionCuller::GetLevelHeight(uint32_t level) const
+{
+	assert(level < Levels.size());
+	return Levels[level].Height;
+}
+
+uint32_t FOcclusionCuller::GetLevelPitch(uint32_t level) const
+{
+	assert(level < Levels.size());
+	return Levels[level].Pitch;
+}
+
+const float* FOcclusionCuller::GetNearestDepths(uint32_t level) const
+{
+	assert(level < Levels.size());
+	return Levels[level].Nearest.data();
+}
+
+const float* FOcclusionCuller::GetFarthestDepths(uint32_t level) const
+{
+	assert(level < Levels.size());
+	return level == 0 ? Levels[0].Nearest.data() : Levels[level].Farthest.data();
+}
+
+const FOcclusionCullingStats& FOcclusionCuller::GetStats() const
+{
+	return Stats;
+}
+
+void FOcclusionCuller::GetDepthRange(uint32_t levelIndex, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float& nearest, float& farthest) const
+{
+	const FDepthLevel& level = Levels[levelIndex];
+	const float* nearestDepths = GetNearestDepths(levelIndex);
+	const float* farthestDepths = GetFarthestDepths(levelIndex);
+
+	nearest = 1.0f;
+	farthest = 0.0f;
+	for (int32_t y = minY >> levelIndex; y <= (maxY >> levelIndex); ++y)
+	{
+		for (int32_t x = minX >> levelIndex; x <= (maxX >> levelIndex); ++x)
+		{
+			size_t texel = static_cast<size_t>(y) * level.Pitch + x;
+			nearest = std::min(nearest, nearestDepths[texel]);
+			farthest = std::max(farthest, farthestDepths[texel]);
+		}
+	}
+}
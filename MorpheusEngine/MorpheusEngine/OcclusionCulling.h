@@ -0,0 +1,138 @@
+#pragma once
+
+#include "BoundingVolumeHierarchy.h"
+#include "TransformMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class FJobSystem;
+
+// Counters of the current frame, reset by BeginFrame().
+struct FOcclusionCullingStats
+{
+	uint32_t Occluders = 0;
+	uint32_t OccluderTriangles = 0;
+	// Occluder triangles that face the camera, are in front of the near plane and overlap the view.
+	uint32_t RasterizedTriangles = 0;
+	uint32_t TestedObjects = 0;
+	uint32_t CulledObjects = 0;
+	// Setting up and rasterizing the occluders and building the hierarchy.
+	uint64_t RasterNanoseconds = 0;
+	uint64_t TestNanoseconds = 0;
+};
+
+// Software occlusion culling against a small depth buffer of selected occluders.
+//
+// Occluders are rasterized conservatively: a pixel is only written where an occluder covers it
+// completely, with the depth of the farthest point of the occluder in it, so the buffer never hides
+// more than the occluders do. Rows are tested 4 pixels at a time with a coverage mask per edge, and the
+// buffer is split into bands of rows that are rasterized on job workers. Every level of the hierarchy
+// above the buffer keeps the nearest and the farthest depth of the 2x2 texels below it. A box is hidden
+// when its nearest point is behind the farthest occluder depth over the pixels it covers, tested on a
+// coarse level first and refined only when the nearest depths there do not already prove it visible.
+//
+// A triangle that shares an edge with the next one in the index buffer is rasterized together with it
+// as a convex quad, as two triangles on their own would leave a seam of pixels neither covers completely.
+//
+// Depths are z / w of a [0, 1] depth range, 1 where there is no occluder. Not thread safe.
+class FOcclusionCuller
+{
+public:
+	static const uint32_t DefaultWidth = 320;
+	static const uint32_t DefaultHeight = 180;
+
+	FOcclusionCuller(uint32_t width = DefaultWidth, uint32_t height = DefaultHeight);
+
+	// Forgets the occluders of the last frame. The row vector view * projection matrix is the one the
+	// frame is drawn with, with a [0, 1] depth range as built by XMMatrixPerspectiveFovLH.
+	void BeginFrame(const FFloat4x4& viewProjection);
+
+	// Triangles of a mesh moved by a row vector world matrix. Front faces are clockwise, as in the
+	// rasterizer state; back faces and triangles that reach past the near plane are skipped. Only
+	// geometry that covers a lot of the screen is worth adding, and it must not be larger than what is
+	// drawn.
+	void AddOccluder(const FFloat3* positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const FFloat4x4& world);
+	// The 12 triangles of a local box, for walls and other geometry that fills its bounds.
+	void AddOccluderBox(const FBoundingBox& box, const FFloat4x4& world);
+
+	// Clears the buffer, rasterizes the occluders and builds the hierarchy.
+	void Rasterize(FJobSystem* jobSystem = nullptr);
+
+	// Whether any part of a world box may be seen past the occluders. Boxes reaching past the near
+	// plane or outside the view count as visible, those are for frustum culling to drop.
+	bool IsVisible(const FBoundingBox& box) const;
+	// Removes the indices of the hidden boxes of boxes[indices[i]], keeping the order, and returns how
+	// many are left.
+	uint32_t Cull(const FBoundingBox* boxes, std::vector<uint32_t>& indices, FJobSystem* jobSystem = nullptr);
+
+	uint32_t GetWidth() const;
+	uint32_t GetHeight() const;
+	// Level zero is the depth buffer, every level above it half the size, rounded up, down to 1x1.
+	uint32_t GetLevelCount() const;
+	uint32_t GetLevelWidth(uint32_t level) const;
+	uint32_t GetLevelHeight(uint32_t level) const;
+	// Floats between the starts of two rows of a level.
+	uint32_t GetLevelPitch(uint32_t level) const;
+	// Nearest and farthest occluder depth of the pixels under every texel, the same buffer on level zero.
+	const float* GetNearestDepths(uint32_t level) const;
+	const float* GetFarthestDepths(uint32_t level) const;
+
+	const FOcclusionCullingStats& GetStats() const;
+
+private:
+	// Rows of a band, so that the first BandLevels levels of a band only read the band.
+	static const uint32_t BandLevels = 4;
+	static const uint32_t BandHeight = 1 << BandLevels;
+	// Levels below the first coarse test of a box that are searched when it is not conclusive.
+	static const uint32_t RefineLevels = 2;
+
+	// A convex screen space polygon of one triangle, or of two that make a quad, ready to rasterize.
+	struct FOccluderPolygon
+	{
+		// Edge functions A * x + B * y + C at pixel centres, moved in by half a pixel so that they are
+		// not negative only for pixels entirely inside. A triangle repeats its first edge.
+		float EdgeA[4];
+		float EdgeB[4];
+		float EdgeC[4];
+		// Depth planes of the two triangles, DepthX * x + DepthY * y + DepthC, at the farthest corner
+		// of a pixel. A triangle has its plane twice. The farther plane is used, at most MaxDepth.
+		float DepthX[2];
+		float DepthY[2];
+		float DepthC[2];
+		float MaxDepth;
+		// Pixels the polygon may cover, inclusive.
+		int32_t MinX;
+		int32_t MinY;
+		int32_t MaxX;
+		int32_t MaxY;
+	};
+
+	struct FDepthLevel
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Pitch;
+		std::vector<float> Nearest;
+		// Empty on level zero, where it is the same as Nearest.
+		std::vector<float> Farthest;
+	};
+
+	// Adds the polygon of 3 or 4 vertices of ScreenPositions.
+	void AddPolygon(const uint32_t* vertices, uint32_t vertexCount);
+	void RasterizeBand(uint32_t band);
+	void BuildLevelRows(uint32_t level, uint32_t rowBegin, uint32_t rowEnd);
+	// Farthest and nearest depth over an inclusive rectangle of level zero pixels, on the given level.
+	void GetDepthRange(uint32_t level, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float& nearest, float& farthest) const;
+
+	FFloat4x4 ViewProjection;
+	std::vector<FDepthLevel> Levels;
+	std::vector<FOccluderPolygon> Polygons;
+	// Pixel coordinates and depth of the vertices of the occluder being added, the depth negative
+	// for vertices past the near plane.
+	std::vector<float> ScreenPositions;
+	// Visibility of every tested box, filled in parallel before compacting.
+	std::vector<uint8_t> Visible;
+	FOcclusionCullingStats Stats;
+	bool Rasterized;
+};
@@ -0,0 +1,596 @@
+#include "PipelineStateCache.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	const char* const ManifestHeader = "MorpheusPipelineStates 1";
+
+	uint32_t FloatBits(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		return bits;
+	}
+
+	float BitsFloat(uint32_t bits)
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+
+		return value;
+	}
+
+	bool SetError(std::string* error, const std::string& message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+
+		return false;
+	}
+
+	// The finaliser of MurmurHash3, every input bit affects every output bit.
+	uint64_t MixWords(uint64_t value)
+	{
+		value ^= value >> 33;
+		value *= 0xff51afd7ed558ccdull;
+		value ^= value >> 33;
+		value *= 0xc4ceb9fe1a85ec53ull;
+		value ^= value >> 33;
+
+		return value;
+	}
+
+	uint64_t HashBytecode(const FShaderBytecode& bytecode)
+	{
+		FHasher hasher;
+		hasher.Add(bytecode.Data, bytecode.Size);
+
+		return hasher.Get();
+	}
+
+	void CountCreation(FStateCacheCounters& counters, std::chrono::steady_clock::time_point start)
+	{
+		uint64_t nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+		counters.CreationNanoseconds += nanoseconds;
+		counters.MaxCreationNanoseconds = std::max(counters.MaxCreationNanoseconds, nanoseconds);
+	}
+
+	// One manifest line split at spaces, with the numbers read as unsigned integers.
+	struct FManifestLine
+	{
+		std::vector<std::string> Tokens;
+
+		bool GetNumber(size_t index, uint64_t& value, int base = 10) const
+		{
+			if (index >= Tokens.size() || Tokens[index].empty())
+			{
+				return false;
+			}
+
+			char* end = nullptr;
+			value = std::strtoull(Tokens[index].c_str(), &end, base);
+
+			return *end == '\0';
+		}
+
+		// Reads a field that must not exceed maximum, which keeps enums in range.
+		template<typename ValueType>
+		bool Get(size_t index, ValueType& value, uint64_t maximum) const
+		{
+			uint64_t number;
+			if (!GetNumber(index, number) || number > maximum)
+			{
+				return false;
+			}
+
+			value = static_cast<ValueType>(number);
+
+			return true;
+		}
+	};
+
+	void SplitLines(const std::string& text, std::vector<FManifestLine>& lines)
+	{
+		size_t lineBegin = 0;
+		while (lineBegin < text.size())
+		{
+			size_t lineEnd = text.find('\n', lineBegin);
+			lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd;
+
+			FManifestLine line;
+			size_t tokenBegin = text.find_first_not_of(" \t\r", lineBegin);
+			while (tokenBegin < lineEnd)
+			{
+				size_t tokenEnd = std::min(text.find_first_of(" \t\r", tokenBegin), lineEnd);
+				line.Tokens.push_back(text.substr(tokenBegin, tokenEnd - tokenBegin));
+				tokenBegin = text.find_first_not_of(" \t\r", tokenEnd);
+			}
+
+			if (!line.Tokens.empty())
+			{
+				lines.push_back(std::move(line));
+			}
+
+			lineBegin = lineEnd + 1;
+		}
+	}
+}
+
+// The fixed function descriptions pack into a few words, mixed rather than hashed byte by byte.
+size_t FPipelineStateCache::FKeyHash::operator()(const FRasterizerDesc& description) const
+{
+	uint64_t flags = uint64_t(description.FillMode) | uint64_t(description.CullMode) << 8 | uint64_t(description.FrontCounterClockwise) << 16 |
+		uint64_t(description.DepthClipEnable) << 17 | uint64_t(description.ScissorEnable) << 18 | uint64_t(description.MultisampleEnable) << 19 |
+		uint64_t(description.AntialiasedLineEnable) << 20 | uint64_t(uint32_t(description.DepthBias)) << 32;
+	uint64_t biases = uint64_t(FloatBits(description.DepthBiasClamp)) | uint64_t(FloatBits(description.SlopeScaledDepthBias)) << 32;
+
+	return static_cast<size_t>(MixWords(MixWords(flags) ^ biases));
+}
+
+size_t FPipelineStateCache::FKeyHash::operator()(const FDepthStencilDesc& description) const
+{
+	return static_cast<size_t>(MixWords(uint64_t(description.DepthEnable) | uint64_t(description.DepthWriteEnable) << 8 |
+		uint64_t(description.DepthFunc) << 16 | uint64_t(description.StencilEnable) << 24));
+}
+
+size_t FPipelineStateCache::FKeyHash::operator()(const FBlendDesc& description) const
+{
+	return static_cast<size_t>(MixWords(uint64_t(description.BlendEnable) | uint64_t(description.SourceBlend) << 8 |
+		uint64_t(description.DestinationBlend) << 16 | uint64_t(description.BlendOperation) << 24 | uint64_t(description.SourceBlendAlpha) << 32 |
+		uint64_t(description.DestinationBlendAlpha) << 40 | uint64_t(description.BlendOperationAlpha) << 48 | uint64_t(description.WriteMask) << 56 |
+		uint64_t(description.AlphaToCoverageEnable) << 60));
+}
+
+size_t FPipelineStateCache::FKeyHash::operator()(const FInputLayoutKey& key) const
+{
+	FHasher hasher;
+	hasher.Add(key.BytecodeHash);
+	hasher.Add(uint64_t(key.Elements.size()));
+
+	for (const FInputElementKey& element : key.Elements)
+	{
+		hasher.Add(element.SemanticName);
+		hasher.Add(uint64_t(element.SemanticIndex));
+		hasher.Add(uint64_t(element.Format));
+		hasher.Add(uint64_t(element.InputSlot));
+		hasher.Add(uint64_t(element.AlignedByteOffset));
+		hasher.Add(uint64_t(element.Classification));
+		hasher.Add(uint64_t(element.InstanceDataStepRate));
+	}
+
+	return static_cast<size_t>(hasher.Get());
+}
+
+size_t FPipelineStateCache::FKeyHash::operator()(const FPipelineKey& key) const
+{
+	uint64_t hash = MixWords(uint64_t(key.Values[0]) | uint64_t(key.Values[1]) << 32);
+	hash = MixWords(hash ^ (uint64_t(key.Values[2]) | uint64_t(key.Values[3]) << 32));
+
+	return static_cast<size_t>(MixWords(hash ^ (uint64_t(key.Values[4]) | uint64_t(key.Values[5]) << 32)));
+}
+
+// Floats compare by their bits, like they hash, so 0 and -0 are two states.
+bool FPipelineStateCache::FKeyEqual::operator()(const FRasterizerDesc& a, const FRasterizerDesc& b) const
+{
+	return a.FillMode == b.FillMode && a.CullMode == b.CullMode && a.FrontCounterClockwise == b.FrontCounterClockwise &&
+		a.DepthBias == b.DepthBias && FloatBits(a.DepthBiasClamp) == FloatBits(b.DepthBiasClamp) &&
+		FloatBits(a.SlopeScaledDepthBias) == FloatBits(b.SlopeScaledDepthBias) && a.DepthClipEnable == b.DepthClipEnable &&
+		a.ScissorEnable == b.ScissorEnable && a.MultisampleEnable == b.MultisampleEnable && a.AntialiasedLineEnable == b.AntialiasedLineEnable;
+}
+
+bool FPipelineStateCache::FKeyEqual::operator()(const FDepthStencilDesc& a, const FDepthStencilDesc& b) const
+{
+	return a.DepthEnable == b.DepthEnable && a.DepthWriteEnable == b.DepthWriteEnable && a.DepthFunc == b.DepthFunc && a.StencilEnable == b.StencilEnable;
+}
+
+bool FPipelineStateCache::FKeyEqual::operator()(const FBlendDesc& a, const FBlendDesc& b) const
+{
+	return a.BlendEnable == b.BlendEnable && a.SourceBlend == b.SourceBlend && a.DestinationBlend == b.DestinationBlend &&
+		a.BlendOperation == b.BlendOperation && a.SourceBlendAlpha == b.SourceBlendAlpha && a.DestinationBlendAlpha == b.DestinationBlendAlpha &&
+		a.BlendOperationAlpha == b.BlendOperationAlpha && a.WriteMask == b.WriteMask && a.AlphaToCoverageEnable == b.AlphaToCoverageEnable;
+}
+
+bool FPipelineStateCache::FKeyEqual::operator()(const FInputLayoutKey& a, const FInputLayoutKey& b) const
+{
+	if (a.BytecodeHash != b.BytecodeHash || a.Elements.size() != b.Elements.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < a.Elements.size(); ++i)
+	{
+		const FInputElementKey& elementA = a.Elements[i];
+		const FInputElementKey& elementB = b.Elements[i];
+
+		if (elementA.SemanticName != elementB.SemanticName || elementA.SemanticIndex != elementB.SemanticIndex || elementA.Format != elementB.Format ||
+			elementA.InputSlot != elementB.InputSlot || elementA.AlignedByteOffset != elementB.AlignedByteOffset ||
+			elementA.Classification != elementB.Classification || elementA.InstanceDataStepRate != elementB.InstanceDataStepRate)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FPipelineStateCache::FKeyEqual::operator()(const FPipelineKey& a, const FPipelineKey& b) const
+{
+	return std::memcmp(a.Values, b.Values, sizeof(a.Values)) == 0;
+}
+
+FPipelineStateCache::FPipelineStateCache(IRenderDevice* renderDevice)
+	: RenderDevice(renderDevice)
+{
+	assert(RenderDevice);
+}
+
+FPipelineStateCache::~FPipelineStateCache()
+{
+	for (const auto& state : RasterizerStates)
+	{
+		RenderDevice->DestroyRasterizerState(state.second);
+	}
+
+	for (const auto& state : DepthStencilStates)
+	{
+		RenderDevice->DestroyDepthStencilState(state.second);
+	}
+
+	for (const auto& state : BlendStates)
+	{
+		RenderDevice->DestroyBlendState(state.second);
+	}
+
+	for (const auto& inputLayout : InputLayouts)
+	{
+		RenderDevice->DestroyInputLayout(inputLayout.second);
+	}
+}
+
+template<typename KeyType, typename HandleType, typename CreateType>
+HandleType FPipelineStateCache::FindOrCreate(TStateMap<KeyType, HandleType>& states, std::vector<KeyType>& order, FStateCacheCounters& counters,
+	const KeyType& key, bool prewarm, const CreateType& create)
+{
+	auto found = states.find(key);
+	if (found != states.end())
+	{
+		counters.Hits += prewarm ? 0 : 1;
+		return found->second;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	HandleType handle = create();
+	CountCreation(counters, start);
+
+	if (!handle.IsValid())
+	{
+		++counters.Failures;
+		return handle;
+	}
+
+	if (prewarm)
+	{
+		++counters.Prewarmed;
+	}
+	else
+	{
+		++counters.Misses;
+	}
+
+	states.emplace(key, handle);
+	order.push_back(key);
+
+	return handle;
+}
+
+FRasterizerStateHandle FPipelineStateCache::GetRasterizerState(const FRasterizerDesc& description)
+{
+	return FindOrCreate(RasterizerStates, RasterizerStateOrder, Stats.RasterizerStates, description, false,
+		[&]() { return RenderDevice->CreateRasterizerState(description); });
+}
+
+FDepthStencilStateHandle FPipelineStateCache::GetDepthStencilState(const FDepthStencilDesc& description)
+{
+	return FindOrCreate(DepthStencilStates, DepthStencilStateOrder, Stats.DepthStencilStates, description, false,
+		[&]() { return RenderDevice->CreateDepthStencilState(description); });
+}
+
+FBlendStateHandle FPipelineStateCache::GetBlendState(const FBlendDesc& description)
+{
+	return FindOrCreate(BlendStates, BlendStateOrder, Stats.BlendStates, description, false,
+		[&]() { return RenderDevice->CreateBlendState(description); });
+}
+
+FInputLayoutHandle FPipelineStateCache::GetInputLayout(const FInputElementDesc* elements, uint32_t elementCount, const FShaderBytecode& vertexShaderBytecode)
+{
+	FInputLayoutKey key;
+	key.BytecodeHash = HashBytecode(vertexShaderBytecode);
+	key.Elements.resize(elementCount);
+
+	for (uint32_t i = 0; i < elementCount; ++i)
+	{
+		FInputElementKey& element = key.Elements[i];
+		element.SemanticName = elements[i].SemanticName ? elements[i].SemanticName : "";
+		element.SemanticIndex = elements[i].SemanticIndex;
+		element.Format = elements[i].Format;
+		element.InputSlot = elements[i].InputSlot;
+		element.AlignedByteOffset = elements[i].AlignedByteOffset;
+		element.Classification = elements[i].Classification;
+		element.InstanceDataStepRate = elements[i].InstanceDataStepRate;
+	}
+
+	return FindOrCreateInputLayout(key, vertexShaderBytecode, false);
+}
+
+FInputLayoutHandle FPipelineStateCache::FindOrCreateInputLayout(const FInputLayoutKey& key, const FShaderBytecode& vertexShaderBytecode, bool prewarm)
+{
+	return FindOrCreate(InputLayouts, InputLayoutOrder, Stats.InputLayouts, key, prewarm, [&]()
+	{
+		std::vector<FInputElementDesc> elements(key.Elements.size());
+		for (size_t i = 0; i < elements.size(); ++i)
+		{
+			const FInputElementKey& element = key.Elements[i];
+			elements[i].SemanticName = element.SemanticName.c_str();
+			elements[i].SemanticIndex = element.SemanticIndex;
+			elements[i].Format = element.Format;
+			elements[i].InputSlot = element.InputSlot;
+			elements[i].AlignedByteOffset = element.AlignedByteOffset;
+			elements[i].Classification = element.Classification;
+			elements[i].InstanceDataStepRate = element.InstanceDataStepRate;
+		}
+
+		return RenderDevice->CreateInputLayout(elements.data(), static_cast<uint32_t>(elements.size()), vertexShaderBytecode);
+	});
+}
+
+uint32_t FPipelineStateCache::GetPipeline(const FPipelineStateDesc& description)
+{
+	FDrawPipelineState state;
+	state.VertexShader = description.VertexShader;
+	state.PixelShader = description.PixelShader;
+	state.InputLayout = description.InputLayout;
+	state.RasterizerState = GetRasterizerState(description.Rasterizer);
+	state.DepthStencilState = GetDepthStencilState(description.DepthStencil);
+	state.BlendState = GetBlendState(description.Blend);
+
+	if (!state.RasterizerState.IsValid() || !state.DepthStencilState.IsValid() || !state.BlendState.IsValid())
+	{
+		++Stats.Pipelines.Failures;
+		return InvalidPipeline;
+	}
+
+	FPipelineKey key = { { state.VertexShader.Value, state.PixelShader.Value, state.InputLayout.Value, state.RasterizerState.Value,
+		state.DepthStencilState.Value, state.BlendState.Value } };
+
+	auto found = PipelineIds.find(key);
+	if (found != PipelineIds.end())
+	{
+		++Stats.Pipelines.Hits;
+		return found->second;
+	}
+
+	if (Pipelines.size() >= MaxPipelines)
+	{
+		++Stats.Pipelines.Failures;
+		return InvalidPipeline;
+	}
+
+	uint32_t pipeline = static_cast<uint32_t>(Pipelines.size());
+	Pipelines.push_back(state);
+	PipelineIds.emplace(key, pipeline);
+	++Stats.Pipelines.Misses;
+
+	return pipeline;
+}
+
+const FDrawPipelineState& FPipelineStateCache::GetPipelineState(uint32_t pipeline) const
+{
+	assert(pipeline < Pipelines.size());
+
+	return Pipelines[pipeline];
+}
+
+uint32_t FPipelineStateCache::GetPipelineCount() const
+{
+	return static_cast<uint32_t>(Pipelines.size());
+}
+
+// One line per state, enums as numbers and floats as their bits in hex:
+//   rasterizer <fill> <cull> <front ccw> <depth bias> <bias clamp> <slope bias> <depth clip> <scissor> <multisample> <aa lines>
+//   depthstencil <depth> <depth write> <depth func> <stencil>
+//   blend <enable> <source> <destination> <operation> <source alpha> <destination alpha> <operation alpha> <write mask> <alpha to coverage>
+//   inputlayout <bytecode hash> <element count>, followed by
+//   element <semantic> <index> <format> <slot> <offset> <classification> <step rate>
+bool FPipelineStateCache::SaveManifest(const char* fileName, std::string* error) const
+{
+	FILE* file = std::fopen(fileName, "wb");
+	if (!file)
+	{
+		return SetError(error, std::string("Could not create ") + fileName);
+	}
+
+	std::fprintf(file, "%s\n", ManifestHeader);
+
+	for (const FRasterizerDesc& state : RasterizerStateOrder)
+	{
+		std::fprintf(file, "rasterizer %u %u %u %u %x %x %u %u %u %u\n", unsigned(state.FillMode), unsigned(state.CullMode), unsigned(state.FrontCounterClockwise),
+			unsigned(uint32_t(state.DepthBias)), FloatBits(state.DepthBiasClamp), FloatBits(state.SlopeScaledDepthBias), unsigned(state.DepthClipEnable),
+			unsigned(state.ScissorEnable), unsigned(state.MultisampleEnable), unsigned(state.AntialiasedLineEnable));
+	}
+
+	for (const FDepthStencilDesc& state : DepthStencilStateOrder)
+	{
+		std::fprintf(file, "depthstencil %u %u %u %u\n", unsigned(state.DepthEnable), unsigned(state.DepthWriteEnable), unsigned(state.DepthFunc),
+			unsigned(state.StencilEnable));
+	}
+
+	for (const FBlendDesc& state : BlendStateOrder)
+	{
+		std::fprintf(file, "blend %u %u %u %u %u %u %u %u %u\n", unsigned(state.BlendEnable), unsigned(state.SourceBlend), unsigned(state.DestinationBlend),
+			unsigned(state.BlendOperation), unsigned(state.SourceBlendAlpha), unsigned(state.DestinationBlendAlpha), unsigned(state.BlendOperationAlpha),
+			unsigned(state.WriteMask), unsigned(state.AlphaToCoverageEnable));
+	}
+
+	for (const FInputLayoutKey& layout : InputLayoutOrder)
+	{
+		std::fprintf(file, "inputlayout %016llx %u\n", static_cast<unsigned long long>(layout.BytecodeHash), unsigned(layout.Elements.size()));
+
+		for (const FInputElementKey& element : layout.Elements)
+		{
+			std::fprintf(file, "element %s %u %u %u %u %u %u\n", element.SemanticName.c_str(), element.SemanticIndex, unsigned(element.Format),
+				element.InputSlot, element.AlignedByteOffset, unsigned(element.Classification), element.InstanceDataStepRate);
+		}
+	}
+
+	bool written = !std::ferror(file);
+	written = std::fclose(file) == 0 && written;
+
+	return written ? true : SetError(error, std::string("Could not write ") + fileName);
+}
+
+bool FPipelineStateCache::PrewarmFromManifest(const char* fileName, const FShaderBytecode* vertexShaders, uint32_t vertexShaderCount, std::string* error)
+{
+	FILE* file = std::fopen(fileName, "rb");
+	if (!file)
+	{
+		return SetError(error, std::string("Could not open ") + fileName);
+	}
+
+	std::string text;
+	char buffer[4096];
+	size_t bytesRead;
+	while ((bytesRead = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		text.append(buffer, bytesRead);
+	}
+	std::fclose(file);
+
+	std::vector<FManifestLine> lines;
+	SplitLines(text, lines);
+
+	if (lines.empty() || lines[0].Tokens.size() != 2 || lines[0].Tokens[0] + " " + lines[0].Tokens[1] != ManifestHeader)
+	{
+		return SetError(error, std::string(fileName) + " is not a pipeline state manifest of this version");
+	}
+
+	std::vector<uint64_t> bytecodeHashes(vertexShaderCount);
+	for (uint32_t i = 0; i < vertexShaderCount; ++i)
+	{
+		bytecodeHashes[i] = HashBytecode(vertexShaders[i]);
+	}
+
+	const uint64_t MaxFormat = uint64_t(EVertexFormat::UByte4Norm);
+	const uint64_t MaxBlendFactor = uint64_t(EBlendFactor::InverseDestinationAlpha);
+	const uint64_t MaxBlendOperation = uint64_t(EBlendOperation::Max);
+
+	for (size_t lineIndex = 1; lineIndex < lines.size(); ++lineIndex)
+	{
+		const FManifestLine& line = lines[lineIndex];
+		const std::string& type = line.Tokens[0];
+		bool valid = false;
+
+		if (type == "rasterizer" && line.Tokens.size() == 11)
+		{
+			FRasterizerDesc state;
+			uint32_t depthBias = 0;
+			uint64_t depthBiasClamp = 0;
+			uint64_t slopeScaledDepthBias = 0;
+
+			valid = line.Get(1, state.FillMode, uint64_t(EFillMode::Wireframe)) && line.Get(2, state.CullMode, uint64_t(ECullMode::Back)) &&
+				line.Get(3, state.FrontCounterClockwise, 1) && line.Get(4, depthBias, UINT32_MAX) &&
+				line.GetNumber(5, depthBiasClamp, 16) && depthBiasClamp <= UINT32_MAX && line.GetNumber(6, slopeScaledDepthBias, 16) && slopeScaledDepthBias <= UINT32_MAX &&
+				line.Get(7, state.DepthClipEnable, 1) && line.Get(8, state.ScissorEnable, 1) && line.Get(9, state.MultisampleEnable, 1) &&
+				line.Get(10, state.AntialiasedLineEnable, 1);
+
+			if (valid)
+			{
+				state.DepthBias = int32_t(depthBias);
+				state.DepthBiasClamp = BitsFloat(uint32_t(depthBiasClamp));
+				state.SlopeScaledDepthBias = BitsFloat(uint32_t(slopeScaledDepthBias));
+
+				FindOrCreate(RasterizerStates, RasterizerStateOrder, Stats.RasterizerStates, state, true,
+					[&]() { return RenderDevice->CreateRasterizerState(state); });
+			}
+		}
+		else if (type == "depthstencil" && line.Tokens.size() == 5)
+		{
+			FDepthStencilDesc state;
+			valid = line.Get(1, state.DepthEnable, 1) && line.Get(2, state.DepthWriteEnable, 1) && line.Get(3, state.DepthFunc, uint64_t(EComparisonFunc::Always)) &&
+				line.Get(4, state.StencilEnable, 1);
+
+			if (valid)
+			{
+				FindOrCreate(DepthStencilStates, DepthStencilStateOrder, Stats.DepthStencilStates, state, true,
+					[&]() { return RenderDevice->CreateDepthStencilState(state); });
+			}
+		}
+		else if (type == "blend" && line.Tokens.size() == 10)
+		{
+			FBlendDesc state;
+			valid = line.Get(1, state.BlendEnable, 1) && line.Get(2, state.SourceBlend, MaxBlendFactor) && line.Get(3, state.DestinationBlend, MaxBlendFactor) &&
+				line.Get(4, state.BlendOperation, MaxBlendOperation) && line.Get(5, state.SourceBlendAlpha, MaxBlendFactor) &&
+				line.Get(6, state.DestinationBlendAlpha, MaxBlendFactor) && line.Get(7, state.BlendOperationAlpha, MaxBlendOperation) &&
+				line.Get(8, state.WriteMask, ColourWrite_All) && line.Get(9, state.AlphaToCoverageEnable, 1);
+
+			if (valid)
+			{
+				FindOrCreate(BlendStates, BlendStateOrder, Stats.BlendStates, state, true,
+					[&]() { return RenderDevice->CreateBlendState(state); });
+			}
+		}
+		else if (type == "inputlayout" && line.Tokens.size() == 3)
+		{
+			FInputLayoutKey key;
+			uint32_t elementCount = 0;
+			valid = line.GetNumber(1, key.BytecodeHash, 16) && line.Get(2, elementCount, lines.size() - lineIndex - 1);
+
+			for (uint32_t i = 0; valid && i < elementCount; ++i)
+			{
+				const FManifestLine& elementLine = lines[++lineIndex];
+
+				FInputElementKey element;
+				valid = elementLine.Tokens.size() == 8 && elementLine.Tokens[0] == "element" && elementLine.Get(2, element.SemanticIndex, UINT32_MAX) &&
+					elementLine.Get(3, element.Format, MaxFormat) && elementLine.Get(4, element.InputSlot, UINT32_MAX) &&
+					elementLine.Get(5, element.AlignedByteOffset, UINT32_MAX) && elementLine.Get(6, element.Classification, uint64_t(EInputClassification::PerInstance)) &&
+					elementLine.Get(7, element.InstanceDataStepRate, UINT32_MAX);
+
+				element.SemanticName = valid ? elementLine.Tokens[1] : std::string();
+				key.Elements.push_back(element);
+			}
+
+			auto shader = std::find(bytecodeHashes.begin(), bytecodeHashes.end(), key.BytecodeHash);
+			if (valid && shader != bytecodeHashes.end())
+			{
+				FindOrCreateInputLayout(key, vertexShaders[shader - bytecodeHashes.begin()], true);
+			}
+		}
+
+		if (!valid)
+		{
+			return SetError(error, std::string(fileName) + ": malformed entry " + std::to_string(lineIndex) + " of the manifest");
+		}
+	}
+
+	return true;
+}
+
+const FPipelineStateCacheStats& FPipelineStateCache::GetStats() const
+{
+	return Stats;
+}
+
+void FPipelineStateCache::ResetStats()
+{
+	Stats = FPipelineStateCacheStats();
+}
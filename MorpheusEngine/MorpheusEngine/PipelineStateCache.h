@@ -0,0 +1,155 @@
+#pragma once
+
+#include "DrawList.h"
+#include "RenderDevice.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Counters of one kind of state object.
+struct FStateCacheCounters
+{
+	uint32_t Hits = 0;
+	uint32_t Misses = 0;
+	// Created from the manifest before anything asked for them.
+	uint32_t Prewarmed = 0;
+	uint32_t Failures = 0;
+	// Time spent in the device creating objects of this kind, and the longest single creation.
+	uint64_t CreationNanoseconds = 0;
+	uint64_t MaxCreationNanoseconds = 0;
+};
+
+struct FPipelineStateCacheStats
+{
+	FStateCacheCounters RasterizerStates;
+	FStateCacheCounters DepthStencilStates;
+	FStateCacheCounters BlendStates;
+	FStateCacheCounters InputLayouts;
+	// Combinations of the above with shaders, which cost the device nothing to create.
+	FStateCacheCounters Pipelines;
+};
+
+// A pipeline by value. The shaders and the input layout are created by the caller, the input layout
+// usually through GetInputLayout().
+struct FPipelineStateDesc
+{
+	FVertexShaderHandle VertexShader;
+	FPixelShaderHandle PixelShader;
+	FInputLayoutHandle InputLayout;
+	FRasterizerDesc Rasterizer;
+	FDepthStencilDesc DepthStencil;
+	FBlendDesc Blend;
+};
+
+// Hash-consed state objects. Every description is hashed field by field and looked up before the
+// device is asked, so identical states share one device object and asking again costs a hash.
+// Pipelines get dense ids from zero that fit the pipeline field of a draw sort key.
+//
+// The unique descriptions can be written to a manifest and created up front on the next run, so the
+// first frames that need them do not hitch. Not thread safe.
+class FPipelineStateCache
+{
+public:
+	static const uint32_t InvalidPipeline = ~0u;
+	static const uint32_t MaxPipelines = 1u << DrawSortPipelineBits;
+
+	explicit FPipelineStateCache(IRenderDevice* renderDevice);
+	// Destroys the states and input layouts it created. Shaders belong to the caller.
+	~FPipelineStateCache();
+
+	FPipelineStateCache(const FPipelineStateCache&) = delete;
+	FPipelineStateCache& operator=(const FPipelineStateCache&) = delete;
+
+	// Invalid handles when the device fails, which is not cached.
+	FRasterizerStateHandle GetRasterizerState(const FRasterizerDesc& description);
+	FDepthStencilStateHandle GetDepthStencilState(const FDepthStencilDesc& description);
+	FBlendStateHandle GetBlendState(const FBlendDesc& description);
+	// Keyed by the elements and a hash of the bytecode the layout is validated against.
+	FInputLayoutHandle GetInputLayout(const FInputElementDesc* elements, uint32_t elementCount, const FShaderBytecode& vertexShaderBytecode);
+
+	// InvalidPipeline when a state cannot be created or all MaxPipelines ids are taken.
+	uint32_t GetPipeline(const FPipelineStateDesc& description);
+	const FDrawPipelineState& GetPipelineState(uint32_t pipeline) const;
+	uint32_t GetPipelineCount() const;
+
+	// Writes every rasterizer, depth stencil and blend state and every input layout created so far.
+	bool SaveManifest(const char* fileName, std::string* error = nullptr) const;
+	// Creates the states a manifest lists. Input layouts are only created for the vertex shaders given,
+	// matched by bytecode hash, the others are skipped. Fails on a missing or malformed manifest, after
+	// creating what it could read.
+	bool PrewarmFromManifest(const char* fileName, const FShaderBytecode* vertexShaders, uint32_t vertexShaderCount, std::string* error = nullptr);
+
+	const FPipelineStateCacheStats& GetStats() const;
+	void ResetStats();
+
+private:
+	struct FInputElementKey
+	{
+		std::string SemanticName;
+		uint32_t SemanticIndex;
+		EVertexFormat Format;
+		uint32_t InputSlot;
+		uint32_t AlignedByteOffset;
+		EInputClassification Classification;
+		uint32_t InstanceDataStepRate;
+	};
+
+	struct FInputLayoutKey
+	{
+		std::vector<FInputElementKey> Elements;
+		uint64_t BytecodeHash;
+	};
+
+	struct FPipelineKey
+	{
+		uint32_t Values[6];
+	};
+
+	struct FKeyHash
+	{
+		size_t operator()(const FRasterizerDesc& description) const;
+		size_t operator()(const FDepthStencilDesc& description) const;
+		size_t operator()(const FBlendDesc& description) const;
+		size_t operator()(const FInputLayoutKey& key) const;
+		size_t operator()(const FPipelineKey& key) const;
+	};
+
+	struct FKeyEqual
+	{
+		bool operator()(const FRasterizerDesc& a, const FRasterizerDesc& b) const;
+		bool operator()(const FDepthStencilDesc& a, const FDepthStencilDesc& b) const;
+		bool operator()(const FBlendDesc& a, const FBlendDesc& b) const;
+		bool operator()(const FInputLayoutKey& a, const FInputLayoutKey& b) const;
+		bool operator()(const FPipelineKey& a, const FPipelineKey& b) const;
+	};
+
+	template<typename KeyType, typename HandleType>
+	using TStateMap = std::unordered_map<KeyType, HandleType, FKeyHash, FKeyEqual>;
+
+	// Looks the key up and creates the object on a miss, timing the device call.
+	template<typename KeyType, typename HandleType, typename CreateType>
+	HandleType FindOrCreate(TStateMap<KeyType, HandleType>& states, std::vector<KeyType>& order, FStateCacheCounters& counters,
+		const KeyType& key, bool prewarm, const CreateType& create);
+
+	FInputLayoutHandle FindOrCreateInputLayout(const FInputLayoutKey& key, const FShaderBytecode& vertexShaderBytecode, bool prewarm);
+
+	IRenderDevice* RenderDevice;
+
+	TStateMap<FRasterizerDesc, FRasterizerStateHandle> RasterizerStates;
+	TStateMap<FDepthStencilDesc, FDepthStencilStateHandle> DepthStencilStates;
+	TStateMap<FBlendDesc, FBlendStateHandle> BlendStates;
+	TStateMap<FInputLayoutKey, FInputLayoutHandle> InputLayouts;
+	TStateMap<FPipelineKey, uint32_t> PipelineIds;
+
+	// Keys in creation order, which is the order of the manifest.
+	std::vector<FRasterizerDesc> RasterizerStateOrder;
+	std::vector<FDepthStencilDesc> DepthStencilStateOrder;
+	std::vector<FBlendDesc> BlendStateOrder;
+	std::vector<FInputLayoutKey> InputLayoutOrder;
+
+	std::vector<FDrawPipelineState> Pipelines;
+
+	FPipelineStateCacheStats Stats;
+};
@@ -0,0 +1,117 @@
+#include "PoolAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+FPoolAllocator::FPoolAllocator(size_t blockSize, size_t blockAlignment, uint32_t blocksPerPage)
+	: BlockAlignment(std::max(blockAlignment, alignof(FFreeBlock)))
+	, BlocksPerPage(blocksPerPage > 0 ? blocksPerPage : DefaultBlocksPerPage)
+	, FreeList(nullptr)
+	, LiveCount(0)
+{
+	assert((BlockAlignment & (BlockAlignment - 1)) == 0);
+
+	// Every block must hold the free list link and keep the next block aligned.
+	BlockSize = std::max(blockSize, sizeof(FFreeBlock));
+	BlockSize = (BlockSize + BlockAlignment - 1) & ~(BlockAlignment - 1);
+}
+
+FPoolAllocator::~FPoolAllocator()
+{
+	assert(LiveCount == 0);
+
+	for (void* page : Pages)
+	{
+		::operator delete(page, std::align_val_t(BlockAlignment));
+	}
+}
+
+void* FPoolAllocator::Allocate()
+{
+	if (!FreeList)
+	{
+		AddPage();
+	}
+
+	FFreeBlock* block = FreeList;
+	FreeList = block->Next;
+	++LiveCount;
+
+	++Stats.Allocations;
+	Stats.BytesAllocated += BlockSize;
+	Stats.PeakBytes = std::max<uint64_t>(Stats.PeakBytes, static_cast<uint64_t>(LiveCount) * BlockSize);
+	return block;
+}
+
+void FPoolAllocator::Free(void* block)
+{
+	if (!block)
+	{
+		return;
+	}
+
+	assert(LiveCount > 0);
+
+	FFreeBlock* freeBlock = static_cast<FFreeBlock*>(block);
+	freeBlock->Next = FreeList;
+	FreeList = freeBlock;
+	--LiveCount;
+}
+
+void FPoolAllocator::Reserve(uint32_t blockCount)
+{
+	while (GetCapacity() < blockCount)
+	{
+		AddPage();
+	}
+}
+
+size_t FPoolAllocator::GetBlockSize() const
+{
+	return BlockSize;
+}
+
+size_t FPoolAllocator::GetBlockAlignment() const
+{
+	return BlockAlignment;
+}
+
+uint32_t FPoolAllocator::GetLiveCount() const
+{
+	return LiveCount;
+}
+
+uint32_t FPoolAllocator::GetCapacity() const
+{
+	return static_cast<uint32_t>(Pages.size()) * BlocksPerPage;
+}
+
+const FAllocatorStats& FPoolAllocator::GetStats() const
+{
+	return Stats;
+}
+
+void FPoolAllocator::ResetStats()
+{
+	uint64_t heapBytes = Stats.HeapBytes;
+	Stats = FAllocatorStats();
+	Stats.HeapBytes = heapBytes;
+}
+
+void FPoolAllocator::AddPage()
+{
+	size_t pageSize = BlockSize * BlocksPerPage;
+	uint8_t* page = static_cast<uint8_t*>(::operator new(pageSize, std::align_val_t(BlockAlignment)));
+	Pages.push_back(page);
+
+	// Linked back to front, so the blocks of a fresh page are handed out in address order.
+	for (uint32_t i = BlocksPerPage; i > 0; --i)
+	{
+		FFreeBlock* block = reinterpret_cast<FFreeBlock*>(page + static_cast<size_t>(i - 1) * BlockSize);
+		block->Next = FreeList;
+		FreeList = block;
+	}
+
+	++Stats.HeapAllocations;
+	Stats.HeapBytes += pageSize;
+}
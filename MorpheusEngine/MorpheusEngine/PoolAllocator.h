@@ -0,0 +1,169 @@
+#pragma once
+
+#include "MemoryArena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Fixed-size blocks carved from pages of blocksPerPage, with freed blocks kept on an intrusive free
+// list. Allocating and freeing are a pointer swap; the heap is only asked for whole pages, so a pool
+// reserved for its peak count never touches it again. Not thread safe.
+class FPoolAllocator
+{
+public:
+	static const uint32_t DefaultBlocksPerPage = 256;
+
+	FPoolAllocator(size_t blockSize, size_t blockAlignment = alignof(std::max_align_t), uint32_t blocksPerPage = DefaultBlocksPerPage);
+	~FPoolAllocator();
+
+	FPoolAllocator(const FPoolAllocator&) = delete;
+	FPoolAllocator& operator=(const FPoolAllocator&) = delete;
+
+	void* Allocate();
+	// Accepts null. The block must come from this pool.
+	void Free(void* block);
+
+	// Adds pages until blockCount blocks exist.
+	void Reserve(uint32_t blockCount);
+
+	size_t GetBlockSize() const;
+	size_t GetBlockAlignment() const;
+	uint32_t GetLiveCount() const;
+	uint32_t GetCapacity() const;
+
+	// BytesAllocated counts whole blocks.
+	const FAllocatorStats& GetStats() const;
+	void ResetStats();
+
+private:
+	struct FFreeBlock
+	{
+		FFreeBlock* Next;
+	};
+
+	void AddPage();
+
+	size_t BlockSize;
+	size_t BlockAlignment;
+	uint32_t BlocksPerPage;
+	std::vector<void*> Pages;
+	FFreeBlock* FreeList;
+	uint32_t LiveCount;
+	FAllocatorStats Stats;
+};
+
+// Typed front of a pool that constructs and destroys the objects it hands out.
+template<typename T>
+class TObjectPool
+{
+public:
+	explicit TObjectPool(uint32_t objectsPerPage = FPoolAllocator::DefaultBlocksPerPage)
+		: Pool(sizeof(T), alignof(T), objectsPerPage)
+	{
+	}
+
+	template<typename... ArgumentTypes>
+	T* New(ArgumentTypes&&... arguments)
+	{
+		void* block = Pool.Allocate();
+		try
+		{
+			return new (block) T(std::forward<ArgumentTypes>(arguments)...);
+		}
+		catch (...)
+		{
+			Pool.Free(block);
+			throw;
+		}
+	}
+
+	void Delete(T* object)
+	{
+		if (object)
+		{
+			object->~T();
+			Pool.Free(object);
+		}
+	}
+
+	FPoolAllocator& GetPool()
+	{
+		return Pool;
+	}
+
+private:
+	FPoolAllocator Pool;
+};
+
+// Lets node-based containers such as std::list and std::map take their nodes from a pool. Requests
+// that do not fit one block, like the bucket array of an unordered_map, fall back to the general heap.
+template<typename T>
+class TPoolAllocator
+{
+public:
+	using value_type = T;
+
+	explicit TPoolAllocator(FPoolAllocator& pool)
+		: Pool(&pool)
+	{
+	}
+
+	template<typename U>
+	TPoolAllocator(const TPoolAllocator<U>& other)
+		: Pool(other.GetPool())
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		if (FitsBlock(count))
+		{
+			return static_cast<T*>(Pool->Allocate());
+		}
+		if (count > SIZE_MAX / sizeof(T))
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(::operator new(count * sizeof(T)));
+	}
+
+	void deallocate(T* pointer, size_t count)
+	{
+		if (FitsBlock(count))
+		{
+			Pool->Free(pointer);
+		}
+		else
+		{
+			::operator delete(pointer);
+		}
+	}
+
+	FPoolAllocator* GetPool() const
+	{
+		return Pool;
+	}
+
+private:
+	bool FitsBlock(size_t count) const
+	{
+		return count == 1 && sizeof(T) <= Pool->GetBlockSize() && alignof(T) <= Pool->GetBlockAlignment();
+	}
+
+	FPoolAllocator* Pool;
+};
+
+template<typename T, typename U>
+bool operator==(const TPoolAllocator<T>& a, const TPoolAllocator<U>& b)
+{
+	return a.GetPool() == b.GetPool();
+}
+
+template<typename T, typename U>
+bool operator!=(const TPoolAllocator<T>& a, const TPoolAllocator<U>& b)
+{
+	return a.GetPool() != b.GetPool();
+}
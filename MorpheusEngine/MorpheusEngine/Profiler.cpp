@@ -0,0 +1,369 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define MORPHEUS_PROFILER_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MORPHEUS_PROFILER_TSC 1
+#else
+#define MORPHEUS_PROFILER_TSC 0
+#endif
+
+namespace
+{
+	const uint32_t DefaultBufferCapacity = 64 * 1024;
+	// Track of the GPU ranges in the trace, the threads follow from one.
+	const uint32_t GpuTrackId = 0;
+
+	enum class EProfileEventType : uint8_t
+	{
+		Scope,
+		Counter,
+		Frame,
+		GpuScope
+	};
+
+	struct FProfileEvent
+	{
+		const char* Name;
+		uint64_t Start;
+		// The end of a scope, the value of a counter or the number of a frame.
+		uint64_t Value;
+		EProfileEventType Type;
+	};
+
+	// An event as the ring holds it. The fields are relaxed atomics because an export may read a slot
+	// while its thread overwrites it; the read is a sequence lock on WriteCount and drops such slots.
+	struct FProfileEventSlot
+	{
+		std::atomic<const char*> Name{ nullptr };
+		std::atomic<uint64_t> Start{ 0 };
+		std::atomic<uint64_t> Value{ 0 };
+		std::atomic<EProfileEventType> Type{ EProfileEventType::Scope };
+	};
+
+	// Written by its thread only. WriteCount is published after the event, so a reader sees complete
+	// events below it. Slot WriteCount & Mask is the one being written next, and once the ring is full
+	// it is also the oldest, so a reader never trusts it.
+	struct FThreadBuffer
+	{
+		std::unique_ptr<FProfileEventSlot[]> Slots;
+		uint64_t Capacity = 0;
+		uint64_t Mask = 0;
+		std::atomic<uint64_t> WriteCount{ 0 };
+		uint32_t TrackId = 0;
+		// Guarded by threadBuffersMutex.
+		std::string Name;
+	};
+
+	std::atomic<bool> profilerEnabled(false);
+	std::atomic<uint32_t> bufferCapacity(DefaultBufferCapacity);
+	std::atomic<uint64_t> captureStart(0);
+	std::atomic<uint64_t> framesMarked(0);
+
+	std::mutex threadBuffersMutex;
+	std::vector<std::unique_ptr<FThreadBuffer>> threadBuffers;
+
+	thread_local FThreadBuffer* localBuffer = nullptr;
+	// Kept until the thread records, so naming a thread does not register a buffer.
+	thread_local std::string localThreadName;
+
+	bool SetError(std::string* error, const std::string& message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+
+		return false;
+	}
+
+	FThreadBuffer* GetThreadBuffer()
+	{
+		if (!localBuffer)
+		{
+			uint32_t capacity = 1;
+			while (capacity < bufferCapacity.load(std::memory_order_relaxed) && capacity < (1u << 31))
+			{
+				capacity <<= 1;
+			}
+
+			std::unique_ptr<FThreadBuffer> buffer(new FThreadBuffer());
+			buffer->Slots.reset(new FProfileEventSlot[capacity]);
+			buffer->Capacity = capacity;
+			buffer->Mask = capacity - 1;
+
+			std::lock_guard<std::mutex> lock(threadBuffersMutex);
+			buffer->TrackId = static_cast<uint32_t>(threadBuffers.size()) + 1;
+			buffer->Name = localThreadName.empty() ? "Thread " + std::to_string(buffer->TrackId) : localThreadName;
+			localBuffer = buffer.get();
+			threadBuffers.push_back(std::move(buffer));
+		}
+
+		return localBuffer;
+	}
+
+	void WriteEvent(EProfileEventType type, const char* name, uint64_t start, uint64_t value)
+	{
+		FThreadBuffer* buffer = GetThreadBuffer();
+
+		uint64_t index = buffer->WriteCount.load(std::memory_order_relaxed);
+		FProfileEventSlot& slot = buffer->Slots[index & buffer->Mask];
+
+		// Orders the previous WriteCount before the fields, so a reader that copied any of them sees
+		// that count again afterwards. Free on x86, as are the relaxed stores.
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.Name.store(name, std::memory_order_relaxed);
+		slot.Start.store(start, std::memory_order_relaxed);
+		slot.Value.store(value, std::memory_order_relaxed);
+		slot.Type.store(type, std::memory_order_relaxed);
+		buffer->WriteCount.store(index + 1, std::memory_order_release);
+	}
+
+	void WriteJsonString(FILE* file, const char* text)
+	{
+		std::fputc('"', file);
+		for (const char* character = text ? text : ""; *character; ++character)
+		{
+			unsigned char value = static_cast<unsigned char>(*character);
+			if (value == '"' || value == '\\')
+			{
+				std::fputc('\\', file);
+				std::fputc(value, file);
+			}
+			else if (value < 0x20)
+			{
+				std::fprintf(file, "\\u%04x", value);
+			}
+			else
+			{
+				std::fputc(value, file);
+			}
+		}
+		std::fputc('"', file);
+	}
+
+	uint64_t GetSteadyNanoseconds()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	double ToMicroseconds(uint64_t ticks, uint64_t origin, double ticksPerNanosecond)
+	{
+		return ticks >= origin ? static_cast<double>(ticks - origin) * 1e-3 / ticksPerNanosecond : 0.0;
+	}
+}
+
+void SetProfilerEnabled(bool enabled)
+{
+	profilerEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsProfilerEnabled()
+{
+	return profilerEnabled.load(std::memory_order_relaxed);
+}
+
+void SetProfilerBufferCapacity(uint32_t eventCount)
+{
+	bufferCapacity.store(std::max(eventCount, 1u), std::memory_order_relaxed);
+}
+
+void SetProfilerThreadName(const char* name)
+{
+	localThreadName = name;
+
+	if (localBuffer)
+	{
+		std::lock_guard<std::mutex> lock(threadBuffersMutex);
+		localBuffer->Name = name;
+	}
+}
+
+uint64_t GetProfilerTimestamp()
+{
+#if MORPHEUS_PROFILER_TSC
+	return __rdtsc();
+#else
+	return GetSteadyNanoseconds();
+#endif
+}
+
+double GetProfilerTicksPerNanosecond()
+{
+#if MORPHEUS_PROFILER_TSC
+	struct FCalibration
+	{
+		uint64_t Ticks;
+		uint64_t Nanoseconds;
+	};
+
+	// The first call measures a few milliseconds, later ones the whole time since then.
+	static const FCalibration origin = []()
+	{
+		FCalibration calibration = { GetProfilerTimestamp(), GetSteadyNanoseconds() };
+		while (GetSteadyNanoseconds() - calibration.Nanoseconds < 5000000)
+		{
+		}
+		return calibration;
+	}();
+
+	uint64_t ticks = GetProfilerTimestamp();
+	uint64_t nanoseconds = GetSteadyNanoseconds();
+
+	return static_cast<double>(ticks - origin.Ticks) / static_cast<double>(nanoseconds - origin.Nanoseconds);
+#else
+	return 1.0;
+#endif
+}
+
+void RecordProfileScope(const char* name, uint64_t startTicks, uint64_t endTicks)
+{
+	WriteEvent(EProfileEventType::Scope, name, startTicks, endTicks);
+}
+
+void RecordProfileCounter(const char* name, int64_t value)
+{
+	if (IsProfilerEnabled())
+	{
+		WriteEvent(EProfileEventType::Counter, name, GetProfilerTimestamp(), static_cast<uint64_t>(value));
+	}
+}
+
+void RecordProfileFrame()
+{
+	if (IsProfilerEnabled())
+	{
+		WriteEvent(EProfileEventType::Frame, "Frame", GetProfilerTimestamp(), framesMarked.fetch_add(1, std::memory_order_relaxed));
+	}
+}
+
+void RecordProfileGpuScope(const char* name, uint64_t startTicks, uint64_t endTicks)
+{
+	WriteEvent(EProfileEventType::GpuScope, name, startTicks, endTicks);
+}
+
+void BeginProfilerCapture()
+{
+	// Calibrates the clock here rather than in the first export.
+	GetProfilerTicksPerNanosecond();
+
+	captureStart.store(GetProfilerTimestamp(), std::memory_order_relaxed);
+	SetProfilerEnabled(true);
+}
+
+bool EndProfilerCapture(const char* fileName, std::string* error)
+{
+	SetProfilerEnabled(false);
+
+	uint64_t origin = captureStart.load(std::memory_order_relaxed);
+	double ticksPerNanosecond = GetProfilerTicksPerNanosecond();
+
+	FILE* file = std::fopen(fileName, "wb");
+	if (!file)
+	{
+		return SetError(error, std::string("Could not create ") + fileName);
+	}
+
+	std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", GpuTrackId);
+
+	std::vector<FProfileEvent> events;
+
+	std::lock_guard<std::mutex> lock(threadBuffersMutex);
+	for (const std::unique_ptr<FThreadBuffer>& buffer : threadBuffers)
+	{
+		std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", buffer->TrackId);
+		WriteJsonString(file, buffer->Name.c_str());
+		std::fprintf(file, "}}");
+
+		// Scopes opened before the capture ended still record, so the threads may be writing. Copy first,
+		// then drop whatever they may have overwritten while it was copied, as a sequence lock would.
+		uint64_t size = buffer->Capacity;
+		uint64_t end = buffer->WriteCount.load(std::memory_order_acquire);
+		uint64_t begin = end >= size ? end - size + 1 : 0;
+
+		events.clear();
+		for (uint64_t index = begin; index < end; ++index)
+		{
+			const FProfileEventSlot& slot = buffer->Slots[index & buffer->Mask];
+
+			FProfileEvent event;
+			event.Name = slot.Name.load(std::memory_order_relaxed);
+			event.Start = slot.Start.load(std::memory_order_relaxed);
+			event.Value = slot.Value.load(std::memory_order_relaxed);
+			event.Type = slot.Type.load(std::memory_order_relaxed);
+			events.push_back(event);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t writtenSince = buffer->WriteCount.load(std::memory_order_relaxed);
+		uint64_t firstIntact = writtenSince >= size ? writtenSince - size + 1 : 0;
+		size_t skipped = static_cast<size_t>(std::min<uint64_t>(firstIntact > begin ? firstIntact - begin : 0, events.size()));
+
+		for (size_t i = skipped; i < events.size(); ++i)
+		{
+			const FProfileEvent& event = events[i];
+			if (event.Start < origin)
+			{
+				continue;
+			}
+
+			std::fprintf(file, ",\n{\"name\":");
+			WriteJsonString(file, event.Name);
+
+			switch (event.Type)
+			{
+				case EProfileEventType::Scope:
+				case EProfileEventType::GpuScope:
+					std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						event.Type == EProfileEventType::GpuScope ? GpuTrackId : buffer->TrackId, ToMicroseconds(event.Start, origin, ticksPerNanosecond),
+						ToMicroseconds(event.Value, event.Start, ticksPerNanosecond));
+					break;
+
+				case EProfileEventType::Counter:
+					std::fprintf(file, ",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%lld}}", buffer->TrackId,
+						ToMicroseconds(event.Start, origin, ticksPerNanosecond), static_cast<long long>(event.Value));
+					break;
+
+				case EProfileEventType::Frame:
+					std::fprintf(file, ",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"frame\":%llu}}", buffer->TrackId,
+						ToMicroseconds(event.Start, origin, ticksPerNanosecond), static_cast<unsigned long long>(event.Value));
+					break;
+			}
+		}
+	}
+
+	std::fprintf(file, "\n]}\n");
+
+	bool written = !std::ferror(file);
+	written = std::fclose(file) == 0 && written;
+
+	return written ? true : SetError(error, std::string("Could not write ") + fileName);
+}
+
+FProfilerStats GetProfilerStats()
+{
+	FProfilerStats stats;
+	stats.FramesMarked = framesMarked.load(std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(threadBuffersMutex);
+	stats.Threads = static_cast<uint32_t>(threadBuffers.size());
+	for (const std::unique_ptr<FThreadBuffer>& buffer : threadBuffers)
+	{
+		uint64_t written = buffer->WriteCount.load(std::memory_order_relaxed);
+		stats.EventsRecorded += written;
+		stats.EventsOverwritten += written > buffer->Capacity ? written - buffer->Capacity : 0;
+	}
+
+	return stats;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Zero compiles every profiling macro away. Compiled in, the profiler still records nothing until it
+// is enabled, and a disabled scope costs a check of one flag.
+#ifndef MORPHEUS_PROFILER_ENABLED
+#define MORPHEUS_PROFILER_ENABLED 1
+#endif
+
+struct FProfilerStats
+{
+	uint32_t Threads = 0;
+	uint64_t EventsRecorded = 0;
+	// Events overwritten in a thread buffer that wrapped around.
+	uint64_t EventsOverwritten = 0;
+	uint64_t FramesMarked = 0;
+};
+
+// Every thread records into its own ring buffer, which only that thread writes, so recording takes
+// no lock. A thread that records for the first time registers its buffer; buffers live until exit.
+void SetProfilerEnabled(bool enabled);
+bool IsProfilerEnabled();
+// Events each thread keeps, rounded up to a power of two. Affects buffers registered afterwards.
+void SetProfilerBufferCapacity(uint32_t eventCount);
+// Names the track of the calling thread in the exported trace.
+void SetProfilerThreadName(const char* name);
+
+// Ticks of the cheapest clock there is, the time stamp counter on x86 and nanoseconds elsewhere.
+// They are only converted to time when a capture is written.
+uint64_t GetProfilerTimestamp();
+// Measured against the steady clock since the first call, which spins for a few milliseconds.
+double GetProfilerTicksPerNanosecond();
+
+// Names are stored as pointers and must outlive the capture, which string literals do.
+void RecordProfileScope(const char* name, uint64_t startTicks, uint64_t endTicks);
+void RecordProfileCounter(const char* name, int64_t value);
+// Marks the start of a frame on the calling thread.
+void RecordProfileFrame();
+// A range that ran on the GPU, already converted to GetProfilerTimestamp() ticks. All of them share
+// one track in the trace.
+void RecordProfileGpuScope(const char* name, uint64_t startTicks, uint64_t endTicks);
+
+// Enables recording and starts a capture; events recorded before are left out of it.
+void BeginProfilerCapture();
+// Disables recording and writes what the buffers still hold of the capture as Chrome trace event
+// JSON, which chrome://tracing and Perfetto open. Other threads may still be inside scopes; an event
+// they write while it is copied is left out rather than exported half written.
+bool EndProfilerCapture(const char* fileName, std::string* error = nullptr);
+
+FProfilerStats GetProfilerStats();
+
+// Times the enclosing scope. Whether to record is decided on entry.
+class FProfileScope
+{
+public:
+	explicit FProfileScope(const char* name)
+		: Name(IsProfilerEnabled() ? name : nullptr)
+		, Start(Name ? GetProfilerTimestamp() : 0)
+	{
+	}
+
+	~FProfileScope()
+	{
+		if (Name)
+		{
+			RecordProfileScope(Name, Start, GetProfilerTimestamp());
+		}
+	}
+
+	FProfileScope(const FProfileScope&) = delete;
+	FProfileScope& operator=(const FProfileScope&) = delete;
+
+private:
+	const char* Name;
+	uint64_t Start;
+};
+
+// Timestamp queries of a graphics API. Ranges are recorded with the frame they were issued in and
+// passed to RecordProfileGpuScope() once the GPU has resolved them, a few frames later.
+class IGpuProfiler
+{
+public:
+	static const uint32_t InvalidRange = ~0u;
+
+	virtual ~IGpuProfiler() = default;
+
+	virtual void BeginFrame() = 0;
+	// InvalidRange while the profiler is disabled or the frame has no queries left.
+	virtual uint32_t BeginRange(const char* name) = 0;
+	virtual void EndRange(uint32_t range) = 0;
+	virtual void EndFrame() = 0;
+};
+
+// Times the GPU work recorded in the enclosing scope. Accepts a null profiler.
+class FGpuProfileScope
+{
+public:
+	FGpuProfileScope(IGpuProfiler* gpuProfiler, const char* name)
+		: GpuProfiler(gpuProfiler)
+		, Range(gpuProfiler ? gpuProfiler->BeginRange(name) : IGpuProfiler::InvalidRange)
+	{
+	}
+
+	~FGpuProfileScope()
+	{
+		if (Range != IGpuProfiler::InvalidRange)
+		{
+			GpuProfiler->EndRange(Range);
+		}
+	}
+
+	FGpuProfileScope(const FGpuProfileScope&) = delete;
+	FGpuProfileScope& operator=(const FGpuProfileScope&) = delete;
+
+private:
+	IGpuProfiler* GpuProfiler;
+	uint32_t Range;
+};
+
+#define MORPHEUS_PROFILE_CONCATENATE_INNER(a, b) a##b
+#define MORPHEUS_PROFILE_CONCATENATE(a, b) MORPHEUS_PROFILE_CONCATENATE_INNER(a, b)
+
+#if MORPHEUS_PROFILER_ENABLED
+#define MORPHEUS_PROFILE_SCOPE(name) FProfileScope MORPHEUS_PROFILE_CONCATENATE(profileScope, __LINE__)(name)
+#define MORPHEUS_PROFILE_FUNCTION() MORPHEUS_PROFILE_SCOPE(__FUNCTION__)
+#define MORPHEUS_PROFILE_GPU_SCOPE(gpuProfiler, name) FGpuProfileScope MORPHEUS_PROFILE_CONCATENATE(gpuProfileScope, __LINE__)(gpuProfiler, name)
+#define MORPHEUS_PROFILE_COUNTER(name, value) RecordProfileCounter(name, static_cast<int64_t>(value))
+#define MORPHEUS_PROFILE_FRAME() RecordProfileFrame()
+#else
+#define MORPHEUS_PROFILE_SCOPE(name) ((void)0)
+#define MORPHEUS_PROFILE_FUNCTION() ((void)0)
+#define MORPHEUS_PROFILE_GPU_SCOPE(gpuProfiler, name) ((void)0)
+#define MORPHEUS_PROFILE_COUNTER(name, value) ((void)0)
+#define MORPHEUS_PROFILE_FRAME() ((void)0)
+#endif
@@ -0,0 +1,152 @@
+#include "RadixSort.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	template<typename FunctionType>
+	void ForEachChunk(FJobSystem* jobSystem, uint32_t chunkCount, const FunctionType& function)
+	{
+		if (chunkCount == 1)
+		{
+			function(0);
+			return;
+		}
+
+		jobSystem->ParallelFor(chunkCount, 1, [&function](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t chunk = begin; chunk < end; ++chunk)
+			{
+				function(chunk);
+			}
+		});
+	}
+}
+
+void FRadixSorter::Sort(uint64_t* keys, uint32_t* values, uint32_t count, FJobSystem* jobSystem)
+{
+	LastPassCount = 0;
+
+	if (count < 2)
+	{
+		return;
+	}
+
+	uint32_t chunkCount = 1;
+	if (jobSystem)
+	{
+		chunkCount = std::max(1u, std::min(jobSystem->GetConcurrency(), count / MinKeysPerChunk));
+	}
+
+	if (ScratchKeys.size() < count)
+	{
+		ScratchKeys.resize(count);
+		ScratchValues.resize(count);
+	}
+
+	Histograms.assign(static_cast<size_t>(chunkCount) * PassCount * BucketCount, 0);
+	Offsets.resize(static_cast<size_t>(chunkCount) * BucketCount);
+
+	auto chunkBegin = [count, chunkCount](uint32_t chunk)
+	{
+		return static_cast<uint32_t>(static_cast<uint64_t>(count) * chunk / chunkCount);
+	};
+
+	// One read counts the digits of every pass. The totals show which passes can be skipped, and until
+	// the first scatter they are also the per-chunk counts of the pass.
+	ForEachChunk(jobSystem, chunkCount, [&](uint32_t chunk)
+	{
+		uint32_t* histogram = &Histograms[static_cast<size_t>(chunk) * PassCount * BucketCount];
+		for (uint32_t i = chunkBegin(chunk), end = chunkBegin(chunk + 1); i < end; ++i)
+		{
+			uint64_t key = keys[i];
+			for (uint32_t pass = 0; pass < PassCount; ++pass)
+			{
+				++histogram[pass * BucketCount + ((key >> (pass * 8)) & 0xff)];
+			}
+		}
+	});
+
+	uint64_t* sourceKeys = keys;
+	uint32_t* sourceValues = values;
+	uint64_t* targetKeys = ScratchKeys.data();
+	uint32_t* targetValues = ScratchValues.data();
+
+	for (uint32_t pass = 0; pass < PassCount; ++pass)
+	{
+		const uint32_t shift = pass * 8;
+
+		bool sameDigit = false;
+		for (uint32_t bucket = 0; bucket < BucketCount && !sameDigit; ++bucket)
+		{
+			uint32_t total = 0;
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				total += Histograms[(static_cast<size_t>(chunk) * PassCount + pass) * BucketCount + bucket];
+			}
+
+			sameDigit = total == count;
+		}
+
+		if (sameDigit)
+		{
+			continue;
+		}
+
+		// A scatter moves keys between chunks, so later passes count their chunks again.
+		if (chunkCount > 1 && LastPassCount > 0)
+		{
+			ForEachChunk(jobSystem, chunkCount, [&](uint32_t chunk)
+			{
+				uint32_t* histogram = &Histograms[(static_cast<size_t>(chunk) * PassCount + pass) * BucketCount];
+				std::fill(histogram, histogram + BucketCount, 0u);
+
+				for (uint32_t i = chunkBegin(chunk), end = chunkBegin(chunk + 1); i < end; ++i)
+				{
+					++histogram[(sourceKeys[i] >> shift) & 0xff];
+				}
+			});
+		}
+
+		// Bucket major, then chunk order, which keeps the sort stable.
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < BucketCount; ++bucket)
+		{
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				Offsets[static_cast<size_t>(chunk) * BucketCount + bucket] = offset;
+				offset += Histograms[(static_cast<size_t>(chunk) * PassCount + pass) * BucketCount + bucket];
+			}
+		}
+
+		ForEachChunk(jobSystem, chunkCount, [&](uint32_t chunk)
+		{
+			uint32_t* offsets = &Offsets[static_cast<size_t>(chunk) * BucketCount];
+			for (uint32_t i = chunkBegin(chunk), end = chunkBegin(chunk + 1); i < end; ++i)
+			{
+				uint64_t key = sourceKeys[i];
+				uint32_t target = offsets[(key >> shift) & 0xff]++;
+
+				targetKeys[target] = key;
+				targetValues[target] = sourceValues[i];
+			}
+		});
+
+		std::swap(sourceKeys, targetKeys);
+		std::swap(sourceValues, targetValues);
+		++LastPassCount;
+	}
+
+	if (sourceKeys != keys)
+	{
+		std::memcpy(keys, sourceKeys, sizeof(uint64_t) * count);
+		std::memcpy(values, sourceValues, sizeof(uint32_t) * count);
+	}
+}
+
+uint32_t FRadixSorter::GetLastPassCount() const
+{
+	return LastPassCount;
+}
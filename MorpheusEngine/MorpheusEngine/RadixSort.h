@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class FJobSystem;
+
+// Least significant digit radix sort of 64-bit keys with a 32-bit value each, usually an index into
+// the array the keys were built from. Eight passes of eight bits, skipping every pass in which all keys
+// share the same digit, so keys that only use a few of their bits sort in a few passes.
+//
+// With a job system the keys are split into one contiguous chunk per thread. Every pass counts the
+// digits of each chunk in parallel, turns the counts into per-chunk offsets and scatters the chunks in
+// parallel. The sort is stable. Scratch memory is kept between calls.
+class FRadixSorter
+{
+public:
+	// Sorts keys ascending and moves values along with them.
+	void Sort(uint64_t* keys, uint32_t* values, uint32_t count, FJobSystem* jobSystem = nullptr);
+
+	// Passes the last Sort() executed, out of PassCount.
+	uint32_t GetLastPassCount() const;
+
+	static const uint32_t PassCount = 8;
+
+private:
+	static const uint32_t BucketCount = 256;
+	// Smaller chunks cost more in counting and synchronisation than they save.
+	static const uint32_t MinKeysPerChunk = 16384;
+
+	std::vector<uint64_t> ScratchKeys;
+	std::vector<uint32_t> ScratchValues;
+	// Per chunk and pass, BucketCount counts each.
+	std::vector<uint32_t> Histograms;
+	// Per chunk, the next output position of every bucket in the current pass.
+	std::vector<uint32_t> Offsets;
+
+	uint32_t LastPassCount = 0;
+};
@@ -0,0 +1,455 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Opaque handle to a resource owned by a render device. Zero is never a valid handle, and the handle
+// of a destroyed resource stays invalid when its slot is reused.
+template<typename Tag>
+struct TRenderHandle
+{
+	uint32_t Value = 0;
+
+	bool IsValid() const
+	{
+		return Value != 0;
+	}
+
+	bool operator==(const TRenderHandle& Other) const
+	{
+		return Value == Other.Value;
+	}
+
+	bool operator!=(const TRenderHandle& Other) const
+	{
+		return Value != Other.Value;
+	}
+};
+
+using FBufferHandle = TRenderHandle<struct FBufferTag>;
+using FVertexShaderHandle = TRenderHandle<struct FVertexShaderTag>;
+using FPixelShaderHandle = TRenderHandle<struct FPixelShaderTag>;
+using FInputLayoutHandle = TRenderHandle<struct FInputLayoutTag>;
+using FRasterizerStateHandle = TRenderHandle<struct FRasterizerStateTag>;
+using FDepthStencilStateHandle = TRenderHandle<struct FDepthStencilStateTag>;
+using FBlendStateHandle = TRenderHandle<struct FBlendStateTag>;
+using FTextureHandle = TRenderHandle<struct FTextureTag>;
+
+enum class EBufferBinding : uint8_t
+{
+	Vertex,
+	Index,
+	Constant
+};
+
+enum class EResourceUsage : uint8_t
+{
+	Default,
+	Immutable,
+	Dynamic
+};
+
+enum class EMapMode : uint8_t
+{
+	// The previous contents are thrown away, the driver hands out fresh memory if the GPU still reads them.
+	WriteDiscard,
+	// The caller promises not to touch bytes the GPU may still read. Only valid after a discard.
+	WriteNoOverwrite
+};
+
+struct FBufferDesc
+{
+	EBufferBinding Binding = EBufferBinding::Vertex;
+	EResourceUsage Usage = EResourceUsage::Default;
+	uint32_t ByteWidth = 0;
+};
+
+enum class ETextureFormat : uint8_t
+{
+	// R8G8B8A8_UNORM
+	RGBA8,
+	// R16G16B16A16_FLOAT
+	RGBA16Float,
+	// R32_FLOAT
+	R32Float,
+	// D24_UNORM_S8_UINT
+	D24S8
+};
+
+enum ETextureBinding : uint8_t
+{
+	TextureBinding_RenderTarget = 1,
+	TextureBinding_DepthStencil = 2,
+	TextureBinding_ShaderResource = 4
+};
+
+// Two-dimensional texture with one mip level, the kind the frame renders into.
+struct FTextureDesc
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	ETextureFormat Format = ETextureFormat::RGBA8;
+	uint8_t Bindings = TextureBinding_RenderTarget;
+
+	bool operator==(const FTextureDesc& Other) const
+	{
+		return Width == Other.Width && Height == Other.Height && Format == Other.Format && Bindings == Other.Bindings;
+	}
+
+	bool operator!=(const FTextureDesc& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
+enum class EShaderStage : uint8_t
+{
+	Vertex,
+	Pixel,
+	NumberOfStages
+};
+
+// Compiled shader blob. The debug name identifies the program for backends that cannot run bytecode.
+struct FShaderBytecode
+{
+	const void* Data = nullptr;
+	size_t Size = 0;
+	const char* DebugName = nullptr;
+};
+
+// Stored in mesh files, only append. The normalized formats read as floats in the shader, see
+// VertexFormat.h for how the engine packs attributes into them.
+enum class EVertexFormat : uint8_t
+{
+	Float2,
+	Float3,
+	Float4,
+	// R16G16B16A16_SNORM
+	Short4Norm,
+	// R16G16_SNORM
+	Short2Norm,
+	// R8G8B8A8_UNORM
+	UByte4Norm
+};
+
+enum class EInputClassification : uint8_t
+{
+	PerVertex,
+	PerInstance
+};
+
+struct FInputElementDesc
+{
+	const char* SemanticName = nullptr;
+	uint32_t SemanticIndex = 0;
+	EVertexFormat Format = EVertexFormat::Float3;
+	uint32_t InputSlot = 0;
+	uint32_t AlignedByteOffset = 0;
+	EInputClassification Classification = EInputClassification::PerVertex;
+	uint32_t InstanceDataStepRate = 0;
+};
+
+enum class EFillMode : uint8_t
+{
+	Solid,
+	Wireframe
+};
+
+enum class ECullMode : uint8_t
+{
+	None,
+	Front,
+	Back
+};
+
+// Defaults match the rasterizer state the engine has always used.
+struct FRasterizerDesc
+{
+	EFillMode FillMode = EFillMode::Solid;
+	ECullMode CullMode = ECullMode::Back;
+	bool FrontCounterClockwise = false;
+	int32_t DepthBias = 0;
+	float DepthBiasClamp = 0.0f;
+	float SlopeScaledDepthBias = 0.0f;
+	bool DepthClipEnable = true;
+	bool ScissorEnable = false;
+	bool MultisampleEnable = false;
+	bool AntialiasedLineEnable = false;
+};
+
+enum class EComparisonFunc : uint8_t
+{
+	Never,
+	Less,
+	Equal,
+	LessEqual,
+	Greater,
+	NotEqual,
+	GreaterEqual,
+	Always
+};
+
+struct FDepthStencilDesc
+{
+	bool DepthEnable = true;
+	bool DepthWriteEnable = true;
+	EComparisonFunc DepthFunc = EComparisonFunc::Less;
+	bool StencilEnable = false;
+};
+
+enum class EBlendFactor : uint8_t
+{
+	Zero,
+	One,
+	SourceColour,
+	InverseSourceColour,
+	SourceAlpha,
+	InverseSourceAlpha,
+	DestinationColour,
+	InverseDestinationColour,
+	DestinationAlpha,
+	InverseDestinationAlpha
+};
+
+enum class EBlendOperation : uint8_t
+{
+	Add,
+	Subtract,
+	ReverseSubtract,
+	Min,
+	Max
+};
+
+enum EColourWriteMask : uint8_t
+{
+	ColourWrite_Red = 1,
+	ColourWrite_Green = 2,
+	ColourWrite_Blue = 4,
+	ColourWrite_Alpha = 8,
+	ColourWrite_All = 15
+};
+
+// Blending of the one render target. Defaults write the pixel shader output unchanged.
+struct FBlendDesc
+{
+	bool BlendEnable = false;
+	EBlendFactor SourceBlend = EBlendFactor::One;
+	EBlendFactor DestinationBlend = EBlendFactor::Zero;
+	EBlendOperation BlendOperation = EBlendOperation::Add;
+	EBlendFactor SourceBlendAlpha = EBlendFactor::One;
+	EBlendFactor DestinationBlendAlpha = EBlendFactor::Zero;
+	EBlendOperation BlendOperationAlpha = EBlendOperation::Add;
+	uint8_t WriteMask = ColourWrite_All;
+	bool AlphaToCoverageEnable = false;
+};
+
+enum class EIndexFormat : uint8_t
+{
+	UInt16,
+	UInt32
+};
+
+struct FViewport
+{
+	float TopLeftX = 0.0f;
+	float TopLeftY = 0.0f;
+	float Width = 0.0f;
+	float Height = 0.0f;
+	float MinDepth = 0.0f;
+	float MaxDepth = 1.0f;
+};
+
+// Counters gathered between two calls to Present().
+struct FRenderDeviceStats
+{
+	uint64_t DrawCalls = 0;
+	uint64_t IndicesSubmitted = 0;
+	// Instances of instanced draws, a plain draw counts as one.
+	uint64_t InstancesSubmitted = 0;
+	// Every bind the driver sees, and the subset that rebound what was already bound.
+	uint64_t StateChanges = 0;
+	uint64_t RedundantStateChanges = 0;
+	uint64_t BufferUpdates = 0;
+	uint64_t BufferMaps = 0;
+	uint64_t BytesUploaded = 0;
+	uint64_t ResourcesCreated = 0;
+	uint64_t ResourcesDestroyed = 0;
+};
+
+// The binds and draws of a frame, which the device takes directly and command lists record for later.
+class ICommandContext
+{
+public:
+	virtual ~ICommandContext() = default;
+
+	// Pipeline state.
+	virtual void SetVertexBuffer(uint32_t slot, FBufferHandle buffer, uint32_t stride, uint32_t offset) = 0;
+	virtual void SetIndexBuffer(FBufferHandle buffer, EIndexFormat format, uint32_t offset) = 0;
+	virtual void SetInputLayout(FInputLayoutHandle inputLayout) = 0;
+	virtual void SetVertexShader(FVertexShaderHandle shader) = 0;
+	virtual void SetPixelShader(FPixelShaderHandle shader) = 0;
+	virtual void SetConstantBuffer(EShaderStage stage, uint32_t slot, FBufferHandle buffer) = 0;
+	// Binds size bytes starting at offset. Both must be multiples of ConstantBufferRangeAlignment, and
+	// offsets other than zero need SupportsConstantBufferRanges().
+	virtual void SetConstantBufferRange(EShaderStage stage, uint32_t slot, FBufferHandle buffer, uint32_t offset, uint32_t size) = 0;
+	virtual void SetRasterizerState(FRasterizerStateHandle state) = 0;
+	virtual void SetDepthStencilState(FDepthStencilStateHandle state) = 0;
+	// An invalid handle restores the default blend state.
+	virtual void SetBlendState(FBlendStateHandle state) = 0;
+	virtual void SetViewport(const FViewport& viewport) = 0;
+	// Either handle may be invalid to bind no target of that kind.
+	virtual void SetRenderTargets(FTextureHandle renderTarget, FTextureHandle depthStencil) = 0;
+
+	// Draws.
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+	// Draws the indexed geometry instanceCount times. Per-instance vertex elements advance once per
+	// instance, starting at startInstance.
+	virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) = 0;
+};
+
+// Records binds and draws on any thread for IRenderDevice::ExecuteCommandList(). Buffers must be
+// filled and unmapped before the list is executed, not while it is recorded.
+class ICommandList : public ICommandContext
+{
+public:
+	// Throws away the last recording. A list starts with the render targets and viewport the device
+	// has bound at this point, and nothing else.
+	virtual void Begin() = 0;
+	virtual void End() = 0;
+	// Draws recorded between Begin() and End().
+	virtual uint32_t GetDrawCount() const = 0;
+};
+
+// Thin interface over the graphics API. Frame code talks to this instead of the D3D11 globals so
+// that it can run against a headless device.
+class IRenderDevice : public ICommandContext
+{
+public:
+	// Resource creation.
+	virtual FBufferHandle CreateBuffer(const FBufferDesc& description, const void* initialData) = 0;
+	virtual FVertexShaderHandle CreateVertexShader(const FShaderBytecode& bytecode) = 0;
+	virtual FPixelShaderHandle CreatePixelShader(const FShaderBytecode& bytecode) = 0;
+	virtual FInputLayoutHandle CreateInputLayout(const FInputElementDesc* elements, uint32_t elementCount, const FShaderBytecode& vertexShaderBytecode) = 0;
+	virtual FRasterizerStateHandle CreateRasterizerState(const FRasterizerDesc& description) = 0;
+	virtual FDepthStencilStateHandle CreateDepthStencilState(const FDepthStencilDesc& description) = 0;
+	virtual FBlendStateHandle CreateBlendState(const FBlendDesc& description) = 0;
+	virtual FTextureHandle CreateTexture(const FTextureDesc& description) = 0;
+
+	// Resource destruction. The resource must not be bound any more and its handle stops working
+	// right away. The GPU may still be using it, the device keeps it alive for as long as that takes.
+	virtual void DestroyBuffer(FBufferHandle buffer) = 0;
+	virtual void DestroyVertexShader(FVertexShaderHandle shader) = 0;
+	virtual void DestroyPixelShader(FPixelShaderHandle shader) = 0;
+	virtual void DestroyInputLayout(FInputLayoutHandle inputLayout) = 0;
+	virtual void DestroyRasterizerState(FRasterizerStateHandle state) = 0;
+	virtual void DestroyDepthStencilState(FDepthStencilStateHandle state) = 0;
+	virtual void DestroyBlendState(FBlendStateHandle state) = 0;
+	virtual void DestroyTexture(FTextureHandle texture) = 0;
+
+	// Appends a line for every resource that was created and not destroyed, the back buffer aside,
+	// and returns how many there are. Anything left at shutdown is a leak.
+	virtual uint32_t ReportLiveResources(std::string& report) const = 0;
+
+	// Render target of the swap chain that Present() shows. The handle stays the same across resizes.
+	virtual FTextureHandle GetBackBuffer() const = 0;
+	virtual const FTextureDesc& GetTextureDesc(FTextureHandle texture) const = 0;
+	// Only called between frames, leaves no render targets bound. Fails when the device cannot resize.
+	virtual bool ResizeBackBuffer(uint32_t width, uint32_t height) = 0;
+
+	// Replaces the whole contents of a default usage buffer.
+	virtual void UpdateBuffer(FBufferHandle buffer, const void* data, uint32_t size) = 0;
+	// Maps a dynamic buffer for writing. A mapped buffer must be unmapped before a draw reads it.
+	virtual void* MapBuffer(FBufferHandle buffer, EMapMode mode) = 0;
+	virtual void UnmapBuffer(FBufferHandle buffer) = 0;
+
+	// GPU progress markers. A fence completes once the GPU has finished every command issued before it,
+	// fences complete in the order they were inserted.
+	virtual uint64_t InsertFence() = 0;
+	virtual bool IsFenceComplete(uint64_t fence) = 0;
+
+	// Whether constant buffers can be bound by offset and mapped without overwrite, as Direct3D 11.1 allows.
+	virtual bool SupportsConstantBufferRanges() const = 0;
+
+	// Command lists are recorded by one thread each while no resources are created, and executed on
+	// the thread that owns the device, in the order the draws should reach the GPU. Executing leaves
+	// the render targets and viewport bound and any other state unspecified.
+	virtual std::unique_ptr<ICommandList> CreateCommandList() = 0;
+	virtual void ExecuteCommandList(ICommandList* commandList) = 0;
+
+	// Frame commands. Clear() clears the render targets that are bound.
+	virtual void Clear(const float clearColour[4], float clearDepth, uint8_t clearStencil) = 0;
+	virtual void Present(bool vSync) = 0;
+
+	// Counters of the frame that is being recorded and of the last presented frame. Command lists
+	// count towards the frame that executes them.
+	virtual const FRenderDeviceStats& GetFrameStats() const = 0;
+	virtual const FRenderDeviceStats& GetLastFrameStats() const = 0;
+};
+
+// Granularity of constant buffer offsets and sizes, 16 constants of 16 bytes.
+const uint32_t ConstantBufferRangeAlignment = 256;
+// Largest constant buffer a shader can see, 4096 constants.
+const uint32_t MaxConstantBufferRangeSize = 65536;
+
+// Counts a bind and remembers what is bound so that redundant binds can be told apart.
+inline void RecordStateChange(FRenderDeviceStats& stats, uint32_t& boundValue, uint32_t newValue)
+{
+	++stats.StateChanges;
+
+	if (boundValue == newValue)
+	{
+		++stats.RedundantStateChanges;
+	}
+
+	boundValue = newValue;
+}
+
+// Size in bytes of one texel of the given texture format.
+inline uint32_t GetTextureFormatSize(ETextureFormat format)
+{
+	switch (format)
+	{
+		case ETextureFormat::RGBA8:
+		case ETextureFormat::R32Float:
+		case ETextureFormat::D24S8:
+			return 4;
+
+		case ETextureFormat::RGBA16Float:
+			return 8;
+	}
+
+	return 0;
+}
+
+// Memory a texture of the description takes, ignoring the padding drivers add.
+inline uint64_t GetTextureSize(const FTextureDesc& description)
+{
+	return static_cast<uint64_t>(description.Width) * description.Height * GetTextureFormatSize(description.Format);
+}
+
+// Size in bytes of one element of the given vertex format.
+inline uint32_t GetVertexFormatSize(EVertexFormat format)
+{
+	switch (format)
+	{
+		case EVertexFormat::Float2:
+			return 8;
+
+		case EVertexFormat::Float3:
+			return 12;
+
+		case EVertexFormat::Float4:
+			return 16;
+
+		case EVertexFormat::Short4Norm:
+			return 8;
+
+		case EVertexFormat::Short2Norm:
+		case EVertexFormat::UByte4Norm:
+			return 4;
+	}
+
+	return 0;
+}
@@ -0,0 +1,441 @@
+#include "RenderGraph.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	bool SetError(std::string* error, const std::string& message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+
+		return false;
+	}
+
+	void AddUnique(std::vector<uint32_t>& indices, uint32_t index)
+	{
+		if (std::find(indices.begin(), indices.end(), index) == indices.end())
+		{
+			indices.push_back(index);
+		}
+	}
+}
+
+FRenderGraphTexturePool::FRenderGraphTexturePool(IRenderDevice* renderDevice, uint32_t maxIdleFrames)
+	: RenderDevice(renderDevice)
+	, MaxIdleFrames(maxIdleFrames)
+	, Frame(0)
+	, TexturesCreated(0)
+{
+	assert(RenderDevice);
+}
+
+FRenderGraphTexturePool::~FRenderGraphTexturePool()
+{
+	Reset();
+}
+
+FTextureHandle FRenderGraphTexturePool::Acquire(const FTextureDesc& description)
+{
+	for (FPooledTexture& pooled : Textures)
+	{
+		if (!pooled.InUse && pooled.Description == description)
+		{
+			pooled.InUse = true;
+			pooled.LastUsedFrame = Frame;
+			return pooled.Texture;
+		}
+	}
+
+	FTextureHandle texture = RenderDevice->CreateTexture(description);
+	if (!texture.IsValid())
+	{
+		return texture;
+	}
+
+	FPooledTexture pooled = { description, texture, Frame, true };
+	Textures.push_back(pooled);
+	++TexturesCreated;
+
+	return texture;
+}
+
+void FRenderGraphTexturePool::EndFrame()
+{
+	size_t kept = 0;
+	for (FPooledTexture& pooled : Textures)
+	{
+		pooled.InUse = false;
+
+		if (Frame - pooled.LastUsedFrame >= MaxIdleFrames)
+		{
+			RenderDevice->DestroyTexture(pooled.Texture);
+			continue;
+		}
+
+		Textures[kept++] = pooled;
+	}
+	Textures.resize(kept);
+
+	++Frame;
+}
+
+void FRenderGraphTexturePool::Reset()
+{
+	for (FPooledTexture& pooled : Textures)
+	{
+		RenderDevice->DestroyTexture(pooled.Texture);
+	}
+
+	Textures.clear();
+}
+
+uint32_t FRenderGraphTexturePool::GetTextureCount() const
+{
+	return static_cast<uint32_t>(Textures.size());
+}
+
+uint64_t FRenderGraphTexturePool::GetTextureBytes() const
+{
+	uint64_t bytes = 0;
+	for (const FPooledTexture& pooled : Textures)
+	{
+		bytes += GetTextureSize(pooled.Description);
+	}
+
+	return bytes;
+}
+
+uint64_t FRenderGraphTexturePool::GetTexturesCreated() const
+{
+	return TexturesCreated;
+}
+
+FRenderGraph::FRenderGraph()
+	: Compiled(false)
+{
+}
+
+void FRenderGraph::Reset()
+{
+	Textures.clear();
+	Passes.clear();
+	Allocations.clear();
+	Stats = FRenderGraphStats();
+	Compiled = false;
+}
+
+FRenderGraphTexture FRenderGraph::CreateTexture(const char* name, const FTextureDesc& description)
+{
+	FTextureNode texture = { name, description, FTextureHandle(), InvalidIndex, InvalidIndex, InvalidIndex };
+	Textures.push_back(texture);
+	Compiled = false;
+
+	FRenderGraphTexture handle;
+	handle.Value = static_cast<uint32_t>(Textures.size());
+
+	return handle;
+}
+
+FRenderGraphTexture FRenderGraph::ImportTexture(const char* name, FTextureHandle texture, const FTextureDesc& description)
+{
+	assert(texture.IsValid());
+
+	FRenderGraphTexture handle = CreateTexture(name, description);
+	Textures.back().Imported = texture;
+
+	return handle;
+}
+
+uint32_t FRenderGraph::AddPass(const char* name, FPassFunction function)
+{
+	FPassNode pass;
+	pass.Name = name;
+	pass.Function = std::move(function);
+	pass.SideEffects = false;
+	pass.Culled = false;
+
+	Passes.push_back(std::move(pass));
+	Compiled = false;
+
+	return static_cast<uint32_t>(Passes.size() - 1);
+}
+
+void FRenderGraph::Read(uint32_t pass, FRenderGraphTexture texture)
+{
+	assert(pass < Passes.size());
+	assert(texture.IsValid() && texture.Value <= Textures.size());
+
+	AddUnique(Passes[pass].Reads, texture.Value - 1);
+	Compiled = false;
+}
+
+void FRenderGraph::Write(uint32_t pass, FRenderGraphTexture texture)
+{
+	assert(pass < Passes.size());
+	assert(texture.IsValid() && texture.Value <= Textures.size());
+
+	AddUnique(Passes[pass].Writes, texture.Value - 1);
+	Compiled = false;
+}
+
+void FRenderGraph::SetSideEffects(uint32_t pass)
+{
+	assert(pass < Passes.size());
+
+	Passes[pass].SideEffects = true;
+	Compiled = false;
+}
+
+bool FRenderGraph::Compile(std::string* error)
+{
+	Compiled = false;
+	Allocations.clear();
+	Stats = FRenderGraphStats();
+	Stats.Passes = static_cast<uint32_t>(Passes.size());
+
+	const uint32_t passCount = static_cast<uint32_t>(Passes.size());
+
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		for (uint32_t texture : Passes[pass].Reads)
+		{
+			if (!Textures[texture].Imported.IsValid() && FindWriter(texture, pass) == InvalidIndex)
+			{
+				return SetError(error, std::string("Pass '") + Passes[pass].Name + "' reads '" + Textures[texture].Name + "' before any pass writes it");
+			}
+		}
+	}
+
+	// Passes whose results leave the graph are kept, and with them the writers of everything they read.
+	std::vector<uint32_t> pending;
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		FPassNode& node = Passes[pass];
+		node.Culled = !node.SideEffects;
+
+		for (uint32_t texture : node.Writes)
+		{
+			node.Culled = node.Culled && !Textures[texture].Imported.IsValid();
+		}
+
+		if (!node.Culled)
+		{
+			pending.push_back(pass);
+		}
+	}
+
+	while (!pending.empty())
+	{
+		uint32_t pass = pending.back();
+		pending.pop_back();
+
+		for (uint32_t texture : Passes[pass].Reads)
+		{
+			uint32_t writer = FindWriter(texture, pass);
+			if (writer != InvalidIndex && Passes[writer].Culled)
+			{
+				Passes[writer].Culled = false;
+				pending.push_back(writer);
+			}
+		}
+	}
+
+	// Lifetimes only count the passes that run.
+	for (FTextureNode& texture : Textures)
+	{
+		texture.FirstUse = InvalidIndex;
+		texture.LastUse = InvalidIndex;
+		texture.Allocation = InvalidIndex;
+	}
+
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		if (Passes[pass].Culled)
+		{
+			++Stats.CulledPasses;
+			continue;
+		}
+
+		for (const std::vector<uint32_t>* textures : { &Passes[pass].Reads, &Passes[pass].Writes })
+		{
+			for (uint32_t texture : *textures)
+			{
+				FTextureNode& node = Textures[texture];
+				node.FirstUse = node.FirstUse == InvalidIndex ? pass : node.FirstUse;
+				node.LastUse = pass;
+			}
+		}
+	}
+
+	// In pass order, a transient takes the first allocation of its description whose holder is done
+	// by now. Transients used by the same pass never share.
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		if (Passes[pass].Culled)
+		{
+			continue;
+		}
+
+		for (const std::vector<uint32_t>* textures : { &Passes[pass].Writes, &Passes[pass].Reads })
+		{
+			for (uint32_t texture : *textures)
+			{
+				FTextureNode& node = Textures[texture];
+				if (node.Imported.IsValid() || node.FirstUse != pass || node.Allocation != InvalidIndex)
+				{
+					continue;
+				}
+
+				for (uint32_t allocation = 0; allocation < Allocations.size(); ++allocation)
+				{
+					if (Allocations[allocation].LastUse < pass && Allocations[allocation].Description == node.Description)
+					{
+						node.Allocation = allocation;
+						break;
+					}
+				}
+
+				if (node.Allocation == InvalidIndex)
+				{
+					FAllocation allocation = { node.Description, node.LastUse, FTextureHandle() };
+					Allocations.push_back(allocation);
+					node.Allocation = static_cast<uint32_t>(Allocations.size() - 1);
+				}
+
+				Allocations[node.Allocation].LastUse = node.LastUse;
+			}
+		}
+	}
+
+	for (const FTextureNode& texture : Textures)
+	{
+		if (!texture.Imported.IsValid() && texture.FirstUse != InvalidIndex)
+		{
+			++Stats.TransientTextures;
+			Stats.UnaliasedBytes += GetTextureSize(texture.Description);
+		}
+	}
+
+	Stats.Allocations = static_cast<uint32_t>(Allocations.size());
+	for (const FAllocation& allocation : Allocations)
+	{
+		Stats.AliasedBytes += GetTextureSize(allocation.Description);
+	}
+
+	for (uint32_t pass = 0; pass < passCount; ++pass)
+	{
+		if (Passes[pass].Culled)
+		{
+			continue;
+		}
+
+		uint64_t liveBytes = 0;
+		for (const FTextureNode& texture : Textures)
+		{
+			if (!texture.Imported.IsValid() && texture.FirstUse != InvalidIndex && texture.FirstUse <= pass && pass <= texture.LastUse)
+			{
+				liveBytes += GetTextureSize(texture.Description);
+			}
+		}
+
+		Stats.PeakLiveBytes = std::max(Stats.PeakLiveBytes, liveBytes);
+	}
+
+	Compiled = true;
+
+	return true;
+}
+
+void FRenderGraph::Execute(IRenderDevice& renderDevice, FRenderGraphTexturePool& pool)
+{
+	assert(Compiled);
+
+	for (FAllocation& allocation : Allocations)
+	{
+		allocation.Texture = pool.Acquire(allocation.Description);
+	}
+
+	for (const FPassNode& pass : Passes)
+	{
+		if (!pass.Culled)
+		{
+			MORPHEUS_PROFILE_SCOPE(pass.Name);
+			pass.Function(renderDevice, *this);
+		}
+	}
+
+	// Nothing stays bound, so the pool is free to destroy what this frame used.
+	renderDevice.SetRenderTargets(FTextureHandle(), FTextureHandle());
+}
+
+FTextureHandle FRenderGraph::GetTexture(FRenderGraphTexture texture) const
+{
+	assert(texture.IsValid() && texture.Value <= Textures.size());
+
+	const FTextureNode& node = Textures[texture.Value - 1];
+	if (node.Imported.IsValid())
+	{
+		return node.Imported;
+	}
+
+	return node.Allocation != InvalidIndex ? Allocations[node.Allocation].Texture : FTextureHandle();
+}
+
+uint32_t FRenderGraph::GetPassCount() const
+{
+	return static_cast<uint32_t>(Passes.size());
+}
+
+const char* FRenderGraph::GetPassName(uint32_t pass) const
+{
+	assert(pass < Passes.size());
+	return Passes[pass].Name;
+}
+
+bool FRenderGraph::IsPassCulled(uint32_t pass) const
+{
+	assert(Compiled && pass < Passes.size());
+	return Passes[pass].Culled;
+}
+
+uint32_t FRenderGraph::GetFirstUse(FRenderGraphTexture texture) const
+{
+	assert(Compiled && texture.IsValid() && texture.Value <= Textures.size());
+	return Textures[texture.Value - 1].FirstUse;
+}
+
+uint32_t FRenderGraph::GetLastUse(FRenderGraphTexture texture) const
+{
+	assert(Compiled && texture.IsValid() && texture.Value <= Textures.size());
+	return Textures[texture.Value - 1].LastUse;
+}
+
+uint32_t FRenderGraph::GetAllocation(FRenderGraphTexture texture) const
+{
+	assert(Compiled && texture.IsValid() && texture.Value <= Textures.size());
+	return Textures[texture.Value - 1].Allocation;
+}
+
+const FRenderGraphStats& FRenderGraph::GetStats() const
+{
+	return Stats;
+}
+
+uint32_t FRenderGraph::FindWriter(uint32_t texture, uint32_t beforePass) const
+{
+	for (uint32_t pass = beforePass; pass-- > 0;)
+	{
+		const std::vector<uint32_t>& writes = Passes[pass].Writes;
+		if (std::find(writes.begin(), writes.end(), texture) != writes.end())
+		{
+			return pass;
+		}
+	}
+
+	return InvalidIndex;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Texture of one frame's render graph. Only valid until the graph is reset.
+using FRenderGraphTexture = TRenderHandle<struct FRenderGraphTextureTag>;
+
+// Render targets the graphs of successive frames share. A texture handed out by Acquire() belongs to
+// one allocation of the graph until EndFrame(), then it is free for any description that matches.
+class FRenderGraphTexturePool
+{
+public:
+	// Textures no frame has asked for in this many frames are destroyed.
+	static const uint32_t DefaultMaxIdleFrames = 8;
+
+	explicit FRenderGraphTexturePool(IRenderDevice* renderDevice, uint32_t maxIdleFrames = DefaultMaxIdleFrames);
+	~FRenderGraphTexturePool();
+
+	FRenderGraphTexturePool(const FRenderGraphTexturePool&) = delete;
+	FRenderGraphTexturePool& operator=(const FRenderGraphTexturePool&) = delete;
+
+	// A free texture of exactly this description, created when there is none. Invalid if creation failed.
+	FTextureHandle Acquire(const FTextureDesc& description);
+	// Frees every texture for the next frame and destroys the ones that have been idle too long.
+	void EndFrame();
+	// Destroys every texture. Called when the back buffer changes size, as nothing sized after it
+	// will be asked for again.
+	void Reset();
+
+	uint32_t GetTextureCount() const;
+	uint64_t GetTextureBytes() const;
+	// Textures created over the lifetime of the pool, which stops growing once frames repeat.
+	uint64_t GetTexturesCreated() const;
+
+private:
+	struct FPooledTexture
+	{
+		FTextureDesc Description;
+		FTextureHandle Texture;
+		uint64_t LastUsedFrame;
+		bool InUse;
+	};
+
+	IRenderDevice* RenderDevice;
+	uint32_t MaxIdleFrames;
+	uint64_t Frame;
+	std::vector<FPooledTexture> Textures;
+	uint64_t TexturesCreated;
+};
+
+struct FRenderGraphStats
+{
+	uint32_t Passes = 0;
+	uint32_t CulledPasses = 0;
+	// Transient textures that a pass which was kept uses.
+	uint32_t TransientTextures = 0;
+	// Textures the transients were packed into.
+	uint32_t Allocations = 0;
+	// Memory of the transients with a texture each, and with the allocations they share.
+	uint64_t UnaliasedBytes = 0;
+	uint64_t AliasedBytes = 0;
+	// Most memory the transients in use during any one pass take, the bound for aliasing whole heaps.
+	uint64_t PeakLiveBytes = 0;
+};
+
+// Passes of a frame, declared with the textures they read and write and run in the order they were
+// added. Compile() drops passes whose results nothing needs, works out where each transient texture
+// is first and last used and lets transients of the same description share a texture when their
+// lifetimes do not overlap. Sharing is by description because Direct3D 11 has no placed resources,
+// PeakLiveBytes shows what aliasing raw memory would reach.
+//
+// Building and compiling do not touch the device, only Execute() does.
+class FRenderGraph
+{
+public:
+	using FPassFunction = std::function<void(IRenderDevice& renderDevice, const FRenderGraph& graph)>;
+
+	static const uint32_t InvalidIndex = ~0u;
+
+	FRenderGraph();
+
+	// Forgets the passes and textures of the last frame.
+	void Reset();
+
+	// A texture that lives for the passes that use it and nothing outside the graph can see.
+	FRenderGraphTexture CreateTexture(const char* name, const FTextureDesc& description);
+	// A texture owned outside the graph, such as the back buffer. Passes writing one are never culled.
+	FRenderGraphTexture ImportTexture(const char* name, FTextureHandle texture, const FTextureDesc& description);
+
+	// Names are stored as pointers, as with profile scopes.
+	uint32_t AddPass(const char* name, FPassFunction function);
+	// A pass that writes a texture without reading it leaves nothing of the previous contents.
+	void Read(uint32_t pass, FRenderGraphTexture texture);
+	void Write(uint32_t pass, FRenderGraphTexture texture);
+	// Keeps the pass even if nothing reads what it writes, for passes that read back to the CPU.
+	void SetSideEffects(uint32_t pass);
+
+	// Fails when a pass reads a transient that no earlier pass writes.
+	bool Compile(std::string* error = nullptr);
+	// Runs the passes that were kept, with the allocations taken from the pool. Compile() first.
+	void Execute(IRenderDevice& renderDevice, FRenderGraphTexturePool& pool);
+
+	// The device texture behind a graph texture, for pass functions.
+	FTextureHandle GetTexture(FRenderGraphTexture texture) const;
+
+	uint32_t GetPassCount() const;
+	const char* GetPassName(uint32_t pass) const;
+	bool IsPassCulled(uint32_t pass) const;
+	// Passes that first and last use a texture, InvalidIndex when no pass that was kept uses it.
+	uint32_t GetFirstUse(FRenderGraphTexture texture) const;
+	uint32_t GetLastUse(FRenderGraphTexture texture) const;
+	// Allocation a transient shares, InvalidIndex for imported and unused textures.
+	uint32_t GetAllocation(FRenderGraphTexture texture) const;
+
+	const FRenderGraphStats& GetStats() const;
+
+private:
+	struct FTextureNode
+	{
+		const char* Name;
+		FTextureDesc Description;
+		// Set for imported textures only.
+		FTextureHandle Imported;
+		uint32_t FirstUse;
+		uint32_t LastUse;
+		uint32_t Allocation;
+	};
+
+	struct FPassNode
+	{
+		const char* Name;
+		FPassFunction Function;
+		std::vector<uint32_t> Reads;
+		std::vector<uint32_t> Writes;
+		bool SideEffects;
+		bool Culled;
+	};
+
+	struct FAllocation
+	{
+		FTextureDesc Description;
+		// Last pass of the transient that holds the allocation at the moment.
+		uint32_t LastUse;
+		FTextureHandle Texture;
+	};
+
+	// Latest pass before the given one that writes the texture, InvalidIndex if there is none.
+	uint32_t FindWriter(uint32_t texture, uint32_t beforePass) const;
+
+	std::vector<FTextureNode> Textures;
+	std::vector<FPassNode> Passes;
+	std::vector<FAllocation> Allocations;
+	FRenderGraphStats Stats;
+	bool Compiled;
+};
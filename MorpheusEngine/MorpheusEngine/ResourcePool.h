@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A handle value keeps the slot in the low bits and the generation of the slot above them. Generations
+// start at one, so no handle of a live resource is zero.
+const uint32_t ResourceHandleIndexBits = 20;
+const uint32_t ResourceHandleIndexMask = (1u << ResourceHandleIndexBits) - 1;
+const uint32_t ResourceHandleMaxGeneration = (1u << (32 - ResourceHandleIndexBits)) - 1;
+
+// Resources stored by value in one array and addressed by generation-checked handles. Removing a
+// resource bumps the generation of its slot, so the old handle never finds whatever takes the slot
+// next; a slot whose generation would wrap is retired instead of reused. Looking a handle up is an
+// index and a compare, with no reference count and no pointer to follow. Not thread safe.
+template<typename HandleType, typename ResourceType>
+class TResourcePool
+{
+public:
+	// Whether Add() has a slot left: a free one, or a new one the index bits can still address.
+	bool CanAdd() const
+	{
+		return !FreeSlots.empty() || Slots.size() <= ResourceHandleIndexMask;
+	}
+
+	// An invalid handle once CanAdd() is false, and the resource is dropped without being released,
+	// so callers that own a device object check CanAdd() before creating it.
+	HandleType Add(ResourceType resource)
+	{
+		if (!CanAdd())
+		{
+			return HandleType();
+		}
+
+		uint32_t index;
+		if (!FreeSlots.empty())
+		{
+			index = FreeSlots.back();
+			FreeSlots.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(Slots.size());
+			Slots.push_back({ ResourceType(), 0, false });
+		}
+
+		FSlot& slot = Slots[index];
+		slot.Resource = std::move(resource);
+		slot.Generation = slot.Generation + 1;
+		slot.Alive = true;
+		++LiveCount;
+
+		HandleType handle;
+		handle.Value = (slot.Generation << ResourceHandleIndexBits) | index;
+
+		return handle;
+	}
+
+	// Null for invalid handles and handles of removed resources.
+	ResourceType* Get(HandleType handle)
+	{
+		uint32_t index = handle.Value & ResourceHandleIndexMask;
+		if (index >= Slots.size() || !Slots[index].Alive || Slots[index].Generation != handle.Value >> ResourceHandleIndexBits)
+		{
+			return nullptr;
+		}
+
+		return &Slots[index].Resource;
+	}
+
+	const ResourceType* Get(HandleType handle) const
+	{
+		return const_cast<TResourcePool*>(this)->Get(handle);
+	}
+
+	bool IsValid(HandleType handle) const
+	{
+		return Get(handle) != nullptr;
+	}
+
+	// Hands the resource back to the caller, who releases it.
+	ResourceType Remove(HandleType handle)
+	{
+		ResourceType* resource = Get(handle);
+		assert(resource);
+
+		uint32_t index = handle.Value & ResourceHandleIndexMask;
+		ResourceType removed = std::move(*resource);
+
+		FSlot& slot = Slots[index];
+		slot.Resource = ResourceType();
+		slot.Alive = false;
+		--LiveCount;
+
+		if (slot.Generation < ResourceHandleMaxGeneration)
+		{
+			FreeSlots.push_back(index);
+		}
+
+		return removed;
+	}
+
+	// Calls function(handle, resource) for every live resource, in slot order.
+	template<typename FunctionType>
+	void ForEach(const FunctionType& function)
+	{
+		for (uint32_t index = 0; index < Slots.size(); ++index)
+		{
+			if (Slots[index].Alive)
+			{
+				HandleType handle;
+				handle.Value = (Slots[index].Generation << ResourceHandleIndexBits) | index;
+				function(handle, Slots[index].Resource);
+			}
+		}
+	}
+
+	template<typename FunctionType>
+	void ForEach(const FunctionType& function) const
+	{
+		const_cast<TResourcePool*>(this)->ForEach([&function](HandleType handle, const ResourceType& resource) { function(handle, resource); });
+	}
+
+	uint32_t GetLiveCount() const
+	{
+		return LiveCount;
+	}
+
+	// Slots ever used, live or not.
+	uint32_t GetSlotCount() const
+	{
+		return static_cast<uint32_t>(Slots.size());
+	}
+
+private:
+	struct FSlot
+	{
+		ResourceType Resource;
+		uint32_t Generation;
+		bool Alive;
+	};
+
+	std::vector<FSlot> Slots;
+	std::vector<uint32_t> FreeSlots;
+	uint32_t LiveCount = 0;
+};
+
+// Objects destroyed while the GPU may still be reading them, each held until the fence of the frame
+// that last used it completes. Fences are enqueued in the order they are inserted, so the oldest
+// entries are always the first to become free.
+template<typename ObjectType>
+class TDeferredReleaseQueue
+{
+public:
+	void Enqueue(const ObjectType& object, uint64_t fence)
+	{
+		assert(Entries.empty() || Entries.back().Fence <= fence);
+
+		FEntry entry = { object, fence };
+		Entries.push_back(entry);
+	}
+
+	// Calls release(object) for every object whose fence is at most completedFence, oldest first, and
+	// returns how many there were.
+	template<typename FunctionType>
+	uint32_t Release(uint64_t completedFence, const FunctionType& release)
+	{
+		uint32_t released = 0;
+		while (!Entries.empty() && Entries.front().Fence <= completedFence)
+		{
+			release(Entries.front().Object);
+			Entries.pop_front();
+			++released;
+		}
+
+		return released;
+	}
+
+	// For shutdown, once the GPU is idle.
+	template<typename FunctionType>
+	uint32_t ReleaseAll(const FunctionType& release)
+	{
+		return Release(~0ull, release);
+	}
+
+	bool IsEmpty() const
+	{
+		return Entries.empty();
+	}
+
+	uint32_t GetPendingCount() const
+	{
+		return static_cast<uint32_t>(Entries.size());
+	}
+
+	// Fence of the newest entry, zero when there is none.
+	uint64_t GetLastFence() const
+	{
+		return Entries.empty() ? 0 : Entries.back().Fence;
+	}
+
+private:
+	struct FEntry
+	{
+		ObjectType Object;
+		uint64_t Fence;
+	};
+
+	std::deque<FEntry> Entries;
+};
+
+// Appends one line per live resource of the pool but the one left out, "<type> <handle>", and returns
+// how many lines there are.
+template<typename HandleType, typename ResourceType>
+uint32_t AppendLiveResources(std::string& report, const char* typeName, const TResourcePool<HandleType, ResourceType>& pool, HandleType except = HandleType())
+{
+	uint32_t count = 0;
+	pool.ForEach([&](HandleType handle, const ResourceType&)
+	{
+		if (handle != except)
+		{
+			char line[64];
+			snprintf(line, sizeof(line), "%s 0x%08x\n", typeName, handle.Value);
+			report += line;
+			++count;
+		}
+	});
+
+	return count;
+}
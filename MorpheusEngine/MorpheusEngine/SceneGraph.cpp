@@ -0,0 +1,565 @@
+#include "SceneGraph.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// Local matrices are composed in runs of this many consecutive nodes.
+	const uint32_t ComposeRunLength = 64;
+
+	// Levels with fewer changed nodes than this are not worth splitting into jobs.
+	const uint32_t MinimumParallelNodes = 4096;
+	const uint32_t ParallelBatchSize = 1024;
+
+	void CopyTransform(const FTransformSoA& source, uint32_t sourceIndex, FTransformSoA& destination, uint32_t destinationIndex)
+	{
+		destination.PositionX[destinationIndex] = source.PositionX[sourceIndex];
+		destination.PositionY[destinationIndex] = source.PositionY[sourceIndex];
+		destination.PositionZ[destinationIndex] = source.PositionZ[sourceIndex];
+		destination.RotationX[destinationIndex] = source.RotationX[sourceIndex];
+		destination.RotationY[destinationIndex] = source.RotationY[sourceIndex];
+		destination.RotationZ[destinationIndex] = source.RotationZ[sourceIndex];
+		destination.RotationW[destinationIndex] = source.RotationW[sourceIndex];
+		destination.ScaleX[destinationIndex] = source.ScaleX[sourceIndex];
+		destination.ScaleY[destinationIndex] = source.ScaleY[sourceIndex];
+		destination.ScaleZ[destinationIndex] = source.ScaleZ[sourceIndex];
+	}
+
+	// Index of the lowest set bit of a non-zero word.
+	inline uint32_t CountTrailingZeros(uint64_t word)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return static_cast<uint32_t>(index);
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(word));
+#endif
+	}
+
+	bool IsBitSet(const std::vector<uint64_t>& words, uint32_t index)
+	{
+		return ((words[index >> 6] >> (index & 63)) & 1) != 0;
+	}
+
+	void SetBit(std::vector<uint64_t>& words, uint32_t index)
+	{
+		words[index >> 6] |= 1ull << (index & 63);
+	}
+
+	void SetBitRange(std::vector<uint64_t>& words, uint32_t first, uint32_t count)
+	{
+		while (count > 0)
+		{
+			uint32_t bit = first & 63;
+			uint32_t run = std::min(count, 64 - bit);
+			words[first >> 6] |= (run == 64 ? ~0ull : (1ull << run) - 1) << bit;
+			first += run;
+			count -= run;
+		}
+	}
+}
+
+FSceneGraph::FSceneGraph()
+	: LiveNodeCount(0)
+	, HierarchyChanged(false)
+	, HasDirtyNodes(false)
+{
+	LevelStarts.push_back(0);
+}
+
+FSceneNodeHandle FSceneGraph::CreateNode(FSceneNodeHandle parent)
+{
+	uint32_t parentIndex = parent.IsValid() ? GetIndex(parent) : InvalidIndex;
+
+	uint32_t slot;
+	if (!FreeSlots.empty())
+	{
+		slot = FreeSlots.back();
+		FreeSlots.pop_back();
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(SlotIndices.size());
+		SlotIndices.push_back(InvalidIndex);
+		SlotParents.push_back(InvalidIndex);
+	}
+
+	uint32_t index = static_cast<uint32_t>(NodeSlots.size());
+
+	LocalTransforms.Resize(index + 1);
+	WorldMatrices.push_back(MatrixIdentity());
+	ParentIndices.push_back(parentIndex);
+	NodeSlots.push_back(slot);
+	if ((index >> 6) >= DirtyBits.size())
+	{
+		DirtyBits.push_back(0);
+	}
+	FirstChildIndices.push_back(0);
+	ChildCounts.push_back(0);
+
+	SlotIndices[slot] = index;
+	SlotParents[slot] = parent.IsValid() ? parent.Value - 1 : InvalidIndex;
+
+	++LiveNodeCount;
+	HierarchyChanged = true;
+
+	MarkDirty(index);
+
+	FSceneNodeHandle node;
+	node.Value = slot + 1;
+
+	return node;
+}
+
+void FSceneGraph::DestroyNode(FSceneNodeHandle node)
+{
+	GetIndex(node);
+
+	// The subtree is only contiguous per level in breadth-first order.
+	if (HierarchyChanged)
+	{
+		RebuildHierarchy();
+	}
+
+	uint32_t first = GetIndex(node);
+	uint32_t last = first + 1;
+
+	while (first < last)
+	{
+		uint32_t nextFirst = FirstChildIndices[first];
+		uint32_t nextLast = FirstChildIndices[last - 1] + ChildCounts[last - 1];
+
+		for (uint32_t index = first; index < last; ++index)
+		{
+			uint32_t slot = NodeSlots[index];
+			SlotIndices[slot] = InvalidIndex;
+			SlotParents[slot] = InvalidIndex;
+			FreeSlots.push_back(slot);
+
+			NodeSlots[index] = InvalidIndex;
+			--LiveNodeCount;
+		}
+
+		first = nextFirst;
+		last = nextLast;
+	}
+
+	HierarchyChanged = true;
+}
+
+void FSceneGraph::SetParent(FSceneNodeHandle node, FSceneNodeHandle parent)
+{
+	uint32_t index = GetIndex(node);
+	uint32_t parentIndex = parent.IsValid() ? GetIndex(parent) : InvalidIndex;
+
+#ifndef NDEBUG
+	for (uint32_t ancestor = parent.IsValid() ? parent.Value - 1 : InvalidIndex; ancestor != InvalidIndex; ancestor = SlotParents[ancestor])
+	{
+		assert(ancestor != node.Value - 1 && "A node cannot become a child of its own subtree");
+	}
+#endif
+
+	SlotParents[node.Value - 1] = parent.IsValid() ? parent.Value - 1 : InvalidIndex;
+	ParentIndices[index] = parentIndex;
+	HierarchyChanged = true;
+
+	MarkDirty(index);
+}
+
+FSceneNodeHandle FSceneGraph::GetParent(FSceneNodeHandle node) const
+{
+	GetIndex(node);
+
+	FSceneNodeHandle parent;
+	uint32_t parentSlot = SlotParents[node.Value - 1];
+	parent.Value = (parentSlot != InvalidIndex) ? parentSlot + 1 : 0;
+
+	return parent;
+}
+
+bool FSceneGraph::IsAlive(FSceneNodeHandle node) const
+{
+	return node.IsValid() && node.Value <= SlotIndices.size() && SlotIndices[node.Value - 1] != InvalidIndex;
+}
+
+void FSceneGraph::SetLocalTransform(FSceneNodeHandle node, const FFloat3& position, const FQuaternion& rotation, const FFloat3& scale)
+{
+	uint32_t index = GetIndex(node);
+
+	LocalTransforms.Set(index, position, rotation, scale);
+	MarkDirty(index);
+}
+
+void FSceneGraph::SetLocalPosition(FSceneNodeHandle node, const FFloat3& position)
+{
+	uint32_t index = GetIndex(node);
+
+	LocalTransforms.PositionX[index] = position.X;
+	LocalTransforms.PositionY[index] = position.Y;
+	LocalTransforms.PositionZ[index] = position.Z;
+	MarkDirty(index);
+}
+
+void FSceneGraph::SetLocalRotation(FSceneNodeHandle node, const FQuaternion& rotation)
+{
+	uint32_t index = GetIndex(node);
+
+	LocalTransforms.RotationX[index] = rotation.X;
+	LocalTransforms.RotationY[index] = rotation.Y;
+	LocalTransforms.RotationZ[index] = rotation.Z;
+	LocalTransforms.RotationW[index] = rotation.W;
+	MarkDirty(index);
+}
+
+FFloat3 FSceneGraph::GetLocalPosition(FSceneNodeHandle node) const
+{
+	return LocalTransforms.GetPosition(GetIndex(node));
+}
+
+FQuaternion FSceneGraph::GetLocalRotation(FSceneNodeHandle node) const
+{
+	return LocalTransforms.GetRotation(GetIndex(node));
+}
+
+FFloat3 FSceneGraph::GetLocalScale(FSceneNodeHandle node) const
+{
+	return LocalTransforms.GetScale(GetIndex(node));
+}
+
+void FSceneGraph::Update(FJobSystem* jobSystem)
+{
+	LastUpdateStats = FSceneGraphStats();
+
+	if (HierarchyChanged)
+	{
+		RebuildHierarchy();
+		LastUpdateStats.HierarchyRebuilt = true;
+	}
+
+	CollectDirtyNodes();
+	UpdateDirtyNodes(jobSystem);
+}
+
+void FSceneGraph::UpdateAll(FJobSystem* jobSystem)
+{
+	LastUpdateStats = FSceneGraphStats();
+
+	if (HierarchyChanged)
+	{
+		RebuildHierarchy();
+		LastUpdateStats.HierarchyRebuilt = true;
+	}
+
+	const uint32_t nodeCount = static_cast<uint32_t>(NodeSlots.size());
+
+	DirtyIndices.resize(nodeCount);
+	for (uint32_t index = 0; index < nodeCount; ++index)
+	{
+		DirtyIndices[index] = index;
+	}
+
+	DirtyLevelStarts = LevelStarts;
+	std::fill(DirtyBits.begin(), DirtyBits.end(), 0);
+	HasDirtyNodes = false;
+
+	UpdateDirtyNodes(jobSystem);
+}
+
+const FFloat4x4& FSceneGraph::GetWorldMatrix(FSceneNodeHandle node) const
+{
+	return WorldMatrices[GetIndex(node)];
+}
+
+uint32_t FSceneGraph::GetNodeCount() const
+{
+	return LiveNodeCount;
+}
+
+const FFloat4x4* FSceneGraph::GetWorldMatrices() const
+{
+	return WorldMatrices.data();
+}
+
+uint32_t FSceneGraph::GetNodeIndex(FSceneNodeHandle node) const
+{
+	return GetIndex(node);
+}
+
+const FSceneGraphStats& FSceneGraph::GetLastUpdateStats() const
+{
+	return LastUpdateStats;
+}
+
+uint32_t FSceneGraph::GetIndex(FSceneNodeHandle node) const
+{
+	assert(IsAlive(node) && "Invalid or destroyed scene node");
+
+	return SlotIndices[node.Value - 1];
+}
+
+void FSceneGraph::MarkDirty(uint32_t index)
+{
+	SetBit(DirtyBits, index);
+	HasDirtyNodes = true;
+}
+
+void FSceneGraph::RebuildHierarchy()
+{
+	const uint32_t entryCount = static_cast<uint32_t>(NodeSlots.size());
+	const uint32_t slotCount = static_cast<uint32_t>(SlotIndices.size());
+
+	// Children of every slot, listed in their current order so the rebuild keeps siblings stable.
+	ChildStarts.assign(slotCount + 1, 0);
+	for (uint32_t index = 0; index < entryCount; ++index)
+	{
+		uint32_t slot = NodeSlots[index];
+		if (slot != InvalidIndex && SlotParents[slot] != InvalidIndex)
+		{
+			++ChildStarts[SlotParents[slot] + 1];
+		}
+	}
+
+	for (uint32_t slot = 0; slot < slotCount; ++slot)
+	{
+		ChildStarts[slot + 1] += ChildStarts[slot];
+	}
+
+	Children.resize(ChildStarts[slotCount]);
+	for (uint32_t index = 0; index < entryCount; ++index)
+	{
+		uint32_t slot = NodeSlots[index];
+		if (slot != InvalidIndex && SlotParents[slot] != InvalidIndex)
+		{
+			Children[ChildStarts[SlotParents[slot]]++] = slot;
+		}
+	}
+
+	// The fill pass advanced every start to the next one, shift them back.
+	for (uint32_t slot = slotCount; slot > 0; --slot)
+	{
+		ChildStarts[slot] = ChildStarts[slot - 1];
+	}
+	ChildStarts[0] = 0;
+
+	// Breadth-first walk from the roots. NewOrder holds the slot of every new index.
+	NewOrder.clear();
+	for (uint32_t index = 0; index < entryCount; ++index)
+	{
+		uint32_t slot = NodeSlots[index];
+		if (slot != InvalidIndex && SlotParents[slot] == InvalidIndex)
+		{
+			NewOrder.push_back(slot);
+		}
+	}
+
+	const uint32_t nodeCount = LiveNodeCount;
+	assert(NewOrder.size() <= nodeCount);
+
+	LevelStarts.clear();
+	LevelStarts.push_back(0);
+
+	FirstChildIndices.resize(nodeCount);
+	ChildCounts.resize(nodeCount);
+
+	uint32_t levelBegin = 0;
+	while (levelBegin < NewOrder.size())
+	{
+		uint32_t levelEnd = static_cast<uint32_t>(NewOrder.size());
+
+		for (uint32_t newIndex = levelBegin; newIndex < levelEnd; ++newIndex)
+		{
+			uint32_t slot = NewOrder[newIndex];
+
+			FirstChildIndices[newIndex] = static_cast<uint32_t>(NewOrder.size());
+			ChildCounts[newIndex] = ChildStarts[slot + 1] - ChildStarts[slot];
+			NewOrder.insert(NewOrder.end(), Children.begin() + ChildStarts[slot], Children.begin() + ChildStarts[slot + 1]);
+		}
+
+		LevelStarts.push_back(levelEnd);
+		levelBegin = levelEnd;
+	}
+
+	assert(NewOrder.size() == nodeCount && "Every live node must be reachable from a root");
+
+	// Move every array into the new order.
+	ReorderedTransforms.Resize(nodeCount);
+	ReorderedWorldMatrices.resize(nodeCount);
+	ReorderedParents.resize(nodeCount);
+	ReorderedSlots.resize(nodeCount);
+	ReorderedDirtyBits.assign((nodeCount + 63) / 64, 0);
+
+	for (uint32_t newIndex = 0; newIndex < nodeCount; ++newIndex)
+	{
+		uint32_t slot = NewOrder[newIndex];
+		uint32_t oldIndex = SlotIndices[slot];
+
+		CopyTransform(LocalTransforms, oldIndex, ReorderedTransforms, newIndex);
+		ReorderedWorldMatrices[newIndex] = WorldMatrices[oldIndex];
+		ReorderedSlots[newIndex] = slot;
+		if (IsBitSet(DirtyBits, oldIndex))
+		{
+			SetBit(ReorderedDirtyBits, newIndex);
+		}
+	}
+
+	for (uint32_t newIndex = 0; newIndex < nodeCount; ++newIndex)
+	{
+		SlotIndices[NewOrder[newIndex]] = newIndex;
+	}
+
+	for (uint32_t newIndex = 0; newIndex < nodeCount; ++newIndex)
+	{
+		uint32_t parentSlot = SlotParents[NewOrder[newIndex]];
+		ReorderedParents[newIndex] = (parentSlot != InvalidIndex) ? SlotIndices[parentSlot] : InvalidIndex;
+	}
+
+	std::swap(LocalTransforms, ReorderedTransforms);
+	std::swap(WorldMatrices, ReorderedWorldMatrices);
+	std::swap(ParentIndices, ReorderedParents);
+	std::swap(NodeSlots, ReorderedSlots);
+	std::swap(DirtyBits, ReorderedDirtyBits);
+
+	// The scratch copies hold the old, possibly longer arrays. Trim them so the next rebuild does not
+	// read stale entries; the capacity is kept.
+	ReorderedTransforms.Resize(0);
+
+	HierarchyChanged = false;
+}
+
+void FSceneGraph::CollectDirtyNodes()
+{
+	DirtyIndices.clear();
+	DirtyLevelStarts.clear();
+	DirtyLevelStarts.push_back(0);
+
+	if (!HasDirtyNodes)
+	{
+		return;
+	}
+
+	const uint32_t levelCount = static_cast<uint32_t>(LevelStarts.size()) - 1;
+
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		uint32_t levelBegin = static_cast<uint32_t>(DirtyIndices.size());
+
+		// The previous level already flagged the children of its changed nodes, so one pass over the bits
+		// of the level finds them together with the nodes flagged directly, sorted and without duplicates.
+		// Most words are zero; the set bits are taken and cleared a word at a time.
+		uint32_t begin = LevelStarts[level];
+		uint32_t end = LevelStarts[level + 1];
+		uint32_t firstWord = begin >> 6;
+		uint32_t lastWord = (end - 1) >> 6;
+
+		for (uint32_t word = firstWord; word <= lastWord; ++word)
+		{
+			uint64_t mask = ~0ull;
+			if (word == firstWord)
+			{
+				mask &= ~0ull << (begin & 63);
+			}
+			if (word == lastWord && (end & 63) != 0)
+			{
+				mask &= ~0ull >> (64 - (end & 63));
+			}
+
+			uint64_t bits = DirtyBits[word] & mask;
+			if (bits == 0)
+			{
+				continue;
+			}
+
+			DirtyBits[word] &= ~bits;
+			do
+			{
+				DirtyIndices.push_back((word << 6) + CountTrailingZeros(bits));
+				bits &= bits - 1;
+			}
+			while (bits != 0);
+		}
+
+		for (uint32_t i = levelBegin; i < DirtyIndices.size(); ++i)
+		{
+			uint32_t parent = DirtyIndices[i];
+			SetBitRange(DirtyBits, FirstChildIndices[parent], ChildCounts[parent]);
+		}
+
+		DirtyLevelStarts.push_back(static_cast<uint32_t>(DirtyIndices.size()));
+	}
+
+	HasDirtyNodes = false;
+}
+
+void FSceneGraph::UpdateDirtyNodes(FJobSystem* jobSystem)
+{
+	// Slices of the packed copy belong to the same dirty nodes as slices of DirtyIndices, so jobs never share one.
+	if (PackedTransforms.GetCount() < DirtyIndices.size())
+	{
+		PackedTransforms.Resize(static_cast<uint32_t>(DirtyIndices.size()));
+	}
+
+	// Levels run one after the other, every node of a level only reads world matrices of the one above.
+	for (size_t level = 0; level + 1 < DirtyLevelStarts.size(); ++level)
+	{
+		uint32_t first = DirtyLevelStarts[level];
+		uint32_t last = DirtyLevelStarts[level + 1];
+
+		if (jobSystem && last - first >= MinimumParallelNodes)
+		{
+			jobSystem->ParallelFor(last - first, ParallelBatchSize, [this, first](uint32_t begin, uint32_t end)
+			{
+				UpdateNodes(first + begin, first + end);
+			});
+		}
+		else
+		{
+			UpdateNodes(first, last);
+		}
+	}
+
+	LastUpdateStats.NodeCount = LiveNodeCount;
+	LastUpdateStats.LevelCount = static_cast<uint32_t>(LevelStarts.size()) - 1;
+	LastUpdateStats.NodesUpdated = static_cast<uint32_t>(DirtyIndices.size());
+}
+
+void FSceneGraph::UpdateNodes(uint32_t first, uint32_t last)
+{
+	FFloat4x4 localMatrices[ComposeRunLength];
+
+	for (uint32_t chunkBegin = first; chunkBegin < last; chunkBegin += ComposeRunLength)
+	{
+		uint32_t count = std::min(last - chunkBegin, ComposeRunLength);
+		const uint32_t* indices = DirtyIndices.data() + chunkBegin;
+
+		// Whole levels and moved subtrees are consecutive and compose in place. Scattered nodes, the moved
+		// leaves, are gathered into packed transforms first, so the batched kernel still runs on them.
+		if (indices[count - 1] - indices[0] == count - 1)
+		{
+			ComposeMatricesPacked(LocalTransforms, indices[0], indices[0] + count, localMatrices);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				CopyTransform(LocalTransforms, indices[i], PackedTransforms, chunkBegin + i);
+			}
+			ComposeMatricesPacked(PackedTransforms, chunkBegin, chunkBegin + count, localMatrices);
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t index = indices[i];
+			uint32_t parent = ParentIndices[index];
+
+			WorldMatrices[index] = (parent != InvalidIndex) ? MatrixMultiply(localMatrices[i], WorldMatrices[parent]) : localMatrices[i];
+		}
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "TransformMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class FJobSystem;
+
+// One-based, zero is the invalid node. A handle stays the same while the node is moved around the
+// hierarchy and the arrays are reordered.
+struct FSceneNodeHandle
+{
+	uint32_t Value = 0;
+
+	bool IsValid() const
+	{
+		return Value != 0;
+	}
+
+	bool operator==(const FSceneNodeHandle& other) const
+	{
+		return Value == other.Value;
+	}
+
+	bool operator!=(const FSceneNodeHandle& other) const
+	{
+		return Value != other.Value;
+	}
+};
+
+// Counters of the last call to Update().
+struct FSceneGraphStats
+{
+	uint32_t NodeCount = 0;
+	uint32_t LevelCount = 0;
+	uint32_t NodesUpdated = 0;
+	bool HierarchyRebuilt = false;
+};
+
+// Transform hierarchy stored breadth first in flat arrays, so every parent precedes its children and
+// all nodes of one depth are contiguous. Setting a local transform only flags the node; Update() then
+// recomputes the world matrices of flagged nodes and their descendants, level by level.
+//
+// Creating, destroying or reparenting nodes appends or flags entries and defers the breadth-first
+// reordering to the next Update().
+class FSceneGraph
+{
+public:
+	FSceneGraph();
+
+	FSceneNodeHandle CreateNode(FSceneNodeHandle parent = FSceneNodeHandle());
+	// Destroys the node and its whole subtree.
+	void DestroyNode(FSceneNodeHandle node);
+	// An invalid parent makes the node a root. The parent must not be a descendant of the node.
+	void SetParent(FSceneNodeHandle node, FSceneNodeHandle parent);
+	FSceneNodeHandle GetParent(FSceneNodeHandle node) const;
+	bool IsAlive(FSceneNodeHandle node) const;
+
+	void SetLocalTransform(FSceneNodeHandle node, const FFloat3& position, const FQuaternion& rotation, const FFloat3& scale);
+	void SetLocalPosition(FSceneNodeHandle node, const FFloat3& position);
+	void SetLocalRotation(FSceneNodeHandle node, const FQuaternion& rotation);
+	FFloat3 GetLocalPosition(FSceneNodeHandle node) const;
+	FQuaternion GetLocalRotation(FSceneNodeHandle node) const;
+	FFloat3 GetLocalScale(FSceneNodeHandle node) const;
+
+	// Recomputes the world matrices of changed nodes and their subtrees. Levels with many changed nodes
+	// are split across the job system when one is given.
+	void Update(FJobSystem* jobSystem = nullptr);
+	// Recomputes every world matrix, the cost Update() avoids.
+	void UpdateAll(FJobSystem* jobSystem = nullptr);
+
+	// Valid after the Update() that followed the last change of the node or its ancestors.
+	const FFloat4x4& GetWorldMatrix(FSceneNodeHandle node) const;
+
+	uint32_t GetNodeCount() const;
+	// World matrices in breadth-first order. GetNodeIndex() maps a handle into this array until the
+	// hierarchy changes.
+	const FFloat4x4* GetWorldMatrices() const;
+	uint32_t GetNodeIndex(FSceneNodeHandle node) const;
+
+	const FSceneGraphStats& GetLastUpdateStats() const;
+
+private:
+	static constexpr uint32_t InvalidIndex = ~0u;
+
+	uint32_t GetIndex(FSceneNodeHandle node) const;
+	void MarkDirty(uint32_t index);
+	void RebuildHierarchy();
+	// Collects the flagged nodes and their descendants into DirtyIndices, one sorted slice per level.
+	void CollectDirtyNodes();
+	void UpdateDirtyNodes(FJobSystem* jobSystem);
+	// Composes the world matrices of DirtyIndices[first, last), all on the same level, in chunks of
+	// ComposeRunLength.
+	void UpdateNodes(uint32_t first, uint32_t last);
+
+	// Arrays in breadth-first order once the hierarchy is rebuilt. Nodes created since then are appended.
+	FTransformSoA LocalTransforms;
+	std::vector<FFloat4x4> WorldMatrices;
+	std::vector<uint32_t> ParentIndices;
+	std::vector<uint32_t> NodeSlots;
+	// One bit per node, set on change and cleared when the node is collected.
+	std::vector<uint64_t> DirtyBits;
+	// The children of a node are contiguous, and so are the children of a contiguous range of nodes.
+	std::vector<uint32_t> FirstChildIndices;
+	std::vector<uint32_t> ChildCounts;
+	// First index of every depth and one past the last node.
+	std::vector<uint32_t> LevelStarts;
+
+	// Per handle slot, indexed by handle value - 1.
+	std::vector<uint32_t> SlotIndices;
+	std::vector<uint32_t> SlotParents;
+	std::vector<uint32_t> FreeSlots;
+
+	uint32_t LiveNodeCount;
+	bool HierarchyChanged;
+
+	// Set by any change, lets Update() skip the scan of the bits when nothing moved.
+	bool HasDirtyNodes;
+	// Changed nodes and their descendants, one sorted slice per level.
+	std::vector<uint32_t> DirtyIndices;
+	std::vector<uint32_t> DirtyLevelStarts;
+	// Local transforms of scattered dirty nodes, at the positions they have in DirtyIndices.
+	FTransformSoA PackedTransforms;
+
+	// Scratch space of RebuildHierarchy(), kept between calls.
+	std::vector<uint32_t> ChildStarts;
+	std::vector<uint32_t> Children;
+	std::vector<uint32_t> NewOrder;
+	FTransformSoA ReorderedTransforms;
+	std::vector<FFloat4x4> ReorderedWorldMatrices;
+	std::vector<uint32_t> ReorderedParents;
+	std::vector<uint32_t> ReorderedSlots;
+	std::vector<uint64_t> ReorderedDirtyBits;
+
+	FSceneGraphStats LastUpdateStats;
+};
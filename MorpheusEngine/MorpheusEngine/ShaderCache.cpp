@@ -0,0 +1,464 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+	const uint32_t ShaderBlobMagic = 0x43485353; // "SSHC"
+	const uint32_t ShaderBlobVersion = 1;
+	// Bumped when the key stops covering what it used to, so old blobs are never read with new meaning.
+	const char* const ShaderKeyVersion = "MorpheusShaderKey 1";
+	// Include chains deeper than this are a cycle the name check missed, like "a" and "./a".
+	const uint32_t MaxIncludeDepth = 32;
+
+	struct FShaderBlobHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t Key;
+		uint64_t BytecodeSize;
+		uint64_t BytecodeHash;
+	};
+
+	static_assert(sizeof(FShaderBlobHeader) == 32, "Shader blob header layout changed");
+
+	uint64_t HashBytes(const std::vector<uint8_t>& bytes)
+	{
+		FHasher hasher;
+		hasher.Add(bytes.data(), bytes.size());
+
+		return hasher.Get();
+	}
+
+	bool SetError(std::string* error, const std::string& message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+
+		return false;
+	}
+
+	bool ReadFile(const std::string& path, std::string& contents)
+	{
+		FILE* file = std::fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+
+		contents.clear();
+		char buffer[4096];
+		size_t bytesRead;
+		while ((bytesRead = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			contents.append(buffer, bytesRead);
+		}
+
+		bool succeeded = !std::ferror(file);
+		std::fclose(file);
+
+		return succeeded;
+	}
+
+	// The directory part of a path, with its separator.
+	std::string GetDirectory(const std::string& path)
+	{
+		size_t separator = path.find_last_of("/\\");
+
+		return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+	}
+
+	// The names of every #include "name" and #include <name> line, in order.
+	void FindIncludes(const std::string& text, std::vector<std::string>& names)
+	{
+		size_t lineBegin = 0;
+		while (lineBegin < text.size())
+		{
+			size_t lineEnd = text.find('\n', lineBegin);
+			lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd;
+
+			size_t i = text.find_first_not_of(" \t", lineBegin);
+			if (i < lineEnd && text[i] == '#')
+			{
+				i = text.find_first_not_of(" \t", i + 1);
+				if (i < lineEnd && text.compare(i, 7, "include") == 0)
+				{
+					i = text.find_first_not_of(" \t", i + 7);
+					if (i < lineEnd && (text[i] == '"' || text[i] == '<'))
+					{
+						char close = text[i] == '"' ? '"' : '>';
+						size_t end = text.find(close, i + 1);
+						if (end < lineEnd)
+						{
+							names.push_back(text.substr(i + 1, end - i - 1));
+						}
+					}
+				}
+			}
+
+			lineBegin = lineEnd + 1;
+		}
+	}
+
+	const FShaderVirtualFile* FindVirtualFile(const FShaderCompileRequest& request, const std::string& name)
+	{
+		for (const FShaderVirtualFile& file : request.VirtualFiles)
+		{
+			if (file.Name == name)
+			{
+				return &file;
+			}
+		}
+
+		return nullptr;
+	}
+
+	bool ResolveIncludes(const FShaderCompileRequest& request, const std::string& text, const std::string& directory, uint32_t depth,
+		FShaderSources& sources, std::vector<std::string>& visited, std::string* error)
+	{
+		if (depth > MaxIncludeDepth)
+		{
+			return SetError(error, "Includes of " + request.FileName + " are nested too deeply");
+		}
+
+		std::vector<std::string> names;
+		FindIncludes(text, names);
+
+		for (const std::string& name : names)
+		{
+			const FShaderVirtualFile* virtualFile = FindVirtualFile(request, name);
+			std::string path = virtualFile ? "virtual:" + name : directory + name;
+			if (std::find(visited.begin(), visited.end(), path) != visited.end())
+			{
+				continue;
+			}
+			visited.push_back(path);
+
+			FShaderSourceFile file;
+			file.Name = name;
+			if (virtualFile)
+			{
+				file.Text = virtualFile->Text;
+			}
+			else if (!ReadFile(path, file.Text))
+			{
+				return SetError(error, "Could not read " + path + ", included by " + request.FileName);
+			}
+
+			sources.Files.push_back(file);
+
+			// The file may move in the vector while its includes are appended.
+			std::string includedText = sources.Files.back().Text;
+			if (!ResolveIncludes(request, includedText, virtualFile ? directory : GetDirectory(path), depth + 1, sources, visited, error))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+const FShaderSourceFile* FShaderSources::FindInclude(const char* name) const
+{
+	for (size_t i = 1; i < Files.size(); ++i)
+	{
+		if (Files[i].Name == name)
+		{
+			return &Files[i];
+		}
+	}
+
+	return nullptr;
+}
+
+bool ResolveShaderSources(const FShaderCompileRequest& request, FShaderSources& sources, std::string* error)
+{
+	sources.Files.clear();
+
+	FShaderSourceFile main;
+	main.Name = request.FileName;
+	if (request.FileName.empty() || !ReadFile(request.FileName, main.Text))
+	{
+		return SetError(error, "Could not read shader '" + request.FileName + "'");
+	}
+	sources.Files.push_back(main);
+
+	std::vector<std::string> visited;
+	visited.push_back(request.FileName);
+
+	return ResolveIncludes(request, sources.Files[0].Text, GetDirectory(request.FileName), 0, sources, visited, error);
+}
+
+uint64_t ComputeShaderKey(const FShaderCompileRequest& request, const FShaderSources& sources, const char* compilerIdentity)
+{
+	FHasher hasher;
+	hasher.Add(std::string(ShaderKeyVersion));
+	hasher.Add(std::string(compilerIdentity));
+	hasher.Add(request.EntryPoint);
+	hasher.Add(request.Profile);
+	hasher.Add(uint64_t(request.Flags));
+
+	// The main file is keyed by its contents only, so moving the shaders around keeps the cache.
+	hasher.Add(uint64_t(sources.Files.size()));
+	for (size_t i = 0; i < sources.Files.size(); ++i)
+	{
+		hasher.Add(i == 0 ? std::string() : sources.Files[i].Name);
+		hasher.Add(sources.Files[i].Text);
+	}
+
+	return hasher.Get();
+}
+
+FStubShaderCompiler::FStubShaderCompiler(uint32_t compileMicroseconds)
+	: CompileMicroseconds(compileMicroseconds)
+	, CompileCount(0)
+{
+}
+
+const char* FStubShaderCompiler::GetIdentity() const
+{
+	return "Stub 1";
+}
+
+bool FStubShaderCompiler::Compile(const FShaderCompileRequest& request, const FShaderSources& sources, std::vector<uint8_t>& bytecode, std::string& messages)
+{
+	CompileCount.fetch_add(1, std::memory_order_relaxed);
+
+	// Spins rather than sleeps, a compile keeps its core busy.
+	auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(CompileMicroseconds);
+	while (std::chrono::steady_clock::now() < end)
+	{
+	}
+
+	for (const FShaderSourceFile& file : sources.Files)
+	{
+		if (file.Text.find("#error") != std::string::npos)
+		{
+			messages = file.Name + ": error: #error directive";
+			return false;
+		}
+	}
+
+	std::string text = "STUB " + request.Profile + " " + request.EntryPoint + " ";
+	uint64_t digest = ComputeShaderKey(request, sources, GetIdentity());
+
+	bytecode.assign(text.begin(), text.end());
+	bytecode.insert(bytecode.end(), reinterpret_cast<const uint8_t*>(&digest), reinterpret_cast<const uint8_t*>(&digest) + sizeof(digest));
+	messages.clear();
+
+	return true;
+}
+
+uint32_t FStubShaderCompiler::GetCompileCount() const
+{
+	return CompileCount.load(std::memory_order_relaxed);
+}
+
+FShaderCache::FShaderCache(const std::string& directory, IShaderCompiler* compiler)
+	: Directory(directory)
+	, Compiler(compiler)
+{
+}
+
+void FShaderCache::Compile(const FShaderCompileRequest* requests, uint32_t requestCount, FShaderCacheResult* results, FJobSystem* jobSystem)
+{
+	// One entry per distinct key, the first request with it does the work.
+	std::vector<FShaderSources> sources(requestCount);
+	std::vector<uint32_t> owners(requestCount, ~0u);
+	std::vector<uint32_t> misses;
+	std::unordered_map<uint64_t, uint32_t> firstRequests;
+	FShaderCacheStats stats;
+
+	for (uint32_t i = 0; i < requestCount; ++i)
+	{
+		FShaderCacheResult& result = results[i];
+		result = FShaderCacheResult();
+
+		if (!ResolveShaderSources(requests[i], sources[i], &result.Messages))
+		{
+			++stats.Failures;
+			continue;
+		}
+
+		result.Key = ComputeShaderKey(requests[i], sources[i], Compiler->GetIdentity());
+
+		auto inserted = firstRequests.insert(std::make_pair(result.Key, i));
+		owners[i] = inserted.first->second;
+		if (!inserted.second)
+		{
+			continue;
+		}
+
+		if (LoadBlob(result.Key, result.Bytecode))
+		{
+			result.Succeeded = true;
+			result.Hit = true;
+			++stats.Hits;
+		}
+		else
+		{
+			misses.push_back(i);
+			++stats.Misses;
+		}
+	}
+
+	auto compileMisses = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t miss = begin; miss < end; ++miss)
+		{
+			uint32_t i = misses[miss];
+			FShaderCacheResult& result = results[i];
+
+			result.Succeeded = Compiler->Compile(requests[i], sources[i], result.Bytecode, result.Messages);
+			if (result.Succeeded && StoreBlob(result.Key, result.Bytecode))
+			{
+				std::lock_guard<std::mutex> lock(StatsMutex);
+				++Stats.BlobsWritten;
+			}
+		}
+	};
+
+	if (jobSystem && misses.size() > 1)
+	{
+		jobSystem->ParallelFor(static_cast<uint32_t>(misses.size()), 1, compileMisses);
+	}
+	else
+	{
+		compileMisses(0, static_cast<uint32_t>(misses.size()));
+	}
+
+	for (uint32_t miss : misses)
+	{
+		stats.Failures += results[miss].Succeeded ? 0 : 1;
+	}
+
+	for (uint32_t i = 0; i < requestCount; ++i)
+	{
+		if (owners[i] != ~0u && owners[i] != i)
+		{
+			results[i] = results[owners[i]];
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	Stats.Hits += stats.Hits;
+	Stats.Misses += stats.Misses;
+	Stats.Failures += stats.Failures;
+}
+
+std::string FShaderCache::GetBlobPath(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.shader", static_cast<unsigned long long>(key));
+
+	return Directory + "/" + name;
+}
+
+FShaderCacheStats FShaderCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(StatsMutex);
+
+	return Stats;
+}
+
+void FShaderCache::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	Stats = FShaderCacheStats();
+}
+
+bool FShaderCache::LoadBlob(uint64_t key, std::vector<uint8_t>& bytecode)
+{
+	if (Directory.empty())
+	{
+		return false;
+	}
+
+	std::string contents;
+	if (!ReadFile(GetBlobPath(key), contents))
+	{
+		return false;
+	}
+
+	// A blob that fails here is compiled and written again like any miss.
+	FShaderBlobHeader header;
+	bool valid = contents.size() >= sizeof(header);
+	if (valid)
+	{
+		std::memcpy(&header, contents.data(), sizeof(header));
+		valid = header.Magic == ShaderBlobMagic && header.Version == ShaderBlobVersion && header.Key == key &&
+			header.BytecodeSize == contents.size() - sizeof(header);
+	}
+
+	if (valid)
+	{
+		bytecode.assign(contents.begin() + sizeof(header), contents.end());
+		valid = HashBytes(bytecode) == header.BytecodeHash;
+	}
+
+	if (!valid)
+	{
+		bytecode.clear();
+
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		++Stats.CorruptBlobs;
+	}
+
+	return valid;
+}
+
+bool FShaderCache::StoreBlob(uint64_t key, const std::vector<uint8_t>& bytecode)
+{
+	if (Directory.empty())
+	{
+		return false;
+	}
+
+	std::error_code errorCode;
+	std::filesystem::create_directories(Directory, errorCode);
+
+	FShaderBlobHeader header;
+	header.Magic = ShaderBlobMagic;
+	header.Version = ShaderBlobVersion;
+	header.Key = key;
+	header.BytecodeSize = bytecode.size();
+	header.BytecodeHash = HashBytes(bytecode);
+
+	// Written next to the blob and renamed over it, so another process never reads half a file. The
+	// temporary name is unique to the thread.
+	std::string path = GetBlobPath(key);
+	std::string temporaryPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+	FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(bytecode.empty() || std::fwrite(bytecode.data(), 1, bytecode.size(), file) == bytecode.size());
+	written = std::fclose(file) == 0 && written;
+
+	if (written)
+	{
+		// Replaces a blob another process stored for the same key in the meantime, with the same bytecode.
+		std::filesystem::rename(temporaryPath, path, errorCode);
+		written = !errorCode;
+	}
+
+	std::filesystem::remove(temporaryPath, errorCode);
+
+	return written;
+}
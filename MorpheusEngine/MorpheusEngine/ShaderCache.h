@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FJobSystem;
+
+// Shader bytecode cache addressed by what the bytecode is made from: the source of the shader and of
+// everything it includes, the entry point, the profile, the compile flags and the compiler. Blobs are
+// stored as "<directory>/<key>.shader", so a changed input is a new file and nothing is ever
+// invalidated in place. Hits cost a file read; misses are compiled on the job system, all of a batch at
+// once, and written back for the next launch.
+
+// A file the shaders include that only exists in memory, like the generated vertex input.
+struct FShaderVirtualFile
+{
+	std::string Name;
+	std::string Text;
+};
+
+struct FShaderCompileRequest
+{
+	// Path of the HLSL file. Includes resolve next to the file that includes them.
+	std::string FileName;
+	std::string EntryPoint;
+	std::string Profile;
+	// D3DCOMPILE_* flags.
+	uint32_t Flags = 0;
+	// Consulted before the disk, by the name in the #include.
+	std::vector<FShaderVirtualFile> VirtualFiles;
+};
+
+struct FShaderSourceFile
+{
+	// The request file name for the main file, the name in the #include for the others.
+	std::string Name;
+	std::string Text;
+};
+
+// Every file of a request, the main file first, then the includes in the order they were found.
+struct FShaderSources
+{
+	std::vector<FShaderSourceFile> Files;
+
+	// The first include of that name, or null.
+	const FShaderSourceFile* FindInclude(const char* name) const;
+};
+
+// Reads the main file and, recursively, every file it names in an #include, including those in
+// disabled #if blocks, which only costs a spurious miss when they change. Fails when a file is
+// missing, with its name in error.
+bool ResolveShaderSources(const FShaderCompileRequest& request, FShaderSources& sources, std::string* error = nullptr);
+
+uint64_t ComputeShaderKey(const FShaderCompileRequest& request, const FShaderSources& sources, const char* compilerIdentity);
+
+class IShaderCompiler
+{
+public:
+	virtual ~IShaderCompiler() {}
+
+	// Part of every key, so a different compiler or version misses the whole cache.
+	virtual const char* GetIdentity() const = 0;
+	// Called from several job workers at once. Messages get the errors, and the warnings of successful
+	// compiles.
+	virtual bool Compile(const FShaderCompileRequest& request, const FShaderSources& sources, std::vector<uint8_t>& bytecode, std::string& messages) = 0;
+};
+
+// Stands in for the HLSL compiler where there is none, so the cache runs anywhere. The bytecode is a
+// deterministic digest of the inputs; an "#error" in any source fails like the real compiler would.
+// compileMicroseconds of busy work per shader model the cost of a real compile.
+class FStubShaderCompiler : public IShaderCompiler
+{
+public:
+	explicit FStubShaderCompiler(uint32_t compileMicroseconds = 0);
+
+	const char* GetIdentity() const override;
+	bool Compile(const FShaderCompileRequest& request, const FShaderSources& sources, std::vector<uint8_t>& bytecode, std::string& messages) override;
+
+	uint32_t GetCompileCount() const;
+
+private:
+	uint32_t CompileMicroseconds;
+	std::atomic<uint32_t> CompileCount;
+};
+
+struct FShaderCacheResult
+{
+	bool Succeeded = false;
+	// Loaded from the directory rather than compiled.
+	bool Hit = false;
+	uint64_t Key = 0;
+	std::vector<uint8_t> Bytecode;
+	// Compiler messages, or why the sources could not be read.
+	std::string Messages;
+};
+
+struct FShaderCacheStats
+{
+	uint32_t Hits = 0;
+	uint32_t Misses = 0;
+	uint32_t Failures = 0;
+	// Blobs that were in the directory but did not pass validation, counted as misses too.
+	uint32_t CorruptBlobs = 0;
+	uint32_t BlobsWritten = 0;
+};
+
+class FShaderCache
+{
+public:
+	// An empty directory keeps nothing between runs.
+	FShaderCache(const std::string& directory, IShaderCompiler* compiler);
+
+	FShaderCache(const FShaderCache&) = delete;
+	FShaderCache& operator=(const FShaderCache&) = delete;
+
+	// Fills one result per request. Requests with the same key are compiled once. Misses compile in
+	// parallel on the job system, or one after another without one.
+	void Compile(const FShaderCompileRequest* requests, uint32_t requestCount, FShaderCacheResult* results, FJobSystem* jobSystem = nullptr);
+
+	std::string GetBlobPath(uint64_t key) const;
+
+	FShaderCacheStats GetStats() const;
+	void ResetStats();
+
+private:
+	bool LoadBlob(uint64_t key, std::vector<uint8_t>& bytecode);
+	bool StoreBlob(uint64_t key, const std::vector<uint8_t>& bytecode);
+
+	std::string Directory;
+	IShaderCompiler* Compiler;
+
+	mutable std::mutex StatsMutex;
+	FShaderCacheStats Stats;
+};
@@ -11,13 +11,13 @@ cbuffer PerFrame : register(b1)
 cbuffer PerObject : register(b2)
 {
 	matrix worldMatrix;
+	// Dequantisation of the mesh positions, see FPositionQuantization.
+	float4 positionScale;
+	float4 positionOffset;
 }
 
-struct AppData
-{
-	float3 position : POSITION;
-	float3 color : COLOR;
-};
+// VertexInput and DecodeVertex(), generated from the input layout of the mesh when the shader is compiled.
+#include "VertexInput.hlsli"
 
 struct VertexShaderOutput
 {
@@ -25,13 +25,14 @@ struct VertexShaderOutput
 	float4 position : SV_POSITION;
 };
 
-VertexShaderOutput main(AppData InData)
+VertexShaderOutput main(VertexInput InData)
 {
 	VertexShaderOutput outData;
+	DecodedVertex vertex = DecodeVertex(InData);
 
 	matrix mvp = mul(projectionMatrix, mul(viewMatrix, worldMatrix));
-	outData.position = mul(mvp, float4(InData.position, 1.0f));
-	outData.color = float4(InData.color, 1.0f);
+	outData.position = mul(mvp, float4(vertex.position, 1.0f));
+	outData.color = vertex.color;
 
 	return outData;
 }
@@ -0,0 +1,1221 @@
+#include "SoftwareRenderDevice.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MORPHEUS_SOFTWARE_RASTERIZER_SSE 1
+#include <emmintrin.h>
+#else
+#define MORPHEUS_SOFTWARE_RASTERIZER_SSE 0
+#endif
+
+namespace
+{
+	// Vertices are snapped to 1/16th of a pixel, like the sub-pixel precision of real hardware.
+	const float SubPixelScale = 16.0f;
+	const float InverseSubPixelScale = 1.0f / SubPixelScale;
+
+	// Triangles are clipped to a guard band of this many pixels around the viewport so that the edge
+	// functions stay well inside float precision.
+	const float GuardBandPixels = 8192.0f;
+
+	const float MaxDepth24 = 16777215.0f;
+
+	// "Shaders/SimpleVertexShader.hlsl" and "SimpleVertexShader" are both "SimpleVertexShader".
+	std::string GetFileStem(const std::string& fileName)
+	{
+		size_t start = fileName.find_last_of("/\\");
+		start = start == std::string::npos ? 0 : start + 1;
+
+		size_t end = fileName.find('.', start);
+
+		return fileName.substr(start, end == std::string::npos ? std::string::npos : end - start);
+	}
+
+	uint32_t PackColour(const float colour[4])
+	{
+		uint32_t packedColour = 0;
+
+		for (int channel = 0; channel < 4; ++channel)
+		{
+			float value = std::min(std::max(colour[channel], 0.0f), 1.0f);
+			packedColour |= static_cast<uint32_t>(value * 255.0f + 0.5f) << (channel * 8);
+		}
+
+		return packedColour;
+	}
+
+	// Rounds to nearest like the SIMD path, adding one half would overflow 24 bits in float.
+	uint32_t QuantizeDepth(float depth)
+	{
+		depth = std::min(std::max(depth, 0.0f), 1.0f);
+
+		return static_cast<uint32_t>(std::lrint(depth * MaxDepth24));
+	}
+
+	// Row vector convention, the same as DirectXMath and the HLSL shaders with default packing.
+	void MultiplyMatrix(const float* left, const float* right, float* result)
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				result[row * 4 + column] =
+					left[row * 4 + 0] * right[0 * 4 + column] +
+					left[row * 4 + 1] * right[1 * 4 + column] +
+					left[row * 4 + 2] * right[2 * 4 + column] +
+					left[row * 4 + 3] * right[3 * 4 + column];
+			}
+		}
+	}
+
+#if MORPHEUS_SOFTWARE_RASTERIZER_SSE
+	// Depth values are below 2^24 so the signed integer compares are exact.
+	__m128i DepthTestMask(EComparisonFunc depthFunc, __m128i newDepth, __m128i oldDepth)
+	{
+		const __m128i allBits = _mm_set1_epi32(-1);
+
+		switch (depthFunc)
+		{
+			case EComparisonFunc::Never:
+				return _mm_setzero_si128();
+
+			case EComparisonFunc::Less:
+				return _mm_cmplt_epi32(newDepth, oldDepth);
+
+			case EComparisonFunc::Equal:
+				return _mm_cmpeq_epi32(newDepth, oldDepth);
+
+			case EComparisonFunc::LessEqual:
+				return _mm_xor_si128(_mm_cmpgt_epi32(newDepth, oldDepth), allBits);
+
+			case EComparisonFunc::Greater:
+				return _mm_cmpgt_epi32(newDepth, oldDepth);
+
+			case EComparisonFunc::NotEqual:
+				return _mm_xor_si128(_mm_cmpeq_epi32(newDepth, oldDepth), allBits);
+
+			case EComparisonFunc::GreaterEqual:
+				return _mm_xor_si128(_mm_cmplt_epi32(newDepth, oldDepth), allBits);
+
+			default:
+				return allBits;
+		}
+	}
+
+	int PopulationCount4(int mask)
+	{
+		return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+	}
+#else
+	bool PassesDepthTest(EComparisonFunc depthFunc, uint32_t newDepth, uint32_t oldDepth)
+	{
+		switch (depthFunc)
+		{
+			case EComparisonFunc::Never:
+				return false;
+
+			case EComparisonFunc::Less:
+				return newDepth < oldDepth;
+
+			case EComparisonFunc::Equal:
+				return newDepth == oldDepth;
+
+			case EComparisonFunc::LessEqual:
+				return newDepth <= oldDepth;
+
+			case EComparisonFunc::Greater:
+				return newDepth > oldDepth;
+
+			case EComparisonFunc::NotEqual:
+				return newDepth != oldDepth;
+
+			case EComparisonFunc::GreaterEqual:
+				return newDepth >= oldDepth;
+
+			default:
+				return true;
+		}
+	}
+#endif
+}
+
+struct FSoftwareRenderDevice::FClipVertex
+{
+	float Position[4];
+	float Colour[3];
+};
+
+// A triangle after clipping, projection and culling, ready to be rasterized.
+struct FSoftwareRenderDevice::FSetupTriangle
+{
+	// Edge i is opposite vertex i and evaluates to Sign * (DeltaX * (y - OriginY) - DeltaY * (x - OriginX)).
+	// The origin is always the same end point of an edge, so two triangles sharing an edge compute
+	// bit-identical values with opposite signs and never both cover a pixel.
+	float EdgeOriginX[3];
+	float EdgeOriginY[3];
+	float EdgeDeltaX[3];
+	float EdgeDeltaY[3];
+	float EdgeSign[3];
+	bool EdgeTopLeft[3];
+
+	float InverseArea;
+	float Depth[3];
+	float InverseW[3];
+	// Vertex colours divided by w, for perspective correct interpolation.
+	float ColourOverW[3][3];
+
+	int32_t MinX;
+	int32_t MinY;
+	int32_t MaxX;
+	int32_t MaxY;
+
+	uint32_t DrawIndex;
+};
+
+// Triangles set up from a contiguous range of draws, binned per tile in submission order.
+struct FSoftwareRenderDevice::FBinningChunk
+{
+	std::vector<FSetupTriangle> Triangles;
+	std::vector<std::vector<uint32_t>> TileBins;
+	std::vector<FClipVertex> TransformedVertices;
+	FSoftwareRasterizerStats Stats;
+};
+
+FSoftwareRenderDevice::FSoftwareRenderDevice(uint32_t width, uint32_t height, FJobSystem* jobSystem)
+	: FNullRenderDevice(false)
+	, Width(width)
+	, Height(height)
+	, TilesX((width + TileSize - 1) / TileSize)
+	, TilesY((height + TileSize - 1) / TileSize)
+	, ActiveChunks(0)
+	, ClearPending(false)
+	, PendingClearColour(0)
+	, PendingClearDepthStencil(0)
+	, JobSystem(jobSystem)
+{
+	assert(width > 0 && height > 0);
+
+	ColourBuffer.resize(GetPitch() * Height, 0);
+	DepthBuffer.resize(GetPitch() * Height, static_cast<uint32_t>(MaxDepth24));
+
+	FNullTexture* backBuffer = Textures.Get(BackBuffer);
+	backBuffer->Description.Width = Width;
+	backBuffer->Description.Height = Height;
+
+	if (!JobSystem)
+	{
+		OwnedJobSystem.reset(new FJobSystem());
+		JobSystem = OwnedJobSystem.get();
+	}
+}
+
+FSoftwareRenderDevice::~FSoftwareRenderDevice()
+{
+	for (FBinningChunk* chunk : Chunks)
+	{
+		delete chunk;
+	}
+}
+
+FVertexShaderHandle FSoftwareRenderDevice::CreateVertexShader(const FShaderBytecode& bytecode)
+{
+	FVertexShaderHandle handle = FNullRenderDevice::CreateVertexShader(bytecode);
+	FNullShader* shader = VertexShaders.Get(handle);
+	if (!shader)
+	{
+		return handle;
+	}
+
+	// Bytecode cannot be executed here, the source file named by the debug name selects the built-in
+	// equivalent. Shaders without a name draw nothing.
+	std::string stem = GetFileStem(bytecode.DebugName ? bytecode.DebugName : "");
+	EVertexProgram program = EVertexProgram::Unsupported;
+	if (stem == "SimpleVertexShader")
+	{
+		program = EVertexProgram::Simple;
+	}
+	else if (stem == "InstancedVertexShader")
+	{
+		program = EVertexProgram::Instanced;
+	}
+
+	shader->Program = static_cast<uint8_t>(program);
+
+	return handle;
+}
+
+void FSoftwareRenderDevice::UpdateBuffer(FBufferHandle buffer, const void* data, uint32_t size)
+{
+	// Constant buffers are captured per draw, but geometry is read when the frame is flushed.
+	FNullBuffer* target = FindBuffer(buffer);
+	if (target && target->Description.Binding != EBufferBinding::Constant && !Draws.empty())
+	{
+		Flush();
+	}
+
+	FNullRenderDevice::UpdateBuffer(buffer, data, size);
+}
+
+void* FSoftwareRenderDevice::MapBuffer(FBufferHandle buffer, EMapMode mode)
+{
+	// As in UpdateBuffer(), only geometry has to be drawn before it is overwritten.
+	FNullBuffer* target = FindBuffer(buffer);
+	if (target && target->Description.Binding != EBufferBinding::Constant && !Draws.empty())
+	{
+		Flush();
+	}
+
+	return FNullRenderDevice::MapBuffer(buffer, mode);
+}
+
+bool FSoftwareRenderDevice::ResizeBackBuffer(uint32_t width, uint32_t height)
+{
+	// The tiles and buffers are laid out once, for the size the device was created with.
+	return width == Width && height == Height;
+}
+
+void FSoftwareRenderDevice::Clear(const float clearColour[4], float clearDepth, uint8_t clearStencil)
+{
+	FNullRenderDevice::Clear(clearColour, clearDepth, clearStencil);
+
+	if (!Draws.empty())
+	{
+		Flush();
+	}
+
+	ClearPending = true;
+	PendingClearColour = PackColour(clearColour);
+	PendingClearDepthStencil = QuantizeDepth(clearDepth) | (static_cast<uint32_t>(clearStencil) << 24);
+}
+
+void FSoftwareRenderDevice::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	FNullRenderDevice::DrawIndexed(indexCount, startIndex, baseVertex);
+
+	SubmitDraw(indexCount, 1, startIndex, baseVertex, 0);
+}
+
+void FSoftwareRenderDevice::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	FNullRenderDevice::DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+
+	SubmitDraw(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void FSoftwareRenderDevice::Present(bool vSync)
+{
+	Flush();
+
+	LastFrameRasterizerStats = RasterizerStats;
+	RasterizerStats = FSoftwareRasterizerStats();
+
+	FNullRenderDevice::Present(vSync);
+}
+
+void FSoftwareRenderDevice::Flush()
+{
+	const uint32_t tileCount = TilesX * TilesY;
+
+	if (Draws.empty())
+	{
+		if (ClearPending)
+		{
+			JobSystem->ParallelFor(tileCount, 1, [this](uint32_t firstTile, uint32_t lastTile)
+			{
+				for (uint32_t tileIndex = firstTile; tileIndex < lastTile; ++tileIndex)
+				{
+					ClearTile(tileIndex);
+				}
+			});
+			ClearPending = false;
+		}
+
+		return;
+	}
+
+	// Several chunks per thread keep the setup phase balanced when draw sizes differ.
+	const uint32_t drawCount = static_cast<uint32_t>(Draws.size());
+	const uint32_t chunkCount = std::min(drawCount, JobSystem->GetConcurrency() * 4);
+	const uint32_t drawsPerChunk = (drawCount + chunkCount - 1) / chunkCount;
+
+	while (Chunks.size() < chunkCount)
+	{
+		FBinningChunk* chunk = new FBinningChunk();
+		chunk->TileBins.resize(tileCount);
+		Chunks.push_back(chunk);
+	}
+
+	ActiveChunks = chunkCount;
+
+	JobSystem->ParallelFor(chunkCount, 1, [this, drawCount, drawsPerChunk](uint32_t firstChunk, uint32_t lastChunk)
+	{
+		for (uint32_t chunkIndex = firstChunk; chunkIndex < lastChunk; ++chunkIndex)
+		{
+			uint32_t firstDraw = chunkIndex * drawsPerChunk;
+			uint32_t lastDraw = std::min(firstDraw + drawsPerChunk, drawCount);
+
+			SetupDraws(*Chunks[chunkIndex], firstDraw, lastDraw);
+		}
+	});
+
+	TilePixelsWritten.assign(tileCount, 0);
+
+	JobSystem->ParallelFor(tileCount, 1, [this](uint32_t firstTile, uint32_t lastTile)
+	{
+		for (uint32_t tileIndex = firstTile; tileIndex < lastTile; ++tileIndex)
+		{
+			if (ClearPending)
+			{
+				ClearTile(tileIndex);
+			}
+
+			TilePixelsWritten[tileIndex] = RasterizeTile(tileIndex);
+		}
+	});
+
+	for (uint64_t pixelsWritten : TilePixelsWritten)
+	{
+		RasterizerStats.PixelsWritten += pixelsWritten;
+	}
+
+	for (uint32_t chunkIndex = 0; chunkIndex < ActiveChunks; ++chunkIndex)
+	{
+		FBinningChunk& chunk = *Chunks[chunkIndex];
+
+		RasterizerStats.TrianglesSubmitted += chunk.Stats.TrianglesSubmitted;
+		RasterizerStats.TrianglesCulled += chunk.Stats.TrianglesCulled;
+		RasterizerStats.TrianglesClipped += chunk.Stats.TrianglesClipped;
+		RasterizerStats.TrianglesRasterized += chunk.Stats.TrianglesRasterized;
+
+		chunk.Triangles.clear();
+		chunk.Stats = FSoftwareRasterizerStats();
+
+		for (std::vector<uint32_t>& bin : chunk.TileBins)
+		{
+			bin.clear();
+		}
+	}
+
+	ActiveChunks = 0;
+	ClearPending = false;
+	Draws.clear();
+}
+
+uint32_t FSoftwareRenderDevice::GetWidth() const
+{
+	return Width;
+}
+
+uint32_t FSoftwareRenderDevice::GetHeight() const
+{
+	return Height;
+}
+
+uint32_t FSoftwareRenderDevice::GetPitch() const
+{
+	// Rows are padded to whole SIMD groups so that a group never straddles two rows.
+	return (Width + 3) & ~3u;
+}
+
+const uint32_t* FSoftwareRenderDevice::GetColourBuffer() const
+{
+	return ColourBuffer.data();
+}
+
+const uint32_t* FSoftwareRenderDevice::GetDepthBuffer() const
+{
+	return DepthBuffer.data();
+}
+
+bool FSoftwareRenderDevice::WriteColourBuffer(const char* fileName) const
+{
+	FILE* file = std::fopen(fileName, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	std::fprintf(file, "P6\n%u %u\n255\n", Width, Height);
+
+	std::vector<uint8_t> row(Width * 3);
+	for (uint32_t y = 0; y < Height; ++y)
+	{
+		for (uint32_t x = 0; x < Width; ++x)
+		{
+			uint32_t texel = ColourBuffer[y * GetPitch() + x];
+			row[x * 3 + 0] = static_cast<uint8_t>(texel);
+			row[x * 3 + 1] = static_cast<uint8_t>(texel >> 8);
+			row[x * 3 + 2] = static_cast<uint8_t>(texel >> 16);
+		}
+
+		std::fwrite(row.data(), 1, row.size(), file);
+	}
+
+	return std::fclose(file) == 0;
+}
+
+const FSoftwareRasterizerStats& FSoftwareRenderDevice::GetRasterizerStats() const
+{
+	return RasterizerStats;
+}
+
+const FSoftwareRasterizerStats& FSoftwareRenderDevice::GetLastFrameRasterizerStats() const
+{
+	return LastFrameRasterizerStats;
+}
+
+FSoftwareRenderDevice::EVertexProgram FSoftwareRenderDevice::GetBoundVertexProgram() const
+{
+	const FNullShader* shader = VertexShaders.Get(FVertexShaderHandle{ Bound.VertexShader });
+
+	return shader ? static_cast<EVertexProgram>(shader->Program) : EVertexProgram::Unsupported;
+}
+
+void FSoftwareRenderDevice::SubmitDraw(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	if (instanceCount == 0)
+	{
+		return;
+	}
+
+	FDraw draw;
+	if (!CaptureDraw(indexCount, startIndex, baseVertex, draw))
+	{
+		++RasterizerStats.SkippedDraws;
+		return;
+	}
+
+	if (GetBoundVertexProgram() == EVertexProgram::Instanced)
+	{
+		if (!CaptureInstances(draw, instanceCount, startInstance))
+		{
+			++RasterizerStats.SkippedDraws;
+		}
+
+		return;
+	}
+
+	// The simple program reads nothing per instance, every instance covers the same pixels.
+	Draws.insert(Draws.end(), instanceCount, draw);
+}
+
+bool FSoftwareRenderDevice::CaptureDraw(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex, FDraw& draw)
+{
+	EVertexProgram program = GetBoundVertexProgram();
+	if (program == EVertexProgram::Unsupported)
+	{
+		return false;
+	}
+
+	bool instanced = program == EVertexProgram::Instanced;
+
+	const FNullInputLayout* boundInputLayout = InputLayouts.Get(FInputLayoutHandle{ Bound.InputLayout });
+	if (!boundInputLayout)
+	{
+		return false;
+	}
+
+	// Resolve the attributes the vertex shader reads from the bound input layout, in the formats
+	// GenerateVertexShaderInput() decodes.
+	const FNullInputLayout& inputLayout = *boundInputLayout;
+	bool hasPosition = false;
+	bool hasColour = false;
+
+	for (size_t i = 0; i < inputLayout.Elements.size(); ++i)
+	{
+		const FInputElementDesc& element = inputLayout.Elements[i];
+		if (element.InputSlot != 0)
+		{
+			continue;
+		}
+
+		if (inputLayout.SemanticNames[i] == "POSITION" &&
+			(element.Format == EVertexFormat::Float3 || element.Format == EVertexFormat::Float4 || element.Format == EVertexFormat::Short4Norm))
+		{
+			draw.PositionOffset = element.AlignedByteOffset;
+			draw.PositionFormat = element.Format;
+			hasPosition = true;
+		}
+		else if (inputLayout.SemanticNames[i] == "COLOR" &&
+			(element.Format == EVertexFormat::Float3 || element.Format == EVertexFormat::Float4 || element.Format == EVertexFormat::UByte4Norm))
+		{
+			draw.ColourOffset = element.AlignedByteOffset;
+			draw.ColourFormat = element.Format;
+			hasColour = true;
+		}
+	}
+
+	FNullBuffer* vertexBuffer = FindBuffer(FBufferHandle{ Bound.VertexBuffers[0] });
+	FNullBuffer* indexBuffer = FindBuffer(FBufferHandle{ Bound.IndexBuffer });
+	if (!hasPosition || !hasColour || !vertexBuffer || !indexBuffer || Bound.VertexStrides[0] == 0)
+	{
+		return false;
+	}
+
+	draw.VertexStride = Bound.VertexStrides[0];
+	draw.Vertices = vertexBuffer->Data.data() + Bound.VertexOffsets[0];
+	draw.VertexCount = static_cast<uint32_t>((vertexBuffer->Data.size() - std::min<size_t>(Bound.VertexOffsets[0], vertexBuffer->Data.size())) / draw.VertexStride);
+
+	if (draw.PositionOffset + GetVertexFormatSize(draw.PositionFormat) > draw.VertexStride ||
+		draw.ColourOffset + GetVertexFormatSize(draw.ColourFormat) > draw.VertexStride)
+	{
+		return false;
+	}
+
+	uint32_t indexSize = Bound.IndexFormat == EIndexFormat::UInt32 ? 4 : 2;
+	size_t indexBytes = static_cast<size_t>(startIndex + indexCount) * indexSize + Bound.IndexOffset;
+	if (indexBytes > indexBuffer->Data.size())
+	{
+		return false;
+	}
+
+	draw.Indices = indexBuffer->Data.data() + Bound.IndexOffset + static_cast<size_t>(startIndex) * indexSize;
+	draw.IndexFormat = Bound.IndexFormat;
+	draw.IndexCount = indexCount;
+	draw.BaseVertex = baseVertex;
+
+	// The matrices are copied now, constant buffers are usually rewritten between draws. The instanced
+	// program takes its world matrices from the instances.
+	const uint32_t matrixCount = instanced ? 2 : 3;
+	const float* matrices[3];
+	for (uint32_t slot = 0; slot < matrixCount; ++slot)
+	{
+		FNullBuffer* constantBuffer = FindBuffer(FBufferHandle{ Bound.ConstantBuffers[static_cast<int>(EShaderStage::Vertex)][slot] });
+		uint32_t offset = Bound.ConstantBufferOffsets[static_cast<int>(EShaderStage::Vertex)][slot];
+		if (!constantBuffer || constantBuffer->Data.size() < offset + sizeof(float) * 16)
+		{
+			return false;
+		}
+
+		matrices[slot] = reinterpret_cast<const float*>(constantBuffer->Data.data() + offset);
+	}
+
+	// The dequantisation follows the world matrix in PerObject. Draws without it read float positions.
+	draw.PositionQuantization = GetIdentityPositionQuantization();
+	FNullBuffer* objectBuffer = FindBuffer(FBufferHandle{ Bound.ConstantBuffers[static_cast<int>(EShaderStage::Vertex)][2] });
+	uint32_t objectOffset = Bound.ConstantBufferOffsets[static_cast<int>(EShaderStage::Vertex)][2];
+	if (objectBuffer && objectBuffer->Data.size() >= objectOffset + sizeof(float) * 24)
+	{
+		std::memcpy(&draw.PositionQuantization.Scale, objectBuffer->Data.data() + objectOffset + sizeof(float) * 16, sizeof(FFloat3));
+		std::memcpy(&draw.PositionQuantization.Offset, objectBuffer->Data.data() + objectOffset + sizeof(float) * 20, sizeof(FFloat3));
+	}
+
+	// mul(projectionMatrix, mul(viewMatrix, worldMatrix)) on column major cbuffers is world * view * projection.
+	// Instanced draws keep view * projection here and apply the world matrices in CaptureInstances().
+	if (instanced)
+	{
+		MultiplyMatrix(matrices[1], matrices[0], draw.ModelViewProjection);
+	}
+	else
+	{
+		float worldView[16];
+		MultiplyMatrix(matrices[2], matrices[1], worldView);
+		MultiplyMatrix(worldView, matrices[0], draw.ModelViewProjection);
+	}
+
+	const FRasterizerDesc* rasterizer = RasterizerStates.Get(FRasterizerStateHandle{ Bound.RasterizerState });
+	const FDepthStencilDesc* depthStencil = DepthStencilStates.Get(FDepthStencilStateHandle{ Bound.DepthStencilState });
+	draw.Rasterizer = rasterizer ? *rasterizer : FRasterizerDesc();
+	draw.DepthStencil = depthStencil ? *depthStencil : FDepthStencilDesc();
+
+	draw.Viewport = Bound.Viewport;
+	if (draw.Viewport.Width <= 0.0f || draw.Viewport.Height <= 0.0f)
+	{
+		draw.Viewport = FViewport();
+		draw.Viewport.Width = static_cast<float>(Width);
+		draw.Viewport.Height = static_cast<float>(Height);
+	}
+
+	return true;
+}
+
+bool FSoftwareRenderDevice::CaptureInstances(const FDraw& draw, uint32_t instanceCount, uint32_t startInstance)
+{
+	// InstancedVertexShader.hlsl reads the first three columns of the world matrix as WORLD0 to WORLD2.
+	const FNullInputLayout& inputLayout = *InputLayouts.Get(FInputLayoutHandle{ Bound.InputLayout });
+	const FInputElementDesc* columns[3] = {};
+
+	for (size_t i = 0; i < inputLayout.Elements.size(); ++i)
+	{
+		const FInputElementDesc& element = inputLayout.Elements[i];
+		if (inputLayout.SemanticNames[i] == "WORLD" && element.SemanticIndex < 3 && element.Format == EVertexFormat::Float4 &&
+			element.Classification == EInputClassification::PerInstance)
+		{
+			columns[element.SemanticIndex] = &element;
+		}
+	}
+
+	if (!columns[0] || !columns[1] || !columns[2] || columns[1]->InputSlot != columns[0]->InputSlot || columns[2]->InputSlot != columns[0]->InputSlot ||
+		columns[0]->InputSlot >= MaxVertexBufferSlots)
+	{
+		return false;
+	}
+
+	const uint32_t slot = columns[0]->InputSlot;
+	const uint32_t stepRate = std::max(columns[0]->InstanceDataStepRate, 1u);
+	const uint32_t stride = Bound.VertexStrides[slot];
+
+	FNullBuffer* instanceBuffer = FindBuffer(FBufferHandle{ Bound.VertexBuffers[slot] });
+	if (!instanceBuffer || stride == 0)
+	{
+		return false;
+	}
+
+	uint32_t elementEnd = 0;
+	for (const FInputElementDesc* column : columns)
+	{
+		elementEnd = std::max(elementEnd, column->AlignedByteOffset + 16);
+	}
+
+	size_t lastElement = static_cast<size_t>(startInstance + (instanceCount - 1) / stepRate);
+	if (Bound.VertexOffsets[slot] + lastElement * stride + elementEnd > instanceBuffer->Data.size())
+	{
+		return false;
+	}
+
+	const uint8_t* instances = instanceBuffer->Data.data() + Bound.VertexOffsets[slot];
+	Draws.reserve(Draws.size() + instanceCount);
+
+	for (uint32_t instance = 0; instance < instanceCount; ++instance)
+	{
+		const uint8_t* instanceData = instances + static_cast<size_t>(startInstance + instance / stepRate) * stride;
+
+		// Column j holds M[0..3][j] of the row vector world matrix, the last column is (0, 0, 0, 1).
+		float world[16] = {};
+		for (int column = 0; column < 3; ++column)
+		{
+			float values[4];
+			std::memcpy(values, instanceData + columns[column]->AlignedByteOffset, sizeof(values));
+
+			for (int row = 0; row < 4; ++row)
+			{
+				world[row * 4 + column] = values[row];
+			}
+		}
+
+		world[15] = 1.0f;
+
+		Draws.push_back(draw);
+		MultiplyMatrix(world, draw.ModelViewProjection, Draws.back().ModelViewProjection);
+	}
+
+	return true;
+}
+
+void FSoftwareRenderDevice::SetupDraws(FBinningChunk& chunk, uint32_t firstDraw, uint32_t lastDraw)
+{
+	for (uint32_t drawIndex = firstDraw; drawIndex < lastDraw; ++drawIndex)
+	{
+		const FDraw& draw = Draws[drawIndex];
+
+		auto fetchIndex = [&draw](uint32_t i) -> int64_t
+		{
+			if (draw.IndexFormat == EIndexFormat::UInt32)
+			{
+				uint32_t index;
+				std::memcpy(&index, draw.Indices + i * 4, sizeof(index));
+				return static_cast<int64_t>(index) + draw.BaseVertex;
+			}
+
+			uint16_t index;
+			std::memcpy(&index, draw.Indices + i * 2, sizeof(index));
+			return static_cast<int64_t>(index) + draw.BaseVertex;
+		};
+
+		// Shade every vertex in the referenced range once, like a post-transform cache would.
+		int64_t minVertex = INT64_MAX;
+		int64_t maxVertex = INT64_MIN;
+		for (uint32_t i = 0; i < draw.IndexCount; ++i)
+		{
+			int64_t vertex = fetchIndex(i);
+			minVertex = std::min(minVertex, vertex);
+			maxVertex = std::max(maxVertex, vertex);
+		}
+
+		if (draw.IndexCount < 3 || minVertex < 0 || maxVertex >= draw.VertexCount)
+		{
+			continue;
+		}
+
+		const float* matrix = draw.ModelViewProjection;
+		chunk.TransformedVertices.resize(static_cast<size_t>(maxVertex - minVertex + 1));
+
+		for (int64_t vertex = minVertex; vertex <= maxVertex; ++vertex)
+		{
+			const uint8_t* source = draw.Vertices + vertex * draw.VertexStride;
+			float position[4];
+			ReadVertexElement(source + draw.PositionOffset, draw.PositionFormat, position);
+			position[0] = position[0] * draw.PositionQuantization.Scale.X + draw.PositionQuantization.Offset.X;
+			position[1] = position[1] * draw.PositionQuantization.Scale.Y + draw.PositionQuantization.Offset.Y;
+			position[2] = position[2] * draw.PositionQuantization.Scale.Z + draw.PositionQuantization.Offset.Z;
+
+			FClipVertex& transformed = chunk.TransformedVertices[static_cast<size_t>(vertex - minVertex)];
+			for (int column = 0; column < 4; ++column)
+			{
+				transformed.Position[column] = position[0] * matrix[column] + position[1] * matrix[4 + column] + position[2] * matrix[8 + column] + matrix[12 + column];
+			}
+
+			float colour[4];
+			ReadVertexElement(source + draw.ColourOffset, draw.ColourFormat, colour);
+			std::copy(colour, colour + 3, transformed.Colour);
+		}
+
+		const float guardBandX = GuardBandPixels * 2.0f / draw.Viewport.Width;
+		const float guardBandY = GuardBandPixels * 2.0f / draw.Viewport.Height;
+		const bool depthClip = draw.Rasterizer.DepthClipEnable;
+
+		// Signed distances to the clip planes, a vertex is inside when all of them are positive.
+		const int planeCount = 7;
+		auto planeDistance = [guardBandX, guardBandY](const FClipVertex& vertex, int plane) -> float
+		{
+			const float* p = vertex.Position;
+
+			switch (plane)
+			{
+				case 0: return p[3] - 1e-5f;
+				case 1: return p[0] + guardBandX * p[3];
+				case 2: return guardBandX * p[3] - p[0];
+				case 3: return p[1] + guardBandY * p[3];
+				case 4: return guardBandY * p[3] - p[1];
+				case 5: return p[2];
+				default: return p[3] - p[2];
+			}
+		};
+
+		auto outCode = [&](const FClipVertex& vertex) -> uint32_t
+		{
+			uint32_t code = 0;
+			for (int plane = 0; plane < (depthClip ? planeCount : planeCount - 2); ++plane)
+			{
+				if (planeDistance(vertex, plane) < 0.0f)
+				{
+					code |= 1u << plane;
+				}
+			}
+
+			return code;
+		};
+
+		for (uint32_t i = 0; i + 2 < draw.IndexCount; i += 3)
+		{
+			++chunk.Stats.TrianglesSubmitted;
+
+			const FClipVertex& vertex0 = chunk.TransformedVertices[static_cast<size_t>(fetchIndex(i) - minVertex)];
+			const FClipVertex& vertex1 = chunk.TransformedVertices[static_cast<size_t>(fetchIndex(i + 1) - minVertex)];
+			const FClipVertex& vertex2 = chunk.TransformedVertices[static_cast<size_t>(fetchIndex(i + 2) - minVertex)];
+
+			uint32_t code0 = outCode(vertex0);
+			uint32_t code1 = outCode(vertex1);
+			uint32_t code2 = outCode(vertex2);
+
+			if ((code0 | code1 | code2) == 0)
+			{
+				SetupTriangle(chunk, drawIndex, vertex0, vertex1, vertex2);
+				continue;
+			}
+
+			if ((code0 & code1 & code2) != 0)
+			{
+				++chunk.Stats.TrianglesCulled;
+				continue;
+			}
+
+			// Sutherland-Hodgman against every plane the triangle crosses.
+			++chunk.Stats.TrianglesClipped;
+
+			FClipVertex polygons[2][3 + planeCount];
+			int vertexCount = 3;
+			polygons[0][0] = vertex0;
+			polygons[0][1] = vertex1;
+			polygons[0][2] = vertex2;
+
+			uint32_t crossedPlanes = code0 | code1 | code2;
+			int current = 0;
+
+			for (int plane = 0; plane < planeCount && vertexCount >= 3; ++plane)
+			{
+				if ((crossedPlanes & (1u << plane)) == 0)
+				{
+					continue;
+				}
+
+				const FClipVertex* input = polygons[current];
+				FClipVertex* output = polygons[current ^ 1];
+				int outputCount = 0;
+
+				for (int v = 0; v < vertexCount; ++v)
+				{
+					const FClipVertex& start = input[v];
+					const FClipVertex& end = input[(v + 1) % vertexCount];
+					float startDistance = planeDistance(start, plane);
+					float endDistance = planeDistance(end, plane);
+
+					if (startDistance >= 0.0f)
+					{
+						output[outputCount++] = start;
+					}
+
+					if ((startDistance >= 0.0f) != (endDistance >= 0.0f))
+					{
+						float t = startDistance / (startDistance - endDistance);
+						FClipVertex& clipped = output[outputCount++];
+
+						for (int c = 0; c < 4; ++c)
+						{
+							clipped.Position[c] = start.Position[c] + (end.Position[c] - start.Position[c]) * t;
+						}
+
+						for (int c = 0; c < 3; ++c)
+						{
+							clipped.Colour[c] = start.Colour[c] + (end.Colour[c] - start.Colour[c]) * t;
+						}
+					}
+				}
+
+				vertexCount = outputCount;
+				current ^= 1;
+			}
+
+			for (int v = 1; v + 1 < vertexCount; ++v)
+			{
+				SetupTriangle(chunk, drawIndex, polygons[current][0], polygons[current][v], polygons[current][v + 1]);
+			}
+		}
+	}
+}
+
+void FSoftwareRenderDevice::SetupTriangle(FBinningChunk& chunk, uint32_t drawIndex, const FClipVertex& vertex0, const FClipVertex& vertex1, const FClipVertex& vertex2)
+{
+	const FDraw& draw = Draws[drawIndex];
+	const FViewport& viewport = draw.Viewport;
+	const FClipVertex* vertices[3] = { &vertex0, &vertex1, &vertex2 };
+
+	float x[3];
+	float y[3];
+	float z[3];
+	float inverseW[3];
+
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* position = vertices[i]->Position;
+		inverseW[i] = 1.0f / position[3];
+
+		float screenX = viewport.TopLeftX + (position[0] * inverseW[i] + 1.0f) * 0.5f * viewport.Width;
+		float screenY = viewport.TopLeftY + (1.0f - position[1] * inverseW[i]) * 0.5f * viewport.Height;
+
+		x[i] = std::floor(screenX * SubPixelScale + 0.5f) * InverseSubPixelScale;
+		y[i] = std::floor(screenY * SubPixelScale + 0.5f) * InverseSubPixelScale;
+		z[i] = viewport.MinDepth + position[2] * inverseW[i] * (viewport.MaxDepth - viewport.MinDepth);
+	}
+
+	// Positive when the triangle is clockwise on screen.
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	bool frontFacing = draw.Rasterizer.FrontCounterClockwise ? area < 0.0f : area > 0.0f;
+
+	if (area == 0.0f ||
+		(draw.Rasterizer.CullMode == ECullMode::Back && !frontFacing) ||
+		(draw.Rasterizer.CullMode == ECullMode::Front && frontFacing))
+	{
+		++chunk.Stats.TrianglesCulled;
+		return;
+	}
+
+	// Reorder to clockwise so that the inside of every edge is positive.
+	int order[3] = { 0, 1, 2 };
+	if (area < 0.0f)
+	{
+		std::swap(order[1], order[2]);
+		area = -area;
+	}
+
+	// Pixel centres are at half integer positions.
+	int32_t scissorMinX = std::max(0, static_cast<int32_t>(std::floor(viewport.TopLeftX)));
+	int32_t scissorMinY = std::max(0, static_cast<int32_t>(std::floor(viewport.TopLeftY)));
+	int32_t scissorMaxX = std::min(static_cast<int32_t>(Width) - 1, static_cast<int32_t>(std::ceil(viewport.TopLeftX + viewport.Width)) - 1);
+	int32_t scissorMaxY = std::min(static_cast<int32_t>(Height) - 1, static_cast<int32_t>(std::ceil(viewport.TopLeftY + viewport.Height)) - 1);
+
+	FSetupTriangle triangle;
+	triangle.MinX = std::max(scissorMinX, static_cast<int32_t>(std::ceil(std::min(std::min(x[0], x[1]), x[2]) - 0.5f)));
+	triangle.MinY = std::max(scissorMinY, static_cast<int32_t>(std::ceil(std::min(std::min(y[0], y[1]), y[2]) - 0.5f)));
+	triangle.MaxX = std::min(scissorMaxX, static_cast<int32_t>(std::floor(std::max(std::max(x[0], x[1]), x[2]) - 0.5f)));
+	triangle.MaxY = std::min(scissorMaxY, static_cast<int32_t>(std::floor(std::max(std::max(y[0], y[1]), y[2]) - 0.5f)));
+
+	if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+	{
+		++chunk.Stats.TrianglesCulled;
+		return;
+	}
+
+	triangle.InverseArea = 1.0f / area;
+	triangle.DrawIndex = drawIndex;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		int vertex = order[i];
+		triangle.Depth[i] = z[vertex];
+		triangle.InverseW[i] = inverseW[vertex];
+
+		for (int c = 0; c < 3; ++c)
+		{
+			triangle.ColourOverW[i][c] = vertices[vertex]->Colour[c] * inverseW[vertex];
+		}
+	}
+
+	for (int edge = 0; edge < 3; ++edge)
+	{
+		int start = order[(edge + 1) % 3];
+		int end = order[(edge + 2) % 3];
+
+		// Top edges are horizontal and go right, left edges go up (clockwise, y pointing down).
+		float deltaX = x[end] - x[start];
+		float deltaY = y[end] - y[start];
+		triangle.EdgeTopLeft[edge] = (deltaY == 0.0f && deltaX > 0.0f) || deltaY < 0.0f;
+
+		bool canonical = y[start] < y[end] || (y[start] == y[end] && x[start] < x[end]);
+		int origin = canonical ? start : end;
+		int other = canonical ? end : start;
+
+		triangle.EdgeOriginX[edge] = x[origin];
+		triangle.EdgeOriginY[edge] = y[origin];
+		triangle.EdgeDeltaX[edge] = x[other] - x[origin];
+		triangle.EdgeDeltaY[edge] = y[other] - y[origin];
+		triangle.EdgeSign[edge] = canonical ? 1.0f : -1.0f;
+	}
+
+	uint32_t triangleIndex = static_cast<uint32_t>(chunk.Triangles.size());
+	chunk.Triangles.push_back(triangle);
+	++chunk.Stats.TrianglesRasterized;
+
+	for (int32_t tileY = triangle.MinY / static_cast<int32_t>(TileSize); tileY <= triangle.MaxY / static_cast<int32_t>(TileSize); ++tileY)
+	{
+		for (int32_t tileX = triangle.MinX / static_cast<int32_t>(TileSize); tileX <= triangle.MaxX / static_cast<int32_t>(TileSize); ++tileX)
+		{
+			chunk.TileBins[tileY * TilesX + tileX].push_back(triangleIndex);
+		}
+	}
+}
+
+uint64_t FSoftwareRenderDevice::RasterizeTile(uint32_t tileIndex)
+{
+	int32_t tileMinX = static_cast<int32_t>((tileIndex % TilesX) * TileSize);
+	int32_t tileMinY = static_cast<int32_t>((tileIndex / TilesX) * TileSize);
+	int32_t tileMaxX = std::min(tileMinX + static_cast<int32_t>(TileSize), static_cast<int32_t>(Width)) - 1;
+	int32_t tileMaxY = std::min(tileMinY + static_cast<int32_t>(TileSize), static_cast<int32_t>(Height)) - 1;
+
+	uint64_t pixelsWritten = 0;
+
+	// Chunks hold consecutive draws, so walking them in order keeps the submission order.
+	for (uint32_t chunkIndex = 0; chunkIndex < ActiveChunks; ++chunkIndex)
+	{
+		const FBinningChunk& chunk = *Chunks[chunkIndex];
+
+		for (uint32_t triangleIndex : chunk.TileBins[tileIndex])
+		{
+			pixelsWritten += RasterizeTriangle(chunk.Triangles[triangleIndex], tileMinX, tileMinY, tileMaxX, tileMaxY);
+		}
+	}
+
+	return pixelsWritten;
+}
+
+uint64_t FSoftwareRenderDevice::RasterizeTriangle(const FSetupTriangle& triangle, int32_t tileMinX, int32_t tileMinY, int32_t tileMaxX, int32_t tileMaxY)
+{
+	const FDraw& draw = Draws[triangle.DrawIndex];
+	const bool depthEnable = draw.DepthStencil.DepthEnable;
+	const bool depthWrite = depthEnable && draw.DepthStencil.DepthWriteEnable;
+	const EComparisonFunc depthFunc = depthEnable ? draw.DepthStencil.DepthFunc : EComparisonFunc::Always;
+
+	const int32_t minX = std::max(triangle.MinX, tileMinX);
+	const int32_t minY = std::max(triangle.MinY, tileMinY);
+	const int32_t maxX = std::min(triangle.MaxX, tileMaxX);
+	const int32_t maxY = std::min(triangle.MaxY, tileMaxY);
+	const uint32_t pitch = GetPitch();
+
+	uint64_t pixelsWritten = 0;
+
+#if MORPHEUS_SOFTWARE_RASTERIZER_SSE
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128i laneIndices = _mm_set_epi32(3, 2, 1, 0);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 inverseArea = _mm_set1_ps(triangle.InverseArea);
+	const __m128i depthMask = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i alphaBits = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+	__m128 edgeOriginX[3];
+	__m128 edgeDeltaY[3];
+	__m128 edgeSign[3];
+	__m128 edgeTopLeft[3];
+
+	for (int edge = 0; edge < 3; ++edge)
+	{
+		edgeOriginX[edge] = _mm_set1_ps(triangle.EdgeOriginX[edge]);
+		edgeDeltaY[edge] = _mm_set1_ps(triangle.EdgeDeltaY[edge]);
+		edgeSign[edge] = _mm_set1_ps(triangle.EdgeSign[edge]);
+		edgeTopLeft[edge] = _mm_castsi128_ps(_mm_set1_epi32(triangle.EdgeTopLeft[edge] ? -1 : 0));
+	}
+
+	// Groups of four pixels start on a multiple of four so they never cross a tile or a row.
+	const int32_t startX = minX & ~3;
+
+	for (int32_t y = minY; y <= maxY; ++y)
+	{
+		const float pixelY = static_cast<float>(y) + 0.5f;
+		__m128 rowTerm[3];
+
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			rowTerm[edge] = _mm_set1_ps(triangle.EdgeDeltaX[edge] * (pixelY - triangle.EdgeOriginY[edge]));
+		}
+
+		uint32_t* colourRow = ColourBuffer.data() + y * pitch;
+		uint32_t* depthRow = DepthBuffer.data() + y * pitch;
+
+		for (int32_t x = startX; x <= maxX; x += 4)
+		{
+			__m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+
+			__m128i lanes = _mm_add_epi32(_mm_set1_epi32(x), laneIndices);
+			__m128i inRange = _mm_andnot_si128(_mm_cmplt_epi32(lanes, _mm_set1_epi32(minX)), _mm_cmplt_epi32(lanes, _mm_set1_epi32(maxX + 1)));
+			__m128 coverage = _mm_castsi128_ps(inRange);
+
+			__m128 edgeValue[3];
+			for (int edge = 0; edge < 3; ++edge)
+			{
+				edgeValue[edge] = _mm_mul_ps(edgeSign[edge], _mm_sub_ps(rowTerm[edge], _mm_mul_ps(edgeDeltaY[edge], _mm_sub_ps(pixelX, edgeOriginX[edge]))));
+
+				__m128 inside = _mm_or_ps(_mm_cmpgt_ps(edgeValue[edge], zero), _mm_and_ps(_mm_cmpeq_ps(edgeValue[edge], zero), edgeTopLeft[edge]));
+				coverage = _mm_and_ps(coverage, inside);
+			}
+
+			if (_mm_movemask_ps(coverage) == 0)
+			{
+				continue;
+			}
+
+			__m128 weight0 = _mm_mul_ps(edgeValue[0], inverseArea);
+			__m128 weight1 = _mm_mul_ps(edgeValue[1], inverseArea);
+			__m128 weight2 = _mm_mul_ps(edgeValue[2], inverseArea);
+
+			__m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(weight0, _mm_set1_ps(triangle.Depth[0])), _mm_mul_ps(weight1, _mm_set1_ps(triangle.Depth[1]))), _mm_mul_ps(weight2, _mm_set1_ps(triangle.Depth[2])));
+			depth = _mm_min_ps(_mm_max_ps(depth, zero), one);
+			__m128i newDepth = _mm_cvtps_epi32(_mm_mul_ps(depth, _mm_set1_ps(MaxDepth24)));
+
+			__m128i oldDepthStencil = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depthRow + x));
+			__m128i mask = _mm_and_si128(_mm_castps_si128(coverage), DepthTestMask(depthFunc, newDepth, _mm_and_si128(oldDepthStencil, depthMask)));
+
+			int laneMask = _mm_movemask_ps(_mm_castsi128_ps(mask));
+			if (laneMask == 0)
+			{
+				continue;
+			}
+
+			if (depthWrite)
+			{
+				__m128i newDepthStencil = _mm_or_si128(_mm_andnot_si128(depthMask, oldDepthStencil), newDepth);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(depthRow + x), _mm_or_si128(_mm_and_si128(mask, newDepthStencil), _mm_andnot_si128(mask, oldDepthStencil)));
+			}
+
+			__m128 inverseW = _mm_add_ps(_mm_add_ps(_mm_mul_ps(weight0, _mm_set1_ps(triangle.InverseW[0])), _mm_mul_ps(weight1, _mm_set1_ps(triangle.InverseW[1]))), _mm_mul_ps(weight2, _mm_set1_ps(triangle.InverseW[2])));
+			__m128 w = _mm_div_ps(one, inverseW);
+
+			__m128i packed = alphaBits;
+			for (int c = 0; c < 3; ++c)
+			{
+				__m128 colour = _mm_add_ps(_mm_add_ps(_mm_mul_ps(weight0, _mm_set1_ps(triangle.ColourOverW[0][c])), _mm_mul_ps(weight1, _mm_set1_ps(triangle.ColourOverW[1][c]))), _mm_mul_ps(weight2, _mm_set1_ps(triangle.ColourOverW[2][c])));
+				colour = _mm_min_ps(_mm_max_ps(_mm_mul_ps(colour, w), zero), one);
+
+				__m128i channel = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(colour, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+				packed = _mm_or_si128(packed, _mm_slli_epi32(channel, c * 8));
+			}
+
+			__m128i oldColour = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colourRow + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(colourRow + x), _mm_or_si128(_mm_and_si128(mask, packed), _mm_andnot_si128(mask, oldColour)));
+
+			pixelsWritten += PopulationCount4(laneMask);
+		}
+	}
+#else
+	for (int32_t y = minY; y <= maxY; ++y)
+	{
+		const float pixelY = static_cast<float>(y) + 0.5f;
+		float rowTerm[3];
+
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			rowTerm[edge] = triangle.EdgeDeltaX[edge] * (pixelY - triangle.EdgeOriginY[edge]);
+		}
+
+		uint32_t* colourRow = ColourBuffer.data() + y * pitch;
+		uint32_t* depthRow = DepthBuffer.data() + y * pitch;
+
+		for (int32_t x = minX; x <= maxX; ++x)
+		{
+			const float pixelX = static_cast<float>(x) + 0.5f;
+			float edgeValue[3];
+			bool covered = true;
+
+			for (int edge = 0; edge < 3; ++edge)
+			{
+				edgeValue[edge] = triangle.EdgeSign[edge] * (rowTerm[edge] - triangle.EdgeDeltaY[edge] * (pixelX - triangle.EdgeOriginX[edge]));
+				covered = covered && (edgeValue[edge] > 0.0f || (edgeValue[edge] == 0.0f && triangle.EdgeTopLeft[edge]));
+			}
+
+			if (!covered)
+			{
+				continue;
+			}
+
+			float weight[3] = { edgeValue[0] * triangle.InverseArea, edgeValue[1] * triangle.InverseArea, edgeValue[2] * triangle.InverseArea };
+
+			float depth = weight[0] * triangle.Depth[0] + weight[1] * triangle.Depth[1] + weight[2] * triangle.Depth[2];
+			uint32_t newDepth = QuantizeDepth(depth);
+			uint32_t oldDepthStencil = depthRow[x];
+
+			if (!PassesDepthTest(depthFunc, newDepth, oldDepthStencil & 0x00FFFFFF))
+			{
+				continue;
+			}
+
+			if (depthWrite)
+			{
+				depthRow[x] = (oldDepthStencil & 0xFF000000) | newDepth;
+			}
+
+			float inverseW = weight[0] * triangle.InverseW[0] + weight[1] * triangle.InverseW[1] + weight[2] * triangle.InverseW[2];
+			float colour[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+			for (int c = 0; c < 3; ++c)
+			{
+				colour[c] = (weight[0] * triangle.ColourOverW[0][c] + weight[1] * triangle.ColourOverW[1][c] + weight[2] * triangle.ColourOverW[2][c]) / inverseW;
+			}
+
+			colourRow[x] = PackColour(colour);
+			++pixelsWritten;
+		}
+	}
+#endif
+
+	return pixelsWritten;
+}
+
+void FSoftwareRenderDevice::ClearTile(uint32_t tileIndex)
+{
+	uint32_t tileMinX = (tileIndex % TilesX) * TileSize;
+	uint32_t tileMinY = (tileIndex / TilesX) * TileSize;
+	uint32_t tileMaxX = std::min(tileMinX + TileSize, Width);
+	uint32_t tileMaxY = std::min(tileMinY + TileSize, Height);
+	const uint32_t pitch = GetPitch();
+
+	for (uint32_t y = tileMinY; y < tileMaxY; ++y)
+	{
+		std::fill(ColourBuffer.begin() + y * pitch + tileMinX, ColourBuffer.begin() + y * pitch + tileMaxX, PendingClearColour);
+		std::fill(DepthBuffer.begin() + y * pitch + tileMinX, DepthBuffer.begin() + y * pitch + tileMaxX, PendingClearDepthStencil);
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "NullRenderDevice.h"
+#include "VertexFormat.h"
+
+#include <memory>
+
+// Counters of the software rasterizer, gathered between two calls to Present().
+struct FSoftwareRasterizerStats
+{
+	uint64_t TrianglesSubmitted = 0;
+	uint64_t TrianglesCulled = 0;
+	uint64_t TrianglesClipped = 0;
+	uint64_t TrianglesRasterized = 0;
+	uint64_t PixelsWritten = 0;
+	uint64_t SkippedDraws = 0;
+};
+
+// CPU reference implementation of the engine's pipeline. It executes what SimpleVertexShader.hlsl,
+// InstancedVertexShader.hlsl and SimplePixelShader.hlsl describe: the PerApplication/PerFrame/PerObject
+// matrix chain or per-instance world transforms, back face culling, depth testing into a D24S8 buffer
+// and an R8G8B8A8_UNORM colour target. Blend states are accepted but every draw is written opaque, as
+// the engine's shaders are. Other render targets can be created and bound, but every draw lands in
+// the one colour and depth buffer of the size the device was created with.
+//
+// Draws are deferred until the end of the frame. Triangles are then set up in parallel, binned into
+// screen-space tiles and every tile is rasterized by one job with SIMD edge functions.
+class FSoftwareRenderDevice : public FNullRenderDevice
+{
+public:
+	static const uint32_t TileSize = 64;
+
+	// Without a job system the device starts its own with one worker per hardware thread.
+	FSoftwareRenderDevice(uint32_t width, uint32_t height, FJobSystem* jobSystem = nullptr);
+	~FSoftwareRenderDevice() override;
+
+	// The debug name must be the source file, SimpleVertexShader.hlsl or InstancedVertexShader.hlsl.
+	// Draws with any other vertex shader are skipped.
+	FVertexShaderHandle CreateVertexShader(const FShaderBytecode& bytecode) override;
+
+	void UpdateBuffer(FBufferHandle buffer, const void* data, uint32_t size) override;
+	void* MapBuffer(FBufferHandle buffer, EMapMode mode) override;
+
+	// Only succeeds for the size the device already has.
+	bool ResizeBackBuffer(uint32_t width, uint32_t height) override;
+
+	void Clear(const float clearColour[4], float clearDepth, uint8_t clearStencil) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+	void Present(bool vSync) override;
+
+	// Executes every draw recorded so far.
+	void Flush();
+
+	uint32_t GetWidth() const;
+	uint32_t GetHeight() const;
+	// Distance in texels between two rows of the colour and depth buffers.
+	uint32_t GetPitch() const;
+
+	// R8G8B8A8_UNORM pixels, row major.
+	const uint32_t* GetColourBuffer() const;
+	// D24_UNORM_S8_UINT texels, depth in the low 24 bits and stencil in the high 8 bits.
+	const uint32_t* GetDepthBuffer() const;
+
+	// Writes the colour buffer as a binary PPM image, used for golden image comparisons.
+	bool WriteColourBuffer(const char* fileName) const;
+
+	const FSoftwareRasterizerStats& GetRasterizerStats() const;
+	const FSoftwareRasterizerStats& GetLastFrameRasterizerStats() const;
+
+private:
+	enum class EVertexProgram : uint8_t
+	{
+		Unsupported,
+		Simple,
+		Instanced
+	};
+
+	struct FDraw
+	{
+		float ModelViewProjection[16];
+		const uint8_t* Vertices;
+		uint32_t VertexStride;
+		uint32_t VertexCount;
+		uint32_t PositionOffset;
+		uint32_t ColourOffset;
+		EVertexFormat PositionFormat;
+		EVertexFormat ColourFormat;
+		// From the PerObject constants, applied to the positions as they are read.
+		FPositionQuantization PositionQuantization;
+		const uint8_t* Indices;
+		EIndexFormat IndexFormat;
+		uint32_t IndexCount;
+		int32_t BaseVertex;
+		FRasterizerDesc Rasterizer;
+		FDepthStencilDesc DepthStencil;
+		FViewport Viewport;
+	};
+
+	struct FSetupTriangle;
+	struct FBinningChunk;
+	struct FClipVertex;
+
+	// Unsupported while no vertex shader or a stale one is bound.
+	EVertexProgram GetBoundVertexProgram() const;
+	void SubmitDraw(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+	bool CaptureDraw(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex, FDraw& draw);
+	// Appends one draw per instance with the world matrix read from the per-instance stream.
+	bool CaptureInstances(const FDraw& draw, uint32_t instanceCount, uint32_t startInstance);
+	void SetupDraws(FBinningChunk& chunk, uint32_t firstDraw, uint32_t lastDraw);
+	void SetupTriangle(FBinningChunk& chunk, uint32_t drawIndex, const FClipVertex& vertex0, const FClipVertex& vertex1, const FClipVertex& vertex2);
+	// Returns the number of pixels written.
+	uint64_t RasterizeTile(uint32_t tileIndex);
+	uint64_t RasterizeTriangle(const FSetupTriangle& triangle, int32_t tileMinX, int32_t tileMinY, int32_t tileMaxX, int32_t tileMaxY);
+	void ClearTile(uint32_t tileIndex);
+
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t TilesX;
+	uint32_t TilesY;
+
+	std::vector<uint32_t> ColourBuffer;
+	std::vector<uint32_t> DepthBuffer;
+
+	std::vector<FDraw> Draws;
+	std::vector<FBinningChunk*> Chunks;
+	uint32_t ActiveChunks;
+	std::vector<uint64_t> TilePixelsWritten;
+
+	bool ClearPending;
+	uint32_t PendingClearColour;
+	uint32_t PendingClearDepthStencil;
+
+	FSoftwareRasterizerStats RasterizerStats;
+	FSoftwareRasterizerStats LastFrameRasterizerStats;
+
+	std::unique_ptr<FJobSystem> OwnedJobSystem;
+	FJobSystem* JobSystem;
+};
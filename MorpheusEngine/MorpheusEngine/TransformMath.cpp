@@ -0,0 +1,353 @@
+#include "TransformMath.h"
+
+#include <cassert>
+#include <cmath>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#include "TransformMathKernels.h"
+
+#if MORPHEUS_MATH_SSE
+#include <emmintrin.h>
+#include <xmmintrin.h>
+
+// Defined in TransformMathAVX2.cpp, which is compiled for AVX2 and FMA.
+uint32_t ComposeTransformsAVX2(const FTransformStreams& transforms, uint32_t begin, uint32_t end, uint32_t outputBase,
+	const FFloat4x4* viewProjection, FFloat4x4* worldMatrices, FFloat4x4* modelViewProjections);
+#elif MORPHEUS_MATH_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+#if MORPHEUS_MATH_SSE
+	struct FVectorSSE
+	{
+		typedef __m128 FRegister;
+		static const uint32_t Width = 4;
+
+		static FRegister Load(const float* source) { return _mm_loadu_ps(source); }
+		static FRegister Set(float value) { return _mm_set1_ps(value); }
+		static FRegister Add(FRegister a, FRegister b) { return _mm_add_ps(a, b); }
+		static FRegister Subtract(FRegister a, FRegister b) { return _mm_sub_ps(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return _mm_mul_ps(a, b); }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+		// Every group of four elements is one row of four matrices.
+		static void StoreMatrices(const FRegister (&elements)[16], FFloat4x4* matrices)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				FRegister lane0 = elements[row * 4 + 0];
+				FRegister lane1 = elements[row * 4 + 1];
+				FRegister lane2 = elements[row * 4 + 2];
+				FRegister lane3 = elements[row * 4 + 3];
+				_MM_TRANSPOSE4_PS(lane0, lane1, lane2, lane3);
+
+				_mm_storeu_ps(matrices[0].M[row], lane0);
+				_mm_storeu_ps(matrices[1].M[row], lane1);
+				_mm_storeu_ps(matrices[2].M[row], lane2);
+				_mm_storeu_ps(matrices[3].M[row], lane3);
+			}
+		}
+	};
+#elif MORPHEUS_MATH_NEON
+	struct FVectorNEON
+	{
+		typedef float32x4_t FRegister;
+		static const uint32_t Width = 4;
+
+		static FRegister Load(const float* source) { return vld1q_f32(source); }
+		static FRegister Set(float value) { return vdupq_n_f32(value); }
+		static FRegister Add(FRegister a, FRegister b) { return vaddq_f32(a, b); }
+		static FRegister Subtract(FRegister a, FRegister b) { return vsubq_f32(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return vmulq_f32(a, b); }
+#if defined(__aarch64__) || defined(_M_ARM64)
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return vfmaq_f32(c, a, b); }
+#else
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return vmlaq_f32(c, a, b); }
+#endif
+
+		static void StoreMatrices(const FRegister (&elements)[16], FFloat4x4* matrices)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				float32x4x2_t low = vtrnq_f32(elements[row * 4 + 0], elements[row * 4 + 1]);
+				float32x4x2_t high = vtrnq_f32(elements[row * 4 + 2], elements[row * 4 + 3]);
+
+				vst1q_f32(matrices[0].M[row], vcombine_f32(vget_low_f32(low.val[0]), vget_low_f32(high.val[0])));
+				vst1q_f32(matrices[1].M[row], vcombine_f32(vget_low_f32(low.val[1]), vget_low_f32(high.val[1])));
+				vst1q_f32(matrices[2].M[row], vcombine_f32(vget_high_f32(low.val[0]), vget_high_f32(high.val[0])));
+				vst1q_f32(matrices[3].M[row], vcombine_f32(vget_high_f32(low.val[1]), vget_high_f32(high.val[1])));
+			}
+		}
+	};
+#endif
+
+	bool CpuSupportsAVX2()
+	{
+#if MORPHEUS_MATH_SSE && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		// The OS has to save the YMM registers too, which XGETBV reports.
+		__cpuid(info, 1);
+		const int fma = 1 << 12;
+		const int osxsave = 1 << 27;
+		const int avx = 1 << 28;
+		if ((info[2] & (fma | osxsave | avx)) != (fma | osxsave | avx) || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif MORPHEUS_MATH_SSE && defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		return false;
+#endif
+	}
+
+	EMathBackend& SelectedBackend()
+	{
+		static EMathBackend backend = GetBestMathBackend();
+
+		return backend;
+	}
+
+	FTransformStreams GetStreams(const FTransformSoA& transforms)
+	{
+		FTransformStreams streams;
+		streams.PositionX = transforms.PositionX.data();
+		streams.PositionY = transforms.PositionY.data();
+		streams.PositionZ = transforms.PositionZ.data();
+		streams.RotationX = transforms.RotationX.data();
+		streams.RotationY = transforms.RotationY.data();
+		streams.RotationZ = transforms.RotationZ.data();
+		streams.RotationW = transforms.RotationW.data();
+		streams.ScaleX = transforms.ScaleX.data();
+		streams.ScaleY = transforms.ScaleY.data();
+		streams.ScaleZ = transforms.ScaleZ.data();
+
+		return streams;
+	}
+
+	void Compose(const FTransformSoA& transforms, uint32_t begin, uint32_t end, uint32_t outputBase, const FFloat4x4* viewProjection,
+		FFloat4x4* worldMatrices, FFloat4x4* modelViewProjections)
+	{
+		assert(begin <= end && end <= transforms.GetCount());
+
+		FTransformStreams streams = GetStreams(transforms);
+		uint32_t index = begin;
+
+		switch (GetMathBackend())
+		{
+#if MORPHEUS_MATH_SSE
+		case EMathBackend::AVX2:
+			index = ComposeTransformsAVX2(streams, index, end, outputBase, viewProjection, worldMatrices, modelViewProjections);
+			break;
+		case EMathBackend::SSE:
+			index = ComposeTransforms<FVectorSSE>(streams, index, end, outputBase, viewProjection, worldMatrices, modelViewProjections);
+			break;
+#elif MORPHEUS_MATH_NEON
+		case EMathBackend::NEON:
+			index = ComposeTransforms<FVectorNEON>(streams, index, end, outputBase, viewProjection, worldMatrices, modelViewProjections);
+			break;
+#endif
+		default:
+			break;
+		}
+
+		ComposeTransforms<FVectorScalar>(streams, index, end, outputBase, viewProjection, worldMatrices, modelViewProjections);
+	}
+}
+
+void FTransformSoA::Resize(uint32_t count)
+{
+	PositionX.resize(count, 0.0f);
+	PositionY.resize(count, 0.0f);
+	PositionZ.resize(count, 0.0f);
+	RotationX.resize(count, 0.0f);
+	RotationY.resize(count, 0.0f);
+	RotationZ.resize(count, 0.0f);
+	RotationW.resize(count, 1.0f);
+	ScaleX.resize(count, 1.0f);
+	ScaleY.resize(count, 1.0f);
+	ScaleZ.resize(count, 1.0f);
+}
+
+uint32_t FTransformSoA::GetCount() const
+{
+	return static_cast<uint32_t>(PositionX.size());
+}
+
+void FTransformSoA::Set(uint32_t index, const FFloat3& position, const FQuaternion& rotation, const FFloat3& scale)
+{
+	assert(index < GetCount());
+
+	PositionX[index] = position.X;
+	PositionY[index] = position.Y;
+	PositionZ[index] = position.Z;
+	RotationX[index] = rotation.X;
+	RotationY[index] = rotation.Y;
+	RotationZ[index] = rotation.Z;
+	RotationW[index] = rotation.W;
+	ScaleX[index] = scale.X;
+	ScaleY[index] = scale.Y;
+	ScaleZ[index] = scale.Z;
+}
+
+FFloat3 FTransformSoA::GetPosition(uint32_t index) const
+{
+	return { PositionX[index], PositionY[index], PositionZ[index] };
+}
+
+FQuaternion FTransformSoA::GetRotation(uint32_t index) const
+{
+	return { RotationX[index], RotationY[index], RotationZ[index], RotationW[index] };
+}
+
+FFloat3 FTransformSoA::GetScale(uint32_t index) const
+{
+	return { ScaleX[index], ScaleY[index], ScaleZ[index] };
+}
+
+EMathBackend GetBestMathBackend()
+{
+#if MORPHEUS_MATH_SSE
+	static const EMathBackend bestBackend = CpuSupportsAVX2() ? EMathBackend::AVX2 : EMathBackend::SSE;
+#elif MORPHEUS_MATH_NEON
+	static const EMathBackend bestBackend = EMathBackend::NEON;
+#else
+	static const EMathBackend bestBackend = EMathBackend::Scalar;
+#endif
+
+	return bestBackend;
+}
+
+EMathBackend GetMathBackend()
+{
+	return SelectedBackend();
+}
+
+void SetMathBackend(EMathBackend backend)
+{
+	SelectedBackend() = IsMathBackendSupported(backend) ? backend : GetBestMathBackend();
+}
+
+bool IsMathBackendSupported(EMathBackend backend)
+{
+	switch (backend)
+	{
+	case EMathBackend::Scalar:
+		return true;
+#if MORPHEUS_MATH_SSE
+	case EMathBackend::SSE:
+		return true;
+	case EMathBackend::AVX2:
+		return GetBestMathBackend() == EMathBackend::AVX2;
+#elif MORPHEUS_MATH_NEON
+	case EMathBackend::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* GetMathBackendName(EMathBackend backend)
+{
+	switch (backend)
+	{
+	case EMathBackend::Scalar:
+		return "Scalar";
+	case EMathBackend::SSE:
+		return "SSE";
+	case EMathBackend::AVX2:
+		return "AVX2";
+	case EMathBackend::NEON:
+		return "NEON";
+	default:
+		return "Unknown";
+	}
+}
+
+FFloat4x4 MatrixIdentity()
+{
+	FFloat4x4 result = {};
+	result.M[0][0] = 1.0f;
+	result.M[1][1] = 1.0f;
+	result.M[2][2] = 1.0f;
+	result.M[3][3] = 1.0f;
+
+	return result;
+}
+
+FFloat4x4 MatrixMultiply(const FFloat4x4& a, const FFloat4x4& b)
+{
+	FFloat4x4 result;
+
+	for (int row = 0; row < 4; ++row)
+	{
+		for (int column = 0; column < 4; ++column)
+		{
+			result.M[row][column] =
+				a.M[row][0] * b.M[0][column] +
+				a.M[row][1] * b.M[1][column] +
+				a.M[row][2] * b.M[2][column] +
+				a.M[row][3] * b.M[3][column];
+		}
+	}
+
+	return result;
+}
+
+FFloat4x4 MatrixTransform(const FFloat3& position, const FQuaternion& rotation, const FFloat3& scale)
+{
+	const float* components[10] =
+	{
+		&position.X, &position.Y, &position.Z, &rotation.X, &rotation.Y, &rotation.Z, &rotation.W, &scale.X, &scale.Y, &scale.Z
+	};
+
+	FTransformStreams streams = { components[0], components[1], components[2], components[3], components[4], components[5], components[6], components[7], components[8], components[9] };
+
+	FFloat4x4 result;
+	ComposeTransforms<FVectorScalar>(streams, 0, 1, 0, nullptr, &result, nullptr);
+
+	return result;
+}
+
+FQuaternion QuaternionRotationAxis(const FFloat3& axis, float angle)
+{
+	float length = std::sqrt(axis.X * axis.X + axis.Y * axis.Y + axis.Z * axis.Z);
+	assert(length > 0.0f);
+
+	float scale = std::sin(0.5f * angle) / length;
+
+	return { axis.X * scale, axis.Y * scale, axis.Z * scale, std::cos(0.5f * angle) };
+}
+
+void ComposeWorldMatrices(const FTransformSoA& transforms, uint32_t begin, uint32_t end, FFloat4x4* worldMatrices)
+{
+	Compose(transforms, begin, end, 0, nullptr, worldMatrices, nullptr);
+}
+
+void ComposeMatricesPacked(const FTransformSoA& transforms, uint32_t begin, uint32_t end, FFloat4x4* matrices)
+{
+	Compose(transforms, begin, end, begin, nullptr, matrices, nullptr);
+}
+
+void ComposeModelViewProjections(const FTransformSoA& transforms, uint32_t begin, uint32_t end, const FFloat4x4& viewProjection,
+	FFloat4x4* worldMatrices, FFloat4x4* modelViewProjections)
+{
+	Compose(transforms, begin, end, 0, &viewProjection, worldMatrices, modelViewProjections);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<DirectXMath.h>)
+#include <DirectXMath.h>
+#define MORPHEUS_HAS_DIRECTXMATH 1
+#endif
+#endif
+
+// Same layout as XMFLOAT3.
+struct FFloat3
+{
+	float X;
+	float Y;
+	float Z;
+};
+
+// Same layout as XMFLOAT4, rotations are unit quaternions.
+struct FQuaternion
+{
+	float X;
+	float Y;
+	float Z;
+	float W;
+};
+
+// Same layout as XMFLOAT4X4 and a stored XMMATRIX: row major, row vectors, translation in the last row.
+// Uploading one untransposed matches the column_major packing the shaders use.
+struct FFloat4x4
+{
+	float M[4][4];
+};
+
+// Transforms as structure of arrays, one stream per component, so the kernels below can load 4 or 8
+// objects with one instruction. The world matrix of an entry is scale * rotation * translation.
+struct FTransformSoA
+{
+	std::vector<float> PositionX;
+	std::vector<float> PositionY;
+	std::vector<float> PositionZ;
+	std::vector<float> RotationX;
+	std::vector<float> RotationY;
+	std::vector<float> RotationZ;
+	std::vector<float> RotationW;
+	std::vector<float> ScaleX;
+	std::vector<float> ScaleY;
+	std::vector<float> ScaleZ;
+
+	// New entries are identity transforms.
+	void Resize(uint32_t count);
+	uint32_t GetCount() const;
+
+	void Set(uint32_t index, const FFloat3& position, const FQuaternion& rotation, const FFloat3& scale);
+	FFloat3 GetPosition(uint32_t index) const;
+	FQuaternion GetRotation(uint32_t index) const;
+	FFloat3 GetScale(uint32_t index) const;
+};
+
+enum class EMathBackend : uint8_t
+{
+	Scalar,
+	SSE,
+	AVX2,
+	NEON
+};
+
+// Fastest backend the CPU supports, detected once.
+EMathBackend GetBestMathBackend();
+EMathBackend GetMathBackend();
+// Forces a backend, used to compare them. Backends the CPU lacks fall back to the best supported one.
+void SetMathBackend(EMathBackend backend);
+bool IsMathBackendSupported(EMathBackend backend);
+const char* GetMathBackendName(EMathBackend backend);
+
+FFloat4x4 MatrixIdentity();
+FFloat4x4 MatrixMultiply(const FFloat4x4& a, const FFloat4x4& b);
+// Matrix of a single transform, the scalar reference of the batched kernels.
+FFloat4x4 MatrixTransform(const FFloat3& position, const FQuaternion& rotation, const FFloat3& scale);
+FQuaternion QuaternionRotationAxis(const FFloat3& axis, float angle);
+
+// Writes the world matrix of every transform in [begin, end) to worldMatrices[index].
+void ComposeWorldMatrices(const FTransformSoA& transforms, uint32_t begin, uint32_t end, FFloat4x4* worldMatrices);
+
+// Same as ComposeWorldMatrices, but the matrix of transform begin + i goes to matrices[i]. Used to compose
+// a run of local matrices into a small scratch buffer.
+void ComposeMatricesPacked(const FTransformSoA& transforms, uint32_t begin, uint32_t end, FFloat4x4* matrices);
+
+// Writes world * viewProjection of every transform in [begin, end) to modelViewProjections[index],
+// ready to upload. worldMatrices may be null when only the product is needed.
+void ComposeModelViewProjections(const FTransformSoA& transforms, uint32_t begin, uint32_t end, const FFloat4x4& viewProjection,
+	FFloat4x4* worldMatrices, FFloat4x4* modelViewProjections);
+
+#if MORPHEUS_HAS_DIRECTXMATH
+static_assert(sizeof(FFloat3) == sizeof(DirectX::XMFLOAT3), "FFloat3 must match XMFLOAT3");
+static_assert(sizeof(FQuaternion) == sizeof(DirectX::XMFLOAT4), "FQuaternion must match XMFLOAT4");
+static_assert(sizeof(FFloat4x4) == sizeof(DirectX::XMFLOAT4X4), "FFloat4x4 must match XMFLOAT4X4");
+
+inline const DirectX::XMFLOAT3& AsXMFLOAT3(const FFloat3& value)
+{
+	return reinterpret_cast<const DirectX::XMFLOAT3&>(value);
+}
+
+inline const FFloat3& AsFloat3(const DirectX::XMFLOAT3& value)
+{
+	return reinterpret_cast<const FFloat3&>(value);
+}
+
+inline DirectX::XMMATRIX LoadMatrix(const FFloat4x4& matrix)
+{
+	return DirectX::XMLoadFloat4x4(reinterpret_cast<const DirectX::XMFLOAT4X4*>(&matrix));
+}
+
+inline FFloat4x4 StoreMatrix(DirectX::FXMMATRIX matrix)
+{
+	FFloat4x4 result;
+	DirectX::XMStoreFloat4x4(reinterpret_cast<DirectX::XMFLOAT4X4*>(&result), matrix);
+
+	return result;
+}
+#endif
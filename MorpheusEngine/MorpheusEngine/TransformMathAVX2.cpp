@@ -0,0 +1,100 @@
+#include "TransformMath.h"
+
+#include <immintrin.h>
+
+// Everything defined below is compiled for AVX2 and FMA. Only TransformMath.cpp calls into this unit,
+// and only after checking that the CPU supports both.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "TransformMathKernels.h"
+
+#if MORPHEUS_MATH_SSE
+
+namespace
+{
+	struct FVectorAVX2
+	{
+		typedef __m256 FRegister;
+		static const uint32_t Width = 8;
+
+		static FRegister Load(const float* source) { return _mm256_loadu_ps(source); }
+		static FRegister Set(float value) { return _mm256_set1_ps(value); }
+		static FRegister Add(FRegister a, FRegister b) { return _mm256_add_ps(a, b); }
+		static FRegister Subtract(FRegister a, FRegister b) { return _mm256_sub_ps(a, b); }
+		static FRegister Multiply(FRegister a, FRegister b) { return _mm256_mul_ps(a, b); }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return _mm256_fmadd_ps(a, b, c); }
+
+		// Transposes eight registers so that output k holds lane k of every input.
+		static void Transpose8x8(const FRegister* rows, FRegister* columns)
+		{
+			__m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+			__m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+			__m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+			__m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+			__m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+			__m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+			__m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+			__m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+
+			__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+			__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+			__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+			columns[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+			columns[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+			columns[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+			columns[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+			columns[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+			columns[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+			columns[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+			columns[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+		}
+
+		// Elements 0-7 and 8-15 are each transposed into the top and bottom half of eight matrices.
+		static void StoreMatrices(const FRegister (&elements)[16], FFloat4x4* matrices)
+		{
+			FRegister halves[8];
+
+			Transpose8x8(elements, halves);
+			for (int i = 0; i < 8; ++i)
+			{
+				_mm256_storeu_ps(matrices[i].M[0], halves[i]);
+			}
+
+			Transpose8x8(elements + 8, halves);
+			for (int i = 0; i < 8; ++i)
+			{
+				_mm256_storeu_ps(matrices[i].M[2], halves[i]);
+			}
+		}
+	};
+}
+
+uint32_t ComposeTransformsAVX2(const FTransformStreams& transforms, uint32_t begin, uint32_t end, uint32_t outputBase,
+	const FFloat4x4* viewProjection, FFloat4x4* worldMatrices, FFloat4x4* modelViewProjections)
+{
+	uint32_t index = ComposeTransforms<FVectorAVX2>(transforms, begin, end, outputBase, viewProjection, worldMatrices, modelViewProjections);
+
+	// The callers continue with SSE or scalar code.
+	_mm256_zeroupper();
+
+	return index;
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
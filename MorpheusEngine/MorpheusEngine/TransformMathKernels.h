@@ -0,0 +1,145 @@
+#pragma once
+
+// Private to the TransformMath translation units. Every unit instantiates the kernel with the vector
+// type of its instruction set, so this header must be included after the target pragmas of that unit
+// and must not pull in any other header: inline functions from shared headers compiled for AVX2 could
+// be picked by the linker for code that runs on older CPUs. TransformMath.h has to be included first.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MORPHEUS_MATH_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64) || defined(_M_ARM)
+#define MORPHEUS_MATH_NEON 1
+#endif
+
+// Raw component streams of an FTransformSoA.
+struct FTransformStreams
+{
+	const float* PositionX;
+	const float* PositionY;
+	const float* PositionZ;
+	const float* RotationX;
+	const float* RotationY;
+	const float* RotationZ;
+	const float* RotationW;
+	const float* ScaleX;
+	const float* ScaleY;
+	const float* ScaleZ;
+};
+
+namespace
+{
+	// One float per register, used for the tails of the batches and as the reference result.
+	struct FVectorScalar
+	{
+		typedef float FRegister;
+		static const uint32_t Width = 1;
+
+		static FRegister Load(const float* source) { return *source; }
+		static FRegister Set(float value) { return value; }
+		static FRegister Add(FRegister a, FRegister b) { return a + b; }
+		static FRegister Subtract(FRegister a, FRegister b) { return a - b; }
+		static FRegister Multiply(FRegister a, FRegister b) { return a * b; }
+		static FRegister MultiplyAdd(FRegister a, FRegister b, FRegister c) { return a * b + c; }
+
+		static void StoreMatrices(const FRegister (&elements)[16], FFloat4x4* matrices)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				matrices->M[i / 4][i % 4] = elements[i];
+			}
+		}
+	};
+
+	// Composes Width transforms per iteration, starting at begin, and returns the first index it did not
+	// process. The matrices of transform index go to index - outputBase. Element i of a matrix is held in
+	// elements[i], one object per lane.
+	template<typename TVector>
+	uint32_t ComposeTransforms(const FTransformStreams& transforms, uint32_t begin, uint32_t end, uint32_t outputBase,
+		const FFloat4x4* viewProjection, FFloat4x4* worldMatrices, FFloat4x4* modelViewProjections)
+	{
+		typedef typename TVector::FRegister FRegister;
+
+		const FRegister zero = TVector::Set(0.0f);
+		const FRegister one = TVector::Set(1.0f);
+
+		FRegister viewProjectionElements[16];
+		if (viewProjection)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				viewProjectionElements[i] = TVector::Set(viewProjection->M[i / 4][i % 4]);
+			}
+		}
+
+		uint32_t index = begin;
+		for (; index + TVector::Width <= end; index += TVector::Width)
+		{
+			FRegister x = TVector::Load(transforms.RotationX + index);
+			FRegister y = TVector::Load(transforms.RotationY + index);
+			FRegister z = TVector::Load(transforms.RotationZ + index);
+			FRegister w = TVector::Load(transforms.RotationW + index);
+
+			FRegister x2 = TVector::Add(x, x);
+			FRegister y2 = TVector::Add(y, y);
+			FRegister z2 = TVector::Add(z, z);
+
+			FRegister xx2 = TVector::Multiply(x, x2);
+			FRegister yy2 = TVector::Multiply(y, y2);
+			FRegister zz2 = TVector::Multiply(z, z2);
+			FRegister xy2 = TVector::Multiply(x, y2);
+			FRegister xz2 = TVector::Multiply(x, z2);
+			FRegister yz2 = TVector::Multiply(y, z2);
+			FRegister wx2 = TVector::Multiply(w, x2);
+			FRegister wy2 = TVector::Multiply(w, y2);
+			FRegister wz2 = TVector::Multiply(w, z2);
+
+			FRegister scaleX = TVector::Load(transforms.ScaleX + index);
+			FRegister scaleY = TVector::Load(transforms.ScaleY + index);
+			FRegister scaleZ = TVector::Load(transforms.ScaleZ + index);
+
+			// Scale * rotation * translation, the same matrix XMMatrixAffineTransformation builds.
+			FRegister world[16];
+			world[0] = TVector::Multiply(TVector::Subtract(one, TVector::Add(yy2, zz2)), scaleX);
+			world[1] = TVector::Multiply(TVector::Add(xy2, wz2), scaleX);
+			world[2] = TVector::Multiply(TVector::Subtract(xz2, wy2), scaleX);
+			world[3] = zero;
+			world[4] = TVector::Multiply(TVector::Subtract(xy2, wz2), scaleY);
+			world[5] = TVector::Multiply(TVector::Subtract(one, TVector::Add(xx2, zz2)), scaleY);
+			world[6] = TVector::Multiply(TVector::Add(yz2, wx2), scaleY);
+			world[7] = zero;
+			world[8] = TVector::Multiply(TVector::Add(xz2, wy2), scaleZ);
+			world[9] = TVector::Multiply(TVector::Subtract(yz2, wx2), scaleZ);
+			world[10] = TVector::Multiply(TVector::Subtract(one, TVector::Add(xx2, yy2)), scaleZ);
+			world[11] = zero;
+			world[12] = TVector::Load(transforms.PositionX + index);
+			world[13] = TVector::Load(transforms.PositionY + index);
+			world[14] = TVector::Load(transforms.PositionZ + index);
+			world[15] = one;
+
+			if (worldMatrices)
+			{
+				TVector::StoreMatrices(world, worldMatrices + (index - outputBase));
+			}
+
+			if (modelViewProjections)
+			{
+				// The last column of the world matrix is (0, 0, 0, 1), which saves a quarter of the products.
+				FRegister product[16];
+				for (int row = 0; row < 4; ++row)
+				{
+					for (int column = 0; column < 4; ++column)
+					{
+						FRegister sum = (row == 3) ? viewProjectionElements[12 + column] : zero;
+						sum = TVector::MultiplyAdd(world[row * 4 + 2], viewProjectionElements[8 + column], sum);
+						sum = TVector::MultiplyAdd(world[row * 4 + 1], viewProjectionElements[4 + column], sum);
+						product[row * 4 + column] = TVector::MultiplyAdd(world[row * 4 + 0], viewProjectionElements[column], sum);
+					}
+				}
+
+				TVector::StoreMatrices(product, modelViewProjections + (index - outputBase));
+			}
+		}
+
+		return index;
+	}
+}
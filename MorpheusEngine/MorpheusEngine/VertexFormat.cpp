@@ -0,0 +1,654 @@
+#include "VertexFormat.h"
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MORPHEUS_VERTEX_FORMAT_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const float Snorm16Scale = 32767.0f;
+	const float Unorm8Scale = 255.0f;
+
+	float Clamp(float value, float minimum, float maximum)
+	{
+		return std::min(std::max(value, minimum), maximum);
+	}
+
+	// Round to nearest even, like the SSE conversions with the default rounding mode.
+	int32_t Round(float value)
+	{
+		return static_cast<int32_t>(std::nearbyint(value));
+	}
+
+	FFloat3 LoadFloat3(const uint8_t* source)
+	{
+		FFloat3 value;
+		std::memcpy(&value, source, sizeof(value));
+
+		return value;
+	}
+
+	bool UseSSE()
+	{
+#if MORPHEUS_VERTEX_FORMAT_SSE
+		return GetMathBackend() != EMathBackend::Scalar;
+#else
+		return false;
+#endif
+	}
+
+	FFloat3 GetInverseScale(const FPositionQuantization& quantization)
+	{
+		return { 1.0f / quantization.Scale.X, 1.0f / quantization.Scale.Y, 1.0f / quantization.Scale.Z };
+	}
+
+	void EncodePositionsScalar(const uint8_t* positions, uint32_t positionStride, uint32_t begin, uint32_t end, const FPositionQuantization& quantization,
+		uint8_t* output, uint32_t outputStride)
+	{
+		FFloat3 inverseScale = GetInverseScale(quantization);
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			FFloat3 position = LoadFloat3(positions + size_t(i) * positionStride);
+
+			int16_t packed[4];
+			packed[0] = static_cast<int16_t>(Round(Clamp((position.X - quantization.Offset.X) * inverseScale.X, -1.0f, 1.0f) * Snorm16Scale));
+			packed[1] = static_cast<int16_t>(Round(Clamp((position.Y - quantization.Offset.Y) * inverseScale.Y, -1.0f, 1.0f) * Snorm16Scale));
+			packed[2] = static_cast<int16_t>(Round(Clamp((position.Z - quantization.Offset.Z) * inverseScale.Z, -1.0f, 1.0f) * Snorm16Scale));
+			packed[3] = static_cast<int16_t>(Snorm16Scale);
+			std::memcpy(output + size_t(i) * outputStride, packed, sizeof(packed));
+		}
+	}
+
+	void EncodeColoursScalar(const uint8_t* colours, uint32_t colourStride, bool hasAlpha, uint32_t begin, uint32_t end, uint8_t* output, uint32_t outputStride)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			float colour[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			std::memcpy(colour, colours + size_t(i) * colourStride, hasAlpha ? 16 : 12);
+
+			uint8_t packed[4];
+			for (int channel = 0; channel < 4; ++channel)
+			{
+				packed[channel] = static_cast<uint8_t>(Round(Clamp(colour[channel], 0.0f, 1.0f) * Unorm8Scale));
+			}
+			std::memcpy(output + size_t(i) * outputStride, packed, sizeof(packed));
+		}
+	}
+
+	void EncodeOctahedralNormalsScalar(const uint8_t* normals, uint32_t normalStride, uint32_t begin, uint32_t end, uint8_t* output, uint32_t outputStride)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			FFloat3 normal = LoadFloat3(normals + size_t(i) * normalStride);
+
+			// Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the diagonals.
+			float sum = std::fabs(normal.X) + std::fabs(normal.Y) + std::fabs(normal.Z);
+			if (sum == 0.0f)
+			{
+				normal = { 0.0f, 0.0f, 0.0f };
+				sum = 1.0f;
+			}
+
+			float x = normal.X / sum;
+			float y = normal.Y / sum;
+			if (normal.Z < 0.0f)
+			{
+				float foldedX = std::copysign(1.0f - std::fabs(y), x);
+				float foldedY = std::copysign(1.0f - std::fabs(x), y);
+				x = foldedX;
+				y = foldedY;
+			}
+
+			int16_t packed[2];
+			packed[0] = static_cast<int16_t>(Round(Clamp(x, -1.0f, 1.0f) * Snorm16Scale));
+			packed[1] = static_cast<int16_t>(Round(Clamp(y, -1.0f, 1.0f) * Snorm16Scale));
+			std::memcpy(output + size_t(i) * outputStride, packed, sizeof(packed));
+		}
+	}
+
+#if MORPHEUS_VERTEX_FORMAT_SSE
+	// Attributes are loaded one vertex per register, vertices are strided and rarely aligned, and the
+	// last vertex may end at the end of its buffer, so the loads are per component.
+	__m128 LoadFloat3SSE(const uint8_t* source, float w)
+	{
+		FFloat3 value = LoadFloat3(source);
+
+		return _mm_setr_ps(value.X, value.Y, value.Z, w);
+	}
+
+	__m128 ClampSSE(__m128 value, __m128 minimum, __m128 maximum)
+	{
+		return _mm_min_ps(_mm_max_ps(value, minimum), maximum);
+	}
+
+	void StoreLow64(uint8_t* destination, __m128i value)
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(destination), value);
+	}
+
+	void Store32(uint8_t* destination, __m128i value)
+	{
+		int32_t packed = _mm_cvtsi128_si32(value);
+		std::memcpy(destination, &packed, sizeof(packed));
+	}
+
+	// Two vertices per iteration, so the packing to 16 bits uses the whole register.
+	uint32_t EncodePositionsSSE(const uint8_t* positions, uint32_t positionStride, uint32_t count, const FPositionQuantization& quantization,
+		uint8_t* output, uint32_t outputStride)
+	{
+		FFloat3 inverseScale = GetInverseScale(quantization);
+		const __m128 offset = _mm_setr_ps(quantization.Offset.X, quantization.Offset.Y, quantization.Offset.Z, 0.0f);
+		const __m128 scale = _mm_setr_ps(inverseScale.X, inverseScale.Y, inverseScale.Z, 0.0f);
+		const __m128 minimum = _mm_set1_ps(-1.0f);
+		const __m128 maximum = _mm_set1_ps(1.0f);
+		const __m128 range = _mm_set1_ps(Snorm16Scale);
+		// The zero w of every loaded position turns into one here.
+		const __m128 one = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+		uint32_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			__m128 first = LoadFloat3SSE(positions + size_t(i) * positionStride, 0.0f);
+			__m128 second = LoadFloat3SSE(positions + size_t(i + 1) * positionStride, 0.0f);
+
+			first = _mm_add_ps(ClampSSE(_mm_mul_ps(_mm_sub_ps(first, offset), scale), minimum, maximum), one);
+			second = _mm_add_ps(ClampSSE(_mm_mul_ps(_mm_sub_ps(second, offset), scale), minimum, maximum), one);
+
+			__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(first, range)), _mm_cvtps_epi32(_mm_mul_ps(second, range)));
+			StoreLow64(output + size_t(i) * outputStride, packed);
+			StoreLow64(output + size_t(i + 1) * outputStride, _mm_srli_si128(packed, 8));
+		}
+
+		return i;
+	}
+
+	uint32_t EncodeColoursSSE(const uint8_t* colours, uint32_t colourStride, bool hasAlpha, uint32_t count, uint8_t* output, uint32_t outputStride)
+	{
+		const __m128 minimum = _mm_setzero_ps();
+		const __m128 maximum = _mm_set1_ps(1.0f);
+		const __m128 range = _mm_set1_ps(Unorm8Scale);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint8_t* source = colours + size_t(i) * colourStride;
+
+			float alpha = 1.0f;
+			if (hasAlpha)
+			{
+				std::memcpy(&alpha, source + 12, sizeof(alpha));
+			}
+
+			__m128 colour = _mm_mul_ps(ClampSSE(LoadFloat3SSE(source, alpha), minimum, maximum), range);
+			__m128i words = _mm_packs_epi32(_mm_cvtps_epi32(colour), _mm_setzero_si128());
+			Store32(output + size_t(i) * outputStride, _mm_packus_epi16(words, words));
+		}
+
+		return count;
+	}
+
+	// Four normals per iteration as structure of arrays.
+	uint32_t EncodeOctahedralNormalsSSE(const uint8_t* normals, uint32_t normalStride, uint32_t count, uint8_t* output, uint32_t outputStride)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 minimum = _mm_set1_ps(-1.0f);
+		const __m128 range = _mm_set1_ps(Snorm16Scale);
+
+		uint32_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			FFloat3 n[4];
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				n[lane] = LoadFloat3(normals + size_t(i + lane) * normalStride);
+			}
+
+			__m128 x = _mm_setr_ps(n[0].X, n[1].X, n[2].X, n[3].X);
+			__m128 y = _mm_setr_ps(n[0].Y, n[1].Y, n[2].Y, n[3].Y);
+			__m128 z = _mm_setr_ps(n[0].Z, n[1].Z, n[2].Z, n[3].Z);
+
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+			__m128 zeroLength = _mm_cmpeq_ps(sum, zero);
+			sum = _mm_or_ps(_mm_and_ps(zeroLength, one), _mm_andnot_ps(zeroLength, sum));
+			x = _mm_div_ps(_mm_andnot_ps(zeroLength, x), sum);
+			y = _mm_div_ps(_mm_andnot_ps(zeroLength, y), sum);
+
+			__m128 lower = _mm_andnot_ps(zeroLength, _mm_cmplt_ps(z, zero));
+			__m128 foldedX = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, y)), _mm_and_ps(signMask, x));
+			__m128 foldedY = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_and_ps(signMask, y));
+			x = _mm_or_ps(_mm_and_ps(lower, foldedX), _mm_andnot_ps(lower, x));
+			y = _mm_or_ps(_mm_and_ps(lower, foldedY), _mm_andnot_ps(lower, y));
+
+			x = _mm_mul_ps(ClampSSE(x, minimum, one), range);
+			y = _mm_mul_ps(ClampSSE(y, minimum, one), range);
+
+			__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(x), _mm_cvtps_epi32(y));
+			__m128i interleaved = _mm_unpacklo_epi16(packed, _mm_srli_si128(packed, 8));
+
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				Store32(output + size_t(i + lane) * outputStride, interleaved);
+				interleaved = _mm_srli_si128(interleaved, 4);
+			}
+		}
+
+		return i;
+	}
+#endif
+
+	bool SetError(std::string* error, const char* message)
+	{
+		if (error)
+		{
+			*error = message;
+		}
+
+		return false;
+	}
+
+	bool EqualsIgnoreCase(const char* a, const char* b)
+	{
+		for (; *a && *b; ++a, ++b)
+		{
+			if (std::toupper(static_cast<unsigned char>(*a)) != std::toupper(static_cast<unsigned char>(*b)))
+			{
+				return false;
+			}
+		}
+
+		return *a == *b;
+	}
+
+	uint32_t GetComponentCount(EVertexFormat format)
+	{
+		switch (format)
+		{
+			case EVertexFormat::Float2:
+			case EVertexFormat::Short2Norm:
+				return 2;
+
+			case EVertexFormat::Float3:
+				return 3;
+
+			default:
+				return 4;
+		}
+	}
+
+	// Widens or narrows an HLSL expression of the element to the components the decoded vertex wants.
+	std::string Resize(const std::string& expression, uint32_t components, uint32_t wanted, const char* fill)
+	{
+		static const char* swizzles[] = { "", ".x", ".xy", ".xyz" };
+		static const char* types[] = { "", "float", "float2", "float3", "float4" };
+
+		if (components == wanted)
+		{
+			return expression;
+		}
+
+		if (components > wanted)
+		{
+			return expression + swizzles[wanted];
+		}
+
+		return std::string(types[wanted]) + "(" + expression + fill + ")";
+	}
+}
+
+FPositionQuantization ComputePositionQuantization(const uint8_t* positions, uint32_t stride, uint32_t count)
+{
+	FPositionQuantization quantization = GetIdentityPositionQuantization();
+	if (count == 0)
+	{
+		return quantization;
+	}
+
+	FFloat3 minimum = { FLT_MAX, FLT_MAX, FLT_MAX };
+	FFloat3 maximum = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		FFloat3 position = LoadFloat3(positions + size_t(i) * stride);
+		minimum = { std::min(minimum.X, position.X), std::min(minimum.Y, position.Y), std::min(minimum.Z, position.Z) };
+		maximum = { std::max(maximum.X, position.X), std::max(maximum.Y, position.Y), std::max(maximum.Z, position.Z) };
+	}
+
+	// A flat axis keeps a scale of one, every position on it stores as zero.
+	auto halfExtent = [](float low, float high)
+	{
+		float extent = 0.5f * (high - low);
+		return extent > 0.0f ? extent : 1.0f;
+	};
+
+	quantization.Offset = { 0.5f * (minimum.X + maximum.X), 0.5f * (minimum.Y + maximum.Y), 0.5f * (minimum.Z + maximum.Z) };
+	quantization.Scale = { halfExtent(minimum.X, maximum.X), halfExtent(minimum.Y, maximum.Y), halfExtent(minimum.Z, maximum.Z) };
+
+	return quantization;
+}
+
+void EncodePositions(const uint8_t* positions, uint32_t positionStride, uint32_t count, const FPositionQuantization& quantization,
+	uint8_t* output, uint32_t outputStride)
+{
+	uint32_t begin = 0;
+#if MORPHEUS_VERTEX_FORMAT_SSE
+	if (UseSSE())
+	{
+		begin = EncodePositionsSSE(positions, positionStride, count, quantization, output, outputStride);
+	}
+#endif
+
+	EncodePositionsScalar(positions, positionStride, begin, count, quantization, output, outputStride);
+}
+
+void EncodeColours(const uint8_t* colours, uint32_t colourStride, bool hasAlpha, uint32_t count, uint8_t* output, uint32_t outputStride)
+{
+	uint32_t begin = 0;
+#if MORPHEUS_VERTEX_FORMAT_SSE
+	if (UseSSE())
+	{
+		begin = EncodeColoursSSE(colours, colourStride, hasAlpha, count, output, outputStride);
+	}
+#endif
+
+	EncodeColoursScalar(colours, colourStride, hasAlpha, begin, count, output, outputStride);
+}
+
+void EncodeOctahedralNormals(const uint8_t* normals, uint32_t normalStride, uint32_t count, uint8_t* output, uint32_t outputStride)
+{
+	uint32_t begin = 0;
+#if MORPHEUS_VERTEX_FORMAT_SSE
+	if (UseSSE())
+	{
+		begin = EncodeOctahedralNormalsSSE(normals, normalStride, count, output, outputStride);
+	}
+#endif
+
+	EncodeOctahedralNormalsScalar(normals, normalStride, begin, count, output, outputStride);
+}
+
+void ReadVertexElement(const uint8_t* data, EVertexFormat format, float value[4])
+{
+	value[0] = 0.0f;
+	value[1] = 0.0f;
+	value[2] = 0.0f;
+	value[3] = 1.0f;
+
+	switch (format)
+	{
+		case EVertexFormat::Float2:
+		case EVertexFormat::Float3:
+		case EVertexFormat::Float4:
+			std::memcpy(value, data, GetVertexFormatSize(format));
+			break;
+
+		case EVertexFormat::Short4Norm:
+		case EVertexFormat::Short2Norm:
+		{
+			// -32768 and -32767 both decode to -1.
+			int16_t packed[4];
+			uint32_t components = GetComponentCount(format);
+			std::memcpy(packed, data, components * sizeof(int16_t));
+			for (uint32_t i = 0; i < components; ++i)
+			{
+				value[i] = std::max(packed[i] / Snorm16Scale, -1.0f);
+			}
+			break;
+		}
+
+		case EVertexFormat::UByte4Norm:
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				value[i] = data[i] / Unorm8Scale;
+			}
+			break;
+	}
+}
+
+FFloat3 DecodeOctahedralNormal(float x, float y)
+{
+	FFloat3 normal = { x, y, 1.0f - std::fabs(x) - std::fabs(y) };
+
+	// Unfold the lower half.
+	float fold = std::max(-normal.Z, 0.0f);
+	normal.X += normal.X >= 0.0f ? -fold : fold;
+	normal.Y += normal.Y >= 0.0f ? -fold : fold;
+
+	float length = std::sqrt(normal.X * normal.X + normal.Y * normal.Y + normal.Z * normal.Z);
+
+	return { normal.X / length, normal.Y / length, normal.Z / length };
+}
+
+bool QuantizeMeshVertices(FMeshData& mesh, const FVertexFormatOptions& options, FVertexQuantizationStats* stats, std::string* error)
+{
+	FVertexQuantizationStats result;
+
+	uint32_t positionStride = 0;
+	const uint8_t* positions = GetMeshDataPositions(mesh, positionStride);
+
+	FPositionQuantization identity = GetIdentityPositionQuantization();
+	bool quantizePositions = options.QuantizePositions && positions;
+	if (quantizePositions && std::memcmp(&mesh.PositionQuantization, &identity, sizeof(identity)) != 0)
+	{
+		return SetError(error, "Float positions of the mesh are already scaled");
+	}
+
+	FPositionQuantization quantization = quantizePositions ? ComputePositionQuantization(positions, positionStride, mesh.VertexCount) : mesh.PositionQuantization;
+
+	for (FMeshStreamData& stream : mesh.Streams)
+	{
+		if (stream.Data.size() != uint64_t(mesh.VertexCount) * stream.Stride)
+		{
+			return SetError(error, "Vertex stream size does not match the vertex count");
+		}
+
+		// Same elements in the same order, every one at the next multiple of four bytes.
+		std::vector<FMeshFileElement> elements = stream.Elements;
+		uint32_t stride = 0;
+		for (FMeshFileElement& element : elements)
+		{
+			bool isPosition = quantizePositions && stream.Data.data() + element.Offset == positions;
+			bool isNormal = options.OctahedralNormals && element.Semantic == EMeshSemantic::Normal && element.Format == EVertexFormat::Float3;
+			bool isColour = options.PackColours && element.Semantic == EMeshSemantic::Colour &&
+				(element.Format == EVertexFormat::Float3 || element.Format == EVertexFormat::Float4);
+
+			if (isPosition)
+			{
+				element.Format = EVertexFormat::Short4Norm;
+			}
+			else if (isNormal)
+			{
+				element.Format = EVertexFormat::Short2Norm;
+			}
+			else if (isColour)
+			{
+				element.Format = EVertexFormat::UByte4Norm;
+			}
+
+			element.Offset = static_cast<uint8_t>(stride);
+			stride += (GetVertexFormatSize(element.Format) + 3) & ~3u;
+		}
+
+		std::vector<uint8_t> data(size_t(stride) * mesh.VertexCount);
+		for (size_t i = 0; i < elements.size(); ++i)
+		{
+			const FMeshFileElement& before = stream.Elements[i];
+			const FMeshFileElement& after = elements[i];
+			const uint8_t* source = stream.Data.data() + before.Offset;
+			uint8_t* destination = data.data() + after.Offset;
+
+			if (before.Format == after.Format)
+			{
+				for (uint32_t vertex = 0; vertex < mesh.VertexCount; ++vertex)
+				{
+					std::memcpy(destination + size_t(vertex) * stride, source + size_t(vertex) * stream.Stride, GetVertexFormatSize(after.Format));
+				}
+				continue;
+			}
+
+			// Encode, then decode again to measure what the packing lost.
+			float decoded[4];
+			switch (after.Format)
+			{
+				case EVertexFormat::Short4Norm:
+					EncodePositions(source, stream.Stride, mesh.VertexCount, quantization, destination, stride);
+					for (uint32_t vertex = 0; vertex < mesh.VertexCount; ++vertex)
+					{
+						FFloat3 original = LoadFloat3(source + size_t(vertex) * stream.Stride);
+						ReadVertexElement(destination + size_t(vertex) * stride, after.Format, decoded);
+
+						float dx = decoded[0] * quantization.Scale.X + quantization.Offset.X - original.X;
+						float dy = decoded[1] * quantization.Scale.Y + quantization.Offset.Y - original.Y;
+						float dz = decoded[2] * quantization.Scale.Z + quantization.Offset.Z - original.Z;
+						result.MaxPositionError = std::max(result.MaxPositionError, std::sqrt(dx * dx + dy * dy + dz * dz));
+					}
+					break;
+
+				case EVertexFormat::Short2Norm:
+					EncodeOctahedralNormals(source, stream.Stride, mesh.VertexCount, destination, stride);
+					for (uint32_t vertex = 0; vertex < mesh.VertexCount; ++vertex)
+					{
+						FFloat3 original = LoadFloat3(source + size_t(vertex) * stream.Stride);
+						double length = std::sqrt(double(original.X) * original.X + double(original.Y) * original.Y + double(original.Z) * original.Z);
+						if (length == 0.0)
+						{
+							continue;
+						}
+
+						ReadVertexElement(destination + size_t(vertex) * stride, after.Format, decoded);
+						FFloat3 normal = DecodeOctahedralNormal(decoded[0], decoded[1]);
+
+						// The angle from the cross and dot products stays precise for tiny angles.
+						double crossX = original.Y * double(normal.Z) - original.Z * double(normal.Y);
+						double crossY = original.Z * double(normal.X) - original.X * double(normal.Z);
+						double crossZ = original.X * double(normal.Y) - original.Y * double(normal.X);
+						double dot = original.X * double(normal.X) + original.Y * double(normal.Y) + original.Z * double(normal.Z);
+						double angle = std::atan2(std::sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot) * (180.0 / 3.14159265358979323846);
+						result.MaxNormalErrorDegrees = std::max(result.MaxNormalErrorDegrees, static_cast<float>(angle));
+					}
+					break;
+
+				case EVertexFormat::UByte4Norm:
+				{
+					bool hasAlpha = before.Format == EVertexFormat::Float4;
+					EncodeColours(source, stream.Stride, hasAlpha, mesh.VertexCount, destination, stride);
+					for (uint32_t vertex = 0; vertex < mesh.VertexCount; ++vertex)
+					{
+						float original[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+						std::memcpy(original, source + size_t(vertex) * stream.Stride, hasAlpha ? 16 : 12);
+						ReadVertexElement(destination + size_t(vertex) * stride, after.Format, decoded);
+
+						for (int channel = 0; channel < 4; ++channel)
+						{
+							result.MaxColourError = std::max(result.MaxColourError, std::fabs(decoded[channel] - Clamp(original[channel], 0.0f, 1.0f)));
+						}
+					}
+					break;
+				}
+
+				default:
+					break;
+			}
+		}
+
+		result.VertexSizeBefore += stream.Stride;
+		result.VertexSizeAfter += stride;
+
+		stream.Stride = stride;
+		stream.Elements.swap(elements);
+		stream.Data.swap(data);
+	}
+
+	mesh.PositionQuantization = quantization;
+
+	if (stats)
+	{
+		*stats = result;
+	}
+
+	return true;
+}
+
+std::string GenerateVertexShaderInput(const FInputElementDesc* elements, uint32_t elementCount)
+{
+	std::string members;
+	std::string position = "float3(0.0f, 0.0f, 0.0f)";
+	std::string normal = "float3(0.0f, 0.0f, 0.0f)";
+	std::string colour = "float4(1.0f, 1.0f, 1.0f, 1.0f)";
+	std::string texCoord = "float2(0.0f, 0.0f)";
+
+	static const char* types[] = { "", "float", "float2", "float3", "float4" };
+
+	for (uint32_t i = 0; i < elementCount; ++i)
+	{
+		const FInputElementDesc& element = elements[i];
+		if (element.Classification != EInputClassification::PerVertex || !element.SemanticName)
+		{
+			continue;
+		}
+
+		// Members are the semantic in lower case, with the index when it is not zero.
+		std::string name;
+		for (const char* c = element.SemanticName; *c; ++c)
+		{
+			name += static_cast<char>(std::tolower(static_cast<unsigned char>(*c)));
+		}
+		if (element.SemanticIndex != 0)
+		{
+			name += std::to_string(element.SemanticIndex);
+		}
+
+		uint32_t components = GetComponentCount(element.Format);
+		members += std::string("\t") + types[components] + " " + name + " : " + element.SemanticName + std::to_string(element.SemanticIndex) + ";\n";
+
+		if (element.SemanticIndex != 0)
+		{
+			continue;
+		}
+
+		std::string value = "input." + name;
+		if (EqualsIgnoreCase(element.SemanticName, GetMeshSemanticName(EMeshSemantic::Position)))
+		{
+			position = Resize(value, components, 3, ", 0.0f") + " * positionScale.xyz + positionOffset.xyz";
+		}
+		else if (EqualsIgnoreCase(element.SemanticName, GetMeshSemanticName(EMeshSemantic::Normal)))
+		{
+			normal = element.Format == EVertexFormat::Short2Norm ? "DecodeOctahedralNormal(" + value + ")" : "normalize(" + Resize(value, components, 3, ", 0.0f") + ")";
+		}
+		else if (EqualsIgnoreCase(element.SemanticName, GetMeshSemanticName(EMeshSemantic::Colour)))
+		{
+			colour = Resize(value, components, 4, components == 2 ? ", 0.0f, 1.0f" : ", 1.0f");
+		}
+		else if (EqualsIgnoreCase(element.SemanticName, GetMeshSemanticName(EMeshSemantic::TexCoord)))
+		{
+			texCoord = Resize(value, components, 2, "");
+		}
+	}
+
+	std::string text;
+	text += "// Generated by GenerateVertexShaderInput() from the input layout of the mesh.\n\n";
+	text += "struct VertexInput\n{\n" + members + "};\n\n";
+	text += "struct DecodedVertex\n{\n\tfloat3 position;\n\tfloat3 normal;\n\tfloat4 color;\n\tfloat2 texCoord;\n};\n\n";
+	text += "float3 DecodeOctahedralNormal(float2 encoded)\n{\n";
+	text += "\tfloat3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));\n";
+	text += "\tfloat fold = saturate(-normal.z);\n";
+	text += "\tnormal.xy += (normal.xy >= 0.0f) ? -fold : fold;\n";
+	text += "\treturn normalize(normal);\n}\n\n";
+	text += "DecodedVertex DecodeVertex(VertexInput input)\n{\n";
+	text += "\tDecodedVertex output;\n";
+	text += "\toutput.position = " + position + ";\n";
+	text += "\toutput.normal = " + normal + ";\n";
+	text += "\toutput.color = " + colour + ";\n";
+	text += "\toutput.texCoord = " + texCoord + ";\n";
+	text += "\treturn output;\n}\n";
+
+	return text;
+}
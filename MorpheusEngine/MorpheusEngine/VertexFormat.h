@@ -0,0 +1,75 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "TransformMath.h"
+
+#include <cstdint>
+#include <string>
+
+struct FMeshData;
+
+// Packed vertex attributes. The input assembler turns every format below into floats, so shaders only
+// differ where the packing needs decoding:
+//   positions    Short4Norm, in the box of the mesh, mesh position = stored * Scale + Offset
+//   normals      Short2Norm, octahedral encoding of the unit vector
+//   colours      UByte4Norm
+// Float formats decode with a Scale of one and an Offset of zero, so one shader serves both.
+
+// Dequantisation of the positions of one mesh, uploaded with the object constants.
+struct FPositionQuantization
+{
+	FFloat3 Scale;
+	FFloat3 Offset;
+};
+
+static_assert(sizeof(FPositionQuantization) == 24, "Position quantization layout changed");
+
+inline FPositionQuantization GetIdentityPositionQuantization()
+{
+	return { { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+}
+
+// The box of the positions mapped to [-1, 1] on every axis.
+FPositionQuantization ComputePositionQuantization(const uint8_t* positions, uint32_t stride, uint32_t count);
+
+// Batched encoders, from strided Float3 (Float4 for colours with alpha) to strided packed vertices. The
+// SSE kernels give bit identical results to the scalar ones, which run with the Scalar math backend and
+// on other CPUs. Positions store a w of one, colours without alpha an alpha of one.
+void EncodePositions(const uint8_t* positions, uint32_t positionStride, uint32_t count, const FPositionQuantization& quantization,
+	uint8_t* output, uint32_t outputStride);
+void EncodeColours(const uint8_t* colours, uint32_t colourStride, bool hasAlpha, uint32_t count, uint8_t* output, uint32_t outputStride);
+// Normals need not be unit length; zero normals encode as +Z.
+void EncodeOctahedralNormals(const uint8_t* normals, uint32_t normalStride, uint32_t count, uint8_t* output, uint32_t outputStride);
+
+// Reads one element as the input assembler would, missing components as (0, 0, 0, 1).
+void ReadVertexElement(const uint8_t* data, EVertexFormat format, float value[4]);
+FFloat3 DecodeOctahedralNormal(float x, float y);
+
+struct FVertexFormatOptions
+{
+	bool QuantizePositions = true;
+	bool OctahedralNormals = true;
+	bool PackColours = true;
+};
+
+// Largest differences between the float attributes and their packed versions decoded again.
+struct FVertexQuantizationStats
+{
+	uint32_t VertexSizeBefore = 0;
+	uint32_t VertexSizeAfter = 0;
+	// In mesh units.
+	float MaxPositionError = 0.0f;
+	float MaxNormalErrorDegrees = 0.0f;
+	// Of a channel in [0, 1].
+	float MaxColourError = 0.0f;
+};
+
+// Repacks the Float3 positions and normals and the float colours of every stream; other elements keep
+// their format. Run OptimizeMesh() first, it needs float positions.
+bool QuantizeMeshVertices(FMeshData& mesh, const FVertexFormatOptions& options, FVertexQuantizationStats* stats = nullptr, std::string* error = nullptr);
+
+// HLSL for the vertex input of a layout: a VertexInput struct with one member per element of the
+// per-vertex slots, and DecodeVertex(), which unpacks it into a DecodedVertex of position, normal,
+// colour and texture coordinate. Attributes the layout lacks decode to zero, with a white colour.
+// positionScale and positionOffset must be declared before the generated code.
+std::string GenerateVertexShaderInput(const FInputElementDesc* elements, uint32_t elementCount);
@@ -0,0 +1,254 @@
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "ObjImporter.h"
+#include "VertexFormat.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	void PrintUsage()
+	{
+		printf("Usage:\n");
+		printf("  MorpheusMeshConverter <input.obj> <output.mesh> [--separate-positions] [--right-handed] [--no-optimize] [--meshlets] [--no-quantize]\n");
+		printf("  MorpheusMeshConverter --pack <output.pack> <input.mesh>...\n\n");
+		printf("  --separate-positions  Positions in their own vertex stream, the other attributes in a second one.\n");
+		printf("  --right-handed        Keep the OBJ coordinates and winding instead of converting them to left handed.\n");
+		printf("  --no-optimize         Keep the triangle and vertex order of the OBJ file.\n");
+		printf("  --meshlets            Also split the submeshes into meshlets with bounding cones.\n");
+		printf("  --no-quantize         Keep float positions, normals and colours instead of packing them.\n");
+		printf("  --pack                Combines mesh files into one pack, named after the files without their extension.\n");
+	}
+
+	void PrintMesh(const char* path, const FMeshFile& mesh)
+	{
+		const FBoundingBox& bounds = mesh.GetBounds();
+
+		printf("%s: %u vertices, %u %s indices, %u submeshes, %u meshlets, %llu bytes\n", path, mesh.GetVertexCount(), mesh.GetIndexCount(),
+			mesh.GetIndexFormat() == EIndexFormat::UInt16 ? "16 bit" : "32 bit", mesh.GetSubmeshCount(), mesh.GetMeshletCount(),
+			static_cast<unsigned long long>(mesh.GetSize()));
+
+		for (uint32_t stream = 0; stream < mesh.GetStreamCount(); ++stream)
+		{
+			const FMeshFileStream& streamHeader = mesh.GetStream(stream);
+
+			printf("  stream %u, %u bytes per vertex:", stream, streamHeader.Stride);
+			for (uint32_t i = 0; i < streamHeader.ElementCount; ++i)
+			{
+				printf(" %s%u", GetMeshSemanticName(streamHeader.Elements[i].Semantic), streamHeader.Elements[i].SemanticIndex);
+			}
+			printf("\n");
+		}
+
+		printf("  bounds (%g, %g, %g) to (%g, %g, %g)\n", bounds.Min.X, bounds.Min.Y, bounds.Min.Z, bounds.Max.X, bounds.Max.Y, bounds.Max.Z);
+	}
+
+	void PrintOptimizeStats(const FMeshOptimizeStats& stats)
+	{
+		printf("  vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", stats.CacheBefore.Acmr, stats.CacheAfter.Acmr, stats.CacheBefore.Atvr,
+			stats.CacheAfter.Atvr);
+		printf("  vertex fetch overfetch %.2f -> %.2f\n", stats.FetchBefore.Overfetch, stats.FetchAfter.Overfetch);
+	}
+
+	void PrintQuantizationStats(const FVertexQuantizationStats& stats)
+	{
+		printf("  vertex size %u -> %u bytes, largest error: position %g, normal %.4f degrees, colour %.4f\n", stats.VertexSizeBefore,
+			stats.VertexSizeAfter, stats.MaxPositionError, stats.MaxNormalErrorDegrees, stats.MaxColourError);
+	}
+
+	std::string GetMeshName(const std::string& path)
+	{
+		size_t begin = path.find_last_of("/\\");
+		begin = begin == std::string::npos ? 0 : begin + 1;
+
+		size_t end = path.find_last_of('.');
+		end = (end == std::string::npos || end < begin) ? path.size() : end;
+
+		return path.substr(begin, end - begin);
+	}
+
+	int ConvertObj(int argumentCount, char** arguments)
+	{
+		const char* inputPath = nullptr;
+		const char* outputPath = nullptr;
+		FObjImportOptions options;
+		FMeshOptimizeOptions optimizeOptions;
+		bool optimize = true;
+		bool quantize = true;
+
+		for (int i = 1; i < argumentCount; ++i)
+		{
+			if (strcmp(arguments[i], "--separate-positions") == 0)
+			{
+				options.SeparatePositionStream = true;
+			}
+			else if (strcmp(arguments[i], "--right-handed") == 0)
+			{
+				options.ConvertToLeftHanded = false;
+			}
+			else if (strcmp(arguments[i], "--no-optimize") == 0)
+			{
+				optimize = false;
+			}
+			else if (strcmp(arguments[i], "--meshlets") == 0)
+			{
+				optimizeOptions.BuildMeshlets = true;
+			}
+			else if (strcmp(arguments[i], "--no-quantize") == 0)
+			{
+				quantize = false;
+			}
+			else if (strncmp(arguments[i], "--", 2) == 0)
+			{
+				fprintf(stderr, "Unknown option '%s'\n", arguments[i]);
+				return 1;
+			}
+			else if (!inputPath)
+			{
+				inputPath = arguments[i];
+			}
+			else if (!outputPath)
+			{
+				outputPath = arguments[i];
+			}
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+
+		if (!inputPath || !outputPath)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		FMeshData meshData;
+		std::string error;
+		if (!ImportObjFile(inputPath, options, meshData, &error))
+		{
+			fprintf(stderr, "%s: %s\n", inputPath, error.c_str());
+			return 1;
+		}
+
+		FMeshOptimizeStats stats;
+		if (optimize && !OptimizeMesh(meshData, optimizeOptions, &stats, &error))
+		{
+			fprintf(stderr, "%s: %s\n", inputPath, error.c_str());
+			return 1;
+		}
+
+		// Last, the optimiser works on float positions.
+		FVertexQuantizationStats quantizationStats;
+		if (quantize && !QuantizeMeshVertices(meshData, FVertexFormatOptions(), &quantizationStats, &error))
+		{
+			fprintf(stderr, "%s: %s\n", inputPath, error.c_str());
+			return 1;
+		}
+
+		if (!WriteMeshFile(outputPath, meshData, &error))
+		{
+			fprintf(stderr, "%s: %s\n", outputPath, error.c_str());
+			return 1;
+		}
+
+		// Read the result back through the loader, so a broken file never leaves the converter.
+		FMeshFile mesh;
+		if (!mesh.Open(outputPath))
+		{
+			fprintf(stderr, "%s: %s\n", outputPath, mesh.GetError());
+			return 1;
+		}
+
+		PrintMesh(outputPath, mesh);
+		if (optimize)
+		{
+			PrintOptimizeStats(stats);
+		}
+		if (quantize)
+		{
+			PrintQuantizationStats(quantizationStats);
+		}
+
+		return 0;
+	}
+
+	int BuildPack(int argumentCount, char** arguments)
+	{
+		if (argumentCount < 4)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		const char* outputPath = arguments[2];
+
+		// Every mesh stays mapped until the pack is written.
+		std::vector<FMeshFile> meshes(argumentCount - 3);
+		std::vector<FMeshPackSource> sources;
+
+		for (int i = 3; i < argumentCount; ++i)
+		{
+			FMeshFile& mesh = meshes[i - 3];
+			if (!mesh.Open(arguments[i]))
+			{
+				fprintf(stderr, "%s: %s\n", arguments[i], mesh.GetError());
+				return 1;
+			}
+
+			FMeshPackSource source;
+			source.Name = GetMeshName(arguments[i]);
+			source.Data = mesh.GetData();
+			source.Size = mesh.GetSize();
+			sources.push_back(source);
+		}
+
+		std::string error;
+		if (!WriteMeshPack(outputPath, sources, &error))
+		{
+			fprintf(stderr, "%s: %s\n", outputPath, error.c_str());
+			return 1;
+		}
+
+		FMeshPack pack;
+		if (!pack.Open(outputPath))
+		{
+			fprintf(stderr, "%s: %s\n", outputPath, pack.GetError());
+			return 1;
+		}
+
+		for (uint32_t i = 0; i < pack.GetMeshCount(); ++i)
+		{
+			FMeshFile mesh;
+			if (!pack.OpenMesh(i, mesh))
+			{
+				fprintf(stderr, "%s: %s: %s\n", outputPath, pack.GetMeshName(i), mesh.GetError());
+				return 1;
+			}
+		}
+
+		printf("%s: %u meshes, %llu bytes\n", outputPath, pack.GetMeshCount(), static_cast<unsigned long long>(pack.GetFile().GetSize()));
+
+		return 0;
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if (argumentCount < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (strcmp(arguments[1], "--pack") == 0)
+	{
+		return BuildPack(argumentCount, arguments);
+	}
+
+	return ConvertObj(argumentCount, arguments);
+}